@@ -18,6 +18,7 @@
 #define LOG_TAG "BootAnimation"
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <math.h>
 #include <fcntl.h>
@@ -61,10 +62,21 @@
 #define SYSTEM_BOOTANIMATION_FILE "/system/media/bootanimation.zip"
 #define SYSTEM_ENCRYPTED_BOOTANIMATION_FILE "/system/media/bootanimation-encrypted.zip"
 #define EXIT_PROP_NAME "service.bootanim.exit"
+#define DECODE_AHEAD_PROP_NAME "ro.bootanim.decode_ahead"
 
 namespace android {
 
 static const int ANIM_ENTRY_NAME_MAX = 256;
+static const int DEFAULT_DECODE_AHEAD = 3;
+static const int MAX_DECODE_AHEAD = 8;
+
+// Compressed texture formats that GLES/glext.h may not define.
+static const GLenum GL_FORMAT_COMPRESSED_RGB8_ETC2 = 0x9274;
+static const GLenum GL_FORMAT_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 = 0x9276;
+static const GLenum GL_FORMAT_COMPRESSED_RGBA8_ETC2_EAC = 0x9278;
+static const GLenum GL_FORMAT_COMPRESSED_RGBA_ASTC_4x4 = 0x93B0;
+
+static const uint32_t ASTC_MAGIC = 0x5CA1AB13;
 
 // ---------------------------------------------------------------------------
 
@@ -161,16 +173,16 @@ status_t BootAnimation::initTexture(Texture* texture, AssetManager& assets,
     return NO_ERROR;
 }
 
-status_t BootAnimation::initTexture(const Animation::Frame& frame)
+void BootAnimation::decodeFrame(const Animation::Frame& frame, SkBitmap* bitmap,
+        bool releaseMap)
 {
     //StopWatch watch("blah");
 
-    SkBitmap bitmap;
     SkMemoryStream  stream(frame.map->getDataPtr(), frame.map->getDataLength());
     SkImageDecoder* codec = SkImageDecoder::Factory(&stream);
     if (codec != NULL) {
         codec->setDitherImage(false);
-        codec->decode(&stream, &bitmap,
+        codec->decode(&stream, bitmap,
                 #ifdef USE_565
                 kRGB_565_SkColorType,
                 #else
@@ -181,17 +193,25 @@ status_t BootAnimation::initTexture(const Animation::Frame& frame)
     }
 
     // FileMap memory is never released until application exit.
-    // Release it now as the texture is already loaded and the memory used for
-    // the packed resource can be released.
-    delete frame.map;
-
-    // ensure we can call getPixels(). No need to call unlock, since the
-    // bitmap will go out of scope when we return from this method.
-    bitmap.lockPixels();
+    // Release it now as the frame is already decoded and the memory used for
+    // the packed resource can be released, unless the frame is decoded again.
+    if (releaseMap) {
+        delete frame.map;
+    }
+}
 
-    const int w = bitmap.width();
-    const int h = bitmap.height();
-    const void* p = bitmap.getPixels();
+status_t BootAnimation::initTexture(SkBitmap* bitmap)
+{
+    // ensure we can call getPixels(). The pixels are unlocked when the
+    // bitmap is reset or goes out of scope.
+    bitmap->lockPixels();
+
+    const int w = bitmap->width();
+    const int h = bitmap->height();
+    const void* p = bitmap->getPixels();
+    if (p == NULL || w <= 0 || h <= 0) {
+        return NO_INIT;
+    }
 
     GLint crop[4] = { 0, h, w, -h };
     int tw = 1 << (31 - __builtin_clz(w));
@@ -199,7 +219,7 @@ status_t BootAnimation::initTexture(const Animation::Frame& frame)
     if (tw < w) tw <<= 1;
     if (th < h) th <<= 1;
 
-    switch (bitmap.colorType()) {
+    switch (bitmap->colorType()) {
         case kN32_SkColorType:
             if (tw != w || th != h) {
                 glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, tw, th, 0, GL_RGBA,
@@ -232,6 +252,184 @@ status_t BootAnimation::initTexture(const Animation::Frame& frame)
     return NO_ERROR;
 }
 
+static inline uint32_t readBE16(const uint8_t* p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t readLE24(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16);
+}
+
+static bool isPowerOfTwo(GLsizei n) {
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+// Parses the header of a .pkm (ETC1/ETC2) or .astc frame. The texture has to
+// be a power of two in each dimension, as GLES 1 requires, and frames
+// smaller than that are padded by the encoder: .pkm files record the size of
+// the image, for .astc the animation size is used.
+bool BootAnimation::parseCompressedFrame(Animation::Frame* frame, const Animation& animation)
+{
+    const uint8_t* p = (const uint8_t*) frame->map->getDataPtr();
+    const size_t length = frame->map->getDataLength();
+    size_t blocks;
+    size_t blockSize;
+
+    if (frame->name.getPathExtension() == ".pkm") {
+        if (length < 16 || memcmp(p, "PKM ", 4) != 0) {
+            return false;
+        }
+        const bool v2 = p[4] == '2';
+        switch (v2 ? readBE16(p + 6) : 0) {
+            case 0:
+                frame->format = GL_ETC1_RGB8_OES;
+                blockSize = 8;
+                break;
+            case 1:
+                frame->format = GL_FORMAT_COMPRESSED_RGB8_ETC2;
+                blockSize = 8;
+                break;
+            case 3:
+                frame->format = GL_FORMAT_COMPRESSED_RGBA8_ETC2_EAC;
+                blockSize = 16;
+                break;
+            case 4:
+                frame->format = GL_FORMAT_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+                blockSize = 8;
+                break;
+            default:
+                return false;
+        }
+        frame->width = readBE16(p + 8);
+        frame->height = readBE16(p + 10);
+        frame->cropWidth = readBE16(p + 12);
+        frame->cropHeight = readBE16(p + 14);
+        blocks = ((frame->width + 3) / 4) * ((frame->height + 3) / 4);
+        frame->dataOffset = 16;
+    } else if (frame->name.getPathExtension() == ".astc") {
+        if (length < 16 || (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24))
+                != ASTC_MAGIC) {
+            return false;
+        }
+        static const uint8_t kBlockSizes[][2] = {
+            { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+            { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+        };
+        const uint8_t bx = p[4];
+        const uint8_t by = p[5];
+        const size_t numBlockSizes = sizeof(kBlockSizes) / sizeof(kBlockSizes[0]);
+        size_t i = 0;
+        while (i < numBlockSizes && (kBlockSizes[i][0] != bx || kBlockSizes[i][1] != by)) {
+            i++;
+        }
+        if (i == numBlockSizes || p[6] != 1 || readLE24(p + 13) != 1) {
+            return false;
+        }
+        frame->format = GL_FORMAT_COMPRESSED_RGBA_ASTC_4x4 + i;
+        frame->width = readLE24(p + 7);
+        frame->height = readLE24(p + 10);
+        frame->cropWidth = animation.width < frame->width ? animation.width : frame->width;
+        frame->cropHeight = animation.height < frame->height ? animation.height : frame->height;
+        blocks = ((frame->width + bx - 1) / bx) * ((frame->height + by - 1) / by);
+        blockSize = 16;
+        frame->dataOffset = 16;
+    } else {
+        return false;
+    }
+
+    frame->dataSize = blocks * blockSize;
+    return isPowerOfTwo(frame->width) && isPowerOfTwo(frame->height)
+            && frame->cropWidth <= frame->width && frame->cropHeight <= frame->height
+            && frame->dataOffset + frame->dataSize <= length;
+}
+
+// Uploads a pre-compressed frame straight from its zip entry mapping.
+status_t BootAnimation::initCompressedTexture(const Animation::Frame& frame, bool releaseMap)
+{
+    const uint8_t* data = (const uint8_t*) frame.map->getDataPtr() + frame.dataOffset;
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, frame.format, frame.width, frame.height, 0,
+            frame.dataSize, data);
+
+    GLint crop[4] = { 0, frame.cropHeight, frame.cropWidth, -frame.cropHeight };
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_CROP_RECT_OES, crop);
+
+    if (releaseMap) {
+        delete frame.map;
+    }
+    return glGetError() == GL_NO_ERROR ? NO_ERROR : UNKNOWN_ERROR;
+}
+
+BootAnimation::FrameDecoder::FrameDecoder(const Animation::Part& part, size_t depth,
+        size_t count, bool releaseMaps)
+    : Thread(false), mPart(part), mDepth(depth), mCount(count),
+      mReleaseMaps(releaseMaps), mBitmaps(new SkBitmap[depth]),
+      mDecoded(0), mConsumed(0)
+{
+}
+
+BootAnimation::FrameDecoder::~FrameDecoder()
+{
+    delete[] mBitmaps;
+}
+
+bool BootAnimation::FrameDecoder::threadLoop()
+{
+    size_t index;
+    {
+        Mutex::Autolock _l(mLock);
+        // wait for the slot of the oldest decoded frame to be drawn
+        while (!exitPending() && mDecoded - mConsumed >= mDepth) {
+            mCondition.wait(mLock);
+        }
+        if (exitPending() || mDecoded >= mCount) {
+            return false;
+        }
+        index = mDecoded;
+    }
+
+    const size_t fcount = mPart.frames.size();
+    if (index + 1 < mCount) {
+        // have the next frame paged in while this one decodes
+        FileMap* next = mPart.frames[(index + 1) % fcount].map;
+        next->advise(FileMap::WILLNEED);
+    }
+
+    SkBitmap* bitmap = &mBitmaps[index % mDepth];
+    bitmap->reset();
+    decodeFrame(mPart.frames[index % fcount], bitmap, mReleaseMaps);
+
+    Mutex::Autolock _l(mLock);
+    mDecoded++;
+    mCondition.broadcast();
+    return true;
+}
+
+SkBitmap* BootAnimation::FrameDecoder::acquire()
+{
+    Mutex::Autolock _l(mLock);
+    while (!exitPending() && mDecoded <= mConsumed) {
+        mCondition.wait(mLock);
+    }
+    return mDecoded > mConsumed ? &mBitmaps[mConsumed % mDepth] : NULL;
+}
+
+void BootAnimation::FrameDecoder::release()
+{
+    Mutex::Autolock _l(mLock);
+    mConsumed++;
+    mCondition.broadcast();
+}
+
+void BootAnimation::FrameDecoder::stop()
+{
+    requestExit();
+    {
+        Mutex::Autolock _l(mLock);
+        mCondition.broadcast();
+    }
+    requestExitAndWait();
+}
+
 status_t BootAnimation::readyToRun() {
     mAssets.addDefaultAssets();
 
@@ -474,6 +672,7 @@ bool BootAnimation::movie()
     }
 
     Animation animation;
+    animation.compressed = false;
 
     // Parse the description file
     for (;;) {
@@ -500,6 +699,7 @@ bool BootAnimation::movie()
             part.pause = pause;
             part.path = path;
             part.audioFile = NULL;
+            part.compressed = false;
             if (!parseColor(color, part.backgroundColor)) {
                 ALOGE("> invalid color '#%s'", color);
                 part.backgroundColor[0] = 0.0f;
@@ -508,10 +708,29 @@ bool BootAnimation::movie()
             }
             animation.parts.add(part);
         }
+        else if (strncmp(l, "compressed", 10) == 0) {
+            // frames may be shipped as .pkm or .astc files next to the pngs
+            animation.compressed = true;
+        }
 
         s = ++endl;
     }
 
+    // the compressed formats the GL can upload
+    SortedVector<GLint> compressedFormats;
+    if (animation.compressed) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+        if (count > 0) {
+            GLint* formats = new GLint[count];
+            glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats);
+            for (GLint i = 0; i < count; i++) {
+                compressedFormats.add(formats[i]);
+            }
+            delete[] formats;
+        }
+    }
+
     // read all the data structures
     const size_t pcount = animation.parts.size();
     void *cookie = NULL;
@@ -544,6 +763,19 @@ bool BootAnimation::movie()
                                 if (leaf == "audio.wav") {
                                     // a part may have at most one audio file
                                     part.audioFile = map;
+                                } else if (leaf.getPathExtension() == ".pkm"
+                                        || leaf.getPathExtension() == ".astc") {
+                                    Animation::Frame frame;
+                                    frame.name = leaf;
+                                    frame.map = map;
+                                    if (animation.compressed
+                                            && parseCompressedFrame(&frame, animation)
+                                            && compressedFormats.indexOf(frame.format) >= 0) {
+                                        part.compressedFrames.add(frame);
+                                    } else {
+                                        ALOGW("Ignoring compressed frame %s", name);
+                                        delete map;
+                                    }
                                 } else {
                                     Animation::Frame frame;
                                     frame.name = leaf;
@@ -560,6 +792,19 @@ bool BootAnimation::movie()
 
     mZip->endIteration(cookie);
 
+    // A part plays its compressed frames when it has some, its pngs otherwise.
+    for (size_t j = 0; j < pcount; j++) {
+        Animation::Part& part(animation.parts.editItemAt(j));
+        if (!part.compressedFrames.isEmpty()) {
+            for (size_t k = 0; k < part.frames.size(); k++) {
+                delete part.frames[k].map;
+            }
+            part.frames = part.compressedFrames;
+            part.compressedFrames.clear();
+            part.compressed = true;
+        }
+    }
+
     glShadeModel(GL_FLAT);
     glDisable(GL_DITHER);
     glDisable(GL_SCISSOR_TEST);
@@ -580,6 +825,15 @@ bool BootAnimation::movie()
     Region clearReg(Rect(mWidth, mHeight));
     clearReg.subtractSelf(Rect(xc, yc, xc+animation.width, yc+animation.height));
 
+    char decodeAhead[PROPERTY_VALUE_MAX];
+    property_get(DECODE_AHEAD_PROP_NAME, decodeAhead, "");
+    int depth = atoi(decodeAhead);
+    if (depth <= 0) {
+        depth = DEFAULT_DECODE_AHEAD;
+    } else if (depth > MAX_DECODE_AHEAD) {
+        depth = MAX_DECODE_AHEAD;
+    }
+
     for (size_t i=0 ; i<pcount ; i++) {
         const Animation::Part& part(animation.parts[i]);
         const size_t fcount = part.frames.size();
@@ -594,6 +848,24 @@ bool BootAnimation::movie()
 #endif
 #endif
 
+        // Frames are decoded for the first pass only, as later passes draw
+        // the textures kept from it, unless the texture cache is disabled.
+        size_t decodeCount = fcount;
+#ifdef BOARD_USES_TEXTURE_CACHE
+        if (useTextureCache) {
+            decodeCount = part.count ? fcount * part.count : SIZE_MAX;
+        }
+#endif
+        const bool releaseMaps = decodeCount == fcount;
+        sp<FrameDecoder> decoder;
+        if (fcount > 0 && !part.compressed) {
+            decoder = new FrameDecoder(part, depth, decodeCount, releaseMaps);
+            if (decoder->run("BootAnimationDecoder", PRIORITY_DISPLAY) != NO_ERROR) {
+                ALOGW("Unable to start the frame decoder, decoding inline");
+                decoder.clear();
+            }
+        }
+
         glBindTexture(GL_TEXTURE_2D, 0);
 
         for (int r=0 ; !part.count || r<part.count ; r++) {
@@ -628,7 +900,19 @@ bool BootAnimation::movie()
                         glTexParameterx(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
                         glTexParameterx(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
                     }
-                    initTexture(frame);
+                    if (part.compressed) {
+                        initCompressedTexture(frame, releaseMaps);
+                    } else if (decoder != NULL) {
+                        SkBitmap* bitmap = decoder->acquire();
+                        if (bitmap != NULL) {
+                            initTexture(bitmap);
+                        }
+                        decoder->release();
+                    } else {
+                        SkBitmap bitmap;
+                        decodeFrame(frame, &bitmap, releaseMaps);
+                        initTexture(&bitmap);
+                    }
                 }
 
                 if (!clearReg.isEmpty()) {
@@ -678,6 +962,11 @@ bool BootAnimation::movie()
                 break;
         }
 
+        if (decoder != NULL) {
+            decoder->stop();
+            decoder.clear();
+        }
+
         // free the textures for this part
         if (part.count != 1) {
             for (size_t j=0 ; j<fcount ; j++) {
@@ -21,6 +21,8 @@
 #include <sys/types.h>
 
 #include <androidfw/AssetManager.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
 #include <utils/Thread.h>
 
 #include <EGL/egl.h>
@@ -62,6 +64,14 @@ private:
             String8 name;
             FileMap* map;
             mutable GLuint tid;
+            // set for pre-compressed (.pkm/.astc) frames, see parseCompressedFrame()
+            GLenum format;
+            GLsizei width;
+            GLsizei height;
+            GLint cropWidth;
+            GLint cropHeight;
+            size_t dataOffset;
+            GLsizei dataSize;
             bool operator < (const Frame& rhs) const {
                 return name < rhs.name;
             }
@@ -71,6 +81,8 @@ private:
             int pause;
             String8 path;
             SortedVector<Frame> frames;
+            SortedVector<Frame> compressedFrames;
+            bool compressed;
             bool playUntilComplete;
             float backgroundColor[3];
             FileMap* audioFile;
@@ -78,11 +90,43 @@ private:
         int fps;
         int width;
         int height;
+        bool compressed;
         Vector<Part> parts;
     };
 
+    // Decodes the frames of a part on its own thread, up to depth frames
+    // ahead of the one being drawn, so that PNG decoding overlaps with the
+    // display time of the previous frames. Frames are decoded in play
+    // order, count frames in total, wrapping around the part.
+    class FrameDecoder : public Thread {
+    public:
+        FrameDecoder(const Animation::Part& part, size_t depth, size_t count,
+                bool releaseMaps);
+        virtual ~FrameDecoder();
+        // blocks until the next frame in play order is decoded
+        SkBitmap* acquire();
+        void release();
+        void stop();
+
+    private:
+        virtual bool threadLoop();
+
+        const Animation::Part& mPart;
+        const size_t mDepth;
+        const size_t mCount;
+        const bool mReleaseMaps;
+        SkBitmap* mBitmaps;
+        Mutex mLock;
+        Condition mCondition;
+        size_t mDecoded;
+        size_t mConsumed;
+    };
+
     status_t initTexture(Texture* texture, AssetManager& asset, const char* name);
-    status_t initTexture(const Animation::Frame& frame);
+    static void decodeFrame(const Animation::Frame& frame, SkBitmap* bitmap, bool releaseMap);
+    status_t initTexture(SkBitmap* bitmap);
+    static bool parseCompressedFrame(Animation::Frame* frame, const Animation& animation);
+    status_t initCompressedTexture(const Animation::Frame& frame, bool releaseMap);
     bool android();
     bool readFile(const char* name, String8& outString);
     bool movie();
@@ -72,7 +72,8 @@ fail:
         return 0;
     }
 
-    bool is_idmap_stale_fd(const char *target_apk_path, const char *overlay_apk_path, int idmap_fd)
+    bool is_idmap_stale_fd(const char *target_apk_path, uint32_t actual_target_crc,
+            const char *overlay_apk_path, int idmap_fd)
     {
         static const size_t N = ResTable::IDMAP_HEADER_SIZE_BYTES;
         struct stat st;
@@ -118,11 +119,7 @@ fail:
             return true;
         }
 
-        uint32_t actual_target_crc, actual_overlay_crc;
-        if (get_zip_entry_crc(target_apk_path, AssetManager::RESOURCES_FILENAME,
-				&actual_target_crc) == -1) {
-            return true;
-        }
+        uint32_t actual_overlay_crc;
         if (get_zip_entry_crc(overlay_apk_path, AssetManager::RESOURCES_FILENAME,
 				&actual_overlay_crc) == -1) {
             return true;
@@ -131,8 +128,8 @@ fail:
         return cached_target_crc != actual_target_crc || cached_overlay_crc != actual_overlay_crc;
     }
 
-    bool is_idmap_stale_path(const char *target_apk_path, const char *overlay_apk_path,
-            const char *idmap_path)
+    bool is_idmap_stale_path(const char *target_apk_path, uint32_t target_crc,
+            const char *overlay_apk_path, const char *idmap_path)
     {
         struct stat st;
         if (stat(idmap_path, &st) == -1) {
@@ -144,35 +141,36 @@ fail:
         if (idmap_fd == -1) {
             return false;
         }
-        bool is_stale = is_idmap_stale_fd(target_apk_path, overlay_apk_path, idmap_fd);
+        bool is_stale = is_idmap_stale_fd(target_apk_path, target_crc, overlay_apk_path,
+                idmap_fd);
         close(idmap_fd);
         return is_stale;
     }
 
-    int create_idmap(const char *target_apk_path, const char *overlay_apk_path,
-            uint32_t **data, size_t *size)
+    // target_table may be NULL, the target resources are then loaded for this idmap only
+    int create_idmap(const ResTable *target_table, const char *target_apk_path,
+            uint32_t target_crc, const char *overlay_apk_path, uint32_t **data, size_t *size)
     {
-        uint32_t target_crc, overlay_crc;
-        if (get_zip_entry_crc(target_apk_path, AssetManager::RESOURCES_FILENAME,
-				&target_crc) == -1) {
-            return -1;
-        }
+        uint32_t overlay_crc;
         if (get_zip_entry_crc(overlay_apk_path, AssetManager::RESOURCES_FILENAME,
 				&overlay_crc) == -1) {
             return -1;
         }
 
         AssetManager am;
-        bool b = am.createIdmap(target_apk_path, overlay_apk_path, target_crc, overlay_crc,
-                data, size);
+        bool b = target_table != NULL ?
+                am.createIdmap(*target_table, target_apk_path, overlay_apk_path, target_crc,
+                        overlay_crc, data, size) :
+                am.createIdmap(target_apk_path, overlay_apk_path, target_crc, overlay_crc,
+                        data, size);
         return b ? 0 : -1;
     }
 
-    int create_and_write_idmap(const char *target_apk_path, const char *overlay_apk_path,
-            int fd, bool check_if_stale)
+    int create_and_write_idmap(const ResTable *target_table, const char *target_apk_path,
+            uint32_t target_crc, const char *overlay_apk_path, int fd, bool check_if_stale)
     {
         if (check_if_stale) {
-            if (!is_idmap_stale_fd(target_apk_path, overlay_apk_path, fd)) {
+            if (!is_idmap_stale_fd(target_apk_path, target_crc, overlay_apk_path, fd)) {
                 // already up to date -- nothing to do
                 return 0;
             }
@@ -181,7 +179,8 @@ fail:
         uint32_t *data = NULL;
         size_t size;
 
-        if (create_idmap(target_apk_path, overlay_apk_path, &data, &size) == -1) {
+        if (create_idmap(target_table, target_apk_path, target_crc, overlay_apk_path,
+                    &data, &size) == -1) {
             return -1;
         }
 
@@ -198,7 +197,19 @@ fail:
 int idmap_create_path(const char *target_apk_path, const char *overlay_apk_path,
         const char *idmap_path)
 {
-    if (!is_idmap_stale_path(target_apk_path, overlay_apk_path, idmap_path)) {
+    uint32_t target_crc;
+    if (get_zip_entry_crc(target_apk_path, AssetManager::RESOURCES_FILENAME,
+                &target_crc) == -1) {
+        return EXIT_FAILURE;
+    }
+    return idmap_create_path_for_target(NULL, target_apk_path, target_crc, overlay_apk_path,
+            idmap_path);
+}
+
+int idmap_create_path_for_target(const ResTable *target_table, const char *target_apk_path,
+        uint32_t target_crc, const char *overlay_apk_path, const char *idmap_path)
+{
+    if (!is_idmap_stale_path(target_apk_path, target_crc, overlay_apk_path, idmap_path)) {
         // already up to date -- nothing to do
         return EXIT_SUCCESS;
     }
@@ -208,7 +219,8 @@ int idmap_create_path(const char *target_apk_path, const char *overlay_apk_path,
         return EXIT_FAILURE;
     }
 
-    int r = create_and_write_idmap(target_apk_path, overlay_apk_path, fd, false);
+    int r = create_and_write_idmap(target_table, target_apk_path, target_crc, overlay_apk_path,
+            fd, false);
     close(fd);
     if (r != 0) {
         unlink(idmap_path);
@@ -218,6 +230,11 @@ int idmap_create_path(const char *target_apk_path, const char *overlay_apk_path,
 
 int idmap_create_fd(const char *target_apk_path, const char *overlay_apk_path, int fd)
 {
-    return create_and_write_idmap(target_apk_path, overlay_apk_path, fd, true) == 0 ?
-        EXIT_SUCCESS : EXIT_FAILURE;
+    uint32_t target_crc;
+    if (get_zip_entry_crc(target_apk_path, AssetManager::RESOURCES_FILENAME,
+                &target_crc) == -1) {
+        return EXIT_FAILURE;
+    }
+    return create_and_write_idmap(NULL, target_apk_path, target_crc, overlay_apk_path, fd,
+            true) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
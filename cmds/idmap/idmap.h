@@ -6,6 +6,7 @@
 #include <utils/Log.h>
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #ifndef TEMP_FAILURE_RETRY
@@ -21,6 +22,17 @@
 int idmap_create_path(const char *target_apk_path, const char *overlay_apk_path,
         const char *idmap_path);
 
+namespace android {
+    class ResTable;
+}
+
+// Same as idmap_create_path, against the resources of the target already loaded
+// in target_table, which is only read and can be shared between threads. If
+// target_table is NULL they're loaded for this idmap only.
+int idmap_create_path_for_target(const android::ResTable *target_table,
+        const char *target_apk_path, uint32_t target_crc, const char *overlay_apk_path,
+        const char *idmap_path);
+
 int idmap_create_fd(const char *target_apk_path, const char *overlay_apk_path, int fd);
 
 // Regarding target_package_name: the idmap_scan implementation should
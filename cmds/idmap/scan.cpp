@@ -1,10 +1,13 @@
 #include <dirent.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "idmap.h"
 
 #include <UniquePtr.h>
+#include <androidfw/AssetManager.h>
 #include <androidfw/ResourceTypes.h>
 #include <androidfw/StreamingZipInflater.h>
 #include <androidfw/ZipFileRO.h>
@@ -12,9 +15,14 @@
 #include <utils/SortedVector.h>
 #include <utils/String16.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 
 #define NO_OVERLAY_TAG (-1000)
 
+// Most of the scan is spent inflating manifests and creating idmaps, which
+// is I/O and CPU bound in about equal parts
+#define MAX_SCAN_THREADS 4
+
 using namespace android;
 
 namespace {
@@ -165,6 +173,90 @@ namespace {
         delete dataMap;
         return priority;
     }
+
+    bool get_resources_crc(const char *apk_path, uint32_t *crc)
+    {
+        UniquePtr<ZipFileRO> zip(ZipFileRO::open(apk_path));
+        if (zip.get() == NULL) {
+            return false;
+        }
+        ZipEntryRO entry = zip->findEntryByName(AssetManager::RESOURCES_FILENAME);
+        if (entry == NULL) {
+            return false;
+        }
+        bool found = zip->getEntryInfo(entry, NULL, NULL, NULL, NULL, NULL, crc);
+        zip->releaseEntry(entry);
+        return found;
+    }
+
+    struct ScanJob {
+        String8 apk_path;
+        String8 idmap_path;
+        int priority;
+    };
+
+    struct ScanState {
+        const char *target_package_name;
+        const char *target_apk_path;
+        // Loaded once, only read by the workers
+        const ResTable *target_table;
+        uint32_t target_crc;
+        ScanJob *jobs;
+        size_t job_count;
+        size_t next_job;
+    };
+
+    // Parses the overlays and (re)creates their stale idmaps, taking the jobs
+    // in turn with the other workers. Failed jobs are left with a negative
+    // priority.
+    void *scan_worker(void *arg)
+    {
+        ScanState *state = static_cast<ScanState *>(arg);
+        for (;;) {
+            const size_t i = __atomic_fetch_add(&state->next_job, 1, __ATOMIC_RELAXED);
+            if (i >= state->job_count) {
+                return NULL;
+            }
+            ScanJob& job = state->jobs[i];
+            job.priority = parse_apk(job.apk_path.string(), state->target_package_name);
+            if (job.priority < 0) {
+                continue;
+            }
+
+            if (idmap_create_path_for_target(state->target_table, state->target_apk_path,
+                        state->target_crc, job.apk_path.string(),
+                        job.idmap_path.string()) != 0) {
+                ALOGE("error: failed to create idmap for target=%s overlay=%s idmap=%s\n",
+                        state->target_apk_path, job.apk_path.string(), job.idmap_path.string());
+                job.priority = -1;
+            }
+        }
+    }
+
+    void run_scan_jobs(ScanState *state)
+    {
+        long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+        if (thread_count > MAX_SCAN_THREADS) {
+            thread_count = MAX_SCAN_THREADS;
+        }
+        if (thread_count > static_cast<long>(state->job_count)) {
+            thread_count = state->job_count;
+        }
+
+        // The calling thread is a worker too
+        pthread_t threads[MAX_SCAN_THREADS];
+        long started = 0;
+        for (long i = 1; i < thread_count; ++i) {
+            if (pthread_create(&threads[started], NULL, scan_worker, state) != 0) {
+                break;
+            }
+            started++;
+        }
+        scan_worker(state);
+        for (long i = 0; i < started; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+    }
 }
 
 int idmap_scan(const char *overlay_dir, const char *target_package_name,
@@ -181,7 +273,7 @@ int idmap_scan(const char *overlay_dir, const char *target_package_name,
         return EXIT_FAILURE;
     }
 
-    SortedVector<Overlay> overlayVector;
+    Vector<ScanJob> jobs;
     struct dirent *dirent;
     while ((dirent = readdir(dir)) != NULL) {
         struct stat st;
@@ -194,30 +286,53 @@ int idmap_scan(const char *overlay_dir, const char *target_package_name,
             continue;
         }
 
-        int priority = parse_apk(overlay_apk_path, target_package_name);
-        if (priority < 0) {
-            continue;
-        }
+        ScanJob job;
+        job.apk_path = String8(overlay_apk_path);
+        job.idmap_path = String8(idmap_dir);
+        job.idmap_path.appendPath(flatten_path(overlay_apk_path + 1));
+        job.idmap_path.append("@idmap");
+        job.priority = -1;
+        jobs.add(job);
+    }
 
-        String8 idmap_path(idmap_dir);
-        idmap_path.appendPath(flatten_path(overlay_apk_path + 1));
-        idmap_path.append("@idmap");
+    closedir(dir);
 
-        if (idmap_create_path(target_apk_path, overlay_apk_path, idmap_path.string()) != 0) {
-            ALOGE("error: failed to create idmap for target=%s overlay=%s idmap=%s\n",
-                    target_apk_path, overlay_apk_path, idmap_path.string());
-            continue;
-        }
+    // Without the target no idmap can be created, but overlays.list is still
+    // written before failing, replacing the one removed above.
+    bool target_failed = false;
+    AssetManager am;
+    ResTable target_table;
+    uint32_t target_crc;
+    if (!jobs.isEmpty() && (!get_resources_crc(target_apk_path, &target_crc)
+            || !am.loadResTable(target_apk_path, &target_table))) {
+        ALOGE("error: failed to load the resources of target=%s\n", target_apk_path);
+        target_failed = true;
+    }
 
-        Overlay overlay(String8(overlay_apk_path), idmap_path, priority);
-        overlayVector.add(overlay);
+    if (!jobs.isEmpty() && !target_failed) {
+        ScanState state;
+        state.target_package_name = target_package_name;
+        state.target_apk_path = target_apk_path;
+        state.target_table = &target_table;
+        state.target_crc = target_crc;
+        // Not shared, the workers can edit the jobs in place
+        state.jobs = jobs.editArray();
+        state.job_count = jobs.size();
+        state.next_job = 0;
+        run_scan_jobs(&state);
     }
 
-    closedir(dir);
+    SortedVector<Overlay> overlayVector;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const ScanJob& job = jobs[i];
+        if (job.priority >= 0) {
+            overlayVector.add(Overlay(job.apk_path, job.idmap_path, job.priority));
+        }
+    }
 
     if (!writePackagesList(filename.string(), overlayVector)) {
         return EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    return target_failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
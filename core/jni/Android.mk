@@ -102,6 +102,7 @@ LOCAL_SRC_FILES:= \
     android/graphics/BitmapFactory.cpp \
     android/graphics/Camera.cpp \
     android/graphics/CanvasProperty.cpp \
+    android/graphics/CmapCache.cpp \
     android/graphics/ColorFilter.cpp \
     android/graphics/DrawFilter.cpp \
     android/graphics/FontFamily.cpp \
@@ -30,6 +30,9 @@
 #include <SkGraphics.h>
 #include <SkImageDecoder.h>
 
+#include <EGL/egl.h>
+#include <ScopedUtfChars.h>
+
 #include "jni.h"
 #include "JNIHelp.h"
 #include "JniInvocation.h"
@@ -41,6 +44,8 @@
 #include <sys/types.h>
 #include <signal.h>
 #include <dirent.h>
+#include <dlfcn.h>
+#include <pthread.h>
 #include <assert.h>
 
 #include <string>
@@ -213,6 +218,121 @@ static void com_android_internal_os_RuntimeInit_nativeSetExitWithoutCleanup(JNIE
     gCurRuntime->setExitWithoutCleanup(exitWithoutCleanup);
 }
 
+/*
+ * Preload profiling. The zygote brackets each preload phase (classes,
+ * resources, fonts, ...) so their cost shows up in the log,
+ * and can hand work that doesn't need the VM to a background thread.
+ */
+struct PreloadPhase {
+    std::string name;
+    nsecs_t duration;
+};
+
+static std::vector<PreloadPhase> gPreloadPhases;
+static std::string gCurrentPreloadPhase;
+static nsecs_t gCurrentPreloadPhaseStart = 0;
+
+struct BackgroundPreload {
+    bool graphicsDriver;
+    std::vector<std::string> sharedLibraries;
+    nsecs_t duration;
+};
+
+static BackgroundPreload* gBackgroundPreload = NULL;
+static pthread_t gBackgroundPreloadThread;
+
+static void* backgroundPreload(void* arg)
+{
+    BackgroundPreload* preload = static_cast<BackgroundPreload*>(arg);
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (preload->graphicsDriver) {
+        // Loads the vendor EGL/GLES libraries, which are then shared by every app
+        eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    for (size_t i = 0; i < preload->sharedLibraries.size(); i++) {
+        // Intentionally never closed; System.loadLibrary() finds them mapped
+        if (!dlopen(preload->sharedLibraries[i].c_str(), RTLD_NOW)) {
+            ALOGW("Failed to preload %s: %s", preload->sharedLibraries[i].c_str(), dlerror());
+        }
+    }
+    preload->duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    return NULL;
+}
+
+static void com_android_internal_os_RuntimeInit_nativeBeginPreloadPhase(JNIEnv* env,
+        jobject clazz, jstring name)
+{
+    ScopedUtfChars nameChars(env, name);
+    if (nameChars.c_str() == NULL) return;
+    gCurrentPreloadPhase = nameChars.c_str();
+    gCurrentPreloadPhaseStart = systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+static void com_android_internal_os_RuntimeInit_nativeEndPreloadPhase(JNIEnv* env,
+        jobject clazz)
+{
+    if (gCurrentPreloadPhase.empty()) return;
+    PreloadPhase phase;
+    phase.name = gCurrentPreloadPhase;
+    phase.duration = systemTime(SYSTEM_TIME_MONOTONIC) - gCurrentPreloadPhaseStart;
+    gPreloadPhases.push_back(phase);
+    ALOGI("Preload phase %s took %.1fms", phase.name.c_str(), ns2us(phase.duration) / 1000.0f);
+    gCurrentPreloadPhase.clear();
+}
+
+static void com_android_internal_os_RuntimeInit_nativeStartBackgroundPreload(JNIEnv* env,
+        jobject clazz, jboolean graphicsDriver, jobjectArray sharedLibraries)
+{
+    if (gBackgroundPreload != NULL) {
+        ALOGW("Background preload already started");
+        return;
+    }
+    BackgroundPreload* preload = new BackgroundPreload();
+    preload->graphicsDriver = graphicsDriver;
+    preload->duration = 0;
+    jsize count = sharedLibraries != NULL ? env->GetArrayLength(sharedLibraries) : 0;
+    for (jsize i = 0; i < count; i++) {
+        jstring library = (jstring) env->GetObjectArrayElement(sharedLibraries, i);
+        ScopedUtfChars libraryChars(env, library);
+        if (libraryChars.c_str() != NULL) {
+            preload->sharedLibraries.push_back(libraryChars.c_str());
+        }
+        env->DeleteLocalRef(library);
+    }
+
+    if (pthread_create(&gBackgroundPreloadThread, NULL, backgroundPreload, preload) != 0) {
+        // Do the work inline rather than lose it
+        ALOGW("Failed to start background preload thread");
+        backgroundPreload(preload);
+        delete preload;
+        return;
+    }
+    gBackgroundPreload = preload;
+}
+
+/*
+ * Joins the background preload thread. The zygote must call this before it
+ * forks for the first time since children can't inherit a running thread.
+ */
+static void com_android_internal_os_RuntimeInit_nativeFinishPreload(JNIEnv* env,
+        jobject clazz)
+{
+    nsecs_t total = 0;
+    for (size_t i = 0; i < gPreloadPhases.size(); i++) {
+        total += gPreloadPhases[i].duration;
+    }
+    if (gBackgroundPreload != NULL) {
+        pthread_join(gBackgroundPreloadThread, NULL);
+        ALOGI("Background preload took %.1fms",
+                ns2us(gBackgroundPreload->duration) / 1000.0f);
+        delete gBackgroundPreload;
+        gBackgroundPreload = NULL;
+    }
+    ALOGI("Preloading took %.1fms over %zu phases", ns2us(total) / 1000.0f,
+            gPreloadPhases.size());
+    gPreloadPhases.clear();
+}
+
 /*
  * JNI registration.
  */
@@ -225,8 +345,22 @@ static JNINativeMethod gMethods[] = {
         (void*) com_android_internal_os_RuntimeInit_nativeSetExitWithoutCleanup },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "nativeBeginPreloadPhase", "(Ljava/lang/String;)V",
+        (void*) com_android_internal_os_RuntimeInit_nativeBeginPreloadPhase },
+    { "nativeEndPreloadPhase", "()V",
+        (void*) com_android_internal_os_RuntimeInit_nativeEndPreloadPhase },
+    { "nativeStartBackgroundPreload", "(Z[Ljava/lang/String;)V",
+        (void*) com_android_internal_os_RuntimeInit_nativeStartBackgroundPreload },
+    { "nativeFinishPreload", "()V",
+        (void*) com_android_internal_os_RuntimeInit_nativeFinishPreload },
+};
+
 int register_com_android_internal_os_RuntimeInit(JNIEnv* env)
 {
+    AndroidRuntime::registerOptionalNativeMethods(env, "com/android/internal/os/RuntimeInit",
+        gOptionalMethods, NELEM(gOptionalMethods));
     return jniRegisterNativeMethods(env, "com/android/internal/os/RuntimeInit",
         gMethods, NELEM(gMethods));
 }
@@ -265,6 +399,34 @@ AndroidRuntime::~AndroidRuntime()
     return jniRegisterNativeMethods(env, className, gMethods, numMethods);
 }
 
+/*
+ * Register native methods one at a time, so a method missing from the class
+ * doesn't abort the runtime like it does for registerNativeMethods.
+ */
+/*static*/ int AndroidRuntime::registerOptionalNativeMethods(JNIEnv* env,
+    const char* className, const JNINativeMethod* gMethods, int numMethods)
+{
+    jclass clazz = env->FindClass(className);
+    if (clazz == NULL) {
+        env->ExceptionClear();
+        ALOGW("Unable to find class %s, not registering its native methods", className);
+        return 0;
+    }
+
+    int registered = 0;
+    for (int i = 0; i < numMethods; i++) {
+        if (env->RegisterNatives(clazz, &gMethods[i], 1) == JNI_OK) {
+            registered++;
+        } else {
+            env->ExceptionClear();
+            ALOGV("%s.%s%s isn't declared, not registering it", className,
+                    gMethods[i].name, gMethods[i].signature);
+        }
+    }
+    env->DeleteLocalRef(clazz);
+    return registered;
+}
+
 void AndroidRuntime::setArgv0(const char* argv0) {
     memset(mArgBlockStart, 0, mArgBlockLength);
     strlcpy(mArgBlockStart, argv0, mArgBlockLength);
@@ -1280,16 +1442,31 @@ static void quickTest(void* arg)
 
 typedef void (*RegJAMProc)();
 
+// Registration entries taking longer than this are logged
+#define SLOW_JNI_REGISTRATION_NS ms2ns(2)
+
 static int register_jni_procs(const RegJNIRec array[], size_t count, JNIEnv* env)
 {
+    nsecs_t total = 0;
     for (size_t i = 0; i < count; i++) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
         if (array[i].mProc(env) < 0) {
 #ifndef NDEBUG
             ALOGD("----------!!! %s failed to load\n", array[i].mName);
 #endif
             return -1;
         }
+        nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+        if (duration > SLOW_JNI_REGISTRATION_NS) {
+#ifndef NDEBUG
+            ALOGI("Registering %s took %.1fms", array[i].mName, ns2us(duration) / 1000.0f);
+#else
+            ALOGI("Registering entry %zu took %.1fms", i, ns2us(duration) / 1000.0f);
+#endif
+        }
+        total += duration;
     }
+    ALOGV("Registered %zu native entries in %.1fms", count, ns2us(total) / 1000.0f);
     return 0;
 }
 
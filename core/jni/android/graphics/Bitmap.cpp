@@ -9,7 +9,6 @@
 #include "SkColorPriv.h"
 #include "GraphicsJNI.h"
 #include "SkDither.h"
-#include "SkUnPreMultiply.h"
 #include "SkStream.h"
 
 #include <binder/Parcel.h>
@@ -18,12 +17,16 @@
 #include "android_nio_utils.h"
 #include "CreateJavaOutputStreamAdaptor.h"
 #include <Caches.h>
+#include <utils/PixelConvert.h>
 
 #include "core_jni_helpers.h"
 
 #include <jni.h>
+#include <atomic>
 #include <memory>
+#include <pthread.h>
 #include <string>
+#include <unistd.h>
 #include <sys/mman.h>
 #include <cutils/ashmem.h>
 
@@ -375,6 +378,7 @@ void Bitmap::assertValid() const {
 } // namespace android
 
 using namespace android;
+using android::uirenderer::PixelConvert;
 
 // Convenience class that does not take a global ref on the pixels, relying
 // on the caller already having a local JNI ref
@@ -406,33 +410,18 @@ private:
 typedef void (*FromColorProc)(void* dst, const SkColor src[], int width,
                               int x, int y);
 
+// Rows are converted through this many pixels of scratch at a time when the
+// destination isn't a format PixelConvert writes directly
+static const int kConvertChunkSize = 64;
+
 static void FromColor_D32(void* dst, const SkColor src[], int width,
                           int, int) {
-    SkPMColor* d = (SkPMColor*)dst;
-
-    for (int i = 0; i < width; i++) {
-        *d++ = SkPreMultiplyColor(*src++);
-    }
+    PixelConvert::premultiply((SkPMColor*)dst, src, width);
 }
 
 static void FromColor_D32_Raw(void* dst, const SkColor src[], int width,
                           int, int) {
-    // Needed to thwart the unreachable code detection from clang.
-    static const bool sk_color_ne_zero = SK_COLOR_MATCHES_PMCOLOR_BYTE_ORDER;
-
-    // SkColor's ordering may be different from SkPMColor
-    if (sk_color_ne_zero) {
-        memcpy(dst, src, width * sizeof(SkColor));
-        return;
-    }
-
-    // order isn't same, repack each pixel manually
-    SkPMColor* d = (SkPMColor*)dst;
-    for (int i = 0; i < width; i++) {
-        SkColor c = *src++;
-        *d++ = SkPackARGB32NoCheck(SkColorGetA(c), SkColorGetR(c),
-                                   SkColorGetG(c), SkColorGetB(c));
-    }
+    PixelConvert::colorToPMColor((SkPMColor*)dst, src, width);
 }
 
 static void FromColor_D565(void* dst, const SkColor src[], int width,
@@ -450,37 +439,42 @@ static void FromColor_D565(void* dst, const SkColor src[], int width,
 static void FromColor_D4444(void* dst, const SkColor src[], int width,
                             int x, int y) {
     SkPMColor16* d = (SkPMColor16*)dst;
+    SkPMColor pmc[kConvertChunkSize];
 
     DITHER_4444_SCAN(y);
-    for (int stop = x + width; x < stop; x++) {
-        SkPMColor pmc = SkPreMultiplyColor(*src++);
-        *d++ = SkDitherARGB32To4444(pmc, DITHER_VALUE(x));
-//        *d++ = SkPixel32ToPixel4444(pmc);
+    while (width > 0) {
+        const int count = SkMin32(width, kConvertChunkSize);
+        PixelConvert::premultiply(pmc, src, count);
+        for (int i = 0; i < count; i++, x++) {
+            *d++ = SkDitherARGB32To4444(pmc[i], DITHER_VALUE(x));
+//            *d++ = SkPixel32ToPixel4444(pmc[i]);
+        }
+        src += count;
+        width -= count;
     }
 }
 
 static void FromColor_D4444_Raw(void* dst, const SkColor src[], int width,
                             int x, int y) {
     SkPMColor16* d = (SkPMColor16*)dst;
+    // SkPMColor is used because the ordering is ARGB32, even though the target actually premultiplied
+    SkPMColor pmc[kConvertChunkSize];
 
     DITHER_4444_SCAN(y);
-    for (int stop = x + width; x < stop; x++) {
-        SkColor c = *src++;
-
-        // SkPMColor is used because the ordering is ARGB32, even though the target actually premultiplied
-        SkPMColor pmc = SkPackARGB32NoCheck(SkColorGetA(c), SkColorGetR(c),
-                                            SkColorGetG(c), SkColorGetB(c));
-        *d++ = SkDitherARGB32To4444(pmc, DITHER_VALUE(x));
-//        *d++ = SkPixel32ToPixel4444(pmc);
+    while (width > 0) {
+        const int count = SkMin32(width, kConvertChunkSize);
+        PixelConvert::colorToPMColor(pmc, src, count);
+        for (int i = 0; i < count; i++, x++) {
+            *d++ = SkDitherARGB32To4444(pmc[i], DITHER_VALUE(x));
+//            *d++ = SkPixel32ToPixel4444(pmc[i]);
+        }
+        src += count;
+        width -= count;
     }
 }
 
 static void FromColor_DA8(void* dst, const SkColor src[], int width, int x, int y) {
-    uint8_t* d = (uint8_t*)dst;
-
-    for (int stop = x + width; x < stop; x++) {
-        *d++ = SkColorGetA(*src++);
-    }
+    PixelConvert::colorToAlpha8((uint8_t*)dst, src, width);
 }
 
 // can return NULL
@@ -538,117 +532,96 @@ typedef void (*ToColorProc)(SkColor dst[], const void* src, int width,
 static void ToColor_S32_Alpha(SkColor dst[], const void* src, int width,
                               SkColorTable*) {
     SkASSERT(width > 0);
-    const SkPMColor* s = (const SkPMColor*)src;
-    do {
-        *dst++ = SkUnPreMultiply::PMColorToColor(*s++);
-    } while (--width != 0);
+    PixelConvert::unpremultiply(dst, (const SkPMColor*)src, width);
 }
 
 static void ToColor_S32_Raw(SkColor dst[], const void* src, int width,
                               SkColorTable*) {
     SkASSERT(width > 0);
-    const SkPMColor* s = (const SkPMColor*)src;
-    do {
-        SkPMColor c = *s++;
-        *dst++ = SkColorSetARGB(SkGetPackedA32(c), SkGetPackedR32(c),
-                                SkGetPackedG32(c), SkGetPackedB32(c));
-    } while (--width != 0);
+    PixelConvert::pmColorToColor(dst, (const SkPMColor*)src, width);
 }
 
 static void ToColor_S32_Opaque(SkColor dst[], const void* src, int width,
                                SkColorTable*) {
     SkASSERT(width > 0);
-    const SkPMColor* s = (const SkPMColor*)src;
-    do {
-        SkPMColor c = *s++;
-        *dst++ = SkColorSetRGB(SkGetPackedR32(c), SkGetPackedG32(c),
-                               SkGetPackedB32(c));
-    } while (--width != 0);
+    PixelConvert::pmColorToOpaqueColor(dst, (const SkPMColor*)src, width);
 }
 
-static void ToColor_S4444_Alpha(SkColor dst[], const void* src, int width,
-                                SkColorTable*) {
+typedef void (*PMColorRowProc)(SkColor dst[], const SkPMColor src[], int width);
+
+// Expands 4444 pixels into 8888 a chunk at a time and converts those
+static void ToColor_S4444(SkColor dst[], const void* src, int width, PMColorRowProc proc) {
     SkASSERT(width > 0);
     const SkPMColor16* s = (const SkPMColor16*)src;
+    SkPMColor pmc[kConvertChunkSize];
     do {
-        *dst++ = SkUnPreMultiply::PMColorToColor(SkPixel4444ToPixel32(*s++));
-    } while (--width != 0);
+        const int count = SkMin32(width, kConvertChunkSize);
+        for (int i = 0; i < count; i++) {
+            pmc[i] = SkPixel4444ToPixel32(*s++);
+        }
+        proc(dst, pmc, count);
+        dst += count;
+        width -= count;
+    } while (width != 0);
+}
+
+static void ToColor_S4444_Alpha(SkColor dst[], const void* src, int width,
+                                SkColorTable*) {
+    ToColor_S4444(dst, src, width, PixelConvert::unpremultiply);
 }
 
 static void ToColor_S4444_Raw(SkColor dst[], const void* src, int width,
                                 SkColorTable*) {
-    SkASSERT(width > 0);
-    const SkPMColor16* s = (const SkPMColor16*)src;
-    do {
-        SkPMColor c = SkPixel4444ToPixel32(*s++);
-        *dst++ = SkColorSetARGB(SkGetPackedA32(c), SkGetPackedR32(c),
-                                SkGetPackedG32(c), SkGetPackedB32(c));
-    } while (--width != 0);
+    ToColor_S4444(dst, src, width, PixelConvert::pmColorToColor);
 }
 
 static void ToColor_S4444_Opaque(SkColor dst[], const void* src, int width,
                                  SkColorTable*) {
-    SkASSERT(width > 0);
-    const SkPMColor16* s = (const SkPMColor16*)src;
-    do {
-        SkPMColor c = SkPixel4444ToPixel32(*s++);
-        *dst++ = SkColorSetRGB(SkGetPackedR32(c), SkGetPackedG32(c),
-                               SkGetPackedB32(c));
-    } while (--width != 0);
+    ToColor_S4444(dst, src, width, PixelConvert::pmColorToOpaqueColor);
 }
 
 static void ToColor_S565(SkColor dst[], const void* src, int width,
                          SkColorTable*) {
     SkASSERT(width > 0);
-    const uint16_t* s = (const uint16_t*)src;
-    do {
-        uint16_t c = *s++;
-        *dst++ =  SkColorSetRGB(SkPacked16ToR32(c), SkPacked16ToG32(c),
-                                SkPacked16ToB32(c));
-    } while (--width != 0);
+    PixelConvert::rgb565ToColor(dst, (const uint16_t*)src, width);
 }
 
-static void ToColor_SI8_Alpha(SkColor dst[], const void* src, int width,
-                              SkColorTable* ctable) {
+// Looks the indices up a chunk at a time and converts the colors found
+static void ToColor_SI8(SkColor dst[], const void* src, int width, SkColorTable* ctable,
+                        PMColorRowProc proc) {
     SkASSERT(width > 0);
     const uint8_t* s = (const uint8_t*)src;
     const SkPMColor* colors = ctable->readColors();
+    SkPMColor pmc[kConvertChunkSize];
     do {
-        *dst++ = SkUnPreMultiply::PMColorToColor(colors[*s++]);
-    } while (--width != 0);
+        const int count = SkMin32(width, kConvertChunkSize);
+        for (int i = 0; i < count; i++) {
+            pmc[i] = colors[*s++];
+        }
+        proc(dst, pmc, count);
+        dst += count;
+        width -= count;
+    } while (width != 0);
+}
+
+static void ToColor_SI8_Alpha(SkColor dst[], const void* src, int width,
+                              SkColorTable* ctable) {
+    ToColor_SI8(dst, src, width, ctable, PixelConvert::unpremultiply);
 }
 
 static void ToColor_SI8_Raw(SkColor dst[], const void* src, int width,
                               SkColorTable* ctable) {
-    SkASSERT(width > 0);
-    const uint8_t* s = (const uint8_t*)src;
-    const SkPMColor* colors = ctable->readColors();
-    do {
-        SkPMColor c = colors[*s++];
-        *dst++ = SkColorSetARGB(SkGetPackedA32(c), SkGetPackedR32(c),
-                                SkGetPackedG32(c), SkGetPackedB32(c));
-    } while (--width != 0);
+    ToColor_SI8(dst, src, width, ctable, PixelConvert::pmColorToColor);
 }
 
 static void ToColor_SI8_Opaque(SkColor dst[], const void* src, int width,
                                SkColorTable* ctable) {
-    SkASSERT(width > 0);
-    const uint8_t* s = (const uint8_t*)src;
-    const SkPMColor* colors = ctable->readColors();
-    do {
-        SkPMColor c = colors[*s++];
-        *dst++ = SkColorSetRGB(SkGetPackedR32(c), SkGetPackedG32(c),
-                               SkGetPackedB32(c));
-    } while (--width != 0);
+    ToColor_SI8(dst, src, width, ctable, PixelConvert::pmColorToOpaqueColor);
 }
 
 static void ToColor_SA8(SkColor dst[], const void* src, int width, SkColorTable*) {
     SkASSERT(width > 0);
-    const uint8_t* s = (const uint8_t*)src;
-    do {
-        uint8_t c = *s++;
-        *dst++ = SkColorSetARGB(c, c, c, c);
-    } while (--width != 0);
+    PixelConvert::alpha8ToColor(dst, (const uint8_t*)src, width);
 }
 
 // can return NULL
@@ -1280,6 +1253,126 @@ static void Bitmap_copyPixelsFromBuffer(JNIEnv* env, jobject,
     }
 }
 
+// Bitmaps of at least kMinParallelBytes are compared and hashed in bands of
+// kRowsPerBand rows on up to kMaxPixelThreads threads.
+static const int kRowsPerBand = 64;
+static const size_t kMinParallelBytes = 4 * 1024 * 1024;
+static const int kMaxPixelThreads = 4;
+
+/**
+ * Work split into bands of rows, taken by the calling thread and any helper
+ * threads in order. A band returns false to skip all of the remaining ones.
+ */
+struct RowBandJob {
+    bool (*proc)(RowBandJob* job, int band);
+    void* context;
+    int rowCount;
+    int bandCount;
+    std::atomic<int> next;
+    std::atomic<bool> stopped;
+};
+
+static void runRowBands(RowBandJob* job) {
+    while (!job->stopped) {
+        int band = job->next++;
+        if (band >= job->bandCount) {
+            break;
+        }
+        if (!job->proc(job, band)) {
+            job->stopped = true;
+        }
+    }
+}
+
+static void* rowBandThread(void* arg) {
+    runRowBands(static_cast<RowBandJob*>(arg));
+    return NULL;
+}
+
+// Runs proc over every band of rowCount rows. Returns false if a band stopped
+// the job.
+static bool forEachRowBand(bool (*proc)(RowBandJob*, int), void* context, int rowCount,
+        size_t totalBytes) {
+    RowBandJob job;
+    job.proc = proc;
+    job.context = context;
+    job.rowCount = rowCount;
+    job.bandCount = (rowCount + kRowsPerBand - 1) / kRowsPerBand;
+    job.next = 0;
+    job.stopped = false;
+
+    int threadCount = 1;
+    if (totalBytes >= kMinParallelBytes) {
+        const long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpuCount > 0 ? cpuCount : 1;
+        if (threadCount > kMaxPixelThreads) {
+            threadCount = kMaxPixelThreads;
+        }
+        if (threadCount > job.bandCount) {
+            threadCount = job.bandCount;
+        }
+    }
+
+    // This thread takes bands too, so the job finishes even if no other
+    // thread can be started.
+    pthread_t threads[kMaxPixelThreads];
+    int startedCount = 0;
+    for (int i = 1; i < threadCount; i++) {
+        if (pthread_create(&threads[startedCount], NULL, rowBandThread, &job) == 0) {
+            startedCount++;
+        }
+    }
+    runRowBands(&job);
+    for (int i = 0; i < startedCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    return !job.stopped;
+}
+
+static void bandRows(const RowBandJob* job, int band, int* startRow, int* endRow) {
+    *startRow = band * kRowsPerBand;
+    *endRow = *startRow + kRowsPerBand;
+    if (*endRow > job->rowCount) {
+        *endRow = job->rowCount;
+    }
+}
+
+struct SameAsContext {
+    const SkBitmap* bm0;
+    const SkBitmap* bm1;
+    size_t rowSize;
+};
+
+static bool sameAsBand(RowBandJob* job, int band) {
+    const SameAsContext* ctx = static_cast<const SameAsContext*>(job->context);
+    int startRow, endRow;
+    bandRows(job, band, &startRow, &endRow);
+
+    // SkBitmap::getAddr(int, int) may return NULL due to unrecognized config
+    // (ex: kRLE_Index8_Config). This will cause memcmp method to crash. Since bm0
+    // and bm1 both have pixel data() (have passed NULL == getPixels() check),
+    // those 2 bitmaps should be valid (only unrecognized), we return JNI_FALSE
+    // to warn user those 2 unrecognized config bitmaps may be different.
+    const void* bm0Addr = ctx->bm0->getAddr(0, startRow);
+    const void* bm1Addr = ctx->bm1->getAddr(0, startRow);
+    if (bm0Addr == NULL || bm1Addr == NULL) {
+        return false;
+    }
+
+    // Rows without padding can be compared in one go
+    if (ctx->bm0->rowBytes() == ctx->rowSize && ctx->bm1->rowBytes() == ctx->rowSize) {
+        return memcmp(bm0Addr, bm1Addr, ctx->rowSize * (endRow - startRow)) == 0;
+    }
+    for (int y = startRow; y < endRow; y++) {
+        bm0Addr = ctx->bm0->getAddr(0, y);
+        bm1Addr = ctx->bm1->getAddr(0, y);
+        if (memcmp(bm0Addr, bm1Addr, ctx->rowSize) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static jboolean Bitmap_sameAs(JNIEnv* env, jobject, jlong bm0Handle,
                               jlong bm1Handle) {
     SkBitmap bm0;
@@ -1319,26 +1412,156 @@ static jboolean Bitmap_sameAs(JNIEnv* env, jobject, jlong bm0Handle,
     // now compare each scanline. We can't do the entire buffer at once,
     // since we don't care about the pixel values that might extend beyond
     // the width (since the scanline might be larger than the logical width)
-    const int h = bm0.height();
-    const size_t size = bm0.width() * bm0.bytesPerPixel();
-    for (int y = 0; y < h; y++) {
-        // SkBitmap::getAddr(int, int) may return NULL due to unrecognized config
-        // (ex: kRLE_Index8_Config). This will cause memcmp method to crash. Since bm0
-        // and bm1 both have pixel data() (have passed NULL == getPixels() check),
-        // those 2 bitmaps should be valid (only unrecognized), we return JNI_FALSE
-        // to warn user those 2 unrecognized config bitmaps may be different.
-        void *bm0Addr = bm0.getAddr(0, y);
-        void *bm1Addr = bm1.getAddr(0, y);
-
-        if(bm0Addr == NULL || bm1Addr == NULL) {
-            return JNI_FALSE;
+    SameAsContext ctx;
+    ctx.bm0 = &bm0;
+    ctx.bm1 = &bm1;
+    ctx.rowSize = bm0.width() * bm0.bytesPerPixel();
+    return forEachRowBand(sameAsBand, &ctx, bm0.height(), ctx.rowSize * bm0.height())
+            ? JNI_TRUE : JNI_FALSE;
+}
+
+// xxHash64, which is limited by memory bandwidth rather than by arithmetic.
+static const uint64_t kXXPrime1 = 11400714785074694791ULL;
+static const uint64_t kXXPrime2 = 14029467366897019727ULL;
+static const uint64_t kXXPrime3 = 1609587929392839161ULL;
+static const uint64_t kXXPrime4 = 9650029242287828579ULL;
+static const uint64_t kXXPrime5 = 2870177450012600261ULL;
+
+static inline uint64_t xxRotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxRead64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t xxRead32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t xxRound(uint64_t acc, uint64_t input) {
+    acc += input * kXXPrime2;
+    acc = xxRotl(acc, 31);
+    return acc * kXXPrime1;
+}
+
+static inline uint64_t xxMergeRound(uint64_t acc, uint64_t val) {
+    acc ^= xxRound(0, val);
+    return acc * kXXPrime1 + kXXPrime4;
+}
+
+static uint64_t xxHash64(const void* data, size_t len, uint64_t seed) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    const uint8_t* const end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        const uint8_t* const limit = end - 32;
+        uint64_t v1 = seed + kXXPrime1 + kXXPrime2;
+        uint64_t v2 = seed + kXXPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kXXPrime1;
+        do {
+            v1 = xxRound(v1, xxRead64(p));
+            v2 = xxRound(v2, xxRead64(p + 8));
+            v3 = xxRound(v3, xxRead64(p + 16));
+            v4 = xxRound(v4, xxRead64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        h = xxRotl(v1, 1) + xxRotl(v2, 7) + xxRotl(v3, 12) + xxRotl(v4, 18);
+        h = xxMergeRound(h, v1);
+        h = xxMergeRound(h, v2);
+        h = xxMergeRound(h, v3);
+        h = xxMergeRound(h, v4);
+    } else {
+        h = seed + kXXPrime5;
+    }
+    h += len;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxRound(0, xxRead64(p));
+        h = xxRotl(h, 27) * kXXPrime1 + kXXPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(xxRead32(p)) * kXXPrime1;
+        h = xxRotl(h, 23) * kXXPrime2 + kXXPrime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * kXXPrime5;
+        h = xxRotl(h, 11) * kXXPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= kXXPrime2;
+    h ^= h >> 29;
+    h *= kXXPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
+struct HashContext {
+    const SkBitmap* bitmap;
+    size_t rowSize;
+    uint64_t* bandHashes;
+};
+
+static bool hashBand(RowBandJob* job, int band) {
+    HashContext* ctx = static_cast<HashContext*>(job->context);
+    int startRow, endRow;
+    bandRows(job, band, &startRow, &endRow);
+
+    uint64_t h = 0;
+    for (int y = startRow; y < endRow; y++) {
+        const void* addr = ctx->bitmap->getAddr(0, y);
+        if (addr == NULL) {
+            return false;
         }
+        h = xxHash64(addr, ctx->rowSize, h);
+    }
+    ctx->bandHashes[band] = h;
+    return true;
+}
 
-        if (memcmp(bm0Addr, bm1Addr, size) != 0) {
-            return JNI_FALSE;
+// Returns a 64 bit hash of the visible pixels, dimensions and color type of
+// the bitmap, and of the color table of Index8 bitmaps. The bands are hashed
+// independently and then together, so the result doesn't depend on how many
+// threads did the work. Returns 0 if the pixels can't be read.
+static jlong Bitmap_contentHash(JNIEnv* env, jobject, jlong bitmapHandle) {
+    SkBitmap bitmap;
+    reinterpret_cast<Bitmap*>(bitmapHandle)->getSkBitmap(&bitmap);
+
+    SkAutoLockPixels alp(bitmap);
+    if (NULL == bitmap.getPixels()) {
+        return 0;
+    }
+
+    const int32_t header[] = { bitmap.width(), bitmap.height(), bitmap.colorType() };
+    uint64_t seed = xxHash64(header, sizeof(header), 0);
+    if (bitmap.colorType() == kIndex_8_SkColorType) {
+        SkColorTable* ct = bitmap.getColorTable();
+        if (NULL == ct) {
+            return 0;
         }
+        seed = xxHash64(ct->readColors(), ct->count() * sizeof(SkPMColor), seed);
     }
-    return JNI_TRUE;
+
+    const int height = bitmap.height();
+    const int bandCount = (height + kRowsPerBand - 1) / kRowsPerBand;
+    std::unique_ptr<uint64_t[]> bandHashes(new uint64_t[bandCount]);
+
+    HashContext ctx;
+    ctx.bitmap = &bitmap;
+    ctx.rowSize = bitmap.width() * bitmap.bytesPerPixel();
+    ctx.bandHashes = bandHashes.get();
+    if (!forEachRowBand(hashBand, &ctx, height, ctx.rowSize * height)) {
+        return 0;
+    }
+    return static_cast<jlong>(xxHash64(bandHashes.get(), bandCount * sizeof(uint64_t), seed));
 }
 
 static jlong Bitmap_refPixelRef(JNIEnv* env, jobject, jlong bitmapHandle) {
@@ -1391,8 +1614,15 @@ static JNINativeMethod gBitmapMethods[] = {
     {   "nativeRefPixelRef",        "(J)J", (void*)Bitmap_refPixelRef },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gBitmapOptionalMethods[] = {
+    {   "nativeContentHash",        "(J)J", (void*)Bitmap_contentHash },
+};
+
 int register_android_graphics_Bitmap(JNIEnv* env)
 {
+    android::RegisterOptionalMethods(env, "android/graphics/Bitmap", gBitmapOptionalMethods,
+                                     NELEM(gBitmapOptionalMethods));
     return android::RegisterMethodsOrDie(env, "android/graphics/Bitmap", gBitmapMethods,
                                          NELEM(gBitmapMethods));
 }
@@ -4,6 +4,7 @@
 #include "NinePatchPeeker.h"
 #include "SkFrontBufferedStream.h"
 #include "SkImageDecoder.h"
+#include "SkMallocPixelRef.h"
 #include "SkMath.h"
 #include "SkPixelRef.h"
 #include "SkStream.h"
@@ -23,6 +24,7 @@
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <utils/Mutex.h>
 
 jfieldID gOptions_justBoundsFieldID;
 jfieldID gOptions_sampleSizeFieldID;
@@ -129,7 +131,134 @@ static SkColorType colorTypeForScaledOutput(SkColorType colorType) {
     return colorType;
 }
 
-class ScaleCheckingAllocator : public SkBitmap::HeapAllocator {
+/*
+ * Keeps the pixel memory of the bitmaps that are decoded only to be scaled,
+ * and freed right after, for the next decodes. Blocks are bucketed by their
+ * power of two size, and a few of each are kept up to kMaxPooledBytes, until
+ * the process is asked to trim its memory.
+ */
+class ScratchPixelPool {
+public:
+    // Returns memory for at least size bytes, to give back with the
+    // release() proc and the returned capacity as its context.
+    static void* acquire(size_t size, size_t* outCapacity) {
+        const int bucket = bucketFor(size);
+        if (bucket < 0) {
+            *outCapacity = size;
+            return sk_malloc_flags(size, 0);
+        }
+
+        *outCapacity = bucketCapacity(bucket);
+        {
+            AutoMutex _l(sLock);
+            if (sCounts[bucket] > 0) {
+                sPooledBytes -= *outCapacity;
+                return sBlocks[bucket][--sCounts[bucket]];
+            }
+        }
+        return sk_malloc_flags(*outCapacity, 0);
+    }
+
+    // Implements SkMallocPixelRef::ReleaseProc.
+    static void release(void* addr, void* context) {
+        const size_t capacity = reinterpret_cast<size_t>(context);
+        const int bucket = bucketFor(capacity);
+        if (bucket >= 0 && bucketCapacity(bucket) == capacity) {
+            AutoMutex _l(sLock);
+            if (sCounts[bucket] < kBlocksPerBucket
+                    && sPooledBytes + capacity <= kMaxPooledBytes) {
+                sBlocks[bucket][sCounts[bucket]++] = addr;
+                sPooledBytes += capacity;
+                return;
+            }
+        }
+        sk_free(addr);
+    }
+
+    // Frees all the pooled blocks.
+    static void trim() {
+        AutoMutex _l(sLock);
+        for (int bucket = 0; bucket < kBucketCount; bucket++) {
+            while (sCounts[bucket] > 0) {
+                sk_free(sBlocks[bucket][--sCounts[bucket]]);
+            }
+        }
+        sPooledBytes = 0;
+    }
+
+private:
+    // Blocks of 16 KB up to 4 MB
+    static const int kMinBucketShift = 14;
+    static const int kBucketCount = 9;
+    static const int kBlocksPerBucket = 2;
+    static const size_t kMaxPooledBytes = 4 * 1024 * 1024;
+
+    static size_t bucketCapacity(int bucket) {
+        return size_t(1) << (bucket + kMinBucketShift);
+    }
+
+    // Returns -1 for the sizes that aren't pooled.
+    static int bucketFor(size_t size) {
+        for (int bucket = 0; bucket < kBucketCount; bucket++) {
+            if (size <= bucketCapacity(bucket)) {
+                return bucket;
+            }
+        }
+        return -1;
+    }
+
+    static Mutex sLock;
+    static void* sBlocks[kBucketCount][kBlocksPerBucket];
+    static int sCounts[kBucketCount];
+    static size_t sPooledBytes;
+};
+
+void trimDecodeScratchMemory() {
+    ScratchPixelPool::trim();
+}
+
+Mutex ScratchPixelPool::sLock;
+void* ScratchPixelPool::sBlocks[kBucketCount][kBlocksPerBucket];
+int ScratchPixelPool::sCounts[kBucketCount];
+size_t ScratchPixelPool::sPooledBytes;
+
+// Allocates the bitmaps that are decoded before being scaled from a
+// ScratchPixelPool, as they're always thrown away.
+class ScratchPixelAllocator : public SkBitmap::Allocator {
+public:
+    virtual bool allocPixelRef(SkBitmap* bitmap, SkColorTable* ctable) {
+        const SkImageInfo& info = bitmap->info();
+        if (info.fColorType == kUnknown_SkColorType) {
+            return false;
+        }
+
+        const int64_t size64 = info.getSafeSize64(bitmap->rowBytes());
+        if (!sk_64_isS32(size64)) {
+            return false;
+        }
+
+        size_t capacity;
+        void* addr = ScratchPixelPool::acquire(sk_64_asS32(size64), &capacity);
+        if (addr == NULL) {
+            return false;
+        }
+
+        SkMallocPixelRef* pr = SkMallocPixelRef::NewWithProc(info, bitmap->rowBytes(), ctable,
+                addr, &ScratchPixelPool::release, reinterpret_cast<void*>(capacity));
+        if (!pr) {
+            ScratchPixelPool::release(addr, reinterpret_cast<void*>(capacity));
+            return false;
+        }
+
+        bitmap->setPixelRef(pr)->unref();
+        // since we're already allocated, we lockPixels right away
+        // HeapAllocator/JavaPixelAllocator behaves this way too
+        bitmap->lockPixels();
+        return true;
+    }
+};
+
+class ScaleCheckingAllocator : public ScratchPixelAllocator {
 public:
     ScaleCheckingAllocator(float scale, int size)
             : mScale(scale), mSize(size) {
@@ -147,7 +276,7 @@ public:
                     mSize, requestedSize);
             return false;
         }
-        return SkBitmap::HeapAllocator::allocPixelRef(bitmap, ctable);
+        return ScratchPixelAllocator::allocPixelRef(bitmap, ctable);
     }
 private:
     const float mScale;
@@ -273,6 +402,7 @@ static jobject doDecode(JNIEnv* env, SkStreamRewindable* stream, jobject padding
     JavaPixelAllocator javaAllocator(env);
     RecyclingPixelAllocator recyclingAllocator(reuseBitmap, existingBufferSize);
     ScaleCheckingAllocator scaleCheckingAllocator(scale, existingBufferSize);
+    ScratchPixelAllocator scratchAllocator;
     SkBitmap::Allocator* outputAllocator = (javaBitmap != NULL) ?
             (SkBitmap::Allocator*)&recyclingAllocator : (SkBitmap::Allocator*)&javaAllocator;
     if (decodeMode != SkImageDecoder::kDecodeBounds_Mode) {
@@ -285,6 +415,8 @@ static jobject doDecode(JNIEnv* env, SkStreamRewindable* stream, jobject padding
             // check for eventual scaled bounds at allocation time, so we don't decode the bitmap
             // only to find the scaled result too large to fit in the allocation
             decoder->setAllocator(&scaleCheckingAllocator);
+        } else {
+            decoder->setAllocator(&scratchAllocator);
         }
     }
 
@@ -23,4 +23,7 @@ jstring getMimeTypeString(JNIEnv* env, SkImageDecoder::Format format);
 
 jobject decodeBitmap(JNIEnv* env, void* data, size_t size);
 
+// Frees the memory kept for the bitmaps decoded before being scaled.
+void trimDecodeScratchMemory();
+
 #endif  // _ANDROID_GRAPHICS_BITMAP_FACTORY_H_
@@ -24,12 +24,15 @@
 #include "SkTemplates.h"
 #include "SkPixelRef.h"
 #include "SkStream.h"
+#include "SkTDArray.h"
 #include "BitmapFactory.h"
 #include "AutoDecodeCancel.h"
 #include "CreateJavaOutputStreamAdaptor.h"
 #include "Utils.h"
 #include "JNIHelp.h"
 
+#include "ScopedPrimitiveArray.h"
+
 #include "core_jni_helpers.h"
 #include "android_util_Binder.h"
 #include "android_nio_utils.h"
@@ -38,40 +41,140 @@
 #include <binder/Parcel.h>
 #include <jni.h>
 #include <androidfw/Asset.h>
+#include <pthread.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+#include <atomic>
 
 using namespace android;
 
+static jclass gBitmap_class;
+
+// Concurrent decodes of one image each need their own decoder, and decoders
+// hold a sizable tile index, so there are at most this many per image.
+static const int kMaxRegionDecoders = 4;
+
+/*
+ * The decoders of one image. They all build their tile index over the same
+ * encoded data, so regions can be decoded on several threads at once.
+ */
 class SkBitmapRegionDecoder {
 public:
-    SkBitmapRegionDecoder(SkImageDecoder* decoder, int width, int height) {
-        fDecoder = decoder;
-        fWidth = width;
-        fHeight = height;
+    // Takes ownership of decoder, whose tile index is built over data.
+    SkBitmapRegionDecoder(SkData* data, SkImageDecoder* decoder, int width, int height)
+            : fData(SkRef(data))
+            , fDecoderCount(1)
+            , fCanCreateDecoder(true)
+            , fWidth(width)
+            , fHeight(height) {
+        fIdleDecoders.push(decoder);
     }
+
     ~SkBitmapRegionDecoder() {
-        SkDELETE(fDecoder);
+        // Only once no region is being decoded, so all decoders are idle.
+        for (int i = 0; i < fIdleDecoders.count(); i++) {
+            SkDELETE(fIdleDecoders[i]);
+        }
     }
 
-    bool decodeRegion(SkBitmap* bitmap, const SkIRect& rect,
-                      SkColorType pref, int sampleSize) {
-        fDecoder->setSampleSize(sampleSize);
-        return fDecoder->decodeSubset(bitmap, rect, pref);
+    // Returns a decoder no other thread is using, to give back with
+    // releaseDecoder(). Creates one if they're all in use and there aren't
+    // kMaxRegionDecoders yet, or else waits for one.
+    SkImageDecoder* acquireDecoder(JNIEnv* env) {
+        AutoMutex _l(fLock);
+        while (fIdleDecoders.isEmpty()) {
+            if (fCanCreateDecoder && fDecoderCount < kMaxRegionDecoders) {
+                fDecoderCount++;
+                fLock.unlock();
+                SkImageDecoder* decoder = createDecoder(env);
+                fLock.lock();
+                if (decoder != NULL) {
+                    return decoder;
+                }
+                // Wait for the ones there are instead.
+                fDecoderCount--;
+                fCanCreateDecoder = false;
+                continue;
+            }
+            fDecoderReleased.wait(fLock);
+        }
+        SkImageDecoder* decoder;
+        fIdleDecoders.pop(&decoder);
+        return decoder;
+    }
+
+    void releaseDecoder(SkImageDecoder* decoder) {
+        AutoMutex _l(fLock);
+        fIdleDecoders.push(decoder);
+        fDecoderReleased.signal();
+    }
+
+    static bool decodeRegion(SkImageDecoder* decoder, SkBitmap* bitmap, const SkIRect& rect,
+                             SkColorType pref, int sampleSize) {
+        decoder->setSampleSize(sampleSize);
+        return decoder->decodeSubset(bitmap, rect, pref);
     }
 
-    SkImageDecoder* getDecoder() const { return fDecoder; }
     int getWidth() const { return fWidth; }
     int getHeight() const { return fHeight; }
 
 private:
-    SkImageDecoder* fDecoder;
+    SkImageDecoder* createDecoder(JNIEnv* env) {
+        SkMemoryStream* stream = new SkMemoryStream(fData);
+        SkImageDecoder* decoder = SkImageDecoder::Factory(stream);
+        if (NULL == decoder) {
+            SkDELETE(stream);
+            return NULL;
+        }
+
+        JavaPixelAllocator *javaAllocator = new JavaPixelAllocator(env);
+        decoder->setAllocator(javaAllocator);
+        javaAllocator->unref();
+
+        // This call passes ownership of stream to the decoder, or deletes on failure.
+        int width, height;
+        if (!decoder->buildTileIndex(stream, &width, &height)) {
+            SkDELETE(decoder);
+            return NULL;
+        }
+        return decoder;
+    }
+
+    SkAutoTUnref<SkData> fData;
+    Mutex fLock;
+    Condition fDecoderReleased;
+    SkTDArray<SkImageDecoder*> fIdleDecoders;
+    int fDecoderCount;
+    bool fCanCreateDecoder;
     int fWidth;
     int fHeight;
 };
 
-// Takes ownership of the SkStreamRewindable. For consistency, deletes stream even
+// Holds a decoder of an SkBitmapRegionDecoder for the scope.
+class AutoRegionDecoder {
+public:
+    AutoRegionDecoder(JNIEnv* env, SkBitmapRegionDecoder* brd)
+            : fRegionDecoder(brd)
+            , fDecoder(brd->acquireDecoder(env)) {
+    }
+
+    ~AutoRegionDecoder() {
+        fRegionDecoder->releaseDecoder(fDecoder);
+    }
+
+    SkImageDecoder* get() const { return fDecoder; }
+
+private:
+    SkBitmapRegionDecoder* fRegionDecoder;
+    SkImageDecoder* fDecoder;
+};
+
+// Takes ownership of the SkMemoryStream. For consistency, deletes stream even
 // when returning null.
-static jobject createBitmapRegionDecoder(JNIEnv* env, SkStreamRewindable* stream) {
+static jobject createBitmapRegionDecoder(JNIEnv* env, SkMemoryStream* stream) {
     SkImageDecoder* decoder = SkImageDecoder::Factory(stream);
     int width, height;
     if (NULL == decoder) {
@@ -84,6 +187,9 @@ static jobject createBitmapRegionDecoder(JNIEnv* env, SkStreamRewindable* stream
     decoder->setAllocator(javaAllocator);
     javaAllocator->unref();
 
+    // Kept for the decoders of concurrent decodes.
+    SkAutoTUnref<SkData> data(stream->copyToData());
+
     // This call passes ownership of stream to the decoder, or deletes on failure.
     if (!decoder->buildTileIndex(stream, &width, &height)) {
         char msg[100];
@@ -94,7 +200,7 @@ static jobject createBitmapRegionDecoder(JNIEnv* env, SkStreamRewindable* stream
         return nullObjectReturn("decoder->buildTileIndex returned false");
     }
 
-    SkBitmapRegionDecoder *bm = new SkBitmapRegionDecoder(decoder, width, height);
+    SkBitmapRegionDecoder *bm = new SkBitmapRegionDecoder(data, decoder, width, height);
     return GraphicsJNI::createBitmapRegionDecoder(env, bm);
 }
 
@@ -138,7 +244,7 @@ static jobject nativeNewInstanceFromStream(JNIEnv* env, jobject clazz,
                                   jboolean isShareable) {
     jobject brd = NULL;
     // for now we don't allow shareable with java inputstreams
-    SkStreamRewindable* stream = CopyJavaInputStream(env, is, storage);
+    SkMemoryStream* stream = CopyJavaInputStream(env, is, storage);
 
     if (stream) {
         // the decoder owns the stream.
@@ -171,7 +277,6 @@ static jobject nativeDecodeRegion(JNIEnv* env, jobject, jlong brdHandle,
                                 jint start_x, jint start_y, jint width, jint height, jobject options) {
     SkBitmapRegionDecoder *brd = reinterpret_cast<SkBitmapRegionDecoder*>(brdHandle);
     jobject tileBitmap = NULL;
-    SkImageDecoder *decoder = brd->getDecoder();
     int sampleSize = 1;
     SkColorType prefColorType = kUnknown_SkColorType;
     bool doDither = true;
@@ -195,6 +300,8 @@ static jobject nativeDecodeRegion(JNIEnv* env, jobject, jlong brdHandle,
         requireUnpremultiplied = !env->GetBooleanField(options, gOptions_premultipliedFieldID);
     }
 
+    AutoRegionDecoder autoDecoder(env, brd);
+    SkImageDecoder* decoder = autoDecoder.get();
     decoder->setDitherImage(doDither);
     decoder->setPreferQualityOverSpeed(preferQualityOverSpeed);
     decoder->setRequireUnpremultipliedColors(requireUnpremultiplied);
@@ -219,7 +326,8 @@ static jobject nativeDecodeRegion(JNIEnv* env, jobject, jlong brdHandle,
         GraphicsJNI::getSkBitmap(env, tileBitmap, &bitmap);
     }
 
-    if (!brd->decodeRegion(&bitmap, region, prefColorType, sampleSize)) {
+    if (!SkBitmapRegionDecoder::decodeRegion(decoder, &bitmap, region, prefColorType,
+            sampleSize)) {
         return nullObjectReturn("decoder->decodeRegion returned false");
     }
 
@@ -247,6 +355,174 @@ static jobject nativeDecodeRegion(JNIEnv* env, jobject, jlong brdHandle,
             bitmapCreateFlags);
 }
 
+/*
+ * Regions decoded together by several threads, each one with a decoder of
+ * its own. All of them use the same options.
+ */
+struct RegionBatch {
+    SkBitmapRegionDecoder* brd;
+    JavaVM* vm;
+    // The left, top, right and bottom of each region
+    const jint* rects;
+    int count;
+    std::atomic<int> next;
+    // Global references to the decoded Bitmaps, NULL where a region failed
+    jobject* bitmaps;
+
+    // Global reference to the options, which may be NULL
+    jobject options;
+    int sampleSize;
+    SkColorType prefColorType;
+    bool doDither;
+    bool preferQualityOverSpeed;
+    bool requireUnpremultiplied;
+};
+
+static void decodeRegions(JNIEnv* env, RegionBatch* batch) {
+    AutoRegionDecoder autoDecoder(env, batch->brd);
+    SkImageDecoder* decoder = autoDecoder.get();
+    decoder->setDitherImage(batch->doDither);
+    decoder->setPreferQualityOverSpeed(batch->preferQualityOverSpeed);
+    decoder->setRequireUnpremultipliedColors(batch->requireUnpremultiplied);
+
+    int bitmapCreateFlags = 0;
+    if (!batch->requireUnpremultiplied) {
+        bitmapCreateFlags |= GraphicsJNI::kBitmapCreateFlag_Premultiplied;
+    }
+
+    int i;
+    while ((i = batch->next.fetch_add(1)) < batch->count) {
+        if (NULL != batch->options && env->GetBooleanField(batch->options, gOptions_mCancelID)) {
+            break;
+        }
+
+        const jint* rect = batch->rects + i * 4;
+        SkIRect region = SkIRect::MakeLTRB(rect[0], rect[1], rect[2], rect[3]);
+        SkBitmap bitmap;
+        if (!SkBitmapRegionDecoder::decodeRegion(decoder, &bitmap, region,
+                batch->prefColorType, batch->sampleSize)) {
+            // The region is left out, as for an OutOfMemoryError allocating it.
+            env->ExceptionClear();
+            continue;
+        }
+
+        JavaPixelAllocator* allocator = (JavaPixelAllocator*) decoder->getAllocator();
+        jobject tileBitmap = GraphicsJNI::createBitmap(env, allocator->getStorageObjAndReset(),
+                bitmapCreateFlags);
+        if (tileBitmap == NULL) {
+            env->ExceptionClear();
+            continue;
+        }
+        batch->bitmaps[i] = env->NewGlobalRef(tileBitmap);
+        env->DeleteLocalRef(tileBitmap);
+    }
+}
+
+static void* decodeRegionsThread(void* arg) {
+    RegionBatch* batch = reinterpret_cast<RegionBatch*>(arg);
+
+    JNIEnv* env;
+    JavaVMAttachArgs args = { JNI_VERSION_1_4, "RegionDecoder", NULL };
+    if (batch->vm->AttachCurrentThread(&env, &args) != JNI_OK) {
+        // The other threads decode the regions.
+        return NULL;
+    }
+    decodeRegions(env, batch);
+    batch->vm->DetachCurrentThread();
+    return NULL;
+}
+
+/*
+ * Decodes each rect of rects, an array of left, top, right and bottom
+ * values, on several threads. Returns the Bitmaps in the same order, with
+ * null for the ones that failed. options.inBitmap isn't supported.
+ */
+static jobjectArray nativeDecodeRegions(JNIEnv* env, jobject, jlong brdHandle,
+                                        jintArray rectsArray, jobject options) {
+    SkBitmapRegionDecoder *brd = reinterpret_cast<SkBitmapRegionDecoder*>(brdHandle);
+    ScopedIntArrayRO rects(env, rectsArray);
+    if (rects.get() == NULL) {
+        return NULL;
+    }
+
+    RegionBatch batch;
+    batch.brd = brd;
+    batch.rects = rects.get();
+    batch.count = rects.size() / 4;
+    batch.next = 0;
+    batch.options = NULL;
+    batch.sampleSize = 1;
+    batch.prefColorType = kUnknown_SkColorType;
+    batch.doDither = true;
+    batch.preferQualityOverSpeed = false;
+    batch.requireUnpremultiplied = false;
+    if (env->GetJavaVM(&batch.vm) != JNI_OK) {
+        return NULL;
+    }
+
+    if (NULL != options) {
+        batch.sampleSize = env->GetIntField(options, gOptions_sampleSizeFieldID);
+        jobject jconfig = env->GetObjectField(options, gOptions_configFieldID);
+        batch.prefColorType = GraphicsJNI::getNativeBitmapColorType(env, jconfig);
+        batch.doDither = env->GetBooleanField(options, gOptions_ditherFieldID);
+        batch.preferQualityOverSpeed = env->GetBooleanField(options,
+                gOptions_preferQualityOverSpeedFieldID);
+        batch.requireUnpremultiplied = !env->GetBooleanField(options,
+                gOptions_premultipliedFieldID);
+        batch.options = env->NewGlobalRef(options);
+    }
+
+    jobjectArray result = env->NewObjectArray(batch.count, gBitmap_class, NULL);
+    if (result == NULL) {
+        if (batch.options != NULL) {
+            env->DeleteGlobalRef(batch.options);
+        }
+        return NULL;
+    }
+
+    SkAutoTMalloc<jobject> bitmaps(batch.count);
+    for (int i = 0; i < batch.count; i++) {
+        bitmaps[i] = NULL;
+    }
+    batch.bitmaps = bitmaps.get();
+
+    int threadCount = batch.count;
+    const long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount > 0 && threadCount > cpuCount) {
+        threadCount = cpuCount;
+    }
+    if (threadCount > kMaxRegionDecoders) {
+        threadCount = kMaxRegionDecoders;
+    }
+
+    // This thread decodes too, so the regions are decoded even if no other
+    // thread can be started.
+    pthread_t threads[kMaxRegionDecoders];
+    int startedCount = 0;
+    for (int i = 1; i < threadCount; i++) {
+        if (pthread_create(&threads[startedCount], NULL, decodeRegionsThread, &batch) == 0) {
+            startedCount++;
+        }
+    }
+    if (batch.count > 0) {
+        decodeRegions(env, &batch);
+    }
+    for (int i = 0; i < startedCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < batch.count; i++) {
+        if (bitmaps[i] != NULL) {
+            env->SetObjectArrayElement(result, i, bitmaps[i]);
+            env->DeleteGlobalRef(bitmaps[i]);
+        }
+    }
+    if (batch.options != NULL) {
+        env->DeleteGlobalRef(batch.options);
+    }
+    return result;
+}
+
 static jint nativeGetHeight(JNIEnv* env, jobject, jlong brdHandle) {
     SkBitmapRegionDecoder *brd = reinterpret_cast<SkBitmapRegionDecoder*>(brdHandle);
     return static_cast<jint>(brd->getHeight());
@@ -296,8 +572,18 @@ static JNINativeMethod gBitmapRegionDecoderMethods[] = {
     },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gBitmapRegionDecoderOptionalMethods[] = {
+    {   "nativeDecodeRegions",
+        "(J[ILandroid/graphics/BitmapFactory$Options;)[Landroid/graphics/Bitmap;",
+        (void*)nativeDecodeRegions},
+};
+
 int register_android_graphics_BitmapRegionDecoder(JNIEnv* env)
 {
+    gBitmap_class = MakeGlobalRefOrDie(env, FindClassOrDie(env, "android/graphics/Bitmap"));
+    android::RegisterOptionalMethods(env, "android/graphics/BitmapRegionDecoder",
+            gBitmapRegionDecoderOptionalMethods, NELEM(gBitmapRegionDecoderOptionalMethods));
     return android::RegisterMethodsOrDie(env, "android/graphics/BitmapRegionDecoder",
             gBitmapRegionDecoderMethods, NELEM(gBitmapRegionDecoderMethods));
 }
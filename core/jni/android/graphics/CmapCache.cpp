@@ -0,0 +1,422 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Minikin"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <SkData.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "CmapCache.h"
+
+namespace android {
+
+static const uint32_t kCacheMagic = 0x636d7063; // 'cmpc'
+static const uint32_t kCacheVersion = 1;
+
+// Only the system fonts are loaded at every boot, fonts of apps aren't kept
+static const char kSystemPrefix[] = "/system/";
+
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+// Followed by the path and the cmap, then padding to the next entry
+struct CacheEntryHeader {
+    uint32_t pathLength;
+    uint32_t cmapSize;
+    int64_t fileSize;
+    int64_t modifiedTime;
+};
+
+static size_t alignEntry(size_t size) {
+    return (size + 7) & ~7;
+}
+
+static uint16_t readU16(const uint8_t* p) {
+    return (uint16_t(p[0]) << 8) | p[1];
+}
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static void appendU16(Vector<uint8_t>* out, uint16_t value) {
+    out->add(value >> 8);
+    out->add(value & 0xFF);
+}
+
+static void appendU32(Vector<uint8_t>* out, uint32_t value) {
+    appendU16(out, value >> 16);
+    appendU16(out, value & 0xFFFF);
+}
+
+struct CmapGroup {
+    uint32_t start;
+    uint32_t end;
+    uint32_t glyph;
+};
+
+// Extends the last group if the code point and glyph follow it. Returns false
+// if the code points aren't increasing.
+static bool addMapping(Vector<CmapGroup>* groups, uint32_t codepoint, uint32_t glyph) {
+    if (!groups->isEmpty()) {
+        CmapGroup& last = groups->editTop();
+        if (codepoint <= last.end) {
+            return false;
+        }
+        if (codepoint == last.end + 1 && glyph == last.glyph + (codepoint - last.start)) {
+            last.end = codepoint;
+            return true;
+        }
+    }
+    CmapGroup group = { codepoint, codepoint, glyph };
+    groups->add(group);
+    return true;
+}
+
+static bool readFormat4(const uint8_t* table, size_t size, Vector<CmapGroup>* groups) {
+    if (size < 14) {
+        return false;
+    }
+    const size_t segCountX2 = readU16(table + 6);
+    if ((segCountX2 & 1) != 0 || size < 16 + 4 * segCountX2) {
+        return false;
+    }
+    const uint8_t* endCodes = table + 14;
+    const uint8_t* startCodes = endCodes + segCountX2 + 2;
+    const uint8_t* idDeltas = startCodes + segCountX2;
+    const uint8_t* idRangeOffsets = idDeltas + segCountX2;
+    for (size_t i = 0; i < segCountX2; i += 2) {
+        const uint32_t end = readU16(endCodes + i);
+        const uint32_t start = readU16(startCodes + i);
+        const uint16_t idDelta = readU16(idDeltas + i);
+        const uint16_t idRangeOffset = readU16(idRangeOffsets + i);
+        for (uint32_t c = start; c <= end && c != 0xFFFF; c++) {
+            uint16_t glyph;
+            if (idRangeOffset == 0) {
+                glyph = c + idDelta;
+            } else {
+                // The offset is relative to its own position in idRangeOffsets
+                const size_t glyphOffset = (idRangeOffsets + i - table) + idRangeOffset
+                        + 2 * (c - start);
+                if (glyphOffset > size - 2) {
+                    return false;
+                }
+                glyph = readU16(table + glyphOffset);
+                if (glyph != 0) {
+                    glyph += idDelta;
+                }
+            }
+            if (glyph != 0 && !addMapping(groups, c, glyph)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool readFormat12(const uint8_t* table, size_t size, Vector<CmapGroup>* groups) {
+    if (size < 16) {
+        return false;
+    }
+    const uint32_t numGroups = readU32(table + 12);
+    if ((size - 16) / 12 < numGroups) {
+        return false;
+    }
+    for (uint32_t i = 0; i < numGroups; i++) {
+        const uint8_t* group = table + 16 + i * 12;
+        CmapGroup g = { readU32(group), readU32(group + 4), readU32(group + 8) };
+        if (g.start > g.end || g.end > 0x10FFFF
+                || (!groups->isEmpty() && g.start <= groups->top().end)) {
+            return false;
+        }
+        groups->add(g);
+    }
+    return true;
+}
+
+bool CmapCache::reduceCmap(const uint8_t* cmap, size_t size, Vector<uint8_t>* outCmap) {
+    if (size < 4) {
+        return false;
+    }
+    const uint16_t numTables = readU16(cmap + 2);
+    if ((size - 4) / 8 < numTables) {
+        return false;
+    }
+
+    // The same subtables as Minikin's CmapCoverage: a format 12 (3, 10)
+    // subtable, or else a format 4 (3, 1) one.
+    const uint8_t* unicode = NULL;
+    size_t unicodeSize = 0;
+    uint16_t unicodeFormat = 0;
+    const uint8_t* variations = NULL;
+    size_t variationsSize = 0;
+    for (uint16_t i = 0; i < numTables; i++) {
+        const uint8_t* record = cmap + 4 + i * 8;
+        const uint16_t platformId = readU16(record);
+        const uint16_t encodingId = readU16(record + 2);
+        const uint32_t offset = readU32(record + 4);
+        if (offset > size - 8) {
+            continue;
+        }
+        const uint8_t* table = cmap + offset;
+        const uint16_t format = readU16(table);
+        if (platformId == 3 && encodingId == 10 && format == 12) {
+            const uint32_t length = readU32(table + 4);
+            if (length <= size - offset) {
+                unicode = table;
+                unicodeSize = length;
+                unicodeFormat = format;
+            }
+        } else if (platformId == 3 && encodingId == 1 && format == 4 && unicodeFormat != 12) {
+            const uint16_t length = readU16(table + 2);
+            if (length <= size - offset) {
+                unicode = table;
+                unicodeSize = length;
+                unicodeFormat = format;
+            }
+        } else if (platformId == 0 && encodingId == 5 && format == 14) {
+            const uint32_t length = readU32(table + 2);
+            if (length <= size - offset) {
+                variations = table;
+                variationsSize = length;
+            }
+        }
+    }
+    if (unicode == NULL) {
+        return false;
+    }
+
+    Vector<CmapGroup> groups;
+    const bool valid = unicodeFormat == 12
+            ? readFormat12(unicode, unicodeSize, &groups)
+            : readFormat4(unicode, unicodeSize, &groups);
+    if (!valid) {
+        return false;
+    }
+
+    const uint16_t outTables = variations != NULL ? 2 : 1;
+    const uint32_t format12Size = 16 + 12 * groups.size();
+    const uint32_t headerSize = 4 + 8 * outTables;
+    outCmap->clear();
+    outCmap->setCapacity(headerSize + format12Size + variationsSize);
+    appendU16(outCmap, 0);
+    appendU16(outCmap, outTables);
+    // The encoding records are sorted by platform, then encoding
+    if (variations != NULL) {
+        appendU16(outCmap, 0);
+        appendU16(outCmap, 5);
+        appendU32(outCmap, headerSize + format12Size);
+    }
+    appendU16(outCmap, 3);
+    appendU16(outCmap, 10);
+    appendU32(outCmap, headerSize);
+
+    appendU16(outCmap, 12);
+    appendU16(outCmap, 0);
+    appendU32(outCmap, format12Size);
+    appendU32(outCmap, 0);
+    appendU32(outCmap, groups.size());
+    for (size_t i = 0; i < groups.size(); i++) {
+        appendU32(outCmap, groups[i].start);
+        appendU32(outCmap, groups[i].end);
+        appendU32(outCmap, groups[i].glyph);
+    }
+    // Its offsets are relative to the subtable, so it can be copied as is
+    if (variations != NULL) {
+        outCmap->appendArray(variations, variationsSize);
+    }
+    return true;
+}
+
+static CmapCache* createCache() {
+    char path[PROPERTY_VALUE_MAX];
+    if (property_get("ro.graphics.font_cmap_cache", path, "") <= 0) {
+        return NULL;
+    }
+    return new CmapCache(path);
+}
+
+CmapCache* CmapCache::get() {
+    static CmapCache* sCache = createCache();
+    return sCache;
+}
+
+CmapCache::CmapCache(const char* cachePath)
+        : mCachePath(cachePath)
+        , mDirty(false)
+        , mFlushed(false) {
+    load();
+}
+
+CmapCache::~CmapCache() {
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        SkSafeUnref(mEntries[i].cmap);
+    }
+}
+
+void CmapCache::load() {
+    // The cmaps are subsets of the mapping, which they keep alive
+    SkData* data = SkData::NewFromFileName(mCachePath.string());
+    if (data == NULL) {
+        return;
+    }
+    const uint8_t* bytes = data->bytes();
+    const size_t length = data->size();
+    CacheHeader header;
+    if (length < sizeof(header)) {
+        data->unref();
+        return;
+    }
+    memcpy(&header, bytes, sizeof(header));
+    if (header.magic != kCacheMagic || header.version != kCacheVersion) {
+        ALOGW("Ignoring cmap cache %s of version %u", mCachePath.string(), header.version);
+        data->unref();
+        return;
+    }
+
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.count; i++) {
+        CacheEntryHeader entryHeader;
+        if (length - offset < sizeof(entryHeader)) {
+            break;
+        }
+        memcpy(&entryHeader, bytes + offset, sizeof(entryHeader));
+        const size_t dataOffset = offset + sizeof(entryHeader);
+        if (entryHeader.pathLength > length - dataOffset
+                || entryHeader.cmapSize > length - dataOffset - entryHeader.pathLength) {
+            ALOGW("Truncated cmap cache %s", mCachePath.string());
+            break;
+        }
+        Entry entry;
+        entry.fileSize = entryHeader.fileSize;
+        entry.modifiedTime = entryHeader.modifiedTime;
+        entry.cmap = SkData::NewSubset(data, dataOffset + entryHeader.pathLength,
+                entryHeader.cmapSize);
+        mEntries.add(String8(reinterpret_cast<const char*>(bytes + dataOffset),
+                entryHeader.pathLength), entry);
+        offset = alignEntry(dataOffset + entryHeader.pathLength + entryHeader.cmapSize);
+        if (offset > length) {
+            break;
+        }
+    }
+    data->unref();
+}
+
+SkData* CmapCache::find(const char* path, const struct stat& st) {
+    AutoMutex _l(mLock);
+    ssize_t index = mEntries.indexOfKey(String8(path));
+    if (index < 0) {
+        return NULL;
+    }
+    Entry& entry = mEntries.editValueAt(index);
+    if (entry.fileSize != st.st_size || entry.modifiedTime != st.st_mtime) {
+        SkSafeUnref(entry.cmap);
+        mEntries.removeItemsAt(index);
+        mDirty = true;
+        return NULL;
+    }
+    entry.used = true;
+    entry.cmap->ref();
+    return entry.cmap;
+}
+
+void CmapCache::add(const char* path, const struct stat& st, const uint8_t* cmap, size_t size) {
+    if (strncmp(path, kSystemPrefix, sizeof(kSystemPrefix) - 1) != 0) {
+        return;
+    }
+    AutoMutex _l(mLock);
+    if (mFlushed || mEntries.indexOfKey(String8(path)) >= 0) {
+        return;
+    }
+    Vector<uint8_t> reduced;
+    if (!reduceCmap(cmap, size, &reduced)) {
+        return;
+    }
+    Entry entry;
+    entry.fileSize = st.st_size;
+    entry.modifiedTime = st.st_mtime;
+    entry.cmap = SkData::NewWithCopy(reduced.array(), reduced.size());
+    entry.used = true;
+    mEntries.add(String8(path), entry);
+    mDirty = true;
+}
+
+void CmapCache::flush() {
+    AutoMutex _l(mLock);
+    if (mFlushed) {
+        return;
+    }
+    mFlushed = true;
+
+    // The entries of fonts that are gone are dropped as well
+    uint32_t count = 0;
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        if (mEntries[i].used) {
+            count++;
+        }
+    }
+    if (!mDirty && count == mEntries.size()) {
+        return;
+    }
+
+    String8 tempPath(mCachePath);
+    tempPath.append(".tmp");
+    FILE* file = fopen(tempPath.string(), "w");
+    if (file == NULL) {
+        ALOGW("Can't write cmap cache %s: %s", tempPath.string(), strerror(errno));
+        return;
+    }
+    static const uint8_t kPadding[8] = { 0 };
+    CacheHeader header = { kCacheMagic, kCacheVersion, count, 0 };
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (size_t i = 0; written && i < mEntries.size(); i++) {
+        const Entry& entry = mEntries[i];
+        if (!entry.used) {
+            continue;
+        }
+        const String8& path = mEntries.keyAt(i);
+        CacheEntryHeader entryHeader = { static_cast<uint32_t>(path.length()),
+                static_cast<uint32_t>(entry.cmap->size()), entry.fileSize, entry.modifiedTime };
+        const size_t entrySize = sizeof(entryHeader) + path.length() + entry.cmap->size();
+        const size_t padding = alignEntry(entrySize) - entrySize;
+        written = fwrite(&entryHeader, sizeof(entryHeader), 1, file) == 1
+                && fwrite(path.string(), 1, path.length(), file) == path.length()
+                && fwrite(entry.cmap->data(), 1, entry.cmap->size(), file) == entry.cmap->size()
+                && fwrite(kPadding, 1, padding, file) == padding;
+    }
+    if (fclose(file) != 0 || !written) {
+        ALOGW("Failed to write cmap cache %s", tempPath.string());
+        unlink(tempPath.string());
+        return;
+    }
+    if (rename(tempPath.string(), mCachePath.string()) != 0) {
+        ALOGW("Can't replace cmap cache %s: %s", mCachePath.string(), strerror(errno));
+        unlink(tempPath.string());
+    }
+}
+
+}  // namespace android
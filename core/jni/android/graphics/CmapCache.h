@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _ANDROID_GRAPHICS_CMAP_CACHE_H_
+#define _ANDROID_GRAPHICS_CMAP_CACHE_H_
+
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/String8.h>
+
+#include <sys/stat.h>
+
+class SkData;
+
+namespace android {
+
+/**
+ * A persistent cache of the cmaps of the system fonts, keyed by the path,
+ * size and modification time of their file.
+ *
+ * The cmaps are stored reduced to the subtables Minikin reads: the Unicode
+ * mapping, as a format 12 subtable of ranges, and the variation sequences.
+ * Building the FontCollections at boot then reads them from the one cache
+ * file, instead of faulting in the cmap of every font file and walking the
+ * glyph arrays of their format 4 subtables.
+ *
+ * The cache is only enabled when ro.graphics.font_cmap_cache names its file.
+ */
+class CmapCache {
+public:
+    // Returns the cache of the process, or NULL if it isn't enabled
+    static CmapCache* get();
+
+    // Returns the cached cmap of the font file, or NULL if it isn't cached or
+    // the file has changed. The caller owns a reference to the returned data.
+    SkData* find(const char* path, const struct stat& st);
+
+    // Reduces the cmap of the font file, to be written by the next flush().
+    // Fonts added after the first flush aren't cached.
+    void add(const char* path, const struct stat& st, const uint8_t* cmap, size_t size);
+
+    // Writes the cmaps found or added since the cache was loaded, if any were
+    // added, and stops caching new ones.
+    void flush();
+
+    // Reduces a cmap table to a format 12 subtable built from its Unicode
+    // subtable, and its variation sequences subtable if any. Returns false
+    // if the table has no Unicode subtable Minikin can use.
+    static bool reduceCmap(const uint8_t* cmap, size_t size, Vector<uint8_t>* outCmap);
+
+private:
+    struct Entry {
+        Entry() : fileSize(0), modifiedTime(0), cmap(NULL), used(false) { }
+
+        int64_t fileSize;
+        int64_t modifiedTime;
+        SkData* cmap;
+        // Found or added since the cache was loaded, so worth writing again
+        bool used;
+    };
+
+    explicit CmapCache(const char* cachePath);
+    ~CmapCache();
+
+    void load();
+
+    Mutex mLock;
+    String8 mCachePath;
+    KeyedVector<String8, Entry> mEntries;
+    bool mDirty;
+    bool mFlushed;
+};
+
+}  // namespace android
+
+#endif  // _ANDROID_GRAPHICS_CMAP_CACHE_H_
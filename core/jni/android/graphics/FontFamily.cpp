@@ -56,29 +56,32 @@ static jboolean addSkTypeface(FontFamily* family, SkTypeface* face) {
     return result;
 }
 
+// Fonts from files are created lazily: most of the system fonts are only ever
+// asked for their coverage, which comes straight from the mapped file.
 static jboolean FontFamily_addFont(JNIEnv* env, jobject clazz, jlong familyPtr, jstring path) {
     NPE_CHECK_RETURN_ZERO(env, path);
     ScopedUtfChars str(env, path);
-    SkTypeface* face = SkTypeface::CreateFromFile(str.c_str());
-    if (face == NULL) {
+    MinikinFont* minikinFont = MinikinFontSkia::createLazy(str.c_str());
+    if (minikinFont == NULL) {
         ALOGE("addFont failed to create font %s", str.c_str());
         return false;
     }
     FontFamily* fontFamily = reinterpret_cast<FontFamily*>(familyPtr);
-    return addSkTypeface(fontFamily, face);
+    bool result = fontFamily->addFont(minikinFont);
+    minikinFont->Unref();
+    return result;
 }
 
 static jboolean FontFamily_addFontWeightStyle(JNIEnv* env, jobject clazz, jlong familyPtr,
         jstring path, jint weight, jboolean isItalic) {
     NPE_CHECK_RETURN_ZERO(env, path);
     ScopedUtfChars str(env, path);
-    SkTypeface* face = SkTypeface::CreateFromFile(str.c_str());
-    if (face == NULL) {
+    MinikinFont* minikinFont = MinikinFontSkia::createLazy(str.c_str());
+    if (minikinFont == NULL) {
         ALOGE("addFont failed to create font %s", str.c_str());
         return false;
     }
     FontFamily* fontFamily = reinterpret_cast<FontFamily*>(familyPtr);
-    MinikinFont* minikinFont = new MinikinFontSkia(face);
     fontFamily->addFont(minikinFont, FontStyle(weight / 100, isItalic));
     minikinFont->Unref();
     return true;
@@ -14,27 +14,130 @@
  * limitations under the License.
  */
 
+#include <string.h>
+#include <sys/stat.h>
+
+#include <SkData.h>
+#include <SkStream.h>
 #include <SkTypeface.h>
 #include <SkPaint.h>
 
 #define LOG_TAG "Minikin"
 #include <cutils/log.h>
 
+#include "CmapCache.h"
 #include "MinikinSkia.h"
 
 namespace android {
 
 MinikinFontSkia::MinikinFontSkia(SkTypeface *typeface) :
-    mTypeface(typeface) {
+    mTypeface(typeface), mData(NULL), mCmap(NULL) {
+}
+
+MinikinFontSkia::MinikinFontSkia(SkData* data, SkData* cmap) :
+    mTypeface(NULL), mData(data), mCmap(cmap) {
 }
 
 MinikinFontSkia::~MinikinFontSkia() {
-    SkSafeUnref(mTypeface);
+    SkSafeUnref(mTypeface.load(std::memory_order_relaxed));
+    SkSafeUnref(mData);
+    SkSafeUnref(mCmap);
+}
+
+static uint16_t readU16(const uint8_t* p) {
+    return (uint16_t(p[0]) << 8) | p[1];
+}
+
+static uint32_t readU32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+// Finds a table in the directory of an sfnt font, or of the first font of a
+// collection. Returns false if the data isn't a font, or has no such table.
+static bool findSfntTable(const SkData* data, uint32_t tag, const uint8_t** table, size_t* size) {
+    const uint8_t* bytes = data->bytes();
+    const size_t length = data->size();
+    size_t dirOffset = 0;
+    if (length >= 16 && readU32(bytes) == SkSetFourByteTag('t', 't', 'c', 'f')) {
+        if (readU32(bytes + 8) == 0) {
+            return false;
+        }
+        dirOffset = readU32(bytes + 12);
+    }
+    if (dirOffset > length || length - dirOffset < 12) {
+        return false;
+    }
+    const uint8_t* dir = bytes + dirOffset;
+    const uint16_t numTables = readU16(dir + 4);
+    if ((length - dirOffset - 12) / 16 < numTables) {
+        return false;
+    }
+    for (uint16_t i = 0; i < numTables; i++) {
+        const uint8_t* record = dir + 12 + i * 16;
+        if (readU32(record) != tag) {
+            continue;
+        }
+        const uint32_t offset = readU32(record + 8);
+        const uint32_t tableSize = readU32(record + 12);
+        if (offset > length || tableSize > length - offset) {
+            return false;
+        }
+        *table = bytes + offset;
+        *size = tableSize;
+        return true;
+    }
+    return false;
+}
+
+MinikinFontSkia* MinikinFontSkia::createLazy(const char* path) {
+    SkData* data = SkData::NewFromFileName(path);
+    if (data == NULL) {
+        return NULL;
+    }
+    const uint8_t* table;
+    size_t size;
+    // Every font that Minikin can use has a cmap
+    if (!findSfntTable(data, SkSetFourByteTag('c', 'm', 'a', 'p'), &table, &size)) {
+        data->unref();
+        return NULL;
+    }
+
+    // The system fonts' cmaps are read from the cache file after the first
+    // boot, their own are only needed for new or updated fonts.
+    SkData* cmap = NULL;
+    CmapCache* cache = CmapCache::get();
+    struct stat st;
+    if (cache != NULL && stat(path, &st) == 0) {
+        cmap = cache->find(path, st);
+        if (cmap == NULL) {
+            cache->add(path, st, table, size);
+        }
+    }
+    return new MinikinFontSkia(data, cmap);
+}
+
+SkTypeface* MinikinFontSkia::typeface() const {
+    SkTypeface* face = mTypeface.load(std::memory_order_acquire);
+    if (face != NULL) {
+        return face;
+    }
+    AutoMutex _l(mLock);
+    face = mTypeface.load(std::memory_order_relaxed);
+    if (face == NULL) {
+        // The stream shares the mapping, so the file isn't read again.
+        face = SkTypeface::CreateFromStream(new SkMemoryStream(mData));
+        if (face == NULL) {
+            ALOGE("failed to create typeface for a %zu byte font", mData->size());
+            face = SkTypeface::RefDefault();
+        }
+        mTypeface.store(face, std::memory_order_release);
+    }
+    return face;
 }
 
 bool MinikinFontSkia::GetGlyph(uint32_t codepoint, uint32_t *glyph) const {
     SkPaint paint;
-    paint.setTypeface(mTypeface);
+    paint.setTypeface(typeface());
     paint.setTextEncoding(SkPaint::kUTF32_TextEncoding);
     uint16_t glyph16;
     paint.textToGlyphs(&codepoint, sizeof(codepoint), &glyph16);
@@ -60,7 +163,7 @@ float MinikinFontSkia::GetHorizontalAdvance(uint32_t glyph_id,
     MinikinFontSkia_SetSkiaPaint(this, &skPaint, paint);
     skPaint.getTextWidths(&glyph16, sizeof(glyph16), &skWidth, NULL);
 #ifdef VERBOSE
-    ALOGD("width for typeface %d glyph %d = %f", mTypeface->uniqueID(), glyph_id, skWidth);
+    ALOGD("width for typeface %d glyph %d = %f", typeface()->uniqueID(), glyph_id, skWidth);
 #endif
     return skWidth;
 }
@@ -79,23 +182,40 @@ void MinikinFontSkia::GetBounds(MinikinRect* bounds, uint32_t glyph_id,
 }
 
 bool MinikinFontSkia::GetTable(uint32_t tag, uint8_t *buf, size_t *size) {
+    if (mData != NULL) {
+        const uint8_t* table;
+        size_t tableSize;
+        if (mCmap != NULL && tag == SkSetFourByteTag('c', 'm', 'a', 'p')) {
+            table = mCmap->bytes();
+            tableSize = mCmap->size();
+        } else if (!findSfntTable(mData, tag, &table, &tableSize)) {
+            *size = 0;
+            return false;
+        }
+        if (buf != NULL) {
+            tableSize = tableSize < *size ? tableSize : *size;
+            memcpy(buf, table, tableSize);
+        }
+        *size = tableSize;
+        return tableSize != 0;
+    }
     if (buf == NULL) {
-        const size_t tableSize = mTypeface->getTableSize(tag);
+        const size_t tableSize = typeface()->getTableSize(tag);
         *size = tableSize;
         return tableSize != 0;
     } else {
-        const size_t actualSize = mTypeface->getTableData(tag, 0, *size, buf);
+        const size_t actualSize = typeface()->getTableData(tag, 0, *size, buf);
         *size = actualSize;
         return actualSize != 0;
     }
 }
 
 SkTypeface *MinikinFontSkia::GetSkTypeface() const {
-    return mTypeface;
+    return typeface();
 }
 
 int32_t MinikinFontSkia::GetUniqueId() const {
-    return mTypeface->uniqueID();
+    return typeface()->uniqueID();
 }
 
 uint32_t MinikinFontSkia::packPaintFlags(const SkPaint* paint) {
@@ -18,6 +18,11 @@
 #define _ANDROID_GRAPHICS_MINIKIN_SKIA_H_
 
 #include <minikin/MinikinFont.h>
+#include <utils/Mutex.h>
+
+#include <atomic>
+
+class SkData;
 
 namespace android {
 
@@ -26,6 +31,11 @@ public:
     // Note: this takes ownership of the reference (will unref on dtor)
     explicit MinikinFontSkia(SkTypeface *typeface);
 
+    // Maps the font file at path, but only creates its SkTypeface the first
+    // time it's needed for glyphs; until then its tables come from the mapping.
+    // Returns NULL if the file can't be mapped or isn't an sfnt font.
+    static MinikinFontSkia* createLazy(const char* path);
+
     ~MinikinFontSkia();
 
     bool GetGlyph(uint32_t codepoint, uint32_t *glyph) const;
@@ -49,7 +59,19 @@ public:
     // set typeface and fake bold/italic parameters
     static void populateSkPaint(SkPaint* paint, const MinikinFont* font, FontFakery fakery);
 private:
-    SkTypeface *mTypeface;
+    MinikinFontSkia(SkData* data, SkData* cmap);
+
+    // Returns the SkTypeface, creating it if this font was created lazily
+    SkTypeface* typeface() const;
+
+    // Only taken to create the SkTypeface, which is published with a release
+    // store so that typeface() can read it without the lock afterwards
+    mutable Mutex mLock;
+    mutable std::atomic<SkTypeface*> mTypeface;
+    // The mapped font file of a lazily created font, or NULL
+    SkData* mData;
+    // The cmap of a lazily created font from the CmapCache, or NULL
+    SkData* mCmap;
 };
 
 }  // namespace android
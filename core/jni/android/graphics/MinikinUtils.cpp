@@ -17,6 +17,11 @@
 #define LOG_TAG "Minikin"
 #include <cutils/log.h>
 #include <string>
+#include <vector>
+
+#include <utils/JenkinsHash.h>
+#include <utils/LruCache.h>
+#include <utils/Mutex.h>
 
 #include "SkPathMeasure.h"
 #include "Paint.h"
@@ -26,6 +31,132 @@
 
 namespace android {
 
+// Measuring, laying out and drawing the same text each shape it again, so the
+// layouts of short runs are cached, keyed by everything doLayout() uses.
+static const size_t kMaxCachedContextLength = 256;
+static const uint32_t kLayoutCacheSize = 512;
+
+struct LayoutCacheKey {
+    std::vector<uint8_t> data;
+    hash_t hash;
+
+    bool operator==(const LayoutCacheKey& other) const {
+        return hash == other.hash && data == other.data;
+    }
+};
+
+inline hash_t hash_type(const LayoutCacheKey& key) {
+    return key.hash;
+}
+
+struct LayoutCacheEntry {
+    Layout layout;
+    // Referenced for as long as the entry exists, so that neither the fonts
+    // of the layout nor the address in its key can go away.
+    FontCollection* collection;
+};
+
+class LayoutCache : public OnEntryRemoved<LayoutCacheKey, LayoutCacheEntry*> {
+public:
+    LayoutCache() : mCache(kLayoutCacheSize), mHits(0), mMisses(0) {
+        mCache.setOnEntryRemovedListener(this);
+    }
+
+    bool get(const LayoutCacheKey& key, Layout* layout) {
+        AutoMutex _l(mLock);
+        LayoutCacheEntry* entry = mCache.get(key);
+        if (!entry) {
+            mMisses++;
+            return false;
+        }
+        mHits++;
+        *layout = entry->layout;
+        return true;
+    }
+
+    void put(const LayoutCacheKey& key, FontCollection* collection, const Layout& layout) {
+        LayoutCacheEntry* entry = new LayoutCacheEntry{ layout, collection };
+        collection->Ref();
+        AutoMutex _l(mLock);
+        if (!mCache.put(key, entry)) {
+            // Another thread laid out the same text meanwhile
+            freeEntry(entry);
+        }
+    }
+
+    void clear() {
+        AutoMutex _l(mLock);
+        mCache.clear();
+    }
+
+    void getStats(uint32_t* hits, uint32_t* misses) {
+        AutoMutex _l(mLock);
+        *hits = mHits;
+        *misses = mMisses;
+    }
+
+    void operator()(LayoutCacheKey&, LayoutCacheEntry*& entry) override {
+        freeEntry(entry);
+    }
+
+private:
+    static void freeEntry(LayoutCacheEntry* entry) {
+        entry->collection->Unref();
+        delete entry;
+    }
+
+    Mutex mLock;
+    LruCache<LayoutCacheKey, LayoutCacheEntry*> mCache;
+    uint32_t mHits;
+    uint32_t mMisses;
+};
+
+static LayoutCache& getLayoutCache() {
+    static LayoutCache* cache = new LayoutCache();
+    return *cache;
+}
+
+static void appendBytes(std::vector<uint8_t>* key, const void* data, size_t size) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    key->insert(key->end(), bytes, bytes + size);
+}
+
+template<typename T>
+static void appendValue(std::vector<uint8_t>* key, const T& value) {
+    appendBytes(key, &value, sizeof(value));
+}
+
+static void appendString(std::vector<uint8_t>* key, const std::string& str) {
+    appendValue(key, str.size());
+    appendBytes(key, str.data(), str.size());
+}
+
+static void makeLayoutCacheKey(LayoutCacheKey* key, const Paint* paint, int bidiFlags,
+        const FontCollection* font, const FontStyle& style, const MinikinPaint& minikinPaint,
+        const uint16_t* buf, size_t start, size_t count, size_t bufSize) {
+    std::vector<uint8_t>* data = &key->data;
+    data->reserve(bufSize * sizeof(uint16_t) + 128);
+    appendValue(data, font);
+    appendString(data, paint->getTextLocale());
+    appendValue(data, paint->getFontVariant());
+    // Typefaces of the same family but different styles share a FontCollection
+    appendValue(data, style.getWeight());
+    appendValue(data, style.getItalic());
+    appendValue(data, paint->getHyphenEdit());
+    appendString(data, minikinPaint.fontFeatureSettings);
+    appendValue(data, minikinPaint.size);
+    appendValue(data, minikinPaint.scaleX);
+    appendValue(data, minikinPaint.skewX);
+    appendValue(data, minikinPaint.letterSpacing);
+    appendValue(data, minikinPaint.paintFlags);
+    appendValue(data, bidiFlags);
+    appendValue(data, start);
+    appendValue(data, count);
+    appendValue(data, bufSize);
+    appendBytes(data, buf, bufSize * sizeof(uint16_t));
+    key->hash = JenkinsHashWhiten(JenkinsHashMixBytes(0, data->data(), data->size()));
+}
+
 FontStyle MinikinUtils::prepareMinikinPaint(MinikinPaint* minikinPaint, FontCollection** pFont,
         const Paint* paint, TypefaceImpl* typeface) {
     const TypefaceImpl* resolvedFace = TypefaceImpl_resolveDefault(typeface);
@@ -59,8 +190,31 @@ void MinikinUtils::doLayout(Layout* layout, const Paint* paint, int bidiFlags,
     FontCollection *font;
     MinikinPaint minikinPaint;
     FontStyle minikinStyle = prepareMinikinPaint(&minikinPaint, &font, paint, typeface);
+
+    if (bufSize > kMaxCachedContextLength) {
+        layout->setFontCollection(font);
+        layout->doLayout(buf, start, count, bufSize, bidiFlags, minikinStyle, minikinPaint);
+        return;
+    }
+
+    LayoutCacheKey key;
+    makeLayoutCacheKey(&key, paint, bidiFlags, font, minikinStyle, minikinPaint, buf, start, count,
+            bufSize);
+    LayoutCache& cache = getLayoutCache();
+    if (cache.get(key, layout)) {
+        return;
+    }
     layout->setFontCollection(font);
     layout->doLayout(buf, start, count, bufSize, bidiFlags, minikinStyle, minikinPaint);
+    cache.put(key, font, *layout);
+}
+
+void MinikinUtils::purgeLayoutCache() {
+    getLayoutCache().clear();
+}
+
+void MinikinUtils::getLayoutCacheStats(uint32_t* hits, uint32_t* misses) {
+    getLayoutCache().getStats(hits, misses);
 }
 
 float MinikinUtils::xOffsetForTextAlign(Paint* paint, const Layout& layout) {
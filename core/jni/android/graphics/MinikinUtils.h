@@ -40,6 +40,12 @@ public:
             TypefaceImpl* typeface, const uint16_t* buf, size_t start, size_t count,
             size_t bufSize);
 
+    // Frees the layouts cached by doLayout()
+    static void purgeLayoutCache();
+
+    // Reports how many doLayout() calls were answered from the cache
+    static void getLayoutCacheStats(uint32_t* hits, uint32_t* misses);
+
     static float xOffsetForTextAlign(Paint* paint, const Layout& layout);
 
     static float hOffsetForTextAlign(Paint* paint, const Layout& layout, const SkPath& path);
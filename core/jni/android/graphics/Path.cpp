@@ -28,6 +28,7 @@
 #include "SkPathOps.h"
 
 #include <Caches.h>
+#include <ScopedPrimitiveArray.h>
 #include <vector>
 #include <map>
 
@@ -269,6 +270,146 @@ public:
         return Op(*p1, *p2, op, r);
      }
 
+    // Returns how many floats follow a verb in the arrays of addSegments() and
+    // getSegments(): its new points, and for a conic also its weight. Returns
+    // -1 for values that aren't verbs.
+    static int segmentCoordCount(jbyte verb) {
+        switch (verb) {
+            case SkPath::kMove_Verb:
+            case SkPath::kLine_Verb:
+                return 2;
+            case SkPath::kQuad_Verb:
+                return 4;
+            case SkPath::kConic_Verb:
+                return 5;
+            case SkPath::kCubic_Verb:
+                return 6;
+            case SkPath::kClose_Verb:
+                return 0;
+            default:
+                return -1;
+        }
+    }
+
+    // Appends verbCount SkPath::Verb values and their coordinates to the path
+    // in a single call, so that building large paths doesn't cost a JNI
+    // transition per point.
+    static void addSegments(JNIEnv* env, jobject clazz, jlong objHandle, jbyteArray verbArray,
+            jint verbCount, jfloatArray coordArray, jint coordCount) {
+        SkPath* obj = reinterpret_cast<SkPath*>(objHandle);
+        ScopedByteArrayRO verbs(env, verbArray);
+        ScopedFloatArrayRO coords(env, coordArray);
+        if (verbs.get() == NULL || coords.get() == NULL) {
+            return;
+        }
+        if (verbCount < 0 || coordCount < 0 || static_cast<size_t>(verbCount) > verbs.size()
+                || static_cast<size_t>(coordCount) > coords.size()) {
+            doThrowAIOOBE(env);
+            return;
+        }
+
+        int64_t neededCoords = 0;
+        for (jint i = 0; i < verbCount; i++) {
+            int count = segmentCoordCount(verbs[i]);
+            if (count < 0) {
+                doThrowIAE(env, "Unknown path verb");
+                return;
+            }
+            neededCoords += count;
+        }
+        if (neededCoords != coordCount) {
+            doThrowIAE(env, "Coordinate count doesn't match the verbs");
+            return;
+        }
+
+        obj->incReserve(coordCount / 2);
+        const float* c = coords.get();
+        for (jint i = 0; i < verbCount; i++) {
+            switch (verbs[i]) {
+                case SkPath::kMove_Verb:
+                    obj->moveTo(c[0], c[1]);
+                    break;
+                case SkPath::kLine_Verb:
+                    obj->lineTo(c[0], c[1]);
+                    break;
+                case SkPath::kQuad_Verb:
+                    obj->quadTo(c[0], c[1], c[2], c[3]);
+                    break;
+                case SkPath::kConic_Verb:
+                    obj->conicTo(c[0], c[1], c[2], c[3], c[4]);
+                    break;
+                case SkPath::kCubic_Verb:
+                    obj->cubicTo(c[0], c[1], c[2], c[3], c[4], c[5]);
+                    break;
+                case SkPath::kClose_Verb:
+                    obj->close();
+                    break;
+            }
+            c += segmentCoordCount(verbs[i]);
+        }
+    }
+
+    static jint countVerbs(JNIEnv* env, jobject clazz, jlong objHandle) {
+        SkPath* obj = reinterpret_cast<SkPath*>(objHandle);
+        return obj->countVerbs();
+    }
+
+    // Fills verbArray, which must hold countVerbs() values, with the verbs of
+    // the path, and returns their coordinates laid out as addSegments() takes
+    // them.
+    static jfloatArray getSegments(JNIEnv* env, jobject clazz, jlong objHandle,
+            jbyteArray verbArray) {
+        NPE_CHECK_RETURN_ZERO(env, verbArray);
+        SkPath* obj = reinterpret_cast<SkPath*>(objHandle);
+        const int verbCount = obj->countVerbs();
+        if (env->GetArrayLength(verbArray) < verbCount) {
+            doThrowAIOOBE(env);
+            return NULL;
+        }
+
+        std::vector<jbyte> verbs;
+        std::vector<float> coords;
+        verbs.reserve(verbCount);
+        coords.reserve(obj->countPoints() * 2 + verbCount);
+        SkPath::RawIter iter(*obj);
+        SkPath::Verb verb;
+        SkPoint pts[4];
+        while ((verb = iter.next(pts)) != SkPath::kDone_Verb) {
+            verbs.push_back(verb);
+            switch (verb) {
+                case SkPath::kMove_Verb:
+                    coords.push_back(pts[0].fX);
+                    coords.push_back(pts[0].fY);
+                    break;
+                case SkPath::kLine_Verb:
+                case SkPath::kQuad_Verb:
+                case SkPath::kConic_Verb:
+                case SkPath::kCubic_Verb: {
+                    // The first point is the end of the previous segment
+                    int newPoints = segmentCoordCount(verb) / 2;
+                    for (int i = 1; i <= newPoints; i++) {
+                        coords.push_back(pts[i].fX);
+                        coords.push_back(pts[i].fY);
+                    }
+                    if (verb == SkPath::kConic_Verb) {
+                        coords.push_back(iter.conicWeight());
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+
+        env->SetByteArrayRegion(verbArray, 0, verbs.size(), verbs.data());
+        jfloatArray result = env->NewFloatArray(coords.size());
+        if (result == NULL) {
+            return NULL;
+        }
+        env->SetFloatArrayRegion(result, 0, coords.size(), coords.data());
+        return result;
+    }
+
     typedef SkPoint (*bezierCalculation)(float t, const SkPoint* points);
 
     static void addMove(std::vector<SkPoint>& segmentPoints, std::vector<float>& lengths,
@@ -517,7 +658,16 @@ static JNINativeMethod methods[] = {
     {"native_approximate", "(JF)[F", (void*) SkPathGlue::approximate},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod optionalMethods[] = {
+    {"native_addSegments","(J[BI[FI)V", (void*) SkPathGlue::addSegments},
+    {"native_countVerbs","(J)I", (void*) SkPathGlue::countVerbs},
+    {"native_getSegments","(J[B)[F", (void*) SkPathGlue::getSegments},
+};
+
 int register_android_graphics_Path(JNIEnv* env) {
+    RegisterOptionalMethods(env, "android/graphics/Path", optionalMethods,
+                            NELEM(optionalMethods));
     return RegisterMethodsOrDie(env, "android/graphics/Path", methods, NELEM(methods));
 }
 
@@ -15,7 +15,9 @@
  */
 
 #include "Canvas.h"
+#include "DisplayListCanvas.h"
 #include "Picture.h"
+#include "RenderNode.h"
 
 #include "SkStream.h"
 
@@ -27,6 +29,7 @@ Picture::Picture(const Picture* src) {
         mHeight = src->height();
         if (NULL != src->mPicture.get()) {
             mPicture.reset(SkRef(src->mPicture.get()));
+            mRenderNode = src->mRenderNode;
         } else if (NULL != src->mRecorder.get()) {
             mPicture.reset(src->makePartialCopy());
         }
@@ -37,8 +40,12 @@ Picture::Picture(const Picture* src) {
     }
 }
 
+Picture::~Picture() {
+}
+
 Canvas* Picture::beginRecording(int width, int height) {
     mPicture.reset(NULL);
+    mRenderNode.clear();
     mRecorder.reset(new SkPictureRecorder);
     mWidth = width;
     mHeight = height;
@@ -101,8 +108,35 @@ void Picture::draw(Canvas* canvas) {
     }
     validate();
     if (NULL != mPicture.get()) {
-        mPicture.get()->playback(canvas->asSkCanvas());
+        if (canvas->isHardwareAccelerated()) {
+            // Reuses the ops translated the first time instead of going
+            // through SkiaCanvasProxy again, and lets them be merged. The
+            // parent's display list holds its own reference to the node, so
+            // it outlives this Picture and a new recording of it.
+            static_cast<uirenderer::DisplayListCanvas*>(canvas)->drawRenderNode(renderNode());
+        } else {
+            mPicture.get()->playback(canvas->asSkCanvas());
+        }
+    }
+}
+
+uirenderer::RenderNode* Picture::renderNode() {
+    if (NULL == mRenderNode.get()) {
+        uirenderer::DisplayListCanvas recorder;
+        recorder.setViewport(mWidth, mHeight);
+        recorder.prepare();
+        mPicture.get()->playback(recorder.asSkCanvas());
+
+        mRenderNode = new uirenderer::RenderNode();
+        mRenderNode->setName("Picture");
+        mRenderNode->setStagingDisplayList(recorder.finishRecording());
+        uirenderer::RenderProperties& properties = mRenderNode->mutateStagingProperties();
+        properties.setLeftTopRightBottom(0, 0, mWidth, mHeight);
+        // Skia does not clip a picture to its bounds on playback either
+        properties.setClipToBounds(false);
+        mRenderNode->setPropertyFieldsDirty(uirenderer::RenderNode::GENERIC);
     }
+    return mRenderNode.get();
 }
 
 SkPicture* Picture::makePartialCopy() const {
@@ -22,6 +22,8 @@
 #include "SkRefCnt.h"
 #include "SkTemplates.h"
 
+#include <utils/StrongPointer.h>
+
 class SkStream;
 class SkWStream;
 
@@ -29,6 +31,10 @@ namespace android {
 
 class Canvas;
 
+namespace uirenderer {
+class RenderNode;
+};
+
 // Skia's SkPicture class has been split into an SkPictureRecorder
 // and an SkPicture. AndroidPicture recreates the functionality
 // of the old SkPicture interface by flip-flopping between the two
@@ -36,6 +42,7 @@ class Canvas;
 class Picture {
 public:
     explicit Picture(const Picture* src = NULL);
+    ~Picture();
 
     Canvas* beginRecording(int width, int height);
 
@@ -56,11 +63,16 @@ private:
     int mHeight;
     SkAutoTUnref<const SkPicture> mPicture;
     SkAutoTDelete<SkPictureRecorder> mRecorder;
+    // The content of mPicture translated to hwui ops, created the first time
+    // the picture is drawn on a hardware canvas
+    sp<uirenderer::RenderNode> mRenderNode;
 
     // Make a copy of a picture that is in the midst of being recorded. The
     // resulting picture will have balanced saves and restores.
     SkPicture* makePartialCopy() const;
 
+    uirenderer::RenderNode* renderNode();
+
     void validate() const;
 };
 
@@ -31,6 +31,7 @@
 #include <minikin/FontFamily.h>
 #include <minikin/Layout.h>
 #include "SkPaint.h"
+#include "CmapCache.h"
 #include "MinikinSkia.h"
 
 #include "TypefaceImpl.h"
@@ -175,6 +176,11 @@ int TypefaceImpl_getStyle(TypefaceImpl* face) {
 
 void TypefaceImpl_setDefault(TypefaceImpl* face) {
     gDefaultTypeface = face;
+    // The system fonts are all loaded by now
+    CmapCache* cache = CmapCache::get();
+    if (cache != NULL) {
+        cache->flush();
+    }
 }
 
 }
@@ -8,6 +8,74 @@
 
 #include <jni.h>
 
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Splits count VU pairs into count U and count V bytes.
+static void splitVu(const uint8_t* vu, uint8_t* u, uint8_t* v, int count) {
+    int i = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t pairs = vld2q_u8(vu + i * 2);
+        vst1q_u8(v + i, pairs.val[0]);
+        vst1q_u8(u + i, pairs.val[1]);
+    }
+#elif defined(__SSE2__)
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (vu + i * 2));
+        __m128i b = _mm_loadu_si128((const __m128i*) (vu + i * 2 + 16));
+        __m128i vs = _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes));
+        __m128i us = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i*) (v + i), vs);
+        _mm_storeu_si128((__m128i*) (u + i), us);
+    }
+#endif
+    for (; i < count; i++) {
+        v[i] = vu[i * 2];
+        u[i] = vu[i * 2 + 1];
+    }
+}
+
+// Splits count YUYV groups into count * 2 Y, count U and count V bytes.
+static void splitYuyv(const uint8_t* yuyv, uint8_t* y, uint8_t* u, uint8_t* v, int count) {
+    int i = 0;
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t groups = vld4q_u8(yuyv + i * 4);
+        uint8x16x2_t ys;
+        ys.val[0] = groups.val[0];
+        ys.val[1] = groups.val[2];
+        vst2q_u8(y + i * 2, ys);
+        vst1q_u8(u + i, groups.val[1]);
+        vst1q_u8(v + i, groups.val[3]);
+    }
+#elif defined(__SSE2__)
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (yuyv + i * 4));
+        __m128i b = _mm_loadu_si128((const __m128i*) (yuyv + i * 4 + 16));
+        __m128i ys = _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes));
+        __m128i uvs = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        __m128i us = _mm_packus_epi16(_mm_and_si128(uvs, lowBytes), zero);
+        __m128i vs = _mm_packus_epi16(_mm_srli_epi16(uvs, 8), zero);
+        _mm_storeu_si128((__m128i*) (y + i * 2), ys);
+        _mm_storel_epi64((__m128i*) (u + i), us);
+        _mm_storel_epi64((__m128i*) (v + i), vs);
+    }
+#endif
+    for (; i < count; i++) {
+        y[i * 2] = yuyv[i * 4];
+        y[i * 2 + 1] = yuyv[i * 4 + 2];
+        u[i] = yuyv[i * 4 + 1];
+        v[i] = yuyv[i * 4 + 3];
+    }
+}
+
 YuvToJpegEncoder* YuvToJpegEncoder::create(int format, int* strides) {
     // Only ImageFormat.NV21 and ImageFormat.YUY2 are supported
     // for now.
@@ -120,13 +188,8 @@ void Yuv420SpToJpegEncoder::deinterleave(uint8_t* vuPlanar, uint8_t* uRows,
     if (numRows > 8) numRows = 8;
     for (int row = 0; row < numRows; ++row) {
         int offset = ((rowIndex >> 1) + row) * fStrides[1];
-        uint8_t* vu = vuPlanar + offset;
-        for (int i = 0; i < (width >> 1); ++i) {
-            int index = row * (width >> 1) + i;
-            uRows[index] = vu[1];
-            vRows[index] = vu[0];
-            vu += 2;
-        }
+        int index = row * (width >> 1);
+        splitVu(vuPlanar + offset, uRows + index, vRows + index, width >> 1);
     }
 }
 
@@ -195,15 +258,8 @@ void Yuv422IToJpegEncoder::deinterleave(uint8_t* yuv, uint8_t* yRows, uint8_t* u
     if (numRows > 16) numRows = 16;
     for (int row = 0; row < numRows; ++row) {
         uint8_t* yuvSeg = yuv + (rowIndex + row) * fStrides[0];
-        for (int i = 0; i < (width >> 1); ++i) {
-            int indexY = row * width + (i << 1);
-            int indexU = row * (width >> 1) + i;
-            yRows[indexY] = yuvSeg[0];
-            yRows[indexY + 1] = yuvSeg[2];
-            uRows[indexU] = yuvSeg[1];
-            vRows[indexU] = yuvSeg[3];
-            yuvSeg += 4;
-        }
+        int indexU = row * (width >> 1);
+        splitYuyv(yuvSeg, yRows + row * width, uRows + indexU, vRows + indexU, width >> 1);
     }
 }
 
@@ -235,9 +291,10 @@ static jboolean YuvImage_compressToJpeg(JNIEnv* env, jobject, jbyteArray inYuv,
         result = JNI_TRUE;
     }
 
-    env->ReleaseByteArrayElements(inYuv, yuv, 0);
-    env->ReleaseIntArrayElements(offsets, imgOffsets, 0);
-    env->ReleaseIntArrayElements(strides, imgStrides, 0);
+    // Nothing was written to the arrays, so there's nothing to copy back.
+    env->ReleaseByteArrayElements(inYuv, yuv, JNI_ABORT);
+    env->ReleaseIntArrayElements(offsets, imgOffsets, JNI_ABORT);
+    env->ReleaseIntArrayElements(strides, imgStrides, JNI_ABORT);
     delete strm;
     return result;
 }
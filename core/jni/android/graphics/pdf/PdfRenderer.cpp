@@ -29,6 +29,7 @@
 #include "core_jni_helpers.h"
 #include <vector>
 #include <utils/Log.h>
+#include <utils/Timers.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -38,6 +39,13 @@ namespace android {
 static const int RENDER_MODE_FOR_DISPLAY = 1;
 static const int RENDER_MODE_FOR_PRINT = 2;
 
+static const int RENDER_STATUS_DONE = 0;
+static const int RENDER_STATUS_TO_BE_CONTINUED = 1;
+static const int RENDER_STATUS_FAILED = 2;
+
+// PDFium looks up the render context of a page under this key.
+static void* const RENDER_CONTEXT_KEY = (void*) 1;
+
 static struct {
     jfieldID x;
     jfieldID y;
@@ -158,18 +166,66 @@ static void DropContext(void* data) {
     delete (CRenderContext*) data;
 }
 
-static void renderPageBitmap(FPDF_BITMAP bitmap, FPDF_PAGE page, int destLeft, int destTop,
-        int destRight, int destBottom, SkMatrix* transform, int flags) {
+/**
+ * The state of a page render that's done in time slices, kept as the private
+ * data of its page between calls. Viewers can show a quick low resolution
+ * render first, then refine it with a high resolution one that they can stop
+ * between slices once the page scrolls away.
+ */
+class ProgressiveRenderContext : public CRenderContext {
+public:
+    ProgressiveRenderContext(const SkBitmap& bitmap, FPDF_BITMAP pdfBitmap)
+            : mBitmap(bitmap), mPdfBitmap(pdfBitmap) {
+        // Keeps the pixels in place until the render is done.
+        mBitmap.lockPixels();
+    }
+
+    ~ProgressiveRenderContext() {
+        // The device draws into mPdfBitmap, so it has to go first; the base
+        // class frees the rest.
+        delete m_pRenderer;
+        m_pRenderer = NULL;
+        delete m_pContext;
+        m_pContext = NULL;
+        delete m_pDevice;
+        m_pDevice = NULL;
+        FPDFBitmap_Destroy(mPdfBitmap);
+        mBitmap.unlockPixels();
+    }
+
+    SkBitmap& bitmap() { return mBitmap; }
+
+private:
+    SkBitmap mBitmap;
+    FPDF_BITMAP mPdfBitmap;
+};
+
+static void DropProgressiveContext(void* data) {
+    delete static_cast<ProgressiveRenderContext*>(data);
+}
+
+// Pauses a progressive render once its time slice is used up.
+class DeadlinePause : public IFX_Pause {
+public:
+    explicit DeadlinePause(nsecs_t deadline) : mDeadline(deadline) {}
+
+    virtual FX_BOOL NeedToPauseNow() {
+        return systemTime(SYSTEM_TIME_MONOTONIC) >= mDeadline;
+    }
+
+private:
+    nsecs_t mDeadline;
+};
+
+// Sets up pContext to render page into bitmap, up to starting its renderer.
+static void setUpRenderContext(CRenderContext* pContext, FPDF_BITMAP bitmap, CPDF_Page* pPage,
+        int destLeft, int destTop, int destRight, int destBottom, SkMatrix* transform,
+        int flags) {
     // Note: this code ignores the currently unused RENDER_NO_NATIVETEXT,
     // FPDF_RENDER_LIMITEDIMAGECACHE, FPDF_RENDER_FORCEHALFTONE, FPDF_GRAYSCALE,
     // and FPDF_ANNOT flags. To add support for that refer to FPDF_RenderPage_Retail
     // in fpdfview.cpp
 
-    CRenderContext* pContext = new CRenderContext;
-
-    CPDF_Page* pPage = (CPDF_Page*) page;
-    pPage->SetPrivateData((void*) 1, pContext, DropContext);
-
     CFX_FxgeDevice* fxgeDevice = new CFX_FxgeDevice;
     pContext->m_pDevice = fxgeDevice;
 
@@ -233,15 +289,37 @@ static void renderPageBitmap(FPDF_BITMAP bitmap, FPDF_PAGE page, int destLeft, i
     pageContext->AppendObjectList(pPage, &matrix);
 
     pContext->m_pRenderer = new CPDF_ProgressiveRenderer;
-    pContext->m_pRenderer->Start(pageContext, fxgeDevice, renderOptions, NULL);
+}
 
-    fxgeDevice->RestoreState();
+static void renderPageBitmap(FPDF_BITMAP bitmap, FPDF_PAGE page, int destLeft, int destTop,
+        int destRight, int destBottom, SkMatrix* transform, int flags) {
+    CRenderContext* pContext = new CRenderContext;
 
-    pPage->RemovePrivateData((void*) 1);
+    CPDF_Page* pPage = (CPDF_Page*) page;
+    pPage->SetPrivateData(RENDER_CONTEXT_KEY, pContext, DropContext);
+
+    setUpRenderContext(pContext, bitmap, pPage, destLeft, destTop, destRight, destBottom,
+            transform, flags);
+    pContext->m_pRenderer->Start(pContext->m_pContext, pContext->m_pDevice,
+            pContext->m_pOptions, NULL);
+
+    pContext->m_pDevice->RestoreState();
+
+    pPage->RemovePrivateData(RENDER_CONTEXT_KEY);
 
     delete pContext;
 }
 
+static int getRenderFlags(jint renderMode) {
+    int renderFlags = 0;
+    if (renderMode == RENDER_MODE_FOR_DISPLAY) {
+        renderFlags |= FPDF_LCD_TEXT;
+    } else if (renderMode == RENDER_MODE_FOR_PRINT) {
+        renderFlags |= FPDF_PRINTING;
+    }
+    return renderFlags;
+}
+
 static void nativeRenderPage(JNIEnv* env, jclass thiz, jlong documentPtr, jlong pagePtr,
         jobject jbitmap, jint destLeft, jint destTop, jint destRight, jint destBottom,
         jlong matrixPtr, jint renderMode) {
@@ -264,25 +342,104 @@ static void nativeRenderPage(JNIEnv* env, jclass thiz, jlong documentPtr, jlong
         return;
     }
 
-    int renderFlags = 0;
-    if (renderMode == RENDER_MODE_FOR_DISPLAY) {
-        renderFlags |= FPDF_LCD_TEXT;
-    } else if (renderMode == RENDER_MODE_FOR_PRINT) {
-        renderFlags |= FPDF_PRINTING;
-    }
-
     if (skMatrix && !skMatrix->asAffine(NULL)) {
+        FPDFBitmap_Destroy(bitmap);
         jniThrowException(env, "java/lang/IllegalArgumentException",
                 "transform matrix has perspective. Only affine matrices are allowed.");
         return;
     }
 
     renderPageBitmap(bitmap, page, destLeft, destTop, destRight,
-            destBottom, skMatrix, renderFlags);
+            destBottom, skMatrix, getRenderFlags(renderMode));
+    FPDFBitmap_Destroy(bitmap);
 
     skBitmap.notifyPixelsChanged();
 }
 
+// Runs the progressive render of the page for up to sliceMillis, and frees it
+// once it's done or has failed.
+static jint continueProgressiveRender(CPDF_Page* pPage, ProgressiveRenderContext* pContext,
+        jint sliceMillis) {
+    DeadlinePause pause(systemTime(SYSTEM_TIME_MONOTONIC)
+            + milliseconds_to_nanoseconds(sliceMillis));
+    CPDF_ProgressiveRenderer* renderer = pContext->m_pRenderer;
+    if (renderer->GetStatus() == CPDF_ProgressiveRenderer::Ready) {
+        renderer->Start(pContext->m_pContext, pContext->m_pDevice, pContext->m_pOptions, &pause);
+    } else {
+        renderer->Continue(&pause);
+    }
+
+    // Whatever is rendered so far can be shown
+    pContext->bitmap().notifyPixelsChanged();
+
+    const int status = renderer->GetStatus();
+    if (status == CPDF_ProgressiveRenderer::ToBeContinued) {
+        return RENDER_STATUS_TO_BE_CONTINUED;
+    }
+    pContext->m_pDevice->RestoreState();
+    pPage->RemovePrivateData(RENDER_CONTEXT_KEY);
+    delete pContext;
+    return status == CPDF_ProgressiveRenderer::Done ? RENDER_STATUS_DONE : RENDER_STATUS_FAILED;
+}
+
+static jint nativeStartRenderPage(JNIEnv* env, jclass thiz, jlong documentPtr, jlong pagePtr,
+        jobject jbitmap, jint destLeft, jint destTop, jint destRight, jint destBottom,
+        jlong matrixPtr, jint renderMode, jint sliceMillis) {
+
+    CPDF_Page* pPage = reinterpret_cast<CPDF_Page*>(pagePtr);
+    SkMatrix* skMatrix = reinterpret_cast<SkMatrix*>(matrixPtr);
+
+    if (skMatrix && !skMatrix->asAffine(NULL)) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                "transform matrix has perspective. Only affine matrices are allowed.");
+        return RENDER_STATUS_FAILED;
+    }
+
+    SkBitmap skBitmap;
+    GraphicsJNI::getSkBitmap(env, jbitmap, &skBitmap);
+
+    SkAutoLockPixels alp(skBitmap);
+
+    const int stride = skBitmap.width() * 4;
+
+    FPDF_BITMAP bitmap = FPDFBitmap_CreateEx(skBitmap.width(), skBitmap.height(),
+            FPDFBitmap_BGRA, skBitmap.getPixels(), stride);
+
+    if (!bitmap) {
+        ALOGE("Erorr creating bitmap");
+        return RENDER_STATUS_FAILED;
+    }
+
+    // Replacing the private data drops any render of the page still in progress.
+    ProgressiveRenderContext* pContext = new ProgressiveRenderContext(skBitmap, bitmap);
+    pPage->SetPrivateData(RENDER_CONTEXT_KEY, pContext, DropProgressiveContext);
+
+    setUpRenderContext(pContext, bitmap, pPage, destLeft, destTop, destRight, destBottom,
+            skMatrix, getRenderFlags(renderMode));
+    return continueProgressiveRender(pPage, pContext, sliceMillis);
+}
+
+static jint nativeContinueRenderPage(JNIEnv* env, jclass thiz, jlong pagePtr, jint sliceMillis) {
+    CPDF_Page* pPage = reinterpret_cast<CPDF_Page*>(pagePtr);
+    ProgressiveRenderContext* pContext = static_cast<ProgressiveRenderContext*>(
+            pPage->GetPrivateData(RENDER_CONTEXT_KEY));
+    if (!pContext) {
+        jniThrowException(env, "java/lang/IllegalStateException", "no render in progress");
+        return RENDER_STATUS_FAILED;
+    }
+    return continueProgressiveRender(pPage, pContext, sliceMillis);
+}
+
+static void nativeCancelRenderPage(JNIEnv* env, jclass thiz, jlong pagePtr) {
+    CPDF_Page* pPage = reinterpret_cast<CPDF_Page*>(pagePtr);
+    ProgressiveRenderContext* pContext = static_cast<ProgressiveRenderContext*>(
+            pPage->GetPrivateData(RENDER_CONTEXT_KEY));
+    if (pContext) {
+        pPage->RemovePrivateData(RENDER_CONTEXT_KEY);
+        delete pContext;
+    }
+}
+
 static JNINativeMethod gPdfRenderer_Methods[] = {
     {"nativeCreate", "(IJ)J", (void*) nativeCreate},
     {"nativeClose", "(J)V", (void*) nativeClose},
@@ -293,10 +450,20 @@ static JNINativeMethod gPdfRenderer_Methods[] = {
     {"nativeClosePage", "(J)V", (void*) nativeClosePage}
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gPdfRenderer_OptionalMethods[] = {
+    {"nativeStartRenderPage", "(JJLandroid/graphics/Bitmap;IIIIJII)I",
+            (void*) nativeStartRenderPage},
+    {"nativeContinueRenderPage", "(JI)I", (void*) nativeContinueRenderPage},
+    {"nativeCancelRenderPage", "(J)V", (void*) nativeCancelRenderPage},
+};
+
 int register_android_graphics_pdf_PdfRenderer(JNIEnv* env) {
     int result = RegisterMethodsOrDie(
             env, "android/graphics/pdf/PdfRenderer", gPdfRenderer_Methods,
             NELEM(gPdfRenderer_Methods));
+    RegisterOptionalMethods(env, "android/graphics/pdf/PdfRenderer",
+            gPdfRenderer_OptionalMethods, NELEM(gPdfRenderer_OptionalMethods));
 
     jclass clazz = FindClassOrDie(env, "android/graphics/Point");
     gPointClassInfo.x = GetFieldIDOrDie(env, clazz, "x", "I");
@@ -61,6 +61,27 @@ static void throwUnknownTypeException(JNIEnv * env, jint type) {
     jniThrowException(env, "java/lang/IllegalStateException", msg.string());
 }
 
+// Windows reserve up to this many times the size they're created with. The
+// pages of their ashmem region are only allocated once written, from the
+// start for the data and from the end for the row index, so a window only
+// takes the memory of the rows it holds. Results larger than the requested
+// size are then filled in one pass of the statement, instead of re-running
+// the query for every window.
+static const size_t kMaxWindowSizeFactor = 4;
+
+// The headroom is capped, as the whole region is mapped by every process the
+// window is sent to and counts against their address space.
+static const size_t kMaxWindowHeadroom = 2 * 1024 * 1024;
+
+static size_t reservedWindowSize(jint cursorWindowSize) {
+    if (cursorWindowSize <= 0) {
+        return cursorWindowSize;
+    }
+    const size_t size = cursorWindowSize;
+    const size_t headroom = size * (kMaxWindowSizeFactor - 1);
+    return size + (headroom < kMaxWindowHeadroom ? headroom : kMaxWindowHeadroom);
+}
+
 static jlong nativeCreate(JNIEnv* env, jclass clazz, jstring nameObj, jint cursorWindowSize) {
     String8 name;
     const char* nameStr = env->GetStringUTFChars(nameObj, NULL);
@@ -68,7 +89,11 @@ static jlong nativeCreate(JNIEnv* env, jclass clazz, jstring nameObj, jint curso
     env->ReleaseStringUTFChars(nameObj, nameStr);
 
     CursorWindow* window;
-    status_t status = CursorWindow::create(name, cursorWindowSize, &window);
+    status_t status = CursorWindow::create(name, reservedWindowSize(cursorWindowSize), &window);
+    if (status || !window) {
+        // Fall back to the requested size if the address space is scarce
+        status = CursorWindow::create(name, cursorWindowSize, &window);
+    }
     if (status || !window) {
         ALOGE("Could not allocate CursorWindow '%s' of size %d due to error %d.",
                 name.string(), cursorWindowSize, status);
@@ -395,6 +420,57 @@ static jdouble nativeGetDouble(JNIEnv* env, jclass clazz, jlong windowPtr,
     }
 }
 
+// The bulk getters read a column over the rows [startRow, startRow + length of
+// outValues) in one call, with the same conversions as the getters of a single
+// field. They stop at the first field that throws.
+
+static void nativeGetLongs(JNIEnv* env, jclass clazz, jlong windowPtr,
+        jint startRow, jint column, jlongArray outValues) {
+    const jsize count = env->GetArrayLength(outValues);
+    jlong* values = env->GetLongArrayElements(outValues, NULL);
+    if (!values) {
+        return;
+    }
+    for (jsize i = 0; i < count; i++) {
+        values[i] = nativeGetLong(env, clazz, windowPtr, startRow + i, column);
+        if (env->ExceptionCheck()) {
+            break;
+        }
+    }
+    env->ReleaseLongArrayElements(outValues, values, 0);
+}
+
+static void nativeGetDoubles(JNIEnv* env, jclass clazz, jlong windowPtr,
+        jint startRow, jint column, jdoubleArray outValues) {
+    const jsize count = env->GetArrayLength(outValues);
+    jdouble* values = env->GetDoubleArrayElements(outValues, NULL);
+    if (!values) {
+        return;
+    }
+    for (jsize i = 0; i < count; i++) {
+        values[i] = nativeGetDouble(env, clazz, windowPtr, startRow + i, column);
+        if (env->ExceptionCheck()) {
+            break;
+        }
+    }
+    env->ReleaseDoubleArrayElements(outValues, values, 0);
+}
+
+static void nativeGetStrings(JNIEnv* env, jclass clazz, jlong windowPtr,
+        jint startRow, jint column, jobjectArray outValues) {
+    const jsize count = env->GetArrayLength(outValues);
+    for (jsize i = 0; i < count; i++) {
+        jstring value = nativeGetString(env, clazz, windowPtr, startRow + i, column);
+        if (env->ExceptionCheck()) {
+            return;
+        }
+        env->SetObjectArrayElement(outValues, i, value);
+        if (value != gEmptyString) {
+            env->DeleteLocalRef(value);
+        }
+    }
+}
+
 static jboolean nativePutBlob(JNIEnv* env, jclass clazz, jlong windowPtr,
         jbyteArray valueObj, jint row, jint column) {
     CursorWindow* window = reinterpret_cast<CursorWindow*>(windowPtr);
@@ -524,6 +600,17 @@ static JNINativeMethod sMethods[] =
             (void*)nativePutNull },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod sOptionalMethods[] =
+{
+    { "nativeGetLongs", "(JII[J)V",
+            (void*)nativeGetLongs },
+    { "nativeGetDoubles", "(JII[D)V",
+            (void*)nativeGetDoubles },
+    { "nativeGetStrings", "(JII[Ljava/lang/String;)V",
+            (void*)nativeGetStrings },
+};
+
 int register_android_database_CursorWindow(JNIEnv* env)
 {
     jclass clazz = FindClassOrDie(env, "android/database/CharArrayBuffer");
@@ -533,6 +620,8 @@ int register_android_database_CursorWindow(JNIEnv* env)
 
     gEmptyString = MakeGlobalRefOrDie(env, env->NewStringUTF(""));
 
+    RegisterOptionalMethods(env, "android/database/CursorWindow", sOptionalMethods,
+                            NELEM(sOptionalMethods));
     return RegisterMethodsOrDie(env, "android/database/CursorWindow", sMethods, NELEM(sMethods));
 }
 
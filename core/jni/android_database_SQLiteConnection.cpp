@@ -24,6 +24,9 @@
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/String16.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
 #include <cutils/ashmem.h>
 #include <sys/mman.h>
 
@@ -68,6 +71,26 @@ static struct {
     jclass clazz;
 } gStringClassInfo;
 
+// Bucket i of a statement latency histogram counts runs under 2^i milliseconds, the
+// resolution sqlite3_profile times statements with.
+static const size_t kStatementStatsBuckets = 16;
+// Statements beyond this many distinct ones are accounted together.
+static const size_t kMaxStatementStats = 128;
+static const size_t kMaxNormalizedSqlLength = 256;
+
+struct StatementStats {
+    uint32_t count;
+    uint64_t totalNs;
+    uint64_t maxNs;
+    uint64_t rows;
+    uint32_t windowFills;
+    uint32_t histogram[kStatementStatsBuckets];
+
+    StatementStats() : count(0), totalNs(0), maxNs(0), rows(0), windowFills(0) {
+        memset(histogram, 0, sizeof(histogram));
+    }
+};
+
 struct SQLiteConnection {
     // Open flags.
     // Must be kept in sync with the constants defined in SQLiteDatabase.java.
@@ -86,10 +109,129 @@ struct SQLiteConnection {
 
     volatile bool canceled;
 
+    // Set with profiling on, the per-statement stats are always kept.
+    bool logProfile;
+    // Rows and window fills of the statement being reset, attributed by the profile callback.
+    uint64_t pendingRows;
+    uint32_t pendingWindowFills;
+    // Keyed by normalized SQL, guarded by statsLock since dumps come from other threads.
+    Mutex statsLock;
+    KeyedVector<String8, StatementStats> statementStats;
+
     SQLiteConnection(sqlite3* db, int openFlags, const String8& path, const String8& label) :
-        db(db), openFlags(openFlags), path(path), label(label), canceled(false) { }
+        db(db), openFlags(openFlags), path(path), label(label), canceled(false),
+        logProfile(false), pendingRows(0), pendingWindowFills(0) { }
 };
 
+static inline bool isSqlIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+            || c == '_';
+}
+
+// Returns the length of the UTF-8 sequence starting with the byte.
+static inline size_t utf8SequenceLength(unsigned char c) {
+    if ((c & 0xe0) == 0xc0) {
+        return 2;
+    } else if ((c & 0xf0) == 0xe0) {
+        return 3;
+    } else if ((c & 0xf8) == 0xf0) {
+        return 4;
+    }
+    return 1;
+}
+
+// Collapses whitespace and replaces string and numeric literals with '?', so statements
+// that only differ in inlined values share an entry. The result is valid modified UTF-8
+// for NewStringUTF: characters outside the BMP are replaced with '?' as well, and it is
+// only truncated between characters.
+static void normalizeSql(const char* sql, String8& out) {
+    char buffer[kMaxNormalizedSqlLength + 1];
+    size_t length = 0;
+    bool pendingSpace = false;
+    for (const char* p = sql; *p && length < kMaxNormalizedSqlLength; p++) {
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            pendingSpace = length > 0;
+            continue;
+        }
+        if (pendingSpace) {
+            buffer[length++] = ' ';
+            pendingSpace = false;
+            if (length == kMaxNormalizedSqlLength) {
+                break;
+            }
+        }
+        const bool afterIdentifier = length > 0 && isSqlIdentifierChar(buffer[length - 1]);
+        if (c == '\'') {
+            // Skip to the closing quote, '' is an escaped quote.
+            while (*++p) {
+                if (*p == '\'' && *(p + 1) != '\'') {
+                    break;
+                } else if (*p == '\'') {
+                    p++;
+                }
+            }
+            buffer[length++] = '?';
+            if (!*p) {
+                break;
+            }
+        } else if (c >= '0' && c <= '9' && !afterIdentifier) {
+            while (isSqlIdentifierChar(*(p + 1)) || *(p + 1) == '.') {
+                p++;
+            }
+            buffer[length++] = '?';
+        } else if (utf8SequenceLength(c) == 4) {
+            while ((*(p + 1) & 0xc0) == 0x80) {
+                p++;
+            }
+            buffer[length++] = '?';
+        } else {
+            buffer[length++] = c;
+        }
+    }
+
+    // Drop a character cut short by the length limit.
+    size_t start = length;
+    while (start > 0 && (buffer[start - 1] & 0xc0) == 0x80) {
+        start--;
+    }
+    if (start > 0 && length - (start - 1) < utf8SequenceLength(buffer[start - 1])) {
+        length = start - 1;
+    }
+    out.setTo(buffer, length);
+}
+
+static void recordStatementStats(SQLiteConnection* connection, const char* sql,
+        sqlite3_uint64 tm) {
+    String8 key;
+    normalizeSql(sql, key);
+
+    AutoMutex _l(connection->statsLock);
+    ssize_t index = connection->statementStats.indexOfKey(key);
+    if (index < 0) {
+        if (connection->statementStats.size() >= kMaxStatementStats) {
+            key.setTo("<other statements>");
+            index = connection->statementStats.indexOfKey(key);
+        }
+        if (index < 0) {
+            index = connection->statementStats.add(key, StatementStats());
+        }
+    }
+
+    StatementStats& stats = connection->statementStats.editValueAt(index);
+    stats.count++;
+    stats.totalNs += tm;
+    stats.maxNs = tm > stats.maxNs ? tm : stats.maxNs;
+    stats.rows += connection->pendingRows;
+    stats.windowFills += connection->pendingWindowFills;
+    const uint64_t ms = tm / 1000000;
+    const size_t bucket = ms ? 64 - __builtin_clzll(ms) : 0;
+    stats.histogram[bucket < kStatementStatsBuckets ? bucket : kStatementStatsBuckets - 1]++;
+
+    connection->pendingRows = 0;
+    connection->pendingWindowFills = 0;
+}
+
 // Called each time a statement begins execution, when tracing is enabled.
 static void sqliteTraceCallback(void *data, const char *sql) {
     SQLiteConnection* connection = static_cast<SQLiteConnection*>(data);
@@ -97,11 +239,14 @@ static void sqliteTraceCallback(void *data, const char *sql) {
             connection->label.string(), sql);
 }
 
-// Called each time a statement finishes execution, when profiling is enabled.
+// Called each time a statement finishes execution.  Logs when profiling is enabled.
 static void sqliteProfileCallback(void *data, const char *sql, sqlite3_uint64 tm) {
     SQLiteConnection* connection = static_cast<SQLiteConnection*>(data);
-    ALOG(LOG_VERBOSE, SQLITE_PROFILE_TAG, "%s: \"%s\" took %0.3f ms\n",
-            connection->label.string(), sql, tm * 0.000001f);
+    if (connection->logProfile) {
+        ALOG(LOG_VERBOSE, SQLITE_PROFILE_TAG, "%s: \"%s\" took %0.3f ms\n",
+                connection->label.string(), sql, tm * 0.000001f);
+    }
+    recordStatementStats(connection, sql, tm);
 }
 
 // Called after each SQLite VM instruction when cancelation is enabled.
@@ -167,9 +312,8 @@ static jlong nativeOpen(JNIEnv* env, jclass clazz, jstring pathStr, jint openFla
     if (enableTrace) {
         sqlite3_trace(db, &sqliteTraceCallback, connection);
     }
-    if (enableProfile) {
-        sqlite3_profile(db, &sqliteProfileCallback, connection);
-    }
+    connection->logProfile = enableProfile;
+    sqlite3_profile(db, &sqliteProfileCallback, connection);
 
     ALOGV("Opened connection %p with label '%s'", db, label.string());
     return reinterpret_cast<jlong>(connection);
@@ -456,6 +600,173 @@ static void nativeExecute(JNIEnv* env, jclass clazz, jlong connectionPtr,
     executeNonQuery(env, connection, statement);
 }
 
+// Column types for nativeExecuteBatch.
+// Must be kept in sync with the FIELD_TYPE constants defined in Cursor.java.
+enum {
+    BATCH_COLUMN_NULL   = 0,
+    BATCH_COLUMN_LONG   = 1,
+    BATCH_COLUMN_DOUBLE = 2,
+    BATCH_COLUMN_STRING = 3,
+    BATCH_COLUMN_BLOB   = 4,
+};
+
+static int bindBatchRow(JNIEnv* env, sqlite3_stmt* statement, const jbyte* types,
+        jsize columnCount, const jlong* longs, const jdouble* doubles,
+        jobjectArray strings, jobjectArray blobs,
+        jsize* longIndex, jsize* doubleIndex, jsize* stringIndex, jsize* blobIndex) {
+    for (jsize i = 0; i < columnCount; i++) {
+        const int index = i + 1;
+        int err = SQLITE_OK;
+        switch (types[i]) {
+        case BATCH_COLUMN_LONG:
+            err = sqlite3_bind_int64(statement, index, longs[(*longIndex)++]);
+            break;
+        case BATCH_COLUMN_DOUBLE:
+            err = sqlite3_bind_double(statement, index, doubles[(*doubleIndex)++]);
+            break;
+        case BATCH_COLUMN_STRING: {
+            jstring valueString = static_cast<jstring>(
+                    env->GetObjectArrayElement(strings, (*stringIndex)++));
+            if (valueString == NULL) {
+                err = sqlite3_bind_null(statement, index);
+                break;
+            }
+            jsize valueLength = env->GetStringLength(valueString);
+            const jchar* value = env->GetStringCritical(valueString, NULL);
+            err = sqlite3_bind_text16(statement, index, value, valueLength * sizeof(jchar),
+                    SQLITE_TRANSIENT);
+            env->ReleaseStringCritical(valueString, value);
+            env->DeleteLocalRef(valueString);
+            break;
+        }
+        case BATCH_COLUMN_BLOB: {
+            jbyteArray valueArray = static_cast<jbyteArray>(
+                    env->GetObjectArrayElement(blobs, (*blobIndex)++));
+            if (valueArray == NULL) {
+                err = sqlite3_bind_null(statement, index);
+                break;
+            }
+            jsize valueLength = env->GetArrayLength(valueArray);
+            jbyte* value = static_cast<jbyte*>(env->GetPrimitiveArrayCritical(valueArray, NULL));
+            err = sqlite3_bind_blob(statement, index, value, valueLength, SQLITE_TRANSIENT);
+            env->ReleasePrimitiveArrayCritical(valueArray, value, JNI_ABORT);
+            env->DeleteLocalRef(valueArray);
+            break;
+        }
+        default:
+            err = sqlite3_bind_null(statement, index);
+            break;
+        }
+        if (err != SQLITE_OK) {
+            return err;
+        }
+    }
+    return SQLITE_OK;
+}
+
+/*
+ * Binds, steps and resets the statement once per row.  Each typed array holds the
+ * values of the columns of that type, row by row, so a row takes as many entries
+ * from it as columnTypes has columns of that type.  When useTransaction is set and
+ * no transaction is open yet, the rows run in their own transaction, rolled back
+ * if any of them fails.  Returns the total number of rows changed.
+ */
+static jint nativeExecuteBatch(JNIEnv* env, jclass clazz, jlong connectionPtr,
+        jlong statementPtr, jbyteArray columnTypesArray, jint rowCount,
+        jlongArray longsArray, jdoubleArray doublesArray, jobjectArray strings,
+        jobjectArray blobs, jboolean useTransaction) {
+    SQLiteConnection* connection = reinterpret_cast<SQLiteConnection*>(connectionPtr);
+    sqlite3_stmt* statement = reinterpret_cast<sqlite3_stmt*>(statementPtr);
+
+    const jsize columnCount = env->GetArrayLength(columnTypesArray);
+    if (columnCount != sqlite3_bind_parameter_count(statement) || rowCount < 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                "Column types don't match the statement parameters.");
+        return -1;
+    }
+
+    Vector<jbyte> typesVector;
+    typesVector.resize(columnCount);
+    jbyte* types = typesVector.editArray();
+    env->GetByteArrayRegion(columnTypesArray, 0, columnCount, types);
+    jsize perRow[BATCH_COLUMN_BLOB + 1] = { 0, 0, 0, 0, 0 };
+    for (jsize i = 0; i < columnCount; i++) {
+        if (types[i] >= 0 && types[i] <= BATCH_COLUMN_BLOB) {
+            perRow[types[i]]++;
+        }
+    }
+    const jsize lengths[BATCH_COLUMN_BLOB + 1] = { 0,
+            longsArray ? env->GetArrayLength(longsArray) : 0,
+            doublesArray ? env->GetArrayLength(doublesArray) : 0,
+            strings ? env->GetArrayLength(strings) : 0,
+            blobs ? env->GetArrayLength(blobs) : 0 };
+    for (int type = BATCH_COLUMN_LONG; type <= BATCH_COLUMN_BLOB; type++) {
+        if (int64_t(perRow[type]) * rowCount > lengths[type]) {
+            jniThrowException(env, "java/lang/IllegalArgumentException",
+                    "Not enough values for the given row count.");
+            return -1;
+        }
+    }
+
+    jlong* longs = longsArray ? env->GetLongArrayElements(longsArray, NULL) : NULL;
+    jdouble* doubles = doublesArray ? env->GetDoubleArrayElements(doublesArray, NULL) : NULL;
+
+    bool inTransaction = false;
+    int err = SQLITE_OK;
+    if (useTransaction && sqlite3_get_autocommit(connection->db)) {
+        err = sqlite3_exec(connection->db, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+        inTransaction = err == SQLITE_OK;
+    }
+
+    jint changes = 0;
+    jsize longIndex = 0, doubleIndex = 0, stringIndex = 0, blobIndex = 0;
+    for (jint row = 0; err == SQLITE_OK && row < rowCount; row++) {
+        err = bindBatchRow(env, statement, types, columnCount, longs, doubles, strings, blobs,
+                &longIndex, &doubleIndex, &stringIndex, &blobIndex);
+        if (err != SQLITE_OK) {
+            break;
+        }
+        err = sqlite3_step(statement);
+        if (err == SQLITE_DONE) {
+            changes += sqlite3_changes(connection->db);
+            err = sqlite3_reset(statement);
+        } else if (err == SQLITE_ROW) {
+            sqlite3_reset(statement);
+            break;
+        }
+    }
+
+    if (longs != NULL) {
+        env->ReleaseLongArrayElements(longsArray, longs, JNI_ABORT);
+    }
+    if (doubles != NULL) {
+        env->ReleaseDoubleArrayElements(doublesArray, doubles, JNI_ABORT);
+    }
+
+    if (err == SQLITE_ROW) {
+        if (inTransaction) {
+            sqlite3_exec(connection->db, "ROLLBACK;", NULL, NULL, NULL);
+        }
+        throw_sqlite3_exception(env,
+                "Queries can be performed using SQLiteDatabase query or rawQuery methods only.");
+        return -1;
+    }
+    if (err == SQLITE_OK && inTransaction) {
+        err = sqlite3_exec(connection->db, "COMMIT;", NULL, NULL, NULL);
+    }
+    if (err != SQLITE_OK) {
+        // Throw first, the rollback would replace the error message.
+        throw_sqlite3_exception(env, connection->db);
+        sqlite3_reset(statement);
+        if (inTransaction && !sqlite3_get_autocommit(connection->db)) {
+            sqlite3_exec(connection->db, "ROLLBACK;", NULL, NULL, NULL);
+        }
+        return -1;
+    }
+    sqlite3_clear_bindings(statement);
+    return changes;
+}
+
 static jint nativeExecuteForChangedRowCount(JNIEnv* env, jclass clazz,
         jlong connectionPtr, jlong statementPtr) {
     SQLiteConnection* connection = reinterpret_cast<SQLiteConnection*>(connectionPtr);
@@ -569,8 +880,74 @@ enum CopyRowResult {
     CPR_ERROR,
 };
 
+// Rows with at most this many columns are copied by copyRowFast().
+static const int kMaxFastCopyColumns = 64;
+
+// Reads the types and sizes of the whole row first, so the row, its field directory and
+// all of its strings and blobs are reserved with a single check and written in place.
+static CopyRowResult copyRowFast(JNIEnv* env, CursorWindow* window,
+        sqlite3_stmt* statement, int numColumns, int startPos, int addedRows) {
+    int types[kMaxFastCopyColumns];
+    const void* values[kMaxFastCopyColumns];
+    size_t sizes[kMaxFastCopyColumns];
+    size_t dataSize = 0;
+    for (int i = 0; i < numColumns; i++) {
+        types[i] = sqlite3_column_type(statement, i);
+        if (types[i] == SQLITE_TEXT) {
+            // As in copyRow(), store the terminator that SQLite leaves out of the size.
+            values[i] = sqlite3_column_text(statement, i);
+            sizes[i] = sqlite3_column_bytes(statement, i) + 1;
+            dataSize += sizes[i];
+        } else if (types[i] == SQLITE_BLOB) {
+            values[i] = sqlite3_column_blob(statement, i);
+            sizes[i] = sqlite3_column_bytes(statement, i);
+            dataSize += sizes[i];
+        } else if (types[i] != SQLITE_INTEGER && types[i] != SQLITE_FLOAT
+                && types[i] != SQLITE_NULL) {
+            ALOGE("Unknown column type when filling database window");
+            throw_sqlite3_exception(env, "Unknown column type when filling window");
+            return CPR_ERROR;
+        }
+    }
+
+    uint32_t dataOffset;
+    CursorWindow::FieldSlot* fieldDir = window->allocRowWithData(dataSize, &dataOffset);
+    if (fieldDir == NULL) {
+        LOG_WINDOW("Failed allocating row of %zu data bytes at startPos %d row %d",
+                dataSize, startPos, addedRows);
+        return CPR_FULL;
+    }
+
+    for (int i = 0; i < numColumns; i++) {
+        switch (types[i]) {
+        case SQLITE_TEXT:
+            window->putFieldBlobOrString(fieldDir, i, CursorWindow::FIELD_TYPE_STRING,
+                    values[i], sizes[i], &dataOffset);
+            break;
+        case SQLITE_BLOB:
+            window->putFieldBlobOrString(fieldDir, i, CursorWindow::FIELD_TYPE_BLOB,
+                    values[i], sizes[i], &dataOffset);
+            break;
+        case SQLITE_INTEGER:
+            window->putFieldLong(fieldDir, i, sqlite3_column_int64(statement, i));
+            break;
+        case SQLITE_FLOAT:
+            window->putFieldDouble(fieldDir, i, sqlite3_column_double(statement, i));
+            break;
+        default:
+            // Null, the directory starts out that way.
+            break;
+        }
+    }
+    return CPR_OK;
+}
+
 static CopyRowResult copyRow(JNIEnv* env, CursorWindow* window,
         sqlite3_stmt* statement, int numColumns, int startPos, int addedRows) {
+    if (numColumns <= kMaxFastCopyColumns) {
+        return copyRowFast(env, window, statement, numColumns, startPos, addedRows);
+    }
+
     // Allocate a new field directory for the row.
     status_t status = window->allocRow();
     if (status) {
@@ -693,6 +1070,9 @@ static jlong nativeExecuteForCursorWindow(JNIEnv* env, jclass clazz,
     bool windowFull = false;
     bool gotException = false;
     while (!gotException && (!windowFull || countAllRows)) {
+        // The profile callback runs in the step that finishes the statement, or in the reset.
+        connection->pendingRows = totalRows;
+        connection->pendingWindowFills = 1;
         int err = sqlite3_step(statement);
         if (err == SQLITE_ROW) {
             LOG_WINDOW("Stepped statement %p to row %d", statement, totalRows);
@@ -748,7 +1128,11 @@ static jlong nativeExecuteForCursorWindow(JNIEnv* env, jclass clazz,
     LOG_WINDOW("Resetting statement %p after fetching %d rows and adding %d rows"
             "to the window in %d bytes",
             statement, totalRows, addedRows, window->size() - window->freeSpace());
+    connection->pendingRows = totalRows;
+    connection->pendingWindowFills = 1;
     sqlite3_reset(statement);
+    connection->pendingRows = 0;
+    connection->pendingWindowFills = 0;
 
     // Report the total number of rows on request.
     if (startPos > totalRows) {
@@ -758,6 +1142,52 @@ static jlong nativeExecuteForCursorWindow(JNIEnv* env, jclass clazz,
     return result;
 }
 
+// Formats the statement stats of the connection, slowest total first, for dumpsys dbinfo.
+static jstring nativeDumpStatementStats(JNIEnv* env, jclass clazz, jlong connectionPtr) {
+    SQLiteConnection* connection = reinterpret_cast<SQLiteConnection*>(connectionPtr);
+
+    String8 dump;
+    AutoMutex _l(connection->statsLock);
+    const KeyedVector<String8, StatementStats>& table = connection->statementStats;
+    Vector<size_t> order;
+    for (size_t i = 0; i < table.size(); i++) {
+        size_t j = order.size();
+        while (j > 0 && table.valueAt(order[j - 1]).totalNs < table.valueAt(i).totalNs) {
+            j--;
+        }
+        order.insertAt(i, j);
+    }
+
+    for (size_t i = 0; i < order.size(); i++) {
+        const StatementStats& stats = table.valueAt(order[i]);
+        // p99 is reported as the upper bound of its histogram bucket, capped by the max.
+        const uint64_t p99Rank = (uint64_t(stats.count) * 99 + 99) / 100;
+        uint64_t seen = 0;
+        uint64_t p99Bound = 0;
+        for (size_t b = 0; b < kStatementStatsBuckets; b++) {
+            seen += stats.histogram[b];
+            if (seen >= p99Rank) {
+                p99Bound = 1ULL << b;
+                break;
+            }
+        }
+        const double maxMs = stats.maxNs * 0.000001;
+        const double p99Ms = p99Bound < maxMs ? p99Bound : maxMs;
+        dump.appendFormat("count=%u total=%0.3fms p99=%0.3fms max=%0.3fms rows=%llu"
+                " windowFills=%u sql=\"%s\"\n",
+                stats.count, stats.totalNs * 0.000001, p99Ms, maxMs,
+                static_cast<unsigned long long>(stats.rows), stats.windowFills,
+                table.keyAt(order[i]).string());
+    }
+    return env->NewStringUTF(dump.string());
+}
+
+static void nativeResetStatementStats(JNIEnv* env, jclass clazz, jlong connectionPtr) {
+    SQLiteConnection* connection = reinterpret_cast<SQLiteConnection*>(connectionPtr);
+    AutoMutex _l(connection->statsLock);
+    connection->statementStats.clear();
+}
+
 static jint nativeGetDbLookaside(JNIEnv* env, jobject clazz, jlong connectionPtr) {
     SQLiteConnection* connection = reinterpret_cast<SQLiteConnection*>(connectionPtr);
 
@@ -843,6 +1273,17 @@ static JNINativeMethod sMethods[] =
             (void*)nativeResetCancel },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod sOptionalMethods[] =
+{
+    { "nativeExecuteBatch", "(JJ[BI[J[D[Ljava/lang/String;[[BZ)I",
+            (void*)nativeExecuteBatch },
+    { "nativeDumpStatementStats", "(J)Ljava/lang/String;",
+            (void*)nativeDumpStatementStats },
+    { "nativeResetStatementStats", "(J)V",
+            (void*)nativeResetStatementStats },
+};
+
 int register_android_database_SQLiteConnection(JNIEnv *env)
 {
     jclass clazz = FindClassOrDie(env, "android/database/sqlite/SQLiteCustomFunction");
@@ -855,6 +1296,8 @@ int register_android_database_SQLiteConnection(JNIEnv *env)
     clazz = FindClassOrDie(env, "java/lang/String");
     gStringClassInfo.clazz = MakeGlobalRefOrDie(env, clazz);
 
+    RegisterOptionalMethods(env, "android/database/sqlite/SQLiteConnection", sOptionalMethods,
+                            NELEM(sOptionalMethods));
     return RegisterMethodsOrDie(env, "android/database/sqlite/SQLiteConnection", sMethods,
                                 NELEM(sMethods));
 }
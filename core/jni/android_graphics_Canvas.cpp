@@ -660,6 +660,7 @@ static void freeCaches(JNIEnv* env, jobject) {
 }
 
 static void freeTextLayoutCaches(JNIEnv* env, jobject) {
+    MinikinUtils::purgeLayoutCache();
     Layout::purgeCaches();
 }
 
@@ -39,6 +39,7 @@ static struct {
     jclass clazz;
     jmethodID dispatchSensorEvent;
     jmethodID dispatchFlushCompleteEvent;
+    jmethodID dispatchSensorEventBatch;
 } gBaseEventQueueClassInfo;
 
 namespace android {
@@ -187,11 +188,45 @@ static jboolean nativeIsDataInjectionEnabled(JNIEnv *_env, jclass _this, jlong s
 
 //----------------------------------------------------------------------------
 
+/*
+ * The layout of one event in the direct ByteBuffer handed to
+ * dispatchSensorEventBatch(), in native byte order. A step counter's count
+ * is stored as a float in values[0], like dispatchSensorEvent() does.
+ */
+struct BatchedSensorEvent {
+    int32_t sensor;
+    int32_t accuracy;
+    int64_t timestamp;
+    float values[16];
+};
+
+static int8_t getSensorEventStatus(const ASensorEvent& event) {
+    switch (event.type) {
+    case SENSOR_TYPE_ORIENTATION:
+    case SENSOR_TYPE_MAGNETIC_FIELD:
+    case SENSOR_TYPE_ACCELEROMETER:
+    case SENSOR_TYPE_GYROSCOPE:
+    case SENSOR_TYPE_GRAVITY:
+    case SENSOR_TYPE_LINEAR_ACCELERATION:
+        return event.vector.status;
+    case SENSOR_TYPE_HEART_RATE:
+        return event.heart_rate.status;
+    default:
+        return SENSOR_STATUS_ACCURACY_HIGH;
+    }
+}
+
 class Receiver : public LooperCallback {
     sp<SensorEventQueue> mSensorQueue;
     sp<MessageQueue> mMessageQueue;
     jobject mReceiverWeakGlobal;
     jfloatArray mScratch;
+
+    // When set, sensor events are packed into this direct buffer and handed
+    // to Java with one upcall per read instead of one per event.
+    jobject mBatchBufferGlobal;
+    BatchedSensorEvent* mBatchEvents;
+    size_t mBatchCapacity;
 public:
     Receiver(const sp<SensorEventQueue>& sensorQueue,
             const sp<MessageQueue>& messageQueue,
@@ -201,11 +236,17 @@ public:
         mMessageQueue = messageQueue;
         mReceiverWeakGlobal = env->NewGlobalRef(receiverWeak);
         mScratch = (jfloatArray)env->NewGlobalRef(scratch);
+        mBatchBufferGlobal = NULL;
+        mBatchEvents = NULL;
+        mBatchCapacity = 0;
     }
     ~Receiver() {
         JNIEnv* env = AndroidRuntime::getJNIEnv();
         env->DeleteGlobalRef(mReceiverWeakGlobal);
         env->DeleteGlobalRef(mScratch);
+        if (mBatchBufferGlobal) {
+            env->DeleteGlobalRef(mBatchBufferGlobal);
+        }
     }
     sp<SensorEventQueue> getSensorEventQueue() const {
         return mSensorQueue;
@@ -215,6 +256,40 @@ public:
         mMessageQueue->getLooper()->removeFd( mSensorQueue->getFd() );
     }
 
+    /*
+     * Switches to batched dispatch into the given direct ByteBuffer, or back
+     * to per event dispatch if it is NULL. Must be called on the thread of
+     * the queue's Looper. Returns the number of events a batch can hold.
+     */
+    jint setBatchBuffer(JNIEnv* env, jobject byteBuffer) {
+        void* address = NULL;
+        size_t capacity = 0;
+        if (byteBuffer) {
+            if (!gBaseEventQueueClassInfo.dispatchSensorEventBatch) {
+                jniThrowException(env, "java/lang/UnsupportedOperationException",
+                        "BaseEventQueue doesn't declare dispatchSensorEventBatch");
+                return 0;
+            }
+            address = env->GetDirectBufferAddress(byteBuffer);
+            jlong bytes = env->GetDirectBufferCapacity(byteBuffer);
+            if (!address || bytes < jlong(sizeof(BatchedSensorEvent))
+                    || (uintptr_t(address) % alignof(BatchedSensorEvent)) != 0) {
+                jniThrowException(env, "java/lang/IllegalArgumentException",
+                        "buffer must be an aligned direct buffer large enough for one event");
+                return 0;
+            }
+            capacity = size_t(bytes) / sizeof(BatchedSensorEvent);
+        }
+
+        if (mBatchBufferGlobal) {
+            env->DeleteGlobalRef(mBatchBufferGlobal);
+        }
+        mBatchBufferGlobal = byteBuffer ? env->NewGlobalRef(byteBuffer) : NULL;
+        mBatchEvents = reinterpret_cast<BatchedSensorEvent*>(address);
+        mBatchCapacity = capacity;
+        return jint(capacity);
+    }
+
 private:
     virtual void onFirstRef() {
         LooperCallback::onFirstRef();
@@ -228,9 +303,34 @@ private:
         ScopedLocalRef<jobject> receiverObj(env, jniGetReferent(env, mReceiverWeakGlobal));
 
         ssize_t n;
-        ASensorEvent buffer[16];
-        while ((n = q->read(buffer, 16)) > 0) {
+        ASensorEvent buffer[64];
+        while ((n = q->read(buffer, 64)) > 0) {
+            // The number of events packed into the batch buffer. Java may
+            // switch buffers from any upcall, so every upcall is made with
+            // an empty batch and mBatchEvents is checked again per event.
+            size_t count = 0;
             for (int i=0 ; i<n ; i++) {
+                if (mBatchEvents && buffer[i].type != SENSOR_TYPE_META_DATA) {
+                    packEvent(&mBatchEvents[count++], buffer[i]);
+                    if (count == mBatchCapacity) {
+                        if (!dispatchBatch(env, receiverObj.get(), count)) {
+                            mSensorQueue->sendAck(buffer, n);
+                            return 1;
+                        }
+                        count = 0;
+                    }
+                    continue;
+                }
+                // Deliver the batched events first, so that Java sees the
+                // events in order.
+                if (count) {
+                    if (!dispatchBatch(env, receiverObj.get(), count)) {
+                        mSensorQueue->sendAck(buffer, n);
+                        return 1;
+                    }
+                    count = 0;
+                }
+
                 if (buffer[i].type == SENSOR_TYPE_STEP_COUNTER) {
                     // step-counter returns a uint64, but the java API only deals with floats
                     float value = float(buffer[i].u64.step_counter);
@@ -248,23 +348,7 @@ private:
                                             buffer[i].meta_data.sensor);
                     }
                 } else {
-                    int8_t status;
-                    switch (buffer[i].type) {
-                    case SENSOR_TYPE_ORIENTATION:
-                    case SENSOR_TYPE_MAGNETIC_FIELD:
-                    case SENSOR_TYPE_ACCELEROMETER:
-                    case SENSOR_TYPE_GYROSCOPE:
-                    case SENSOR_TYPE_GRAVITY:
-                    case SENSOR_TYPE_LINEAR_ACCELERATION:
-                        status = buffer[i].vector.status;
-                        break;
-                    case SENSOR_TYPE_HEART_RATE:
-                        status = buffer[i].heart_rate.status;
-                        break;
-                    default:
-                        status = SENSOR_STATUS_ACCURACY_HIGH;
-                        break;
-                    }
+                    int8_t status = getSensorEventStatus(buffer[i]);
                     if (receiverObj.get()) {
                         env->CallVoidMethod(receiverObj.get(),
                                             gBaseEventQueueClassInfo.dispatchSensorEvent,
@@ -280,6 +364,10 @@ private:
                     return 1;
                 }
             }
+            if (count && !dispatchBatch(env, receiverObj.get(), count)) {
+                mSensorQueue->sendAck(buffer, n);
+                return 1;
+            }
             mSensorQueue->sendAck(buffer, n);
         }
         if (n<0 && n != -EAGAIN) {
@@ -287,6 +375,31 @@ private:
         }
         return 1;
     }
+
+    static void packEvent(BatchedSensorEvent* outEvent, const ASensorEvent& event) {
+        outEvent->sensor = event.sensor;
+        outEvent->accuracy = getSensorEventStatus(event);
+        outEvent->timestamp = event.timestamp;
+        if (event.type == SENSOR_TYPE_STEP_COUNTER) {
+            // step-counter returns a uint64, but the java API only deals with floats
+            outEvent->values[0] = float(event.u64.step_counter);
+        } else {
+            memcpy(outEvent->values, event.data, sizeof(outEvent->values));
+        }
+    }
+
+    bool dispatchBatch(JNIEnv* env, jobject receiverObj, size_t count) {
+        if (receiverObj) {
+            env->CallVoidMethod(receiverObj,
+                                gBaseEventQueueClassInfo.dispatchSensorEventBatch,
+                                jint(count));
+        }
+        if (env->ExceptionCheck()) {
+            ALOGE("Exception dispatching input event.");
+            return false;
+        }
+        return true;
+    }
 };
 
 static jlong nativeInitSensorEventQueue(JNIEnv *env, jclass clazz, jlong sensorManager,
@@ -330,6 +443,11 @@ static jint nativeFlushSensor(JNIEnv *env, jclass clazz, jlong eventQ) {
     return receiver->getSensorEventQueue()->flush();
 }
 
+static jint nativeSetBatchBuffer(JNIEnv *env, jclass clazz, jlong eventQ, jobject byteBuffer) {
+    sp<Receiver> receiver(reinterpret_cast<Receiver *>(eventQ));
+    return receiver->setBatchBuffer(env, byteBuffer);
+}
+
 static jint nativeInjectSensorData(JNIEnv *env, jclass clazz, jlong eventQ, jint handle,
         jfloatArray values, jint accuracy, jlong timestamp) {
     sp<Receiver> receiver(reinterpret_cast<Receiver *>(eventQ));
@@ -386,6 +504,13 @@ static JNINativeMethod gBaseEventQueueMethods[] = {
             (void*)nativeInjectSensorData },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gBaseEventQueueOptionalMethods[] = {
+    {"nativeSetBatchBuffer",
+            "(JLjava/nio/ByteBuffer;)I",
+            (void*)nativeSetBatchBuffer },
+};
+
 }; // namespace android
 
 using namespace android;
@@ -397,6 +522,8 @@ int register_android_hardware_SensorManager(JNIEnv *env)
 
     RegisterMethodsOrDie(env, "android/hardware/SystemSensorManager$BaseEventQueue",
             gBaseEventQueueMethods, NELEM(gBaseEventQueueMethods));
+    RegisterOptionalMethods(env, "android/hardware/SystemSensorManager$BaseEventQueue",
+            gBaseEventQueueOptionalMethods, NELEM(gBaseEventQueueOptionalMethods));
 
     gBaseEventQueueClassInfo.clazz = FindClassOrDie(env,
             "android/hardware/SystemSensorManager$BaseEventQueue");
@@ -407,5 +534,8 @@ int register_android_hardware_SensorManager(JNIEnv *env)
     gBaseEventQueueClassInfo.dispatchFlushCompleteEvent = GetMethodIDOrDie(env,
             gBaseEventQueueClassInfo.clazz, "dispatchFlushCompleteEvent", "(I)V");
 
+    gBaseEventQueueClassInfo.dispatchSensorEventBatch = GetOptionalMethodID(env,
+            gBaseEventQueueClassInfo.clazz, "dispatchSensorEventBatch", "(I)V");
+
     return 0;
 }
@@ -23,8 +23,16 @@
 #include "core_jni_helpers.h"
 
 #include <usbhost/usbhost.h>
+#include <utils/Condition.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
+#include <utils/SortedVector.h>
+#include <utils/Vector.h>
+
+#include <algorithm>
 
 #include <stdio.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -38,6 +46,8 @@ struct usb_device* get_device_from_object(JNIEnv* env, jobject connection)
     return (struct usb_device*)env->GetLongField(connection, field_context);
 }
 
+static struct usb_request* wait_for_user_request(struct usb_device* device);
+
 static jboolean
 android_hardware_UsbDeviceConnection_open(JNIEnv *env, jobject thiz, jstring deviceName,
         jobject fileDescriptor)
@@ -223,13 +233,280 @@ android_hardware_UsbDeviceConnection_request_wait(JNIEnv *env, jobject thiz)
         return NULL;
     }
 
-    struct usb_request* request = usb_request_wait(device);
+    struct usb_request* request = wait_for_user_request(device);
     if (request)
         return (jobject)request->client_data;
     else
         return NULL;
 }
 
+/*
+ * Transfer rings keep a fixed set of URBs, each backed by a slice of one direct
+ * ByteBuffer, so callers can keep many transfers queued and collect completions
+ * in batches instead of paying a JNI round trip and an allocation per transfer.
+ *
+ * Rings share the device's completion queue with UsbRequest. Only one thread
+ * at a time reaps the URBs of a device, and hands those of the other waiters
+ * over through the lists below. The other waiters sleep on sReapCondition
+ * until it has, so a completion can't be parked where nobody is looking.
+ */
+struct TransferRing {
+    struct usb_device* device;
+    jobject pool;                       // global ref keeping the buffer alive
+    jint transferSize;                  // size of each slot of the pool
+    Vector<struct usb_request*> requests;
+    Vector<bool> queued;
+    Vector<jint> completed;             // slot index, actual length pairs
+};
+
+static Mutex sRingLock;
+// Broadcast whenever a reaped URB was handed over or a reaper is done
+static Condition sReapCondition;
+// Devices a thread is blocked reaping in usb_request_wait()
+static SortedVector<struct usb_device*> sReapingDevices;
+// URBs owned by rings, mapped to their ring
+static KeyedVector<struct usb_request*, TransferRing*> sRingRequests;
+// UsbRequest URBs reaped by another thread, waiting for native_request_wait
+static Vector<struct usb_request*> sPendingUserRequests;
+
+// Returns true if the request belonged to a ring, must hold sRingLock
+static bool record_ring_completion_locked(struct usb_request* request)
+{
+    ssize_t index = sRingRequests.indexOfKey(request);
+    if (index < 0) {
+        return false;
+    }
+    TransferRing* ring = sRingRequests.valueAt(index);
+    jint slot = (jint)(intptr_t)request->client_data;
+    ring->queued.editItemAt(slot) = false;
+    ring->completed.push(slot);
+    ring->completed.push(request->actual_length);
+    return true;
+}
+
+static struct usb_request* take_pending_user_request_locked(struct usb_device* device)
+{
+    for (size_t i = 0; i < sPendingUserRequests.size(); i++) {
+        struct usb_request* request = sPendingUserRequests[i];
+        if (request->dev == device) {
+            sPendingUserRequests.removeAt(i);
+            return request;
+        }
+    }
+    return NULL;
+}
+
+// Reaps one completed URB of the device and hands it over to its owner. If
+// another thread is already reaping the device, waits for it to hand over what
+// it reaped instead, or returns at once if block is false. Must hold sRingLock,
+// which is released while blocked. Returns false if nothing was reaped.
+static bool reap_locked(struct usb_device* device, bool block)
+{
+    if (sReapingDevices.indexOf(device) >= 0) {
+        if (!block) {
+            return false;
+        }
+        sReapCondition.wait(sRingLock);
+        return true;
+    }
+    if (!block) {
+        // usbfs reports POLLOUT once a completed URB is ready to be reaped
+        struct pollfd pfd;
+        pfd.fd = usb_device_get_fd(device);
+        pfd.events = POLLOUT;
+        if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLOUT)) {
+            return false;
+        }
+    }
+
+    sReapingDevices.add(device);
+    sRingLock.unlock();
+    struct usb_request* request = usb_request_wait(device);
+    sRingLock.lock();
+    sReapingDevices.remove(device);
+    if (request && !record_ring_completion_locked(request)) {
+        sPendingUserRequests.push(request);
+    }
+    // Wakes up the owner, and lets another waiter take over reaping
+    sReapCondition.broadcast();
+    return request != NULL;
+}
+
+static struct usb_request* wait_for_user_request(struct usb_device* device)
+{
+    Mutex::Autolock _l(sRingLock);
+    while (true) {
+        struct usb_request* request = take_pending_user_request_locked(device);
+        if (request) {
+            return request;
+        }
+        if (!reap_locked(device, true)) {
+            return NULL;
+        }
+    }
+}
+
+static void free_ring(JNIEnv* env, TransferRing* ring)
+{
+    {
+        Mutex::Autolock _l(sRingLock);
+        for (size_t i = 0; i < ring->requests.size(); i++) {
+            sRingRequests.removeItem(ring->requests[i]);
+            usb_request_free(ring->requests[i]);
+        }
+    }
+    env->DeleteGlobalRef(ring->pool);
+    delete ring;
+}
+
+static jlong
+android_hardware_UsbDeviceConnection_ring_create(JNIEnv *env, jobject thiz,
+        jint ep_address, jint ep_attributes, jint ep_max_packet_size, jint ep_interval,
+        jobject pool, jint transferSize, jint count)
+{
+    struct usb_device* device = get_device_from_object(env, thiz);
+    if (!device) {
+        ALOGE("device is closed in native_ring_create");
+        return 0;
+    }
+
+    uint8_t* poolBytes = (uint8_t*)env->GetDirectBufferAddress(pool);
+    jlong capacity = env->GetDirectBufferCapacity(pool);
+    if (!poolBytes || transferSize <= 0 || count <= 0
+            || (jlong)transferSize * count > capacity) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                "buffer pool too small for transfer ring");
+        return 0;
+    }
+
+    struct usb_endpoint_descriptor desc;
+    desc.bLength = USB_DT_ENDPOINT_SIZE;
+    desc.bDescriptorType = USB_DT_ENDPOINT;
+    desc.bEndpointAddress = ep_address;
+    desc.bmAttributes = ep_attributes;
+    desc.wMaxPacketSize = ep_max_packet_size;
+    desc.bInterval = ep_interval;
+
+    TransferRing* ring = new TransferRing();
+    ring->device = device;
+    ring->pool = env->NewGlobalRef(pool);
+    ring->transferSize = transferSize;
+    for (jint i = 0; i < count; i++) {
+        struct usb_request* request = usb_request_new(device, &desc);
+        if (!request) {
+            ALOGE("usb_request_new failed in native_ring_create");
+            free_ring(env, ring);
+            return 0;
+        }
+        request->buffer = poolBytes + (size_t)i * transferSize;
+        request->buffer_length = transferSize;
+        request->client_data = (void*)(intptr_t)i;
+        ring->requests.push(request);
+        ring->queued.push(false);
+
+        Mutex::Autolock _l(sRingLock);
+        sRingRequests.add(request, ring);
+    }
+    return (jlong)ring;
+}
+
+static jboolean
+android_hardware_UsbDeviceConnection_ring_submit(JNIEnv *env, jobject thiz,
+        jlong ringPtr, jint slot, jint length)
+{
+    TransferRing* ring = (TransferRing*)ringPtr;
+    if (slot < 0 || (size_t)slot >= ring->requests.size()) {
+        jniThrowException(env, "java/lang/IndexOutOfBoundsException", NULL);
+        return false;
+    }
+    if (length < 0 || length > ring->transferSize) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                "length exceeds the transfer ring's slot size");
+        return false;
+    }
+    struct usb_request* request = ring->requests[slot];
+
+    Mutex::Autolock _l(sRingLock);
+    if (ring->queued[slot]) {
+        ALOGE("transfer %d already queued in native_ring_submit", slot);
+        return false;
+    }
+    request->buffer_length = length;
+    if (usb_request_queue(request)) {
+        return false;
+    }
+    ring->queued.editItemAt(slot) = true;
+    return true;
+}
+
+static jint
+android_hardware_UsbDeviceConnection_ring_wait(JNIEnv *env, jobject thiz,
+        jlong ringPtr, jintArray completions)
+{
+    TransferRing* ring = (TransferRing*)ringPtr;
+    const size_t maxCompletions = env->GetArrayLength(completions) / 2;
+    if (maxCompletions == 0) {
+        return 0;
+    }
+
+    Mutex::Autolock _l(sRingLock);
+    while (true) {
+        size_t available = ring->completed.size() / 2;
+        if (available >= maxCompletions) {
+            break;
+        }
+        bool block = true;
+        if (available > 0) {
+            // have at least one, only pick up what's already done
+            block = false;
+        } else {
+            bool anyQueued = false;
+            for (size_t i = 0; i < ring->queued.size(); i++) {
+                anyQueued |= ring->queued[i];
+            }
+            if (!anyQueued) {
+                return 0;
+            }
+        }
+        if (!reap_locked(ring->device, block)) {
+            if (block) {
+                return -1;
+            }
+            break;
+        }
+    }
+
+    size_t count = std::min(ring->completed.size() / 2, maxCompletions);
+    env->SetIntArrayRegion(completions, 0, count * 2, ring->completed.array());
+    ring->completed.removeItemsAt(0, count * 2);
+    return (jint)count;
+}
+
+static void
+android_hardware_UsbDeviceConnection_ring_close(JNIEnv *env, jobject thiz, jlong ringPtr)
+{
+    TransferRing* ring = (TransferRing*)ringPtr;
+    {
+        Mutex::Autolock _l(sRingLock);
+        for (size_t i = 0; i < ring->queued.size(); i++) {
+            if (ring->queued[i]) {
+                usb_request_cancel(ring->requests[i]);
+            }
+        }
+        // URBs must be reaped before they can be freed
+        while (true) {
+            bool anyQueued = false;
+            for (size_t i = 0; i < ring->queued.size(); i++) {
+                anyQueued |= ring->queued[i];
+            }
+            if (!anyQueued || !reap_locked(ring->device, true)) {
+                break;
+            }
+        }
+    }
+    free_ring(env, ring);
+}
+
 static jstring
 android_hardware_UsbDeviceConnection_get_serial(JNIEnv *env, jobject thiz)
 {
@@ -266,11 +543,24 @@ static JNINativeMethod method_table[] = {
                                         (void*)android_hardware_UsbDeviceConnection_get_serial },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod optional_method_table[] = {
+    {"native_ring_create",      "(IIIILjava/nio/ByteBuffer;II)J",
+                                        (void *)android_hardware_UsbDeviceConnection_ring_create},
+    {"native_ring_submit",      "(JII)Z",
+                                        (void *)android_hardware_UsbDeviceConnection_ring_submit},
+    {"native_ring_wait",        "(J[I)I",
+                                        (void *)android_hardware_UsbDeviceConnection_ring_wait},
+    {"native_ring_close",       "(J)V", (void *)android_hardware_UsbDeviceConnection_ring_close},
+};
+
 int register_android_hardware_UsbDeviceConnection(JNIEnv *env)
 {
     jclass clazz = FindClassOrDie(env, "android/hardware/usb/UsbDeviceConnection");
     field_context = GetFieldIDOrDie(env, clazz, "mNativeContext", "J");
 
+    RegisterOptionalMethods(env, "android/hardware/usb/UsbDeviceConnection",
+            optional_method_table, NELEM(optional_method_table));
     return RegisterMethodsOrDie(env, "android/hardware/usb/UsbDeviceConnection",
             method_table, NELEM(method_table));
 }
@@ -19,6 +19,7 @@
 #define LOG_TAG "CameraMetadata-JNI"
 #include <utils/Errors.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
 #include <utils/RefBase.h>
 #include <utils/Vector.h>
 #include <utils/SortedVector.h>
@@ -252,12 +253,29 @@ static jint CameraMetadata_getEntryCount(JNIEnv *env, jobject thiz) {
     return metadata->entryCount();
 }
 
+// The metadata whose buffer nativeLockBuffer handed out to Java. CameraMetadata
+// can't tell whether it's locked, and Java may hold on to the ByteBuffer.
+static Mutex sLockedBuffersLock;
+static SortedVector<const CameraMetadata*> sLockedBuffers;
+
+static bool CameraMetadata_isBufferLocked(const CameraMetadata* metadata) {
+    Mutex::Autolock _l(sLockedBuffersLock);
+    return sLockedBuffers.indexOf(metadata) >= 0;
+}
+
 // idempotent. calling more than once has no effect.
 static void CameraMetadata_close(JNIEnv *env, jobject thiz) {
     ALOGV("%s", __FUNCTION__);
 
     CameraMetadata* metadata = CameraMetadata_getPointerNoThrow(env, thiz);
 
+    // The ByteBuffer of nativeLockBuffer points into the metadata
+    if (metadata != NULL && CameraMetadata_isBufferLocked(metadata)) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                "Metadata buffer must be unlocked before close");
+        return;
+    }
+
     if (metadata != NULL) {
         delete metadata;
         env->SetLongField(thiz, fields.metadata_ptr, 0);
@@ -320,6 +338,92 @@ static jbyteArray CameraMetadata_readValues(JNIEnv *env, jobject thiz, jint tag)
     return byteArray;
 }
 
+// Fields per entry in the index filled by nativeLockBuffer.
+// Keep in sync with CameraMetadataNative.java.
+enum {
+    ENTRY_INDEX_TAG = 0,
+    ENTRY_INDEX_TYPE,
+    ENTRY_INDEX_COUNT,
+    ENTRY_INDEX_OFFSET,     // of the entry data, in bytes from the start of the buffer
+    ENTRY_INDEX_FIELDS
+};
+
+/*
+ * Locks the metadata and returns its camera_metadata_t as a direct ByteBuffer, so the
+ * values of a result can be read from Java without a JNI call and a copy per key.
+ * outIndex receives ENTRY_INDEX_FIELDS ints per entry, up to its length.  The
+ * buffer stays valid until nativeUnlockBuffer; until then the metadata can't be
+ * written, swapped, or closed. The buffer can only be locked once at a time.
+ */
+static jobject CameraMetadata_lockBuffer(JNIEnv *env, jobject thiz, jintArray outIndex) {
+    ALOGV("%s", __FUNCTION__);
+
+    CameraMetadata* metadata = CameraMetadata_getPointerThrow(env, thiz);
+    if (metadata == NULL) return NULL;
+
+    Mutex::Autolock _l(sLockedBuffersLock);
+    if (sLockedBuffers.indexOf(metadata) >= 0) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                "Metadata buffer is already locked");
+        return NULL;
+    }
+
+    // The buffer is only ever read through the ByteBuffer
+    camera_metadata_t* buffer = const_cast<camera_metadata_t*>(metadata->getAndLock());
+    if (buffer == NULL) {
+        metadata->unlock(buffer);
+        return NULL;
+    }
+
+    if (outIndex != NULL) {
+        const size_t entryCount = get_camera_metadata_entry_count(buffer);
+        const size_t maxEntries = env->GetArrayLength(outIndex) / ENTRY_INDEX_FIELDS;
+        const size_t count = entryCount < maxEntries ? entryCount : maxEntries;
+        std::vector<jint> index(count * ENTRY_INDEX_FIELDS);
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(buffer);
+        for (size_t i = 0; i < count; i++) {
+            camera_metadata_entry_t entry;
+            if (get_camera_metadata_entry(buffer, i, &entry) != OK) {
+                break;
+            }
+            jint* out = &index[i * ENTRY_INDEX_FIELDS];
+            out[ENTRY_INDEX_TAG] = entry.tag;
+            out[ENTRY_INDEX_TYPE] = entry.type;
+            out[ENTRY_INDEX_COUNT] = entry.count;
+            out[ENTRY_INDEX_OFFSET] = entry.data.u8 - base;
+        }
+        if (!index.empty()) {
+            env->SetIntArrayRegion(outIndex, 0, index.size(), index.data());
+        }
+    }
+
+    jobject byteBuffer = env->NewDirectByteBuffer(buffer, get_camera_metadata_size(buffer));
+    if (byteBuffer == NULL) {
+        metadata->unlock(buffer);
+        return NULL;
+    }
+    sLockedBuffers.add(metadata);
+    return byteBuffer;
+}
+
+static void CameraMetadata_unlockBuffer(JNIEnv *env, jobject thiz) {
+    ALOGV("%s", __FUNCTION__);
+
+    CameraMetadata* metadata = CameraMetadata_getPointerThrow(env, thiz);
+    if (metadata == NULL) return;
+
+    // CameraMetadata itself would accept any unlock(getAndLock()) pair
+    Mutex::Autolock _l(sLockedBuffersLock);
+    ssize_t index = sLockedBuffers.indexOf(metadata);
+    if (index < 0) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                "Metadata buffer was not locked");
+        return;
+    }
+    sLockedBuffers.removeAt(index);
+    metadata->unlock(metadata->getAndLock());
+}
+
 static void CameraMetadata_writeValues(JNIEnv *env, jobject thiz, jint tag, jbyteArray src) {
     ALOGV("%s (tag = %d)", __FUNCTION__, tag);
 
@@ -583,6 +687,16 @@ static JNINativeMethod gCameraMetadataMethods[] = {
     (void *)CameraMetadata_writeToParcel },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gCameraMetadataOptionalMethods[] = {
+  { "nativeLockBuffer",
+    "([I)Ljava/nio/ByteBuffer;",
+    (void *)CameraMetadata_lockBuffer },
+  { "nativeUnlockBuffer",
+    "()V",
+    (void *)CameraMetadata_unlockBuffer },
+};
+
 struct field {
     const char *class_name;
     const char *field_name;
@@ -654,6 +768,10 @@ int register_android_hardware_camera2_CameraMetadata(JNIEnv *env)
             "add", "(Ljava/lang/Object;)Z");
 
     // Register native functions
+    RegisterOptionalMethods(env,
+            CAMERA_METADATA_CLASS_NAME,
+            gCameraMetadataOptionalMethods,
+            NELEM(gCameraMetadataOptionalMethods));
     return RegisterMethodsOrDie(env,
             CAMERA_METADATA_CLASS_NAME,
             gCameraMetadataMethods,
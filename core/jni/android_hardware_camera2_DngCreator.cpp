@@ -16,8 +16,10 @@
 
 #define LOG_NDEBUG 0
 #define LOG_TAG "DngCreator_JNI"
+#include <errno.h>
 #include <inttypes.h>
 #include <string.h>
+#include <unistd.h>
 #include <algorithm>
 #include <memory>
 #include <vector>
@@ -295,24 +297,94 @@ bool NativeContext::hasCaptureTime() const {
 // ----------------------------------------------------------------------------
 
 /**
- * Wrapper class for a Java OutputStream.
+ * Output that collects small writes, like the TIFF header and IFD entries, into a native buffer so
+ * that they reach the underlying sink as a few large writes. Writes at least as large as the buffer
+ * go straight through without a copy.
  *
- * This class is not intended to be used across JNI calls.
+ * Subclasses must call flush() once the last write is done; nothing is flushed on destruction.
  */
-class JniOutputStream : public Output, public LightRefBase<JniOutputStream> {
+class BufferedOutput : public Output {
 public:
-    JniOutputStream(JNIEnv* env, jobject outStream);
-
-    virtual ~JniOutputStream();
+    virtual ~BufferedOutput();
 
     status_t open();
 
     status_t write(const uint8_t* buf, size_t offset, size_t count);
 
     status_t close();
+
+    status_t flush();
+protected:
+    enum {
+        BUFFER_SIZE = 256 * 1024
+    };
+
+    BufferedOutput();
+
+    /**
+     * Write count bytes from buf to the underlying sink.
+     */
+    virtual status_t writeThrough(const uint8_t* buf, size_t count) = 0;
+private:
+    std::unique_ptr<uint8_t[]> mBuffer;
+    size_t mBufferUsed;
+};
+
+BufferedOutput::BufferedOutput() : mBuffer(new uint8_t[BUFFER_SIZE]), mBufferUsed(0) {}
+
+BufferedOutput::~BufferedOutput() {}
+
+status_t BufferedOutput::open() {
+    // Do nothing
+    return OK;
+}
+
+status_t BufferedOutput::write(const uint8_t* buf, size_t offset, size_t count) {
+    if (mBufferUsed + count > BUFFER_SIZE) {
+        status_t res = flush();
+        if (res != OK) {
+            return res;
+        }
+    }
+    if (count >= BUFFER_SIZE) {
+        return writeThrough(buf + offset, count);
+    }
+    memcpy(mBuffer.get() + mBufferUsed, buf + offset, count);
+    mBufferUsed += count;
+    return OK;
+}
+
+status_t BufferedOutput::close() {
+    return flush();
+}
+
+status_t BufferedOutput::flush() {
+    if (mBufferUsed == 0) {
+        return OK;
+    }
+    size_t used = mBufferUsed;
+    mBufferUsed = 0;
+    return writeThrough(mBuffer.get(), used);
+}
+
+// End of BufferedOutput
+// ----------------------------------------------------------------------------
+
+/**
+ * Wrapper class for a Java OutputStream.
+ *
+ * This class is not intended to be used across JNI calls.
+ */
+class JniOutputStream : public BufferedOutput, public LightRefBase<JniOutputStream> {
+public:
+    JniOutputStream(JNIEnv* env, jobject outStream);
+
+    virtual ~JniOutputStream();
+protected:
+    status_t writeThrough(const uint8_t* buf, size_t count);
 private:
     enum {
-        BYTE_ARRAY_LENGTH = 4096
+        BYTE_ARRAY_LENGTH = BUFFER_SIZE
     };
     jobject mOutputStream;
     JNIEnv* mEnv;
@@ -331,12 +403,8 @@ JniOutputStream::~JniOutputStream() {
     mEnv->DeleteLocalRef(mByteArray);
 }
 
-status_t JniOutputStream::open() {
-    // Do nothing
-    return OK;
-}
-
-status_t JniOutputStream::write(const uint8_t* buf, size_t offset, size_t count) {
+status_t JniOutputStream::writeThrough(const uint8_t* buf, size_t count) {
+    size_t offset = 0;
     while(count > 0) {
         size_t len = BYTE_ARRAY_LENGTH;
         len = (count > len) ? len : count;
@@ -359,12 +427,43 @@ status_t JniOutputStream::write(const uint8_t* buf, size_t offset, size_t count)
     return OK;
 }
 
-status_t JniOutputStream::close() {
-    // Do nothing
+// End of JniOutputStream
+// ----------------------------------------------------------------------------
+
+/**
+ * Output for a file descriptor, written with write(2) and without any calls into Java.
+ * The descriptor is not owned, and is left open.
+ */
+class FdOutputStream : public BufferedOutput {
+public:
+    explicit FdOutputStream(int fd);
+
+    virtual ~FdOutputStream();
+protected:
+    status_t writeThrough(const uint8_t* buf, size_t count);
+private:
+    int mFd;
+};
+
+FdOutputStream::FdOutputStream(int fd) : mFd(fd) {}
+
+FdOutputStream::~FdOutputStream() {}
+
+status_t FdOutputStream::writeThrough(const uint8_t* buf, size_t count) {
+    while (count > 0) {
+        ssize_t written = TEMP_FAILURE_RETRY(::write(mFd, buf, count));
+        if (written < 0) {
+            ALOGE("%s: Failed to write %zu bytes: %s (%d)", __FUNCTION__, count, strerror(errno),
+                    errno);
+            return -errno;
+        }
+        buf += written;
+        count -= written;
+    }
     return OK;
 }
 
-// End of JniOutputStream
+// End of FdOutputStream
 // ----------------------------------------------------------------------------
 
 /**
@@ -2098,12 +2197,27 @@ static void DngCreator_nativeSetThumbnail(JNIEnv* env, jobject thiz, jobject buf
     }
 }
 
-// TODO: Refactor out common preamble for the two nativeWrite methods.
-static void DngCreator_nativeWriteImage(JNIEnv* env, jobject thiz, jobject outStream, jint width,
+/**
+ * Write all of sources to out, and flush whatever out still buffers.
+ */
+static void DngCreator_writeSources(JNIEnv* env, TiffWriter* writer, BufferedOutput* out,
+        Vector<StripSource*>& sources) {
+    status_t ret = OK;
+    if ((ret = writer->write(out, sources.editArray(), sources.size())) != OK ||
+            (ret = out->flush()) != OK) {
+        ALOGE("%s: write failed with error %d.", __FUNCTION__, ret);
+        if (!env->ExceptionCheck()) {
+            jniThrowExceptionFmt(env, "java/io/IOException",
+                    "Encountered error %d while writing file.", ret);
+        }
+    }
+}
+
+// TODO: Refactor out common preamble for the two write methods.
+static void DngCreator_writeImage(JNIEnv* env, jobject thiz, BufferedOutput* out, jint width,
         jint height, jobject inBuffer, jint rowStride, jint pixStride, jlong offset,
         jboolean isDirect) {
-    ALOGV("%s:", __FUNCTION__);
-    ALOGV("%s: nativeWriteImage called with: width=%d, height=%d, "
+    ALOGV("%s: writeImage called with: width=%d, height=%d, "
           "rowStride=%d, pixStride=%d, offset=%" PRId64, __FUNCTION__, width,
           height, rowStride, pixStride, offset);
     uint32_t rStride = static_cast<uint32_t>(rowStride);
@@ -2112,12 +2226,6 @@ static void DngCreator_nativeWriteImage(JNIEnv* env, jobject thiz, jobject outSt
     uint32_t uHeight = static_cast<uint32_t>(height);
     uint64_t uOffset = static_cast<uint64_t>(offset);
 
-    sp<JniOutputStream> out = new JniOutputStream(env, outStream);
-    if(env->ExceptionCheck()) {
-        ALOGE("%s: Could not allocate buffers for output stream", __FUNCTION__);
-        return;
-    }
-
     NativeContext* context = DngCreator_getNativeContext(env, thiz);
     if (context == nullptr) {
         ALOGE("%s: Failed to initialize DngCreator", __FUNCTION__);
@@ -2177,15 +2285,7 @@ static void DngCreator_nativeWriteImage(JNIEnv* env, jobject thiz, jobject outSt
                 rStride, uOffset, BYTES_PER_SAMPLE, SAMPLES_PER_RAW_PIXEL);
         sources.add(&stripSource);
 
-        status_t ret = OK;
-        if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK) {
-            ALOGE("%s: write failed with error %d.", __FUNCTION__, ret);
-            if (!env->ExceptionCheck()) {
-                jniThrowExceptionFmt(env, "java/io/IOException",
-                        "Encountered error %d while writing file.", ret);
-            }
-            return;
-        }
+        DngCreator_writeSources(env, writer.get(), out, sources);
     } else {
         inBuf = new JniInputByteBuffer(env, inBuffer);
 
@@ -2194,21 +2294,12 @@ static void DngCreator_nativeWriteImage(JNIEnv* env, jobject thiz, jobject outSt
                  rStride, uOffset, BYTES_PER_SAMPLE, SAMPLES_PER_RAW_PIXEL);
         sources.add(&stripSource);
 
-        status_t ret = OK;
-        if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK) {
-            ALOGE("%s: write failed with error %d.", __FUNCTION__, ret);
-            if (!env->ExceptionCheck()) {
-                jniThrowExceptionFmt(env, "java/io/IOException",
-                        "Encountered error %d while writing file.", ret);
-            }
-            return;
-        }
+        DngCreator_writeSources(env, writer.get(), out, sources);
     }
 }
 
-static void DngCreator_nativeWriteInputStream(JNIEnv* env, jobject thiz, jobject outStream,
+static void DngCreator_writeInputStream(JNIEnv* env, jobject thiz, BufferedOutput* out,
         jobject inStream, jint width, jint height, jlong offset) {
-    ALOGV("%s:", __FUNCTION__);
 
     uint32_t rowStride = width * BYTES_PER_SAMPLE;
     uint32_t pixStride = BYTES_PER_SAMPLE;
@@ -2216,16 +2307,10 @@ static void DngCreator_nativeWriteInputStream(JNIEnv* env, jobject thiz, jobject
     uint32_t uHeight = static_cast<uint32_t>(height);
     uint64_t uOffset = static_cast<uint32_t>(offset);
 
-    ALOGV("%s: nativeWriteInputStream called with: width=%d, height=%d, "
+    ALOGV("%s: writeInputStream called with: width=%d, height=%d, "
           "rowStride=%d, pixStride=%d, offset=%" PRId64, __FUNCTION__, width,
           height, rowStride, pixStride, offset);
 
-    sp<JniOutputStream> out = new JniOutputStream(env, outStream);
-    if (env->ExceptionCheck()) {
-        ALOGE("%s: Could not allocate buffers for output stream", __FUNCTION__);
-        return;
-    }
-
     NativeContext* context = DngCreator_getNativeContext(env, thiz);
     if (context == nullptr) {
         ALOGE("%s: Failed to initialize DngCreator", __FUNCTION__);
@@ -2268,15 +2353,61 @@ static void DngCreator_nativeWriteInputStream(JNIEnv* env, jobject thiz, jobject
              rowStride, uOffset, BYTES_PER_SAMPLE, SAMPLES_PER_RAW_PIXEL);
     sources.add(&stripSource);
 
-    status_t ret = OK;
-    if ((ret = writer->write(out.get(), sources.editArray(), sources.size())) != OK) {
-        ALOGE("%s: write failed with error %d.", __FUNCTION__, ret);
-        if (!env->ExceptionCheck()) {
-            jniThrowExceptionFmt(env, "java/io/IOException",
-                    "Encountered error %d while writing file.", ret);
-        }
+    DngCreator_writeSources(env, writer.get(), out, sources);
+}
+
+static void DngCreator_nativeWriteImage(JNIEnv* env, jobject thiz, jobject outStream, jint width,
+        jint height, jobject inBuffer, jint rowStride, jint pixStride, jlong offset,
+        jboolean isDirect) {
+    ALOGV("%s:", __FUNCTION__);
+
+    sp<JniOutputStream> out = new JniOutputStream(env, outStream);
+    if(env->ExceptionCheck()) {
+        ALOGE("%s: Could not allocate buffers for output stream", __FUNCTION__);
         return;
     }
+    DngCreator_writeImage(env, thiz, out.get(), width, height, inBuffer, rowStride, pixStride,
+            offset, isDirect);
+}
+
+static void DngCreator_nativeWriteImageToFd(JNIEnv* env, jobject thiz, jobject fileDescriptor,
+        jint width, jint height, jobject inBuffer, jint rowStride, jint pixStride, jlong offset,
+        jboolean isDirect) {
+    ALOGV("%s:", __FUNCTION__);
+
+    int fd = jniGetFDFromFileDescriptor(env, fileDescriptor);
+    if (fd < 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "Invalid file descriptor");
+        return;
+    }
+    FdOutputStream out(fd);
+    DngCreator_writeImage(env, thiz, &out, width, height, inBuffer, rowStride, pixStride,
+            offset, isDirect);
+}
+
+static void DngCreator_nativeWriteInputStream(JNIEnv* env, jobject thiz, jobject outStream,
+        jobject inStream, jint width, jint height, jlong offset) {
+    ALOGV("%s:", __FUNCTION__);
+
+    sp<JniOutputStream> out = new JniOutputStream(env, outStream);
+    if (env->ExceptionCheck()) {
+        ALOGE("%s: Could not allocate buffers for output stream", __FUNCTION__);
+        return;
+    }
+    DngCreator_writeInputStream(env, thiz, out.get(), inStream, width, height, offset);
+}
+
+static void DngCreator_nativeWriteInputStreamToFd(JNIEnv* env, jobject thiz,
+        jobject fileDescriptor, jobject inStream, jint width, jint height, jlong offset) {
+    ALOGV("%s:", __FUNCTION__);
+
+    int fd = jniGetFDFromFileDescriptor(env, fileDescriptor);
+    if (fd < 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "Invalid file descriptor");
+        return;
+    }
+    FdOutputStream out(fd);
+    DngCreator_writeInputStream(env, thiz, &out, inStream, width, height, offset);
 }
 
 } /*extern "C" */
@@ -2298,7 +2429,18 @@ static JNINativeMethod gDngCreatorMethods[] = {
             (void*) DngCreator_nativeWriteInputStream},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gDngCreatorOptionalMethods[] = {
+    {"nativeWriteImageToFd",    "(Ljava/io/FileDescriptor;IILjava/nio/ByteBuffer;IIJZ)V",
+            (void*) DngCreator_nativeWriteImageToFd},
+    {"nativeWriteInputStreamToFd",
+            "(Ljava/io/FileDescriptor;Ljava/io/InputStream;IIJ)V",
+            (void*) DngCreator_nativeWriteInputStreamToFd},
+};
+
 int register_android_hardware_camera2_DngCreator(JNIEnv *env) {
+    RegisterOptionalMethods(env, "android/hardware/camera2/DngCreator",
+            gDngCreatorOptionalMethods, NELEM(gDngCreatorOptionalMethods));
     return RegisterMethodsOrDie(env,
             "android/hardware/camera2/DngCreator", gDngCreatorMethods, NELEM(gDngCreatorMethods));
 }
@@ -60,6 +60,8 @@ struct audiorecord_callback_cookie {
     jobject     audioRecord_ref;
     bool        busy;
     Condition   cond;
+    uint32_t    posBatch;   // number of EVENT_NEW_POS notifications coalesced per upcall
+    uint32_t    posPending; // notifications received since the last upcall
 };
 
 static Mutex sLock;
@@ -77,11 +79,20 @@ static SortedVector <audiorecord_callback_cookie *> sAudioRecordCallBackCookies;
 static void recorderCallback(int event, void* user, void *info) {
 
     audiorecord_callback_cookie *callbackInfo = (audiorecord_callback_cookie *)user;
+    uint32_t coalesced = 0;
     {
         Mutex::Autolock l(sLock);
         if (sAudioRecordCallBackCookies.indexOf(callbackInfo) < 0) {
             return;
         }
+        if (event == AudioRecord::EVENT_NEW_POS) {
+            // only every posBatch-th position update crosses into Java
+            if (++callbackInfo->posPending < callbackInfo->posBatch) {
+                return;
+            }
+            coalesced = callbackInfo->posPending;
+            callbackInfo->posPending = 0;
+        }
         callbackInfo->busy = true;
     }
 
@@ -103,10 +114,12 @@ static void recorderCallback(int event, void* user, void *info) {
     case AudioRecord::EVENT_NEW_POS: {
         JNIEnv *env = AndroidRuntime::getJNIEnv();
         if (user != NULL && env != NULL) {
+            // arg1 is the number of periods covered by this upcall, arg2 the latest position
+            const uint32_t position = info != NULL ? *(const uint32_t *)info : 0;
             env->CallStaticVoidMethod(
                 callbackInfo->audioRecord_class,
                 javaAudioRecordFields.postNativeEventInJava,
-                callbackInfo->audioRecord_ref, event, 0,0, NULL);
+                callbackInfo->audioRecord_ref, event, (jint)coalesced, (jint)position, NULL);
             if (env->ExceptionCheck()) {
                 env->ExceptionDescribe();
                 env->ExceptionClear();
@@ -268,6 +281,8 @@ android_media_AudioRecord_setup(JNIEnv *env, jobject thiz, jobject weak_this,
     // we use a weak reference so the AudioRecord object can be garbage collected.
     lpCallbackData->audioRecord_ref = env->NewGlobalRef(weak_this);
     lpCallbackData->busy = false;
+    lpCallbackData->posBatch = 1;
+    lpCallbackData->posPending = 0;
 
     const status_t status = lpRecorder->set(paa->source,
         sampleRateInHertz,
@@ -521,6 +536,64 @@ static jint android_media_AudioRecord_readInDirectBuffer(JNIEnv *env,  jobject t
     return (jint)readSize;
 }
 
+// ----------------------------------------------------------------------------
+// Reads into a window of a direct buffer, so an application managed ring of several periods
+// can be filled and consumed in place without slicing a new ByteBuffer for every read.
+static jint android_media_AudioRecord_readInDirectBufferAt(JNIEnv *env,  jobject thiz,
+                                                           jobject jBuffer, jint offsetInBytes,
+                                                           jint sizeInBytes,
+                                                           jboolean isReadBlocking) {
+    sp<AudioRecord> lpRecorder = getAudioRecord(env, thiz);
+    if (lpRecorder==NULL)
+        return (jint)AUDIO_JAVA_INVALID_OPERATION;
+
+    jlong capacity = env->GetDirectBufferCapacity(jBuffer);
+    jbyte* nativeFromJavaBuf = (jbyte*) env->GetDirectBufferAddress(jBuffer);
+    if (capacity == -1 || nativeFromJavaBuf == NULL) {
+        ALOGE("Buffer direct access is not supported, can't record");
+        return (jint)AUDIO_JAVA_BAD_VALUE;
+    }
+    if (offsetInBytes < 0 || sizeInBytes < 0 || offsetInBytes > capacity) {
+        ALOGE("Invalid window %d+%d for direct buffer of %lld bytes",
+                offsetInBytes, sizeInBytes, (long long)capacity);
+        return (jint)AUDIO_JAVA_BAD_VALUE;
+    }
+    const jlong available = capacity - offsetInBytes;
+
+    ssize_t readSize = lpRecorder->read(nativeFromJavaBuf + offsetInBytes,
+                                        available < sizeInBytes ? available : sizeInBytes,
+                                        isReadBlocking == JNI_TRUE /* blocking */);
+    if (readSize < 0) {
+        return interpretReadSizeError(readSize);
+    }
+    return (jint)readSize;
+}
+
+// ----------------------------------------------------------------------------
+// Coalesces position update notifications: Java is called back once every batchCount
+// periods instead of once per period, which matters for 10ms capture periods.
+static jint android_media_AudioRecord_set_pos_update_batch(JNIEnv *env,  jobject thiz,
+        jint batchCount) {
+    if (getAudioRecord(env, thiz) == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+            "Unable to retrieve AudioRecord pointer for setPositionUpdateBatch()");
+        return (jint)AUDIO_JAVA_ERROR;
+    }
+    if (batchCount < 1) {
+        return (jint)AUDIO_JAVA_BAD_VALUE;
+    }
+
+    Mutex::Autolock l(sLock);
+    audiorecord_callback_cookie *lpCookie = (audiorecord_callback_cookie *)env->GetLongField(
+        thiz, javaAudioRecordFields.nativeCallbackCookie);
+    if (lpCookie == NULL) {
+        return (jint)AUDIO_JAVA_INVALID_OPERATION;
+    }
+    lpCookie->posBatch = (uint32_t)batchCount;
+    lpCookie->posPending = 0;
+    return (jint)AUDIO_JAVA_SUCCESS;
+}
+
 // ----------------------------------------------------------------------------
 static jint android_media_AudioRecord_get_buffer_size_in_frames(JNIEnv *env,  jobject thiz) {
     sp<AudioRecord> lpRecorder = getAudioRecord(env, thiz);
@@ -718,6 +791,14 @@ static JNINativeMethod gMethods[] = {
                                         (void *)android_media_AudioRecord_disableDeviceCallback},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    {"native_read_in_direct_buffer_at","(Ljava/lang/Object;IIZ)I",
+                                       (void *)android_media_AudioRecord_readInDirectBufferAt},
+    {"native_set_pos_update_batch",
+                             "(I)I",   (void *)android_media_AudioRecord_set_pos_update_batch},
+};
+
 // field names found in android/media/AudioRecord.java
 #define JAVA_POSTEVENT_CALLBACK_NAME  "postEventFromNative"
 #define JAVA_NATIVERECORDERINJAVAOBJ_FIELD_NAME  "mNativeRecorderInJavaObj"
@@ -758,6 +839,7 @@ int register_android_media_AudioRecord(JNIEnv *env)
     javaAudioAttrFields.fieldFormattedTags = GetFieldIDOrDie(env,
             audioAttrClass, "mFormattedTags", "Ljava/lang/String;");
 
+    RegisterOptionalMethods(env, kClassPathName, gOptionalMethods, NELEM(gOptionalMethods));
     return RegisterMethodsOrDie(env, kClassPathName, gMethods, NELEM(gMethods));
 }
 
@@ -114,6 +114,40 @@ static SortedVector <audiotrack_callback_cookie *> sAudioTrackCallBackCookies;
 #define AUDIOTRACK_ERROR_SETUP_INVALIDSTREAMTYPE   -19
 #define AUDIOTRACK_ERROR_SETUP_NATIVEINITFAILED    -20
 
+// layout of the long[] filled by native_get_playback_state(), keep in sync with AudioTrack.java
+#define PLAYBACK_STATE_POSITION          0  // playback head position in frames
+#define PLAYBACK_STATE_UNDERRUN_FRAMES   1  // frames of silence inserted by underruns
+#define PLAYBACK_STATE_LATENCY_MS        2  // output latency in ms
+#define PLAYBACK_STATE_TIMESTAMP_FRAMES  3  // presented frame position, -1 if unavailable
+#define PLAYBACK_STATE_TIMESTAMP_NANOS   4  // CLOCK_MONOTONIC time of that frame
+#define PLAYBACK_STATE_SIZE              5
+
+// ----------------------------------------------------------------------------
+// Static buffers handed to Java by getSharedBuffer(). A direct ByteBuffer over native memory
+// can't own it, so each one is tracked with a weak global ref, and the memory it wraps stays
+// mapped until a sweep finds the ByteBuffer collected. That is independent of the AudioTrack:
+// the buffer stays usable after the track is released or finalized, as long as it's reachable.
+struct ExposedSharedBuffer {
+    jweak buffer;
+    sp<IMemory> memory;
+};
+
+static Mutex sExposedSharedBuffersLock;
+static Vector<ExposedSharedBuffer> sExposedSharedBuffers;
+
+// Drops the memory of the exposed buffers that have been collected. Runs whenever a buffer is
+// exposed or a track is released, which includes finalizers running after a GC.
+static void sweepExposedSharedBuffers(JNIEnv *env) {
+    Mutex::Autolock l(sExposedSharedBuffersLock);
+    for (size_t i = sExposedSharedBuffers.size(); i > 0; i--) {
+        const ExposedSharedBuffer& exposed = sExposedSharedBuffers[i - 1];
+        if (env->IsSameObject(exposed.buffer, NULL)) {
+            env->DeleteWeakGlobalRef(exposed.buffer);
+            sExposedSharedBuffers.removeAt(i - 1);
+        }
+    }
+}
+
 // ----------------------------------------------------------------------------
 static void audioCallback(int event, void* user, void *info) {
 
@@ -487,6 +521,8 @@ android_media_AudioTrack_set_volume(JNIEnv *env, jobject thiz, jfloat leftVol, j
 
 #define CALLBACK_COND_WAIT_TIMEOUT_MS 1000
 static void android_media_AudioTrack_release(JNIEnv *env,  jobject thiz) {
+    sweepExposedSharedBuffers(env);
+
     sp<AudioTrack> lpTrack = setAudioTrack(env, thiz, 0);
     if (lpTrack == NULL) {
         return;
@@ -516,6 +552,7 @@ static void android_media_AudioTrack_release(JNIEnv *env,  jobject thiz) {
         // delete global refs created in native_setup
         env->DeleteGlobalRef(lpCookie->audioTrack_class);
         env->DeleteGlobalRef(lpCookie->audioTrack_ref);
+        // a buffer handed out by getSharedBuffer() holds its own reference to the memory
         delete pJniStorage;
     }
 }
@@ -655,6 +692,113 @@ static jint android_media_AudioTrack_write_native_bytes(JNIEnv *env,  jobject th
     return written;
 }
 
+// ----------------------------------------------------------------------------
+// Samples everything a real-time writer needs to pace itself in a single native call, instead
+// of separate getPlaybackHeadPosition(), getUnderrunCount(), latency and getTimestamp() calls.
+static jint fillPlaybackState(JNIEnv *env, const sp<AudioTrack>& track, jlongArray jState) {
+    if (jState == NULL || env->GetArrayLength(jState) < PLAYBACK_STATE_SIZE) {
+        ALOGE("Invalid array for playback state");
+        return (jint)AUDIO_JAVA_BAD_VALUE;
+    }
+
+    jlong state[PLAYBACK_STATE_SIZE];
+    uint32_t position = 0;
+    track->getPosition(&position);
+    state[PLAYBACK_STATE_POSITION] = (jlong) position;
+    state[PLAYBACK_STATE_UNDERRUN_FRAMES] = (jlong) track->getUnderrunFrames();
+    state[PLAYBACK_STATE_LATENCY_MS] = (jlong) track->latency();
+
+    AudioTimestamp timestamp;
+    if (track->getTimestamp(timestamp) == OK) {
+        state[PLAYBACK_STATE_TIMESTAMP_FRAMES] = (jlong) timestamp.mPosition;
+        state[PLAYBACK_STATE_TIMESTAMP_NANOS] =
+                (jlong) ((timestamp.mTime.tv_sec * 1000000000LL) + timestamp.mTime.tv_nsec);
+    } else {
+        state[PLAYBACK_STATE_TIMESTAMP_FRAMES] = -1;
+        state[PLAYBACK_STATE_TIMESTAMP_NANOS] = 0;
+    }
+
+    env->SetLongArrayRegion(jState, 0, PLAYBACK_STATE_SIZE, state);
+    return (jint)AUDIO_JAVA_SUCCESS;
+}
+
+static jint android_media_AudioTrack_get_playback_state(JNIEnv *env,  jobject thiz,
+        jlongArray jState) {
+    sp<AudioTrack> lpTrack = getAudioTrack(env, thiz);
+    if (lpTrack == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+            "Unable to retrieve AudioTrack pointer for getPlaybackState()");
+        return (jint)AUDIO_JAVA_ERROR;
+    }
+    return fillPlaybackState(env, lpTrack, jState);
+}
+
+// ----------------------------------------------------------------------------
+// Writes from a direct ByteBuffer without going through ScopedBytesRO, and optionally reports
+// the playback state in the same call. The buffer memory is handed straight to the track, so
+// the only copy left is the one into the server ring.
+static jint android_media_AudioTrack_write_direct_buffer(JNIEnv *env,  jobject thiz,
+        jobject jByteBuffer, jint byteOffset, jint sizeInBytes,
+        jboolean isWriteBlocking, jlongArray jState) {
+    sp<AudioTrack> lpTrack = getAudioTrack(env, thiz);
+    if (lpTrack == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                "Unable to retrieve AudioTrack pointer for write()");
+        return (jint)AUDIO_JAVA_INVALID_OPERATION;
+    }
+
+    jbyte* data = (jbyte *) env->GetDirectBufferAddress(jByteBuffer);
+    if (data == NULL) {
+        ALOGE("Buffer for write is not direct");
+        return (jint)AUDIO_JAVA_BAD_VALUE;
+    }
+    jlong capacity = env->GetDirectBufferCapacity(jByteBuffer);
+    if (byteOffset < 0 || sizeInBytes < 0 || (jlong) byteOffset + sizeInBytes > capacity) {
+        ALOGE("Invalid range %d+%d for direct buffer of %lld bytes",
+                byteOffset, sizeInBytes, (long long) capacity);
+        return (jint)AUDIO_JAVA_BAD_VALUE;
+    }
+
+    jint written = writeToTrack(lpTrack, 0 /* unused */, data, byteOffset,
+            sizeInBytes, isWriteBlocking == JNI_TRUE /* blocking */);
+
+    if (jState != NULL && written >= 0) {
+        fillPlaybackState(env, lpTrack, jState);
+    }
+    return written;
+}
+
+// ----------------------------------------------------------------------------
+// Exposes the static mode shared memory as a direct ByteBuffer so the application can fill it
+// in place. The memory stays mapped for as long as the ByteBuffer is reachable, even after the
+// AudioTrack is released or collected; see sExposedSharedBuffers.
+static jobject android_media_AudioTrack_get_shared_buffer(JNIEnv *env,  jobject thiz) {
+    sp<AudioTrack> lpTrack = getAudioTrack(env, thiz);
+    if (lpTrack == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+            "Unable to retrieve AudioTrack pointer for getSharedBuffer()");
+        return NULL;
+    }
+
+    sp<IMemory> sharedBuffer = lpTrack->sharedBuffer();
+    if (sharedBuffer == 0 || sharedBuffer->pointer() == NULL) {
+        // streaming tracks have no client visible buffer
+        return NULL;
+    }
+
+    sweepExposedSharedBuffers(env);
+    jobject buffer = env->NewDirectByteBuffer(sharedBuffer->pointer(), sharedBuffer->size());
+    if (buffer == NULL) {
+        return NULL;
+    }
+    ExposedSharedBuffer exposed;
+    exposed.buffer = env->NewWeakGlobalRef(buffer);
+    exposed.memory = sharedBuffer;
+    Mutex::Autolock l(sExposedSharedBuffersLock);
+    sExposedSharedBuffers.add(exposed);
+    return buffer;
+}
+
 // ----------------------------------------------------------------------------
 static jint android_media_AudioTrack_get_native_frame_count(JNIEnv *env,  jobject thiz) {
     sp<AudioTrack> lpTrack = getAudioTrack(env, thiz);
@@ -1108,6 +1252,18 @@ static JNINativeMethod gMethods[] = {
     {"native_disableDeviceCallback", "()V", (void *)android_media_AudioTrack_disableDeviceCallback},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    {"native_write_direct_buffer",
+                             "(Ljava/nio/ByteBuffer;IIZ[J)I",
+                                         (void *)android_media_AudioTrack_write_direct_buffer},
+    {"native_get_shared_buffer",
+                             "()Ljava/nio/ByteBuffer;",
+                                         (void *)android_media_AudioTrack_get_shared_buffer},
+    {"native_get_playback_state",
+                             "([J)I",    (void *)android_media_AudioTrack_get_playback_state},
+};
+
 
 // field names found in android/media/AudioTrack.java
 #define JAVA_POSTEVENT_CALLBACK_NAME                    "postEventFromNative"
@@ -1173,6 +1329,7 @@ int register_android_media_AudioTrack(JNIEnv *env)
     // initialize PlaybackParams field info
     gPlaybackParamsFields.init(env);
 
+    RegisterOptionalMethods(env, kClassPathName, gOptionalMethods, NELEM(gOptionalMethods));
     return RegisterMethodsOrDie(env, kClassPathName, gMethods, NELEM(gMethods));
 }
 
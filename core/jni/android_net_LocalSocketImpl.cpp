@@ -18,6 +18,7 @@
 
 #include "JNIHelp.h"
 #include "jni.h"
+#include "android_runtime/AndroidRuntime.h"
 #include "utils/Log.h"
 #include "utils/misc.h"
 
@@ -46,6 +47,7 @@ static jfieldID field_inboundFileDescriptors;
 static jfieldID field_outboundFileDescriptors;
 static jclass class_Credentials;
 static jclass class_FileDescriptor;
+static jclass class_byteArray;
 static jmethodID method_CredentialsInit;
 
 /* private native void connectLocal(FileDescriptor fd,
@@ -491,30 +493,24 @@ static int socket_process_cmsg(JNIEnv *env, jobject thisJ, struct msghdr * pMsg)
  * Returns the length of normal data read, or -1 if an exception has
  * been thrown in this function.
  */
-static ssize_t socket_read_all(JNIEnv *env, jobject thisJ, int fd,
-        void *buffer, size_t len)
+static ssize_t socket_readv_all(JNIEnv *env, jobject thisJ, int fd,
+        struct iovec *iov, int iovcnt, int flags)
 {
     ssize_t ret;
     struct msghdr msg;
-    struct iovec iv;
-    unsigned char *buf = (unsigned char *)buffer;
     // Enough buffer for a pile of fd's. We throw an exception if
     // this buffer is too small.
     struct cmsghdr cmsgbuf[2*sizeof(cmsghdr) + 0x100];
 
     memset(&msg, 0, sizeof(msg));
-    memset(&iv, 0, sizeof(iv));
-
-    iv.iov_base = buf;
-    iv.iov_len = len;
 
-    msg.msg_iov = &iv;
-    msg.msg_iovlen = 1;
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
     msg.msg_control = cmsgbuf;
     msg.msg_controllen = sizeof(cmsgbuf);
 
     do {
-        ret = recvmsg(fd, &msg, MSG_NOSIGNAL);
+        ret = recvmsg(fd, &msg, MSG_NOSIGNAL | flags);
     } while (ret < 0 && errno == EINTR);
 
     if (ret < 0 && errno == EPIPE) {
@@ -522,6 +518,11 @@ static ssize_t socket_read_all(JNIEnv *env, jobject thisJ, int fd,
         return 0;
     }
 
+    if (ret < 0 && (flags & MSG_DONTWAIT) && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // Nothing to read yet, only reported to non-blocking reads
+        return -2;
+    }
+
     if (ret < 0) {
         jniThrowIOException(env, errno);
         return -1;
@@ -543,17 +544,27 @@ static ssize_t socket_read_all(JNIEnv *env, jobject thisJ, int fd,
     return ret;
 }
 
+static ssize_t socket_read_all(JNIEnv *env, jobject thisJ, int fd,
+        void *buffer, size_t len)
+{
+    struct iovec iv;
+    iv.iov_base = buffer;
+    iv.iov_len = len;
+    return socket_readv_all(env, thisJ, fd, &iv, 1, 0);
+}
+
 /**
- * Writes all the data in the specified buffer to the specified socket.
+ * Writes all the data in the specified buffers to the specified socket,
+ * along with any pending outbound file descriptors. As much as the socket
+ * takes goes out in each sendmsg(), so a whole command usually costs one.
  *
  * Returns 0 on success or -1 if an exception was thrown.
  */
-static int socket_write_all(JNIEnv *env, jobject object, int fd,
-        void *buf, size_t len)
+static int socket_writev_all(JNIEnv *env, jobject object, int fd,
+        struct iovec *iov, int iovcnt)
 {
     ssize_t ret;
     struct msghdr msg;
-    unsigned char *buffer = (unsigned char *)buf;
     memset(&msg, 0, sizeof(msg));
 
     jobjectArray outboundFds
@@ -598,16 +609,16 @@ static int socket_write_all(JNIEnv *env, jobject object, int fd,
         memcpy(CMSG_DATA(cmsg), fds, sizeof fds);
     }
 
-    // We only write our msg_control during the first write
-    while (len > 0) {
-        struct iovec iv;
-        memset(&iv, 0, sizeof(iv));
-
-        iv.iov_base = buffer;
-        iv.iov_len = len;
+    // Skip empty leading buffers, the rest is written in order
+    while (iovcnt > 0 && iov->iov_len == 0) {
+        iov++;
+        iovcnt--;
+    }
 
-        msg.msg_iov = &iv;
-        msg.msg_iovlen = 1;
+    // We only write our msg_control during the first write
+    while (iovcnt > 0) {
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
 
         do {
             ret = sendmsg(fd, &msg, MSG_NOSIGNAL);
@@ -618,8 +629,17 @@ static int socket_write_all(JNIEnv *env, jobject object, int fd,
             return -1;
         }
 
-        buffer += ret;
-        len -= ret;
+        // Advance past what was written, possibly into the middle of a buffer
+        size_t written = ret;
+        while (iovcnt > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (unsigned char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
 
         // Wipes out any msg_control too
         memset(&msg, 0, sizeof(msg));
@@ -628,6 +648,15 @@ static int socket_write_all(JNIEnv *env, jobject object, int fd,
     return 0;
 }
 
+static int socket_write_all(JNIEnv *env, jobject object, int fd,
+        void *buf, size_t len)
+{
+    struct iovec iv;
+    iv.iov_base = buf;
+    iv.iov_len = len;
+    return socket_writev_all(env, object, fd, &iv, 1);
+}
+
 static jint socket_read (JNIEnv *env, jobject object, jobject fileDescriptor)
 {
     int fd;
@@ -766,6 +795,190 @@ static void socket_writeba (JNIEnv *env, jobject object,
     env->ReleaseByteArrayElements(buffer, byteBuffer, JNI_ABORT);
 }
 
+// Most segments a single readv_native() or writev_native() call takes
+#define MAX_IO_SEGMENTS 16
+
+/**
+ * Resolves segments, each a byte[] or a direct ByteBuffer with an offset
+ * and a length, into iovecs. Arrays are pinned into arrayElements and
+ * must be released with socket_release_segments().
+ *
+ * Returns the number of segments or -1 if an exception was thrown.
+ */
+static void socket_release_segments(JNIEnv *env, int count,
+        jbyteArray *arrays, jbyte **arrayElements, int mode);
+
+static int socket_get_segments(JNIEnv *env, jobjectArray segments,
+        jintArray offsets, jintArray lengths, struct iovec *iov,
+        jbyteArray *arrays, jbyte **arrayElements)
+{
+    if (segments == NULL || offsets == NULL || lengths == NULL) {
+        jniThrowNullPointerException(env, NULL);
+        return -1;
+    }
+
+    int count = env->GetArrayLength(segments);
+    if (count > MAX_IO_SEGMENTS || env->GetArrayLength(offsets) < count
+            || env->GetArrayLength(lengths) < count) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                "bad segment count");
+        return -1;
+    }
+
+    jint off[MAX_IO_SEGMENTS];
+    jint len[MAX_IO_SEGMENTS];
+    env->GetIntArrayRegion(offsets, 0, count, off);
+    env->GetIntArrayRegion(lengths, 0, count, len);
+
+    memset(arrays, 0, sizeof(jbyteArray) * count);
+    memset(arrayElements, 0, sizeof(jbyte *) * count);
+    for (int i = 0; i < count; i++) {
+        jobject segment = env->GetObjectArrayElement(segments, i);
+        if (segment == NULL) {
+            jniThrowNullPointerException(env, NULL);
+            goto fail;
+        }
+
+        jlong capacity;
+        jbyte *base = NULL;
+        if (env->IsInstanceOf(segment, class_byteArray)) {
+            arrays[i] = (jbyteArray)segment;
+            capacity = env->GetArrayLength(arrays[i]);
+        } else {
+            base = (jbyte *)env->GetDirectBufferAddress(segment);
+            capacity = env->GetDirectBufferCapacity(segment);
+            env->DeleteLocalRef(segment);
+            if (base == NULL) {
+                jniThrowException(env, "java/lang/IllegalArgumentException",
+                        "segments must be byte[] or direct ByteBuffers");
+                goto fail;
+            }
+        }
+
+        if (off[i] < 0 || len[i] < 0 || (jlong)off[i] + len[i] > capacity) {
+            jniThrowException(env, "java/lang/ArrayIndexOutOfBoundsException", NULL);
+            goto fail;
+        }
+
+        if (arrays[i] != NULL) {
+            base = env->GetByteArrayElements(arrays[i], NULL);
+            if (base == NULL) {
+                // an exception will have been thrown
+                goto fail;
+            }
+            arrayElements[i] = base;
+        }
+
+        iov[i].iov_base = base + off[i];
+        iov[i].iov_len = len[i];
+    }
+    return count;
+
+fail:
+    socket_release_segments(env, count, arrays, arrayElements, JNI_ABORT);
+    return -1;
+}
+
+static void socket_release_segments(JNIEnv *env, int count,
+        jbyteArray *arrays, jbyte **arrayElements, int mode)
+{
+    for (int i = 0; i < count; i++) {
+        if (arrays[i] != NULL) {
+            if (arrayElements[i] != NULL) {
+                env->ReleaseByteArrayElements(arrays[i], arrayElements[i], mode);
+            }
+            env->DeleteLocalRef(arrays[i]);
+        }
+    }
+}
+
+/*
+ * private native int readv_native(Object[] segments, int[] offsets,
+ *         int[] lengths, boolean nonBlocking, FileDescriptor fd)
+ *
+ * Scatters one recvmsg() over byte[] and direct ByteBuffer segments.
+ * Returns the number of bytes read, -1 at end of stream, or 0 if
+ * nonBlocking is set and nothing is available.
+ */
+static jint socket_readv (JNIEnv *env, jobject object, jobjectArray segments,
+        jintArray offsets, jintArray lengths, jboolean nonBlocking,
+        jobject fileDescriptor)
+{
+    if (fileDescriptor == NULL) {
+        jniThrowNullPointerException(env, NULL);
+        return (jint)-1;
+    }
+
+    int fd = jniGetFDFromFileDescriptor(env, fileDescriptor);
+    if (env->ExceptionCheck()) {
+        return (jint)-1;
+    }
+
+    struct iovec iov[MAX_IO_SEGMENTS];
+    jbyteArray arrays[MAX_IO_SEGMENTS];
+    jbyte *arrayElements[MAX_IO_SEGMENTS];
+    int count = socket_get_segments(env, segments, offsets, lengths,
+            iov, arrays, arrayElements);
+    if (count < 0) {
+        return (jint)-1;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        total += iov[i].iov_len;
+    }
+
+    ssize_t ret = 0;
+    if (total > 0) {
+        ret = socket_readv_all(env, object, fd, iov, count,
+                nonBlocking ? MSG_DONTWAIT : 0);
+    }
+
+    socket_release_segments(env, count, arrays, arrayElements, 0);
+
+    if (total == 0 || ret == -2) {
+        return 0;
+    }
+    // A return of -1 above means an exception is pending
+    return (jint) ((ret == 0) ? -1 : ret);
+}
+
+/*
+ * private native void writev_native(Object[] segments, int[] offsets,
+ *         int[] lengths, FileDescriptor fd)
+ *
+ * Gathers byte[] and direct ByteBuffer segments, and the pending outbound
+ * file descriptors, into as few sendmsg() calls as the socket allows.
+ */
+static void socket_writev (JNIEnv *env, jobject object, jobjectArray segments,
+        jintArray offsets, jintArray lengths, jobject fileDescriptor)
+{
+    if (fileDescriptor == NULL) {
+        jniThrowNullPointerException(env, NULL);
+        return;
+    }
+
+    int fd = jniGetFDFromFileDescriptor(env, fileDescriptor);
+    if (env->ExceptionCheck()) {
+        return;
+    }
+
+    struct iovec iov[MAX_IO_SEGMENTS];
+    jbyteArray arrays[MAX_IO_SEGMENTS];
+    jbyte *arrayElements[MAX_IO_SEGMENTS];
+    int count = socket_get_segments(env, segments, offsets, lengths,
+            iov, arrays, arrayElements);
+    if (count < 0) {
+        return;
+    }
+
+    int err = socket_writev_all(env, object, fd, iov, count);
+    UNUSED(err);
+    // A return of -1 above means an exception is pending
+
+    socket_release_segments(env, count, arrays, arrayElements, JNI_ABORT);
+}
+
 static jobject socket_get_peer_credentials(JNIEnv *env,
         jobject object, jobject fileDescriptor)
 {
@@ -881,6 +1094,14 @@ static JNINativeMethod gMethods[] = {
 
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    {"readv_native", "([Ljava/lang/Object;[I[IZLjava/io/FileDescriptor;)I",
+            (void*) socket_readv},
+    {"writev_native", "([Ljava/lang/Object;[I[ILjava/io/FileDescriptor;)V",
+            (void*) socket_writev},
+};
+
 int register_android_net_LocalSocketImpl(JNIEnv *env)
 {
     jclass clazz;
@@ -921,6 +1142,14 @@ int register_android_net_LocalSocketImpl(JNIEnv *env)
 
     class_FileDescriptor = (jclass)env->NewGlobalRef(class_FileDescriptor);
 
+    class_byteArray = env->FindClass("[B");
+
+    if (class_byteArray == NULL) {
+        goto error;
+    }
+
+    class_byteArray = (jclass)env->NewGlobalRef(class_byteArray);
+
     method_CredentialsInit
             = env->GetMethodID(class_Credentials, "<init>", "(III)V");
 
@@ -928,6 +1157,8 @@ int register_android_net_LocalSocketImpl(JNIEnv *env)
         goto error;
     }
 
+    AndroidRuntime::registerOptionalNativeMethods(env,
+        "android/net/LocalSocketImpl", gOptionalMethods, NELEM(gOptionalMethods));
     return jniRegisterNativeMethods(env,
         "android/net/LocalSocketImpl", gMethods, NELEM(gMethods));
 
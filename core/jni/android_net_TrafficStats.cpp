@@ -23,11 +23,18 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "core_jni_helpers.h"
 #include <jni.h>
+#include <JNIHelp.h>
 #include <ScopedUtfChars.h>
 #include <utils/misc.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -74,7 +81,46 @@ static uint64_t getStatsType(struct Stats* stats, StatsType type) {
     }
 }
 
-static int parseIfaceStats(const char* iface, struct Stats* stats) {
+// Consecutive queries within this window share one parse of each stats file
+static const nsecs_t STATS_CACHE_DURATION = ms2ns(100);
+
+struct IfaceStats {
+    std::string iface;
+    Stats stats;
+};
+
+struct StatsCache {
+    Mutex lock;
+    nsecs_t parseTime = 0;
+    bool valid = false;
+};
+
+static StatsCache sIfaceCache;
+static std::vector<IfaceStats> sIfaceStats;
+static bool sIfaceFoundTcp = false;
+
+static StatsCache sUidCache;
+static std::unordered_map<uint32_t, Stats> sUidStats;
+
+static bool isCacheFresh(const StatsCache& cache) {
+    return cache.valid && systemTime(SYSTEM_TIME_MONOTONIC) - cache.parseTime < STATS_CACHE_DURATION;
+}
+
+static void markCacheParsed(StatsCache& cache, bool valid) {
+    cache.parseTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    cache.valid = valid;
+}
+
+// Must be called with sIfaceCache.lock held
+static int readIfaceStats() {
+    if (isCacheFresh(sIfaceCache)) {
+        return 0;
+    }
+
+    sIfaceStats.clear();
+    sIfaceFoundTcp = false;
+    markCacheParsed(sIfaceCache, false);
+
     FILE *fp = fopen(QTAGUID_IFACE_STATS, "r");
     if (fp == NULL) {
         return -1;
@@ -82,7 +128,6 @@ static int parseIfaceStats(const char* iface, struct Stats* stats) {
 
     char buffer[384];
     char cur_iface[32];
-    bool foundTcp = false;
     uint64_t rxBytes, rxPackets, txBytes, txPackets, tcpRxPackets, tcpTxPackets;
 
     while (fgets(buffer, sizeof(buffer), fp) != NULL) {
@@ -91,34 +136,64 @@ static int parseIfaceStats(const char* iface, struct Stats* stats) {
                 "%*u %" SCNu64 " %*u %*u %*u %*u", cur_iface, &rxBytes,
                 &rxPackets, &txBytes, &txPackets, &tcpRxPackets, &tcpTxPackets);
         if (matched >= 5) {
+            IfaceStats row;
+            row.iface = cur_iface;
+            row.stats.rxBytes = rxBytes;
+            row.stats.rxPackets = rxPackets;
+            row.stats.txBytes = txBytes;
+            row.stats.txPackets = txPackets;
             if (matched == 7) {
-                foundTcp = true;
-            }
-            if (!iface || !strcmp(iface, cur_iface)) {
-                stats->rxBytes += rxBytes;
-                stats->rxPackets += rxPackets;
-                stats->txBytes += txBytes;
-                stats->txPackets += txPackets;
-                if (matched == 7) {
-                    stats->tcpRxPackets += tcpRxPackets;
-                    stats->tcpTxPackets += tcpTxPackets;
-                }
+                sIfaceFoundTcp = true;
+                row.stats.tcpRxPackets = tcpRxPackets;
+                row.stats.tcpTxPackets = tcpTxPackets;
+            } else {
+                row.stats.tcpRxPackets = 0;
+                row.stats.tcpTxPackets = 0;
             }
+            sIfaceStats.push_back(row);
         }
     }
 
-    if (!foundTcp) {
-        stats->tcpRxPackets = UNKNOWN;
-        stats->tcpTxPackets = UNKNOWN;
+    if (fclose(fp) != 0) {
+        return -1;
     }
+    markCacheParsed(sIfaceCache, true);
+    return 0;
+}
 
-    if (fclose(fp) != 0) {
+static int parseIfaceStats(const char* iface, struct Stats* stats) {
+    Mutex::Autolock _l(sIfaceCache.lock);
+    if (readIfaceStats() != 0) {
         return -1;
     }
+
+    for (const IfaceStats& row : sIfaceStats) {
+        if (!iface || row.iface == iface) {
+            stats->rxBytes += row.stats.rxBytes;
+            stats->rxPackets += row.stats.rxPackets;
+            stats->txBytes += row.stats.txBytes;
+            stats->txPackets += row.stats.txPackets;
+            stats->tcpRxPackets += row.stats.tcpRxPackets;
+            stats->tcpTxPackets += row.stats.tcpTxPackets;
+        }
+    }
+
+    if (!sIfaceFoundTcp) {
+        stats->tcpRxPackets = UNKNOWN;
+        stats->tcpTxPackets = UNKNOWN;
+    }
     return 0;
 }
 
-static int parseUidStats(const uint32_t uid, struct Stats* stats) {
+// Must be called with sUidCache.lock held
+static int readUidStats() {
+    if (isCacheFresh(sUidCache)) {
+        return 0;
+    }
+
+    sUidStats.clear();
+    markCacheParsed(sUidCache, false);
+
     FILE *fp = fopen(QTAGUID_UID_STATS, "r");
     if (fp == NULL) {
         return -1;
@@ -135,11 +210,12 @@ static int parseUidStats(const uint32_t uid, struct Stats* stats) {
                 " %" SCNu64 " %" SCNu64 "",
                 &idx, iface, &tag, &cur_uid, &set, &rxBytes, &rxPackets,
                 &txBytes, &txPackets) == 9) {
-            if (uid == cur_uid && tag == 0L) {
-                stats->rxBytes += rxBytes;
-                stats->rxPackets += rxPackets;
-                stats->txBytes += txBytes;
-                stats->txPackets += txPackets;
+            if (tag == 0L) {
+                Stats& stats = sUidStats[cur_uid];
+                stats.rxBytes += rxBytes;
+                stats.rxPackets += rxPackets;
+                stats.txBytes += txBytes;
+                stats.txPackets += txPackets;
             }
         }
     }
@@ -147,9 +223,41 @@ static int parseUidStats(const uint32_t uid, struct Stats* stats) {
     if (fclose(fp) != 0) {
         return -1;
     }
+    markCacheParsed(sUidCache, true);
+    return 0;
+}
+
+static int parseUidStats(const uint32_t uid, struct Stats* stats) {
+    Mutex::Autolock _l(sUidCache.lock);
+    if (readUidStats() != 0) {
+        return -1;
+    }
+
+    auto iter = sUidStats.find(uid);
+    if (iter != sUidStats.end()) {
+        const Stats& uidStats = iter->second;
+        stats->rxBytes += uidStats.rxBytes;
+        stats->rxPackets += uidStats.rxPackets;
+        stats->txBytes += uidStats.txBytes;
+        stats->txPackets += uidStats.txPackets;
+    }
     return 0;
 }
 
+// Fills every counter, indexed by StatsType, from a single parse
+static jboolean copyStats(JNIEnv* env, struct Stats* stats, jlongArray outStats) {
+    if (env->GetArrayLength(outStats) <= TCP_TX_PACKETS) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "outStats too short");
+        return JNI_FALSE;
+    }
+    jlong values[TCP_TX_PACKETS + 1];
+    for (int type = RX_BYTES; type <= TCP_TX_PACKETS; type++) {
+        values[type] = getStatsType(stats, (StatsType) type);
+    }
+    env->SetLongArrayRegion(outStats, 0, TCP_TX_PACKETS + 1, values);
+    return JNI_TRUE;
+}
+
 static jlong getTotalStat(JNIEnv* env, jclass clazz, jint type) {
     struct Stats stats;
     memset(&stats, 0, sizeof(Stats));
@@ -185,13 +293,54 @@ static jlong getUidStat(JNIEnv* env, jclass clazz, jint uid, jint type) {
     }
 }
 
+static jboolean getTotalStats(JNIEnv* env, jclass clazz, jlongArray outStats) {
+    struct Stats stats;
+    memset(&stats, 0, sizeof(Stats));
+    if (parseIfaceStats(NULL, &stats) != 0) {
+        return JNI_FALSE;
+    }
+    return copyStats(env, &stats, outStats);
+}
+
+static jboolean getIfaceStats(JNIEnv* env, jclass clazz, jstring iface, jlongArray outStats) {
+    ScopedUtfChars iface8(env, iface);
+    if (iface8.c_str() == NULL) {
+        return JNI_FALSE;
+    }
+
+    struct Stats stats;
+    memset(&stats, 0, sizeof(Stats));
+    if (parseIfaceStats(iface8.c_str(), &stats) != 0) {
+        return JNI_FALSE;
+    }
+    return copyStats(env, &stats, outStats);
+}
+
+static jboolean getUidStats(JNIEnv* env, jclass clazz, jint uid, jlongArray outStats) {
+    struct Stats stats;
+    memset(&stats, 0, sizeof(Stats));
+    if (parseUidStats(uid, &stats) != 0) {
+        return JNI_FALSE;
+    }
+    return copyStats(env, &stats, outStats);
+}
+
 static JNINativeMethod gMethods[] = {
     {"nativeGetTotalStat", "(I)J", (void*) getTotalStat},
     {"nativeGetIfaceStat", "(Ljava/lang/String;I)J", (void*) getIfaceStat},
     {"nativeGetUidStat", "(II)J", (void*) getUidStat},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    {"nativeGetTotalStats", "([J)Z", (void*) getTotalStats},
+    {"nativeGetIfaceStats", "(Ljava/lang/String;[J)Z", (void*) getIfaceStats},
+    {"nativeGetUidStats", "(I[J)Z", (void*) getUidStats},
+};
+
 int register_android_net_TrafficStats(JNIEnv* env) {
+    RegisterOptionalMethods(env, "android/net/TrafficStats", gOptionalMethods,
+                            NELEM(gOptionalMethods));
     return RegisterMethodsOrDie(env, "android/net/TrafficStats", gMethods, NELEM(gMethods));
 }
 
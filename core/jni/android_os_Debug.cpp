@@ -221,10 +221,289 @@ static int read_memtrack_memory(int pid, struct graphics_memory_pss* graphics_me
     return err;
 }
 
-static void read_mapinfo(FILE *fp, stats_t* stats)
+/*
+ * Reads the lines of a /proc file with a few large reads rather than stdio
+ * calls per line, since smaps has a dozen lines for every mapping. Lines
+ * longer than the buffer are truncated.
+ */
+class ProcFileReader {
+public:
+    explicit ProcFileReader(const char* path)
+            : mFd(TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC)))
+            , mStart(0)
+            , mEnd(0)
+            , mEof(false)
+            , mTruncated(false) {
+    }
+
+    ~ProcFileReader() {
+        if (mFd >= 0) {
+            close(mFd);
+        }
+    }
+
+    bool isOpen() const { return mFd >= 0; }
+
+    // Returns the next line without its newline, or NULL at the end of the
+    // file. The line stays valid until the next call.
+    const char* nextLine(size_t* outLen) {
+        while (true) {
+            char* newline = (char*) memchr(mBuffer + mStart, '\n', mEnd - mStart);
+            if (newline != NULL || (mEof && mStart < mEnd)) {
+                char* line = mBuffer + mStart;
+                char* lineEnd = newline != NULL ? newline : mBuffer + mEnd;
+                *lineEnd = 0;
+                mStart = lineEnd - mBuffer + (newline != NULL ? 1 : 0);
+                if (mTruncated) {
+                    // The end of a line that has already been returned
+                    mTruncated = false;
+                    continue;
+                }
+                *outLen = lineEnd - line;
+                return line;
+            }
+            if (mEof) {
+                return NULL;
+            }
+
+            if (mStart == 0 && mEnd == sizeof(mBuffer) - 1) {
+                // Return what fits and drop the rest of the line.
+                mBuffer[mEnd] = 0;
+                *outLen = mEnd;
+                mStart = mEnd = 0;
+                mTruncated = true;
+                return mBuffer;
+            }
+
+            memmove(mBuffer, mBuffer + mStart, mEnd - mStart);
+            mEnd -= mStart;
+            mStart = 0;
+            ssize_t count = TEMP_FAILURE_RETRY(read(mFd, mBuffer + mEnd,
+                    sizeof(mBuffer) - 1 - mEnd));
+            if (count <= 0) {
+                mEof = true;
+            } else {
+                mEnd += count;
+            }
+        }
+    }
+
+private:
+    int mFd;
+    size_t mStart;
+    size_t mEnd;
+    bool mEof;
+    bool mTruncated;
+    char mBuffer[16 * 1024];
+};
+
+static inline bool is_hex_digit(char c)
 {
-    char line[1024];
-    int len, nameLen;
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static const char* parse_hex(const char* p, uint64_t* out)
+{
+    uint64_t value = 0;
+    for (; is_hex_digit(*p); p++) {
+        value = (value << 4) | (*p <= '9' ? *p - '0' : (*p | 0x20) - 'a' + 10);
+    }
+    *out = value;
+    return p;
+}
+
+static const char* skip_spaces(const char* p)
+{
+    while (isspace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+/*
+ * Parses the first line of a mapping, for example:
+ * "10000000-10001000 ---p 10000000 00:00 0          /system/lib/libc.so".
+ * Returns false if the line isn't one.
+ */
+static bool parse_mapping(const char* line, uint64_t* start, uint64_t* end, const char** name)
+{
+    if (!is_hex_digit(*line)) {
+        return false;
+    }
+    const char* p = parse_hex(line, start);
+    if (*p != '-' || !is_hex_digit(p[1])) {
+        return false;
+    }
+    p = parse_hex(p + 1, end);
+
+    // Skip the permissions, offset, device and inode.
+    for (int i = 0; i < 4; i++) {
+        if (*p != ' ') {
+            return false;
+        }
+        p = skip_spaces(p);
+        while (*p != 0 && !isspace(*p)) {
+            p++;
+        }
+    }
+    *name = skip_spaces(p);
+    return true;
+}
+
+/*
+ * Parses a line like "Pss:                 12 kB" if it starts with the given
+ * field name, colon included.
+ */
+static inline bool parse_field(const char* line, size_t len, const char* field,
+        size_t fieldLen, unsigned* out)
+{
+    if (len <= fieldLen || memcmp(line, field, fieldLen) != 0) {
+        return false;
+    }
+    const char* p = skip_spaces(line + fieldLen);
+    unsigned value = 0;
+    for (; *p >= '0' && *p <= '9'; p++) {
+        value = value * 10 + (*p - '0');
+    }
+    *out = value;
+    return true;
+}
+
+#define PARSE_FIELD(line, len, field, out) parse_field(line, len, field, sizeof(field) - 1, out)
+
+struct map_suffix_t {
+    const char* str;
+    size_t len;
+    int heap;
+    // Whether the suffix may also be found in the middle of the name
+    bool anywhere;
+};
+
+#define MAP_SUFFIX(str, heap, anywhere) { str, sizeof(str) - 1, heap, anywhere }
+
+// The file mappings that can be swapped, by suffix. Checked in order.
+static const map_suffix_t kSwappableFileSuffixes[] = {
+    MAP_SUFFIX(".so", HEAP_SO, false),
+    MAP_SUFFIX(".jar", HEAP_JAR, false),
+    MAP_SUFFIX(".apk", HEAP_APK, false),
+    MAP_SUFFIX(".ttf", HEAP_TTF, false),
+    MAP_SUFFIX(".dex", HEAP_DEX, true),
+    MAP_SUFFIX(".odex", HEAP_DEX, false),
+    MAP_SUFFIX(".oat", HEAP_OAT, false),
+    MAP_SUFFIX(".art", HEAP_ART, false),
+};
+
+struct map_name_t {
+    const char* str;
+    size_t len;
+    int heap;
+    int subHeap;
+};
+
+#define MAP_NAME(str, heap, subHeap) { str, sizeof(str) - 1, heap, subHeap }
+
+#define DALVIK_ASHMEM_PREFIX "/dev/ashmem/dalvik-"
+
+// The spaces of the runtime, by what follows DALVIK_ASHMEM_PREFIX. The ones
+// that aren't found are accounting.
+static const map_name_t kDalvikSpacePrefixes[] = {
+    MAP_NAME("LinearAlloc", HEAP_DALVIK_OTHER, HEAP_DALVIK_LINEARALLOC),
+    // This is the regular Dalvik heap.
+    MAP_NAME("alloc space", HEAP_DALVIK, HEAP_DALVIK_NORMAL),
+    MAP_NAME("main space", HEAP_DALVIK, HEAP_DALVIK_NORMAL),
+    MAP_NAME("large object space", HEAP_DALVIK, HEAP_DALVIK_LARGE),
+    MAP_NAME("free list large object space", HEAP_DALVIK, HEAP_DALVIK_LARGE),
+    MAP_NAME("non moving space", HEAP_DALVIK, HEAP_DALVIK_NON_MOVING),
+    MAP_NAME("zygote space", HEAP_DALVIK, HEAP_DALVIK_ZYGOTE),
+    MAP_NAME("indirect ref", HEAP_DALVIK_OTHER, HEAP_DALVIK_INDIRECT_REFERENCE_TABLE),
+    MAP_NAME("jit-code-cache", HEAP_DALVIK_OTHER, HEAP_DALVIK_CODE_CACHE),
+};
+
+#define STARTS_WITH(name, nameLen, prefix) \
+    ((nameLen) >= sizeof(prefix) - 1 && memcmp(name, prefix, sizeof(prefix) - 1) == 0)
+
+/*
+ * Finds the heap of a mapping from its name. prevHeap and prevEnd describe
+ * the previous mapping.
+ */
+static void classify_mapping(const char* name, size_t nameLen, uint64_t start,
+        uint64_t prevEnd, int prevHeap, int* whichHeap, int* subHeap, bool* isSwappable)
+{
+    *whichHeap = HEAP_UNKNOWN;
+    *subHeap = HEAP_UNKNOWN;
+    *isSwappable = false;
+
+    if (nameLen == 0) {
+        if (start == prevEnd && prevHeap == HEAP_SO) {
+            // bss section of a shared library.
+            *whichHeap = HEAP_SO;
+        }
+        return;
+    }
+
+    if (name[0] == '[') {
+        if (STARTS_WITH(name, nameLen, "[heap]")
+                || STARTS_WITH(name, nameLen, "[anon:libc_malloc]")) {
+            *whichHeap = HEAP_NATIVE;
+            return;
+        }
+        if (STARTS_WITH(name, nameLen, "[stack")) {
+            *whichHeap = HEAP_STACK;
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < NELEM(kSwappableFileSuffixes); i++) {
+        const map_suffix_t& suffix = kSwappableFileSuffixes[i];
+        if (nameLen <= suffix.len) {
+            continue;
+        }
+        const bool found = suffix.anywhere
+                ? memmem(name, nameLen, suffix.str, suffix.len) != NULL
+                : memcmp(name + nameLen - suffix.len, suffix.str, suffix.len) == 0;
+        if (found) {
+            *whichHeap = suffix.heap;
+            *isSwappable = true;
+            return;
+        }
+    }
+
+    if (STARTS_WITH(name, nameLen, "/dev/")) {
+        if (STARTS_WITH(name, nameLen, "/dev/kgsl-3d0")) {
+            *whichHeap = HEAP_GL_DEV;
+        } else if (STARTS_WITH(name, nameLen, DALVIK_ASHMEM_PREFIX)) {
+            const char* space = name + sizeof(DALVIK_ASHMEM_PREFIX) - 1;
+            const size_t spaceLen = nameLen - (sizeof(DALVIK_ASHMEM_PREFIX) - 1);
+            *whichHeap = HEAP_DALVIK_OTHER;
+            *subHeap = HEAP_DALVIK_ACCOUNTING;  // Default to accounting.
+            for (size_t i = 0; i < NELEM(kDalvikSpacePrefixes); i++) {
+                const map_name_t& prefix = kDalvikSpacePrefixes[i];
+                if (spaceLen >= prefix.len && memcmp(space, prefix.str, prefix.len) == 0) {
+                    *whichHeap = prefix.heap;
+                    *subHeap = prefix.subHeap;
+                    break;
+                }
+            }
+        } else if (STARTS_WITH(name, nameLen, "/dev/ashmem/CursorWindow")) {
+            *whichHeap = HEAP_CURSOR;
+        } else if (STARTS_WITH(name, nameLen, "/dev/ashmem/libc malloc")) {
+            *whichHeap = HEAP_NATIVE;
+        } else if (STARTS_WITH(name, nameLen, "/dev/ashmem")) {
+            *whichHeap = HEAP_ASHMEM;
+        } else {
+            *whichHeap = HEAP_UNKNOWN_DEV;
+        }
+    } else if (STARTS_WITH(name, nameLen, "[anon:")) {
+        *whichHeap = HEAP_UNKNOWN;
+    } else {
+        *whichHeap = HEAP_UNKNOWN_MAP;
+    }
+}
+
+static void read_mapinfo(ProcFileReader* reader, stats_t* stats)
+{
+    const char* line;
+    size_t len;
     bool skip, done = false;
 
     unsigned pss = 0, swappable_pss = 0;
@@ -238,14 +517,14 @@ static void read_mapinfo(FILE *fp, stats_t* stats)
     uint64_t start;
     uint64_t end = 0;
     uint64_t prevEnd = 0;
-    char* name;
-    int name_pos;
+    const char* name;
 
     int whichHeap = HEAP_UNKNOWN;
     int subHeap = HEAP_UNKNOWN;
     int prevHeap = HEAP_UNKNOWN;
 
-    if(fgets(line, sizeof(line), fp) == 0) return;
+    line = reader->nextLine(&len);
+    if (line == NULL) return;
 
     while (!done) {
         prevHeap = whichHeap;
@@ -255,101 +534,13 @@ static void read_mapinfo(FILE *fp, stats_t* stats)
         skip = false;
         is_swappable = false;
 
-        len = strlen(line);
-        if (len < 1) return;
-        line[--len] = 0;
-
-        if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %*s %*x %*x:%*x %*d%n", &start, &end, &name_pos) != 2) {
+        if (!parse_mapping(line, &start, &end, &name)) {
             skip = true;
         } else {
-            while (isspace(line[name_pos])) {
-                name_pos += 1;
-            }
-            name = line + name_pos;
-            nameLen = strlen(name);
-
-            if ((strstr(name, "[heap]") == name)) {
-                whichHeap = HEAP_NATIVE;
-            } else if (strncmp(name, "[anon:libc_malloc]", 18) == 0) {
-                whichHeap = HEAP_NATIVE;
-            } else if (strncmp(name, "[stack", 6) == 0) {
-                whichHeap = HEAP_STACK;
-            } else if (nameLen > 3 && strcmp(name+nameLen-3, ".so") == 0) {
-                whichHeap = HEAP_SO;
-                is_swappable = true;
-            } else if (nameLen > 4 && strcmp(name+nameLen-4, ".jar") == 0) {
-                whichHeap = HEAP_JAR;
-                is_swappable = true;
-            } else if (nameLen > 4 && strcmp(name+nameLen-4, ".apk") == 0) {
-                whichHeap = HEAP_APK;
-                is_swappable = true;
-            } else if (nameLen > 4 && strcmp(name+nameLen-4, ".ttf") == 0) {
-                whichHeap = HEAP_TTF;
-                is_swappable = true;
-            } else if ((nameLen > 4 && strstr(name, ".dex") != NULL) ||
-                       (nameLen > 5 && strcmp(name+nameLen-5, ".odex") == 0)) {
-                whichHeap = HEAP_DEX;
-                is_swappable = true;
-            } else if (nameLen > 4 && strcmp(name+nameLen-4, ".oat") == 0) {
-                whichHeap = HEAP_OAT;
-                is_swappable = true;
-            } else if (nameLen > 4 && strcmp(name+nameLen-4, ".art") == 0) {
-                whichHeap = HEAP_ART;
-                is_swappable = true;
-            } else if (strncmp(name, "/dev/", 5) == 0) {
-                if (strncmp(name, "/dev/kgsl-3d0", 13) == 0) {
-                    whichHeap = HEAP_GL_DEV;
-                } else if (strncmp(name, "/dev/ashmem", 11) == 0) {
-                    if (strncmp(name, "/dev/ashmem/dalvik-", 19) == 0) {
-                        whichHeap = HEAP_DALVIK_OTHER;
-                        if (strstr(name, "/dev/ashmem/dalvik-LinearAlloc") == name) {
-                            subHeap = HEAP_DALVIK_LINEARALLOC;
-                        } else if ((strstr(name, "/dev/ashmem/dalvik-alloc space") == name) ||
-                                   (strstr(name, "/dev/ashmem/dalvik-main space") == name)) {
-                            // This is the regular Dalvik heap.
-                            whichHeap = HEAP_DALVIK;
-                            subHeap = HEAP_DALVIK_NORMAL;
-                        } else if (strstr(name, "/dev/ashmem/dalvik-large object space") == name ||
-                                   strstr(name, "/dev/ashmem/dalvik-free list large object space")
-                                       == name) {
-                            whichHeap = HEAP_DALVIK;
-                            subHeap = HEAP_DALVIK_LARGE;
-                        } else if (strstr(name, "/dev/ashmem/dalvik-non moving space") == name) {
-                            whichHeap = HEAP_DALVIK;
-                            subHeap = HEAP_DALVIK_NON_MOVING;
-                        } else if (strstr(name, "/dev/ashmem/dalvik-zygote space") == name) {
-                            whichHeap = HEAP_DALVIK;
-                            subHeap = HEAP_DALVIK_ZYGOTE;
-                        } else if (strstr(name, "/dev/ashmem/dalvik-indirect ref") == name) {
-                            subHeap = HEAP_DALVIK_INDIRECT_REFERENCE_TABLE;
-                        } else if (strstr(name, "/dev/ashmem/dalvik-jit-code-cache") == name) {
-                            subHeap = HEAP_DALVIK_CODE_CACHE;
-                        } else {
-                            subHeap = HEAP_DALVIK_ACCOUNTING;  // Default to accounting.
-                        }
-                    } else if (strncmp(name, "/dev/ashmem/CursorWindow", 24) == 0) {
-                        whichHeap = HEAP_CURSOR;
-                    } else if (strncmp(name, "/dev/ashmem/libc malloc", 23) == 0) {
-                        whichHeap = HEAP_NATIVE;
-                    } else {
-                        whichHeap = HEAP_ASHMEM;
-                    }
-                } else {
-                    whichHeap = HEAP_UNKNOWN_DEV;
-                }
-            } else if (strncmp(name, "[anon:", 6) == 0) {
-                whichHeap = HEAP_UNKNOWN;
-            } else if (nameLen > 0) {
-                whichHeap = HEAP_UNKNOWN_MAP;
-            } else if (start == prevEnd && prevHeap == HEAP_SO) {
-                // bss section of a shared library.
-                whichHeap = HEAP_SO;
-            }
+            classify_mapping(name, line + len - name, start, prevEnd, prevHeap,
+                    &whichHeap, &subHeap, &is_swappable);
         }
 
-        //ALOGI("native=%d dalvik=%d sqlite=%d: %s\n", isNativeHeap, isDalvikHeap,
-        //    isSqliteHeap, line);
-
         shared_clean = 0;
         shared_dirty = 0;
         private_clean = 0;
@@ -357,30 +548,29 @@ static void read_mapinfo(FILE *fp, stats_t* stats)
         swapped_out = 0;
 
         while (true) {
-            if (fgets(line, 1024, fp) == 0) {
+            line = reader->nextLine(&len);
+            if (line == NULL) {
                 done = true;
                 break;
             }
 
-            if (line[0] == 'S' && sscanf(line, "Size: %d kB", &temp) == 1) {
-                /* size = temp; */
-            } else if (line[0] == 'R' && sscanf(line, "Rss: %d kB", &temp) == 1) {
-                /* resident = temp; */
-            } else if (line[0] == 'P' && sscanf(line, "Pss: %d kB", &temp) == 1) {
-                pss = temp;
-            } else if (line[0] == 'S' && sscanf(line, "Shared_Clean: %d kB", &temp) == 1) {
-                shared_clean = temp;
-            } else if (line[0] == 'S' && sscanf(line, "Shared_Dirty: %d kB", &temp) == 1) {
-                shared_dirty = temp;
-            } else if (line[0] == 'P' && sscanf(line, "Private_Clean: %d kB", &temp) == 1) {
-                private_clean = temp;
-            } else if (line[0] == 'P' && sscanf(line, "Private_Dirty: %d kB", &temp) == 1) {
-                private_dirty = temp;
-            } else if (line[0] == 'R' && sscanf(line, "Referenced: %d kB", &temp) == 1) {
-                /* referenced = temp; */
-            } else if (line[0] == 'S' && sscanf(line, "Swap: %d kB", &temp) == 1) {
-                swapped_out = temp;
-            } else if (sscanf(line, "%" SCNx64 "-%" SCNx64 " %*s %*x %*x:%*x %*d", &start, &end) == 2) {
+            if (line[0] == 'P') {
+                if (PARSE_FIELD(line, len, "Pss:", &temp)) {
+                    pss = temp;
+                } else if (PARSE_FIELD(line, len, "Private_Clean:", &temp)) {
+                    private_clean = temp;
+                } else if (PARSE_FIELD(line, len, "Private_Dirty:", &temp)) {
+                    private_dirty = temp;
+                }
+            } else if (line[0] == 'S') {
+                if (PARSE_FIELD(line, len, "Shared_Clean:", &temp)) {
+                    shared_clean = temp;
+                } else if (PARSE_FIELD(line, len, "Shared_Dirty:", &temp)) {
+                    shared_dirty = temp;
+                } else if (PARSE_FIELD(line, len, "Swap:", &temp)) {
+                    swapped_out = temp;
+                }
+            } else if (parse_mapping(line, &start, &end, &name)) {
                 // looks like a new mapping
                 // example: "10000000-10001000 ---p 10000000 00:00 0"
                 break;
@@ -421,14 +611,12 @@ static void read_mapinfo(FILE *fp, stats_t* stats)
 static void load_maps(int pid, stats_t* stats)
 {
     char tmp[128];
-    FILE *fp;
 
     sprintf(tmp, "/proc/%d/smaps", pid);
-    fp = fopen(tmp, "r");
-    if (fp == 0) return;
+    ProcFileReader reader(tmp);
+    if (!reader.isOpen()) return;
 
-    read_mapinfo(fp, stats);
-    fclose(fp);
+    read_mapinfo(&reader, stats);
 }
 
 static void android_os_Debug_getDirtyPagesPid(JNIEnv *env, jobject clazz,
@@ -496,50 +684,53 @@ static void android_os_Debug_getDirtyPages(JNIEnv *env, jobject clazz, jobject o
     android_os_Debug_getDirtyPagesPid(env, clazz, getpid(), object);
 }
 
+/*
+ * Adds up the Pss and Private_* fields of a smaps or smaps_rollup file.
+ * Returns false if it can't be opened.
+ */
+static bool sum_pss(const char* path, jlong* pss, jlong* uss)
+{
+    ProcFileReader reader(path);
+    if (!reader.isOpen()) {
+        return false;
+    }
+
+    const char* line;
+    size_t len;
+    unsigned temp;
+    while ((line = reader.nextLine(&len)) != NULL) {
+        if (line[0] == 'P') {
+            if (PARSE_FIELD(line, len, "Pss:", &temp)) {
+                *pss += temp;
+            } else if (PARSE_FIELD(line, len, "Private_Clean:", &temp)
+                    || PARSE_FIELD(line, len, "Private_Dirty:", &temp)) {
+                *uss += temp;
+            }
+        }
+    }
+    return true;
+}
+
 static jlong android_os_Debug_getPssPid(JNIEnv *env, jobject clazz, jint pid, jlongArray outUss,
         jlongArray outMemtrack)
 {
-    char line[1024];
     jlong pss = 0;
     jlong uss = 0;
     jlong memtrack = 0;
 
     char tmp[128];
-    FILE *fp;
 
     struct graphics_memory_pss graphics_mem;
     if (read_memtrack_memory(pid, &graphics_mem) == 0) {
         pss = uss = memtrack = graphics_mem.graphics + graphics_mem.gl + graphics_mem.other;
     }
 
-    sprintf(tmp, "/proc/%d/smaps", pid);
-    fp = fopen(tmp, "r");
-
-    if (fp != 0) {
-        while (true) {
-            if (fgets(line, 1024, fp) == NULL) {
-                break;
-            }
-
-            if (line[0] == 'P') {
-                if (strncmp(line, "Pss:", 4) == 0) {
-                    char* c = line + 4;
-                    while (*c != 0 && (*c < '0' || *c > '9')) {
-                        c++;
-                    }
-                    pss += atoi(c);
-                } else if (strncmp(line, "Private_Clean:", 14) == 0
-                        || strncmp(line, "Private_Dirty:", 14) == 0) {
-                    char* c = line + 14;
-                    while (*c != 0 && (*c < '0' || *c > '9')) {
-                        c++;
-                    }
-                    uss += atoi(c);
-                }
-            }
-        }
-
-        fclose(fp);
+    // Only the totals are needed, which smaps_rollup has already summed up
+    // where the kernel supports it.
+    sprintf(tmp, "/proc/%d/smaps_rollup", pid);
+    if (!sum_pss(tmp, &pss, &uss)) {
+        sprintf(tmp, "/proc/%d/smaps", pid);
+        sum_pss(tmp, &pss, &uss);
     }
 
     if (outUss != NULL) {
@@ -19,9 +19,19 @@
 #include "JNIHelp.h"
 #include <android_runtime/AndroidRuntime.h>
 
+#include <atomic>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <utils/KeyedVector.h>
 #include <utils/Looper.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <ScopedUtfChars.h>
 #include "android_os_MessageQueue.h"
+#include "android_util_Log2Histogram.h"
 
 #include "core_jni_helpers.h"
 
@@ -37,6 +47,34 @@ static const int CALLBACK_EVENT_INPUT = 1 << 0;
 static const int CALLBACK_EVENT_OUTPUT = 1 << 1;
 static const int CALLBACK_EVENT_ERROR = 1 << 2;
 
+static const size_t kLooperStatsBuckets = 20;
+
+// A log2 histogram of durations, in microseconds.
+struct LooperLatencyStats {
+    uint64_t count;
+    uint64_t totalMicros;
+    uint64_t maxMicros;
+    // Bucket i counts values in [2^(i-1), 2^i), the last one everything above
+    uint32_t buckets[kLooperStatsBuckets];
+
+    void record(nsecs_t duration) {
+        const uint64_t micros = duration > 0 ? uint64_t(duration) / 1000 : 0;
+        count++;
+        totalMicros += micros;
+        if (micros > maxMicros) {
+            maxMicros = micros;
+        }
+        buckets[log2HistogramBucket(micros, kLooperStatsBuckets)]++;
+    }
+
+    void dump(int fd, const char* prefix, const char* label) const {
+        dprintf(fd, "%s%s: count=%" PRIu64 " total=%" PRIu64 "us max=%" PRIu64 "us\n",
+                prefix, label, count, totalMicros, maxMicros);
+        dprintf(fd, "%s  latency us:", prefix);
+        dumpLog2Histogram(fd, buckets, kLooperStatsBuckets);
+    }
+};
+
 
 class NativeMessageQueue : public MessageQueue, public LooperCallback {
 public:
@@ -51,10 +89,24 @@ public:
 
     virtual int handleEvent(int fd, int events, void* data);
 
+    void setStatsEnabled(bool enabled);
+    void dumpStats(int fd, const char* prefix);
+
 private:
     JNIEnv* mPollEnv;
     jobject mPollObj;
     jthrowable mExceptionObj;
+
+    // Optional statistics, off by default. They are recorded on the looper
+    // thread and dumped from any thread, usually a binder thread, under
+    // mStatsLock. mFirstWakeTime is the time of the first wake() since the
+    // looper last returned from pollOnce(), or 0.
+    std::atomic<bool> mStatsEnabled;
+    std::atomic<nsecs_t> mFirstWakeTime;
+    Mutex mStatsLock;
+    uint64_t mPollCount;
+    LooperLatencyStats mWakeLatency;
+    KeyedVector<int, LooperLatencyStats> mFdCallbackStats;
 };
 
 
@@ -76,7 +128,9 @@ bool MessageQueue::raiseAndClearException(JNIEnv* env, const char* msg) {
 }
 
 NativeMessageQueue::NativeMessageQueue() :
-        mPollEnv(NULL), mPollObj(NULL), mExceptionObj(NULL) {
+        mPollEnv(NULL), mPollObj(NULL), mExceptionObj(NULL),
+        mStatsEnabled(false), mFirstWakeTime(0), mPollCount(0) {
+    memset(&mWakeLatency, 0, sizeof(mWakeLatency));
     mLooper = Looper::getForThread();
     if (mLooper == NULL) {
         mLooper = new Looper(false);
@@ -111,6 +165,17 @@ void NativeMessageQueue::pollOnce(JNIEnv* env, jobject pollObj, int timeoutMilli
     mPollObj = NULL;
     mPollEnv = NULL;
 
+    if (mStatsEnabled.load(std::memory_order_relaxed)) {
+        // The delay from the first wake() to the looper getting back to Java
+        // covers both a busy thread and a slow callback.
+        const nsecs_t wakeTime = mFirstWakeTime.exchange(0, std::memory_order_relaxed);
+        AutoMutex _l(mStatsLock);
+        mPollCount++;
+        if (wakeTime) {
+            mWakeLatency.record(systemTime(SYSTEM_TIME_MONOTONIC) - wakeTime);
+        }
+    }
+
     if (mExceptionObj) {
         env->Throw(mExceptionObj);
         env->DeleteLocalRef(mExceptionObj);
@@ -119,6 +184,11 @@ void NativeMessageQueue::pollOnce(JNIEnv* env, jobject pollObj, int timeoutMilli
 }
 
 void NativeMessageQueue::wake() {
+    if (mStatsEnabled.load(std::memory_order_relaxed)) {
+        nsecs_t expected = 0;
+        mFirstWakeTime.compare_exchange_strong(expected, systemTime(SYSTEM_TIME_MONOTONIC),
+                std::memory_order_relaxed);
+    }
     mLooper->wake();
 }
 
@@ -150,8 +220,21 @@ int NativeMessageQueue::handleEvent(int fd, int looperEvents, void* data) {
         events |= CALLBACK_EVENT_ERROR;
     }
     int oldWatchedEvents = reinterpret_cast<intptr_t>(data);
+    const bool statsEnabled = mStatsEnabled.load(std::memory_order_relaxed);
+    const nsecs_t startTime = statsEnabled ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
     int newWatchedEvents = mPollEnv->CallIntMethod(mPollObj,
             gMessageQueueClassInfo.dispatchEvents, fd, events);
+    if (statsEnabled) {
+        const nsecs_t duration = systemTime(SYSTEM_TIME_MONOTONIC) - startTime;
+        AutoMutex _l(mStatsLock);
+        ssize_t index = mFdCallbackStats.indexOfKey(fd);
+        if (index < 0) {
+            LooperLatencyStats empty;
+            memset(&empty, 0, sizeof(empty));
+            index = mFdCallbackStats.add(fd, empty);
+        }
+        mFdCallbackStats.editValueAt(index).record(duration);
+    }
     if (!newWatchedEvents) {
         return 0; // unregister the fd
     }
@@ -161,6 +244,32 @@ int NativeMessageQueue::handleEvent(int fd, int looperEvents, void* data) {
     return 1;
 }
 
+void NativeMessageQueue::setStatsEnabled(bool enabled) {
+    AutoMutex _l(mStatsLock);
+    if (enabled && !mStatsEnabled.load(std::memory_order_relaxed)) {
+        // Start over, so that the dump covers a known window.
+        mFirstWakeTime.store(0, std::memory_order_relaxed);
+        mPollCount = 0;
+        memset(&mWakeLatency, 0, sizeof(mWakeLatency));
+        mFdCallbackStats.clear();
+    }
+    mStatsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void NativeMessageQueue::dumpStats(int fd, const char* prefix) {
+    AutoMutex _l(mStatsLock);
+    dprintf(fd, "%sLooper stats%s: polls=%" PRIu64 "\n", prefix,
+            mStatsEnabled.load(std::memory_order_relaxed) ? "" : " (stopped)", mPollCount);
+    String8 childPrefix(prefix);
+    childPrefix.append("  ");
+    mWakeLatency.dump(fd, childPrefix.string(), "wake to dispatch");
+    for (size_t i = 0; i < mFdCallbackStats.size(); i++) {
+        String8 label;
+        label.appendFormat("fd %d callback", mFdCallbackStats.keyAt(i));
+        mFdCallbackStats.valueAt(i).dump(fd, childPrefix.string(), label.string());
+    }
+}
+
 
 // ----------------------------------------------------------------------------
 
@@ -207,6 +316,27 @@ static void android_os_MessageQueue_nativeSetFileDescriptorEvents(JNIEnv* env, j
     nativeMessageQueue->setFileDescriptorEvents(fd, events);
 }
 
+static void android_os_MessageQueue_nativeSetStatsEnabled(JNIEnv* env, jclass clazz,
+        jlong ptr, jboolean enabled) {
+    NativeMessageQueue* nativeMessageQueue = reinterpret_cast<NativeMessageQueue*>(ptr);
+    nativeMessageQueue->setStatsEnabled(enabled);
+}
+
+static void android_os_MessageQueue_nativeDumpStats(JNIEnv* env, jclass clazz,
+        jlong ptr, jobject fdObj, jstring prefixObj) {
+    int fd = jniGetFDFromFileDescriptor(env, fdObj);
+    if (fd < 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "bad FileDescriptor");
+        return;
+    }
+    ScopedUtfChars prefix(env, prefixObj);
+    if (prefix.c_str() == NULL) {
+        return;
+    }
+    NativeMessageQueue* nativeMessageQueue = reinterpret_cast<NativeMessageQueue*>(ptr);
+    nativeMessageQueue->dumpStats(fd, prefix.c_str());
+}
+
 // ----------------------------------------------------------------------------
 
 static JNINativeMethod gMessageQueueMethods[] = {
@@ -220,9 +350,18 @@ static JNINativeMethod gMessageQueueMethods[] = {
             (void*)android_os_MessageQueue_nativeSetFileDescriptorEvents },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gMessageQueueOptionalMethods[] = {
+    { "nativeSetStatsEnabled", "(JZ)V", (void*)android_os_MessageQueue_nativeSetStatsEnabled },
+    { "nativeDumpStats", "(JLjava/io/FileDescriptor;Ljava/lang/String;)V",
+            (void*)android_os_MessageQueue_nativeDumpStats },
+};
+
 int register_android_os_MessageQueue(JNIEnv* env) {
     int res = RegisterMethodsOrDie(env, "android/os/MessageQueue", gMessageQueueMethods,
                                    NELEM(gMessageQueueMethods));
+    RegisterOptionalMethods(env, "android/os/MessageQueue", gMessageQueueOptionalMethods,
+                            NELEM(gMessageQueueOptionalMethods));
 
     jclass clazz = FindClassOrDie(env, "android/os/MessageQueue");
     gMessageQueueClassInfo.mPtr = GetFieldIDOrDie(env, clazz, "mPtr", "J");
@@ -273,6 +273,67 @@ static void android_os_Parcel_writeDouble(JNIEnv* env, jclass clazz, jlong nativ
     }
 }
 
+// The primitive array writes lay the length and the elements out exactly like
+// writing each of them in turn would, with a single copy into the parcel.
+// A null array is written as a length of -1.
+static void writePrimitiveArray(JNIEnv* env, jclass clazz, jlong nativePtr, jarray data,
+                                jint offset, jint length, size_t elementSize)
+{
+    Parcel* parcel = reinterpret_cast<Parcel*>(nativePtr);
+    if (parcel == NULL) {
+        return;
+    }
+
+    if (data == NULL) {
+        const status_t err = parcel->writeInt32(-1);
+        if (err != NO_ERROR) {
+            signalExceptionForError(env, clazz, err);
+        }
+        return;
+    }
+
+    if (offset < 0 || length < 0 || offset > env->GetArrayLength(data) - length) {
+        jniThrowException(env, "java/lang/ArrayIndexOutOfBoundsException", NULL);
+        return;
+    }
+
+    const status_t err = parcel->writeInt32(length);
+    if (err != NO_ERROR) {
+        signalExceptionForError(env, clazz, err);
+        return;
+    }
+
+    void* dest = parcel->writeInplace(length * elementSize);
+    if (dest == NULL) {
+        signalExceptionForError(env, clazz, NO_MEMORY);
+        return;
+    }
+
+    char* ar = (char*)env->GetPrimitiveArrayCritical(data, 0);
+    if (ar) {
+        memcpy(dest, ar + offset * elementSize, length * elementSize);
+        env->ReleasePrimitiveArrayCritical(data, ar, JNI_ABORT);
+    }
+}
+
+static void android_os_Parcel_writeIntArray(JNIEnv* env, jclass clazz, jlong nativePtr,
+                                            jintArray data, jint offset, jint length)
+{
+    writePrimitiveArray(env, clazz, nativePtr, data, offset, length, sizeof(jint));
+}
+
+static void android_os_Parcel_writeLongArray(JNIEnv* env, jclass clazz, jlong nativePtr,
+                                             jlongArray data, jint offset, jint length)
+{
+    writePrimitiveArray(env, clazz, nativePtr, data, offset, length, sizeof(jlong));
+}
+
+static void android_os_Parcel_writeFloatArray(JNIEnv* env, jclass clazz, jlong nativePtr,
+                                              jfloatArray data, jint offset, jint length)
+{
+    writePrimitiveArray(env, clazz, nativePtr, data, offset, length, sizeof(jfloat));
+}
+
 static void android_os_Parcel_writeString(JNIEnv* env, jclass clazz, jlong nativePtr, jstring val)
 {
     Parcel* parcel = reinterpret_cast<Parcel*>(nativePtr);
@@ -346,6 +407,53 @@ static jbyteArray android_os_Parcel_createByteArray(JNIEnv* env, jclass clazz, j
     return ret;
 }
 
+// Reads an array written by writePrimitiveArray(). Returns NULL for a null
+// array, or if the length doesn't fit in the rest of the parcel.
+template <typename ArrayType>
+static ArrayType createPrimitiveArray(JNIEnv* env, jlong nativePtr, size_t elementSize,
+                                      ArrayType (JNIEnv::*newArray)(jsize))
+{
+    Parcel* parcel = reinterpret_cast<Parcel*>(nativePtr);
+    if (parcel == NULL) {
+        return NULL;
+    }
+
+    int32_t len = parcel->readInt32();
+
+    // sanity check the stored length against the true data size
+    if (len < 0 || (size_t)len > parcel->dataAvail() / elementSize) {
+        return NULL;
+    }
+
+    ArrayType ret = (env->*newArray)(len);
+    if (ret != NULL) {
+        void* a2 = env->GetPrimitiveArrayCritical(ret, 0);
+        if (a2) {
+            const void* data = parcel->readInplace(len * elementSize);
+            if (data) {
+                memcpy(a2, data, len * elementSize);
+            }
+            env->ReleasePrimitiveArrayCritical(ret, a2, 0);
+        }
+    }
+    return ret;
+}
+
+static jintArray android_os_Parcel_createIntArray(JNIEnv* env, jclass clazz, jlong nativePtr)
+{
+    return createPrimitiveArray(env, nativePtr, sizeof(jint), &JNIEnv::NewIntArray);
+}
+
+static jlongArray android_os_Parcel_createLongArray(JNIEnv* env, jclass clazz, jlong nativePtr)
+{
+    return createPrimitiveArray(env, nativePtr, sizeof(jlong), &JNIEnv::NewLongArray);
+}
+
+static jfloatArray android_os_Parcel_createFloatArray(JNIEnv* env, jclass clazz, jlong nativePtr)
+{
+    return createPrimitiveArray(env, nativePtr, sizeof(jfloat), &JNIEnv::NewFloatArray);
+}
+
 static jbyteArray android_os_Parcel_readBlob(JNIEnv* env, jclass clazz, jlong nativePtr)
 {
     jbyteArray ret = NULL;
@@ -779,6 +887,16 @@ static const JNINativeMethod gParcelMethods[] = {
     {"nativeGetBlobAshmemSize",       "(J)J", (void*)android_os_Parcel_getBlobAshmemSize},
 };
 
+// Natives whose Java declarations may not be present.
+static const JNINativeMethod gParcelOptionalMethods[] = {
+    {"nativeWriteIntArray",       "(J[III)V", (void*)android_os_Parcel_writeIntArray},
+    {"nativeWriteLongArray",      "(J[JII)V", (void*)android_os_Parcel_writeLongArray},
+    {"nativeWriteFloatArray",     "(J[FII)V", (void*)android_os_Parcel_writeFloatArray},
+    {"nativeCreateIntArray",      "(J)[I", (void*)android_os_Parcel_createIntArray},
+    {"nativeCreateLongArray",     "(J)[J", (void*)android_os_Parcel_createLongArray},
+    {"nativeCreateFloatArray",    "(J)[F", (void*)android_os_Parcel_createFloatArray},
+};
+
 const char* const kParcelPathName = "android/os/Parcel";
 
 int register_android_os_Parcel(JNIEnv* env)
@@ -790,6 +908,8 @@ int register_android_os_Parcel(JNIEnv* env)
     gParcelOffsets.obtain = GetStaticMethodIDOrDie(env, clazz, "obtain", "()Landroid/os/Parcel;");
     gParcelOffsets.recycle = GetMethodIDOrDie(env, clazz, "recycle", "()V");
 
+    RegisterOptionalMethods(env, kParcelPathName, gParcelOptionalMethods,
+                            NELEM(gParcelOptionalMethods));
     return RegisterMethodsOrDie(env, kParcelPathName, gParcelMethods, NELEM(gParcelMethods));
 }
 
@@ -17,13 +17,23 @@
 #define LOG_TAG "Trace"
 // #define LOG_NDEBUG 0
 
+#include <atomic>
 #include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <android_runtime/AndroidRuntime.h>
+#include <android_runtime/android_os_Trace.h>
 
 #include <JNIHelp.h>
 #include <ScopedUtfChars.h>
 #include <ScopedStringChars.h>
 
 #include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <utils/threads.h>
 
 #include <cutils/trace.h>
 #include <cutils/log.h>
@@ -42,6 +52,152 @@ static void sanitizeString(String8& utf8Chars) {
     utf8Chars.unlockBuffer();
 }
 
+// ---------------------------------------------------------------------------
+// Buffered tracing
+
+// Number of events per thread ring, a power of two
+static const uint32_t kTraceRingSize = 1024;
+
+struct TraceRing {
+    TraceRing() : head(0), tail(0), dropped(0) { }
+
+    // head is only written by the owning thread, tail only by drains
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> dropped;
+    BufferedTraceEvent events[kTraceRingSize];
+};
+
+static std::atomic<uint64_t> gBufferedTraceTags(0);
+
+// Guards the ring lists, rings of exited threads are reused by new ones and
+// stay in gTraceRings so their pending events still get drained.
+static Mutex gTraceRingsLock;
+static Vector<TraceRing*> gTraceRings;
+static Vector<TraceRing*> gTraceFreeRings;
+static pthread_key_t gTraceRingKey;
+static pthread_once_t gTraceRingOnce = PTHREAD_ONCE_INIT;
+
+static void releaseTraceRing(void* ring)
+{
+    AutoMutex _l(gTraceRingsLock);
+    gTraceFreeRings.push(static_cast<TraceRing*>(ring));
+}
+
+static void initTraceRings()
+{
+    pthread_key_create(&gTraceRingKey, releaseTraceRing);
+}
+
+static TraceRing* traceRing()
+{
+    pthread_once(&gTraceRingOnce, initTraceRings);
+    TraceRing* ring = static_cast<TraceRing*>(pthread_getspecific(gTraceRingKey));
+    if (ring == NULL) {
+        AutoMutex _l(gTraceRingsLock);
+        if (gTraceFreeRings.isEmpty()) {
+            ring = new TraceRing();
+            gTraceRings.push(ring);
+        } else {
+            ring = gTraceFreeRings.top();
+            gTraceFreeRings.pop();
+        }
+        pthread_setspecific(gTraceRingKey, ring);
+    }
+    return ring;
+}
+
+static void recordTraceEvent(char type, const char* name, int64_t value)
+{
+    TraceRing* ring = traceRing();
+    const uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= kTraceRingSize) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    BufferedTraceEvent& event = ring->events[head & (kTraceRingSize - 1)];
+    event.timestamp = systemTime(SYSTEM_TIME_MONOTONIC);
+    event.value = value;
+    event.tid = gettid();
+    event.type = type;
+    if (name != NULL) {
+        strncpy(event.name, name, sizeof(event.name) - 1);
+        event.name[sizeof(event.name) - 1] = '\0';
+    } else {
+        event.name[0] = '\0';
+    }
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+static inline bool isBuffered(uint64_t tag)
+{
+    return (gBufferedTraceTags.load(std::memory_order_relaxed) & tag) != 0;
+}
+
+void setBufferedTraceTags(uint64_t tags)
+{
+    gBufferedTraceTags.store(tags, std::memory_order_relaxed);
+}
+
+uint64_t getBufferedTraceTags()
+{
+    return gBufferedTraceTags.load(std::memory_order_relaxed);
+}
+
+void traceBegin(uint64_t tag, const char* name)
+{
+    if (isBuffered(tag)) {
+        recordTraceEvent('B', name, 0);
+    } else {
+        atrace_begin(tag, name);
+    }
+}
+
+void traceEnd(uint64_t tag)
+{
+    if (isBuffered(tag)) {
+        recordTraceEvent('E', NULL, 0);
+    } else {
+        atrace_end(tag);
+    }
+}
+
+void traceCounter(uint64_t tag, const char* name, int64_t value)
+{
+    if (isBuffered(tag)) {
+        recordTraceEvent('C', name, value);
+    } else {
+        atrace_int64(tag, name, value);
+    }
+}
+
+size_t drainBufferedTraceEvents(BufferedTraceEvent* outEvents, size_t maxEvents,
+        uint64_t* outDropped)
+{
+    AutoMutex _l(gTraceRingsLock);
+    size_t count = 0;
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < gTraceRings.size(); i++) {
+        TraceRing* ring = gTraceRings[i];
+        dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+
+        uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+        const uint32_t head = ring->head.load(std::memory_order_acquire);
+        while (tail != head && count < maxEvents) {
+            outEvents[count++] = ring->events[tail & (kTraceRingSize - 1)];
+            tail++;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    if (outDropped != NULL) {
+        *outDropped += dropped;
+    }
+    return count;
+}
+
+// ---------------------------------------------------------------------------
+
 static jlong android_os_Trace_nativeGetEnabledTags(JNIEnv* env, jclass clazz) {
     return atrace_get_enabled_tags();
 }
@@ -51,7 +207,11 @@ static void android_os_Trace_nativeTraceCounter(JNIEnv* env, jclass clazz,
     ScopedUtfChars name(env, nameStr);
 
     ALOGV("%s: %" PRId64 " %s %d", __FUNCTION__, tag, name.c_str(), value);
-    atrace_int(tag, name.c_str(), value);
+    if (isBuffered(tag)) {
+        recordTraceEvent('C', name.c_str(), value);
+    } else {
+        atrace_int(tag, name.c_str(), value);
+    }
 }
 
 static void android_os_Trace_nativeTraceBegin(JNIEnv* env, jclass clazz,
@@ -61,14 +221,14 @@ static void android_os_Trace_nativeTraceBegin(JNIEnv* env, jclass clazz,
     sanitizeString(utf8Chars);
 
     ALOGV("%s: %" PRId64 " %s", __FUNCTION__, tag, utf8Chars.string());
-    atrace_begin(tag, utf8Chars.string());
+    traceBegin(tag, utf8Chars.string());
 }
 
 static void android_os_Trace_nativeTraceEnd(JNIEnv* env, jclass clazz,
         jlong tag) {
 
     ALOGV("%s: %" PRId64, __FUNCTION__, tag);
-    atrace_end(tag);
+    traceEnd(tag);
 }
 
 static void android_os_Trace_nativeAsyncTraceBegin(JNIEnv* env, jclass clazz,
@@ -105,6 +265,33 @@ static void android_os_Trace_nativeSetTracingEnabled(JNIEnv* env,
     atrace_set_tracing_enabled(enabled);
 }
 
+static void android_os_Trace_nativeSetBufferedTags(JNIEnv* env, jclass clazz, jlong tags) {
+    ALOGV("%s: %" PRId64, __FUNCTION__, tags);
+    setBufferedTraceTags(tags);
+}
+
+// Drains buffered events into a direct buffer as packed BufferedTraceEvent
+// structs, returns the number of events written.
+static jint android_os_Trace_nativeDrainBufferedEvents(JNIEnv* env, jclass clazz,
+        jobject buffer, jlongArray droppedOut) {
+    void* data = env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (data == NULL || capacity < 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                "buffer must be a direct ByteBuffer");
+        return 0;
+    }
+
+    uint64_t dropped = 0;
+    size_t count = drainBufferedTraceEvents(static_cast<BufferedTraceEvent*>(data),
+            capacity / sizeof(BufferedTraceEvent), &dropped);
+    if (droppedOut != NULL && env->GetArrayLength(droppedOut) > 0) {
+        jlong value = dropped;
+        env->SetLongArrayRegion(droppedOut, 0, 1, &value);
+    }
+    return count;
+}
+
 static JNINativeMethod gTraceMethods[] = {
     /* name, signature, funcPtr */
     { "nativeGetEnabledTags",
@@ -133,10 +320,22 @@ static JNINativeMethod gTraceMethods[] = {
             (void*)android_os_Trace_nativeSetTracingEnabled },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gTraceOptionalMethods[] = {
+    { "nativeSetBufferedTags",
+            "(J)V",
+            (void*)android_os_Trace_nativeSetBufferedTags },
+    { "nativeDrainBufferedEvents",
+            "(Ljava/nio/ByteBuffer;[J)I",
+            (void*)android_os_Trace_nativeDrainBufferedEvents },
+};
+
 int register_android_os_Trace(JNIEnv* env) {
     int res = jniRegisterNativeMethods(env, "android/os/Trace",
             gTraceMethods, NELEM(gTraceMethods));
     LOG_ALWAYS_FATAL_IF(res < 0, "Unable to register native methods.");
+    AndroidRuntime::registerOptionalNativeMethods(env, "android/os/Trace",
+            gTraceOptionalMethods, NELEM(gTraceOptionalMethods));
 
     return 0;
 }
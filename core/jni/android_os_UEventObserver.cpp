@@ -29,10 +29,112 @@
 #include <utils/String8.h>
 #include <ScopedUtfChars.h>
 
+#include <linux/filter.h>
+#include <poll.h>
+#include <sys/socket.h>
+
 namespace android {
 
 static Mutex gMatchesMutex;
 static Vector<String8> gMatches;
+static jclass gStringClass;
+
+// Kernel uevents start with "<action>@<devpath>", the actions it sends.
+static const char* const kUeventActions[] = {
+    "add", "remove", "change", "move", "online", "offline", "bind", "unbind",
+};
+static const char kDevPathPrefix[] = "DEVPATH=";
+
+static void appendFilterBlock(Vector<sock_filter>& program, const String8& prefix) {
+    const size_t length = prefix.length();
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(prefix.string());
+
+    // Each failed test skips the rest of this block, which ends with the accept.
+    size_t blockSize = 3;
+    for (size_t offset = 0; offset < length; ) {
+        const size_t width = length - offset >= 4 ? 4 : length - offset >= 2 ? 2 : 1;
+        blockSize += 2;
+        offset += width;
+    }
+    const size_t start = program.size();
+    struct sock_filter load = BPF_STMT(BPF_LD | BPF_W | BPF_LEN, 0);
+    program.add(load);
+    struct sock_filter checkLength = BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, length, 0,
+            blockSize - 2);
+    program.add(checkLength);
+    for (size_t offset = 0; offset < length; ) {
+        const size_t width = length - offset >= 4 ? 4 : length - offset >= 2 ? 2 : 1;
+        // Absolute loads are big endian.
+        uint32_t value = 0;
+        for (size_t i = 0; i < width; i++) {
+            value = value << 8 | bytes[offset + i];
+        }
+        const uint16_t size = width == 4 ? BPF_W : width == 2 ? BPF_H : BPF_B;
+        struct sock_filter loadBytes = BPF_STMT(BPF_LD | size | BPF_ABS, offset);
+        program.add(loadBytes);
+        const size_t next = program.size() + 1;
+        struct sock_filter compare = BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, value, 0,
+                start + blockSize - next);
+        program.add(compare);
+        offset += width;
+    }
+    struct sock_filter accept = BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+    program.add(accept);
+}
+
+/*
+ * Attaches a socket filter that only lets through the events a match can apply to,
+ * so hotplug storms on unrelated devices don't wake us up.  Only DEVPATH= matches can
+ * be compiled, they turn into a prefix test on the "<action>@<devpath>" header.  Other
+ * matches can appear anywhere in the event, which classic BPF can't search for, so
+ * while there are any the filter lets all events through and isMatch() does the
+ * filtering.  The filter stays attached either way, and is swapped in place.
+ * Must be called with gMatchesMutex held.
+ */
+static void updateSocketFilterLocked() {
+    const int fd = uevent_get_fd();
+    if (fd < 0) {
+        return;
+    }
+
+    Vector<sock_filter> program;
+    bool compiled = true;
+    const size_t prefixLength = sizeof(kDevPathPrefix) - 1;
+    for (size_t i = 0; compiled && i < gMatches.size(); i++) {
+        const String8& match = gMatches.itemAt(i);
+        if (strncmp(match.string(), kDevPathPrefix, prefixLength) != 0
+                || match.length() - prefixLength > 200) {
+            compiled = false;
+            break;
+        }
+        for (size_t a = 0; a < NELEM(kUeventActions); a++) {
+            String8 prefix(kUeventActions[a]);
+            prefix.append("@");
+            prefix.append(match.string() + prefixLength);
+            appendFilterBlock(program, prefix);
+        }
+    }
+    struct sock_filter reject = BPF_STMT(BPF_RET | BPF_K, 0);
+    program.add(reject);
+
+    if (!compiled || program.size() > BPF_MAXINSNS) {
+        // Replace the program rather than detach it, so the filter is only ever
+        // changed by the one attach below.
+        program.clear();
+        struct sock_filter accept = BPF_STMT(BPF_RET | BPF_K, 0xffffffff);
+        program.add(accept);
+    }
+
+    struct sock_fprog fprog;
+    fprog.len = program.size();
+    fprog.filter = program.editArray();
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0) {
+        // The previous program may reject events the new matches need.
+        ALOGW("Unable to attach uevent filter: %s", strerror(errno));
+        int unused = 0;
+        setsockopt(fd, SOL_SOCKET, SO_DETACH_FILTER, &unused, sizeof(unused));
+    }
+}
 
 static void nativeSetup(JNIEnv *env, jclass clazz) {
     if (!uevent_init()) {
@@ -61,6 +163,15 @@ static bool isMatch(const char* buffer, size_t length) {
     return false;
 }
 
+static jstring toMessage(JNIEnv *env, const char* buffer, int length) {
+    // Assume the message is ASCII.
+    jchar message[length];
+    for (int i = 0; i < length; i++) {
+        message[i] = buffer[i];
+    }
+    return env->NewString(message, length);
+}
+
 static jstring nativeWaitForNextEvent(JNIEnv *env, jclass clazz) {
     char buffer[1024];
 
@@ -74,14 +185,51 @@ static jstring nativeWaitForNextEvent(JNIEnv *env, jclass clazz) {
         ALOGV("Received uevent message: %s", buffer);
 
         if (isMatch(buffer, length)) {
-            // Assume the message is ASCII.
-            jchar message[length];
-            for (int i = 0; i < length; i++) {
-                message[i] = buffer[i];
+            return toMessage(env, buffer, length);
+        }
+    }
+}
+
+/*
+ * Waits for the next matching event like nativeWaitForNextEvent(), then also returns
+ * up to maxEvents - 1 more that are already queued, so a burst costs one wakeup.
+ */
+static jobjectArray nativeWaitForNextEvents(JNIEnv *env, jclass clazz, jint maxEvents) {
+    char buffer[1024];
+    Vector<jstring> messages;
+    const int fd = uevent_get_fd();
+
+    while ((jint) messages.size() < maxEvents) {
+        if (!messages.isEmpty()) {
+            struct pollfd fds = { fd, POLLIN, 0 };
+            if (fd < 0 || poll(&fds, 1, 0) <= 0 || !(fds.revents & POLLIN)) {
+                break;
+            }
+        }
+
+        int length = uevent_next_event(buffer, sizeof(buffer) - 1);
+        if (length <= 0) {
+            break;
+        }
+        buffer[length] = '\0';
+
+        ALOGV("Received uevent message: %s", buffer);
+
+        if (isMatch(buffer, length)) {
+            jstring message = toMessage(env, buffer, length);
+            if (message == NULL) {
+                break;
             }
-            return env->NewString(message, length);
+            messages.add(message);
         }
     }
+
+    jobjectArray result = env->NewObjectArray(messages.size(), gStringClass, NULL);
+    for (size_t i = 0; result != NULL && i < messages.size(); i++) {
+        env->SetObjectArrayElement(result, i, messages[i]);
+        env->DeleteLocalRef(messages[i]);
+    }
+    return result;
 }
 
 static void nativeAddMatch(JNIEnv* env, jclass clazz, jstring matchStr) {
@@ -89,6 +237,7 @@ static void nativeAddMatch(JNIEnv* env, jclass clazz, jstring matchStr) {
 
     AutoMutex _l(gMatchesMutex);
     gMatches.add(String8(match.c_str()));
+    updateSocketFilterLocked();
 }
 
 static void nativeRemoveMatch(JNIEnv* env, jclass clazz, jstring matchStr) {
@@ -98,6 +247,7 @@ static void nativeRemoveMatch(JNIEnv* env, jclass clazz, jstring matchStr) {
     for (size_t i = 0; i < gMatches.size(); i++) {
         if (gMatches.itemAt(i) == match.c_str()) {
             gMatches.removeAt(i);
+            updateSocketFilterLocked();
             break; // only remove first occurrence
         }
     }
@@ -114,11 +264,20 @@ static JNINativeMethod gMethods[] = {
             (void *)nativeRemoveMatch },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "nativeWaitForNextEvents", "(I)[Ljava/lang/String;",
+            (void *)nativeWaitForNextEvents },
+};
+
 
 int register_android_os_UEventObserver(JNIEnv *env)
 {
     FindClassOrDie(env, "android/os/UEventObserver");
+    gStringClass = MakeGlobalRefOrDie(env, FindClassOrDie(env, "java/lang/String"));
 
+    RegisterOptionalMethods(env, "android/os/UEventObserver", gOptionalMethods,
+                            NELEM(gOptionalMethods));
     return RegisterMethodsOrDie(env, "android/os/UEventObserver", gMethods, NELEM(gMethods));
 }
 
@@ -20,7 +20,10 @@
 #include "unicode/locid.h"
 #include "unicode/brkiter.h"
 #include "utils/misc.h"
+#include "utils/JenkinsHash.h"
 #include "utils/Log.h"
+#include "utils/LruCache.h"
+#include "utils/Mutex.h"
 #include "ScopedStringChars.h"
 #include "ScopedPrimitiveArray.h"
 #include "JNIHelp.h"
@@ -48,21 +51,123 @@ struct JLineBreaksID {
 static jclass gLineBreaks_class;
 static JLineBreaksID gLineBreaks_fieldID;
 
+// Lists and editors rebuild the same layouts over and over, so the breaks of
+// short paragraphs are cached, keyed by everything they were computed from.
+static const size_t kMaxCachedParagraphLength = 512;
+static const uint32_t kLineBreakCacheSize = 64;
+
+struct LineBreakKey {
+    std::vector<uint8_t> data;
+    hash_t hash;
+
+    bool operator==(const LineBreakKey& other) const {
+        return hash == other.hash && data == other.data;
+    }
+};
+
+inline hash_t hash_type(const LineBreakKey& key) {
+    return key.hash;
+}
+
+struct LineBreakResult {
+    std::vector<jint> breaks;
+    std::vector<jfloat> widths;
+    std::vector<jint> flags;
+    // The fonts the key refers to by address, referenced by the cache entry so
+    // that the address can't be reused by another font while it's cached
+    std::vector<FontCollection*> fonts;
+};
+
+class LineBreakCache : public OnEntryRemoved<LineBreakKey, LineBreakResult> {
+public:
+    LineBreakCache() : cache(kLineBreakCacheSize) {
+        cache.setOnEntryRemovedListener(this);
+    }
+
+    void operator()(LineBreakKey&, LineBreakResult& result) override {
+        for (FontCollection* font : result.fonts) {
+            font->Unref();
+        }
+    }
+
+    Mutex lock;
+    LruCache<LineBreakKey, LineBreakResult> cache;
+};
+
+static LineBreakCache gLineBreakCache;
+
+// Marks the start of each run in a key
+enum LineBreakKeyRun : uint8_t {
+    kStyleRun,
+    kMeasuredRun,
+    kReplacementRun,
+};
+
+// A LineBreaker along with what its breaks depend on, recorded as the
+// paragraph is set up.
+struct StaticLayoutBuilder {
+    LineBreaker breaker;
+    // Set by nSetLocale and nSetIndents, which last for several paragraphs
+    std::vector<uint8_t> localeKey;
+    std::vector<uint8_t> indentsKey;
+    // The key of the current paragraph, unless it's too long to cache
+    std::vector<uint8_t> key;
+    // The fonts of its style runs
+    std::vector<FontCollection*> fonts;
+    bool cacheable = false;
+
+    void appendKey(const void* data, size_t size) {
+        if (cacheable) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+            key.insert(key.end(), bytes, bytes + size);
+        }
+    }
+
+    template<typename T>
+    void appendKey(const T& value) {
+        appendKey(&value, sizeof(value));
+    }
+};
+
+static void appendBytes(std::vector<uint8_t>* key, const void* data, size_t size) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    key->insert(key->end(), bytes, bytes + size);
+}
+
 // set text and set a number of parameters for creating a layout (width, tabstops, strategy,
 // hyphenFrequency)
 static void nSetupParagraph(JNIEnv* env, jclass, jlong nativePtr, jcharArray text, jint length,
         jfloat firstWidth, jint firstWidthLineLimit, jfloat restWidth,
         jintArray variableTabStops, jint defaultTabStop, jint strategy, jint hyphenFrequency) {
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
+    LineBreaker* b = &builder->breaker;
     b->resize(length);
     env->GetCharArrayRegion(text, 0, length, b->buffer());
     b->setText();
     b->setLineWidths(firstWidth, firstWidthLineLimit, restWidth);
+
+    builder->key.clear();
+    builder->fonts.clear();
+    builder->cacheable = static_cast<size_t>(length) <= kMaxCachedParagraphLength;
+    builder->appendKey(builder->localeKey.data(), builder->localeKey.size());
+    builder->appendKey(builder->indentsKey.data(), builder->indentsKey.size());
+    builder->appendKey(length);
+    builder->appendKey(b->buffer(), length * sizeof(uint16_t));
+    builder->appendKey(firstWidth);
+    builder->appendKey(firstWidthLineLimit);
+    builder->appendKey(restWidth);
+    builder->appendKey(defaultTabStop);
+    builder->appendKey(strategy);
+    builder->appendKey(hyphenFrequency);
+
     if (variableTabStops == nullptr) {
         b->setTabStops(nullptr, 0, defaultTabStop);
+        builder->appendKey(static_cast<size_t>(0));
     } else {
         ScopedIntArrayRO stops(env, variableTabStops);
         b->setTabStops(stops.get(), stops.size(), defaultTabStop);
+        builder->appendKey(stops.size());
+        builder->appendKey(stops.get(), stops.size() * sizeof(jint));
     }
     b->setStrategy(static_cast<BreakStrategy>(strategy));
     b->setHyphenationFrequency(static_cast<HyphenationFrequency>(hyphenFrequency));
@@ -92,29 +197,71 @@ static jint nComputeLineBreaks(JNIEnv* env, jclass, jlong nativePtr,
                                jobject recycle, jintArray recycleBreaks,
                                jfloatArray recycleWidths, jintArray recycleFlags,
                                jint recycleLength) {
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
+    LineBreaker* b = &builder->breaker;
+
+    LineBreakKey key;
+    if (builder->cacheable) {
+        // The widths stand for the style, measured and replacement runs.
+        builder->appendKey(b->charWidths(), b->size() * sizeof(float));
+        key.data.swap(builder->key);
+        key.hash = JenkinsHashWhiten(JenkinsHashMixBytes(0, key.data.data(), key.data.size()));
+
+        LineBreakResult cached;
+        {
+            AutoMutex _l(gLineBreakCache.lock);
+            cached = gLineBreakCache.cache.get(key);
+        }
+        if (!cached.breaks.empty()) {
+            size_t nBreaks = cached.breaks.size();
+            recycleCopy(env, recycle, recycleBreaks, recycleWidths, recycleFlags, recycleLength,
+                    nBreaks, cached.breaks.data(), cached.widths.data(), cached.flags.data());
+            b->finish();
+            return static_cast<jint>(nBreaks);
+        }
+    }
 
     size_t nBreaks = b->computeBreaks();
 
     recycleCopy(env, recycle, recycleBreaks, recycleWidths, recycleFlags, recycleLength,
             nBreaks, b->getBreaks(), b->getWidths(), b->getFlags());
 
+    if (builder->cacheable && nBreaks > 0) {
+        LineBreakResult result;
+        result.breaks.assign(b->getBreaks(), b->getBreaks() + nBreaks);
+        result.widths.assign(b->getWidths(), b->getWidths() + nBreaks);
+        result.flags.assign(b->getFlags(), b->getFlags() + nBreaks);
+        result.fonts.swap(builder->fonts);
+        for (FontCollection* font : result.fonts) {
+            font->Ref();
+        }
+
+        AutoMutex _l(gLineBreakCache.lock);
+        if (!gLineBreakCache.cache.put(key, result)) {
+            // Another builder cached the same paragraph meanwhile
+            gLineBreakCache(key, result);
+        }
+    }
+    builder->cacheable = false;
+    builder->fonts.clear();
+
     b->finish();
 
     return static_cast<jint>(nBreaks);
 }
 
 static jlong nNewBuilder(JNIEnv*, jclass) {
-    return reinterpret_cast<jlong>(new LineBreaker);
+    return reinterpret_cast<jlong>(new StaticLayoutBuilder);
 }
 
 static void nFreeBuilder(JNIEnv*, jclass, jlong nativePtr) {
-    delete reinterpret_cast<LineBreaker*>(nativePtr);
+    delete reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
 }
 
 static void nFinishBuilder(JNIEnv*, jclass, jlong nativePtr) {
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
-    b->finish();
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
+    builder->breaker.finish();
+    builder->cacheable = false;
 }
 
 static jlong nLoadHyphenator(JNIEnv* env, jclass, jobject buffer, jint offset) {
@@ -134,49 +281,97 @@ static jlong nLoadHyphenator(JNIEnv* env, jclass, jobject buffer, jint offset) {
 static void nSetLocale(JNIEnv* env, jclass, jlong nativePtr, jstring javaLocaleName,
         jlong nativeHyphenator) {
     ScopedIcuLocale icuLocale(env, javaLocaleName);
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
     Hyphenator* hyphenator = reinterpret_cast<Hyphenator*>(nativeHyphenator);
 
     if (icuLocale.valid()) {
-        b->setLocale(icuLocale.locale(), hyphenator);
+        builder->breaker.setLocale(icuLocale.locale(), hyphenator);
+
+        // Hyphenators are loaded once and kept, so they're known by address.
+        const char* name = icuLocale.locale().getName();
+        builder->localeKey.clear();
+        appendBytes(&builder->localeKey, name, strlen(name) + 1);
+        appendBytes(&builder->localeKey, &hyphenator, sizeof(hyphenator));
     }
 }
 
 static void nSetIndents(JNIEnv* env, jclass, jlong nativePtr, jintArray indents) {
     ScopedIntArrayRO indentArr(env, indents);
     std::vector<float> indentVec(indentArr.get(), indentArr.get() + indentArr.size());
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
-    b->setIndents(indentVec);
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
+    builder->breaker.setIndents(indentVec);
+
+    builder->indentsKey.clear();
+    const size_t count = indentVec.size();
+    appendBytes(&builder->indentsKey, &count, sizeof(count));
+    appendBytes(&builder->indentsKey, indentVec.data(), count * sizeof(float));
 }
 
 // Basically similar to Paint.getTextRunAdvances but with C++ interface
 static jfloat nAddStyleRun(JNIEnv* env, jclass, jlong nativePtr,
         jlong nativePaint, jlong nativeTypeface, jint start, jint end, jboolean isRtl) {
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
     Paint* paint = reinterpret_cast<Paint*>(nativePaint);
     TypefaceImpl* typeface = reinterpret_cast<TypefaceImpl*>(nativeTypeface);
     FontCollection *font;
     MinikinPaint minikinPaint;
     FontStyle style = MinikinUtils::prepareMinikinPaint(&minikinPaint, &font, paint, typeface);
-    return b->addStyleRun(&minikinPaint, font, style, start, end, isRtl);
+
+    // The widths are in the key already; hyphenation also measures with the
+    // paint and font of the run.
+    if (builder->cacheable) {
+        builder->appendKey(kStyleRun);
+        builder->appendKey(start);
+        builder->appendKey(end);
+        builder->appendKey(isRtl);
+        builder->appendKey(font);
+        if (std::find(builder->fonts.begin(), builder->fonts.end(), font) == builder->fonts.end()) {
+            builder->fonts.push_back(font);
+        }
+        builder->appendKey(style.getWeight());
+        builder->appendKey(style.getItalic());
+        builder->appendKey(paint->getFontVariant());
+        builder->appendKey(minikinPaint.size);
+        builder->appendKey(minikinPaint.scaleX);
+        builder->appendKey(minikinPaint.skewX);
+        builder->appendKey(minikinPaint.letterSpacing);
+        builder->appendKey(minikinPaint.paintFlags);
+        builder->appendKey(paint->getHyphenEdit());
+        const std::string& locale = paint->getTextLocale();
+        builder->appendKey(locale.c_str(), locale.size() + 1);
+        builder->appendKey(minikinPaint.fontFeatureSettings.c_str(),
+                minikinPaint.fontFeatureSettings.size() + 1);
+    }
+    return builder->breaker.addStyleRun(&minikinPaint, font, style, start, end, isRtl);
 }
 
 // Accept width measurements for the run, passed in from Java
 static void nAddMeasuredRun(JNIEnv* env, jclass, jlong nativePtr,
         jint start, jint end, jfloatArray widths) {
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
+    LineBreaker* b = &builder->breaker;
     env->GetFloatArrayRegion(widths, start, end - start, b->charWidths() + start);
     b->addStyleRun(nullptr, nullptr, FontStyle{}, start, end, false);
+
+    builder->appendKey(kMeasuredRun);
+    builder->appendKey(start);
+    builder->appendKey(end);
 }
 
 static void nAddReplacementRun(JNIEnv* env, jclass, jlong nativePtr,
         jint start, jint end, jfloat width) {
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
-    b->addReplacement(start, end, width);
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
+    builder->breaker.addReplacement(start, end, width);
+
+    builder->appendKey(kReplacementRun);
+    builder->appendKey(start);
+    builder->appendKey(end);
+    builder->appendKey(width);
 }
 
 static void nGetWidths(JNIEnv* env, jclass, jlong nativePtr, jfloatArray widths) {
-    LineBreaker* b = reinterpret_cast<LineBreaker*>(nativePtr);
+    StaticLayoutBuilder* builder = reinterpret_cast<StaticLayoutBuilder*>(nativePtr);
+    LineBreaker* b = &builder->breaker;
     env->SetFloatArrayRegion(widths, 0, b->size(), b->charWidths());
 }
 
@@ -38,6 +38,7 @@
 #include "JNIHelp.h"
 #include "ScopedStringChars.h"
 #include "ScopedUtfChars.h"
+#include "utils/JenkinsHash.h"
 #include "utils/Log.h"
 #include "utils/misc.h"
 
@@ -845,6 +846,85 @@ static jint android_content_AssetManager_loadResourceValue(JNIEnv* env, jobject
     return static_cast<jint>(block);
 }
 
+// Same as loadResourceValue() for each of ids, without a JNI call per value:
+// their values are written to outValues with STYLE_NUM_ENTRIES per id, the
+// same as retrieveArray(). The values not found are left TYPE_NULL with a
+// cookie of -1. Returns the number of values found.
+static jint android_content_AssetManager_loadResourceValues(JNIEnv* env, jobject clazz,
+                                                            jintArray ids,
+                                                            jshort density,
+                                                            jboolean resolve,
+                                                            jintArray outValues)
+{
+    if (ids == NULL) {
+        jniThrowNullPointerException(env, "ids");
+        return 0;
+    }
+    if (outValues == NULL) {
+        jniThrowNullPointerException(env, "out values");
+        return 0;
+    }
+    AssetManager* am = assetManagerForJavaObject(env, clazz);
+    if (am == NULL) {
+        return 0;
+    }
+    const ResTable& res(am->getResources());
+
+    const jsize NI = env->GetArrayLength(ids);
+    const jsize NV = env->GetArrayLength(outValues);
+    if (NV < (NI*STYLE_NUM_ENTRIES)) {
+        jniThrowException(env, "java/lang/IndexOutOfBoundsException", "out values too small");
+        return 0;
+    }
+
+    jint* src = (jint*)env->GetPrimitiveArrayCritical(ids, 0);
+    if (src == NULL) {
+        return 0;
+    }
+    jint* baseDest = (jint*)env->GetPrimitiveArrayCritical(outValues, 0);
+    jint* dest = baseDest;
+    if (dest == NULL) {
+        env->ReleasePrimitiveArrayCritical(ids, src, 0);
+        return 0;
+    }
+
+    // Values are looked up without locking the resource object.
+    jint found = 0;
+    Res_value value;
+    ResTable_config config;
+    for (jsize ii = 0; ii < NI; ii++) {
+        const uint32_t ident = (uint32_t)src[ii];
+        uint32_t typeSpecFlags = 0;
+        ssize_t block = res.getResource(ident, &value, false, density, &typeSpecFlags, &config);
+        uint32_t ref = ident;
+        if (block >= 0 && resolve) {
+            block = res.resolveReference(&value, block, &ref, &typeSpecFlags, &config);
+        }
+
+        if (block >= 0) {
+            dest[STYLE_TYPE] = value.dataType;
+            dest[STYLE_DATA] = value.data;
+            dest[STYLE_ASSET_COOKIE] = static_cast<jint>(res.getTableCookie(block));
+            dest[STYLE_RESOURCE_ID] = ref;
+            dest[STYLE_CHANGING_CONFIGURATIONS] = typeSpecFlags;
+            dest[STYLE_DENSITY] = config.density;
+            found++;
+        } else {
+            dest[STYLE_TYPE] = Res_value::TYPE_NULL;
+            dest[STYLE_DATA] = Res_value::DATA_NULL_UNDEFINED;
+            dest[STYLE_ASSET_COOKIE] = -1;
+            dest[STYLE_RESOURCE_ID] = 0;
+            dest[STYLE_CHANGING_CONFIGURATIONS] = 0;
+            dest[STYLE_DENSITY] = 0;
+        }
+        dest += STYLE_NUM_ENTRIES;
+    }
+
+    env->ReleasePrimitiveArrayCritical(outValues, baseDest, 0);
+    env->ReleasePrimitiveArrayCritical(ids, src, 0);
+    return found;
+}
+
 static jint android_content_AssetManager_loadResourceBagValue(JNIEnv* env, jobject clazz,
                                                            jint ident, jint bagEntryId,
                                                            jobject outValue, jboolean resolve)
@@ -1039,14 +1119,38 @@ class XmlAttributeFinder : public BackTrackingAttributeFinder<XmlAttributeFinder
 public:
     XmlAttributeFinder(const ResXMLParser* parser)
         : BackTrackingAttributeFinder(0, parser != NULL ? parser->getAttributeCount() : 0)
-        , mParser(parser) {}
+        , mParser(parser)
+        , mResolvedCount(0) {
+        // The flattened XML already stores the attributes sorted by resource ID, as
+        // R.styleable arrays are, so they can be matched positionally. Resolve the
+        // IDs of the element once up front: the finder reads each of them several
+        // times, and every read through the parser goes through the string pool
+        // index, the resource map and the dynamic reference table.
+        if (parser != NULL) {
+            const size_t count = parser->getAttributeCount();
+            if (count <= kMaxResolvedAttributes) {
+                for (size_t i = 0; i < count; i++) {
+                    mResolvedIds[i] = parser->getAttributeNameResID(i);
+                }
+                mResolvedCount = count;
+            }
+        }
+    }
 
     inline uint32_t getAttribute(jsize index) const {
+        if (static_cast<size_t>(index) < mResolvedCount) {
+            return mResolvedIds[index];
+        }
         return mParser->getAttributeNameResID(index);
     }
 
 private:
+    // Elements with more attributes than this are rare, they are read through the parser
+    static const size_t kMaxResolvedAttributes = 32;
+
     const ResXMLParser* mParser;
+    size_t mResolvedCount;
+    uint32_t mResolvedIds[kMaxResolvedAttributes];
 };
 
 class BagAttributeFinder : public BackTrackingAttributeFinder<BagAttributeFinder, const ResTable::bag_entry*> {
@@ -1132,14 +1236,13 @@ static jboolean android_content_AssetManager_resolveAttrs(JNIEnv* env, jobject c
         }
     }
 
-    // Now lock down the resource object and start pulling stuff from it.
-    res.lock();
-
-    // Retrieve the default style bag, if requested.
+    // Retrieve the default style bag, if requested. Bags are read without
+    // locking the resource object, the values are looked up lock-free too.
     const ResTable::bag_entry* defStyleStart = NULL;
     uint32_t defStyleTypeSetFlags = 0;
     ssize_t bagOff = defStyleRes != 0
-            ? res.getBagLocked(defStyleRes, &defStyleStart, &defStyleTypeSetFlags) : -1;
+            ? res.lockBag(defStyleRes, &defStyleStart, &defStyleTypeSetFlags) : -1;
+    const bool defStyleLocked = bagOff >= 0;
     defStyleTypeSetFlags |= defStyleBagTypeSetFlags;
     const ResTable::bag_entry* const defStyleEnd = defStyleStart + (bagOff >= 0 ? bagOff : 0);
     BagAttributeFinder defStyleAttrFinder(defStyleStart, defStyleEnd);
@@ -1249,7 +1352,9 @@ static jboolean android_content_AssetManager_resolveAttrs(JNIEnv* env, jobject c
         dest += STYLE_NUM_ENTRIES;
     }
 
-    res.unlock();
+    if (defStyleLocked) {
+        res.unlockBag(defStyleStart);
+    }
 
     if (indices != NULL) {
         indices[0] = indicesIdx;
@@ -1262,6 +1367,225 @@ static jboolean android_content_AssetManager_resolveAttrs(JNIEnv* env, jobject c
     return JNI_TRUE;
 }
 
+// The values applyStyle() resolves from the style of a tag, the default style
+// and the theme, for every view inflated with the same ones (e.g. the items of a
+// list). The generations of the theme and the table tell when they're stale.
+struct StyleCacheKey {
+    uint32_t themeGeneration;
+    uint32_t tableGeneration;
+    uint32_t defStyleRes;
+    uint32_t defStyleFlags;
+    uint32_t style;
+    uint32_t styleFlags;
+
+    bool operator==(const StyleCacheKey& other) const {
+        return themeGeneration == other.themeGeneration
+                && tableGeneration == other.tableGeneration
+                && defStyleRes == other.defStyleRes
+                && defStyleFlags == other.defStyleFlags
+                && style == other.style
+                && styleFlags == other.styleFlags;
+    }
+};
+
+struct StyleCacheEntry {
+    StyleCacheKey key;
+    Vector<jint> attrs;
+    // STYLE_NUM_ENTRIES per attribute, as written to applyStyle()'s outValues
+    Vector<jint> values;
+};
+
+static const size_t kStyleCacheSize = 16;
+static Mutex gStyleCacheLock;
+static StyleCacheEntry gStyleCache[kStyleCacheSize];
+
+static size_t getStyleCacheIndex(const StyleCacheKey& key, const jint* attrs, jsize count)
+{
+    uint32_t hash = JenkinsHashMixBytes(0, reinterpret_cast<const uint8_t*>(&key), sizeof(key));
+    hash = JenkinsHashMixBytes(hash, reinterpret_cast<const uint8_t*>(attrs),
+            count * sizeof(jint));
+    return JenkinsHashWhiten(hash) % kStyleCacheSize;
+}
+
+static bool getCachedStyleValues(const StyleCacheKey& key, const jint* attrs, jsize count,
+        jint* outValues)
+{
+    AutoMutex _l(gStyleCacheLock);
+    const StyleCacheEntry& entry = gStyleCache[getStyleCacheIndex(key, attrs, count)];
+    if (!(entry.key == key) || entry.attrs.size() != static_cast<size_t>(count)
+            || memcmp(entry.attrs.array(), attrs, count * sizeof(jint)) != 0) {
+        return false;
+    }
+    memcpy(outValues, entry.values.array(), entry.values.size() * sizeof(jint));
+    return true;
+}
+
+static void cacheStyleValues(const StyleCacheKey& key, const jint* attrs, jsize count,
+        const jint* values)
+{
+    AutoMutex _l(gStyleCacheLock);
+    StyleCacheEntry& entry = gStyleCache[getStyleCacheIndex(key, attrs, count)];
+    entry.key = key;
+    entry.attrs.clear();
+    entry.attrs.appendArray(attrs, count);
+    entry.values.clear();
+    entry.values.appendArray(values, count * STYLE_NUM_ENTRIES);
+}
+
+static void writeStyleValue(const ResTable& res, Res_value value, ssize_t block,
+        uint32_t resid, uint32_t typeSetFlags, const ResTable_config& config, jint* dest)
+{
+    static const ssize_t kXmlBlock = 0x10000000;
+
+    // Deal with the special @null value -- it turns back to TYPE_NULL.
+    if (value.dataType == Res_value::TYPE_REFERENCE && value.data == 0) {
+        if (kDebugStyles) {
+            ALOGI("-> Setting to @null!");
+        }
+        value.dataType = Res_value::TYPE_NULL;
+        value.data = Res_value::DATA_NULL_UNDEFINED;
+        block = kXmlBlock;
+    }
+
+    if (kDebugStyles) {
+        ALOGI("-> Final value: type=0x%x, data=0x%08x", value.dataType, value.data);
+    }
+
+    dest[STYLE_TYPE] = value.dataType;
+    dest[STYLE_DATA] = value.data;
+    dest[STYLE_ASSET_COOKIE] = block != kXmlBlock ?
+        static_cast<jint>(res.getTableCookie(block)) : -1;
+    dest[STYLE_RESOURCE_ID] = resid;
+    dest[STYLE_CHANGING_CONFIGURATIONS] = typeSetFlags;
+    dest[STYLE_DENSITY] = config.density;
+}
+
+// Resolves the attributes from the style of the tag, then the default style,
+// then the theme, ignoring the XML attributes of the tag.
+static bool resolveStyleValues(JNIEnv* env, const ResTable::Theme& theme,
+        uint32_t defStyleRes, uint32_t defStyleBagTypeSetFlags,
+        uint32_t style, uint32_t styleBagTypeSetFlags,
+        const jint* attrs, jsize count, jint* outValues)
+{
+    const ResTable& res = theme.getResTable();
+    ResTable_config config;
+    Res_value value;
+
+    // Retrieve the default style bag, if requested. Bags are read without
+    // locking the resource object, the values are looked up lock-free too.
+    const ResTable::bag_entry* defStyleAttrStart = NULL;
+    uint32_t defStyleTypeSetFlags = 0;
+    ssize_t bagOff = defStyleRes != 0
+            ? res.lockBag(defStyleRes, &defStyleAttrStart, &defStyleTypeSetFlags) : -1;
+    const bool defStyleLocked = bagOff >= 0;
+    defStyleTypeSetFlags |= defStyleBagTypeSetFlags;
+    const ResTable::bag_entry* const defStyleAttrEnd = defStyleAttrStart + (bagOff >= 0 ? bagOff : 0);
+    BagAttributeFinder defStyleAttrFinder(defStyleAttrStart, defStyleAttrEnd);
+
+    // Retrieve the style class bag, if requested.
+    const ResTable::bag_entry* styleAttrStart = NULL;
+    uint32_t styleTypeSetFlags = 0;
+    bagOff = style != 0 ? res.lockBag(style, &styleAttrStart, &styleTypeSetFlags) : -1;
+    const bool styleLocked = bagOff >= 0;
+    styleTypeSetFlags |= styleBagTypeSetFlags;
+    const ResTable::bag_entry* const styleAttrEnd = styleAttrStart + (bagOff >= 0 ? bagOff : 0);
+    BagAttributeFinder styleAttrFinder(styleAttrStart, styleAttrEnd);
+
+    bool ok = true;
+    for (jsize ii = 0; ii < count; ii++) {
+        const uint32_t curIdent = (uint32_t)attrs[ii];
+
+        if (kDebugStyles) {
+            ALOGI("RETRIEVING ATTR 0x%08x...", curIdent);
+        }
+
+        // Try to find a value for this attribute...  we prioritize values
+        // coming from the XML style, then default style, and finally the theme.
+        ssize_t block = 0;
+        uint32_t typeSetFlags = 0;
+        value.dataType = Res_value::TYPE_NULL;
+        value.data = Res_value::DATA_NULL_UNDEFINED;
+        config.density = 0;
+
+        // Walk through the style class values looking for the requested attribute.
+        const ResTable::bag_entry* const styleAttrEntry = styleAttrFinder.find(curIdent);
+        if (styleAttrEntry != styleAttrEnd) {
+            // We found the attribute we were looking for.
+            block = styleAttrEntry->stringBlock;
+            typeSetFlags = styleTypeSetFlags;
+            value = styleAttrEntry->map.value;
+            if (kDebugStyles) {
+                ALOGI("-> From style: type=0x%x, data=0x%08x", value.dataType, value.data);
+            }
+        }
+
+        if (value.dataType == Res_value::TYPE_NULL) {
+            // Walk through the default style values looking for the requested attribute.
+            const ResTable::bag_entry* const defStyleAttrEntry = defStyleAttrFinder.find(curIdent);
+            if (defStyleAttrEntry != defStyleAttrEnd) {
+                // We found the attribute we were looking for.
+                block = defStyleAttrEntry->stringBlock;
+                typeSetFlags = styleTypeSetFlags;
+                value = defStyleAttrEntry->map.value;
+                if (kDebugStyles) {
+                    ALOGI("-> From def style: type=0x%x, data=0x%08x", value.dataType, value.data);
+                }
+            }
+        }
+
+        uint32_t resid = 0;
+        if (value.dataType != Res_value::TYPE_NULL) {
+            // Take care of resolving the found resource to its final value.
+            ssize_t newBlock = theme.resolveAttributeReference(&value, block,
+                    &resid, &typeSetFlags, &config);
+            if (newBlock >= 0) {
+                block = newBlock;
+            }
+
+            if (kDebugStyles) {
+                ALOGI("-> Resolved attr: type=0x%x, data=0x%08x", value.dataType, value.data);
+            }
+        } else {
+            // If we still don't have a value for this attribute, try to find
+            // it in the theme!
+            ssize_t newBlock = theme.getAttribute(curIdent, &value, &typeSetFlags);
+            if (newBlock >= 0) {
+                if (kDebugStyles) {
+                    ALOGI("-> From theme: type=0x%x, data=0x%08x", value.dataType, value.data);
+                }
+                newBlock = res.resolveReference(&value, newBlock, &resid,
+                        &typeSetFlags, &config);
+                if (kThrowOnBadId) {
+                    if (newBlock == BAD_INDEX) {
+                        jniThrowException(env, "java/lang/IllegalStateException", "Bad resource!");
+                        ok = false;
+                        break;
+                    }
+                }
+
+                if (newBlock >= 0) {
+                    block = newBlock;
+                }
+
+                if (kDebugStyles) {
+                    ALOGI("-> Resolved theme: type=0x%x, data=0x%08x", value.dataType, value.data);
+                }
+            }
+        }
+
+        writeStyleValue(res, value, block, resid, typeSetFlags, config,
+                outValues + ii * STYLE_NUM_ENTRIES);
+    }
+
+    if (defStyleLocked) {
+        res.unlockBag(defStyleAttrStart);
+    }
+    if (styleLocked) {
+        res.unlockBag(styleAttrStart);
+    }
+    return ok;
+}
+
 static jboolean android_content_AssetManager_applyStyle(JNIEnv* env, jobject clazz,
                                                         jlong themeToken,
                                                         jint defStyleAttr,
@@ -1351,161 +1675,68 @@ static jboolean android_content_AssetManager_applyStyle(JNIEnv* env, jobject cla
         }
     }
 
-    // Now lock down the resource object and start pulling stuff from it.
-    res.lock();
-
-    // Retrieve the default style bag, if requested.
-    const ResTable::bag_entry* defStyleAttrStart = NULL;
-    uint32_t defStyleTypeSetFlags = 0;
-    ssize_t bagOff = defStyleRes != 0
-            ? res.getBagLocked(defStyleRes, &defStyleAttrStart, &defStyleTypeSetFlags) : -1;
-    defStyleTypeSetFlags |= defStyleBagTypeSetFlags;
-    const ResTable::bag_entry* const defStyleAttrEnd = defStyleAttrStart + (bagOff >= 0 ? bagOff : 0);
-    BagAttributeFinder defStyleAttrFinder(defStyleAttrStart, defStyleAttrEnd);
-
-    // Retrieve the style class bag, if requested.
-    const ResTable::bag_entry* styleAttrStart = NULL;
-    uint32_t styleTypeSetFlags = 0;
-    bagOff = style != 0 ? res.getBagLocked(style, &styleAttrStart, &styleTypeSetFlags) : -1;
-    styleTypeSetFlags |= styleBagTypeSetFlags;
-    const ResTable::bag_entry* const styleAttrEnd = styleAttrStart + (bagOff >= 0 ? bagOff : 0);
-    BagAttributeFinder styleAttrFinder(styleAttrStart, styleAttrEnd);
+    // The values from the styles and the theme only depend on the attributes
+    // requested, they're cached for the next views inflated the same way.
+    StyleCacheKey key;
+    key.themeGeneration = theme->getGeneration();
+    key.tableGeneration = res.getGeneration();
+    key.defStyleRes = defStyleRes;
+    key.defStyleFlags = defStyleBagTypeSetFlags;
+    key.style = style;
+    key.styleFlags = styleBagTypeSetFlags;
+    if (!getCachedStyleValues(key, src, NI, dest)) {
+        if (!resolveStyleValues(env, *theme, defStyleRes, defStyleBagTypeSetFlags,
+                style, styleBagTypeSetFlags, src, NI, dest)) {
+            if (indices != NULL) {
+                env->ReleasePrimitiveArrayCritical(outIndices, indices, 0);
+            }
+            env->ReleasePrimitiveArrayCritical(outValues, baseDest, 0);
+            env->ReleasePrimitiveArrayCritical(attrs, src, 0);
+            return JNI_FALSE;
+        }
+        cacheStyleValues(key, src, NI, dest);
+    }
 
-    // Retrieve the XML attributes, if requested.
+    // The XML attributes take precedence, they're resolved for every tag.
     static const ssize_t kXmlBlock = 0x10000000;
     XmlAttributeFinder xmlAttrFinder(xmlParser);
     const jsize xmlAttrEnd = xmlParser != NULL ? xmlParser->getAttributeCount() : 0;
 
-    // Now iterate through all of the attributes that the client has requested,
-    // filling in each with whatever data we can find.
-    ssize_t block = 0;
-    uint32_t typeSetFlags;
     for (jsize ii = 0; ii < NI; ii++) {
         const uint32_t curIdent = (uint32_t)src[ii];
 
-        if (kDebugStyles) {
-            ALOGI("RETRIEVING ATTR 0x%08x...", curIdent);
-        }
-
-        // Try to find a value for this attribute...  we prioritize values
-        // coming from, first XML attributes, then XML style, then default
-        // style, and finally the theme.
-        value.dataType = Res_value::TYPE_NULL;
-        value.data = Res_value::DATA_NULL_UNDEFINED;
-        typeSetFlags = 0;
-        config.density = 0;
-
         // Walk through the xml attributes looking for the requested attribute.
         const jsize xmlAttrIdx = xmlAttrFinder.find(curIdent);
         if (xmlAttrIdx != xmlAttrEnd) {
-            // We found the attribute we were looking for.
-            block = kXmlBlock;
+            value.dataType = Res_value::TYPE_NULL;
+            value.data = Res_value::DATA_NULL_UNDEFINED;
+            config.density = 0;
             xmlParser->getAttributeValue(xmlAttrIdx, &value);
             if (kDebugStyles) {
-                ALOGI("-> From XML: type=0x%x, data=0x%08x", value.dataType, value.data);
-            }
-        }
-
-        if (value.dataType == Res_value::TYPE_NULL) {
-            // Walk through the style class values looking for the requested attribute.
-            const ResTable::bag_entry* const styleAttrEntry = styleAttrFinder.find(curIdent);
-            if (styleAttrEntry != styleAttrEnd) {
-                // We found the attribute we were looking for.
-                block = styleAttrEntry->stringBlock;
-                typeSetFlags = styleTypeSetFlags;
-                value = styleAttrEntry->map.value;
-                if (kDebugStyles) {
-                    ALOGI("-> From style: type=0x%x, data=0x%08x", value.dataType, value.data);
-                }
-            }
-        }
-
-        if (value.dataType == Res_value::TYPE_NULL) {
-            // Walk through the default style values looking for the requested attribute.
-            const ResTable::bag_entry* const defStyleAttrEntry = defStyleAttrFinder.find(curIdent);
-            if (defStyleAttrEntry != defStyleAttrEnd) {
-                // We found the attribute we were looking for.
-                block = defStyleAttrEntry->stringBlock;
-                typeSetFlags = styleTypeSetFlags;
-                value = defStyleAttrEntry->map.value;
-                if (kDebugStyles) {
-                    ALOGI("-> From def style: type=0x%x, data=0x%08x", value.dataType, value.data);
-                }
-            }
-        }
-
-        uint32_t resid = 0;
-        if (value.dataType != Res_value::TYPE_NULL) {
-            // Take care of resolving the found resource to its final value.
-            ssize_t newBlock = theme->resolveAttributeReference(&value, block,
-                    &resid, &typeSetFlags, &config);
-            if (newBlock >= 0) {
-                block = newBlock;
-            }
-
-            if (kDebugStyles) {
-                ALOGI("-> Resolved attr: type=0x%x, data=0x%08x", value.dataType, value.data);
+                ALOGI("Attribute 0x%08x from XML: type=0x%x, data=0x%08x", curIdent,
+                        value.dataType, value.data);
             }
-        } else {
-            // If we still don't have a value for this attribute, try to find
-            // it in the theme!
-            ssize_t newBlock = theme->getAttribute(curIdent, &value, &typeSetFlags);
-            if (newBlock >= 0) {
-                if (kDebugStyles) {
-                    ALOGI("-> From theme: type=0x%x, data=0x%08x", value.dataType, value.data);
-                }
-                newBlock = res.resolveReference(&value, block, &resid,
-                        &typeSetFlags, &config);
-                if (kThrowOnBadId) {
-                    if (newBlock == BAD_INDEX) {
-                        jniThrowException(env, "java/lang/IllegalStateException", "Bad resource!");
-                        return JNI_FALSE;
-                    }
-                }
-
+            if (value.dataType != Res_value::TYPE_NULL) {
+                // Take care of resolving the found resource to its final value.
+                ssize_t block = kXmlBlock;
+                uint32_t resid = 0;
+                uint32_t typeSetFlags = 0;
+                ssize_t newBlock = theme->resolveAttributeReference(&value, block,
+                        &resid, &typeSetFlags, &config);
                 if (newBlock >= 0) {
                     block = newBlock;
                 }
-
-                if (kDebugStyles) {
-                    ALOGI("-> Resolved theme: type=0x%x, data=0x%08x", value.dataType, value.data);
-                }
+                writeStyleValue(res, value, block, resid, typeSetFlags, config,
+                        dest + ii * STYLE_NUM_ENTRIES);
             }
         }
 
-        // Deal with the special @null value -- it turns back to TYPE_NULL.
-        if (value.dataType == Res_value::TYPE_REFERENCE && value.data == 0) {
-            if (kDebugStyles) {
-                ALOGI("-> Setting to @null!");
-            }
-            value.dataType = Res_value::TYPE_NULL;
-            value.data = Res_value::DATA_NULL_UNDEFINED;
-            block = kXmlBlock;
-        }
-
-        if (kDebugStyles) {
-            ALOGI("Attribute 0x%08x: type=0x%x, data=0x%08x", curIdent, value.dataType, value.data);
-        }
-
-        // Write the final value back to Java.
-        dest[STYLE_TYPE] = value.dataType;
-        dest[STYLE_DATA] = value.data;
-        dest[STYLE_ASSET_COOKIE] = block != kXmlBlock ?
-            static_cast<jint>(res.getTableCookie(block)) : -1;
-        dest[STYLE_RESOURCE_ID] = resid;
-        dest[STYLE_CHANGING_CONFIGURATIONS] = typeSetFlags;
-        dest[STYLE_DENSITY] = config.density;
-
-        if (indices != NULL && value.dataType != Res_value::TYPE_NULL) {
+        if (indices != NULL && dest[ii * STYLE_NUM_ENTRIES + STYLE_TYPE] != Res_value::TYPE_NULL) {
             indicesIdx++;
             indices[indicesIdx] = ii;
         }
-
-        dest += STYLE_NUM_ENTRIES;
     }
 
-    res.unlock();
-
     if (indices != NULL) {
         indices[0] = indicesIdx;
         env->ReleasePrimitiveArrayCritical(outIndices, indices, 0);
@@ -1576,8 +1807,7 @@ static jboolean android_content_AssetManager_retrieveAttributes(JNIEnv* env, job
 
     // Retrieve the XML attributes, if requested.
     const jsize NX = xmlParser->getAttributeCount();
-    jsize ix=0;
-    uint32_t curXmlAttr = xmlParser->getAttributeNameResID(ix);
+    XmlAttributeFinder xmlAttrFinder(xmlParser);
 
     static const ssize_t kXmlBlock = 0x10000000;
 
@@ -1594,17 +1824,11 @@ static jboolean android_content_AssetManager_retrieveAttributes(JNIEnv* env, job
         typeSetFlags = 0;
         config.density = 0;
 
-        // Skip through XML attributes until the end or the next possible match.
-        while (ix < NX && curIdent > curXmlAttr) {
-            ix++;
-            curXmlAttr = xmlParser->getAttributeNameResID(ix);
-        }
-        // Retrieve the current XML attribute if it matches, and step to next.
-        if (ix < NX && curIdent == curXmlAttr) {
+        // Retrieve the XML attribute if there is one for this attribute.
+        const jsize xmlAttrIdx = xmlAttrFinder.find(curIdent);
+        if (xmlAttrIdx != NX) {
             block = kXmlBlock;
-            xmlParser->getAttributeValue(ix, &value);
-            ix++;
-            curXmlAttr = xmlParser->getAttributeNameResID(ix);
+            xmlParser->getAttributeValue(xmlAttrIdx, &value);
         }
 
         //printf("Attribute 0x%08x: type=0x%x, data=0x%08x\n", curIdent, value.dataType, value.data);
@@ -1670,10 +1894,11 @@ static jint android_content_AssetManager_getArraySize(JNIEnv* env, jobject clazz
     }
     const ResTable& res(am->getResources());
 
-    res.lock();
     const ResTable::bag_entry* defStyleEnt = NULL;
-    ssize_t bagOff = res.getBagLocked(id, &defStyleEnt);
-    res.unlock();
+    ssize_t bagOff = res.lockBag(id, &defStyleEnt);
+    if (bagOff >= 0) {
+        res.unlockBag(defStyleEnt);
+    }
 
     return static_cast<jint>(bagOff);
 }
@@ -1705,12 +1930,10 @@ static jint android_content_AssetManager_retrieveArray(JNIEnv* env, jobject claz
         return JNI_FALSE;
     }
 
-    // Now lock down the resource object and start pulling stuff from it.
-    res.lock();
-
     const ResTable::bag_entry* arrayEnt = NULL;
     uint32_t arrayTypeSetFlags = 0;
-    ssize_t bagOff = res.getBagLocked(id, &arrayEnt, &arrayTypeSetFlags);
+    ssize_t bagOff = res.lockBag(id, &arrayEnt, &arrayTypeSetFlags);
+    const ResTable::bag_entry* const startArrayEnt = arrayEnt;
     const ResTable::bag_entry* endArrayEnt = arrayEnt +
         (bagOff >= 0 ? bagOff : 0);
 
@@ -1759,7 +1982,9 @@ static jint android_content_AssetManager_retrieveArray(JNIEnv* env, jobject claz
 
     i /= STYLE_NUM_ENTRIES;
 
-    res.unlock();
+    if (bagOff >= 0) {
+        res.unlockBag(startArrayEnt);
+    }
 
     env->ReleasePrimitiveArrayCritical(outValues, baseDest, 0);
 
@@ -2035,6 +2260,14 @@ static jint android_content_AssetManager_getGlobalAssetCount(JNIEnv* env, jobjec
 static jobject android_content_AssetManager_getAssetAllocations(JNIEnv* env, jobject clazz)
 {
     String8 alloc = Asset::getAssetAllocations();
+
+    size_t mappedTableSize, copiedTableSize;
+    ResTable::getGlobalTableSizes(&mappedTableSize, &copiedTableSize);
+    if (mappedTableSize > 0 || copiedTableSize > 0) {
+        alloc.appendFormat("    Resource tables: %zuK mapped, %zuK copied\n",
+                (mappedTableSize + 512) / 1024, (copiedTableSize + 512) / 1024);
+    }
+
     if (alloc.length() <= 0) {
         return NULL;
     }
@@ -2171,6 +2404,12 @@ static JNINativeMethod gAssetManagerMethods[] = {
         (void*) android_content_AssetManager_getGlobalAssetManagerCount },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gAssetManagerOptionalMethods[] = {
+    { "loadResourceValues","([ISZ[I)I",
+        (void*) android_content_AssetManager_loadResourceValues },
+};
+
 int register_android_content_AssetManager(JNIEnv* env)
 {
     jclass typedValue = FindClassOrDie(env, "android/util/TypedValue");
@@ -2203,6 +2442,8 @@ int register_android_content_AssetManager(JNIEnv* env)
     gSparseArrayOffsets.put = GetMethodIDOrDie(env, gSparseArrayOffsets.classObject, "put",
                                                "(ILjava/lang/Object;)V");
 
+    RegisterOptionalMethods(env, "android/content/res/AssetManager",
+                            gAssetManagerOptionalMethods, NELEM(gAssetManagerOptionalMethods));
     return RegisterMethodsOrDie(env, "android/content/res/AssetManager", gAssetManagerMethods,
                                 NELEM(gAssetManagerMethods));
 }
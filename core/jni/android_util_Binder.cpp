@@ -19,17 +19,20 @@
 
 #include "android_os_Parcel.h"
 #include "android_util_Binder.h"
+#include "android_util_Log2Histogram.h"
 
 #include "JNIHelp.h"
 
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <utils/Atomic.h>
+#include <utils/JenkinsHash.h>
 #include <binder/IInterface.h>
 #include <binder/IPCThreadState.h>
 #include <utils/Log.h>
@@ -42,10 +45,13 @@
 #include <binder/IServiceManager.h>
 #include <utils/threads.h>
 #include <utils/String8.h>
+#include <utils/Timers.h>
 
 #include <ScopedUtfChars.h>
 #include <ScopedLocalRef.h>
 
+#include <atomic>
+
 #include "core_jni_helpers.h"
 
 //#undef ALOGV
@@ -212,6 +218,217 @@ bail:
     env->DeleteLocalRef(msgstr);
 }
 
+// ----------------------------------------------------------------------------
+// Transaction statistics
+//
+// Every transaction through JavaBBinder and BinderProxy is counted in log2
+// histograms of its latency and parcel size, per direction, interface
+// descriptor and transaction code. Each thread records into a table of its
+// own with relaxed atomics, so recording never takes a lock. Tables are never
+// freed, because a dump may be reading them: a thread's table goes to the
+// next thread that starts making transactions when it exits.
+
+static const size_t kBinderStatsSlots = 64;
+static const size_t kBinderStatsBuckets = 20;
+
+struct BinderStatsSlot {
+    // 0 while the slot is free, then the key of binderStatsKey()
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> totalMicros;
+    // Bucket i counts values in [2^(i-1), 2^i), the last one everything above
+    std::atomic<uint32_t> latencyMicros[kBinderStatsBuckets];
+    std::atomic<uint32_t> sizeBytes[kBinderStatsBuckets];
+};
+
+struct BinderStatsTable {
+    BinderStatsSlot slots[kBinderStatsSlots];
+    // Transactions that found every slot taken by other keys
+    std::atomic<uint32_t> dropped;
+};
+
+static Mutex gBinderStatsLock;
+static Vector<BinderStatsTable*> gBinderStatsTables;
+static Vector<BinderStatsTable*> gBinderStatsFreeTables;
+// The descriptor of the upper half of each key, for dumping
+static KeyedVector<uint32_t, String16> gBinderStatsDescriptors;
+static pthread_key_t gBinderStatsTableKey;
+static pthread_once_t gBinderStatsOnce = PTHREAD_ONCE_INIT;
+
+static void releaseBinderStatsTable(void* table)
+{
+    AutoMutex _l(gBinderStatsLock);
+    gBinderStatsFreeTables.push(static_cast<BinderStatsTable*>(table));
+}
+
+static void initBinderStats()
+{
+    pthread_key_create(&gBinderStatsTableKey, releaseBinderStatsTable);
+}
+
+static BinderStatsTable* binderStatsTable()
+{
+    pthread_once(&gBinderStatsOnce, initBinderStats);
+    BinderStatsTable* table =
+            static_cast<BinderStatsTable*>(pthread_getspecific(gBinderStatsTableKey));
+    if (table == NULL) {
+        AutoMutex _l(gBinderStatsLock);
+        if (gBinderStatsFreeTables.isEmpty()) {
+            table = new BinderStatsTable();
+            gBinderStatsTables.push(table);
+        } else {
+            table = gBinderStatsFreeTables.top();
+            gBinderStatsFreeTables.pop();
+        }
+        pthread_setspecific(gBinderStatsTableKey, table);
+    }
+    return table;
+}
+
+static size_t binderStatsBucket(uint64_t value)
+{
+    return log2HistogramBucket(value, kBinderStatsBuckets);
+}
+
+// AIDL calls start with the interface token written by writeInterfaceToken(),
+// which gives the descriptor without asking the target for it.
+static uint32_t binderStatsDescriptorHash(const Parcel& data, uint32_t code,
+        const char16_t** outDescriptor, size_t* outLength)
+{
+    *outDescriptor = NULL;
+    *outLength = 0;
+    if (code < IBinder::FIRST_CALL_TRANSACTION || code > IBinder::LAST_CALL_TRANSACTION) {
+        return 0;
+    }
+
+    const size_t pos = data.dataPosition();
+    data.setDataPosition(0);
+    data.readInt32();   // strict mode policy
+    *outDescriptor = data.readString16Inplace(outLength);
+    data.setDataPosition(pos);
+    if (*outDescriptor == NULL) {
+        *outLength = 0;
+        return 0;
+    }
+    return JenkinsHashWhiten(JenkinsHashMixShorts(0,
+            reinterpret_cast<const uint16_t*>(*outDescriptor), *outLength));
+}
+
+static uint64_t binderStatsKey(bool incoming, uint32_t descriptorHash, uint32_t code)
+{
+    const uint32_t upper = 0x80000000 | (incoming ? 0x40000000 : 0) |
+            (descriptorHash & 0x3fffffff);
+    return (uint64_t(upper) << 32) | code;
+}
+
+static void recordBinderTransaction(bool incoming, uint32_t code, const Parcel& data,
+        const Parcel* reply, nsecs_t startTime)
+{
+    const uint64_t micros = uint64_t(systemTime(SYSTEM_TIME_MONOTONIC) - startTime) / 1000;
+    const size_t size = data.dataSize() + (reply != NULL ? reply->dataSize() : 0);
+
+    const char16_t* descriptor;
+    size_t descriptorLength;
+    const uint32_t hash = binderStatsDescriptorHash(data, code, &descriptor, &descriptorLength);
+    const uint64_t key = binderStatsKey(incoming, hash, code);
+
+    BinderStatsTable* table = binderStatsTable();
+    BinderStatsSlot* slot = NULL;
+    for (size_t i = 0, index = key % kBinderStatsSlots; i < kBinderStatsSlots;
+            i++, index = (index + 1) % kBinderStatsSlots) {
+        const uint64_t slotKey = table->slots[index].key.load(std::memory_order_relaxed);
+        if (slotKey == key) {
+            slot = &table->slots[index];
+            break;
+        }
+        if (slotKey == 0) {
+            // Only this thread writes keys, the release pairs with the dump.
+            slot = &table->slots[index];
+            slot->key.store(key, std::memory_order_release);
+
+            const uint32_t upper = key >> 32;
+            AutoMutex _l(gBinderStatsLock);
+            if (gBinderStatsDescriptors.indexOfKey(upper) < 0) {
+                gBinderStatsDescriptors.add(upper, descriptor != NULL
+                        ? String16(descriptor, descriptorLength) : String16());
+            }
+            break;
+        }
+    }
+
+    if (slot == NULL) {
+        table->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    slot->totalMicros.fetch_add(micros, std::memory_order_relaxed);
+    slot->latencyMicros[binderStatsBucket(micros)].fetch_add(1, std::memory_order_relaxed);
+    slot->sizeBytes[binderStatsBucket(size)].fetch_add(1, std::memory_order_relaxed);
+}
+
+struct BinderStatsTotals {
+    uint64_t count;
+    uint64_t totalMicros;
+    uint64_t latencyMicros[kBinderStatsBuckets];
+    uint64_t sizeBytes[kBinderStatsBuckets];
+};
+
+static void dumpBinderStatsHistogram(int fd, const char* label, const uint64_t* buckets)
+{
+    dprintf(fd, "    %s:", label);
+    dumpLog2Histogram(fd, buckets, kBinderStatsBuckets);
+}
+
+static void dumpBinderStats(int fd)
+{
+    KeyedVector<uint64_t, BinderStatsTotals> totals;
+    uint64_t dropped = 0;
+
+    AutoMutex _l(gBinderStatsLock);
+    for (size_t t = 0; t < gBinderStatsTables.size(); t++) {
+        BinderStatsTable* table = gBinderStatsTables[t];
+        dropped += table->dropped.load(std::memory_order_relaxed);
+        for (size_t s = 0; s < kBinderStatsSlots; s++) {
+            const BinderStatsSlot& slot = table->slots[s];
+            const uint64_t key = slot.key.load(std::memory_order_acquire);
+            if (key == 0) {
+                continue;
+            }
+
+            ssize_t index = totals.indexOfKey(key);
+            if (index < 0) {
+                BinderStatsTotals empty;
+                memset(&empty, 0, sizeof(empty));
+                index = totals.add(key, empty);
+            }
+            BinderStatsTotals& total = totals.editValueAt(index);
+            total.totalMicros += slot.totalMicros.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < kBinderStatsBuckets; i++) {
+                const uint32_t count = slot.latencyMicros[i].load(std::memory_order_relaxed);
+                total.count += count;
+                total.latencyMicros[i] += count;
+                total.sizeBytes[i] += slot.sizeBytes[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    dprintf(fd, "Binder transaction stats for pid %d (%zu threads):\n", getpid(),
+            gBinderStatsTables.size());
+    for (size_t i = 0; i < totals.size(); i++) {
+        const uint64_t key = totals.keyAt(i);
+        const BinderStatsTotals& total = totals.valueAt(i);
+        const uint32_t upper = key >> 32;
+        String8 descriptor(gBinderStatsDescriptors.valueFor(upper));
+        dprintf(fd, "  %s %s code=%" PRIu32 ": count=%" PRIu64 " total=%" PRIu64 "us\n",
+                (upper & 0x40000000) ? "incoming" : "outgoing",
+                descriptor.isEmpty() ? "<no descriptor>" : descriptor.string(),
+                uint32_t(key), total.count, total.totalMicros);
+        dumpBinderStatsHistogram(fd, "latency us", total.latencyMicros);
+        dumpBinderStatsHistogram(fd, "size bytes", total.sizeBytes);
+    }
+    if (dropped > 0) {
+        dprintf(fd, "  %" PRIu64 " transactions dropped, tables full\n", dropped);
+    }
+}
+
 class JavaBBinderHolder;
 
 class JavaBBinder : public BBinder
@@ -257,8 +474,10 @@ protected:
         //printf("Transact from %p to Java code sending: ", this);
         //data.print();
         //printf("\n");
+        const nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
         jboolean res = env->CallBooleanMethod(mObject, gBinderOffsets.mExecTransact,
             code, reinterpret_cast<jlong>(&data), reinterpret_cast<jlong>(reply), flags);
+        recordBinderTransaction(true, code, data, reply, start_time);
 
         if (env->ExceptionCheck()) {
             jthrowable excep = env->ExceptionOccurred();
@@ -542,7 +761,17 @@ static void proxy_cleanup(const void* id, void* obj, void* cleanupCookie)
     env->DeleteGlobalRef((jobject)obj);
 }
 
-static Mutex mProxyLock;
+// Looking up and creating the Java proxy of an IBinder only has to be
+// serialized against other threads doing the same for that IBinder, so the
+// binders are spread over several locks instead of sharing a single one.
+static const size_t kProxyLockCount = 32;
+static Mutex gProxyLocks[kProxyLockCount];
+
+static Mutex& proxyLockFor(IBinder* binder)
+{
+    // Heap addresses are aligned, the lowest bits would leave most locks unused
+    return gProxyLocks[(reinterpret_cast<uintptr_t>(binder) >> 4) % kProxyLockCount];
+}
 
 jobject javaObjectForIBinder(JNIEnv* env, const sp<IBinder>& val)
 {
@@ -556,8 +785,8 @@ jobject javaObjectForIBinder(JNIEnv* env, const sp<IBinder>& val)
     }
 
     // For the rest of the function we will hold this lock, to serialize
-    // looking/creation of Java proxies for native Binder proxies.
-    AutoMutex _l(mProxyLock);
+    // looking/creation of Java proxies for this native Binder proxy.
+    AutoMutex _l(proxyLockFor(val.get()));
 
     // Someone else's...  do we know about it?
     jobject object = (jobject)val->findObject(&gBinderProxyOffsets);
@@ -920,6 +1149,17 @@ static void android_os_BinderInternal_handleGc(JNIEnv* env, jobject clazz)
     android_atomic_and(0, &gNumRefsCreated);
 }
 
+static void android_os_BinderInternal_dumpTransactionStats(JNIEnv* env, jobject clazz,
+        jobject fdObj)
+{
+    int fd = jniGetFDFromFileDescriptor(env, fdObj);
+    if (fd < 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "bad FileDescriptor");
+        return;
+    }
+    dumpBinderStats(fd);
+}
+
 // ----------------------------------------------------------------------------
 
 static const JNINativeMethod gBinderInternalMethods[] = {
@@ -927,7 +1167,12 @@ static const JNINativeMethod gBinderInternalMethods[] = {
     { "getContextObject", "()Landroid/os/IBinder;", (void*)android_os_BinderInternal_getContextObject },
     { "joinThreadPool", "()V", (void*)android_os_BinderInternal_joinThreadPool },
     { "disableBackgroundScheduling", "(Z)V", (void*)android_os_BinderInternal_disableBackgroundScheduling },
-    { "handleGc", "()V", (void*)android_os_BinderInternal_handleGc }
+    { "handleGc", "()V", (void*)android_os_BinderInternal_handleGc },
+};
+
+// Natives whose Java declarations may not be present.
+static const JNINativeMethod gBinderInternalOptionalMethods[] = {
+    { "dumpTransactionStats", "(Ljava/io/FileDescriptor;)V", (void*)android_os_BinderInternal_dumpTransactionStats },
 };
 
 const char* const kBinderInternalPathName = "com/android/internal/os/BinderInternal";
@@ -939,6 +1184,8 @@ static int int_register_android_os_BinderInternal(JNIEnv* env)
     gBinderInternalOffsets.mClass = MakeGlobalRefOrDie(env, clazz);
     gBinderInternalOffsets.mForceGc = GetStaticMethodIDOrDie(env, clazz, "forceBinderGc", "()V");
 
+    RegisterOptionalMethods(env, kBinderInternalPathName,
+            gBinderInternalOptionalMethods, NELEM(gBinderInternalOptionalMethods));
     return RegisterMethodsOrDie(
         env, kBinderInternalPathName,
         gBinderInternalMethods, NELEM(gBinderInternalMethods));
@@ -1121,7 +1368,9 @@ static jboolean android_os_BinderProxy_transact(JNIEnv* env, jobject obj,
     }
 
     //printf("Transact from Java code to %p sending: ", target); data->print();
+    const nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
     status_t err = target->transact(code, *data, reply, flags);
+    recordBinderTransaction(false, code, *data, reply, start_time);
     //if (reply) printf("Transact from Java code to %p received: ", target); reply->print();
 
     if (kEnableBinderSample) {
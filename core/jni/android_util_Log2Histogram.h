@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UTIL_LOG2_HISTOGRAM_H
+#define ANDROID_UTIL_LOG2_HISTOGRAM_H
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace android {
+
+// Log2 histograms, as dumped by the binder and looper stats. Bucket i counts
+// values in [2^(i-1), 2^i), and the last one everything above.
+
+inline size_t log2HistogramBucket(uint64_t value, size_t bucketCount)
+{
+    if (value == 0) {
+        return 0;
+    }
+    const size_t bucket = 64 - __builtin_clzll(value);
+    return bucket < bucketCount ? bucket : bucketCount - 1;
+}
+
+// Writes the non-empty buckets, as " <bound:count", and ends the line.
+template <typename T>
+inline void dumpLog2Histogram(int fd, const T* buckets, size_t bucketCount)
+{
+    for (size_t i = 0; i < bucketCount; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        if (i + 1 == bucketCount) {
+            dprintf(fd, " >=%" PRIu64 ":%" PRIu64, uint64_t(1) << (i - 1), uint64_t(buckets[i]));
+        } else {
+            dprintf(fd, " <%" PRIu64 ":%" PRIu64, uint64_t(1) << i, uint64_t(buckets[i]));
+        }
+    }
+    dprintf(fd, "\n");
+}
+
+}  // namespace android
+
+#endif  // ANDROID_UTIL_LOG2_HISTOGRAM_H
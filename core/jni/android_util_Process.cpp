@@ -22,6 +22,8 @@
 #include <binder/IServiceManager.h>
 #include <cutils/process_name.h>
 #include <cutils/sched_policy.h>
+#include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
 #include <processgroup/processgroup.h>
@@ -690,6 +692,244 @@ jintArray android_os_Process_getPids(JNIEnv* env, jobject clazz,
     return lastArray;
 }
 
+// Layout of each record written by sampleProcStats().
+// Must be kept in sync with the constants defined in Process.java.
+enum {
+    PROC_SAMPLE_PID = 0,
+    PROC_SAMPLE_PPID,
+    PROC_SAMPLE_MINOR_FAULTS,
+    PROC_SAMPLE_MAJOR_FAULTS,
+    PROC_SAMPLE_UTIME,          // clock ticks
+    PROC_SAMPLE_STIME,          // clock ticks
+    PROC_SAMPLE_NUM_THREADS,
+    PROC_SAMPLE_START_TIME,     // clock ticks since boot
+    PROC_SAMPLE_VSIZE,          // bytes
+    PROC_SAMPLE_RSS,            // pages
+    PROC_SAMPLE_VM_SWAP,        // kB, from status, -1 if not read
+    PROC_SAMPLE_UID,            // real uid, from status, -1 if not read
+    PROC_SAMPLE_FIELD_COUNT
+};
+
+// Parses the numeric fields of a stat line.  The command name can contain
+// spaces and parentheses, so the fields start after the last ')'.
+static bool parseProcStat(char* buffer, jlong* record)
+{
+    char* p = strrchr(buffer, ')');
+    if (p == NULL) {
+        return false;
+    }
+    p++;
+
+    // Fields are numbered as in proc(5), the first one after the name is 3 (state).
+    int field = 3;
+    while (*p && field <= 24) {
+        while (*p == ' ') p++;
+        char* start = p;
+        while (*p && *p != ' ') p++;
+        if (*p) *p++ = '\0';
+
+        const jlong value = field == 3 ? 0 : strtoll(start, NULL, 10);
+        switch (field) {
+            case 4:  record[PROC_SAMPLE_PPID] = value; break;
+            case 10: record[PROC_SAMPLE_MINOR_FAULTS] = value; break;
+            case 12: record[PROC_SAMPLE_MAJOR_FAULTS] = value; break;
+            case 14: record[PROC_SAMPLE_UTIME] = value; break;
+            case 15: record[PROC_SAMPLE_STIME] = value; break;
+            case 20: record[PROC_SAMPLE_NUM_THREADS] = value; break;
+            case 22: record[PROC_SAMPLE_START_TIME] = value; break;
+            case 23: record[PROC_SAMPLE_VSIZE] = value; break;
+            case 24: record[PROC_SAMPLE_RSS] = value; break;
+        }
+        field++;
+    }
+    return field > 24;
+}
+
+static void parseProcStatus(const char* buffer, jlong* record)
+{
+    for (const char* line = buffer; line != NULL && *line; ) {
+        if (strncmp(line, "Uid:", 4) == 0) {
+            record[PROC_SAMPLE_UID] = strtoll(line + 4, NULL, 10);
+        } else if (strncmp(line, "VmSwap:", 7) == 0) {
+            record[PROC_SAMPLE_VM_SWAP] = strtoll(line + 7, NULL, 10);
+        }
+        line = strchr(line, '\n');
+        if (line != NULL) line++;
+    }
+}
+
+// The stat and status entries opened by sampleProcStats(), kept open to be read
+// again by the next sample, keyed by their path.  An fd outlives the process it
+// was opened for, reads then fail with ESRCH, even if its pid gets reused.
+struct ProcEntryFd {
+    int fd;
+    // The sample that last read the entry
+    uint32_t sample;
+};
+static Mutex gProcEntryFdsLock;
+static KeyedVector<String8, ProcEntryFd> gProcEntryFds;
+static uint32_t gProcSample;
+static const size_t kMaxProcEntryFds = 1024;
+static const size_t kMaxProcEntrySize = 64 * 1024;
+
+// Reads the whole entry from the start, growing the buffer as needed.
+static ssize_t readWholeProcEntry(int fd, Vector<char>& buffer)
+{
+    size_t len = 0;
+    for (;;) {
+        if (len + 1 >= buffer.size()) {
+            if (buffer.size() >= kMaxProcEntrySize) {
+                break;
+            }
+            buffer.resize(buffer.size() * 2);
+        }
+        ssize_t n = TEMP_FAILURE_RETRY(pread(fd, buffer.editArray() + len,
+                buffer.size() - 1 - len, len));
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        len += n;
+    }
+    buffer.editArray()[len] = '\0';
+    return len;
+}
+
+// Must be called with gProcEntryFdsLock held.
+static ssize_t readProcEntry(const String8& dir, int dirFd, const char* pidName,
+        const char* file, Vector<char>& buffer)
+{
+    String8 path = String8::format("%s/%s", pidName, file);
+    String8 key(dir);
+    key.appendPath(path);
+
+    ssize_t index = gProcEntryFds.indexOfKey(key);
+    if (index >= 0) {
+        ProcEntryFd& entry = gProcEntryFds.editValueAt(index);
+        ssize_t len = readWholeProcEntry(entry.fd, buffer);
+        if (len >= 0) {
+            entry.sample = gProcSample;
+            return len;
+        }
+        // The process is gone, its pid may have been reused since.
+        close(entry.fd);
+        gProcEntryFds.removeItemsAt(index);
+    }
+
+    int fd = openat(dirFd, path.string(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t len = readWholeProcEntry(fd, buffer);
+    if (len >= 0 && gProcEntryFds.size() < kMaxProcEntryFds) {
+        ProcEntryFd entry = { fd, gProcSample };
+        gProcEntryFds.add(key, entry);
+    } else {
+        close(fd);
+    }
+    return len;
+}
+
+// Closes the entries of dir the current sample didn't read, leaving those of
+// the other directories, like the task directories under /proc/<pid>.
+// Must be called with gProcEntryFdsLock held.
+static void pruneProcEntryFds(const String8& dir)
+{
+    String8 prefix(dir);
+    if (prefix.isEmpty() || prefix.string()[prefix.length() - 1] != '/') {
+        prefix.append("/");
+    }
+    for (size_t i = gProcEntryFds.size(); i > 0; i--) {
+        const ProcEntryFd& entry = gProcEntryFds.valueAt(i - 1);
+        const char* key = gProcEntryFds.keyAt(i - 1).string();
+        if (entry.sample != gProcSample
+                && strncmp(key, prefix.string(), prefix.length()) == 0
+                && strchr(key + prefix.length(), '/') == strrchr(key, '/')) {
+            close(entry.fd);
+            gProcEntryFds.removeItemsAt(i - 1);
+        }
+    }
+}
+
+/*
+ * Samples stat, and status when asked to, for every pid under procDir
+ * ("/proc" or "/proc/<pid>/task") into PROC_SAMPLE_FIELD_COUNT longs per
+ * pid, sorted by pid.  This replaces a getPids() and readProcFile() pass per
+ * pid with one call that reuses its buffers, and keeps the entries open for
+ * the next call.  Returns the number of records, or minus the number of
+ * records needed when outRecords is too small.
+ */
+jint android_os_Process_sampleProcStats(JNIEnv* env, jobject clazz, jstring procDir,
+        jboolean readStatus, jlongArray outRecords)
+{
+    if (procDir == NULL || outRecords == NULL) {
+        jniThrowNullPointerException(env, NULL);
+        return 0;
+    }
+
+    const char* dir8 = env->GetStringUTFChars(procDir, NULL);
+    if (dir8 == NULL) {
+        jniThrowException(env, "java/lang/OutOfMemoryError", NULL);
+        return 0;
+    }
+    const String8 dir(dir8);
+    env->ReleaseStringUTFChars(procDir, dir8);
+    DIR* dirp = opendir(dir.string());
+    if (dirp == NULL) {
+        return 0;
+    }
+
+    const jsize capacity = env->GetArrayLength(outRecords) / PROC_SAMPLE_FIELD_COUNT;
+    Vector<jlong> records;
+    Vector<char> buffer;
+    buffer.resize(2048);
+    jint count = 0;
+
+    AutoMutex _l(gProcEntryFdsLock);
+    gProcSample++;
+
+    struct dirent* entry;
+    while ((entry = readdir(dirp)) != NULL) {
+        const char* p = entry->d_name;
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p != 0 || p == entry->d_name) continue;
+
+        jlong record[PROC_SAMPLE_FIELD_COUNT];
+        memset(record, 0, sizeof(record));
+        record[PROC_SAMPLE_PID] = strtol(entry->d_name, NULL, 10);
+        record[PROC_SAMPLE_VM_SWAP] = -1;
+        record[PROC_SAMPLE_UID] = -1;
+
+        // The process may be gone by now, skip it then.
+        if (readProcEntry(dir, dirfd(dirp), entry->d_name, "stat", buffer) < 0
+                || !parseProcStat(buffer.editArray(), record)) {
+            continue;
+        }
+        if (readStatus
+                && readProcEntry(dir, dirfd(dirp), entry->d_name, "status", buffer) >= 0) {
+            parseProcStatus(buffer.array(), record);
+        }
+
+        // Keep the records sorted by pid, readdir() order is close to it already.
+        size_t pos = count;
+        while (pos > 0 && records[(pos - 1) * PROC_SAMPLE_FIELD_COUNT] > record[PROC_SAMPLE_PID]) {
+            pos--;
+        }
+        records.insertArrayAt(record, pos * PROC_SAMPLE_FIELD_COUNT, PROC_SAMPLE_FIELD_COUNT);
+        count++;
+    }
+    closedir(dirp);
+    pruneProcEntryFds(dir);
+
+    if (count > capacity) {
+        return -count;
+    }
+    env->SetLongArrayRegion(outRecords, 0, count * PROC_SAMPLE_FIELD_COUNT, records.array());
+    return count;
+}
+
 enum {
     PROC_TERM_MASK = 0xff,
     PROC_ZERO_TERM = 0,
@@ -1073,7 +1313,13 @@ static const JNINativeMethod methods[] = {
     {"removeAllProcessGroups", "()V", (void*)android_os_Process_removeAllProcessGroups},
 };
 
+// Natives whose Java declarations may not be present.
+static const JNINativeMethod optionalMethods[] = {
+    {"sampleProcStats", "(Ljava/lang/String;Z[J)I", (void*)android_os_Process_sampleProcStats},
+};
+
 int register_android_os_Process(JNIEnv* env)
 {
+    RegisterOptionalMethods(env, "android/os/Process", optionalMethods, NELEM(optionalMethods));
     return RegisterMethodsOrDie(env, "android/os/Process", methods, NELEM(methods));
 }
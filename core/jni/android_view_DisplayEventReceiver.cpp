@@ -20,6 +20,7 @@
 
 #include "JNIHelp.h"
 
+#include <algorithm>
 #include <inttypes.h>
 
 #include <android_runtime/AndroidRuntime.h>
@@ -40,6 +41,13 @@ namespace android {
 // using just a few large reads.
 static const size_t EVENT_BUFFER_SIZE = 100;
 
+// Gaps between vsync events longer than this many periods, for example while
+// no vsync was requested, are not used to refine the period estimate.
+static const nsecs_t MAX_VSYNC_PERIODS_PER_SAMPLE = 4;
+
+// The number of recent gaps between vsync events the period is estimated from
+static const size_t VSYNC_PERIOD_SAMPLES = 16;
+
 static struct {
     jclass clazz;
 
@@ -57,6 +65,12 @@ public:
     void dispose();
     status_t scheduleVsync();
 
+    // The vsync period estimated from the vsync events received so far, or 0
+    // if there have not been enough yet.
+    nsecs_t getVsyncPeriod() const { return mVsyncPeriod; }
+    // The predicted timestamp of the first vsync after now, or 0 if unknown.
+    nsecs_t predictNextVsync(nsecs_t now) const;
+
 protected:
     virtual ~NativeDisplayEventReceiver();
 
@@ -65,8 +79,15 @@ private:
     sp<MessageQueue> mMessageQueue;
     DisplayEventReceiver mReceiver;
     bool mWaitingForVsync;
+    nsecs_t mLastVsyncTimestamp;
+    nsecs_t mVsyncPeriod;
+    // Ring of the last gaps between vsync events
+    nsecs_t mVsyncDeltas[VSYNC_PERIOD_SAMPLES];
+    size_t mVsyncDeltaCount;
+    size_t mNextVsyncDelta;
 
     virtual int handleEvent(int receiveFd, int events, void* data);
+    void updateVsyncPeriod(nsecs_t timestamp);
     bool processPendingEvents(nsecs_t* outTimestamp, int32_t* id, uint32_t* outCount);
     void dispatchVsync(nsecs_t timestamp, int32_t id, uint32_t count);
     void dispatchHotplug(nsecs_t timestamp, int32_t id, bool connected);
@@ -76,7 +97,8 @@ private:
 NativeDisplayEventReceiver::NativeDisplayEventReceiver(JNIEnv* env,
         jobject receiverWeak, const sp<MessageQueue>& messageQueue) :
         mReceiverWeakGlobal(env->NewGlobalRef(receiverWeak)),
-        mMessageQueue(messageQueue), mWaitingForVsync(false) {
+        mMessageQueue(messageQueue), mWaitingForVsync(false),
+        mLastVsyncTimestamp(0), mVsyncPeriod(0), mVsyncDeltaCount(0), mNextVsyncDelta(0) {
     ALOGV("receiver %p ~ Initializing display event receiver.", this);
 }
 
@@ -170,6 +192,7 @@ bool NativeDisplayEventReceiver::processPendingEvents(
                 // Later vsync events will just overwrite the info from earlier
                 // ones. That's fine, we only care about the most recent.
                 gotVsync = true;
+                updateVsyncPeriod(ev.header.timestamp);
                 *outTimestamp = ev.header.timestamp;
                 *outId = ev.header.id;
                 *outCount = ev.vsync.count;
@@ -189,6 +212,47 @@ bool NativeDisplayEventReceiver::processPendingEvents(
     return gotVsync;
 }
 
+void NativeDisplayEventReceiver::updateVsyncPeriod(nsecs_t timestamp) {
+    if (mLastVsyncTimestamp > 0 && timestamp > mLastVsyncTimestamp) {
+        const nsecs_t delta = timestamp - mLastVsyncTimestamp;
+        if (!mVsyncPeriod || delta <= mVsyncPeriod * MAX_VSYNC_PERIODS_PER_SAMPLE) {
+            mVsyncDeltas[mNextVsyncDelta] = delta;
+            mNextVsyncDelta = (mNextVsyncDelta + 1) % VSYNC_PERIOD_SAMPLES;
+            if (mVsyncDeltaCount < VSYNC_PERIOD_SAMPLES) {
+                mVsyncDeltaCount++;
+            }
+
+            // Vsyncs that nobody asked for are not sent, so a delta may span
+            // several periods, and averaging them would drift towards 2T when
+            // every other vsync is skipped. The shortest delta is one period;
+            // the median of the deltas close to it smooths out its jitter.
+            const nsecs_t shortest = *std::min_element(mVsyncDeltas,
+                    mVsyncDeltas + mVsyncDeltaCount);
+            nsecs_t single[VSYNC_PERIOD_SAMPLES];
+            size_t count = 0;
+            for (size_t i = 0; i < mVsyncDeltaCount; i++) {
+                if (mVsyncDeltas[i] < shortest + shortest / 2) {
+                    single[count++] = mVsyncDeltas[i];
+                }
+            }
+            std::nth_element(single, single + count / 2, single + count);
+            mVsyncPeriod = single[count / 2];
+        }
+    }
+    mLastVsyncTimestamp = timestamp;
+}
+
+nsecs_t NativeDisplayEventReceiver::predictNextVsync(nsecs_t now) const {
+    if (!mVsyncPeriod) {
+        return 0;
+    }
+    nsecs_t next = mLastVsyncTimestamp + mVsyncPeriod;
+    if (next <= now) {
+        next += ((now - next) / mVsyncPeriod + 1) * mVsyncPeriod;
+    }
+    return next;
+}
+
 void NativeDisplayEventReceiver::dispatchVsync(nsecs_t timestamp, int32_t id, uint32_t count) {
     JNIEnv* env = AndroidRuntime::getJNIEnv();
 
@@ -258,6 +322,18 @@ static void nativeScheduleVsync(JNIEnv* env, jclass clazz, jlong receiverPtr) {
     }
 }
 
+static jlong nativeGetVsyncPeriod(JNIEnv* env, jclass clazz, jlong receiverPtr) {
+    NativeDisplayEventReceiver* receiver =
+            reinterpret_cast<NativeDisplayEventReceiver*>(receiverPtr);
+    return receiver->getVsyncPeriod();
+}
+
+static jlong nativeGetPredictedVsyncTime(JNIEnv* env, jclass clazz, jlong receiverPtr) {
+    NativeDisplayEventReceiver* receiver =
+            reinterpret_cast<NativeDisplayEventReceiver*>(receiverPtr);
+    return receiver->predictNextVsync(systemTime(SYSTEM_TIME_MONOTONIC));
+}
+
 
 static JNINativeMethod gMethods[] = {
     /* name, signature, funcPtr */
@@ -271,9 +347,19 @@ static JNINativeMethod gMethods[] = {
             (void*)nativeScheduleVsync }
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "nativeGetVsyncPeriod", "(J)J",
+            (void*)nativeGetVsyncPeriod },
+    { "nativeGetPredictedVsyncTime", "(J)J",
+            (void*)nativeGetPredictedVsyncTime }
+};
+
 int register_android_view_DisplayEventReceiver(JNIEnv* env) {
     int res = RegisterMethodsOrDie(env, "android/view/DisplayEventReceiver", gMethods,
                                    NELEM(gMethods));
+    RegisterOptionalMethods(env, "android/view/DisplayEventReceiver", gOptionalMethods,
+                            NELEM(gOptionalMethods));
 
     jclass clazz = FindClassOrDie(env, "android/view/DisplayEventReceiver");
     gDisplayEventReceiverClassInfo.clazz = MakeGlobalRefOrDie(env, clazz);
@@ -39,6 +39,10 @@ namespace android {
 
 static const bool kDebugDispatchCycle = false;
 
+// The number of events that latency tracking keeps, both for events that are
+// still being handled and for finished ones that haven't been collected.
+static const size_t kMaxLatencyRecords = 64;
+
 static struct {
     jclass clazz;
 
@@ -58,6 +62,9 @@ public:
     status_t finishInputEvent(uint32_t seq, bool handled);
     status_t consumeEvents(JNIEnv* env, bool consumeBatches, nsecs_t frameTime,
             bool* outConsumedBatch);
+    void setResamplePrediction(nsecs_t prediction);
+    void setLatencyTrackingEnabled(bool enabled);
+    size_t takeLatencyRecords(jlong* outValues, size_t maxRecords);
 
 protected:
     virtual ~NativeInputEventReceiver();
@@ -68,15 +75,35 @@ private:
         bool handled;
     };
 
+    // The timestamps of one input event on its way through the app.
+    struct LatencyRecord {
+        uint32_t seq;
+        nsecs_t eventTime;      // when the newest sample was read from the kernel
+        nsecs_t receiveTime;    // when it was consumed from the input channel
+        nsecs_t finishTime;     // when the app finished it
+    };
+
     jobject mReceiverWeakGlobal;
     InputConsumer mInputConsumer;
     sp<MessageQueue> mMessageQueue;
     PreallocatedInputEventFactory mInputEventFactory;
     bool mBatchedInputEventPending;
     int mFdEvents;
+    nsecs_t mResamplePrediction;
     Vector<Finish> mFinishQueue;
 
+    // Latency tracking, off by default. Events that are dispatched to Java
+    // wait in mPendingLatency until they are finished, then the finished
+    // records stay in the mLatency ring until takeLatencyRecords().
+    bool mLatencyTrackingEnabled;
+    Vector<LatencyRecord> mPendingLatency;
+    LatencyRecord mLatency[kMaxLatencyRecords];
+    size_t mLatencyStart;
+    size_t mLatencyCount;
+
     void setFdEvents(int events);
+    void recordReceived(uint32_t seq, const InputEvent* inputEvent);
+    void recordFinished(uint32_t seq);
 
     const char* getInputChannelName() {
         return mInputConsumer.getChannel()->getName().string();
@@ -91,7 +118,8 @@ NativeInputEventReceiver::NativeInputEventReceiver(JNIEnv* env,
         const sp<MessageQueue>& messageQueue) :
         mReceiverWeakGlobal(env->NewGlobalRef(receiverWeak)),
         mInputConsumer(inputChannel), mMessageQueue(messageQueue),
-        mBatchedInputEventPending(false), mFdEvents(0) {
+        mBatchedInputEventPending(false), mFdEvents(0), mResamplePrediction(0),
+        mLatencyTrackingEnabled(false), mLatencyStart(0), mLatencyCount(0) {
     if (kDebugDispatchCycle) {
         ALOGD("channel '%s' ~ Initializing input event receiver.", getInputChannelName());
     }
@@ -115,11 +143,77 @@ void NativeInputEventReceiver::dispose() {
     setFdEvents(0);
 }
 
+void NativeInputEventReceiver::setResamplePrediction(nsecs_t prediction) {
+    mResamplePrediction = prediction > 0 ? prediction : 0;
+}
+
+void NativeInputEventReceiver::setLatencyTrackingEnabled(bool enabled) {
+    mLatencyTrackingEnabled = enabled;
+    if (!enabled) {
+        mPendingLatency.clear();
+        mLatencyStart = 0;
+        mLatencyCount = 0;
+    }
+}
+
+void NativeInputEventReceiver::recordReceived(uint32_t seq, const InputEvent* inputEvent) {
+    if (mPendingLatency.size() >= kMaxLatencyRecords) {
+        // The app is holding on to events without finishing them.
+        mPendingLatency.removeAt(0);
+    }
+    LatencyRecord record;
+    record.seq = seq;
+    record.eventTime = inputEvent->getType() == AINPUT_EVENT_TYPE_KEY
+            ? static_cast<const KeyEvent*>(inputEvent)->getEventTime()
+            : static_cast<const MotionEvent*>(inputEvent)->getEventTime();
+    record.receiveTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    record.finishTime = 0;
+    mPendingLatency.push(record);
+}
+
+void NativeInputEventReceiver::recordFinished(uint32_t seq) {
+    for (size_t i = 0; i < mPendingLatency.size(); i++) {
+        if (mPendingLatency[i].seq != seq) {
+            continue;
+        }
+        LatencyRecord record = mPendingLatency[i];
+        mPendingLatency.removeAt(i);
+        record.finishTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
+        // Overwrite the oldest finished record when nobody collects them.
+        if (mLatencyCount == kMaxLatencyRecords) {
+            mLatencyStart = (mLatencyStart + 1) % kMaxLatencyRecords;
+            mLatencyCount--;
+        }
+        mLatency[(mLatencyStart + mLatencyCount) % kMaxLatencyRecords] = record;
+        mLatencyCount++;
+        return;
+    }
+}
+
+size_t NativeInputEventReceiver::takeLatencyRecords(jlong* outValues, size_t maxRecords) {
+    size_t count = mLatencyCount < maxRecords ? mLatencyCount : maxRecords;
+    for (size_t i = 0; i < count; i++) {
+        const LatencyRecord& record = mLatency[(mLatencyStart + i) % kMaxLatencyRecords];
+        *outValues++ = record.seq;
+        *outValues++ = record.eventTime;
+        *outValues++ = record.receiveTime;
+        *outValues++ = record.finishTime;
+    }
+    mLatencyStart = (mLatencyStart + count) % kMaxLatencyRecords;
+    mLatencyCount -= count;
+    return count;
+}
+
 status_t NativeInputEventReceiver::finishInputEvent(uint32_t seq, bool handled) {
     if (kDebugDispatchCycle) {
         ALOGD("channel '%s' ~ Finished input event.", getInputChannelName());
     }
 
+    if (mLatencyTrackingEnabled) {
+        recordFinished(seq);
+    }
+
     status_t status = mInputConsumer.sendFinishedSignal(seq, handled);
     if (status) {
         if (status == WOULD_BLOCK) {
@@ -228,13 +322,18 @@ status_t NativeInputEventReceiver::consumeEvents(JNIEnv* env,
         *outConsumedBatch = false;
     }
 
+    // Batching up to a later time makes the InputConsumer take the samples
+    // that arrived since vsync, and extrapolate the batch (within its own
+    // limits) towards when the frame is expected to be presented.
+    const nsecs_t sampleTime = frameTime >= 0 ? frameTime + mResamplePrediction : frameTime;
+
     ScopedLocalRef<jobject> receiverObj(env, NULL);
     bool skipCallbacks = false;
     for (;;) {
         uint32_t seq;
         InputEvent* inputEvent;
         status_t status = mInputConsumer.consume(&mInputEventFactory,
-                consumeBatches, frameTime, &seq, &inputEvent);
+                consumeBatches, sampleTime, &seq, &inputEvent);
         if (status) {
             if (status == WOULD_BLOCK) {
                 if (!skipCallbacks && !mBatchedInputEventPending
@@ -310,6 +409,9 @@ status_t NativeInputEventReceiver::consumeEvents(JNIEnv* env,
                 if (kDebugDispatchCycle) {
                     ALOGD("channel '%s' ~ Dispatching input event.", getInputChannelName());
                 }
+                if (mLatencyTrackingEnabled) {
+                    recordReceived(seq, inputEvent);
+                }
                 env->CallVoidMethod(receiverObj.get(),
                         gInputEventReceiverClassInfo.dispatchInputEvent, seq, inputEventObj);
                 if (env->ExceptionCheck()) {
@@ -394,6 +496,38 @@ static jboolean nativeConsumeBatchedInputEvents(JNIEnv* env, jclass clazz, jlong
     return consumedBatch ? JNI_TRUE : JNI_FALSE;
 }
 
+static void nativeSetResamplePrediction(JNIEnv* env, jclass clazz, jlong receiverPtr,
+        jlong predictionNanos) {
+    sp<NativeInputEventReceiver> receiver =
+            reinterpret_cast<NativeInputEventReceiver*>(receiverPtr);
+    receiver->setResamplePrediction(predictionNanos);
+}
+
+static void nativeSetLatencyTrackingEnabled(JNIEnv* env, jclass clazz, jlong receiverPtr,
+        jboolean enabled) {
+    sp<NativeInputEventReceiver> receiver =
+            reinterpret_cast<NativeInputEventReceiver*>(receiverPtr);
+    receiver->setLatencyTrackingEnabled(enabled);
+}
+
+// Fills outValues with (seq, event time, receive time, finish time) for each
+// finished event, oldest first, and returns the number of events.
+static jint nativeTakeLatencyRecords(JNIEnv* env, jclass clazz, jlong receiverPtr,
+        jlongArray outValuesArray) {
+    sp<NativeInputEventReceiver> receiver =
+            reinterpret_cast<NativeInputEventReceiver*>(receiverPtr);
+    if (!outValuesArray) {
+        jniThrowNullPointerException(env, NULL);
+        return 0;
+    }
+    jlong values[kMaxLatencyRecords * 4];
+    size_t maxRecords = size_t(env->GetArrayLength(outValuesArray)) / 4;
+    size_t count = receiver->takeLatencyRecords(values,
+            maxRecords < kMaxLatencyRecords ? maxRecords : kMaxLatencyRecords);
+    env->SetLongArrayRegion(outValuesArray, 0, count * 4, values);
+    return jint(count);
+}
+
 
 static JNINativeMethod gMethods[] = {
     /* name, signature, funcPtr */
@@ -408,9 +542,21 @@ static JNINativeMethod gMethods[] = {
             (void*)nativeConsumeBatchedInputEvents },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "nativeSetResamplePrediction", "(JJ)V",
+            (void*)nativeSetResamplePrediction },
+    { "nativeSetLatencyTrackingEnabled", "(JZ)V",
+            (void*)nativeSetLatencyTrackingEnabled },
+    { "nativeTakeLatencyRecords", "(J[J)I",
+            (void*)nativeTakeLatencyRecords },
+};
+
 int register_android_view_InputEventReceiver(JNIEnv* env) {
     int res = RegisterMethodsOrDie(env, "android/view/InputEventReceiver",
             gMethods, NELEM(gMethods));
+    RegisterOptionalMethods(env, "android/view/InputEventReceiver",
+            gOptionalMethods, NELEM(gOptionalMethods));
 
     jclass clazz = FindClassOrDie(env, "android/view/InputEventReceiver");
     gInputEventReceiverClassInfo.clazz = MakeGlobalRefOrDie(env, clazz);
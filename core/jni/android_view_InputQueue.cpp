@@ -39,6 +39,8 @@ namespace android {
 
 static struct {
     jmethodID finishInputEvent;
+    // Optional, NULL if the Java class has no such method.
+    jmethodID finishInputEvents;
 } gInputQueueClassInfo;
 
 enum {
@@ -141,25 +143,65 @@ void InputQueue::handleMessage(const Message& message) {
             return;
         }
         while (true) {
-            InputEvent* event;
-            bool handled;
+            Vector<key_value_pair_t<InputEvent*, bool> > finishedEvents;
             {
                 Mutex::Autolock _l(mLock);
                 if (mFinishedEvents.isEmpty()) {
                     break;
                 }
-                event = mFinishedEvents[0].getKey();
-                handled = mFinishedEvents[0].getValue();
-                mFinishedEvents.removeAt(0);
+                finishedEvents = mFinishedEvents;
+                mFinishedEvents.clear();
             }
-            env->CallVoidMethod(inputQueueObj.get(), gInputQueueClassInfo.finishInputEvent,
-                    reinterpret_cast<jlong>(event), handled);
-            recycleInputEvent(event);
+            finishEvents(env, inputQueueObj.get(), finishedEvents);
         }
         break;
     }
 }
 
+void InputQueue::finishEvents(JNIEnv* env, jobject inputQueueObj,
+        const Vector<key_value_pair_t<InputEvent*, bool> >& events) {
+    const size_t count = events.size();
+    if (count > 1 && gInputQueueClassInfo.finishInputEvents) {
+        // A game draining a fast gamepad or touch stream finishes many events
+        // per message, so tell Java about all of them in a single call.
+        jlongArray eventsArray = env->NewLongArray(count);
+        jbooleanArray handledArray = env->NewBooleanArray(count);
+        if (eventsArray && handledArray) {
+            jlong* eventPtrs = env->GetLongArrayElements(eventsArray, NULL);
+            jboolean* handled = env->GetBooleanArrayElements(handledArray, NULL);
+            for (size_t i = 0; i < count; i++) {
+                eventPtrs[i] = reinterpret_cast<jlong>(events[i].getKey());
+                handled[i] = events[i].getValue();
+            }
+            env->ReleaseLongArrayElements(eventsArray, eventPtrs, 0);
+            env->ReleaseBooleanArrayElements(handledArray, handled, 0);
+            env->CallVoidMethod(inputQueueObj, gInputQueueClassInfo.finishInputEvents,
+                    eventsArray, handledArray);
+            env->DeleteLocalRef(eventsArray);
+            env->DeleteLocalRef(handledArray);
+            for (size_t i = 0; i < count; i++) {
+                recycleInputEvent(events[i].getKey());
+            }
+            return;
+        }
+        // Out of memory, clear the exception and fall back to one call per event.
+        env->ExceptionClear();
+        if (eventsArray) {
+            env->DeleteLocalRef(eventsArray);
+        }
+        if (handledArray) {
+            env->DeleteLocalRef(handledArray);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        InputEvent* event = events[i].getKey();
+        env->CallVoidMethod(inputQueueObj, gInputQueueClassInfo.finishInputEvent,
+                reinterpret_cast<jlong>(event), events[i].getValue());
+        recycleInputEvent(event);
+    }
+}
+
 void InputQueue::recycleInputEvent(InputEvent* event) {
     mPooledInputEventFactory.recycle(event);
 }
@@ -263,6 +305,11 @@ int register_android_view_InputQueue(JNIEnv* env)
     jclass clazz = FindClassOrDie(env, kInputQueuePathName);
     gInputQueueClassInfo.finishInputEvent = GetMethodIDOrDie(env, clazz, "finishInputEvent",
                                                              "(JZ)V");
+    gInputQueueClassInfo.finishInputEvents = env->GetMethodID(clazz, "finishInputEvents",
+                                                              "([J[Z)V");
+    if (!gInputQueueClassInfo.finishInputEvents) {
+        env->ExceptionClear();
+    }
 
     return RegisterMethodsOrDie(env, kInputQueuePathName, g_methods, NELEM(g_methods));
 }
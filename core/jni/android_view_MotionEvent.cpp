@@ -23,6 +23,7 @@
 #include <android_runtime/Log.h>
 #include <utils/Log.h>
 #include <input/Input.h>
+#include <ScopedPrimitiveArray.h>
 #include <ScopedUtfChars.h>
 #include "android_os_Parcel.h"
 #include "android_view_MotionEvent.h"
@@ -671,6 +672,78 @@ static void android_view_MotionEvent_nativeGetPointerCoords(JNIEnv* env, jclass
             outPointerCoordsObj);
 }
 
+/**
+ * Copies the given axes of every pointer of every sample, oldest history sample
+ * first and the current sample last, into outValues, laid out as
+ * outValues[(sample * pointerCount + pointerIndex) * axisCount + axisIndex].
+ * The sample times are copied into outTimesNanos if it isn't null. Returns the
+ * number of samples copied.
+ */
+static jint android_view_MotionEvent_nativeGetHistoricalData(JNIEnv* env, jclass clazz,
+        jlong nativePtr, jintArray axesArray, jfloatArray outValuesArray,
+        jlongArray outTimesNanosArray) {
+    MotionEvent* event = reinterpret_cast<MotionEvent*>(nativePtr);
+    if (!axesArray || !outValuesArray) {
+        jniThrowNullPointerException(env, NULL);
+        return 0;
+    }
+
+    const size_t pointerCount = event->getPointerCount();
+    const size_t historySize = event->getHistorySize();
+    const size_t sampleCount = historySize + 1;
+    ScopedIntArrayRO axes(env, axesArray);
+    const size_t axisCount = axes.size();
+    const size_t valueCount = sampleCount * pointerCount * axisCount;
+    if (size_t(env->GetArrayLength(outValuesArray)) < valueCount) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                "outValues array must be large enough to hold all samples");
+        return 0;
+    }
+    if (outTimesNanosArray
+            && size_t(env->GetArrayLength(outTimesNanosArray)) < sampleCount) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                "outTimesNanos array must be large enough to hold all samples");
+        return 0;
+    }
+
+    ScopedFloatArrayRW outValues(env, outValuesArray);
+    if (outValues.get() == NULL) {
+        return 0; // OOME was thrown
+    }
+    const float xOffset = event->getXOffset();
+    const float yOffset = event->getYOffset();
+    jfloat* out = outValues.get();
+    // The current sample is stored right after the history, so a single
+    // historical index covers both.
+    for (size_t h = 0; h < sampleCount; h++) {
+        for (size_t i = 0; i < pointerCount; i++) {
+            const PointerCoords* coords = event->getHistoricalRawPointerCoords(i, h);
+            for (size_t a = 0; a < axisCount; a++) {
+                const int32_t axis = axes[a];
+                float value = coords->getAxisValue(axis);
+                if (axis == AMOTION_EVENT_AXIS_X) {
+                    value += xOffset;
+                } else if (axis == AMOTION_EVENT_AXIS_Y) {
+                    value += yOffset;
+                }
+                *out++ = value;
+            }
+        }
+    }
+
+    if (outTimesNanosArray) {
+        ScopedLongArrayRW outTimesNanos(env, outTimesNanosArray);
+        if (outTimesNanos.get() == NULL) {
+            return 0; // OOME was thrown
+        }
+        for (size_t h = 0; h < historySize; h++) {
+            outTimesNanos[h] = event->getHistoricalEventTime(h);
+        }
+        outTimesNanos[historySize] = event->getEventTime();
+    }
+    return jint(sampleCount);
+}
+
 static void android_view_MotionEvent_nativeGetPointerProperties(JNIEnv* env, jclass clazz,
         jlong nativePtr, jint pointerIndex, jobject outPointerPropertiesObj) {
     MotionEvent* event = reinterpret_cast<MotionEvent*>(nativePtr);
@@ -881,9 +954,18 @@ static JNINativeMethod gMotionEventMethods[] = {
             (void*)android_view_MotionEvent_nativeAxisFromString },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gMotionEventOptionalMethods[] = {
+    { "nativeGetHistoricalData",
+            "(J[I[F[J)I",
+            (void*)android_view_MotionEvent_nativeGetHistoricalData },
+};
+
 int register_android_view_MotionEvent(JNIEnv* env) {
     int res = RegisterMethodsOrDie(env, "android/view/MotionEvent", gMotionEventMethods,
                                    NELEM(gMotionEventMethods));
+    RegisterOptionalMethods(env, "android/view/MotionEvent", gMotionEventOptionalMethods,
+                            NELEM(gMotionEventOptionalMethods));
 
     gMotionEventClassInfo.clazz = FindClassOrDie(env, "android/view/MotionEvent");
     gMotionEventClassInfo.clazz = MakeGlobalRefOrDie(env, gMotionEventClassInfo.clazz);
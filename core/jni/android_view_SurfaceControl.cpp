@@ -41,6 +41,7 @@
 
 #include <utils/Log.h>
 
+#include <ScopedPrimitiveArray.h>
 #include <ScopedUtfChars.h>
 
 #include "SkTemplates.h"
@@ -316,6 +317,110 @@ static void nativeSetLayerStack(JNIEnv* env, jclass clazz, jlong nativeObject, j
     }
 }
 
+// Operations and flags of nativeApplyBatch.
+// Must be kept in sync with the constants in SurfaceControl.java.
+enum {
+    BATCH_OP_LAYER = 0,         // 1 int
+    BATCH_OP_POSITION = 1,      // 2 floats
+    BATCH_OP_SIZE = 2,          // 2 ints
+    BATCH_OP_FLAGS = 3,         // 2 ints: flags, mask
+    BATCH_OP_ALPHA = 4,         // 1 float
+    BATCH_OP_MATRIX = 5,        // 4 floats
+    BATCH_OP_WINDOW_CROP = 6,   // 4 ints
+    BATCH_OP_LAYER_STACK = 7,   // 1 int
+    BATCH_OP_COUNT
+};
+
+enum {
+    BATCH_FLAG_OPEN_TRANSACTION = 1 << 0,
+    BATCH_FLAG_ANIMATION = 1 << 1,
+};
+
+static const uint8_t kBatchOpInts[BATCH_OP_COUNT] = { 1, 0, 2, 2, 0, 0, 4, 1 };
+static const uint8_t kBatchOpFloats[BATCH_OP_COUNT] = { 0, 2, 0, 0, 1, 4, 0, 0 };
+
+static status_t applyBatchOp(SurfaceControl* ctrl, jint op, const jint* i, const jfloat* f) {
+    switch (op) {
+        case BATCH_OP_LAYER:
+            return ctrl->setLayer(i[0]);
+        case BATCH_OP_POSITION:
+            return ctrl->setPosition(f[0], f[1]);
+        case BATCH_OP_SIZE:
+            return ctrl->setSize(i[0], i[1]);
+        case BATCH_OP_FLAGS:
+            return ctrl->setFlags(i[0], i[1]);
+        case BATCH_OP_ALPHA:
+            return ctrl->setAlpha(f[0]);
+        case BATCH_OP_MATRIX:
+            return ctrl->setMatrix(f[0], f[1], f[2], f[3]);
+        case BATCH_OP_WINDOW_CROP:
+            return ctrl->setCrop(Rect(i[0], i[1], i[2], i[3]));
+        case BATCH_OP_LAYER_STACK:
+            return ctrl->setLayerStack(i[0]);
+    }
+    return BAD_VALUE;
+}
+
+/*
+ * Applies ops[k] to the surface surfaces[k] for every k, taking the arguments of each op
+ * in order from intArgs and floatArgs, so a frame of window animation updates costs one
+ * JNI call.  With BATCH_FLAG_OPEN_TRANSACTION the updates get a global transaction of
+ * their own, otherwise they join the one the caller has open.  Stops at the first
+ * failing update with an IllegalArgumentException, like the single setters.
+ */
+static void nativeApplyBatch(JNIEnv* env, jclass clazz, jint flags, jlongArray surfacesArray,
+        jintArray opsArray, jintArray intArgsArray, jfloatArray floatArgsArray) {
+    const jsize count = env->GetArrayLength(opsArray);
+    if (env->GetArrayLength(surfacesArray) < count) {
+        doThrowIAE(env);
+        return;
+    }
+    ScopedLongArrayRO surfaces(env, surfacesArray);
+    ScopedIntArrayRO ops(env, opsArray);
+
+    size_t intCount = 0;
+    size_t floatCount = 0;
+    for (jsize k = 0; k < count; k++) {
+        if (ops[k] < 0 || ops[k] >= BATCH_OP_COUNT || surfaces[k] == 0) {
+            doThrowIAE(env);
+            return;
+        }
+        intCount += kBatchOpInts[ops[k]];
+        floatCount += kBatchOpFloats[ops[k]];
+    }
+    if (size_t(env->GetArrayLength(intArgsArray)) < intCount
+            || size_t(env->GetArrayLength(floatArgsArray)) < floatCount) {
+        doThrowIAE(env);
+        return;
+    }
+    ScopedIntArrayRO intArgs(env, intArgsArray);
+    ScopedFloatArrayRO floatArgs(env, floatArgsArray);
+
+    if (flags & BATCH_FLAG_OPEN_TRANSACTION) {
+        SurfaceComposerClient::openGlobalTransaction();
+    }
+    if (flags & BATCH_FLAG_ANIMATION) {
+        SurfaceComposerClient::setAnimationTransaction();
+    }
+
+    const jint* i = intArgs.get();
+    const jfloat* f = floatArgs.get();
+    for (jsize k = 0; k < count; k++) {
+        SurfaceControl* const ctrl = reinterpret_cast<SurfaceControl *>(surfaces[k]);
+        status_t err = applyBatchOp(ctrl, ops[k], i, f);
+        if (err < 0 && err != NO_INIT) {
+            doThrowIAE(env);
+            break;
+        }
+        i += kBatchOpInts[ops[k]];
+        f += kBatchOpFloats[ops[k]];
+    }
+
+    if (flags & BATCH_FLAG_OPEN_TRANSACTION) {
+        SurfaceComposerClient::closeGlobalTransaction();
+    }
+}
+
 static jobject nativeGetBuiltInDisplay(JNIEnv* env, jclass clazz, jint id) {
     sp<IBinder> token(SurfaceComposerClient::getBuiltInDisplay(id));
     return javaObjectForIBinder(env, token);
@@ -646,10 +751,18 @@ static JNINativeMethod sSurfaceControlMethods[] = {
             (void*)nativeSetDisplayPowerMode },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod sSurfaceControlOptionalMethods[] = {
+    {"nativeApplyBatch", "(I[J[I[I[F)V",
+            (void*)nativeApplyBatch },
+};
+
 int register_android_view_SurfaceControl(JNIEnv* env)
 {
     int err = RegisterMethodsOrDie(env, "android/view/SurfaceControl",
             sSurfaceControlMethods, NELEM(sSurfaceControlMethods));
+    RegisterOptionalMethods(env, "android/view/SurfaceControl",
+            sSurfaceControlOptionalMethods, NELEM(sSurfaceControlOptionalMethods));
 
     jclass clazz = FindClassOrDie(env, "android/view/SurfaceControl$PhysicalDisplayInfo");
     gPhysicalDisplayInfoClassInfo.clazz = MakeGlobalRefOrDie(env, clazz);
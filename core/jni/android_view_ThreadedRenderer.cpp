@@ -22,6 +22,7 @@
 #include <nativehelper/JNIHelp.h>
 #include "core_jni_helpers.h"
 #include <GraphicsJNI.h>
+#include <BitmapFactory.h>
 #include <ScopedPrimitiveArray.h>
 
 #include <EGL/egl.h>
@@ -38,6 +39,7 @@
 #include <AnimationContext.h>
 #include <IContextFactory.h>
 #include <JankTracker.h>
+#include <ProgramCache.h>
 #include <RenderNode.h>
 #include <renderthread/CanvasContext.h>
 #include <renderthread/RenderProxy.h>
@@ -389,6 +391,11 @@ static void android_view_ThreadedRenderer_destroyHardwareResources(JNIEnv* env,
 static void android_view_ThreadedRenderer_trimMemory(JNIEnv* env, jobject clazz,
         jint level) {
     RenderProxy::trimMemory(level);
+    trimDecodeScratchMemory();
+}
+
+static void android_view_ThreadedRenderer_preload(JNIEnv* env, jobject clazz) {
+    RenderProxy::preload();
 }
 
 static void android_view_ThreadedRenderer_overrideProperty(JNIEnv* env, jobject clazz,
@@ -425,6 +432,13 @@ static void android_view_ThreadedRenderer_dumpProfileInfo(JNIEnv* env, jobject c
     proxy->dumpProfileInfo(fd, dumpFlags);
 }
 
+static void android_view_ThreadedRenderer_setFrameExportFd(JNIEnv* env, jobject clazz,
+        jlong proxyPtr, jobject javaFileDescriptor) {
+    RenderProxy* proxy = reinterpret_cast<RenderProxy*>(proxyPtr);
+    int fd = javaFileDescriptor ? jniGetFDFromFileDescriptor(env, javaFileDescriptor) : -1;
+    proxy->setFrameExportFd(fd);
+}
+
 static void android_view_ThreadedRenderer_dumpProfileData(JNIEnv* env, jobject clazz,
         jbyteArray jdata, jobject javaFileDescriptor) {
     int fd = jniGetFDFromFileDescriptor(env, javaFileDescriptor);
@@ -444,6 +458,11 @@ static void android_view_ThreadedRenderer_setupShadersDiskCache(JNIEnv* env, job
 
     const char* cacheArray = env->GetStringUTFChars(diskCachePath, NULL);
     egl_cache_t::get()->setCacheFilename(cacheArray);
+
+    // hwui keeps its linked programs next to the EGL blob cache
+    String8 programCachePath(String8(cacheArray).getPathDir());
+    programCachePath.appendPath("com.android.hwui.program_binaries");
+    ProgramCache::setBinaryCacheFile(programCachePath.string());
     env->ReleaseStringUTFChars(diskCachePath, cacheArray);
 }
 
@@ -489,7 +508,14 @@ static JNINativeMethod gMethods[] = {
                 (void*) android_view_ThreadedRenderer_setupShadersDiskCache },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "nPreload", "()V", (void*) android_view_ThreadedRenderer_preload },
+    { "nSetFrameExportFd", "(JLjava/io/FileDescriptor;)V", (void*) android_view_ThreadedRenderer_setFrameExportFd },
+};
+
 int register_android_view_ThreadedRenderer(JNIEnv* env) {
+    RegisterOptionalMethods(env, kClassPathName, gOptionalMethods, NELEM(gOptionalMethods));
     return RegisterMethodsOrDie(env, kClassPathName, gMethods, NELEM(gMethods));
 }
 
@@ -62,31 +62,51 @@ private:
     int32_t mActivePointerId;
     BitSet32 mCalculatedIdBits;
     Velocity mCalculatedVelocity[MAX_POINTERS];
+
+    // The unscaled velocities from the last time the strategy was solved.
+    // Views often compute the velocity several times per movement, with
+    // different units, so the solver only runs again after a new movement.
+    bool mRawVelocityValid;
+    BitSet32 mRawIdBits;
+    Velocity mRawVelocity[MAX_POINTERS];
 };
 
 VelocityTrackerState::VelocityTrackerState(const char* strategy) :
-        mVelocityTracker(strategy), mActivePointerId(-1) {
+        mVelocityTracker(strategy), mActivePointerId(-1), mRawVelocityValid(false) {
 }
 
 void VelocityTrackerState::clear() {
     mVelocityTracker.clear();
     mActivePointerId = -1;
     mCalculatedIdBits.clear();
+    mRawVelocityValid = false;
 }
 
 void VelocityTrackerState::addMovement(const MotionEvent* event) {
     mVelocityTracker.addMovement(event);
+    mRawVelocityValid = false;
 }
 
 void VelocityTrackerState::computeCurrentVelocity(int32_t units, float maxVelocity) {
-    BitSet32 idBits(mVelocityTracker.getCurrentPointerIdBits());
+    if (!mRawVelocityValid) {
+        BitSet32 idBits(mVelocityTracker.getCurrentPointerIdBits());
+        mRawIdBits = idBits;
+        for (uint32_t index = 0; !idBits.isEmpty(); index++) {
+            uint32_t id = idBits.clearFirstMarkedBit();
+            Velocity& raw = mRawVelocity[index];
+            mVelocityTracker.getVelocity(id, &raw.vx, &raw.vy);
+        }
+        mRawVelocityValid = true;
+    }
+
+    BitSet32 idBits(mRawIdBits);
     mCalculatedIdBits = idBits;
 
     for (uint32_t index = 0; !idBits.isEmpty(); index++) {
-        uint32_t id = idBits.clearFirstMarkedBit();
+        idBits.clearFirstMarkedBit();
 
-        float vx, vy;
-        mVelocityTracker.getVelocity(id, &vx, &vy);
+        float vx = mRawVelocity[index].vx;
+        float vy = mRawVelocity[index].vy;
 
         vx = vx * units / 1000;
         vy = vy * units / 1000;
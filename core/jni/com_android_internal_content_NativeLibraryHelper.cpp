@@ -24,6 +24,7 @@
 #include <androidfw/ZipFileRO.h>
 #include <androidfw/ZipUtils.h>
 #include <utils/Log.h>
+#include <utils/String8.h>
 #include <utils/Vector.h>
 
 #include <zlib.h>
@@ -34,9 +35,12 @@
 #include <time.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <atomic>
+
 
 #define APK_LIB "lib/"
 #define APK_LIB_LEN (sizeof(APK_LIB) - 1)
@@ -168,33 +172,32 @@ sumFiles(JNIEnv*, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntry, const char
 }
 
 /*
- * Copy the native library if needed.
- *
- * This function assumes the library and path names passed in are considered safe.
+ * The libraries copyNativeBinaries() has to extract, gathered by
+ * collectFileToCopy() while iterating and then copied by several threads.
  */
+struct NativeLibraryCopy {
+    bool extractNativeLibs;
+    bool hasNativeBridge;
+    // Set once the libraries are collected, for the copying threads to open
+    const char* apkPath;
+    Vector<String8> entryNames;
+    Vector<String8> fileNames;
+};
+
 static install_status_t
-copyFileIfChanged(JNIEnv *env, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntry, const char* fileName)
+collectFileToCopy(JNIEnv*, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntry, const char* fileName)
 {
-    void** args = reinterpret_cast<void**>(arg);
-    jstring* javaNativeLibPath = (jstring*) args[0];
-    jboolean extractNativeLibs = *(jboolean*) args[1];
-    jboolean hasNativeBridge = *(jboolean*) args[2];
-
-    ScopedUtfChars nativeLibPath(env, *javaNativeLibPath);
-
-    uint32_t uncompLen;
-    uint32_t when;
-    uint32_t crc;
+    NativeLibraryCopy* copy = reinterpret_cast<NativeLibraryCopy*>(arg);
 
     uint16_t method;
     off64_t offset;
 
-    if (!zipFile->getEntryInfo(zipEntry, &method, &uncompLen, NULL, &offset, &when, &crc)) {
+    if (!zipFile->getEntryInfo(zipEntry, &method, NULL, NULL, &offset, NULL, NULL)) {
         ALOGD("Couldn't read zip entry info\n");
         return INSTALL_FAILED_INVALID_APK;
     }
 
-    if (!extractNativeLibs) {
+    if (!copy->extractNativeLibs) {
         // check if library is uncompressed and page-aligned
         if (method != ZipFileRO::kCompressStored) {
             ALOGD("Library '%s' is compressed - will not be able to open it directly from apk.\n",
@@ -208,24 +211,54 @@ copyFileIfChanged(JNIEnv *env, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntr
             return INSTALL_FAILED_INVALID_APK;
         }
 
-        if (!hasNativeBridge) {
+        if (!copy->hasNativeBridge) {
           return INSTALL_SUCCEEDED;
         }
     }
 
+    char entryName[PATH_MAX];
+    if (zipFile->getEntryFileName(zipEntry, entryName, sizeof(entryName))) {
+        return INSTALL_FAILED_INVALID_APK;
+    }
+    copy->entryNames.add(String8(entryName));
+    copy->fileNames.add(String8(fileName));
+    return INSTALL_SUCCEEDED;
+}
+
+/*
+ * Copy the native library if needed.
+ *
+ * This function assumes the library and path names passed in are considered safe.
+ * It doesn't use JNI and only reads zipFile, so it may run on any thread.
+ */
+static install_status_t
+copyFileIfChanged(const char* nativeLibPath, ZipFileRO* zipFile, ZipEntryRO zipEntry,
+        const char* fileName)
+{
+    const size_t nativeLibPathLen = strlen(nativeLibPath);
+
+    uint32_t uncompLen;
+    uint32_t when;
+    uint32_t crc;
+
+    if (!zipFile->getEntryInfo(zipEntry, NULL, &uncompLen, NULL, NULL, &when, &crc)) {
+        ALOGD("Couldn't read zip entry info\n");
+        return INSTALL_FAILED_INVALID_APK;
+    }
+
     // Build local file path
     const size_t fileNameLen = strlen(fileName);
-    char localFileName[nativeLibPath.size() + fileNameLen + 2];
+    char localFileName[nativeLibPathLen + fileNameLen + 2];
 
-    if (strlcpy(localFileName, nativeLibPath.c_str(), sizeof(localFileName)) != nativeLibPath.size()) {
+    if (strlcpy(localFileName, nativeLibPath, sizeof(localFileName)) != nativeLibPathLen) {
         ALOGD("Couldn't allocate local file name for library");
         return INSTALL_FAILED_INTERNAL_ERROR;
     }
 
-    *(localFileName + nativeLibPath.size()) = '/';
+    *(localFileName + nativeLibPathLen) = '/';
 
-    if (strlcpy(localFileName + nativeLibPath.size() + 1, fileName, sizeof(localFileName)
-                    - nativeLibPath.size() - 1) != fileNameLen) {
+    if (strlcpy(localFileName + nativeLibPathLen + 1, fileName, sizeof(localFileName)
+                    - nativeLibPathLen - 1) != fileNameLen) {
         ALOGD("Couldn't allocate local file name for library");
         return INSTALL_FAILED_INTERNAL_ERROR;
     }
@@ -239,17 +272,17 @@ copyFileIfChanged(JNIEnv *env, void* arg, ZipFileRO* zipFile, ZipEntryRO zipEntr
         return INSTALL_SUCCEEDED;
     }
 
-    char localTmpFileName[nativeLibPath.size() + TMP_FILE_PATTERN_LEN + 2];
-    if (strlcpy(localTmpFileName, nativeLibPath.c_str(), sizeof(localTmpFileName))
-            != nativeLibPath.size()) {
+    char localTmpFileName[nativeLibPathLen + TMP_FILE_PATTERN_LEN + 2];
+    if (strlcpy(localTmpFileName, nativeLibPath, sizeof(localTmpFileName))
+            != nativeLibPathLen) {
         ALOGD("Couldn't allocate local file name for library");
         return INSTALL_FAILED_INTERNAL_ERROR;
     }
 
-    *(localFileName + nativeLibPath.size()) = '/';
+    *(localFileName + nativeLibPathLen) = '/';
 
-    if (strlcpy(localTmpFileName + nativeLibPath.size(), TMP_FILE_PATTERN,
-                    TMP_FILE_PATTERN_LEN - nativeLibPath.size()) != TMP_FILE_PATTERN_LEN) {
+    if (strlcpy(localTmpFileName + nativeLibPathLen, TMP_FILE_PATTERN,
+                    TMP_FILE_PATTERN_LEN - nativeLibPathLen) != TMP_FILE_PATTERN_LEN) {
         ALOGI("Couldn't allocate temporary file name for library");
         return INSTALL_FAILED_INTERNAL_ERROR;
     }
@@ -485,14 +518,112 @@ static int findSupportedAbi(JNIEnv *env, jlong apkHandle, jobjectArray supported
     return status;
 }
 
+// Copying is mostly inflating and writing, which scales with the cores until
+// the storage can't keep up.
+static const size_t kMaxCopyThreads = 4;
+
+/*
+ * Shared by the threads copying the libraries of a NativeLibraryCopy. Each
+ * one takes the next library until they're all done or one has failed.
+ */
+struct NativeLibraryCopyState {
+    const NativeLibraryCopy* copy;
+    const char* nativeLibPath;
+    std::atomic<size_t> next;
+    // The result of the first library to fail, if any
+    std::atomic<int> status;
+};
+
+static void
+copyNativeLibraries(NativeLibraryCopyState* state, ZipFileRO* zipFile)
+{
+    const NativeLibraryCopy& copy = *state->copy;
+    size_t i;
+    while (state->status.load() == INSTALL_SUCCEEDED
+            && (i = state->next.fetch_add(1)) < copy.entryNames.size()) {
+        install_status_t ret = INSTALL_FAILED_INVALID_APK;
+        ZipEntryRO entry = zipFile->findEntryByName(copy.entryNames[i].string());
+        if (entry != NULL) {
+            ret = copyFileIfChanged(state->nativeLibPath, zipFile, entry,
+                    copy.fileNames[i].string());
+            zipFile->releaseEntry(entry);
+        }
+
+        if (ret != INSTALL_SUCCEEDED) {
+            ALOGV("Failure for entry %s", copy.fileNames[i].string());
+            int expected = INSTALL_SUCCEEDED;
+            state->status.compare_exchange_strong(expected, ret);
+        }
+    }
+}
+
+static void*
+copyNativeLibrariesThread(void* arg)
+{
+    NativeLibraryCopyState* state = reinterpret_cast<NativeLibraryCopyState*>(arg);
+
+    // The reads of an archive seek its fd, so each thread opens its own.
+    // If that fails, the other threads copy the libraries.
+    ZipFileRO* zipFile = ZipFileRO::open(state->copy->apkPath);
+    if (zipFile != NULL) {
+        copyNativeLibraries(state, zipFile);
+        delete zipFile;
+    }
+    return NULL;
+}
+
 static jint
 com_android_internal_content_NativeLibraryHelper_copyNativeBinaries(JNIEnv *env, jclass clazz,
         jlong apkHandle, jstring javaNativeLibPath, jstring javaCpuAbi,
         jboolean extractNativeLibs, jboolean hasNativeBridge)
 {
-    void* args[] = { &javaNativeLibPath, &extractNativeLibs, &hasNativeBridge };
-    return (jint) iterateOverNativeFiles(env, apkHandle, javaCpuAbi,
-            copyFileIfChanged, reinterpret_cast<void*>(args));
+    NativeLibraryCopy copy;
+    copy.extractNativeLibs = extractNativeLibs;
+    copy.hasNativeBridge = hasNativeBridge;
+    install_status_t ret = iterateOverNativeFiles(env, apkHandle, javaCpuAbi,
+            collectFileToCopy, &copy);
+    if (ret != INSTALL_SUCCEEDED || copy.entryNames.isEmpty()) {
+        return (jint) ret;
+    }
+
+    ScopedUtfChars nativeLibPath(env, javaNativeLibPath);
+    if (nativeLibPath.c_str() == NULL) {
+        return INSTALL_FAILED_INTERNAL_ERROR;
+    }
+
+    ZipFileRO* zipFile = reinterpret_cast<ZipFileRO*>(apkHandle);
+    copy.apkPath = zipFile->getFileName();
+
+    NativeLibraryCopyState state;
+    state.copy = &copy;
+    state.nativeLibPath = nativeLibPath.c_str();
+    state.next = 0;
+    state.status = INSTALL_SUCCEEDED;
+
+    size_t threadCount = copy.entryNames.size();
+    const long cpuCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpuCount > 0 && threadCount > static_cast<size_t>(cpuCount)) {
+        threadCount = cpuCount;
+    }
+    if (threadCount > kMaxCopyThreads) {
+        threadCount = kMaxCopyThreads;
+    }
+
+    // This thread copies too, with the archive it was given, so the libraries
+    // are copied even if no other thread can be started.
+    pthread_t threads[kMaxCopyThreads];
+    size_t startedCount = 0;
+    for (size_t i = 1; i < threadCount; i++) {
+        if (pthread_create(&threads[startedCount], NULL, copyNativeLibrariesThread, &state) == 0) {
+            startedCount++;
+        }
+    }
+    copyNativeLibraries(&state, zipFile);
+    for (size_t i = 0; i < startedCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return (jint) state.status.load();
 }
 
 static jlong
@@ -30,8 +30,11 @@
 
 #include <utils/Log.h>
 #include <utils/misc.h>
+#include <utils/Mutex.h>
 #include <utils/Vector.h>
 
+#include <vector>
+
 namespace android {
 
 static jclass gStringClass;
@@ -61,6 +64,49 @@ struct stats_line {
     int64_t txPackets;
 };
 
+// An iface name with the String handed to Java for it. There are only a few
+// interfaces, while there can be thousands of rows for each of them.
+struct interned_iface {
+    char name[32];
+    jstring string;     // Global reference
+};
+
+// Past this many interfaces, the Strings are created for each row again
+static const size_t kMaxInternedIfaces = 64;
+
+// Guards the state kept between reads
+static Mutex gStatsLock;
+static Vector<interned_iface> gIfaces;
+// The rows of the last read, kept so that their storage is reused
+static std::vector<stats_line> gLines;
+
+// Returns a local reference to the String for the iface name.
+static jstring get_iface_string(JNIEnv* env, const char* name, size_t* lastIfaceIdx)
+{
+    if (*lastIfaceIdx < gIfaces.size()
+            && strcmp(gIfaces[*lastIfaceIdx].name, name) == 0) {
+        return (jstring) env->NewLocalRef(gIfaces[*lastIfaceIdx].string);
+    }
+    for (size_t i = 0; i < gIfaces.size(); i++) {
+        if (strcmp(gIfaces[i].name, name) == 0) {
+            *lastIfaceIdx = i;
+            return (jstring) env->NewLocalRef(gIfaces[i].string);
+        }
+    }
+
+    jstring string = env->NewStringUTF(name);
+    if (string == NULL || gIfaces.size() >= kMaxInternedIfaces) {
+        return string;
+    }
+    interned_iface iface;
+    strlcpy(iface.name, name, sizeof(iface.name));
+    iface.string = (jstring) env->NewGlobalRef(string);
+    if (iface.string != NULL) {
+        *lastIfaceIdx = gIfaces.add(iface);
+    }
+    return string;
+}
+
 static jobjectArray get_string_array(JNIEnv* env, jobject obj, jfieldID field, int size, bool grow)
 {
     if (!grow) {
@@ -94,6 +140,27 @@ static jlongArray get_long_array(JNIEnv* env, jobject obj, jfieldID field, int s
     return env->NewLongArray(size);
 }
 
+// Parses the uid, set and the four counters that follow the tag of a row.
+static bool parse_stats_fields(const char* pos, stats_line* s)
+{
+    uint64_t values[6];
+    for (size_t i = 0; i < NELEM(values); i++) {
+        char* endPos;
+        values[i] = strtoull(pos, &endPos, 10);
+        if (endPos == pos) {
+            return false;
+        }
+        pos = endPos;
+    }
+    s->uid = (int32_t) values[0];
+    s->set = (int32_t) values[1];
+    s->rxBytes = (int64_t) values[2];
+    s->rxPackets = (int64_t) values[3];
+    s->txBytes = (int64_t) values[4];
+    s->txPackets = (int64_t) values[5];
+    return true;
+}
+
 static int readNetworkStatsDetail(JNIEnv* env, jclass clazz, jobject stats,
         jstring path, jint limitUid, jobjectArray limitIfacesObj, jint limitTag) {
     ScopedUtfChars path8(env, path);
@@ -101,6 +168,8 @@ static int readNetworkStatsDetail(JNIEnv* env, jclass clazz, jobject stats,
         return -1;
     }
 
+    AutoMutex _l(gStatsLock);
+
     FILE *fp = fopen(path8.c_str(), "r");
     if (fp == NULL) {
         return -1;
@@ -119,7 +188,8 @@ static int readNetworkStatsDetail(JNIEnv* env, jclass clazz, jobject stats,
         }
     }
 
-    Vector<stats_line> lines;
+    std::vector<stats_line>& lines = gLines;
+    lines.clear();
 
     int lastIdx = 1;
     int idx;
@@ -188,7 +258,9 @@ static int readNetworkStatsDetail(JNIEnv* env, jclass clazz, jobject stats,
         if (endPos - pos == 3) {
             rawTag = 0;
         } else {
-            if (sscanf(pos, "%" PRIx64, &rawTag) != 1) {
+            char* tagEnd;
+            rawTag = (int64_t) strtoull(pos, &tagEnd, 16);
+            if (tagEnd == pos) {
                 ALOGE("bad tag: %s", pos);
                 fclose(fp);
                 return -1;
@@ -205,9 +277,7 @@ static int readNetworkStatsDetail(JNIEnv* env, jclass clazz, jobject stats,
         while (*pos == ' ') pos++;
 
         // Parse remaining fields.
-        if (sscanf(pos, "%u %u %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64,
-                &s.uid, &s.set, &s.rxBytes, &s.rxPackets,
-                &s.txBytes, &s.txPackets) == 6) {
+        if (parse_stats_fields(pos, &s)) {
             if (limitUid != -1 && limitUid != s.uid) {
                 //ALOGI("skipping due to uid: %s", buffer);
                 continue;
@@ -254,8 +324,10 @@ static int readNetworkStatsDetail(JNIEnv* env, jclass clazz, jobject stats,
             gNetworkStatsClassInfo.operations, size, grow));
     if (operations.get() == NULL) return -1;
 
+    size_t lastIfaceIdx = 0;
     for (int i = 0; i < size; i++) {
-        ScopedLocalRef<jstring> ifaceString(env, env->NewStringUTF(lines[i].iface));
+        ScopedLocalRef<jstring> ifaceString(env,
+                get_iface_string(env, lines[i].iface, &lastIfaceIdx));
         env->SetObjectArrayElement(iface.get(), i, ifaceString.get());
 
         uid[i] = lines[i].uid;
@@ -370,7 +370,8 @@ static bool NeedsNoRandomizeWorkaround() {
 // Utility to close down the Zygote socket file descriptors while
 // the child is still running as root with Zygote's privileges.  Each
 // descriptor (if any) is closed via dup2(), replacing it with a valid
-// (open) descriptor to /dev/null.
+// (open) descriptor to /dev/null. A single /dev/null descriptor is
+// used for all of them.
 
 static void DetachDescriptors(JNIEnv* env, jintArray fdsToClose) {
   if (!fdsToClose) {
@@ -382,22 +383,25 @@ static void DetachDescriptors(JNIEnv* env, jintArray fdsToClose) {
       ALOGE("Bad fd array");
       RuntimeAbort(env);
   }
+  if (count == 0) {
+    env->ReleaseIntArrayElements(fdsToClose, ar, JNI_ABORT);
+    return;
+  }
+  int devnull = open("/dev/null", O_RDWR | O_CLOEXEC);
+  if (devnull < 0) {
+    ALOGE("Failed to open /dev/null: %s", strerror(errno));
+    RuntimeAbort(env);
+  }
   jsize i;
-  int devnull;
   for (i = 0; i < count; i++) {
-    devnull = open("/dev/null", O_RDWR);
-    if (devnull < 0) {
-      ALOGE("Failed to open /dev/null: %s", strerror(errno));
-      RuntimeAbort(env);
-      continue;
-    }
     ALOGV("Switching descriptor %d to /dev/null: %s", ar[i], strerror(errno));
     if (dup2(devnull, ar[i]) < 0) {
       ALOGE("Failed dup2() on descriptor %d: %s", ar[i], strerror(errno));
       RuntimeAbort(env);
     }
-    close(devnull);
   }
+  close(devnull);
+  env->ReleaseIntArrayElements(fdsToClose, ar, JNI_ABORT);
 }
 
 void SetThreadName(const char* thread_name) {
@@ -451,14 +455,9 @@ static void SetForkLoad(bool boost) {
 // The list of open zygote file descriptors.
 static FileDescriptorTable* gOpenFdTable = NULL;
 
-// Utility routine to fork zygote and specialize the child process.
-static pid_t ForkAndSpecializeCommon(JNIEnv* env, uid_t uid, gid_t gid, jintArray javaGids,
-                                     jint debug_flags, jobjectArray javaRlimits,
-                                     jlong permittedCapabilities, jlong effectiveCapabilities,
-                                     jint mount_external,
-                                     jstring java_se_info, jstring java_se_name,
-                                     bool is_system_server, jintArray fdsToClose,
-                                     jstring instructionSet, jstring dataDir) {
+// Utility routine to fork zygote. The child only gets the work that doesn't
+// depend on what it will run: its descriptors are detached from the zygote's.
+static pid_t ForkCommon(JNIEnv* env, jintArray fdsToClose) {
   SetSigChldHandler();
 
 #ifdef ENABLE_SCHED_BOOST
@@ -495,144 +494,170 @@ static pid_t ForkAndSpecializeCommon(JNIEnv* env, uid_t uid, gid_t gid, jintArra
     if (!gOpenFdTable->ReopenOrDetach()) {
       RuntimeAbort(env, __LINE__, "Unable to reopen whitelisted descriptors.");
     }
+  } else if (pid > 0) {
+    // the parent process
 
-    // Keep capabilities across UID change, unless we're staying root.
-    if (uid != 0) {
-      EnableKeepCapabilities(env);
-    }
+#ifdef ENABLE_SCHED_BOOST
+    // unset scheduler knob
+    SetForkLoad(false);
+#endif
 
-    DropCapabilitiesBoundingSet(env);
+  }
+  return pid;
+}
 
-    bool use_native_bridge = !is_system_server && (instructionSet != NULL)
-        && android::NativeBridgeAvailable();
-    if (use_native_bridge) {
-      ScopedUtfChars isa_string(env, instructionSet);
-      use_native_bridge = android::NeedsNativeBridge(isa_string.c_str());
-    }
-    if (use_native_bridge && dataDir == NULL) {
-      // dataDir should never be null if we need to use a native bridge.
-      // In general, dataDir will never be null for normal applications. It can only happen in
-      // special cases (for isolated processes which are not associated with any app). These are
-      // launched by the framework and should not be emulated anyway.
-      use_native_bridge = false;
-      ALOGW("Native bridge will not be used because dataDir == NULL.");
-    }
+// Utility routine to specialize a child of ForkCommon for what it will run.
+static void SpecializeCommon(JNIEnv* env, uid_t uid, gid_t gid, jintArray javaGids,
+                             jint debug_flags, jobjectArray javaRlimits,
+                             jlong permittedCapabilities, jlong effectiveCapabilities,
+                             jint mount_external,
+                             jstring java_se_info, jstring java_se_name,
+                             bool is_system_server,
+                             jstring instructionSet, jstring dataDir) {
+  // Keep capabilities across UID change, unless we're staying root.
+  if (uid != 0) {
+    EnableKeepCapabilities(env);
+  }
 
-    if (!MountEmulatedStorage(uid, mount_external, use_native_bridge)) {
-      ALOGW("Failed to mount emulated storage: %s", strerror(errno));
-      if (errno == ENOTCONN || errno == EROFS) {
-        // When device is actively encrypting, we get ENOTCONN here
-        // since FUSE was mounted before the framework restarted.
-        // When encrypted device is booting, we get EROFS since
-        // FUSE hasn't been created yet by init.
-        // In either case, continue without external storage.
-      } else {
-        ALOGE("Cannot continue without emulated storage");
-        RuntimeAbort(env);
-      }
-    }
+  DropCapabilitiesBoundingSet(env);
 
-    if (!is_system_server) {
-        int rc = createProcessGroup(uid, getpid());
-        if (rc != 0) {
-            if (rc == -EROFS) {
-                ALOGW("createProcessGroup failed, kernel missing CONFIG_CGROUP_CPUACCT?");
-            } else {
-                ALOGE("createProcessGroup(%d, %d) failed: %s", uid, pid, strerror(-rc));
-            }
-        }
+  bool use_native_bridge = !is_system_server && (instructionSet != NULL)
+      && android::NativeBridgeAvailable();
+  if (use_native_bridge) {
+    ScopedUtfChars isa_string(env, instructionSet);
+    use_native_bridge = android::NeedsNativeBridge(isa_string.c_str());
+  }
+  if (use_native_bridge && dataDir == NULL) {
+    // dataDir should never be null if we need to use a native bridge.
+    // In general, dataDir will never be null for normal applications. It can only happen in
+    // special cases (for isolated processes which are not associated with any app). These are
+    // launched by the framework and should not be emulated anyway.
+    use_native_bridge = false;
+    ALOGW("Native bridge will not be used because dataDir == NULL.");
+  }
+
+  if (!MountEmulatedStorage(uid, mount_external, use_native_bridge)) {
+    ALOGW("Failed to mount emulated storage: %s", strerror(errno));
+    if (errno == ENOTCONN || errno == EROFS) {
+      // When device is actively encrypting, we get ENOTCONN here
+      // since FUSE was mounted before the framework restarted.
+      // When encrypted device is booting, we get EROFS since
+      // FUSE hasn't been created yet by init.
+      // In either case, continue without external storage.
+    } else {
+      ALOGE("Cannot continue without emulated storage");
+      RuntimeAbort(env);
     }
+  }
 
-    SetGids(env, javaGids);
+  if (!is_system_server) {
+      int rc = createProcessGroup(uid, getpid());
+      if (rc != 0) {
+          if (rc == -EROFS) {
+              ALOGW("createProcessGroup failed, kernel missing CONFIG_CGROUP_CPUACCT?");
+          } else {
+              ALOGE("createProcessGroup(%d, %d) failed: %s", uid, getpid(), strerror(-rc));
+          }
+      }
+  }
 
-    SetRLimits(env, javaRlimits);
+  SetGids(env, javaGids);
 
-    if (use_native_bridge) {
-      ScopedUtfChars isa_string(env, instructionSet);
-      ScopedUtfChars data_dir(env, dataDir);
-      android::PreInitializeNativeBridge(data_dir.c_str(), isa_string.c_str());
-    }
+  SetRLimits(env, javaRlimits);
 
-    int rc = setresgid(gid, gid, gid);
-    if (rc == -1) {
-      ALOGE("setresgid(%d) failed: %s", gid, strerror(errno));
-      RuntimeAbort(env);
-    }
+  if (use_native_bridge) {
+    ScopedUtfChars isa_string(env, instructionSet);
+    ScopedUtfChars data_dir(env, dataDir);
+    android::PreInitializeNativeBridge(data_dir.c_str(), isa_string.c_str());
+  }
 
-    rc = setresuid(uid, uid, uid);
-    if (rc == -1) {
-      ALOGE("setresuid(%d) failed: %s", uid, strerror(errno));
-      RuntimeAbort(env);
-    }
+  int rc = setresgid(gid, gid, gid);
+  if (rc == -1) {
+    ALOGE("setresgid(%d) failed: %s", gid, strerror(errno));
+    RuntimeAbort(env);
+  }
 
-    if (NeedsNoRandomizeWorkaround()) {
-        // Work around ARM kernel ASLR lossage (http://b/5817320).
-        int old_personality = personality(0xffffffff);
-        int new_personality = personality(old_personality | ADDR_NO_RANDOMIZE);
-        if (new_personality == -1) {
-            ALOGW("personality(%d) failed: %s", new_personality, strerror(errno));
-        }
-    }
+  rc = setresuid(uid, uid, uid);
+  if (rc == -1) {
+    ALOGE("setresuid(%d) failed: %s", uid, strerror(errno));
+    RuntimeAbort(env);
+  }
 
-    SetCapabilities(env, permittedCapabilities, effectiveCapabilities);
+  if (NeedsNoRandomizeWorkaround()) {
+      // Work around ARM kernel ASLR lossage (http://b/5817320).
+      int old_personality = personality(0xffffffff);
+      int new_personality = personality(old_personality | ADDR_NO_RANDOMIZE);
+      if (new_personality == -1) {
+          ALOGW("personality(%d) failed: %s", new_personality, strerror(errno));
+      }
+  }
 
-    SetSchedulerPolicy(env);
+  SetCapabilities(env, permittedCapabilities, effectiveCapabilities);
 
-    const char* se_info_c_str = NULL;
-    ScopedUtfChars* se_info = NULL;
-    if (java_se_info != NULL) {
-        se_info = new ScopedUtfChars(env, java_se_info);
-        se_info_c_str = se_info->c_str();
-        if (se_info_c_str == NULL) {
-          ALOGE("se_info_c_str == NULL");
-          RuntimeAbort(env);
-        }
-    }
-    const char* se_name_c_str = NULL;
-    ScopedUtfChars* se_name = NULL;
-    if (java_se_name != NULL) {
-        se_name = new ScopedUtfChars(env, java_se_name);
-        se_name_c_str = se_name->c_str();
-        if (se_name_c_str == NULL) {
-          ALOGE("se_name_c_str == NULL");
-          RuntimeAbort(env);
-        }
-    }
-    rc = selinux_android_setcontext(uid, is_system_server, se_info_c_str, se_name_c_str);
-    if (rc == -1) {
-      ALOGE("selinux_android_setcontext(%d, %d, \"%s\", \"%s\") failed", uid,
-            is_system_server, se_info_c_str, se_name_c_str);
-      RuntimeAbort(env);
-    }
+  SetSchedulerPolicy(env);
 
-    // Make it easier to debug audit logs by setting the main thread's name to the
-    // nice name rather than "app_process".
-    if (se_info_c_str == NULL && is_system_server) {
-      se_name_c_str = "system_server";
-    }
-    if (se_info_c_str != NULL) {
-      SetThreadName(se_name_c_str);
-    }
+  const char* se_info_c_str = NULL;
+  ScopedUtfChars* se_info = NULL;
+  if (java_se_info != NULL) {
+      se_info = new ScopedUtfChars(env, java_se_info);
+      se_info_c_str = se_info->c_str();
+      if (se_info_c_str == NULL) {
+        ALOGE("se_info_c_str == NULL");
+        RuntimeAbort(env);
+      }
+  }
+  const char* se_name_c_str = NULL;
+  ScopedUtfChars* se_name = NULL;
+  if (java_se_name != NULL) {
+      se_name = new ScopedUtfChars(env, java_se_name);
+      se_name_c_str = se_name->c_str();
+      if (se_name_c_str == NULL) {
+        ALOGE("se_name_c_str == NULL");
+        RuntimeAbort(env);
+      }
+  }
+  rc = selinux_android_setcontext(uid, is_system_server, se_info_c_str, se_name_c_str);
+  if (rc == -1) {
+    ALOGE("selinux_android_setcontext(%d, %d, \"%s\", \"%s\") failed", uid,
+          is_system_server, se_info_c_str, se_name_c_str);
+    RuntimeAbort(env);
+  }
 
-    delete se_info;
-    delete se_name;
+  // Make it easier to debug audit logs by setting the main thread's name to the
+  // nice name rather than "app_process".
+  if (se_info_c_str == NULL && is_system_server) {
+    se_name_c_str = "system_server";
+  }
+  if (se_info_c_str != NULL) {
+    SetThreadName(se_name_c_str);
+  }
 
-    UnsetSigChldHandler();
+  delete se_info;
+  delete se_name;
 
-    env->CallStaticVoidMethod(gZygoteClass, gCallPostForkChildHooks, debug_flags,
-                              is_system_server ? NULL : instructionSet);
-    if (env->ExceptionCheck()) {
-      ALOGE("Error calling post fork hooks.");
-      RuntimeAbort(env);
-    }
-  } else if (pid > 0) {
-    // the parent process
+  UnsetSigChldHandler();
 
-#ifdef ENABLE_SCHED_BOOST
-    // unset scheduler knob
-    SetForkLoad(false);
-#endif
+  env->CallStaticVoidMethod(gZygoteClass, gCallPostForkChildHooks, debug_flags,
+                            is_system_server ? NULL : instructionSet);
+  if (env->ExceptionCheck()) {
+    ALOGE("Error calling post fork hooks.");
+    RuntimeAbort(env);
+  }
+}
 
+// Utility routine to fork zygote and specialize the child process.
+static pid_t ForkAndSpecializeCommon(JNIEnv* env, uid_t uid, gid_t gid, jintArray javaGids,
+                                     jint debug_flags, jobjectArray javaRlimits,
+                                     jlong permittedCapabilities, jlong effectiveCapabilities,
+                                     jint mount_external,
+                                     jstring java_se_info, jstring java_se_name,
+                                     bool is_system_server, jintArray fdsToClose,
+                                     jstring instructionSet, jstring dataDir) {
+  pid_t pid = ForkCommon(env, fdsToClose);
+  if (pid == 0) {
+    SpecializeCommon(env, uid, gid, javaGids, debug_flags, javaRlimits,
+                     permittedCapabilities, effectiveCapabilities, mount_external,
+                     java_se_info, java_se_name, is_system_server, instructionSet, dataDir);
   }
   return pid;
 }
@@ -640,11 +665,10 @@ static pid_t ForkAndSpecializeCommon(JNIEnv* env, uid_t uid, gid_t gid, jintArra
 
 namespace android {
 
-static jint com_android_internal_os_Zygote_nativeForkAndSpecialize(
-        JNIEnv* env, jclass, jint uid, jint gid, jintArray gids,
-        jint debug_flags, jobjectArray rlimits,
-        jint mount_external, jstring se_info, jstring se_name,
-        jintArray fdsToClose, jstring instructionSet, jstring appDataDir) {
+// Returns the capabilities of an application uid, adding to gids whatever
+// groups it needs on top of the ones it asked for.
+static jlong GetApplicationCapabilities(JNIEnv* env, jint uid, jintArray* javaGids) {
+    jintArray gids = *javaGids;
     jlong capabilities = 0;
     if (uid == AID_BLUETOOTH) {
         // Grant CAP_WAKE_ALARM and CAP_BLOCK_SUSPEND to the Bluetooth process.
@@ -672,14 +696,42 @@ static jint com_android_internal_os_Zygote_nativeForkAndSpecialize(
 
         env->ReleaseIntArrayElements(gids, gids_elements, JNI_ABORT);
         env->ReleaseIntArrayElements(gids_with_system, gids_with_system_elements, 0);
-        gids = gids_with_system;
+        *javaGids = gids_with_system;
     }
+    return capabilities;
+}
 
+static jint com_android_internal_os_Zygote_nativeForkAndSpecialize(
+        JNIEnv* env, jclass, jint uid, jint gid, jintArray gids,
+        jint debug_flags, jobjectArray rlimits,
+        jint mount_external, jstring se_info, jstring se_name,
+        jintArray fdsToClose, jstring instructionSet, jstring appDataDir) {
+    jlong capabilities = GetApplicationCapabilities(env, uid, &gids);
     return ForkAndSpecializeCommon(env, uid, gid, gids, debug_flags,
             rlimits, capabilities, capabilities, mount_external, se_info,
             se_name, false, fdsToClose, instructionSet, appDataDir);
 }
 
+// Forks a child for the pool of waiting applications. It runs as the zygote
+// until nativeSpecializePoolChild has been called with the request it got.
+static jint com_android_internal_os_Zygote_nativeForkPoolChild(
+        JNIEnv* env, jclass, jintArray fdsToClose) {
+    return ForkCommon(env, fdsToClose);
+}
+
+// Called in a child of nativeForkPoolChild to make it the application that
+// nativeForkAndSpecialize would have forked with the same arguments.
+static void com_android_internal_os_Zygote_nativeSpecializePoolChild(
+        JNIEnv* env, jclass, jint uid, jint gid, jintArray gids,
+        jint debug_flags, jobjectArray rlimits,
+        jint mount_external, jstring se_info, jstring se_name,
+        jstring instructionSet, jstring appDataDir) {
+    jlong capabilities = GetApplicationCapabilities(env, uid, &gids);
+    SpecializeCommon(env, uid, gid, gids, debug_flags, rlimits,
+                     capabilities, capabilities, mount_external, se_info,
+                     se_name, false, instructionSet, appDataDir);
+}
+
 static jint com_android_internal_os_Zygote_nativeForkSystemServer(
         JNIEnv* env, jclass, uid_t uid, gid_t gid, jintArray gids,
         jint debug_flags, jobjectArray rlimits, jlong permittedCapabilities,
@@ -710,7 +762,16 @@ static JNINativeMethod gMethods[] = {
       "(II[II[[IILjava/lang/String;Ljava/lang/String;[ILjava/lang/String;Ljava/lang/String;)I",
       (void *) com_android_internal_os_Zygote_nativeForkAndSpecialize },
     { "nativeForkSystemServer", "(II[II[[IJJ)I",
-      (void *) com_android_internal_os_Zygote_nativeForkSystemServer }
+      (void *) com_android_internal_os_Zygote_nativeForkSystemServer },
+};
+
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "nativeForkPoolChild", "([I)I",
+      (void *) com_android_internal_os_Zygote_nativeForkPoolChild },
+    { "nativeSpecializePoolChild",
+      "(II[II[[IILjava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)V",
+      (void *) com_android_internal_os_Zygote_nativeSpecializePoolChild },
 };
 
 int register_com_android_internal_os_Zygote(JNIEnv* env) {
@@ -718,6 +779,8 @@ int register_com_android_internal_os_Zygote(JNIEnv* env) {
   gCallPostForkChildHooks = GetStaticMethodIDOrDie(env, gZygoteClass, "callPostForkChildHooks",
                                                    "(ILjava/lang/String;)V");
 
+  RegisterOptionalMethods(env, "com/android/internal/os/Zygote", gOptionalMethods,
+                          NELEM(gOptionalMethods));
   return RegisterMethodsOrDie(env, "com/android/internal/os/Zygote", gMethods, NELEM(gMethods));
 }
 }  // namespace android
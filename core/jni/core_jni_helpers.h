@@ -44,6 +44,16 @@ static inline jmethodID GetMethodIDOrDie(JNIEnv* env, jclass clazz, const char*
     return res;
 }
 
+// Returns NULL, without a pending exception, if the class doesn't declare the method.
+static inline jmethodID GetOptionalMethodID(JNIEnv* env, jclass clazz, const char* method_name,
+                                            const char* method_signature) {
+    jmethodID res = env->GetMethodID(clazz, method_name, method_signature);
+    if (res == NULL) {
+        env->ExceptionClear();
+    }
+    return res;
+}
+
 static inline jfieldID GetStaticFieldIDOrDie(JNIEnv* env, jclass clazz, const char* field_name,
                                              const char* field_signature) {
     jfieldID res = env->GetStaticFieldID(clazz, field_name, field_signature);
@@ -72,6 +82,13 @@ static inline int RegisterMethodsOrDie(JNIEnv* env, const char* className,
     return res;
 }
 
+// Registers the methods the class declares, for natives added ahead of their
+// Java declarations.
+static inline int RegisterOptionalMethods(JNIEnv* env, const char* className,
+                                          const JNINativeMethod* gMethods, int numMethods) {
+    return AndroidRuntime::registerOptionalNativeMethods(env, className, gMethods, numMethods);
+}
+
 }  // namespace android
 
 #endif  // CORE_JNI_HELPERS
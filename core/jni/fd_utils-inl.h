@@ -16,7 +16,6 @@
 
 #include <string>
 #include <unordered_map>
-#include <set>
 #include <vector>
 #include <algorithm>
 
@@ -165,9 +164,11 @@ class FileDescriptorInfo {
     return f_stat.st_ino == stat.st_ino && f_stat.st_dev == stat.st_dev;
   }
 
-  bool ReopenOrDetach() const {
+  // Sockets are detached by pointing them at dev_null_fd, an open
+  // descriptor to /dev/null shared by all the descriptors of a table.
+  bool ReopenOrDetach(int dev_null_fd) const {
     if (is_sock) {
-      return DetachSocket();
+      return DetachSocket(dev_null_fd);
     }
 
     // NOTE: This might happen if the file was unlinked after being opened.
@@ -334,23 +335,12 @@ class FileDescriptorInfo {
     return true;
   }
 
-  bool DetachSocket() const {
-    const int dev_null_fd = open("/dev/null", O_RDWR);
-    if (dev_null_fd < 0) {
-      ALOGE("Failed to open /dev/null : %s", strerror(errno));
-      return false;
-    }
-
+  bool DetachSocket(int dev_null_fd) const {
     if (dup2(dev_null_fd, fd) == -1) {
       ALOGE("Failed dup2 on socket descriptor %d : %s", fd, strerror(errno));
       return false;
     }
 
-    if (close(dev_null_fd) == -1) {
-      ALOGE("Failed close(%d) : %s", dev_null_fd, strerror(errno));
-      return false;
-    }
-
     return true;
   }
 
@@ -401,7 +391,7 @@ class FileDescriptorTable {
   }
 
   bool Restat() {
-    std::set<int> open_fds;
+    std::vector<int> open_fds;
 
     // First get the list of open descriptors.
     DIR* d = opendir(kFdPath);
@@ -418,7 +408,7 @@ class FileDescriptorTable {
         continue;
       }
 
-      open_fds.insert(fd);
+      open_fds.push_back(fd);
     }
 
     if (closedir(d) == -1) {
@@ -426,6 +416,7 @@ class FileDescriptorTable {
       return false;
     }
 
+    std::sort(open_fds.begin(), open_fds.end());
     return RestatInternal(open_fds);
   }
 
@@ -433,15 +424,27 @@ class FileDescriptorTable {
   // if all descriptors were successfully re-opened or detached, and false if an
   // error occurred.
   bool ReopenOrDetach() {
+    const int dev_null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (dev_null_fd < 0) {
+      ALOGE("Failed to open /dev/null : %s", strerror(errno));
+      return false;
+    }
+
+    bool result = true;
     std::unordered_map<int, FileDescriptorInfo*>::const_iterator it;
     for (it = open_fd_map_.begin(); it != open_fd_map_.end(); ++it) {
       const FileDescriptorInfo* info = it->second;
-      if (info == NULL || !info->ReopenOrDetach()) {
-        return false;
+      if (info == NULL || !info->ReopenOrDetach(dev_null_fd)) {
+        result = false;
+        break;
       }
     }
 
-    return true;
+    if (close(dev_null_fd) == -1) {
+      ALOGE("Failed close(%d) : %s", dev_null_fd, strerror(errno));
+      return false;
+    }
+    return result;
   }
 
  private:
@@ -449,78 +452,55 @@ class FileDescriptorTable {
       : open_fd_map_(map) {
   }
 
-  bool RestatInternal(std::set<int>& open_fds) {
+  // |open_fds| is the sorted list of the descriptors open now. Only the
+  // descriptors that weren't open, or no longer refer to the same file, are
+  // inspected again; the others are just restatted.
+  bool RestatInternal(const std::vector<int>& open_fds) {
     bool error = false;
 
-    // Iterate through the list of file descriptors we've already recorded
-    // and check whether :
+    // Drop the entries of the descriptors that have been closed.
     //
-    // (a) they continue to be open.
-    // (b) they refer to the same file.
+    // TODO(narayan): This will be an error in a future android release.
+    // error = true;
+    // ALOGW("Zygote closed file descriptor %d.", it->first);
     std::unordered_map<int, FileDescriptorInfo*>::iterator it = open_fd_map_.begin();
     while (it != open_fd_map_.end()) {
-      std::set<int>::const_iterator element = open_fds.find(it->first);
-      if (element == open_fds.end()) {
-        // The entry from the file descriptor table is no longer in the list
-        // of open files. We warn about this condition and remove it from
-        // the list of FDs under consideration.
-        //
-        // TODO(narayan): This will be an error in a future android release.
-        // error = true;
-        // ALOGW("Zygote closed file descriptor %d.", it->first);
+      if (!std::binary_search(open_fds.begin(), open_fds.end(), it->first)) {
+        delete it->second;
         it = open_fd_map_.erase(it);
       } else {
-        // The entry from the file descriptor table is still open. Restat
-        // it and check whether it refers to the same file.
-        const bool same_file = it->second->Restat();
-        if (!same_file) {
-          // The file descriptor refers to a different description. We must
-          // update our entry in the table.
-          delete it->second;
-          it->second = FileDescriptorInfo::createFromFd(*element);
-          if (it->second == NULL) {
-            // The descriptor no longer no longer refers to a whitelisted file.
-            // We flag an error and remove it from the list of files we're
-            // tracking.
-            error = true;
-            it = open_fd_map_.erase(it);
-          } else {
-            // Successfully restatted the file, move on to the next open FD.
-            ++it;
-          }
-        } else {
-          // It's the same file. Nothing to do here. Move on to the next open
-          // FD.
-          ++it;
-        }
-
-        // Finally, remove the FD from the set of open_fds. We do this last because
-        // |element| will not remain valid after a call to erase.
-        open_fds.erase(*element);
+        ++it;
       }
     }
 
-    if (open_fds.size() > 0) {
-      // The zygote has opened new file descriptors since our last inspection.
-      // We warn about this condition and add them to our table.
-      //
-      // TODO(narayan): This will be an error in a future android release.
-      // error = true;
-      // ALOGW("Zygote opened %zd new file descriptor(s).", open_fds.size());
-
-      // TODO(narayan): This code will be removed in a future android release.
-      std::set<int>::const_iterator it;
-      for (it = open_fds.begin(); it != open_fds.end(); ++it) {
-        const int fd = (*it);
+    std::vector<int>::const_iterator fd_it;
+    for (fd_it = open_fds.begin(); fd_it != open_fds.end(); ++fd_it) {
+      const int fd = (*fd_it);
+      it = open_fd_map_.find(fd);
+      if (it == open_fd_map_.end()) {
+        // The zygote has opened a new file descriptor since our last
+        // inspection. Add it to our table.
+        //
+        // TODO(narayan): This will be an error in a future android release.
         FileDescriptorInfo* info = FileDescriptorInfo::createFromFd(fd);
         if (info == NULL) {
           // A newly opened file is not on the whitelist. Flag an error and
           // continue.
           error = true;
         } else {
-          // Track the newly opened file.
           open_fd_map_[fd] = info;
         }
+      } else if (!it->second->Restat()) {
+        // The file descriptor refers to a different description. We must
+        // update our entry in the table.
+        delete it->second;
+        it->second = FileDescriptorInfo::createFromFd(fd);
+        if (it->second == NULL) {
+          // The descriptor no longer refers to a whitelisted file. We flag
+          // an error and remove it from the list of files we're tracking.
+          error = true;
+          open_fd_map_.erase(it);
+        }
       }
     }
 
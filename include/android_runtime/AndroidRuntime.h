@@ -53,6 +53,13 @@ public:
     static int registerNativeMethods(JNIEnv* env,
         const char* className, const JNINativeMethod* gMethods, int numMethods);
 
+    /**
+     * Register a set of methods in the specified class, skipping those the
+     * class doesn't declare. Returns the number of methods registered.
+     */
+    static int registerOptionalNativeMethods(JNIEnv* env,
+        const char* className, const JNINativeMethod* gMethods, int numMethods);
+
     /**
      * Call a class's static main method with the given arguments,
      */
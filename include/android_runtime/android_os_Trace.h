@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _ANDROID_OS_TRACE_H
+#define _ANDROID_OS_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/*
+ * Buffered tracing.  Markers for the tags set with setBufferedTraceTags() are
+ * stored in a lock-free ring owned by the calling thread instead of being
+ * written to trace_marker, and a collector drains all rings in bulk.  Other
+ * tags still go through atrace.
+ */
+struct BufferedTraceEvent {
+    int64_t timestamp;      // systemTime(SYSTEM_TIME_MONOTONIC)
+    int64_t value;          // counter value, 0 for sections
+    int32_t tid;
+    char type;              // 'B', 'E' or 'C', as in trace_marker
+    char name[43];          // NUL terminated, truncated if longer
+};
+
+void setBufferedTraceTags(uint64_t tags);
+uint64_t getBufferedTraceTags();
+
+void traceBegin(uint64_t tag, const char* name);
+void traceEnd(uint64_t tag);
+void traceCounter(uint64_t tag, const char* name, int64_t value);
+
+/*
+ * Moves up to maxEvents pending events into outEvents, thread by thread and in
+ * order within each thread.  Returns the number of events copied and adds the
+ * events dropped on full rings since the last drain to outDropped.
+ */
+size_t drainBufferedTraceEvents(BufferedTraceEvent* outEvents, size_t maxEvents,
+        uint64_t* outDropped);
+
+} // namespace android
+
+#endif // _ANDROID_OS_TRACE_H
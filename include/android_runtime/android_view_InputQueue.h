@@ -67,6 +67,9 @@ private:
 
     void detachLooperLocked();
 
+    void finishEvents(JNIEnv* env, jobject inputQueueObj,
+            const Vector<key_value_pair_t<InputEvent*, bool> >& events);
+
     jobject mInputQueueWeakGlobal;
     int mDispatchReadFd;
     int mDispatchWriteFd;
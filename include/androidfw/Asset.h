@@ -312,6 +312,7 @@ private:
     class StreamingZipInflater* mZipInflater;  // for streaming large compressed assets
 
     unsigned char*  mBuf;       // for getBuffer()
+    String8     mBufKey;        // set if mBuf is shared with other assets
 };
 
 // need: shared mmap version?
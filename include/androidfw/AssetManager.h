@@ -153,6 +153,14 @@ public:
      */
     Asset* open(const char* fileName, AccessMode mode);
 
+    /*
+     * Open several assets at once, as if by open().  The asset paths are
+     * snapshotted once for the whole batch.  outAssets[i] is set to the
+     * opened asset or NULL.  Returns the number of assets opened.
+     */
+    size_t openBatch(const char* const* fileNames, size_t count, AccessMode mode,
+            Asset** outAssets);
+
     /*
      * Open a non-asset file as an asset.
      *
@@ -233,6 +241,21 @@ public:
     bool createIdmap(const char* targetApkPath, const char* overlayApkPath,
         uint32_t targetCrc, uint32_t overlayCrc, uint32_t** outData, size_t* outSize);
 
+    /**
+     * Same as above, against the resources of the target package already
+     * loaded with loadResTable(). The target table is only read, so it can be
+     * shared to create the idmaps of several overlays in parallel.
+     */
+    bool createIdmap(const ResTable& targetTable, const char* targetApkPath,
+        const char* overlayApkPath, uint32_t targetCrc, uint32_t overlayCrc,
+        uint32_t** outData, size_t* outSize);
+
+    /**
+     * Load the resources.arsc of an APK alone, without the framework
+     * resources nor any overlay.
+     */
+    bool loadResTable(const char* apkPath, ResTable* outTable);
+
 private:
     struct asset_path
     {
@@ -247,6 +270,9 @@ private:
         const asset_path& path);
     Asset* openNonAssetInPathLocked(const char* fileName, AccessMode mode,
         const asset_path& path);
+    Vector<asset_path> getAssetPathsForOpen();
+    Asset* openNonAssetInAnyPath(const Vector<asset_path>& assetPaths,
+        const char* fileName, AccessMode mode, int32_t* outCookie);
     Asset* openInLocaleVendorLocked(const char* fileName, AccessMode mode,
         const asset_path& path, const char* locale, const char* vendor);
     String8 createPathNameLocked(const asset_path& path, const char* locale,
@@ -360,11 +386,16 @@ private:
         void closeZip(int idx);
 
         int getIndex(const String8& zip) const;
+
+        // Protects the two vectors, zips are opened by concurrent open() calls
+        Mutex mLock;
         mutable Vector<String8> mZipPath;
         mutable Vector<sp<SharedZip> > mZipFile;
     };
 
-    // Protect all internal state.
+    // Protect all internal state, except for the ZipSet and the path cache.
+    // open() and openNonAsset() only take it to copy mAssetPaths, the
+    // openNonAssetInPathLocked() path they run doesn't touch the rest.
     mutable Mutex   mLock;
 
     ZipSet          mZipSet;
@@ -388,6 +419,17 @@ private:
     CacheMode       mCacheMode;         // is the cache enabled?
     bool            mCacheValid;        // clear when locale or vendor changes
     SortedVector<AssetDir::FileInfo> mCache;
+
+    /*
+     * The index of the asset path in which open() and openNonAsset() last
+     * found each file, or -1 if none has it, so that the other paths aren't
+     * probed for it again. Only used when all the asset paths are Zip files,
+     * whose entries don't change once they're opened, and cleared when paths
+     * are added.
+     */
+    Mutex           mPathCacheLock;
+    KeyedVector<String8, ssize_t> mPathCache;
+    size_t          mPathCacheAssetPathCount;
 };
 
 }; // namespace android
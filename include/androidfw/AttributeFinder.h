@@ -63,6 +63,7 @@ public:
 private:
     void jumpToClosestAttribute(uint32_t packageId);
     void markCurrentPackageId(uint32_t packageId);
+    void skipAttributesBefore(uint32_t attr);
 
     bool mFirstTime;
     Iterator mBegin;
@@ -141,6 +142,47 @@ void BackTrackingAttributeFinder<Derived, Iterator>::markCurrentPackageId(const
     }
 }
 
+/**
+ * Moves past the attributes of the current package that are smaller than attr,
+ * in steps doubling while they stay so, instead of one at a time. Long lists
+ * searched for few attributes, such as the bag of a theme, are then walked
+ * over in logarithmic time.
+ *
+ * The attributes before one of the same package are of that package too, and
+ * smaller than it, so none of the skipped ones starts a new package nor
+ * matches.
+ */
+template <typename Derived, typename Iterator>
+void BackTrackingAttributeFinder<Derived, Iterator>::skipAttributesBefore(const uint32_t attr) {
+    const uint32_t packageId = getPackage(attr);
+    size_t step = 1;
+    for (;;) {
+        bool skip = false;
+        if (static_cast<size_t>(mEnd - mCurrent) > step) {
+            const Iterator probe = mCurrent + step;
+            const uint32_t probeAttr = static_cast<const Derived*>(this)->getAttribute(probe);
+            if (getPackage(probeAttr) == packageId && probeAttr < attr) {
+                mCurrent = probe;
+                mCurrentAttr = probeAttr;
+                skip = true;
+            }
+        }
+
+        if (skip) {
+            step *= 2;
+        } else if (step > 1) {
+            // Overshot, start again with small steps from where we are.
+            step = 1;
+        } else {
+            break;
+        }
+    }
+
+    if (mCurrent > mLargest) {
+        mLargest = mCurrent;
+    }
+}
+
 template <typename Derived, typename Iterator>
 Iterator BackTrackingAttributeFinder<Derived, Iterator>::find(uint32_t attr) {
     if (!(mBegin < mEnd)) {
@@ -165,6 +207,11 @@ Iterator BackTrackingAttributeFinder<Derived, Iterator>::find(uint32_t attr) {
         mLastPackageId = needlePackageId;
     }
 
+    if (mCurrent != mEnd && getPackage(mCurrentAttr) == needlePackageId
+            && mCurrentAttr < attr) {
+        skipAttributesBefore(attr);
+    }
+
     // Walk through the xml attributes looking for the requested attribute.
     while (mCurrent != mEnd) {
         const uint32_t haystackPackageId = getPackage(mCurrentAttr);
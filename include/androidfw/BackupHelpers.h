@@ -82,6 +82,13 @@ public:
      */
     status_t WriteEntityData(const void* data, size_t size);
 
+    /* Like WriteEntityData, but copies size bytes from the current position of
+     * fd in the kernel with sendfile(2).  Returns INVALID_OPERATION, without
+     * having written anything, when the output does not support that; the
+     * caller should then fall back to WriteEntityData.
+     */
+    status_t WriteEntityDataFromFd(int fd, size_t size);
+
     void SetKeyPrefix(const String8& keyPrefix);
 
 private:
@@ -140,6 +147,10 @@ int write_tarfile(const String8& packageName, const String8& domain,
         const String8& rootPath, const String8& filePath, off_t* outSize,
         BackupDataWriter* outputStream);
 
+// The CRC-32 of zlib's crc32(), as stored in the snapshots: pass 0 as the crc
+// of the first block and the returned value for the following ones.
+uint32_t backup_crc32(uint32_t crc, const uint8_t* p, size_t len);
+
 class RestoreHelperBase
 {
 public:
@@ -20,6 +20,7 @@
 #include <cutils/log.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <binder/Parcel.h>
 #include <utils/String8.h>
@@ -39,13 +40,17 @@
 namespace android {
 
 /**
- * This class stores a set of rows from a database in a buffer. The begining of the
- * window has first chunk of RowSlots, which are offsets to the row directory, followed by
- * an offset to the next chunk in a linked-list of additional chunk of RowSlots in case
- * the pre-allocated chunk isn't big enough to refer to all rows. Each row directory has a
+ * This class stores a set of rows from a database in a buffer. The end of the
+ * window has the index of the RowSlots, which are offsets to the row directory: the
+ * slot of row N is the Nth from the end, so the index grows down towards the data
+ * that grows up from the beginning of the window. Each row directory has a
  * FieldSlot per column, which has the size, offset, and type of the data for that field.
  * Note that the data types come from sqlite3.h.
  *
+ * Windows may also be in the former layout, where the beginning of the window has
+ * a first chunk of RowSlots followed by an offset to the next chunk in a linked-list
+ * of additional chunks. Those are still read, see Header::firstChunkOffset.
+ *
  * Strings are stored in UTF-8.
  */
 class CursorWindow {
@@ -87,7 +92,7 @@ public:
 
     inline String8 name() { return mName; }
     inline size_t size() { return mSize; }
-    inline size_t freeSpace() { return mSize - mHeader->freeOffset; }
+    inline size_t freeSpace() { return getRowIndexOffset() - mHeader->freeOffset; }
     inline uint32_t getNumRows() { return mHeader->numRows; }
     inline uint32_t getNumColumns() { return mHeader->numColumns; }
 
@@ -101,6 +106,36 @@ public:
     status_t allocRow();
     status_t freeLastRow();
 
+    /**
+     * Allocates a row along with dataSize bytes for the strings and blobs of its
+     * fields, and returns its field directory, initialized with null entries.
+     * The fields are then set with the putField*() calls, which don't look the
+     * row up and pack the data into the reservation in order.
+     * Returns NULL without allocating anything if the whole row doesn't fit.
+     */
+    FieldSlot* allocRowWithData(size_t dataSize, uint32_t* outDataOffset);
+
+    inline void putFieldLong(FieldSlot* fieldDir, uint32_t column, int64_t value) {
+        fieldDir[column].type = FIELD_TYPE_INTEGER;
+        fieldDir[column].data.l = value;
+    }
+
+    inline void putFieldDouble(FieldSlot* fieldDir, uint32_t column, double value) {
+        fieldDir[column].type = FIELD_TYPE_FLOAT;
+        fieldDir[column].data.d = value;
+    }
+
+    // Copies the value to *dataOffset, inside the reservation of allocRowWithData(),
+    // and advances it.
+    inline void putFieldBlobOrString(FieldSlot* fieldDir, uint32_t column, int32_t type,
+            const void* value, size_t size, uint32_t* dataOffset) {
+        memcpy(offsetToPtr(*dataOffset), value, size);
+        fieldDir[column].type = type;
+        fieldDir[column].data.buffer.offset = *dataOffset;
+        fieldDir[column].data.buffer.size = size;
+        *dataOffset += size;
+    }
+
     status_t putBlob(uint32_t row, uint32_t column, const void* value, size_t size);
     status_t putString(uint32_t row, uint32_t column, const char* value, size_t sizeIncludingNull);
     status_t putLong(uint32_t row, uint32_t column, int64_t value);
@@ -143,7 +178,8 @@ private:
         // Offset of the lowest unused byte in the window.
         uint32_t freeOffset;
 
-        // Offset of the first row slot chunk.
+        // Offset of the first row slot chunk, or 0 if the row slots are
+        // indexed from the end of the window.
         uint32_t firstChunkOffset;
 
         uint32_t numRows;
@@ -181,6 +217,11 @@ private:
      */
     uint32_t alloc(size_t size, bool aligned = false);
 
+    // Offset of the row slot of the last row, the end of the free space
+    inline uint32_t getRowIndexOffset() {
+        return mHeader->firstChunkOffset ? mSize : mSize - mHeader->numRows * sizeof(RowSlot);
+    }
+
     RowSlot* getRowSlot(uint32_t row);
     RowSlot* allocRowSlot();
 
@@ -32,6 +32,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <atomic>
+
 #include <android/configuration.h>
 
 namespace android {
@@ -522,11 +524,13 @@ private:
     void*                       mOwnedData;
     const ResStringPool_header* mHeader;
     size_t                      mSize;
-    mutable Mutex               mDecodeLock;
     const uint32_t*             mEntries;
     const uint32_t*             mEntryStyles;
     const void*                 mStrings;
-    char16_t mutable**          mCache;
+    // UTF-16 copies of the UTF-8 strings, decoded on first use. Both the
+    // table and its entries are published with compare-and-swap, readers
+    // never take a lock.
+    mutable std::atomic<std::atomic<char16_t*>*> mCache;
     uint32_t                    mStringPoolSize;    // number of uint16_t
     const uint32_t*             mStyles;
     uint32_t                    mStylePoolSize;    // number of uint32_t
@@ -1559,6 +1563,14 @@ public:
 
     void uninit();
 
+    /**
+     * Retrieve the bytes of all the resource tables of the process that are
+     * read in place, mapped from their APK, and of those that are copied to
+     * the heap, because they are compressed or misaligned in their APK or
+     * were added with copyData.
+     */
+    static void getGlobalTableSizes(size_t* outMappedSize, size_t* outCopiedSize);
+
     struct resource_name
     {
         const char16_t* package;
@@ -1625,12 +1637,18 @@ public:
      *
      * Note that this function -does- do reference traversal of the bag data.
      *
+     * Bags that are already computed are returned without taking the table's
+     * lock, so several threads can read them at once. The bag stays valid
+     * until unlockBag(), which must only be called if this succeeded.
+     *
      * @param resID The desired resource identifier.
      * @param outBag Filled inm with a pointer to the bag mappings.
+     * @param outTypeSpecFlags Optional, filled in with the flags of the bag.
      *
      * @return ssize_t Either a >= 0 bag count of negative error code.
      */
-    ssize_t lockBag(uint32_t resID, const bag_entry** outBag) const;
+    ssize_t lockBag(uint32_t resID, const bag_entry** outBag,
+            uint32_t* outTypeSpecFlags=NULL) const;
 
     void unlockBag(const bag_entry* bag) const;
 
@@ -1688,6 +1706,13 @@ public:
          */
         uint32_t getChangingConfigurations() const;
 
+        /**
+         * Returns a value that changes whenever the theme is modified, and that
+         * no other theme has, so that what is resolved against the theme can
+         * be cached.
+         */
+        inline uint32_t getGeneration() const { return mGeneration; }
+
         void dumpToLog() const;
         
     private:
@@ -1715,11 +1740,19 @@ public:
         const ResTable& mTable;
         package_info*   mPackages[Res_MAXPACKAGE];
         uint32_t        mTypeSpecFlags;
+        uint32_t        mGeneration;
     };
 
     void setParameters(const ResTable_config* params);
     void getParameters(ResTable_config* params) const;
 
+    /**
+     * Returns a value that changes whenever the resources or the parameters
+     * of the table change, and that no other table nor theme has, so that
+     * what is resolved from the table can be cached.
+     */
+    uint32_t getGeneration() const;
+
     // Retrieve an identifier (which can be passed to getResource)
     // for a given resource name.  The 'name' can be fully qualified
     // (<package>:<type>.<basename>) or the package or type components
@@ -1856,11 +1889,18 @@ private:
     struct bag_set;
     typedef Vector<Type*> TypeList;
 
+    // dataIsAllocated tells that data is already a heap copy, for
+    // getGlobalTableSizes()
     status_t addInternal(const void* data, size_t size, const void* idmapData, size_t idmapDataSize,
-            const int32_t cookie, bool copyData);
+            const int32_t cookie, bool copyData, bool dataIsAllocated=false);
 
     ssize_t getResourcePackageIndex(uint32_t resID) const;
 
+    // Returns the bag if it is already computed, without locking
+    ssize_t getCachedBag(uint32_t resID, const bag_entry** outBag,
+            uint32_t* outTypeSpecFlags) const;
+    void freeRetiredBagsLocked() const;
+
     status_t getEntry(
         const PackageGroup* packageGroup, int typeIndex, int entryIndex,
         const ResTable_config* config,
@@ -1876,6 +1916,14 @@ private:
     
     mutable Mutex               mLock;
 
+    // Number of threads using bags between lockBag() and unlockBag(), or the
+    // filtered configurations in getEntry(), which may not hold mLock. The
+    // ones replaced by setParameters() are only freed once there are none.
+    mutable int32_t             mBagReaders;
+
+    // See getGeneration().
+    uint32_t                    mGeneration;
+
     status_t                    mError;
 
     ResTable_config             mParams;
@@ -30,6 +30,12 @@ public:
     static const size_t INPUT_CHUNK_SIZE = 64 * 1024;
     static const size_t OUTPUT_CHUNK_SIZE = 64 * 1024;
 
+    // Compressed data at least this large is read in chunks of LARGE_INPUT_CHUNK_SIZE,
+    // so that fewer reads are made and the read-ahead of the next chunk has time to
+    // complete while the current one is inflated
+    static const size_t LARGE_INPUT_SIZE = 1024 * 1024;
+    static const size_t LARGE_INPUT_CHUNK_SIZE = 256 * 1024;
+
     // Flavor that pages in the compressed data from a fd
     StreamingZipInflater(int fd, off64_t compDataStart, size_t uncompSize, size_t compSize);
 
@@ -50,6 +56,7 @@ public:
 private:
     void initInflateState();
     int readNextChunk();
+    void readAheadNextChunk();
 
     // where to find the uncompressed data
     int mFd;
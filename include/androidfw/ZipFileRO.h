@@ -76,6 +76,11 @@ public:
 
     /*
      * Open an archive.
+     *
+     * The index of the entries is built by libziparchive from the central
+     * directory, in the memory of the calling process. AssetManager keeps
+     * the archive it opens in a SharedZip, so each process builds it once,
+     * and the apps inherit the framework's from the zygote.
      */
     static ZipFileRO* open(const char* zipFileName);
 
@@ -152,6 +157,12 @@ public:
      */
     bool uncompressEntry(ZipEntryRO entry, int fd) const;
 
+    /*
+     * The path the archive was opened from. Threads that need to read it at
+     * the same time open it again, rather than share this instance's fd.
+     */
+    const char* getFileName() const { return mFileName; }
+
     ~ZipFileRO();
 
 private:
@@ -27,6 +27,7 @@
 #include <androidfw/ZipUtils.h>
 #include <utils/Atomic.h>
 #include <utils/FileMap.h>
+#include <utils/KeyedVector.h>
 #include <utils/Log.h>
 #include <utils/threads.h>
 
@@ -52,6 +53,73 @@ static int32_t gCount = 0;
 static Asset* gHead = NULL;
 static Asset* gTail = NULL;
 
+/*
+ * The buffers compressed zip entries were expanded into, shared by all the
+ * assets open on the same entry so that each one is only inflated and held
+ * in memory once in the process.  Entries are keyed by file name, offset and
+ * length of the compressed data, and are freed when their last asset closes.
+ */
+struct InflatedBuffer {
+    unsigned char* buf;
+    int32_t refs;
+};
+
+static Mutex gInflatedLock;
+static KeyedVector<String8, InflatedBuffer> gInflatedBuffers;
+
+static String8 getInflatedBufferKey(const FileMap* map)
+{
+    return String8::format("%s:%lld:%zu", map->getFileName(),
+            (long long) map->getDataOffset(), map->getDataLength());
+}
+
+static unsigned char* acquireInflatedBuffer(const String8& key)
+{
+    AutoMutex _l(gInflatedLock);
+    ssize_t idx = gInflatedBuffers.indexOfKey(key);
+    if (idx < 0) {
+        return NULL;
+    }
+    InflatedBuffer& entry = gInflatedBuffers.editValueAt(idx);
+    entry.refs++;
+    return entry.buf;
+}
+
+/*
+ * Share a newly inflated buffer, or return the one that was shared while it
+ * was being inflated, in which case "buf" is freed.
+ */
+static unsigned char* shareInflatedBuffer(const String8& key, unsigned char* buf)
+{
+    AutoMutex _l(gInflatedLock);
+    ssize_t idx = gInflatedBuffers.indexOfKey(key);
+    if (idx >= 0) {
+        InflatedBuffer& entry = gInflatedBuffers.editValueAt(idx);
+        entry.refs++;
+        delete[] buf;
+        return entry.buf;
+    }
+    InflatedBuffer entry;
+    entry.buf = buf;
+    entry.refs = 1;
+    gInflatedBuffers.add(key, entry);
+    return buf;
+}
+
+static void releaseInflatedBuffer(const String8& key)
+{
+    AutoMutex _l(gInflatedLock);
+    ssize_t idx = gInflatedBuffers.indexOfKey(key);
+    if (idx < 0) {
+        return;
+    }
+    InflatedBuffer& entry = gInflatedBuffers.editValueAt(idx);
+    if (--entry.refs == 0) {
+        delete[] entry.buf;
+        gInflatedBuffers.removeItemsAt(idx);
+    }
+}
+
 int32_t Asset::getGlobalCount()
 {
     AutoMutex _l(gAssetLock);
@@ -825,7 +893,12 @@ void _CompressedAsset::close(void)
         mMap = NULL;
     }
 
-    delete[] mBuf;
+    if (!mBufKey.isEmpty()) {
+        releaseInflatedBuffer(mBufKey);
+        mBufKey = String8();
+    } else {
+        delete[] mBuf;
+    }
     mBuf = NULL;
 
     delete mZipInflater;
@@ -841,15 +914,26 @@ void _CompressedAsset::close(void)
  * Get a pointer to a read-only buffer of data.
  *
  * The first time this is called, we expand the compressed data into a
- * buffer.
+ * buffer.  Buffers of mapped zip entries are shared with the other assets
+ * open on the same entry.
  */
 const void* _CompressedAsset::getBuffer(bool)
 {
     unsigned char* buf = NULL;
+    String8 key;
 
     if (mBuf != NULL)
         return mBuf;
 
+    if (mMap != NULL && mMap->getFileName() != NULL) {
+        key = getInflatedBufferKey(mMap);
+        buf = acquireInflatedBuffer(key);
+        if (buf != NULL) {
+            mBufKey = key;
+            goto done;
+        }
+    }
+
     /*
      * Allocate a buffer and read the file into it.
      */
@@ -880,6 +964,12 @@ const void* _CompressedAsset::getBuffer(bool)
             goto bail;
     }
 
+    if (!key.isEmpty()) {
+        buf = shareInflatedBuffer(key, buf);
+        mBufKey = key;
+    }
+
+done:
     /*
      * Success - now that we have the full asset in RAM we
      * no longer need the streaming inflater
@@ -38,6 +38,7 @@
 #include <cutils/trace.h>
 #endif
 
+#include <algorithm>
 #include <assert.h>
 #include <dirent.h>
 #include <errno.h>
@@ -152,7 +153,7 @@ int32_t AssetManager::getGlobalCount()
 AssetManager::AssetManager(CacheMode cacheMode)
     : mLocale(NULL), mVendor(NULL),
       mResources(NULL), mConfig(new ResTable_config),
-      mCacheMode(cacheMode), mCacheValid(false)
+      mCacheMode(cacheMode), mCacheValid(false), mPathCacheAssetPathCount(0)
 {
     int count = android_atomic_inc(&gCount) + 1;
     if (kIsDebug) {
@@ -312,26 +313,43 @@ bool AssetManager::addOverlayPath(const String8& packagePath, int32_t* cookie)
 bool AssetManager::createIdmap(const char* targetApkPath, const char* overlayApkPath,
         uint32_t targetCrc, uint32_t overlayCrc, uint32_t** outData, size_t* outSize)
 {
-    AutoMutex _l(mLock);
-    const String8 paths[2] = { String8(targetApkPath), String8(overlayApkPath) };
-    ResTable tables[2];
-
-    for (int i = 0; i < 2; ++i) {
-        asset_path ap;
-        ap.type = kFileTypeRegular;
-        ap.path = paths[i];
-        Asset* ass = openNonAssetInPathLocked("resources.arsc", Asset::ACCESS_BUFFER, ap);
-        if (ass == NULL) {
-            ALOGW("failed to find resources.arsc in %s\n", ap.path.string());
-            return false;
-        }
-        tables[i].add(ass);
+    ResTable targetTable;
+    if (!loadResTable(targetApkPath, &targetTable)) {
+        return false;
     }
+    return createIdmap(targetTable, targetApkPath, overlayApkPath, targetCrc, overlayCrc,
+            outData, outSize);
+}
 
-    return tables[0].createIdmap(tables[1], targetCrc, overlayCrc,
+bool AssetManager::createIdmap(const ResTable& targetTable, const char* targetApkPath,
+        const char* overlayApkPath, uint32_t targetCrc, uint32_t overlayCrc,
+        uint32_t** outData, size_t* outSize)
+{
+    ResTable overlayTable;
+    if (!loadResTable(overlayApkPath, &overlayTable)) {
+        return false;
+    }
+    return targetTable.createIdmap(overlayTable, targetCrc, overlayCrc,
             targetApkPath, overlayApkPath, (void**)outData, outSize) == NO_ERROR;
 }
 
+bool AssetManager::loadResTable(const char* apkPath, ResTable* outTable)
+{
+    AutoMutex _l(mLock);
+    asset_path ap;
+    ap.type = kFileTypeRegular;
+    ap.path = String8(apkPath);
+    Asset* ass = openNonAssetInPathLocked("resources.arsc", Asset::ACCESS_BUFFER, ap);
+    if (ass == NULL) {
+        ALOGW("failed to find resources.arsc in %s\n", ap.path.string());
+        return false;
+    }
+    // The table outlives the asset
+    status_t err = outTable->add(ass, -1, true);
+    delete ass;
+    return err == NO_ERROR;
+}
+
 bool AssetManager::addDefaultAssets()
 {
     const char* root = getenv("ANDROID_ROOT");
@@ -498,33 +516,33 @@ void AssetManager::getConfiguration(ResTable_config* outConfig) const
  */
 Asset* AssetManager::open(const char* fileName, AccessMode mode)
 {
-    AutoMutex _l(mLock);
-
-    LOG_FATAL_IF(mAssetPaths.size() == 0, "No assets added to AssetManager");
-
-
-    if (mCacheMode != CACHE_OFF && !mCacheValid)
-        loadFileNameCacheLocked();
+    const Vector<asset_path> assetPaths = getAssetPathsForOpen();
 
     String8 assetName(kAssetsRoot);
     assetName.appendPath(fileName);
 
-    /*
-     * For each top-level asset path, search for the asset.
-     */
+    return openNonAssetInAnyPath(assetPaths, assetName.string(), mode, NULL);
+}
 
-    size_t i = mAssetPaths.size();
-    while (i > 0) {
-        i--;
-        ALOGV("Looking for asset '%s' in '%s'\n",
-                assetName.string(), mAssetPaths.itemAt(i).path.string());
-        Asset* pAsset = openNonAssetInPathLocked(assetName.string(), mode, mAssetPaths.itemAt(i));
-        if (pAsset != NULL) {
-            return pAsset != kExcludedAsset ? pAsset : NULL;
+size_t AssetManager::openBatch(const char* const* fileNames, size_t count, AccessMode mode,
+        Asset** outAssets)
+{
+    const Vector<asset_path> assetPaths = getAssetPathsForOpen();
+
+    size_t opened = 0;
+    for (size_t i = 0; i < count; i++) {
+        outAssets[i] = NULL;
+        if (fileNames[i] == NULL) {
+            continue;
+        }
+        String8 assetName(kAssetsRoot);
+        assetName.appendPath(fileNames[i]);
+        outAssets[i] = openNonAssetInAnyPath(assetPaths, assetName.string(), mode, NULL);
+        if (outAssets[i] != NULL) {
+            opened++;
         }
     }
-
-    return NULL;
+    return opened;
 }
 
 /*
@@ -535,31 +553,9 @@ Asset* AssetManager::open(const char* fileName, AccessMode mode)
  */
 Asset* AssetManager::openNonAsset(const char* fileName, AccessMode mode, int32_t* outCookie)
 {
-    AutoMutex _l(mLock);
-
-    LOG_FATAL_IF(mAssetPaths.size() == 0, "No assets added to AssetManager");
-
-
-    if (mCacheMode != CACHE_OFF && !mCacheValid)
-        loadFileNameCacheLocked();
-
-    /*
-     * For each top-level asset path, search for the asset.
-     */
+    const Vector<asset_path> assetPaths = getAssetPathsForOpen();
 
-    size_t i = mAssetPaths.size();
-    while (i > 0) {
-        i--;
-        ALOGV("Looking for non-asset '%s' in '%s'\n", fileName, mAssetPaths.itemAt(i).path.string());
-        Asset* pAsset = openNonAssetInPathLocked(
-            fileName, mode, mAssetPaths.itemAt(i));
-        if (pAsset != NULL) {
-            if (outCookie != NULL) *outCookie = static_cast<int32_t>(i + 1);
-            return pAsset != kExcludedAsset ? pAsset : NULL;
-        }
-    }
-
-    return NULL;
+    return openNonAssetInAnyPath(assetPaths, fileName, mode, outCookie);
 }
 
 Asset* AssetManager::openNonAsset(const int32_t cookie, const char* fileName, AccessMode mode)
@@ -828,7 +824,12 @@ const ResTable& AssetManager::getResources(bool required) const
 bool AssetManager::isUpToDate()
 {
     AutoMutex _l(mLock);
-    return mZipSet.isUpToDate();
+    if (!mZipSet.isUpToDate()) {
+        AutoMutex _pl(mPathCacheLock);
+        mPathCache.clear();
+        return false;
+    }
+    return true;
 }
 
 void AssetManager::getLocales(Vector<String8>* locales) const
@@ -906,6 +907,105 @@ Asset* AssetManager::openNonAssetInPathLocked(const char* fileName, AccessMode m
     return pAsset;
 }
 
+/*
+ * Take a snapshot of the asset paths for open() and openNonAsset(), which
+ * search them without holding mLock.  Paths are only ever appended, and the
+ * Vector is shared rather than copied.
+ */
+Vector<asset_path> AssetManager::getAssetPathsForOpen()
+{
+    AutoMutex _l(mLock);
+
+    LOG_FATAL_IF(mAssetPaths.size() == 0, "No assets added to AssetManager");
+
+    if (mCacheMode != CACHE_OFF && !mCacheValid)
+        loadFileNameCacheLocked();
+
+    return mAssetPaths;
+}
+
+/*
+ * Open a non-asset file, searching for it in each asset path from the last
+ * one added.
+ *
+ * This runs without mLock: opening an entry only reads the asset path and
+ * the zip, and the ZipSet and the path cache have locks of their own.
+ */
+Asset* AssetManager::openNonAssetInAnyPath(const Vector<asset_path>& assetPaths,
+    const char* fileName, AccessMode mode, int32_t* outCookie)
+{
+    static const size_t kMaxPathCacheSize = 1024;
+
+    bool cacheable = true;
+    for (size_t i = 0; i < assetPaths.size(); i++) {
+        if (assetPaths.itemAt(i).type != kFileTypeRegular) {
+            cacheable = false;
+            break;
+        }
+    }
+
+    const String8 name(fileName);
+    if (cacheable) {
+        ssize_t which = NAME_NOT_FOUND;
+        {
+            AutoMutex _l(mPathCacheLock);
+            if (mPathCacheAssetPathCount != assetPaths.size()) {
+                mPathCache.clear();
+                mPathCacheAssetPathCount = assetPaths.size();
+            }
+            const ssize_t idx = mPathCache.indexOfKey(name);
+            if (idx >= 0) {
+                which = mPathCache.valueAt(idx);
+                if (which < 0) {
+                    return NULL;
+                }
+            }
+        }
+        if (which >= 0) {
+            Asset* pAsset = openNonAssetInPathLocked(fileName, mode, assetPaths.itemAt(which));
+            if (pAsset != NULL) {
+                if (outCookie != NULL) *outCookie = static_cast<int32_t>(which + 1);
+                return pAsset != kExcludedAsset ? pAsset : NULL;
+            }
+            // Couldn't be opened this time, search all the paths again
+        }
+    }
+
+    /*
+     * For each top-level asset path, search for the asset.
+     */
+
+    ssize_t found = -1;
+    Asset* pAsset = NULL;
+    size_t i = assetPaths.size();
+    while (i > 0) {
+        i--;
+        ALOGV("Looking for non-asset '%s' in '%s'\n", fileName, assetPaths.itemAt(i).path.string());
+        pAsset = openNonAssetInPathLocked(fileName, mode, assetPaths.itemAt(i));
+        if (pAsset != NULL) {
+            found = i;
+            break;
+        }
+    }
+
+    if (cacheable) {
+        AutoMutex _l(mPathCacheLock);
+        // Paths may have been added while searching
+        if (mPathCacheAssetPathCount == assetPaths.size()) {
+            if (mPathCache.size() >= kMaxPathCacheSize) {
+                mPathCache.clear();
+            }
+            mPathCache.replaceValueFor(name, found);
+        }
+    }
+
+    if (pAsset != NULL) {
+        if (outCookie != NULL) *outCookie = static_cast<int32_t>(found + 1);
+        return pAsset != kExcludedAsset ? pAsset : NULL;
+    }
+    return NULL;
+}
+
 /*
  * Open an asset, searching for it in the directory hierarchy for the
  * specified app.
@@ -1437,6 +1537,25 @@ bool AssetManager::scanAndMergeDirLocked(SortedVector<AssetDir::FileInfo>* pMerg
     return true;
 }
 
+/*
+ * Sort the files found in a directory and add them to "pContents".
+ *
+ * Adding them to the SortedVector as they're found keeps it sorted at every
+ * step, which moves every entry after the insertion point each time: that's
+ * quadratic in the size of the directory.  Appending them once sorted
+ * doesn't move anything.  The sort is stable so that, as before, the last
+ * entry found with a given name is the one kept.
+ */
+static void addSortedFileInfos(SortedVector<AssetDir::FileInfo>* pContents,
+    Vector<AssetDir::FileInfo>* pFound)
+{
+    AssetDir::FileInfo* found = pFound->editArray();
+    std::stable_sort(found, found + pFound->size());
+    for (size_t i = 0; i < pFound->size(); i++) {
+        pContents->add(found[i]);
+    }
+}
+
 /*
  * Scan the contents of the specified directory, and stuff what we find
  * into a newly-allocated vector.
@@ -1451,6 +1570,7 @@ bool AssetManager::scanAndMergeDirLocked(SortedVector<AssetDir::FileInfo>* pMerg
 SortedVector<AssetDir::FileInfo>* AssetManager::scanDirLocked(const String8& path)
 {
     SortedVector<AssetDir::FileInfo>* pContents = NULL;
+    Vector<AssetDir::FileInfo> found;
     DIR* dir;
     struct dirent* entry;
     FileType fileType;
@@ -1492,10 +1612,11 @@ SortedVector<AssetDir::FileInfo>* AssetManager::scanDirLocked(const String8& pat
         if (strcasecmp(info.getFileName().getPathExtension().string(), ".gz") == 0)
             info.setFileName(info.getFileName().getBasePath());
         info.setSourceName(path.appendPathCopy(info.getFileName()));
-        pContents->add(info);
+        found.add(info);
     }
 
     closedir(dir);
+    addSortedFileInfos(pContents, &found);
     return pContents;
 }
 
@@ -1510,8 +1631,9 @@ bool AssetManager::scanAndMergeZipLocked(SortedVector<AssetDir::FileInfo>* pMerg
     const asset_path& ap, const char* rootDir, const char* baseDirName)
 {
     ZipFileRO* pZip;
-    Vector<String8> dirs;
+    SortedVector<String8> dirs;
     AssetDir::FileInfo info;
+    Vector<AssetDir::FileInfo> found;
     SortedVector<AssetDir::FileInfo> contents;
     String8 sourceName, zipName, dirName;
 
@@ -1581,20 +1703,12 @@ bool AssetManager::scanAndMergeZipLocked(SortedVector<AssetDir::FileInfo>* pMerg
                 info.setSourceName(
                     createZipSourceNameLocked(zipName, dirName, info.getFileName()));
 
-                contents.add(info);
+                found.add(info);
                 //printf("FOUND: file '%s'\n", info.getFileName().string());
             } else {
                 /* this is a subdir; add it if we don't already have it*/
                 String8 subdirName(cp, nextSlash - cp);
-                size_t j;
-                size_t N = dirs.size();
-
-                for (j = 0; j < N; j++) {
-                    if (subdirName == dirs[j]) {
-                        break;
-                    }
-                }
-                if (j == N) {
+                if (dirs.indexOf(subdirName) < 0) {
                     dirs.add(subdirName);
                 }
 
@@ -1612,9 +1726,10 @@ bool AssetManager::scanAndMergeZipLocked(SortedVector<AssetDir::FileInfo>* pMerg
         info.set(dirs[i], kFileTypeDirectory);
         info.setSourceName(
             createZipSourceNameLocked(zipName, dirName, info.getFileName()));
-        contents.add(info);
+        found.add(info);
     }
 
+    addSortedFileInfos(&contents, &found);
     mergeInfoLocked(pMergedInfo, &contents);
 
     return true;
@@ -2026,6 +2141,7 @@ void AssetManager::ZipSet::closeZip(int idx)
  */
 ZipFileRO* AssetManager::ZipSet::getZip(const String8& path)
 {
+    AutoMutex _l(mLock);
     int idx = getIndex(path);
     sp<SharedZip> zip = mZipFile[idx];
     if (zip == NULL) {
@@ -2037,6 +2153,7 @@ ZipFileRO* AssetManager::ZipSet::getZip(const String8& path)
 
 Asset* AssetManager::ZipSet::getZipResourceTableAsset(const String8& path)
 {
+    AutoMutex _l(mLock);
     int idx = getIndex(path);
     sp<SharedZip> zip = mZipFile[idx];
     if (zip == NULL) {
@@ -2049,6 +2166,7 @@ Asset* AssetManager::ZipSet::getZipResourceTableAsset(const String8& path)
 Asset* AssetManager::ZipSet::setZipResourceTableAsset(const String8& path,
                                                  Asset* asset)
 {
+    AutoMutex _l(mLock);
     int idx = getIndex(path);
     sp<SharedZip> zip = mZipFile[idx];
     // doesn't make sense to call before previously accessing.
@@ -2057,6 +2175,7 @@ Asset* AssetManager::ZipSet::setZipResourceTableAsset(const String8& path,
 
 ResTable* AssetManager::ZipSet::getZipResourceTable(const String8& path)
 {
+    AutoMutex _l(mLock);
     int idx = getIndex(path);
     sp<SharedZip> zip = mZipFile[idx];
     if (zip == NULL) {
@@ -2069,6 +2188,7 @@ ResTable* AssetManager::ZipSet::getZipResourceTable(const String8& path)
 ResTable* AssetManager::ZipSet::setZipResourceTable(const String8& path,
                                                     ResTable* res)
 {
+    AutoMutex _l(mLock);
     int idx = getIndex(path);
     sp<SharedZip> zip = mZipFile[idx];
     // doesn't make sense to call before previously accessing.
@@ -2088,6 +2208,7 @@ ResTable* AssetManager::ZipSet::setZipResourceTable(const String8& path,
 
 bool AssetManager::ZipSet::isUpToDate()
 {
+    AutoMutex _l(mLock);
     const size_t N = mZipFile.size();
     for (size_t i=0; i<N; i++) {
         if (mZipFile[i] != NULL && !mZipFile[i]->isUpToDate()) {
@@ -2099,6 +2220,7 @@ bool AssetManager::ZipSet::isUpToDate()
 
 void AssetManager::ZipSet::addOverlay(const String8& path, const asset_path& overlay)
 {
+    AutoMutex _l(mLock);
     int idx = getIndex(path);
     sp<SharedZip> zip = mZipFile[idx];
     zip->addOverlay(overlay);
@@ -19,8 +19,10 @@
 #include <androidfw/BackupHelpers.h>
 #include <utils/ByteOrder.h>
 
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 
 #include <cutils/log.h>
@@ -168,6 +170,40 @@ BackupDataWriter::WriteEntityData(const void* data, size_t size)
     return NO_ERROR;
 }
 
+status_t
+BackupDataWriter::WriteEntityDataFromFd(int fd, size_t size)
+{
+    if (kIsDebug) ALOGD("Writing data from fd %d: size=%lu", fd, (unsigned long) size);
+
+    if (m_status != NO_ERROR) {
+        return m_status;
+    }
+
+    bool sentAny = false;
+    while (size > 0) {
+        ssize_t amt = sendfile(m_fd, fd, NULL, size);
+        if (amt < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!sentAny && (errno == EINVAL || errno == ENOSYS)) {
+                return INVALID_OPERATION;
+            }
+            m_status = errno;
+            if (kIsDebug) ALOGD("sendfile returned error %d (%s)", m_status, strerror(m_status));
+            return m_status;
+        } else if (amt == 0) {
+            // the source ended early
+            m_status = EIO;
+            return m_status;
+        }
+        sentAny = true;
+        m_pos += amt;
+        size -= amt;
+    }
+    return NO_ERROR;
+}
+
 void
 BackupDataWriter::SetKeyPrefix(const String8& keyPrefix)
 {
@@ -32,7 +32,11 @@
 #include <unistd.h>
 #include <utime.h>
 #include <fcntl.h>
-#include <zlib.h>
+#include <pthread.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
 
 #include <cutils/log.h>
 
@@ -304,6 +308,75 @@ write_update_file(BackupDataWriter* dataStream, const String8& key, char const*
     return err;
 }
 
+#if !defined(__ARM_FEATURE_CRC32)
+// Tables for slice-by-8 CRC-32, the same polynomial as zlib's crc32()
+static uint32_t crc_tables[8][256];
+static pthread_once_t crc_tables_once = PTHREAD_ONCE_INIT;
+
+static void
+init_crc_tables()
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+        }
+        crc_tables[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t c = crc_tables[t - 1][i];
+            crc_tables[t][i] = crc_tables[0][c & 0xff] ^ (c >> 8);
+        }
+    }
+}
+#endif
+
+// Drop-in replacement for zlib's crc32(), using the ARMv8 CRC32 instructions
+// when the build targets them and slice-by-8 tables otherwise.
+uint32_t
+backup_crc32(uint32_t crc, const uint8_t* p, size_t len)
+{
+    crc = ~crc;
+#if defined(__ARM_FEATURE_CRC32)
+    while (len > 0 && ((uintptr_t) p & 7) != 0) {
+        crc = __crc32b(crc, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        crc = __crc32d(crc, *(const uint64_t*) p);
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = __crc32b(crc, *p++);
+        len--;
+    }
+#else
+    pthread_once(&crc_tables_once, init_crc_tables);
+    while (len > 0 && ((uintptr_t) p & 3) != 0) {
+        crc = crc_tables[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        // little endian words, as on all Android targets
+        uint32_t one = *(const uint32_t*) p ^ crc;
+        uint32_t two = *(const uint32_t*) (p + 4);
+        crc = crc_tables[7][one & 0xff] ^ crc_tables[6][(one >> 8) & 0xff]
+                ^ crc_tables[5][(one >> 16) & 0xff] ^ crc_tables[4][one >> 24]
+                ^ crc_tables[3][two & 0xff] ^ crc_tables[2][(two >> 8) & 0xff]
+                ^ crc_tables[1][(two >> 16) & 0xff] ^ crc_tables[0][two >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = crc_tables[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+#endif
+    return ~crc;
+}
+
 static int
 compute_crc32(const char* file, FileRec* out) {
     int fd = open(file, O_RDONLY);
@@ -311,16 +384,23 @@ compute_crc32(const char* file, FileRec* out) {
         return -1;
     }
 
-    const int bufsize = 4*1024;
+    const int bufsize = 64*1024;
     int amt;
 
     char* buf = (char*)malloc(bufsize);
-    int crc = crc32(0L, Z_NULL, 0);
+    uint32_t crc = 0;
 
     lseek(fd, 0, SEEK_SET);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
     while ((amt = read(fd, buf, bufsize)) != 0) {
-        crc = crc32(crc, (Bytef*)buf, amt);
+        if (amt < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            free(buf);
+            return -1;
+        }
+        crc = backup_crc32(crc, (const uint8_t*)buf, amt);
     }
 
     close(fd);
@@ -330,6 +410,17 @@ compute_crc32(const char* file, FileRec* out) {
     return NO_ERROR;
 }
 
+// Whether a file still has the metadata recorded for it in a snapshot.
+// Snapshots from before nanosecond mtimes were recorded hold 0 there, so for
+// those only the seconds are compared.
+static bool
+same_file_metadata(const FileState& snap, const FileState& cur)
+{
+    return snap.modTime_sec == cur.modTime_sec
+            && (snap.modTime_nsec == 0 || snap.modTime_nsec == cur.modTime_nsec)
+            && snap.mode == cur.mode && snap.size == cur.size;
+}
+
 int
 back_up_files(int oldSnapshotFD, BackupDataWriter* dataStream, int newSnapshotFD,
         char const* const* files, char const* const* keys, int fileCount)
@@ -360,8 +451,7 @@ back_up_files(int oldSnapshotFD, BackupDataWriter* dataStream, int newSnapshotFD
         } else {
             r.deleted = false;
             r.s.modTime_sec = st.st_mtime;
-            r.s.modTime_nsec = 0; // workaround sim breakage
-            //r.s.modTime_nsec = st.st_mtime_nsec;
+            r.s.modTime_nsec = st.st_mtim.tv_nsec;
             r.s.mode = st.st_mode;
             r.s.size = st.st_size;
 
@@ -370,8 +460,14 @@ back_up_files(int oldSnapshotFD, BackupDataWriter* dataStream, int newSnapshotFD
                 return -1;
             }
 
-            // compute the CRC
-            if (compute_crc32(file, &r) != NO_ERROR) {
+            // A file whose metadata matches the snapshot down to the nanosecond
+            // is unchanged, so keep its CRC instead of reading it all again.
+            // Coarse or legacy timestamps are ambiguous and get rehashed.
+            ssize_t oldIndex = oldSnapshot.indexOfKey(key);
+            if (oldIndex >= 0 && oldSnapshot.valueAt(oldIndex).modTime_nsec != 0
+                    && same_file_metadata(oldSnapshot.valueAt(oldIndex), r.s)) {
+                r.s.crc32 = oldSnapshot.valueAt(oldIndex).crc32;
+            } else if (compute_crc32(file, &r) != NO_ERROR) {
                 ALOGW("Unable to open file %s", file);
                 continue;
             }
@@ -408,8 +504,7 @@ back_up_files(int oldSnapshotFD, BackupDataWriter* dataStream, int newSnapshotFD
                     f.modTime_sec, f.modTime_nsec, f.mode, f.size, f.crc32);
             LOGP("  new: modTime=%d,%d mode=%04o size=%-3d crc32=0x%08x",
                     g.s.modTime_sec, g.s.modTime_nsec, g.s.mode, g.s.size, g.s.crc32);
-            if (f.modTime_sec != g.s.modTime_sec || f.modTime_nsec != g.s.modTime_nsec
-                    || f.mode != g.s.mode || f.size != g.s.size || f.crc32 != g.s.crc32) {
+            if (!same_file_metadata(f, g.s) || f.crc32 != g.s.crc32) {
                 int fd = open(g.file.string(), O_RDONLY);
                 if (fd < 0) {
                     ALOGE("Unable to read file for backup: %s", g.file.string());
@@ -477,6 +572,26 @@ void send_tarfile_chunk(BackupDataWriter* writer, const char* buffer, size_t siz
     if (size != 0) writer->WriteEntityData(buffer, size);
 }
 
+// Read exactly size bytes of file data; a short file is an error.
+static int read_tarfile_data(int fd, char* buf, size_t size, const String8& filepath) {
+    while (size > 0) {
+        ssize_t nRead = read(fd, buf, size);
+        if (nRead < 0) {
+            if (errno == EINTR) continue;
+            int err = errno;
+            ALOGE("Unable to read file [%s], err=%d (%s)", filepath.string(),
+                    err, strerror(err));
+            return err;
+        } else if (nRead == 0) {
+            ALOGE("EOF but expect %zu more bytes in [%s]", size, filepath.string());
+            return EIO;
+        }
+        buf += nRead;
+        size -= nRead;
+    }
+    return 0;
+}
+
 int write_tarfile(const String8& packageName, const String8& domain,
         const String8& rootpath, const String8& filepath, off_t* outSize,
         BackupDataWriter* writer)
@@ -538,7 +653,6 @@ int write_tarfile(const String8& packageName, const String8& domain,
     // Measure case: we've returned the size; now return without moving data
     if (!writer) return 0;
 
-    // !!! TODO: use mmap when possible to avoid churning the buffer cache
     // !!! TODO: this will break with symlinks; need to use readlink(2)
     int fd = open(filepath.string(), O_RDONLY);
     if (fd < 0) {
@@ -547,8 +661,16 @@ int write_tarfile(const String8& packageName, const String8& domain,
         return err;
     }
 
-    // read/write up to this much at a time.
-    const size_t BUFSIZE = 32 * 1024;
+    // read/write up to this much at a time: enough for the headers, and for
+    // the whole of a file up to MAX_BUFSIZE so that it goes out in one chunk.
+    const size_t MIN_BUFSIZE = 32 * 1024;
+    const size_t MAX_BUFSIZE = 256 * 1024;
+    size_t BUFSIZE = MIN_BUFSIZE;
+    if (s.st_size > (off64_t) MAX_BUFSIZE) {
+        BUFSIZE = MAX_BUFSIZE;
+    } else if (s.st_size > (off64_t) MIN_BUFSIZE) {
+        BUFSIZE = (s.st_size + 511) & ~511;
+    }
     char* buf = (char *)calloc(1,BUFSIZE);
     char* paxHeader = buf + 512;    // use a different chunk of it as separate scratch
     char* paxData = buf + 1024;
@@ -675,39 +797,68 @@ int write_tarfile(const String8& packageName, const String8& domain,
     send_tarfile_chunk(writer, buf, 512);
 
     // Now write the file data itself, for real files.  We honor tar's convention that
-    // only full 512-byte blocks are sent to write().
+    // only full 512-byte blocks are sent to write().  Whole blocks are copied in the
+    // kernel with sendfile() when the output allows it; the final partial block is
+    // NUL-padded through buf.  The kernel reads the next chunk ahead while the
+    // current one is being written.
     if (!isdir) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
         off64_t toWrite = s.st_size;
+        off64_t pos = 0;
+        bool useSendfile = true;
         while (toWrite > 0) {
-            size_t toRead = toWrite;
-            if (toRead > BUFSIZE) {
-                toRead = BUFSIZE;
+            size_t chunk = BUFSIZE;
+            if (toWrite < (off64_t) chunk) {
+                chunk = toWrite;
             }
-            ssize_t nRead = read(fd, buf, toRead);
-            if (nRead < 0) {
-                err = errno;
-                ALOGE("Unable to read file [%s], err=%d (%s)", filepath.string(),
-                        err, strerror(err));
-                break;
-            } else if (nRead == 0) {
-                ALOGE("EOF but expect %lld more bytes in [%s]", (long long) toWrite,
-                        filepath.string());
-                err = EIO;
-                break;
+            if (useSendfile && chunk >= 512) {
+                chunk &= ~511;
+            }
+            posix_fadvise(fd, pos + chunk, BUFSIZE, POSIX_FADV_WILLNEED);
+
+            if (useSendfile && (chunk % 512) == 0) {
+                uint32_t chunk_size_no = htonl(chunk);
+                writer->WriteEntityData(&chunk_size_no, 4);
+                status_t status = writer->WriteEntityDataFromFd(fd, chunk);
+                if (status == NO_ERROR) {
+                    toWrite -= chunk;
+                    pos += chunk;
+                    continue;
+                } else if (status != INVALID_OPERATION) {
+                    err = status;
+                    ALOGE("Unable to send file [%s], err=%d (%s)", filepath.string(),
+                            err, strerror(err));
+                    break;
+                }
+                // The size word is already out; send this chunk through buf and
+                // stop trying sendfile() on this output.
+                useSendfile = false;
+                err = read_tarfile_data(fd, buf, chunk, filepath);
+                if (err != 0) {
+                    break;
+                }
+                writer->WriteEntityData(buf, chunk);
+                toWrite -= chunk;
+                pos += chunk;
+                continue;
             }
 
-            // At EOF we might have a short block; NUL-pad that to a 512-byte multiple.  This
-            // depends on the OS guarantee that for ordinary files, read() will never return
-            // less than the number of bytes requested.
-            ssize_t partial = (nRead+512) % 512;
-            if (partial > 0) {
-                ssize_t remainder = 512 - partial;
-                memset(buf + nRead, 0, remainder);
-                nRead += remainder;
+            err = read_tarfile_data(fd, buf, chunk, filepath);
+            if (err != 0) {
+                break;
             }
-            send_tarfile_chunk(writer, buf, nRead);
-            toWrite -= nRead;
+
+            // At EOF we might have a short block; NUL-pad that to a 512-byte multiple.
+            size_t padded = (chunk + 511) & ~511;
+            memset(buf + chunk, 0, padded - chunk);
+            send_tarfile_chunk(writer, buf, padded);
+            toWrite -= chunk;
+            pos += chunk;
         }
+
+        // the data has been sent; don't let a large backup push everything else
+        // out of the page cache
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
     }
 
 cleanup:
@@ -773,7 +924,7 @@ RestoreHelperBase::WriteFile(const String8& filename, BackupDataReader* in)
     mode = metadata.mode;
 
     // Write the file and compute the crc
-    crc = crc32(0L, Z_NULL, 0);
+    crc = 0;
     fd = open(filename.string(), O_CREAT|O_RDWR|O_TRUNC, mode);
     if (fd == -1) {
         ALOGW("Could not open file %s -- %s", filename.string(), strerror(errno));
@@ -787,7 +938,7 @@ RestoreHelperBase::WriteFile(const String8& filename, BackupDataReader* in)
             ALOGW("Error '%s' writing '%s'", strerror(errno), filename.string());
             return errno;
         }
-        crc = crc32(crc, (Bytef*)buf, amt);
+        crc = backup_crc32(crc, (const uint8_t*)buf, amt);
     }
 
     close(fd);
@@ -802,8 +953,7 @@ RestoreHelperBase::WriteFile(const String8& filename, BackupDataReader* in)
     r.file = filename;
     r.deleted = false;
     r.s.modTime_sec = st.st_mtime;
-    r.s.modTime_nsec = 0; // workaround sim breakage
-    //r.s.modTime_nsec = st.st_mtime_nsec;
+    r.s.modTime_nsec = st.st_mtim.tv_nsec;
     r.s.mode = st.st_mode;
     r.s.size = st.st_size;
     r.s.crc32 = crc;
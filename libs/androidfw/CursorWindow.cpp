@@ -134,13 +134,10 @@ status_t CursorWindow::clear() {
         return INVALID_OPERATION;
     }
 
-    mHeader->freeOffset = sizeof(Header) + sizeof(RowSlotChunk);
-    mHeader->firstChunkOffset = sizeof(Header);
+    mHeader->freeOffset = sizeof(Header);
+    mHeader->firstChunkOffset = 0;
     mHeader->numRows = 0;
     mHeader->numColumns = 0;
-
-    RowSlotChunk* firstChunk = static_cast<RowSlotChunk*>(offsetToPtr(mHeader->firstChunkOffset));
-    firstChunk->nextChunkOffset = 0;
     return OK;
 }
 
@@ -187,6 +184,33 @@ status_t CursorWindow::allocRow() {
     return OK;
 }
 
+CursorWindow::FieldSlot* CursorWindow::allocRowWithData(size_t dataSize,
+        uint32_t* outDataOffset) {
+    if (mReadOnly) {
+        return NULL;
+    }
+
+    // Check the whole row up front, so a row that doesn't fit leaves nothing behind
+    const uint32_t fieldDirOffset = (mHeader->freeOffset + 3) & ~3;
+    const size_t fieldDirSize = mHeader->numColumns * sizeof(FieldSlot);
+    const size_t end = size_t(fieldDirOffset) + fieldDirSize + dataSize;
+    if (end + sizeof(RowSlot) > getRowIndexOffset()) {
+        LOG_WINDOW("Window is full: requested row of %zu bytes, free space %zu bytes",
+                end - mHeader->freeOffset + sizeof(RowSlot), freeSpace());
+        return NULL;
+    }
+
+    mHeader->numRows += 1;
+    RowSlot* rowSlot = getRowSlot(mHeader->numRows - 1);
+    rowSlot->offset = fieldDirOffset;
+    mHeader->freeOffset = end;
+
+    FieldSlot* fieldDir = static_cast<FieldSlot*>(offsetToPtr(fieldDirOffset));
+    memset(fieldDir, 0, fieldDirSize);
+    *outDataOffset = fieldDirOffset + fieldDirSize;
+    return fieldDir;
+}
+
 status_t CursorWindow::freeLastRow() {
     if (mReadOnly) {
         return INVALID_OPERATION;
@@ -209,7 +233,7 @@ uint32_t CursorWindow::alloc(size_t size, bool aligned) {
 
     uint32_t offset = mHeader->freeOffset + padding;
     uint32_t nextFreeOffset = offset + size;
-    if (nextFreeOffset > mSize) {
+    if (nextFreeOffset > getRowIndexOffset()) {
         ALOGW("Window is full: requested allocation %zu bytes, "
                 "free space %zu bytes, window size %zu bytes",
                 size, freeSpace(), mSize);
@@ -221,6 +245,10 @@ uint32_t CursorWindow::alloc(size_t size, bool aligned) {
 }
 
 CursorWindow::RowSlot* CursorWindow::getRowSlot(uint32_t row) {
+    if (!mHeader->firstChunkOffset) {
+        return static_cast<RowSlot*>(offsetToPtr(mSize - (row + 1) * sizeof(RowSlot)));
+    }
+
     uint32_t chunkPos = row;
     RowSlotChunk* chunk = static_cast<RowSlotChunk*>(
             offsetToPtr(mHeader->firstChunkOffset));
@@ -232,26 +260,15 @@ CursorWindow::RowSlot* CursorWindow::getRowSlot(uint32_t row) {
 }
 
 CursorWindow::RowSlot* CursorWindow::allocRowSlot() {
-    uint32_t chunkPos = mHeader->numRows;
-    RowSlotChunk* chunk = static_cast<RowSlotChunk*>(
-            offsetToPtr(mHeader->firstChunkOffset));
-    while (chunkPos > ROW_SLOT_CHUNK_NUM_ROWS) {
-        chunk = static_cast<RowSlotChunk*>(offsetToPtr(chunk->nextChunkOffset));
-        chunkPos -= ROW_SLOT_CHUNK_NUM_ROWS;
-    }
-    if (chunkPos == ROW_SLOT_CHUNK_NUM_ROWS) {
-        if (!chunk->nextChunkOffset) {
-            chunk->nextChunkOffset = alloc(sizeof(RowSlotChunk), true /*aligned*/);
-            if (!chunk->nextChunkOffset) {
-                return NULL;
-            }
-        }
-        chunk = static_cast<RowSlotChunk*>(offsetToPtr(chunk->nextChunkOffset));
-        chunk->nextChunkOffset = 0;
-        chunkPos = 0;
+    // Windows are only written in the indexed layout, see clear()
+    if (getRowIndexOffset() - mHeader->freeOffset < sizeof(RowSlot)) {
+        ALOGW("Window is full: requested allocation %zu bytes, "
+                "free space %zu bytes, window size %zu bytes",
+                sizeof(RowSlot), freeSpace(), mSize);
+        return NULL;
     }
     mHeader->numRows += 1;
-    return &chunk->slots[chunkPos];
+    return getRowSlot(mHeader->numRows - 1);
 }
 
 CursorWindow::FieldSlot* CursorWindow::getFieldSlot(uint32_t row, uint32_t column) {
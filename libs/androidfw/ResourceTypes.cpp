@@ -632,15 +632,12 @@ status_t ResStringPool::getError() const
 void ResStringPool::uninit()
 {
     mError = NO_INIT;
-    if (mHeader != NULL && mCache != NULL) {
+    std::atomic<char16_t*>* cache = mCache.exchange(NULL);
+    if (mHeader != NULL && cache != NULL) {
         for (size_t x = 0; x < mHeader->stringCount; x++) {
-            if (mCache[x] != NULL) {
-                free(mCache[x]);
-                mCache[x] = NULL;
-            }
+            free(cache[x].load());
         }
-        free(mCache);
-        mCache = NULL;
+        delete[] cache;
     }
     if (mOwnedData) {
         free(mOwnedData);
@@ -724,9 +721,8 @@ const char16_t* ResStringPool::stringAt(size_t idx, size_t* u16len) const
 
                 // encLen must be less than 0x7FFF due to encoding.
                 if ((uint32_t)(u8str+u8len-strings) < mStringPoolSize) {
-                    AutoMutex lock(mDecodeLock);
-
-                    if (mCache == NULL) {
+                    std::atomic<char16_t*>* cache = mCache.load(std::memory_order_acquire);
+                    if (cache == NULL) {
 #ifndef HAVE_ANDROID_OS
                         if (kDebugStringPoolNoisy) {
                             ALOGI("CREATING STRING CACHE OF %zu bytes",
@@ -737,16 +733,20 @@ const char16_t* ResStringPool::stringAt(size_t idx, size_t* u16len) const
                         ALOGW("CREATING STRING CACHE OF %zu bytes",
                                 static_cast<size_t>(mHeader->stringCount*sizeof(char16_t**)));
 #endif
-                        mCache = (char16_t**)calloc(mHeader->stringCount, sizeof(char16_t**));
-                        if (mCache == NULL) {
-                            ALOGW("No memory trying to allocate decode cache table of %d bytes\n",
-                                    (int)(mHeader->stringCount*sizeof(char16_t**)));
-                            return NULL;
+                        std::atomic<char16_t*>* newCache =
+                                new std::atomic<char16_t*>[mHeader->stringCount]();
+                        if (mCache.compare_exchange_strong(cache, newCache,
+                                std::memory_order_acq_rel)) {
+                            cache = newCache;
+                        } else {
+                            // Lost the race, cache now holds the other thread's table
+                            delete[] newCache;
                         }
                     }
 
-                    if (mCache[idx] != NULL) {
-                        return mCache[idx];
+                    char16_t* cached = cache[idx].load(std::memory_order_acquire);
+                    if (cached != NULL) {
+                        return cached;
                     }
 
                     ssize_t actualLen = utf8_to_utf16_length(u8str, u8len);
@@ -775,7 +775,12 @@ const char16_t* ResStringPool::stringAt(size_t idx, size_t* u16len) const
                         ALOGI("Caching UTF8 string: %s", u8str);
                     }
                     utf8_to_utf16(u8str, u8len, u16str);
-                    mCache[idx] = u16str;
+                    if (!cache[idx].compare_exchange_strong(cached, u16str,
+                            std::memory_order_acq_rel)) {
+                        // Another thread decoded the same string first, cached is its copy
+                        free(u16str);
+                        return cached;
+                    }
                     return u16str;
                 } else {
                     ALOGW("Bad string block: string #%lld extends to %lld, past end at %lld\n",
@@ -3009,7 +3014,7 @@ String8 ResTable_config::toString() const {
 struct ResTable::Header
 {
     Header(ResTable* _owner) : owner(_owner), ownedData(NULL), header(NULL),
-        resourceIDMap(NULL), resourceIDMapSize(0) { }
+        resourceIDMap(NULL), resourceIDMapSize(0), dataSize(0), dataCopied(false) { }
 
     ~Header()
     {
@@ -3027,8 +3032,36 @@ struct ResTable::Header
     ResStringPool                   values;
     uint32_t*                       resourceIDMap;
     size_t                          resourceIDMapSize;
+
+    // Counted in the mapped or copied size of getGlobalTableSizes()
+    size_t                          dataSize;
+    bool                            dataCopied;
 };
 
+// Sizes of the table data of all the ResTables, see getGlobalTableSizes()
+static size_t gMappedTableSize = 0;
+static size_t gCopiedTableSize = 0;
+
+static void countTableSize(bool copied, ssize_t delta)
+{
+    __atomic_add_fetch(copied ? &gCopiedTableSize : &gMappedTableSize, delta, __ATOMIC_RELAXED);
+}
+
+// Resource tables should be stored uncompressed and aligned in their APK,
+// so that they can be mapped rather than copied into every process.
+static void warnIfTableCopied(Asset* asset)
+{
+#ifndef STATIC_ANDROIDFW_FOR_TOOLS
+    if (asset->isAllocated()) {
+        ALOGW("Resource table %s is copied to the heap (%lld bytes), it is compressed "
+                "or not aligned to 4 bytes in its APK", asset->getAssetSource(),
+                (long long) asset->getLength());
+    }
+#else
+    (void) asset;
+#endif
+}
+
 struct ResTable::Entry {
     ResTable_config config;
     const ResTable_entry* entry;
@@ -3086,11 +3119,17 @@ struct ResTable::PackageGroup
         , id(_id)
         , largestTypeId(0)
         , bags(NULL)
+        , filteredConfigs(NULL)
+        , entryCache(NULL)
+        , entryCacheGeneration(0)
         , dynamicRefTable(static_cast<uint8_t>(_id))
     { }
 
     ~PackageGroup() {
         clearBagCache();
+        delete filteredConfigs;
+        freeRetiredBags();
+        clearEntryCache();
         const size_t numTypes = types.size();
         for (size_t i = 0; i < numTypes; i++) {
             const TypeList& typeList = types[i];
@@ -3112,17 +3151,42 @@ struct ResTable::PackageGroup
     }
 
     void clearBagCache() {
+        freeBags(bags);
+        bags = NULL;
+    }
+
+    // Replaces the bags with an empty cache. The bags are kept until
+    // freeRetiredBags() since threads may still be reading them.
+    void retireBagCache() {
         if (bags) {
+            retiredBags.add(bags);
+            __atomic_store_n(&bags, (bag_set***)NULL, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    void freeRetiredBags() {
+        for (size_t i = 0; i < retiredBags.size(); i++) {
+            freeBags(retiredBags[i]);
+        }
+        retiredBags.clear();
+        for (size_t i = 0; i < retiredFilteredConfigs.size(); i++) {
+            delete retiredFilteredConfigs[i];
+        }
+        retiredFilteredConfigs.clear();
+    }
+
+    void freeBags(bag_set*** typeBagSets) {
+        if (typeBagSets) {
             if (kDebugTableNoisy) {
-                printf("bags=%p\n", bags);
+                printf("bags=%p\n", typeBagSets);
             }
-            for (size_t i = 0; i < bags->size(); i++) {
+            for (size_t i = 0; i <= Res_MAXTYPE; i++) {
                 if (kDebugTableNoisy) {
                     printf("type=%zu\n", i);
                 }
                 const TypeList& typeList = types[i];
                 if (!typeList.isEmpty()) {
-                    bag_set** typeBags = bags->get(i);
+                    bag_set** typeBags = typeBagSets[i];
                     if (kDebugTableNoisy) {
                         printf("typeBags=%p\n", typeBags);
                     }
@@ -3139,8 +3203,91 @@ struct ResTable::PackageGroup
                     }
                 }
             }
-            delete bags;
-            bags = NULL;
+            free(typeBagSets);
+        }
+    }
+
+    void clearEntryCache() {
+        AutoMutex _l(entryCacheLock);
+        if (entryCache) {
+            for (size_t i = 0; i < entryCache->size(); i++) {
+                delete [] entryCache->get(i);
+            }
+            delete entryCache;
+            entryCache = NULL;
+        }
+        // Entries being resolved for the previous parameters must not be cached
+        entryCacheGeneration++;
+    }
+
+    // Returns true and the entry resolved for the table's parameters if it is
+    // cached, otherwise the generation to pass to cacheEntry() once resolved.
+    bool getCachedEntry(int typeIndex, int entryIndex, Entry* outEntry,
+            uint32_t* outGeneration) const {
+        AutoMutex _l(entryCacheLock);
+        if (entryCache) {
+            const Entry* typeEntries = entryCache->get(typeIndex);
+            if (typeEntries && typeEntries[entryIndex].entry != NULL) {
+                *outEntry = typeEntries[entryIndex];
+                return true;
+            }
+        }
+        *outGeneration = entryCacheGeneration;
+        return false;
+    }
+
+    void cacheEntry(int typeIndex, int entryIndex, uint32_t generation,
+            const Entry& entry) const {
+        AutoMutex _l(entryCacheLock);
+        if (generation != entryCacheGeneration) {
+            return;
+        }
+        if (!entryCache) {
+            entryCache = new ByteBucketArray<Entry*>();
+        }
+        Entry* typeEntries = entryCache->get(typeIndex);
+        if (!typeEntries) {
+            typeEntries = new Entry[types[typeIndex][0]->entryCount]();
+            entryCache->set(typeIndex, typeEntries);
+        }
+        typeEntries[entryIndex] = entry;
+    }
+
+    // Replaces filteredConfigs with the configurations matching the given
+    // parameters. The previous ones are kept until freeRetiredBags() since
+    // threads may still be looking up resources with them.
+    void filterConfigs(const ResTable_config& params) {
+        FilteredConfigs* newConfigs = new FilteredConfigs();
+        for (size_t i = 0; i < types.size(); i++) {
+            const TypeList& typeList = types[i];
+            if (typeList.isEmpty()) {
+                continue;
+            }
+            Vector<Vector<const ResTable_type*> >& typeFilteredConfigs =
+                    newConfigs->editItemAt(i);
+            for (size_t j = 0; j < typeList.size(); j++) {
+                const Vector<const ResTable_type*>& configs = typeList[j]->configs;
+                Vector<const ResTable_type*> matching;
+                for (size_t c = 0; c < configs.size(); c++) {
+                    if (configs[c] == NULL) {
+                        continue;
+                    }
+                    ResTable_config thisConfig;
+                    thisConfig.copyFromDtoH(configs[c]->config);
+                    if (thisConfig.match(params)) {
+                        matching.add(configs[c]);
+                    }
+                }
+                typeFilteredConfigs.add(matching);
+            }
+        }
+
+        // Pairs with the acquire load of getEntry(), the lists are complete
+        // once they are reachable
+        FilteredConfigs* oldConfigs = filteredConfigs;
+        __atomic_store_n(&filteredConfigs, newConfigs, __ATOMIC_RELEASE);
+        if (oldConfigs) {
+            retiredFilteredConfigs.add(oldConfigs);
         }
     }
 
@@ -3169,8 +3316,30 @@ struct ResTable::PackageGroup
     uint8_t                         largestTypeId;
 
     // Computed attribute bags, first indexed by the type and second
-    // by the entry in that type.
-    ByteBucketArray<bag_set**>*     bags;
+    // by the entry in that type. The arrays and bags are published with
+    // release stores, so that lockBag() can read them without the lock.
+    bag_set***                      bags;
+
+    // Bags replaced by setParameters() while threads were reading them.
+    Vector<bag_set***>              retiredBags;
+
+    // The configurations of each Type of the TypeLists that match the table's
+    // parameters, in the same order. The Types may be shared with other
+    // tables, so they are filtered here rather than in the Types. Resources
+    // are looked up without the table's lock, so the lists are never changed
+    // once published, filterConfigs() replaces them.
+    typedef ByteBucketArray<Vector<Vector<const ResTable_type*> > > FilteredConfigs;
+    FilteredConfigs*                filteredConfigs;
+
+    // Filtered configurations replaced while threads were looking up resources.
+    Vector<FilteredConfigs*>        retiredFilteredConfigs;
+
+    // Entries resolved for the table's parameters, first indexed by the type
+    // and second by the entry in that type. Resources are looked up without
+    // holding the table's lock, so it is guarded by its own.
+    mutable Mutex                   entryCacheLock;
+    mutable ByteBucketArray<Entry*>* entryCache;
+    mutable uint32_t                entryCacheGeneration;
 
     // The table mapping dynamic references to resolved references for
     // this package group.
@@ -3188,9 +3357,19 @@ struct ResTable::bag_set
     // Followed by 'numAttr' bag_entry structures.
 };
 
+// Shared by the tables and the themes, so that none of them gets the
+// generation of another, even if allocated at the same address.
+static uint32_t gNextGeneration = 0;
+
+static uint32_t nextGeneration()
+{
+    return __atomic_add_fetch(&gNextGeneration, 1, __ATOMIC_RELAXED);
+}
+
 ResTable::Theme::Theme(const ResTable& table)
     : mTable(table)
     , mTypeSpecFlags(0)
+    , mGeneration(nextGeneration())
 {
     memset(mPackages, 0, sizeof(mPackages));
 }
@@ -3239,17 +3418,16 @@ status_t ResTable::Theme::applyStyle(uint32_t resID, bool force)
 {
     const bag_entry* bag;
     uint32_t bagTypeSpecFlags = 0;
-    mTable.lock();
-    const ssize_t N = mTable.getBagLocked(resID, &bag, &bagTypeSpecFlags);
+    const ssize_t N = mTable.lockBag(resID, &bag, &bagTypeSpecFlags);
     if (kDebugTableNoisy) {
         ALOGV("Applying style 0x%08x to theme %p, count=%zu", resID, this, N);
     }
     if (N < 0) {
-        mTable.unlock();
         return N;
     }
 
     mTypeSpecFlags |= bagTypeSpecFlags;
+    mGeneration = nextGeneration();
 
     uint32_t curPackage = 0xffffffff;
     ssize_t curPackageIndex = 0;
@@ -3324,7 +3502,7 @@ status_t ResTable::Theme::applyStyle(uint32_t resID, bool force)
         bag++;
     }
 
-    mTable.unlock();
+    mTable.unlockBag(bag);
 
     if (kDebugTableTheme) {
         ALOGI("Applying style 0x%08x (force=%d)  theme %p...\n", resID, force, this);
@@ -3370,6 +3548,7 @@ status_t ResTable::Theme::setTo(const Theme& other)
     }
 
     mTypeSpecFlags = other.mTypeSpecFlags;
+    mGeneration = nextGeneration();
 
     if (kDebugTableTheme) {
         ALOGI("Final theme:");
@@ -3394,6 +3573,7 @@ status_t ResTable::Theme::clear()
     }
 
     mTypeSpecFlags = 0;
+    mGeneration = nextGeneration();
 
     if (kDebugTableTheme) {
         ALOGI("Final theme:");
@@ -3518,7 +3698,7 @@ void ResTable::Theme::dumpToLog() const
 }
 
 ResTable::ResTable()
-    : mError(NO_INIT), mNextPackageId(2)
+    : mBagReaders(0), mGeneration(nextGeneration()), mError(NO_INIT), mNextPackageId(2)
 {
     memset(&mParams, 0, sizeof(mParams));
     memset(mPackageMap, 0, sizeof(mPackageMap));
@@ -3528,7 +3708,7 @@ ResTable::ResTable()
 }
 
 ResTable::ResTable(const void* data, size_t size, const int32_t cookie, bool copyData)
-    : mError(NO_INIT), mNextPackageId(2)
+    : mBagReaders(0), mGeneration(nextGeneration()), mError(NO_INIT), mNextPackageId(2)
 {
     memset(&mParams, 0, sizeof(mParams));
     memset(mPackageMap, 0, sizeof(mPackageMap));
@@ -3567,8 +3747,10 @@ status_t ResTable::add(Asset* asset, const int32_t cookie, bool copyData) {
         ALOGW("Unable to get buffer of resource asset file");
         return UNKNOWN_ERROR;
     }
+    warnIfTableCopied(asset);
 
-    return addInternal(data, static_cast<size_t>(asset->getLength()), NULL, 0, cookie, copyData);
+    return addInternal(data, static_cast<size_t>(asset->getLength()), NULL, 0, cookie, copyData,
+            asset->isAllocated());
 }
 
 status_t ResTable::add(Asset* asset, Asset* idmapAsset, const int32_t cookie, bool copyData) {
@@ -3577,6 +3759,7 @@ status_t ResTable::add(Asset* asset, Asset* idmapAsset, const int32_t cookie, bo
         ALOGW("Unable to get buffer of resource asset file");
         return UNKNOWN_ERROR;
     }
+    warnIfTableCopied(asset);
 
     size_t idmapSize = 0;
     const void* idmapData = NULL;
@@ -3590,12 +3773,19 @@ status_t ResTable::add(Asset* asset, Asset* idmapAsset, const int32_t cookie, bo
     }
 
     return addInternal(data, static_cast<size_t>(asset->getLength()),
-            idmapData, idmapSize, cookie, copyData);
+            idmapData, idmapSize, cookie, copyData, asset->isAllocated());
+}
+
+void ResTable::getGlobalTableSizes(size_t* outMappedSize, size_t* outCopiedSize)
+{
+    *outMappedSize = __atomic_load_n(&gMappedTableSize, __ATOMIC_RELAXED);
+    *outCopiedSize = __atomic_load_n(&gCopiedTableSize, __ATOMIC_RELAXED);
 }
 
 status_t ResTable::add(ResTable* src)
 {
     mError = src->mError;
+    __atomic_store_n(&mGeneration, nextGeneration(), __ATOMIC_RELAXED);
 
     for (size_t i=0; i<src->mHeaders.size(); i++) {
         mHeaders.add(src->mHeaders[i]);
@@ -3618,6 +3808,7 @@ status_t ResTable::add(ResTable* src)
         }
         pg->dynamicRefTable.addMappings(srcPg->dynamicRefTable);
         pg->largestTypeId = max(pg->largestTypeId, srcPg->largestTypeId);
+        pg->filterConfigs(mParams);
         mPackageGroups.add(pg);
     }
 
@@ -3627,6 +3818,7 @@ status_t ResTable::add(ResTable* src)
 }
 
 status_t ResTable::addEmpty(const int32_t cookie) {
+    __atomic_store_n(&mGeneration, nextGeneration(), __ATOMIC_RELAXED);
     Header* header = new Header(this);
     header->index = mHeaders.size();
     header->cookie = cookie;
@@ -3644,7 +3836,7 @@ status_t ResTable::addEmpty(const int32_t cookie) {
 }
 
 status_t ResTable::addInternal(const void* data, size_t dataSize, const void* idmapData, size_t idmapDataSize,
-        const int32_t cookie, bool copyData)
+        const int32_t cookie, bool copyData, bool dataIsAllocated)
 {
     if (!data) {
         return NO_ERROR;
@@ -3656,6 +3848,8 @@ status_t ResTable::addInternal(const void* data, size_t dataSize, const void* id
         return UNKNOWN_ERROR;
     }
 
+    __atomic_store_n(&mGeneration, nextGeneration(), __ATOMIC_RELAXED);
+
     Header* header = new Header(this);
     header->index = mHeaders.size();
     header->cookie = cookie;
@@ -3685,6 +3879,9 @@ status_t ResTable::addInternal(const void* data, size_t dataSize, const void* id
         memcpy(header->ownedData, data, dataSize);
         data = header->ownedData;
     }
+    header->dataSize = dataSize;
+    header->dataCopied = header->ownedData != NULL || dataIsAllocated;
+    countTableSize(header->dataCopied, dataSize);
 
     header->header = (const ResTable_header*)data;
     header->size = dtohl(header->header->header.size);
@@ -3784,6 +3981,7 @@ status_t ResTable::getError() const
 void ResTable::uninit()
 {
     mError = NO_INIT;
+    __atomic_store_n(&mGeneration, nextGeneration(), __ATOMIC_RELAXED);
     size_t N = mPackageGroups.size();
     for (size_t i=0; i<N; i++) {
         PackageGroup* g = mPackageGroups[i];
@@ -3793,6 +3991,7 @@ void ResTable::uninit()
     for (size_t i=0; i<N; i++) {
         Header* header = mHeaders[i];
         if (header->owner == this) {
+            countTableSize(header->dataCopied, -(ssize_t) header->dataSize);
             if (header->ownedData) {
                 free(header->ownedData);
             }
@@ -3897,13 +4096,16 @@ ssize_t ResTable::getResource(uint32_t resID, Res_value* outValue, bool mayBeBag
     }
 
     // Allow overriding density
-    ResTable_config desiredConfig = mParams;
+    const ResTable_config* desiredConfig = &mParams;
+    ResTable_config densityConfig;
     if (density > 0) {
-        desiredConfig.density = density;
+        densityConfig = mParams;
+        densityConfig.density = density;
+        desiredConfig = &densityConfig;
     }
 
     Entry entry;
-    status_t err = getEntry(grp, t, e, &desiredConfig, &entry);
+    status_t err = getEntry(grp, t, e, desiredConfig, &entry);
     if (err != NO_ERROR) {
         // Only log the failure when we're not running on the host as
         // part of a tool. The caller will do its own logging.
@@ -4006,21 +4208,81 @@ const char16_t* ResTable::valueToString(
     return NULL;
 }
 
-ssize_t ResTable::lockBag(uint32_t resID, const bag_entry** outBag) const
+ssize_t ResTable::lockBag(uint32_t resID, const bag_entry** outBag,
+        uint32_t* outTypeSpecFlags) const
 {
-    mLock.lock();
-    ssize_t err = getBagLocked(resID, outBag);
+    // Counted before reading the cache: setParameters() either sees this
+    // reader and keeps the bags, or has already replaced them.
+    __atomic_add_fetch(&mBagReaders, 1, __ATOMIC_SEQ_CST);
+    ssize_t err = getCachedBag(resID, outBag, outTypeSpecFlags);
     if (err < NO_ERROR) {
-        //printf("*** get failed!  unlocking\n");
+        mLock.lock();
+        err = getBagLocked(resID, outBag, outTypeSpecFlags);
         mLock.unlock();
     }
+    if (err < NO_ERROR) {
+        //printf("*** get failed!  unlocking\n");
+        __atomic_sub_fetch(&mBagReaders, 1, __ATOMIC_SEQ_CST);
+    }
     return err;
 }
 
 void ResTable::unlockBag(const bag_entry* /*bag*/) const
 {
     //printf("<<< unlockBag %p\n", this);
-    mLock.unlock();
+    __atomic_sub_fetch(&mBagReaders, 1, __ATOMIC_SEQ_CST);
+}
+
+ssize_t ResTable::getCachedBag(uint32_t resID, const bag_entry** outBag,
+        uint32_t* outTypeSpecFlags) const
+{
+    const ssize_t p = getResourcePackageIndex(resID);
+    const int t = Res_GETTYPE(resID);
+    const int e = Res_GETENTRY(resID);
+    if (mError != NO_ERROR || p < 0 || t < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    const PackageGroup* const grp = mPackageGroups[p];
+    if (grp == NULL) {
+        return NAME_NOT_FOUND;
+    }
+    const TypeList& typeConfigs = grp->types[t];
+    if (typeConfigs.isEmpty() || e >= (int)typeConfigs[0]->entryCount) {
+        return NAME_NOT_FOUND;
+    }
+
+    // Pairs with the release stores of getBagLocked(), the bags are complete
+    // once they are reachable
+    bag_set*** const typeBagSets = __atomic_load_n(&grp->bags, __ATOMIC_ACQUIRE);
+    if (typeBagSets == NULL) {
+        return NAME_NOT_FOUND;
+    }
+    bag_set** const typeSet = __atomic_load_n(&typeBagSets[t], __ATOMIC_ACQUIRE);
+    if (typeSet == NULL) {
+        return NAME_NOT_FOUND;
+    }
+    bag_set* const set = __atomic_load_n(&typeSet[e], __ATOMIC_ACQUIRE);
+    // Bags being computed, or that failed to be, are left to getBagLocked()
+    if (set == NULL || set == (bag_set*)0xFFFFFFFF) {
+        return NAME_NOT_FOUND;
+    }
+
+    if (outTypeSpecFlags != NULL) {
+        *outTypeSpecFlags = set->typeSpecFlags;
+    }
+    *outBag = (bag_entry*)(set+1);
+    return set->numAttrs;
+}
+
+void ResTable::freeRetiredBagsLocked() const
+{
+    if (__atomic_load_n(&mBagReaders, __ATOMIC_SEQ_CST) != 0) {
+        return;
+    }
+    for (size_t i = 0; i < mPackageGroups.size(); i++) {
+        mPackageGroups[i]->freeRetiredBags();
+    }
 }
 
 void ResTable::lock() const
@@ -4075,7 +4337,7 @@ ssize_t ResTable::getBagLocked(uint32_t resID, const bag_entry** outBag,
 
     // First see if we've already computed this bag...
     if (grp->bags) {
-        bag_set** typeSet = grp->bags->get(t);
+        bag_set** typeSet = grp->bags[t];
         if (typeSet) {
             bag_set* set = typeSet[e];
             if (set) {
@@ -4097,20 +4359,23 @@ ssize_t ResTable::getBagLocked(uint32_t resID, const bag_entry** outBag,
     }
 
     // Bag not found, we need to compute it!
+    // Published with release stores for getCachedBag(), which reads them
+    // without the lock.
     if (!grp->bags) {
-        grp->bags = new ByteBucketArray<bag_set**>();
-        if (!grp->bags) return NO_MEMORY;
+        bag_set*** typeBagSets = (bag_set***)calloc(Res_MAXTYPE + 1, sizeof(bag_set**));
+        if (!typeBagSets) return NO_MEMORY;
+        __atomic_store_n(&grp->bags, typeBagSets, __ATOMIC_RELEASE);
     }
 
-    bag_set** typeSet = grp->bags->get(t);
+    bag_set** typeSet = grp->bags[t];
     if (!typeSet) {
         typeSet = (bag_set**)calloc(NENTRY, sizeof(bag_set*));
         if (!typeSet) return NO_MEMORY;
-        grp->bags->set(t, typeSet);
+        __atomic_store_n(&grp->bags[t], typeSet, __ATOMIC_RELEASE);
     }
 
     // Mark that we are currently working on this one.
-    typeSet[e] = (bag_set*)0xFFFFFFFF;
+    __atomic_store_n(&typeSet[e], (bag_set*)0xFFFFFFFF, __ATOMIC_RELAXED);
 
     if (kDebugTableNoisy) {
         ALOGI("Building bag: %x\n", resID);
@@ -4296,7 +4561,7 @@ ssize_t ResTable::getBagLocked(uint32_t resID, const bag_entry** outBag,
     }
 
     // And this is it...
-    typeSet[e] = set;
+    __atomic_store_n(&typeSet[e], set, __ATOMIC_RELEASE);
     if (set) {
         if (outTypeSpecFlags != NULL) {
             *outTypeSpecFlags = set->typeSpecFlags;
@@ -4317,12 +4582,16 @@ void ResTable::setParameters(const ResTable_config* params)
         ALOGI("Setting parameters: %s\n", params->toString().string());
     }
     mParams = *params;
+    __atomic_store_n(&mGeneration, nextGeneration(), __ATOMIC_RELAXED);
     for (size_t i=0; i<mPackageGroups.size(); i++) {
         if (kDebugTableNoisy) {
             ALOGI("CLEARING BAGS FOR GROUP %zu!", i);
         }
-        mPackageGroups[i]->clearBagCache();
+        mPackageGroups[i]->retireBagCache();
+        mPackageGroups[i]->clearEntryCache();
+        mPackageGroups[i]->filterConfigs(mParams);
     }
+    freeRetiredBagsLocked();
     mLock.unlock();
 }
 
@@ -4333,6 +4602,11 @@ void ResTable::getParameters(ResTable_config* params) const
     mLock.unlock();
 }
 
+uint32_t ResTable::getGeneration() const
+{
+    return __atomic_load_n(&mGeneration, __ATOMIC_RELAXED);
+}
+
 struct id_name_map {
     uint32_t id;
     size_t len;
@@ -5800,6 +6074,21 @@ status_t ResTable::getEntry(
         return BAD_TYPE;
     }
 
+    // Only the lookups for the table's own parameters are cached, they are
+    // most of them and are repeated for every view inflated.
+    const bool useTableParams = config == &mParams;
+    const bool cacheable = useTableParams
+            && static_cast<size_t>(entryIndex) < typeList[0]->entryCount;
+    Entry resolved;
+    uint32_t cacheGeneration = 0;
+    if (cacheable && packageGroup->getCachedEntry(typeIndex, entryIndex, &resolved,
+            &cacheGeneration)) {
+        if (outEntry != NULL) {
+            *outEntry = resolved;
+        }
+        return NO_ERROR;
+    }
+
     const ResTable_type* bestType = NULL;
     uint32_t bestOffset = ResTable_type::NO_ENTRY;
     const Package* bestPackage = NULL;
@@ -5808,6 +6097,18 @@ status_t ResTable::getEntry(
     ResTable_config bestConfig;
     memset(&bestConfig, 0, sizeof(bestConfig));
 
+    // The configurations that can't match the table's parameters are already
+    // filtered out. Counted as a reader like lockBag(), so that setParameters()
+    // keeps the lists until the loop below is done with them.
+    __atomic_add_fetch(&mBagReaders, 1, __ATOMIC_SEQ_CST);
+    const PackageGroup::FilteredConfigs* const filteredConfigs =
+            __atomic_load_n(&packageGroup->filteredConfigs, __ATOMIC_ACQUIRE);
+    static const Vector<Vector<const ResTable_type*> > kNoFilteredConfigs;
+    const Vector<Vector<const ResTable_type*> >& typeFilteredConfigs =
+            filteredConfigs != NULL ? (*filteredConfigs)[typeIndex] : kNoFilteredConfigs;
+    const bool useFilteredConfigs = useTableParams
+            && typeFilteredConfigs.size() == typeList.size();
+
     // Iterate over the Types of each package.
     const size_t typeCount = typeList.size();
     for (size_t i = 0; i < typeCount; i++) {
@@ -5846,9 +6147,11 @@ status_t ResTable::getEntry(
             specFlags = -1;
         }
 
-        const size_t numConfigs = typeSpec->configs.size();
+        const Vector<const ResTable_type*>& candidateConfigs = useFilteredConfigs
+                ? typeFilteredConfigs[i] : typeSpec->configs;
+        const size_t numConfigs = candidateConfigs.size();
         for (size_t c = 0; c < numConfigs; c++) {
-            const ResTable_type* const thisType = typeSpec->configs[c];
+            const ResTable_type* const thisType = candidateConfigs[c];
             if (thisType == NULL) {
                 continue;
             }
@@ -5857,7 +6160,7 @@ status_t ResTable::getEntry(
             thisConfig.copyFromDtoH(thisType->config);
 
             // Check to make sure this one is valid for the current parameters.
-            if (config != NULL && !thisConfig.match(*config)) {
+            if (config != NULL && !useFilteredConfigs && !thisConfig.match(*config)) {
                 continue;
             }
 
@@ -5894,6 +6197,7 @@ status_t ResTable::getEntry(
             }
         }
     }
+    __atomic_sub_fetch(&mBagReaders, 1, __ATOMIC_SEQ_CST);
 
     if (bestType == NULL) {
         return BAD_INDEX;
@@ -5918,14 +6222,19 @@ status_t ResTable::getEntry(
         return BAD_TYPE;
     }
 
+    resolved.entry = entry;
+    resolved.config = bestConfig;
+    resolved.type = bestType;
+    resolved.specFlags = specFlags;
+    resolved.package = bestPackage;
+    resolved.typeStr = StringPoolRef(&bestPackage->typeStrings, actualTypeIndex - bestPackage->typeIdOffset);
+    resolved.keyStr = StringPoolRef(&bestPackage->keyStrings, dtohl(entry->key.index));
+
+    if (cacheable) {
+        packageGroup->cacheEntry(typeIndex, entryIndex, cacheGeneration, resolved);
+    }
     if (outEntry != NULL) {
-        outEntry->entry = entry;
-        outEntry->config = bestConfig;
-        outEntry->type = bestType;
-        outEntry->specFlags = specFlags;
-        outEntry->package = bestPackage;
-        outEntry->typeStr = StringPoolRef(&bestPackage->typeStrings, actualTypeIndex - bestPackage->typeIdOffset);
-        outEntry->keyStr = StringPoolRef(&bestPackage->keyStrings, dtohl(entry->key.index));
+        *outEntry = resolved;
     }
     return NO_ERROR;
 }
@@ -6036,6 +6345,9 @@ status_t ResTable::parsePackage(const ResTable_package* const pkg,
         if (group == NULL) {
             return (mError=UNKNOWN_ERROR);
         }
+        // The configurations and overlays of this package may resolve the
+        // entries of the group differently
+        group->clearEntryCache();
     }
 
     err = group->packages.add(package);
@@ -6221,6 +6533,7 @@ status_t ResTable::parsePackage(const ResTable_package* const pkg,
             (((const uint8_t*)chunk) + csize);
     }
 
+    group->filterConfigs(mParams);
     return NO_ERROR;
 }
 
@@ -25,6 +25,7 @@
 #include <assert.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 
 /*
  * TEMP_FAILURE_RETRY is defined by some, but not all, versions of
@@ -58,12 +59,20 @@ StreamingZipInflater::StreamingZipInflater(int fd, off64_t compDataStart,
     mOutTotalSize = uncompSize;
     mInTotalSize = compSize;
 
-    mInBufSize = StreamingZipInflater::INPUT_CHUNK_SIZE;
+    // Small entries only need a buffer of their size
+    mInBufSize = min_of(compSize, compSize >= StreamingZipInflater::LARGE_INPUT_SIZE
+            ? StreamingZipInflater::LARGE_INPUT_CHUNK_SIZE
+            : StreamingZipInflater::INPUT_CHUNK_SIZE);
     mInBuf = new uint8_t[mInBufSize];
 
     mOutBufSize = StreamingZipInflater::OUTPUT_CHUNK_SIZE;
     mOutBuf = new uint8_t[mOutBufSize];
 
+#ifdef HAVE_ANDROID_OS
+    // The data is read once from start to end
+    ::posix_fadvise(mFd, mInFileStart, mInTotalSize, POSIX_FADV_SEQUENTIAL);
+#endif
+
     initInflateState();
 }
 
@@ -221,12 +230,26 @@ int StreamingZipInflater::readNextChunk() {
                 mInNextChunkOffset += didRead;
                 mInflateState.next_in = (Bytef*) mInBuf;
                 mInflateState.avail_in = didRead;
+                readAheadNextChunk();
             }
         }
     }
     return 0;
 }
 
+/*
+ * Have the kernel start reading the next chunk while the current one is
+ * inflated, so that readNextChunk() doesn't wait on the disk for it.
+ */
+void StreamingZipInflater::readAheadNextChunk() {
+#ifdef HAVE_ANDROID_OS
+    if (mInNextChunkOffset < mInTotalSize) {
+        size_t toRead = min_of(mInBufSize, mInTotalSize - mInNextChunkOffset);
+        ::posix_fadvise(mFd, mInFileStart + mInNextChunkOffset, toRead, POSIX_FADV_WILLNEED);
+    }
+#endif
+}
+
 // seeking backwards requires uncompressing fom the beginning, so is very
 // expensive.  seeking forwards only requires uncompressing from the current
 // position to the destination.
@@ -70,6 +70,7 @@ LOCAL_MODULE := libandroidfw_tests
 LOCAL_CFLAGS := $(androidfw_test_cflags)
 LOCAL_SRC_FILES := $(testFiles) \
     BackupData_test.cpp \
+    BackupHelpers_test.cpp \
     ObbFile_test.cpp \
 
 LOCAL_SHARED_LIBRARIES := \
@@ -81,3 +82,31 @@ LOCAL_SHARED_LIBRARIES := \
 include $(BUILD_NATIVE_TEST)
 endif # Not SDK_ONLY
 
+
+# ==========================================================
+# Build the device benchmarks: libandroidfw_benchmarks
+#
+# They measure the startup path of apps against the
+# framework-res.apk of the device, run them with:
+# adb shell /data/benchmarktest/libandroidfw_benchmarks/libandroidfw_benchmarks
+# ==========================================================
+ifneq ($(SDK_ONLY),true)
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libandroidfw_benchmarks
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS := $(androidfw_test_cflags)
+LOCAL_SRC_FILES := \
+    AssetManager_bench.cpp \
+    AttributeFinder_bench.cpp \
+    BenchmarkHelpers.cpp \
+    ResTable_bench.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+    libandroidfw \
+    libcutils \
+    liblog \
+    libutils \
+
+include $(BUILD_NATIVE_BENCHMARK)
+endif # Not SDK_ONLY
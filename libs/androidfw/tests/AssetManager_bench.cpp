@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/Benchmark.h>
+
+#include "BenchmarkHelpers.h"
+
+#include <androidfw/ResourceTypes.h>
+
+using namespace android;
+
+BENCHMARK_NO_ARG(BM_AssetManager_openNonAsset);
+void BM_AssetManager_openNonAsset::Run(int iters) {
+    AssetManager& am = getFrameworkAssetManager();
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        Asset* asset = am.openNonAsset("AndroidManifest.xml", Asset::ACCESS_BUFFER);
+        DoNotOptimize(asset->getBuffer(true));
+        delete asset;
+    }
+    StopBenchmarkTiming();
+}
+
+// framework-res has few layouts worth parsing on their own, its manifest is
+// a large compiled XML document with the same structure
+BENCHMARK_NO_ARG(BM_ResXMLParser_parse);
+void BM_ResXMLParser_parse::Run(int iters) {
+    Asset* asset = openFrameworkAsset("AndroidManifest.xml", Asset::ACCESS_BUFFER);
+    const void* data = asset->getBuffer(true);
+    const size_t size = asset->getLength();
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        ResXMLTree tree;
+        tree.setTo(data, size);
+        size_t attributeCount = 0;
+        ResXMLParser::event_code_t code;
+        while ((code = tree.next()) != ResXMLParser::END_DOCUMENT
+                && code != ResXMLParser::BAD_DOCUMENT) {
+            if (code == ResXMLParser::START_TAG) {
+                for (size_t j = 0; j < tree.getAttributeCount(); j++) {
+                    attributeCount += tree.getAttributeNameResID(j) != 0;
+                }
+            }
+        }
+        DoNotOptimize(attributeCount);
+    }
+    StopBenchmarkTiming();
+
+    delete asset;
+}
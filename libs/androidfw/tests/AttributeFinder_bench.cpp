@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/Benchmark.h>
+
+#include <androidfw/AttributeFinder.h>
+#include <utils/Vector.h>
+
+using namespace android;
+
+class ArrayAttributeFinder : public BackTrackingAttributeFinder<ArrayAttributeFinder, size_t> {
+public:
+    explicit ArrayAttributeFinder(const Vector<uint32_t>& attrs)
+        : BackTrackingAttributeFinder(0, attrs.size()), mAttrs(attrs) {
+    }
+
+    inline uint32_t getAttribute(const size_t index) const {
+        return mAttrs[index];
+    }
+
+private:
+    const Vector<uint32_t>& mAttrs;
+};
+
+// A bag the size of a framework theme, which sets a spread of the framework
+// attributes, followed by a few of the app's own
+static void buildThemeAttributes(Vector<uint32_t>* outAttrs) {
+    for (uint32_t entry = 0; entry < 3000; entry += 3) {
+        outAttrs->add(0x01010000 | entry);
+    }
+    for (uint32_t entry = 0; entry < 200; entry += 2) {
+        outAttrs->add(0x7f010000 | entry);
+    }
+}
+
+// Arg is the number of attributes looked up, like the styleable of a view
+// passed to obtainStyledAttributes(), spread evenly over the bag in order
+BENCHMARK_WITH_ARG(BM_AttributeFinder_find, int)->Arg(4)->Arg(32)->Arg(256);
+void BM_AttributeFinder_find::Run(int iters, int lookups) {
+    Vector<uint32_t> attrs;
+    buildThemeAttributes(&attrs);
+
+    Vector<uint32_t> wanted;
+    for (int i = 0; i < lookups; i++) {
+        // Every other one isn't in the bag and has to stop at the next one
+        wanted.add(attrs[i * attrs.size() / lookups] + (i & 1));
+    }
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        ArrayAttributeFinder finder(attrs);
+        for (size_t j = 0; j < wanted.size(); j++) {
+            DoNotOptimize(finder.find(wanted[j]));
+        }
+    }
+    StopBenchmarkTiming();
+}
@@ -126,3 +126,30 @@ TEST(AttributeFinderTest, FindAttributesInSinglePackageAttributeList) {
     EXPECT_EQ(end, finder.find(0x010100fa));
     EXPECT_EQ(0, finder.find(0x7f010007));
 }
+
+TEST(AttributeFinderTest, FindSparseAttributesInLongAttributeList) {
+    // Long runs of attributes per package, as in the bag of a theme.
+    uint32_t attrs[600];
+    const int end = sizeof(attrs) / sizeof(*attrs);
+    for (int i = 0; i < 300; i++) {
+        attrs[i] = 0x01010000 + i * 2;
+    }
+    for (int i = 0; i < 200; i++) {
+        attrs[300 + i] = 0x02010000 + i * 2;
+    }
+    for (int i = 0; i < 100; i++) {
+        attrs[500 + i] = 0x7f010000 + i * 2;
+    }
+    MockAttributeFinder finder(attrs, end);
+
+    EXPECT_EQ(3, finder.find(0x01010006));
+    EXPECT_EQ(end, finder.find(0x01010007));
+    EXPECT_EQ(200, finder.find(0x01010190));
+    EXPECT_EQ(299, finder.find(0x01010256));
+    EXPECT_EQ(end, finder.find(0x01010258));
+    EXPECT_EQ(550, finder.find(0x7f010064));
+    EXPECT_EQ(599, finder.find(0x7f0100c6));
+    EXPECT_EQ(301, finder.find(0x02010002));
+    EXPECT_EQ(499, finder.find(0x0201018e));
+    EXPECT_EQ(end, finder.find(0x02010190));
+}
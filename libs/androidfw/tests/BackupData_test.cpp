@@ -25,6 +25,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 
 namespace android {
 
@@ -434,4 +435,46 @@ TEST_F(BackupDataTest, ReadDeletedEntityData) {
   delete reader;
 }
 
+TEST_F(BackupDataTest, WriteEntityDataFromFd) {
+  String8 srcFilename(mFilename);
+  srcFilename.append(".src");
+  int srcFd = ::open(srcFilename.string(), O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+  ASSERT_LE(0, srcFd) << "Couldn't create " << srcFilename.string();
+  ASSERT_EQ((ssize_t) sizeof(DATA1), ::write(srcFd, DATA1, sizeof(DATA1)));
+  ::lseek(srcFd, 0, SEEK_SET);
+
+  int fd = ::open(mFilename.string(), O_WRONLY);
+  BackupDataWriter* writer = new BackupDataWriter(fd);
+  EXPECT_EQ(NO_ERROR, writer->WriteEntityHeader(mKey1, sizeof(DATA1)));
+  status_t err = writer->WriteEntityDataFromFd(srcFd, sizeof(DATA1));
+  if (err == INVALID_OPERATION) {
+    // no sendfile() to this output; the caller falls back like this
+    err = writer->WriteEntityData(DATA1, sizeof(DATA1));
+  }
+  EXPECT_EQ(NO_ERROR, err)
+          << "WriteEntityDataFromFd returned an error";
+  ::close(fd);
+  ::close(srcFd);
+  ::unlink(srcFilename.string());
+
+  fd = ::open(mFilename.string(), O_RDONLY);
+  BackupDataReader* reader = new BackupDataReader(fd);
+  bool done;
+  int type;
+  reader->ReadNextHeader(&done, &type);
+  EXPECT_EQ(BACKUP_HEADER_ENTITY_V1, type);
+
+  String8 key;
+  size_t dataSize;
+  EXPECT_EQ(NO_ERROR, reader->ReadEntityHeader(&key, &dataSize));
+  EXPECT_EQ(mKey1, key);
+  EXPECT_EQ(sizeof(DATA1), dataSize);
+
+  char dataBytes[sizeof(DATA1)];
+  EXPECT_EQ((int) sizeof(DATA1), reader->ReadEntityData(dataBytes, sizeof(DATA1)));
+  EXPECT_EQ(0, memcmp(DATA1, dataBytes, sizeof(DATA1)));
+  delete writer;
+  delete reader;
+}
+
 }
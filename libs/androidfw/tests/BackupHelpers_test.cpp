@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <androidfw/BackupHelpers.h>
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+namespace android {
+
+static uint32_t crcOf(const char* str) {
+    return backup_crc32(0, (const uint8_t*) str, strlen(str));
+}
+
+TEST(BackupHelpersTest, crc32MatchesKnownValues) {
+    EXPECT_EQ(0u, crcOf(""));
+    EXPECT_EQ(0xe8b7be43u, crcOf("a"));
+    EXPECT_EQ(0xcbf43926u, crcOf("123456789"));
+    EXPECT_EQ(0x414fa339u, crcOf("The quick brown fox jumps over the lazy dog"));
+
+    uint8_t zeros[32];
+    memset(zeros, 0, sizeof(zeros));
+    EXPECT_EQ(0x190a55adu, backup_crc32(0, zeros, sizeof(zeros)));
+
+    // Long enough to spend most of its time in the 8 byte loop
+    uint8_t ramp[4096];
+    for (size_t i = 0; i < sizeof(ramp); i++) {
+        ramp[i] = i & 0xff;
+    }
+    EXPECT_EQ(0xa2912082u, backup_crc32(0, ramp, sizeof(ramp)));
+}
+
+TEST(BackupHelpersTest, crc32IsIndependentOfAlignment) {
+    const char* check = "123456789";
+    const size_t length = strlen(check);
+    uint8_t buffer[16 + 9];
+    for (size_t offset = 0; offset < 16; offset++) {
+        memcpy(buffer + offset, check, length);
+        EXPECT_EQ(0xcbf43926u, backup_crc32(0, buffer + offset, length)) << "offset " << offset;
+    }
+}
+
+TEST(BackupHelpersTest, crc32ContinuesAcrossBlocks) {
+    const char* fox = "The quick brown fox jumps over the lazy dog";
+    const size_t length = strlen(fox);
+    for (size_t split = 0; split <= length; split++) {
+        uint32_t crc = backup_crc32(0, (const uint8_t*) fox, split);
+        crc = backup_crc32(crc, (const uint8_t*) fox + split, length - split);
+        EXPECT_EQ(0x414fa339u, crc) << "split at " << split;
+    }
+}
+
+}  // namespace android
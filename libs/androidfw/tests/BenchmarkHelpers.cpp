@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BenchmarkHelpers.h"
+
+#include <utils/Log.h>
+#include <utils/String8.h>
+
+namespace android {
+
+AssetManager& getFrameworkAssetManager() {
+    static AssetManager* sAssetManager = NULL;
+    if (sAssetManager == NULL) {
+        sAssetManager = new AssetManager();
+        int32_t cookie;
+        LOG_ALWAYS_FATAL_IF(!sAssetManager->addAssetPath(String8(kFrameworkResPath), &cookie),
+                "Couldn't load %s", kFrameworkResPath);
+    }
+    return *sAssetManager;
+}
+
+Asset* openFrameworkAsset(const char* fileName, Asset::AccessMode mode) {
+    Asset* asset = getFrameworkAssetManager().openNonAsset(fileName, mode);
+    LOG_ALWAYS_FATAL_IF(asset == NULL, "Couldn't open %s of %s", fileName, kFrameworkResPath);
+    return asset;
+}
+
+} // namespace android
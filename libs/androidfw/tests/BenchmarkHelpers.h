@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BENCHMARK_HELPERS_H
+#define __BENCHMARK_HELPERS_H
+
+#include <androidfw/Asset.h>
+#include <androidfw/AssetManager.h>
+
+namespace android {
+
+// The resources every app loads first, so that the numbers are those of a
+// real startup
+static const char kFrameworkResPath[] = "/system/framework/framework-res.apk";
+
+/**
+ * Keeps the compiler from optimizing away the computation of value.
+ */
+template <class Tp>
+static inline void DoNotOptimize(Tp const& value) {
+    asm volatile("" : : "g"(value) : "memory");
+}
+
+/**
+ * An AssetManager with only framework-res.apk, aborting if it can't be
+ * loaded. Created once, shared by the benchmarks.
+ */
+AssetManager& getFrameworkAssetManager();
+
+/**
+ * Opens a file of framework-res.apk, aborting if it isn't found. The caller
+ * deletes the asset.
+ */
+Asset* openFrameworkAsset(const char* fileName, Asset::AccessMode mode);
+
+} // namespace android
+
+#endif // __BENCHMARK_HELPERS_H
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/Benchmark.h>
+
+#include "BenchmarkHelpers.h"
+
+#include <androidfw/ResourceTypes.h>
+#include <utils/String16.h>
+#include <utils/Vector.h>
+
+using namespace android;
+
+static const ResTable& getFrameworkTable() {
+    return getFrameworkAssetManager().getResources();
+}
+
+// The IDs of the first entries of each type of framework-res, as the
+// resources looked up at startup are spread over all of them. Returns the
+// first type framework-res doesn't have.
+static uint32_t collectFrameworkIds(Vector<uint32_t>* outIds) {
+    const ResTable& table = getFrameworkTable();
+    uint32_t missingType = 0;
+    for (uint32_t type = 1; type <= Res_MAXTYPE; type++) {
+        const size_t count = outIds->size();
+        for (uint32_t entry = 0; entry < 256; entry++) {
+            const uint32_t resId = 0x01000000 | (type << 16) | entry;
+            Res_value value;
+            if (table.getResource(resId, &value, true) >= 0) {
+                outIds->add(resId);
+            }
+        }
+        if (outIds->size() == count && missingType == 0) {
+            missingType = type;
+        }
+    }
+    return missingType;
+}
+
+BENCHMARK_NO_ARG(BM_ResTable_addFramework);
+void BM_ResTable_addFramework::Run(int iters) {
+    Asset* asset = openFrameworkAsset("resources.arsc", Asset::ACCESS_BUFFER);
+    const void* data = asset->getBuffer(true);
+    const size_t size = asset->getLength();
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        ResTable table;
+        table.add(data, size);
+        DoNotOptimize(table.getTableCount());
+    }
+    StopBenchmarkTiming();
+
+    delete asset;
+}
+
+// Arg is the percentage of lookups of IDs that don't exist, spread among the
+// hits. They are in the framework package, with a type it doesn't have, like
+// the probes for optional resources apps make, so they fail in getEntry()
+// without walking the configurations of a type.
+BENCHMARK_WITH_ARG(BM_ResTable_getResource, int)->Arg(0)->Arg(10)->Arg(50);
+void BM_ResTable_getResource::Run(int iters, int missPercent) {
+    const ResTable& table = getFrameworkTable();
+    Vector<uint32_t> ids;
+    const uint32_t missingType = collectFrameworkIds(&ids);
+    for (size_t i = 0; i < ids.size() && missingType != 0; i++) {
+        if ((i * missPercent) % 100 < (size_t) missPercent) {
+            ids.editItemAt(i) = (ids[i] & 0xff00ffff) | (missingType << 16);
+        }
+    }
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        for (size_t j = 0; j < ids.size(); j++) {
+            Res_value value;
+            DoNotOptimize(table.getResource(ids[j], &value, true));
+        }
+    }
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_NO_ARG(BM_Theme_applyStyle);
+void BM_Theme_applyStyle::Run(int iters) {
+    const ResTable& table = getFrameworkTable();
+    const String16 name("Theme.Material.Light.DarkActionBar");
+    const String16 type("style");
+    const String16 package("android");
+    const uint32_t style = table.identifierForName(name.string(), name.size(),
+            type.string(), type.size(), package.string(), package.size());
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        ResTable::Theme theme(table);
+        theme.applyStyle(style);
+        DoNotOptimize(theme.getChangingConfigurations());
+    }
+    StopBenchmarkTiming();
+}
@@ -46,6 +46,27 @@ TEST(ResTableTest, shouldLoadSuccessfully) {
     ASSERT_EQ(NO_ERROR, table.add(basic_arsc, basic_arsc_len));
 }
 
+TEST(ResTableTest, tableSizesAreCountedAsMappedOrCopied) {
+    size_t mappedSize, copiedSize;
+    ResTable::getGlobalTableSizes(&mappedSize, &copiedSize);
+
+    {
+        ResTable table;
+        ASSERT_EQ(NO_ERROR, table.add(basic_arsc, basic_arsc_len));
+        ASSERT_EQ(NO_ERROR, table.add(lib_arsc, lib_arsc_len, -1, true));
+
+        size_t newMappedSize, newCopiedSize;
+        ResTable::getGlobalTableSizes(&newMappedSize, &newCopiedSize);
+        EXPECT_EQ(mappedSize + basic_arsc_len, newMappedSize);
+        EXPECT_EQ(copiedSize + lib_arsc_len, newCopiedSize);
+    }
+
+    size_t finalMappedSize, finalCopiedSize;
+    ResTable::getGlobalTableSizes(&finalMappedSize, &finalCopiedSize);
+    EXPECT_EQ(mappedSize, finalMappedSize);
+    EXPECT_EQ(copiedSize, finalCopiedSize);
+}
+
 TEST(ResTableTest, simpleTypeIsRetrievedCorrectly) {
     ResTable table;
     ASSERT_EQ(NO_ERROR, table.add(basic_arsc, basic_arsc_len));
@@ -165,6 +186,30 @@ TEST(ResTableTest, resourcesStillAccessibleAfterParameterChange) {
     table.unlockBag(entry);
 }
 
+TEST(ResTableTest, lockedBagStaysValidAfterParameterChange) {
+    ResTable table;
+    ASSERT_EQ(NO_ERROR, table.add(basic_arsc, basic_arsc_len));
+
+    const ResTable::bag_entry* entry;
+    ssize_t count = table.lockBag(base::R::array::integerArray1, &entry);
+    ASSERT_GE(count, 0);
+
+    // Locking a bag doesn't hold the table's lock, the parameters can change
+    // while it is read
+    ResTable_config param;
+    memset(&param, 0, sizeof(param));
+    param.density = 320;
+    table.setParameters(&param);
+
+    const ResTable::bag_entry* otherEntry;
+    ASSERT_EQ(count, table.lockBag(base::R::array::integerArray1, &otherEntry));
+    for (ssize_t i = 0; i < count; i++) {
+        EXPECT_EQ(entry[i].map.value.data, otherEntry[i].map.value.data);
+    }
+    table.unlockBag(otherEntry);
+    table.unlockBag(entry);
+}
+
 TEST(ResTableTest, resourceIsOverridenWithBetterConfig) {
     ResTable table;
     ASSERT_EQ(NO_ERROR, table.add(basic_arsc, basic_arsc_len));
@@ -189,6 +234,52 @@ TEST(ResTableTest, resourceIsOverridenWithBetterConfig) {
     ASSERT_EQ(uint32_t(400), val.data);
 }
 
+TEST(ResTableTest, resolvedResourceIsUpdatedAfterParameterChange) {
+    ResTable table;
+    ASSERT_EQ(NO_ERROR, table.add(basic_arsc, basic_arsc_len));
+
+    ResTable_config param;
+    memset(&param, 0, sizeof(param));
+    param.language[0] = 's';
+    param.language[1] = 'v';
+    param.country[0] = 'S';
+    param.country[1] = 'E';
+    table.setParameters(&param);
+
+    // The second lookup is served from the resolved entry of the first
+    Res_value val;
+    for (int i = 0; i < 2; i++) {
+        ssize_t block = table.getResource(base::R::integer::number1, &val, MAY_NOT_BE_BAG);
+        ASSERT_GE(block, 0);
+        ASSERT_EQ(uint32_t(400), val.data);
+    }
+
+    memset(&param, 0, sizeof(param));
+    table.setParameters(&param);
+
+    ssize_t block = table.getResource(base::R::integer::number1, &val, MAY_NOT_BE_BAG);
+    ASSERT_GE(block, 0);
+    ASSERT_EQ(uint32_t(200), val.data);
+}
+
+TEST(ResTableTest, resourceAddedAfterParameterChangeUsesParameters) {
+    ResTable table;
+    ResTable_config param;
+    memset(&param, 0, sizeof(param));
+    param.language[0] = 's';
+    param.language[1] = 'v';
+    param.country[0] = 'S';
+    param.country[1] = 'E';
+    table.setParameters(&param);
+
+    ASSERT_EQ(NO_ERROR, table.add(basic_arsc, basic_arsc_len));
+
+    Res_value val;
+    ssize_t block = table.getResource(base::R::integer::number1, &val, MAY_NOT_BE_BAG);
+    ASSERT_GE(block, 0);
+    ASSERT_EQ(uint32_t(400), val.data);
+}
+
 TEST(ResTableTest, emptyTableHasSensibleDefaults) {
     const int32_t assetCookie = 1;
 
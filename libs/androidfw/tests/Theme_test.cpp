@@ -65,4 +65,26 @@ TEST(ThemeTest, DISABLED_shouldCopyThemeFromDifferentResTable) {
     ASSERT_EQ(uint32_t(1), val.data);
 }
 
+TEST(ThemeTest, generationChangesWhenThemeOrTableChanges) {
+    ResTable table;
+    ASSERT_EQ(NO_ERROR, table.add(system_arsc, system_arsc_len));
+
+    ResTable::Theme theme(table);
+    ResTable::Theme otherTheme(table);
+    EXPECT_NE(theme.getGeneration(), otherTheme.getGeneration());
+    EXPECT_NE(theme.getGeneration(), table.getGeneration());
+
+    uint32_t themeGeneration = theme.getGeneration();
+    const uint32_t tableGeneration = table.getGeneration();
+    ASSERT_EQ(NO_ERROR, table.add(app_arsc, app_arsc_len));
+    EXPECT_NE(tableGeneration, table.getGeneration());
+
+    ASSERT_EQ(NO_ERROR, theme.applyStyle(app::R::style::Theme_One));
+    EXPECT_NE(themeGeneration, theme.getGeneration());
+
+    themeGeneration = theme.getGeneration();
+    ASSERT_EQ(NO_ERROR, theme.clear());
+    EXPECT_NE(themeGeneration, theme.getGeneration());
+}
+
 }
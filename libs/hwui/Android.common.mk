@@ -25,8 +25,10 @@ LOCAL_SRC_FILES := \
     renderthread/TimeLord.cpp \
     thread/TaskManager.cpp \
     utils/Blur.cpp \
+    utils/DistanceField.cpp \
     utils/GLUtils.cpp \
     utils/LinearAllocator.cpp \
+    utils/PixelConvert.cpp \
     utils/SortedListImpl.cpp \
     AmbientShadow.cpp \
     AnimationContext.cpp \
@@ -41,6 +43,7 @@ LOCAL_SRC_FILES := \
     DeferredLayerUpdater.cpp \
     DisplayList.cpp \
     DisplayListCanvas.cpp \
+    DisplayListSerializer.cpp \
     Dither.cpp \
     Extensions.cpp \
     FboCache.cpp \
@@ -49,6 +52,7 @@ LOCAL_SRC_FILES := \
     FrameInfoVisualizer.cpp \
     GammaFontRenderer.cpp \
     GlopBuilder.cpp \
+    GpuTimer.cpp \
     GradientCache.cpp \
     Image.cpp \
     Interpolator.cpp \
@@ -58,6 +62,7 @@ LOCAL_SRC_FILES := \
     LayerRenderer.cpp \
     Matrix.cpp \
     OpenGLRenderer.cpp \
+    OpProfiler.cpp \
     Patch.cpp \
     PatchCache.cpp \
     PathCache.cpp \
@@ -39,6 +39,7 @@ BaseRenderNodeAnimator::BaseRenderNodeAnimator(float finalValue)
         , mStagingPlayState(NOT_STARTED)
         , mPlayState(NOT_STARTED)
         , mHasStartValue(false)
+        , mStartValueApplied(false)
         , mStartTime(0)
         , mDuration(300)
         , mStartDelay(0)
@@ -107,6 +108,7 @@ void BaseRenderNodeAnimator::transitionToRunning(AnimationContext& context) {
         ALOGW("Your start delay is strange and confusing: %" PRId64, mStartDelay);
     }
     mStartTime = frameTimeMs + mStartDelay;
+    mStartValueApplied = false;
     if (mStartTime < 0) {
         ALOGW("Ended up with a really weird start time of %" PRId64
                 " with frame time %" PRId64 " and start delay %" PRId64,
@@ -137,6 +139,7 @@ bool BaseRenderNodeAnimator::animate(AnimationContext& context) {
     // being delayed as we need to override the staging value
     if (mStartTime > context.frameTimeMs()) {
         setValue(mTarget, mFromValue);
+        mStartValueApplied = true;
         return false;
     }
 
@@ -160,6 +163,14 @@ bool BaseRenderNodeAnimator::animate(AnimationContext& context) {
     return false;
 }
 
+bool BaseRenderNodeAnimator::isHoldingValue(AnimationContext& context) {
+    if (mPlayState == NOT_STARTED) {
+        return true;
+    }
+    return mPlayState == RUNNING && mStartValueApplied
+            && mStartTime > context.frameTimeMs();
+}
+
 void BaseRenderNodeAnimator::forceEndNow(AnimationContext& context) {
     if (mPlayState < FINISHED) {
         mPlayState = FINISHED;
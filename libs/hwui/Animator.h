@@ -70,6 +70,9 @@ public:
 
     bool isRunning() { return mPlayState == RUNNING; }
     bool isFinished() { return mPlayState == FINISHED; }
+    // True if animate() at the current frame time can only re-apply the
+    // value this animator already set on a previous frame
+    bool isHoldingValue(AnimationContext& context);
     float finalValue() { return mFinalValue; }
 
     ANDROID_API virtual uint32_t dirtyMask() = 0;
@@ -104,6 +107,7 @@ protected:
     PlayState mStagingPlayState;
     PlayState mPlayState;
     bool mHasStartValue;
+    bool mStartValueApplied;
     nsecs_t mStartTime;
     nsecs_t mDuration;
     nsecs_t mStartDelay;
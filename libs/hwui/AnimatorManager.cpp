@@ -34,7 +34,8 @@ static void unref(BaseRenderNodeAnimator* animator) {
 
 AnimatorManager::AnimatorManager(RenderNode& parent)
         : mParent(parent)
-        , mAnimationHandle(nullptr) {
+        , mAnimationHandle(nullptr)
+        , mPropertiesPushed(false) {
 }
 
 AnimatorManager::~AnimatorManager() {
@@ -109,6 +110,18 @@ private:
 uint32_t AnimatorManager::animate(TreeInfo& info) {
     if (!mAnimators.size()) return 0;
 
+    // Animators waiting out a start delay re-apply the same start value every
+    // frame. The first frame they did so damaged the node, so as long as no
+    // staging properties were pushed since, a node where every animator is in
+    // that state can be animated without damaging it again. This keeps the
+    // not yet started items of a staggered animation out of the frame damage.
+    bool propertiesPushed = mPropertiesPushed;
+    mPropertiesPushed = false;
+    if (!propertiesPushed && allAnimatorsHoldingValue()) {
+        animateCommon(info);
+        return 0;
+    }
+
     // TODO: Can we target this better? For now treat it like any other staging
     // property push and just damage self before and after animators are run
 
@@ -123,6 +136,16 @@ uint32_t AnimatorManager::animate(TreeInfo& info) {
     return dirty;
 }
 
+bool AnimatorManager::allAnimatorsHoldingValue() {
+    AnimationContext& context = mAnimationHandle->context();
+    for (BaseRenderNodeAnimator* animator : mAnimators) {
+        if (!animator->isHoldingValue(context)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void AnimatorManager::animateNoDamage(TreeInfo& info) {
     if (!mAnimators.size()) return;
 
@@ -45,6 +45,10 @@ public:
 
     void pushStaging();
 
+    // Called by the parent after it copied changed staging properties, which
+    // may have moved it away from the values held by delayed animators
+    void notifyPropertiesPushed() { mPropertiesPushed = true; }
+
     // Returns the combined dirty mask of all animators run
     uint32_t animate(TreeInfo& info);
 
@@ -61,9 +65,11 @@ public:
 
 private:
     uint32_t animateCommon(TreeInfo& info);
+    bool allAnimatorsHoldingValue();
 
     RenderNode& mParent;
     AnimationHandle* mAnimationHandle;
+    bool mPropertiesPushed;
 
     // To improve the efficiency of resizing & removing from the vector
     // use manual ref counting instead of sp<>.
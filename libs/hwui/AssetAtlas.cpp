@@ -19,16 +19,46 @@
 #include "AssetAtlas.h"
 #include "Caches.h"
 #include "Image.h"
+#include "Properties.h"
 
 #include <GLES2/gl2ext.h>
 
 namespace android {
 namespace uirenderer {
 
+// Size in pixels of a dynamic atlas page, clamped to GL_MAX_TEXTURE_SIZE
+#define DYNAMIC_PAGE_SIZE 1024
+// Largest bitmap dimension packed into a dynamic page
+#define DYNAMIC_ENTRY_MAX_SIZE 256
+// Padding around each dynamic entry, filled with its edge pixels so that
+// bilinear filtering never samples a neighbour
+#define DYNAMIC_ENTRY_PADDING 1
+// Maximum number of bitmaps packed between two frames
+#define DYNAMIC_MAX_PENDING_ENTRIES 16
+// Number of updates a page is kept before it can be recycled, so that a working
+// set larger than the pages doesn't recycle one, and upload it again, every frame
+#define DYNAMIC_PAGE_MIN_UPDATES 60
+
 ///////////////////////////////////////////////////////////////////////////////
 // Lifecycle
 ///////////////////////////////////////////////////////////////////////////////
 
+AssetAtlas::AssetAtlas()
+        : mTexture(nullptr)
+        , mImage(nullptr)
+        , mBlendKey(true)
+        , mOpaqueKey(false)
+        , mMaxDynamicPages(DEFAULT_DYNAMIC_ATLAS_PAGES)
+        , mDynamicPageSize(0)
+        , mNextRecycledPage(0)
+        , mDynamicUpdateCount(0) {
+    char property[PROPERTY_VALUE_MAX];
+    if (property_get(PROPERTY_DYNAMIC_ATLAS_PAGES, property, nullptr) > 0) {
+        int pages = atoi(property);
+        mMaxDynamicPages = pages > 0 ? pages : 0;
+    }
+}
+
 void AssetAtlas::init(sp<GraphicBuffer> buffer, int64_t* map, int count) {
     if (mImage) {
         return;
@@ -60,6 +90,7 @@ void AssetAtlas::terminate() {
         mImage = nullptr;
         updateTextureId();
     }
+    destroyDynamicPages();
 }
 
 
@@ -86,9 +117,19 @@ AssetAtlas::Entry* AssetAtlas::getEntry(const SkBitmap* bitmap) const {
     return index >= 0 ? mEntries.valueAt(index) : nullptr;
 }
 
+AssetAtlas::Entry* AssetAtlas::getDynamicEntry(const SkBitmap* bitmap) const {
+    if (mDynamicEntries.isEmpty() || !bitmap->pixelRef()) return nullptr;
+    ssize_t index = mDynamicEntries.indexOfKey(bitmap->pixelRef()->getStableID());
+    return index >= 0 ? mDynamicEntries.valueAt(index) : nullptr;
+}
+
 Texture* AssetAtlas::getEntryTexture(const SkBitmap* bitmap) const {
     ssize_t index = mEntries.indexOfKey(bitmap->pixelRef());
-    return index >= 0 ? mEntries.valueAt(index)->texture : nullptr;
+    if (index >= 0) {
+        return mEntries.valueAt(index)->texture;
+    }
+    Entry* entry = getDynamicEntry(bitmap);
+    return entry ? entry->texture : nullptr;
 }
 
 /**
@@ -138,12 +179,231 @@ void AssetAtlas::createEntries(Caches& caches, int64_t* map, int count) {
         texture->width = pixelRef->info().width();
         texture->height = pixelRef->info().height();
 
-        Entry* entry = new Entry(pixelRef, texture, mapper, *this);
+        Entry* entry = new Entry(pixelRef, texture, mapper, &mBlendKey, &mOpaqueKey);
         texture->uvMapper = &entry->uvMapper;
 
         mEntries.add(entry->pixelRef, entry);
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Dynamic pages
+///////////////////////////////////////////////////////////////////////////////
+
+bool AssetAtlas::ShelfPacker::allocate(uint32_t width, uint32_t height,
+        uint32_t* outX, uint32_t* outY) {
+    if (width > mSize) {
+        return false;
+    }
+    if (mShelfX + width > mSize) {
+        // Start a new shelf on top of the current one
+        mShelfY += mShelfHeight;
+        mShelfX = 0;
+        mShelfHeight = 0;
+    }
+    if (mShelfY + height > mSize) {
+        return false;
+    }
+
+    *outX = mShelfX;
+    *outY = mShelfY;
+    mShelfX += width;
+    mShelfHeight = std::max(mShelfHeight, height);
+    return true;
+}
+
+bool AssetAtlas::isDynamicCandidate(const SkBitmap* bitmap) const {
+    // Only immutable bitmaps: a dynamic entry is never re-uploaded
+    return mMaxDynamicPages > 0
+            && bitmap->pixelRef()
+            && bitmap->isImmutable()
+            && bitmap->colorType() == kN32_SkColorType
+            && bitmap->width() > 0 && bitmap->width() <= DYNAMIC_ENTRY_MAX_SIZE
+            && bitmap->height() > 0 && bitmap->height() <= DYNAMIC_ENTRY_MAX_SIZE
+            && mEntries.indexOfKey(bitmap->pixelRef()) < 0
+            && mDynamicEntries.indexOfKey(bitmap->pixelRef()->getStableID()) < 0;
+}
+
+void AssetAtlas::requestDynamicEntry(const SkBitmap* bitmap) {
+    if (mPendingBitmaps.size() >= DYNAMIC_MAX_PENDING_ENTRIES
+            || !isDynamicCandidate(bitmap)) {
+        return;
+    }
+    const uint32_t stableId = bitmap->pixelRef()->getStableID();
+    for (const SkBitmap& pending : mPendingBitmaps) {
+        if (pending.pixelRef()->getStableID() == stableId) return;
+    }
+    mPendingBitmaps.push_back(*bitmap);
+}
+
+void AssetAtlas::updateDynamicPages() {
+    if (CC_LIKELY(mPendingBitmaps.empty())) return;
+
+    ATRACE_NAME("AssetAtlas::updateDynamicPages");
+    mDynamicUpdateCount++;
+    for (const SkBitmap& bitmap : mPendingBitmaps) {
+        // The entry may have been created by an earlier request in this batch
+        if (isDynamicCandidate(&bitmap)) {
+            addDynamicEntry(bitmap);
+        }
+    }
+    mPendingBitmaps.clear();
+}
+
+AssetAtlas::DynamicPage* AssetAtlas::findDynamicSpace(uint32_t width, uint32_t height,
+        uint32_t* outX, uint32_t* outY) {
+    for (DynamicPage* page : mDynamicPages) {
+        if (page->packer.allocate(width, height, outX, outY)) {
+            return page;
+        }
+    }
+
+    Caches& caches = Caches::getInstance();
+    if (mDynamicPages.size() < mMaxDynamicPages) {
+        if (!mDynamicPageSize) {
+            mDynamicPageSize = std::min(DYNAMIC_PAGE_SIZE, caches.maxTextureSize);
+        }
+        if (!caches.textureCache.reserve(dynamicPageBytes())) {
+            // Textures in use during this frame take all the budget
+            return nullptr;
+        }
+
+        DynamicPage* page = new DynamicPage(mDynamicPageSize, mDynamicUpdateCount);
+        page->texture = new Texture(caches);
+        page->texture->width = mDynamicPageSize;
+        page->texture->height = mDynamicPageSize;
+        page->texture->blend = true;
+        glGenTextures(1, &page->texture->id);
+        caches.textureState().bindTexture(page->texture->id);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mDynamicPageSize, mDynamicPageSize, 0,
+                GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        page->texture->setWrap(GL_CLAMP_TO_EDGE, false, true);
+        page->texture->setFilter(GL_NEAREST, false, true);
+        mDynamicPages.push_back(page);
+
+        return page->packer.allocate(width, height, outX, outY) ? page : nullptr;
+    }
+
+    if (mDynamicPages.empty()) return nullptr;
+
+    // All pages are full, start over with the least recently recycled one;
+    // its bitmaps fall back to the texture cache until requested again. A
+    // page filled recently, this update included, is kept as it is
+    DynamicPage* page = mDynamicPages[mNextRecycledPage];
+    if (mDynamicUpdateCount - page->filledAt < DYNAMIC_PAGE_MIN_UPDATES) {
+        return nullptr;
+    }
+    mNextRecycledPage = (mNextRecycledPage + 1) % mDynamicPages.size();
+    recycleDynamicPage(page);
+    return page->packer.allocate(width, height, outX, outY) ? page : nullptr;
+}
+
+void AssetAtlas::addDynamicEntry(const SkBitmap& bitmap) {
+    SkAutoLockPixels alp(bitmap);
+    if (!bitmap.readyToDraw()) return;
+
+    const uint32_t width = bitmap.width();
+    const uint32_t height = bitmap.height();
+    const uint32_t paddedWidth = width + 2 * DYNAMIC_ENTRY_PADDING;
+    const uint32_t paddedHeight = height + 2 * DYNAMIC_ENTRY_PADDING;
+
+    uint32_t x, y;
+    DynamicPage* page = findDynamicSpace(paddedWidth, paddedHeight, &x, &y);
+    if (!page) return;
+
+    // Replicate the edge pixels into the padding so the whole block can be
+    // uploaded with a single glTexSubImage2D()
+    std::unique_ptr<uint32_t[]> pixels(new uint32_t[paddedWidth * paddedHeight]);
+    for (uint32_t row = 0; row < paddedHeight; row++) {
+        int srcRow = int(row) - DYNAMIC_ENTRY_PADDING;
+        srcRow = std::max(0, std::min(srcRow, int(height) - 1));
+        const uint32_t* src = bitmap.getAddr32(0, srcRow);
+        uint32_t* dst = &pixels[row * paddedWidth];
+        for (uint32_t i = 0; i < DYNAMIC_ENTRY_PADDING; i++) {
+            dst[i] = src[0];
+            dst[paddedWidth - 1 - i] = src[width - 1];
+        }
+        memcpy(dst + DYNAMIC_ENTRY_PADDING, src, width * sizeof(uint32_t));
+    }
+
+    Caches& caches = Caches::getInstance();
+    caches.textureState().bindTexture(page->texture->id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, paddedWidth, paddedHeight,
+            GL_RGBA, GL_UNSIGNED_BYTE, pixels.get());
+
+    const float size = float(mDynamicPageSize);
+    const uint32_t left = x + DYNAMIC_ENTRY_PADDING;
+    const uint32_t top = y + DYNAMIC_ENTRY_PADDING;
+    const UvMapper mapper(left / size, (left + width) / size,
+            top / size, (top + height) / size);
+
+    Texture* texture = new DelegateTexture(caches, page->texture);
+    texture->id = page->texture->id;
+    texture->blend = !bitmap.isOpaque();
+    texture->width = width;
+    texture->height = height;
+
+    Entry* entry = new Entry(nullptr, texture, mapper, &page->blendKey, &page->opaqueKey);
+    texture->uvMapper = &entry->uvMapper;
+
+    const uint32_t stableId = bitmap.pixelRef()->getStableID();
+    mDynamicEntries.add(stableId, entry);
+    page->entries.push(stableId);
+}
+
+void AssetAtlas::releaseDynamicEntry(uint32_t pixelRefStableID) {
+    ssize_t index = mDynamicEntries.indexOfKey(pixelRefStableID);
+    if (index < 0) return;
+
+    delete mDynamicEntries.valueAt(index);
+    mDynamicEntries.removeItemsAt(index);
+    // The space is reclaimed when the page is recycled, or as soon as it
+    // has no entries left
+    for (DynamicPage* page : mDynamicPages) {
+        for (size_t i = 0; i < page->entries.size(); i++) {
+            if (page->entries[i] == pixelRefStableID) {
+                page->entries.removeAt(i);
+                if (page->entries.isEmpty()) {
+                    page->packer.reset();
+                }
+                return;
+            }
+        }
+    }
+}
+
+void AssetAtlas::recycleDynamicPage(DynamicPage* page) {
+    for (size_t i = 0; i < page->entries.size(); i++) {
+        ssize_t index = mDynamicEntries.indexOfKey(page->entries[i]);
+        if (index >= 0) {
+            delete mDynamicEntries.valueAt(index);
+            mDynamicEntries.removeItemsAt(index);
+        }
+    }
+    page->entries.clear();
+    page->packer.reset();
+    page->filledAt = mDynamicUpdateCount;
+}
+
+void AssetAtlas::destroyDynamicPages() {
+    for (size_t i = 0; i < mDynamicEntries.size(); i++) {
+        delete mDynamicEntries.valueAt(i);
+    }
+    mDynamicEntries.clear();
+
+    if (!mDynamicPages.empty()) {
+        Caches::getInstance().textureCache.unreserve(mDynamicPages.size() * dynamicPageBytes());
+    }
+    for (DynamicPage* page : mDynamicPages) {
+        page->texture->deleteTexture();
+        delete page->texture;
+        delete page;
+    }
+    mDynamicPages.clear();
+    mNextRecycledPage = 0;
+    mPendingBitmaps.clear();
+}
+
 }; // namespace uirenderer
 }; // namespace android
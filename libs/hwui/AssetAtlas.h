@@ -27,6 +27,8 @@
 
 #include <SkBitmap.h>
 
+#include <vector>
+
 #include "Texture.h"
 #include "UvMapper.h"
 
@@ -41,6 +43,12 @@ class Image;
  * texture. Each bitmap is associated with a location, defined in pixels,
  * inside the atlas. The atlas is generated by the framework and bound as
  * an external texture using the EGLImageKHR extension.
+ *
+ * In addition to the framework page, the atlas can pack frequently drawn,
+ * immutable app bitmaps into process-local dynamic pages at runtime (see
+ * PROPERTY_DYNAMIC_ATLAS_PAGES). Dynamic entries only change between frames
+ * and callers must not hold on to them across frames: a dynamic page can be
+ * recycled when the atlas runs out of space.
  */
 class AssetAtlas {
 public:
@@ -65,29 +73,32 @@ public:
 
         /**
          * Unique identifier used to merge bitmaps and 9-patches stored
-         * in the atlas.
+         * in the same atlas page.
          */
         const void* getMergeId() const {
-            return texture->blend ? &atlas.mBlendKey : &atlas.mOpaqueKey;
+            return texture->blend ? blendKey : opaqueKey;
         }
 
     private:
         /**
-         * The pixel ref that generated this atlas entry.
+         * The pixel ref that generated this atlas entry. Null for
+         * dynamic entries, which are keyed by the pixel ref's stable ID.
          */
         SkPixelRef* pixelRef;
 
         /**
-         * Atlas this entry belongs to.
+         * Merge keys of the page this entry belongs to.
          */
-        const AssetAtlas& atlas;
+        const void* blendKey;
+        const void* opaqueKey;
 
         Entry(SkPixelRef* pixelRef, Texture* texture, const UvMapper& mapper,
-                    const AssetAtlas& atlas)
+                    const void* blendKey, const void* opaqueKey)
                 : texture(texture)
                 , uvMapper(mapper)
                 , pixelRef(pixelRef)
-                , atlas(atlas) {
+                , blendKey(blendKey)
+                , opaqueKey(opaqueKey) {
         }
 
         ~Entry() {
@@ -97,8 +108,37 @@ public:
         friend class AssetAtlas;
     };
 
-    AssetAtlas(): mTexture(nullptr), mImage(nullptr),
-            mBlendKey(true), mOpaqueKey(false) { }
+    /**
+     * Packs rectangles into a square area in shelves: rows as tall as their
+     * tallest rectangle, filled left to right, stacked bottom to top. Space
+     * is only reclaimed all at once, by reset().
+     */
+    class ShelfPacker {
+    public:
+        explicit ShelfPacker(uint32_t size)
+                : mSize(size), mShelfX(0), mShelfY(0), mShelfHeight(0) {
+        }
+
+        /**
+         * Finds room for a width x height rectangle and returns its
+         * position, or false if the area is full.
+         */
+        bool allocate(uint32_t width, uint32_t height, uint32_t* outX, uint32_t* outY);
+
+        void reset() {
+            mShelfX = 0;
+            mShelfY = 0;
+            mShelfHeight = 0;
+        }
+
+    private:
+        uint32_t mSize;
+        uint32_t mShelfX;
+        uint32_t mShelfY;
+        uint32_t mShelfHeight;
+    };
+
+    AssetAtlas();
     ~AssetAtlas() { terminate(); }
 
     /**
@@ -118,7 +158,8 @@ public:
      * re-initialized after calling this method.
      *
      * After calling this method, the width, height
-     * and texture are set to 0.
+     * and texture are set to 0. Dynamic pages and their
+     * entries are destroyed.
      */
     void terminate();
 
@@ -147,21 +188,78 @@ public:
     }
 
     /**
-     * Returns the entry in the atlas associated with the specified
-     * bitmap. If the bitmap is not in the atlas, return NULL.
+     * Returns the entry in the framework page associated with the
+     * specified bitmap. If the bitmap is not in the atlas, return NULL.
+     * Framework entries live as long as the atlas and can be cached.
      */
     Entry* getEntry(const SkBitmap* bitmap) const;
 
     /**
-     * Returns the texture for the atlas entry associated with the
-     * specified bitmap. If the bitmap is not in the atlas, return NULL.
+     * Returns the entry in a dynamic page associated with the specified
+     * bitmap, or NULL. The entry is only valid for the current frame.
+     */
+    Entry* getDynamicEntry(const SkBitmap* bitmap) const;
+
+    /**
+     * Returns the texture for the atlas entry, framework or dynamic,
+     * associated with the specified bitmap. If the bitmap is not in the
+     * atlas, return NULL. Callers must map texture coordinates through
+     * the returned texture's uvMapper.
      */
     Texture* getEntryTexture(const SkBitmap* bitmap) const;
 
+    /**
+     * Asks for the specified bitmap to be packed into a dynamic page. The
+     * request is ignored if the bitmap is not eligible; eligible bitmaps are
+     * packed by the next call to updateDynamicPages().
+     */
+    void requestDynamicEntry(const SkBitmap* bitmap);
+
+    /**
+     * Packs and uploads the bitmaps requested during the frame. Must be called
+     * between frames, with the GL context current.
+     */
+    void updateDynamicPages();
+
+    /**
+     * Removes the dynamic entry of a pixel ref that was destroyed.
+     */
+    void releaseDynamicEntry(uint32_t pixelRefStableID);
+
 private:
+    /**
+     * A process-local atlas page. Its texture is accounted in the budget of
+     * the texture cache.
+     */
+    struct DynamicPage {
+        DynamicPage(uint32_t size, uint32_t update): texture(nullptr), packer(size),
+                filledAt(update), blendKey(true), opaqueKey(false) { }
+
+        Texture* texture;
+        ShelfPacker packer;
+        // Stable IDs of the entries packed in this page
+        Vector<uint32_t> entries;
+        // Update in which the page was created or last recycled
+        uint32_t filledAt;
+
+        const bool blendKey;
+        const bool opaqueKey;
+    };
+
     void createEntries(Caches& caches, int64_t* map, int count);
     void updateTextureId();
 
+    bool isDynamicCandidate(const SkBitmap* bitmap) const;
+    DynamicPage* findDynamicSpace(uint32_t width, uint32_t height,
+            uint32_t* outX, uint32_t* outY);
+    void addDynamicEntry(const SkBitmap& bitmap);
+    void recycleDynamicPage(DynamicPage* page);
+    void destroyDynamicPages();
+
+    uint32_t dynamicPageBytes() const {
+        return mDynamicPageSize * mDynamicPageSize * 4;
+    }
+
     Texture* mTexture;
     Image* mImage;
 
@@ -169,6 +267,17 @@ private:
     const bool mOpaqueKey;
 
     KeyedVector<const SkPixelRef*, Entry*> mEntries;
+
+    size_t mMaxDynamicPages;
+    uint32_t mDynamicPageSize;
+    size_t mNextRecycledPage;
+    // Number of updateDynamicPages() calls that packed bitmaps
+    uint32_t mDynamicUpdateCount;
+    std::vector<DynamicPage*> mDynamicPages;
+    KeyedVector<uint32_t, Entry*> mDynamicEntries;
+    // Bitmaps requested during the current frame, these copies keep the
+    // pixel refs alive until updateDynamicPages()
+    std::vector<SkBitmap> mPendingBitmaps;
 }; // class AssetAtlas
 
 }; // namespace uirenderer
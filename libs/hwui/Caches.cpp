@@ -24,7 +24,9 @@
 #include "renderstate/RenderState.h"
 #include "ShadowTessellator.h"
 #include "utils/GLUtils.h"
+#include "utils/LinearAllocator.h"
 
+#include <algorithm>
 #include <utils/Log.h>
 #include <utils/String8.h>
 
@@ -43,6 +45,13 @@ Caches* Caches::sInstance = nullptr;
     #define FLUSH_LOGD(...)
 #endif
 
+// Number of frames between two cache budget balancing passes
+#define BUDGET_BALANCE_INTERVAL 60
+// A cache borrows budget after this many misses in one interval while it
+// was at least BUDGET_PRESSURE_FILL full
+#define BUDGET_PRESSURE_MISSES 4
+#define BUDGET_PRESSURE_FILL 0.9f
+
 ///////////////////////////////////////////////////////////////////////////////
 // Constructors/destructor
 ///////////////////////////////////////////////////////////////////////////////
@@ -51,11 +60,13 @@ Caches::Caches(RenderState& renderState)
         : gradientCache(mExtensions)
         , patchCache(renderState)
         , programCache(mExtensions)
+        , tessellationCache(renderState)
         , dither(*this)
         , mRenderState(&renderState)
         , mInitialized(false) {
     INIT_LOGD("Creating OpenGL renderer caches");
     init();
+    initCacheBudgets();
     initFont();
     initConstraints();
     initStaticProperties();
@@ -73,6 +84,7 @@ bool Caches::init() {
     mFunctorsCount = 0;
 
     patchCache.init();
+    programCache.loadBinaries();
 
     mInitialized = true;
 
@@ -103,6 +115,12 @@ void Caches::initConstraints() {
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
 }
 
+void Caches::initCacheBudgets() {
+    mCacheBudgets[kBudgetedCache_Texture] = { textureCache.getMaxSize(), 0, 0 };
+    mCacheBudgets[kBudgetedCache_Gradient] = { gradientCache.getMaxSize(), 0, 0 };
+    mCacheBudgets[kBudgetedCache_DropShadow] = { dropShadowCache.getMaxSize(), 0, 0 };
+}
+
 void Caches::initStaticProperties() {
     gpuPixelBuffersEnabled = false;
 
@@ -121,10 +139,13 @@ void Caches::terminate() {
 
     fboCache.clear();
 
+    programCache.saveBinaries();
     programCache.clear();
     mProgram = nullptr;
 
     patchCache.clear();
+    // Cached round rects hold VBOs of this context
+    tessellationCache.clear();
 
     clearGarbage();
 
@@ -173,11 +194,18 @@ void Caches::dumpMemoryUsage() {
     ALOGD("%s", stringLog.string());
 }
 
+static float hitRate(uint32_t hits, uint32_t misses) {
+    uint32_t lookups = hits + misses;
+    return lookups ? hits * 100.0f / lookups : 0.0f;
+}
+
 void Caches::dumpMemoryUsage(String8 &log) {
     uint32_t total = 0;
     log.appendFormat("Current memory usage / total memory usage (bytes):\n");
-    log.appendFormat("  TextureCache         %8d / %8d\n",
-            textureCache.getSize(), textureCache.getMaxSize());
+    log.appendFormat("  TextureCache         %8d / %8d (base %d, hit rate %.1f%%)\n",
+            textureCache.getSize(), textureCache.getMaxSize(),
+            mCacheBudgets[kBudgetedCache_Texture].baseSize,
+            hitRate(textureCache.getHitCount(), textureCache.getMissCount()));
     log.appendFormat("  LayerCache           %8d / %8d (numLayers = %zu)\n",
             layerCache.getSize(), layerCache.getMaxSize(), layerCache.getCount());
     if (mRenderState) {
@@ -197,14 +225,18 @@ void Caches::dumpMemoryUsage(String8 &log) {
     }
     log.appendFormat("  RenderBufferCache    %8d / %8d\n",
             renderBufferCache.getSize(), renderBufferCache.getMaxSize());
-    log.appendFormat("  GradientCache        %8d / %8d\n",
-            gradientCache.getSize(), gradientCache.getMaxSize());
+    log.appendFormat("  GradientCache        %8d / %8d (base %d, hit rate %.1f%%)\n",
+            gradientCache.getSize(), gradientCache.getMaxSize(),
+            mCacheBudgets[kBudgetedCache_Gradient].baseSize,
+            hitRate(gradientCache.getHitCount(), gradientCache.getMissCount()));
     log.appendFormat("  PathCache            %8d / %8d\n",
             pathCache.getSize(), pathCache.getMaxSize());
     log.appendFormat("  TessellationCache    %8d / %8d\n",
             tessellationCache.getSize(), tessellationCache.getMaxSize());
-    log.appendFormat("  TextDropShadowCache  %8d / %8d\n", dropShadowCache.getSize(),
-            dropShadowCache.getMaxSize());
+    log.appendFormat("  TextDropShadowCache  %8d / %8d (base %d, hit rate %.1f%%)\n",
+            dropShadowCache.getSize(), dropShadowCache.getMaxSize(),
+            mCacheBudgets[kBudgetedCache_DropShadow].baseSize,
+            hitRate(dropShadowCache.getHitCount(), dropShadowCache.getMissCount()));
     log.appendFormat("  PatchCache           %8d / %8d\n",
             patchCache.getSize(), patchCache.getMaxSize());
     for (uint32_t i = 0; i < fontRenderer->getFontRendererCount(); i++) {
@@ -218,6 +250,10 @@ void Caches::dumpMemoryUsage(String8 &log) {
     log.appendFormat("Other:\n");
     log.appendFormat("  FboCache             %8d / %8d\n",
             fboCache.getSize(), fboCache.getMaxSize());
+    LinearAllocator::PagePoolStats pagePool = LinearAllocator::getPagePoolStats();
+    log.appendFormat("  LinearAllocator pool %8zu / %8zu (pages reused %zu, allocated %zu)\n",
+            pagePool.pooledSize, pagePool.maxPooledSize,
+            pagePool.reusedPages, pagePool.allocatedPages);
 
     total += textureCache.getSize();
     total += renderBufferCache.getSize();
@@ -243,9 +279,77 @@ void Caches::clearGarbage() {
     textureCache.clearGarbage();
     pathCache.clearGarbage();
     patchCache.clearGarbage();
+
+    if (++mFramesSinceBudgetBalance >= BUDGET_BALANCE_INTERVAL) {
+        mFramesSinceBudgetBalance = 0;
+        balanceCacheBudgets();
+    }
+}
+
+void Caches::balanceCacheBudgets() {
+    const uint32_t size[kBudgetedCache_Count] = {
+            textureCache.getSize(), gradientCache.getSize(), dropShadowCache.getSize() };
+    const uint32_t maxSize[kBudgetedCache_Count] = {
+            textureCache.getMaxSize(), gradientCache.getMaxSize(), dropShadowCache.getMaxSize() };
+    const uint32_t hits[kBudgetedCache_Count] = {
+            textureCache.getHitCount(), gradientCache.getHitCount(),
+            dropShadowCache.getHitCount() };
+    const uint32_t misses[kBudgetedCache_Count] = {
+            textureCache.getMissCount(), gradientCache.getMissCount(),
+            dropShadowCache.getMissCount() };
+
+    uint32_t windowHits[kBudgetedCache_Count];
+    uint32_t windowMisses[kBudgetedCache_Count];
+    int borrower = -1;
+    for (int i = 0; i < kBudgetedCache_Count; i++) {
+        windowHits[i] = hits[i] - mCacheBudgets[i].hitCount;
+        windowMisses[i] = misses[i] - mCacheBudgets[i].missCount;
+        mCacheBudgets[i].hitCount = hits[i];
+        mCacheBudgets[i].missCount = misses[i];
+
+        // The cache that missed the most while close to its budget borrows
+        if (windowMisses[i] >= BUDGET_PRESSURE_MISSES
+                && size[i] >= maxSize[i] * BUDGET_PRESSURE_FILL
+                && (borrower < 0 || windowMisses[i] > windowMisses[borrower])) {
+            borrower = i;
+        }
+    }
+    if (borrower < 0) return;
+
+    uint32_t newMaxSize[kBudgetedCache_Count];
+    uint32_t borrowed = 0;
+    for (int i = 0; i < kBudgetedCache_Count; i++) {
+        newMaxSize[i] = maxSize[i];
+        if (i == borrower || windowMisses[i] >= BUDGET_PRESSURE_MISSES) continue;
+
+        // Donors only give up space they do not use and keep at least half
+        // of their configured size. A cache not looked up at all during the
+        // interval gives all of its headroom, others give half of it
+        uint32_t floor = std::max(size[i], mCacheBudgets[i].baseSize / 2);
+        if (maxSize[i] <= floor) continue;
+        uint32_t headroom = maxSize[i] - floor;
+        uint32_t donation = (windowHits[i] + windowMisses[i]) ? headroom / 2 : headroom;
+        newMaxSize[i] -= donation;
+        borrowed += donation;
+    }
+    if (!borrowed) return;
+    newMaxSize[borrower] += borrowed;
+
+    FLUSH_LOGD("Cache %d borrows %u bytes (%u misses)", borrower, borrowed,
+            windowMisses[borrower]);
+    textureCache.setMaxSize(newMaxSize[kBudgetedCache_Texture]);
+    gradientCache.setMaxSize(newMaxSize[kBudgetedCache_Gradient]);
+    dropShadowCache.setMaxSize(newMaxSize[kBudgetedCache_DropShadow]);
 }
 
-void Caches::flush(FlushMode mode) {
+void Caches::resetCacheBudgets() {
+    textureCache.setMaxSize(mCacheBudgets[kBudgetedCache_Texture].baseSize);
+    gradientCache.setMaxSize(mCacheBudgets[kBudgetedCache_Gradient].baseSize);
+    dropShadowCache.setMaxSize(mCacheBudgets[kBudgetedCache_DropShadow].baseSize);
+    mFramesSinceBudgetBalance = 0;
+}
+
+void Caches::flush(FlushMode mode, bool finish) {
     FLUSH_LOGD("Flushing caches (mode %d)", mode);
 
     switch (mode) {
@@ -259,10 +363,15 @@ void Caches::flush(FlushMode mode) {
             dither.clear();
             // fall through
         case kFlushMode_Moderate:
+            // a good time to persist the programs linked so far, the
+            // process is likely to be in the background
+            programCache.saveBinaries();
+            resetCacheBudgets();
             fontRenderer->flush();
             textureCache.flush();
             pathCache.clear();
             tessellationCache.clear();
+            LinearAllocator::trimPagePool();
             // fall through
         case kFlushMode_Layers:
             layerCache.clear();
@@ -271,7 +380,11 @@ void Caches::flush(FlushMode mode) {
     }
 
     clearGarbage();
-    glFinish();
+    if (finish) {
+        glFinish();
+    } else {
+        glFlush();
+    }
     // Errors during cleanup should be considered non-fatal, dump them and
     // and move on. TODO: All errors or just errors like bad surface?
     GLUtils::dumpGLErrors();
@@ -102,8 +102,11 @@ public:
      * Flush the cache.
      *
      * @param mode Indicates how much of the cache should be flushed
+     * @param finish If true, waits for the GPU to be done with everything
+     *        queued so far, letting the driver free the memory right away.
+     *        Otherwise the deletes are only flushed to the GPU.
      */
-    void flush(FlushMode mode);
+    void flush(FlushMode mode, bool finish = true);
 
     /**
      * Destroys all resources associated with this cache. This should
@@ -196,6 +199,30 @@ private:
     void initConstraints();
     void initStaticProperties();
 
+    /**
+     * The texture, gradient and drop shadow caches share the sum of their
+     * configured sizes. Every few frames a cache that kept missing while
+     * full borrows headroom the others leave unused; trimming memory hands
+     * every cache its configured size back.
+     */
+    enum BudgetedCache {
+        kBudgetedCache_Texture = 0,
+        kBudgetedCache_Gradient,
+        kBudgetedCache_DropShadow,
+        kBudgetedCache_Count
+    };
+
+    struct CacheBudget {
+        uint32_t baseSize;
+        // Lookup counters of the cache at the last balancing pass
+        uint32_t hitCount;
+        uint32_t missCount;
+    };
+
+    void initCacheBudgets();
+    void balanceCacheBudgets();
+    void resetCacheBudgets();
+
     static void eventMarkNull(GLsizei length, const GLchar* marker) { }
     static void startMarkNull(GLsizei length, const GLchar* marker) { }
     static void endMarkNull() { }
@@ -212,6 +239,9 @@ private:
 
     uint32_t mFunctorsCount;
 
+    CacheBudget mCacheBudgets[kBudgetedCache_Count];
+    uint32_t mFramesSinceBudgetBalance = 0;
+
     // TODO: move below to RenderState
     PixelBufferState* mPixelBufferState = nullptr;
     TextureState* mTextureState = nullptr;
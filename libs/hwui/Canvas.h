@@ -58,6 +58,12 @@ public:
 
     virtual void setBitmap(const SkBitmap& bitmap) = 0;
 
+    /**
+     *  Returns true if this is a uirenderer::DisplayListCanvas, recording
+     *  hwui display lists rather than drawing through Skia.
+     */
+    virtual bool isHardwareAccelerated() const = 0;
+
     virtual bool isOpaque() = 0;
     virtual int width() = 0;
     virtual int height() = 0;
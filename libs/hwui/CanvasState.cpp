@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#include <new>
+#include <stdlib.h>
+
 #include <SkCanvas.h>
 
 #include "CanvasState.h"
@@ -22,6 +25,8 @@
 namespace android {
 namespace uirenderer {
 
+// Restored snapshots kept around for reuse, deeper save stacks are rare
+#define MAX_SNAPSHOT_POOL_SIZE 10
 
 CanvasState::CanvasState(CanvasStateClient& renderer)
         : mDirtyClip(false)
@@ -30,17 +35,61 @@ CanvasState::CanvasState(CanvasStateClient& renderer)
         , mSaveCount(1)
         , mFirstSnapshot(new Snapshot)
         , mCanvas(renderer)
-        , mSnapshot(mFirstSnapshot) {
+        , mSnapshot(mFirstSnapshot)
+        , mSnapshotPool(nullptr)
+        , mSnapshotPoolCount(0) {
 
 }
 
 CanvasState::~CanvasState() {
+    freeAllSnapshots();
+    delete mFirstSnapshot;
+    while (mSnapshotPool) {
+        Snapshot* pooled = mSnapshotPool;
+        mSnapshotPool = pooled->previous;
+        free(pooled);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Snapshot pool
+///////////////////////////////////////////////////////////////////////////////
+
+Snapshot* CanvasState::allocSnapshot(Snapshot* previous, int saveFlags) {
+    void* memory;
+    if (mSnapshotPool) {
+        memory = mSnapshotPool;
+        mSnapshotPool = mSnapshotPool->previous;
+        mSnapshotPoolCount--;
+    } else {
+        memory = malloc(sizeof(Snapshot));
+    }
+    return new (memory) Snapshot(previous, saveFlags);
+}
 
+void CanvasState::freeSnapshot(Snapshot* snapshot) {
+    snapshot->~Snapshot();
+    if (mSnapshotPoolCount >= MAX_SNAPSHOT_POOL_SIZE) {
+        free(snapshot);
+    } else {
+        snapshot->previous = mSnapshotPool;
+        mSnapshotPool = snapshot;
+        mSnapshotPoolCount++;
+    }
+}
+
+void CanvasState::freeAllSnapshots() {
+    while (mSnapshot != mFirstSnapshot) {
+        Snapshot* previous = mSnapshot->previous;
+        freeSnapshot(mSnapshot);
+        mSnapshot = previous;
+    }
 }
 
 void CanvasState::initializeSaveStack(float clipLeft, float clipTop,
         float clipRight, float clipBottom, const Vector3& lightCenter) {
-    mSnapshot = new Snapshot(mFirstSnapshot,
+    freeAllSnapshots();
+    mSnapshot = allocSnapshot(mFirstSnapshot,
             SkCanvas::kMatrix_SaveFlag | SkCanvas::kClip_SaveFlag);
     mSnapshot->setClip(clipLeft, clipTop, clipRight, clipBottom);
     mSnapshot->fbo = mCanvas.getTargetFbo();
@@ -57,7 +106,8 @@ void CanvasState::setViewport(int width, int height) {
     // create a temporary 1st snapshot, so old snapshots are released,
     // and viewport can be queried safely.
     // TODO: remove, combine viewport + save stack initialization
-    mSnapshot = new Snapshot(mFirstSnapshot,
+    freeAllSnapshots();
+    mSnapshot = allocSnapshot(mFirstSnapshot,
             SkCanvas::kMatrix_SaveFlag | SkCanvas::kClip_SaveFlag);
     mSaveCount = 1;
 }
@@ -73,7 +123,7 @@ void CanvasState::setViewport(int width, int height) {
  * stack, and ensures restoreToCount() doesn't call back into subclass overrides.
  */
 int CanvasState::saveSnapshot(int flags) {
-    mSnapshot = new Snapshot(mSnapshot, flags);
+    mSnapshot = allocSnapshot(mSnapshot, flags);
     return mSaveCount++;
 }
 
@@ -85,14 +135,16 @@ int CanvasState::save(int flags) {
  * Guaranteed to restore without side-effects.
  */
 void CanvasState::restoreSnapshot() {
-    sp<Snapshot> toRemove = mSnapshot;
-    sp<Snapshot> toRestore = mSnapshot->previous;
+    Snapshot* toRemove = mSnapshot;
+    Snapshot* toRestore = mSnapshot->previous;
 
     mSaveCount--;
     mSnapshot = toRestore;
 
     // subclass handles restore implementation
     mCanvas.onSnapshotRestored(*toRemove, *toRestore);
+
+    freeSnapshot(toRemove);
 }
 
 void CanvasState::restore() {
@@ -160,15 +160,20 @@ public:
     bool clipIsSimple() const { return currentSnapshot()->clipIsSimple(); }
 
     inline const Snapshot* currentSnapshot() const {
-        return mSnapshot != nullptr ? mSnapshot.get() : mFirstSnapshot.get();
+        return mSnapshot != nullptr ? mSnapshot : mFirstSnapshot;
     }
-    inline Snapshot* writableSnapshot() { return mSnapshot.get(); }
-    inline const Snapshot* firstSnapshot() const { return mFirstSnapshot.get(); }
+    inline Snapshot* writableSnapshot() { return mSnapshot; }
+    inline const Snapshot* firstSnapshot() const { return mFirstSnapshot; }
 
 private:
     /// No default constructor - must supply a CanvasStateClient (mCanvas).
     CanvasState();
 
+    /// Snapshots are recycled through a free list, save() is a hot path
+    Snapshot* allocSnapshot(Snapshot* previous, int saveFlags);
+    void freeSnapshot(Snapshot* snapshot);
+    void freeAllSnapshots();
+
     /// indicates that the clip has been changed since the last time it was consumed
     bool mDirtyClip;
 
@@ -179,13 +184,17 @@ private:
     int mSaveCount;
 
     /// Base state
-    sp<Snapshot> mFirstSnapshot;
+    Snapshot* mFirstSnapshot;
 
     /// Host providing callbacks
     CanvasStateClient& mCanvas;
 
     /// Current state
-    sp<Snapshot> mSnapshot;
+    Snapshot* mSnapshot;
+
+    /// Storage of restored snapshots, linked through Snapshot::previous
+    Snapshot* mSnapshotPool;
+    int mSnapshotPoolCount;
 
 }; // class CanvasState
 
@@ -16,6 +16,7 @@
 #include "ClipArea.h"
 
 #include <SkPath.h>
+#include <cmath>
 #include <limits>
 
 #include "Rect.h"
@@ -74,6 +75,46 @@ bool TransformedRectangle::intersectWith(const TransformedRectangle& other) {
     return intersect(mBounds, translatedBounds);
 }
 
+// Float rounding leaves a tiny skew in the transform relating a rotated
+// parent to an offset child, this keeps the error well under 0.1px
+static const float kAxisAlignedEpsilon = 0.00001f;
+
+static bool isAxisAligned(const Matrix4& m) {
+    return fabs(m.data[Matrix4::kSkewX]) <= kAxisAlignedEpsilon
+            && fabs(m.data[Matrix4::kSkewY]) <= kAxisAlignedEpsilon
+            && fabs(m.data[Matrix4::kPerspective0]) <= kAxisAlignedEpsilon
+            && fabs(m.data[Matrix4::kPerspective1]) <= kAxisAlignedEpsilon
+            && fabs(m.data[Matrix4::kScaleX]) > kAxisAlignedEpsilon
+            && fabs(m.data[Matrix4::kScaleY]) > kAxisAlignedEpsilon;
+}
+
+/**
+ * Intersects with a rectangle whose transform only differs from ours by a
+ * transform that keeps rectangles axis aligned, such as the offset and scale
+ * of a child view, by mapping it into our local space. Returns false if the
+ * transforms aren't related that way.
+ */
+bool TransformedRectangle::intersectWithMapped(const Rect& bounds,
+        const Matrix4& transform) {
+    Matrix4 inverse;
+    inverse.loadInverse(mTransform);
+    Matrix4 relative;
+    relative.loadMultiply(inverse, transform);
+    if (!isAxisAligned(relative)) {
+        return false;
+    }
+
+    Rect mapped(bounds);
+    relative.mapRect(mapped);
+    // A degenerate transform has no usable inverse
+    if (!std::isfinite(mapped.left) || !std::isfinite(mapped.top)
+            || !std::isfinite(mapped.right) || !std::isfinite(mapped.bottom)) {
+        return false;
+    }
+    intersect(mBounds, mapped);
+    return true;
+}
+
 bool TransformedRectangle::isEmpty() const {
     return mBounds.isEmpty();
 }
@@ -130,6 +171,15 @@ bool RectangleList::intersectWith(const Rect& bounds,
         }
     }
 
+    // Nested views mostly clip with transforms that only add an offset to
+    // their parent's, which map into the local space of an existing rectangle
+    // instead of filling up the list
+    for (int i = 0; i < mTransformedRectanglesCount; i++) {
+        if (mTransformedRectangles[i].intersectWithMapped(bounds, transform)) {
+            return true;
+        }
+    }
+
     // Add it to the list if there is room
     if (index < kMaxTransformedRectangles) {
         mTransformedRectangles[index] = newRectangle;
@@ -314,6 +364,7 @@ bool ClipArea::rectangleListModeClipRectWithTransform(const Rect& r,
         enterRegionMode();
         return regionModeClipRectWithTransform(r, transform, op);
     }
+    intersect(mClipRect, transformAndCalculateBounds(r, *transform));
     return true;
 }
 
@@ -34,6 +34,7 @@ public:
 
     bool canSimplyIntersectWith(const TransformedRectangle& other) const;
     bool intersectWith(const TransformedRectangle& other);
+    bool intersectWithMapped(const Rect& bounds, const Matrix4& transform);
 
     bool isEmpty() const;
 
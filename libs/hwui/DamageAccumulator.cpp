@@ -24,6 +24,67 @@
 namespace android {
 namespace uirenderer {
 
+void DamageRects::join(const SkRect& rect) {
+    if (rect.isEmpty()) return;
+
+    SkRect merged = rect;
+    // Absorbing a rect can make the result overlap others, so rescan
+    for (int i = 0; i < mCount; i++) {
+        if (SkRect::Intersects(mRects[i], merged)) {
+            merged.join(mRects[i]);
+            removeAt(i);
+            i = -1;
+        }
+    }
+    if (mCount < DAMAGE_MAX_RECTS) {
+        mRects[mCount++] = merged;
+        return;
+    }
+
+    int best = 0;
+    float bestGrowth = 0;
+    for (int i = 0; i < mCount; i++) {
+        SkRect joined = mRects[i];
+        joined.join(merged);
+        float growth = joined.width() * joined.height() - mRects[i].width() * mRects[i].height();
+        if (i == 0 || growth < bestGrowth) {
+            best = i;
+            bestGrowth = growth;
+        }
+    }
+    merged.join(mRects[best]);
+    removeAt(best);
+    join(merged);
+}
+
+void DamageRects::join(const DamageRects& other) {
+    for (int i = 0; i < other.mCount; i++) {
+        join(other.mRects[i]);
+    }
+}
+
+void DamageRects::intersect(const SkRect& clip) {
+    for (int i = 0; i < mCount; i++) {
+        if (!mRects[i].intersect(clip)) {
+            removeAt(i--);
+        }
+    }
+}
+
+void DamageRects::roundOut() {
+    for (int i = 0; i < mCount; i++) {
+        mRects[i].roundOut(&mRects[i]);
+    }
+}
+
+SkRect DamageRects::bounds() const {
+    SkRect bounds = SkRect::MakeEmpty();
+    for (int i = 0; i < mCount; i++) {
+        bounds.join(mRects[i]);
+    }
+    return bounds;
+}
+
 enum TransformType {
     TransformInvalid = 0,
     TransformRenderNode,
@@ -37,9 +98,9 @@ struct DirtyStack {
         const RenderNode* renderNode;
         const Matrix4* matrix4;
     };
-    // When this frame is pop'd, this rect is mapped through the above transform
+    // When this frame is pop'd, these rects are mapped through the above transform
     // and applied to the previous (aka parent) frame
-    SkRect pendingDirty;
+    DamageRects pendingDirty;
     DirtyStack* prev;
     DirtyStack* next;
 };
@@ -47,6 +108,7 @@ struct DirtyStack {
 DamageAccumulator::DamageAccumulator() {
     mHead = (DirtyStack*) mAllocator.alloc(sizeof(DirtyStack));
     memset(mHead, 0, sizeof(DirtyStack));
+    mHead->pendingDirty.setEmpty();
     // Create a root that we will not pop off
     mHead->prev = mHead;
     mHead->type = TransformNone;
@@ -118,26 +180,30 @@ void DamageAccumulator::popTransform() {
     }
 }
 
-static inline void mapRect(const Matrix4* matrix, const SkRect& in, SkRect* out) {
-    if (in.isEmpty()) return;
-    Rect temp(in);
-    matrix->mapRect(temp);
-    out->join(RECT_ARGS(temp));
+static inline void mapRect(const Matrix4* matrix, const DamageRects& in, DamageRects* out) {
+    for (int i = 0; i < in.count(); i++) {
+        Rect temp(in[i]);
+        matrix->mapRect(temp);
+        out->join(RECT_ARGS(temp));
+    }
 }
 
 void DamageAccumulator::applyMatrix4Transform(DirtyStack* frame) {
     mapRect(frame->matrix4, frame->pendingDirty, &mHead->pendingDirty);
 }
 
-static inline void mapRect(const RenderProperties& props, const SkRect& in, SkRect* out) {
-    if (in.isEmpty()) return;
+static inline void mapRect(const RenderProperties& props, const DamageRects& in,
+        DamageRects* out) {
     const SkMatrix* transform = props.getTransformMatrix();
-    SkRect temp(in);
-    if (transform && !transform->isIdentity()) {
-        transform->mapRect(&temp);
+    const bool hasTransform = transform && !transform->isIdentity();
+    for (int i = 0; i < in.count(); i++) {
+        SkRect temp(in[i]);
+        if (hasTransform) {
+            transform->mapRect(&temp);
+        }
+        temp.offset(props.getLeft(), props.getTop());
+        out->join(temp);
     }
-    temp.offset(props.getLeft(), props.getTop());
-    out->join(temp);
 }
 
 static DirtyStack* findParentRenderNode(DirtyStack* frame) {
@@ -164,13 +230,16 @@ static DirtyStack* findProjectionReceiver(DirtyStack* frame) {
 }
 
 static void applyTransforms(DirtyStack* frame, DirtyStack* end) {
-    SkRect* rect = &frame->pendingDirty;
+    DamageRects* rects = &frame->pendingDirty;
     while (frame != end) {
+        // The mapped rects are added to the unmapped ones
+        DamageRects mapped = *rects;
         if (frame->type == TransformRenderNode) {
-            mapRect(frame->renderNode->properties(), *rect, rect);
+            mapRect(frame->renderNode->properties(), *rects, &mapped);
         } else {
-            mapRect(frame->matrix4, *rect, rect);
+            mapRect(frame->matrix4, *rects, &mapped);
         }
+        *rects = mapped;
         frame = frame->prev;
     }
 }
@@ -187,9 +256,7 @@ void DamageAccumulator::applyRenderNodeTransform(DirtyStack* frame) {
 
     // Perform clipping
     if (props.getClipDamageToBounds() && !frame->pendingDirty.isEmpty()) {
-        if (!frame->pendingDirty.intersect(0, 0, props.getWidth(), props.getHeight())) {
-            frame->pendingDirty.setEmpty();
-        }
+        frame->pendingDirty.intersect(SkRect::MakeWH(props.getWidth(), props.getHeight()));
     }
 
     // apply all transforms
@@ -215,14 +282,20 @@ void DamageAccumulator::dirty(float left, float top, float right, float bottom)
 }
 
 void DamageAccumulator::peekAtDirty(SkRect* dest) const {
-    *dest = mHead->pendingDirty;
+    *dest = mHead->pendingDirty.bounds();
 }
 
 void DamageAccumulator::finish(SkRect* totalDirty) {
+    DamageRects rects;
+    finish(&rects);
+    *totalDirty = rects.bounds();
+}
+
+void DamageAccumulator::finish(DamageRects* totalDirty) {
     LOG_ALWAYS_FATAL_IF(mHead->prev != mHead, "Cannot finish, mismatched push/pop calls! %p vs. %p", mHead->prev, mHead);
-    // Root node never has a transform, so this is the fully mapped dirty rect
+    // Root node never has a transform, so these are the fully mapped dirty rects
     *totalDirty = mHead->pendingDirty;
-    totalDirty->roundOut(totalDirty);
+    totalDirty->roundOut();
     mHead->pendingDirty.setEmpty();
 }
 
@@ -31,6 +31,42 @@ struct DirtyStack;
 class RenderNode;
 class Matrix4;
 
+// Damage beyond this many separate rects is merged into the nearest one
+#define DAMAGE_MAX_RECTS 4
+
+/**
+ * A small set of non-overlapping damage rects. Overlapping rects are merged
+ * as they are added, and once full, a new rect is merged into whichever
+ * existing rect grows the least from it.
+ */
+class DamageRects {
+public:
+    DamageRects() : mCount(0) {}
+
+    void setEmpty() { mCount = 0; }
+    bool isEmpty() const { return mCount == 0; }
+    int count() const { return mCount; }
+    const SkRect& operator[](int index) const { return mRects[index]; }
+
+    void join(const SkRect& rect);
+    void join(float left, float top, float right, float bottom) {
+        join(SkRect::MakeLTRB(left, top, right, bottom));
+    }
+    void join(const DamageRects& other);
+
+    // Clips every rect, dropping the ones left empty
+    void intersect(const SkRect& clip);
+    void roundOut();
+
+    SkRect bounds() const;
+
+private:
+    void removeAt(int index) { mRects[index] = mRects[--mCount]; }
+
+    SkRect mRects[DAMAGE_MAX_RECTS];
+    int mCount;
+};
+
 class DamageAccumulator {
     PREVENT_COPY_AND_ASSIGN(DamageAccumulator);
 public:
@@ -55,6 +91,8 @@ public:
     void computeCurrentTransform(Matrix4* outMatrix) const;
 
     void finish(SkRect* totalDirty);
+    // Same as above, keeping the separate damage rects
+    void finish(DamageRects* totalDirty);
 
 private:
     void pushCommon();
@@ -28,7 +28,9 @@
 #include "DeferredDisplayList.h"
 #include "DisplayListOp.h"
 #include "OpenGLRenderer.h"
+#include "OpProfiler.h"
 #include "Properties.h"
+#include "thread/TaskManager.h"
 #include "utils/MathUtils.h"
 
 #if DEBUG_DEFER
@@ -43,6 +45,9 @@ namespace uirenderer {
 // Depth of the save stack at the beginning of batch playback at flush time
 #define FLUSH_SAVE_STACK_DEPTH 2
 
+// Number of pending ops accumulated by the defer thread before handing them to the batching worker
+#define ASYNC_BATCHING_CHUNK_SIZE 32
+
 #define DEBUG_COLOR_BARRIER          0x1f000000
 #define DEBUG_COLOR_MERGEDBATCH      0x5f7f7fff
 #define DEBUG_COLOR_MERGEDBATCH_SOLO 0x5f7fff7f
@@ -104,7 +109,10 @@ public:
 #if DEBUG_DISPLAY_LIST_OPS_AS_EVENTS
             renderer.eventMark(op->name());
 #endif
-            op->applyDraw(renderer, dirty);
+            {
+                AutoOpProfile profile(renderer.opProfiler(), op->name(), state->mProfiledNode);
+                op->applyDraw(renderer, dirty);
+            }
 
 #if DEBUG_MERGE_BEHAVIOR
             const Rect& bounds = state->mBounds;
@@ -265,8 +273,19 @@ public:
         renderer.eventMark("multiDraw");
         renderer.eventMark(op->name());
 #endif
+        OpProfiler* profiler = renderer.opProfiler();
+        nsecs_t start = CC_UNLIKELY(profiler) ? systemTime(CLOCK_MONOTONIC) : 0;
+
         op->multiDraw(renderer, dirty, mOps, mBounds);
 
+        if (CC_UNLIKELY(profiler)) {
+            // Merged ops can't be timed individually, split the cost evenly
+            nsecs_t duration = (systemTime(CLOCK_MONOTONIC) - start) / mOps.size();
+            for (unsigned int i = 0; i < mOps.size(); i++) {
+                profiler->addOp(mOps[i].op->name(), mOps[i].state->mProfiledNode, duration);
+            }
+        }
+
 #if DEBUG_MERGE_BEHAVIOR
         renderer.drawScreenSpaceColorRect(mBounds.left, mBounds.top, mBounds.right, mBounds.bottom,
                 DEBUG_COLOR_MERGEDBATCH);
@@ -456,7 +475,7 @@ void DeferredDisplayList::addRestoreToCount(OpenGLRenderer& renderer, StateOp* o
 
     if (recordingComplexClip() && newSaveCount <= mComplexClipStackStart) {
         mComplexClipStackStart = -1;
-        resetBatchingState();
+        addBatchingReset();
     }
 
     if (mSaveStack.isEmpty() || newSaveCount > mSaveStack.top()) {
@@ -487,6 +506,10 @@ void DeferredDisplayList::addDrawOp(OpenGLRenderer& renderer, DrawOp* op) {
         return; // quick rejected
     }
 
+    if (CC_UNLIKELY(renderer.opProfiler())) {
+        state->mProfiledNode = renderer.opProfiler()->currentNode();
+    }
+
     /* 3: ask op for defer info, given renderer state */
     DeferInfo deferInfo;
     op->onDefer(renderer, deferInfo, *state);
@@ -498,6 +521,18 @@ void DeferredDisplayList::addDrawOp(OpenGLRenderer& renderer, DrawOp* op) {
             && mSaveStack.isEmpty()
             && !state->mRoundRectClipState;
 
+    if (mAsyncBatching) {
+        PendingOp pendingOp = { op, state, deferInfo, nullptr, false,
+                renderer.getViewportWidth(), renderer.getViewportHeight() };
+        queuePendingOp(pendingOp);
+        return;
+    }
+
+    batchDrawOp(op, state, deferInfo, renderer.getViewportWidth(), renderer.getViewportHeight());
+}
+
+void DeferredDisplayList::batchDrawOp(DrawOp* op, const DeferredDisplayState* state,
+        DeferInfo& deferInfo, int viewportWidth, int viewportHeight) {
     if (CC_LIKELY(mAvoidOverdraw) && mBatches.size() &&
             state->mClipSideFlags != kClipSide_ConservativeFull &&
             deferInfo.opaqueOverBounds && state->mBounds.contains(mBounds)) {
@@ -578,8 +613,7 @@ void DeferredDisplayList::addDrawOp(OpenGLRenderer& renderer, DrawOp* op) {
 
     if (!targetBatch) {
         if (deferInfo.mergeable) {
-            targetBatch = new MergingDrawBatch(deferInfo,
-                    renderer.getViewportWidth(), renderer.getViewportHeight());
+            targetBatch = new MergingDrawBatch(deferInfo, viewportWidth, viewportHeight);
             mMergingBatches[deferInfo.batchId].put(deferInfo.mergeId, targetBatch);
         } else {
             targetBatch = new DrawBatch(deferInfo);
@@ -596,27 +630,154 @@ void DeferredDisplayList::addDrawOp(OpenGLRenderer& renderer, DrawOp* op) {
 }
 
 void DeferredDisplayList::storeStateOpBarrier(OpenGLRenderer& renderer, StateOp* op) {
-    DEFER_LOGD("%p adding state op barrier at pos %d", this, mBatches.size());
+    DEFER_LOGD("%p adding state op barrier", this);
 
     DeferredDisplayState* state = createState();
     renderer.storeDisplayState(*state, getStateOpDeferFlags());
-    mBatches.add(new StateOpBatch(op, state));
-    resetBatchingState();
+    addBarrier(new StateOpBatch(op, state));
 }
 
 void DeferredDisplayList::storeRestoreToCountBarrier(OpenGLRenderer& renderer, StateOp* op,
         int newSaveCount) {
-    DEFER_LOGD("%p adding restore to count %d barrier, pos %d",
-            this, newSaveCount, mBatches.size());
+    DEFER_LOGD("%p adding restore to count %d barrier", this, newSaveCount);
 
     // store displayState for the restore operation, as it may be associated with a saveLayer that
     // doesn't have kClip_SaveFlag set
     DeferredDisplayState* state = createState();
     renderer.storeDisplayState(*state, getStateOpDeferFlags());
-    mBatches.add(new RestoreToCountBatch(op, state, newSaveCount));
+    addBarrier(new RestoreToCountBatch(op, state, newSaveCount));
+}
+
+void DeferredDisplayList::addBarrier(Batch* barrier) {
+    if (mAsyncBatching) {
+        PendingOp pendingOp = { nullptr, nullptr, DeferInfo(), barrier, true, 0, 0 };
+        queuePendingOp(pendingOp);
+        return;
+    }
+    mBatches.add(barrier);
+    resetBatchingState();
+}
+
+void DeferredDisplayList::addBatchingReset() {
+    if (mAsyncBatching) {
+        PendingOp pendingOp = { nullptr, nullptr, DeferInfo(), nullptr, true, 0, 0 };
+        queuePendingOp(pendingOp);
+        return;
+    }
     resetBatchingState();
 }
 
+/////////////////////////////////////////////////////////////////////////////////
+// Async batching
+/////////////////////////////////////////////////////////////////////////////////
+
+void DeferredDisplayList::BatchingProcessor::onProcess(const sp<Task<bool> >& task) {
+    DeferredDisplayList* list = static_cast<BatchingTask*>(task.get())->list;
+
+    // TaskProcessor::add() processes the task inline when no worker can accept it. Waiting for
+    // more ops here would then block the defer thread forever, so leave the pending ops in the
+    // queue: waitForAsyncBatching() drains them on the defer thread instead
+    if (pthread_equal(pthread_self(), list->mDeferThread)) {
+        task->setResult(false);
+        return;
+    }
+
+    list->runBatchingLoop();
+    task->setResult(true);
+}
+
+void DeferredDisplayList::beginAsyncBatching(TaskManager& taskManager) {
+    LOG_ALWAYS_FATAL_IF(mAsyncBatching, "Async batching already started");
+    if (!taskManager.canRunTasks()) return;
+
+    mAsyncBatching = true;
+    mAsyncBatchingDone = false;
+    mDeferThread = pthread_self();
+
+    if (!mBatchingProcessor.get()) {
+        mBatchingProcessor = new BatchingProcessor(&taskManager);
+    }
+    mBatchingTask = new BatchingTask(this);
+    mBatchingProcessor->add(mBatchingTask);
+}
+
+void DeferredDisplayList::endAsyncBatching() {
+    if (!mAsyncBatching) return;
+
+    flushPendingOps();
+    Mutex::Autolock _l(mPendingLock);
+    mAsyncBatchingDone = true;
+    mPendingCondition.signal();
+}
+
+void DeferredDisplayList::queuePendingOp(const PendingOp& pendingOp) {
+    mLocalPendingOps.add(pendingOp);
+    if (mLocalPendingOps.size() >= ASYNC_BATCHING_CHUNK_SIZE) {
+        flushPendingOps();
+    }
+}
+
+void DeferredDisplayList::flushPendingOps() {
+    if (mLocalPendingOps.isEmpty()) return;
+
+    Mutex::Autolock _l(mPendingLock);
+    mPendingOps.appendVector(mLocalPendingOps);
+    mLocalPendingOps.clear();
+    mPendingCondition.signal();
+}
+
+void DeferredDisplayList::processPendingOp(PendingOp& pendingOp) {
+    if (pendingOp.op) {
+        batchDrawOp(pendingOp.op, pendingOp.state, pendingOp.deferInfo,
+                pendingOp.viewportWidth, pendingOp.viewportHeight);
+        return;
+    }
+    if (pendingOp.barrier) {
+        mBatches.add(pendingOp.barrier);
+    }
+    if (pendingOp.resetBatching) {
+        resetBatchingState();
+    }
+}
+
+void DeferredDisplayList::runBatchingLoop() {
+    ATRACE_NAME("batch deferred ops");
+    Vector<PendingOp> pendingOps;
+    bool done = false;
+    while (!done) {
+        {
+            Mutex::Autolock _l(mPendingLock);
+            while (mPendingOps.isEmpty() && !mAsyncBatchingDone) {
+                mPendingCondition.wait(mPendingLock);
+            }
+            pendingOps = mPendingOps;
+            mPendingOps.clear();
+            done = mAsyncBatchingDone;
+        }
+
+        for (size_t i = 0; i < pendingOps.size(); i++) {
+            processPendingOp(pendingOps.editItemAt(i));
+        }
+        pendingOps.clear();
+    }
+}
+
+void DeferredDisplayList::waitForAsyncBatching() {
+    if (!mAsyncBatching) return;
+
+    // in case the ops were never closed off, e.g. the layer's deferral was cancelled
+    endAsyncBatching();
+    mBatchingTask->getResult();
+    mBatchingTask.clear();
+    mAsyncBatching = false;
+
+    // anything left over wasn't picked up by a worker, batch it on this thread
+    for (size_t i = 0; i < mPendingOps.size(); i++) {
+        processPendingOp(mPendingOps.editItemAt(i));
+    }
+    mPendingOps.clear();
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 // Replay / flush
 /////////////////////////////////////////////////////////////////////////////////
@@ -636,6 +797,8 @@ void DeferredDisplayList::flush(OpenGLRenderer& renderer, Rect& dirty) {
     ATRACE_NAME("flush drawing commands");
     Caches::getInstance().fontRenderer->endPrecaching();
 
+    waitForAsyncBatching();
+
     if (isEmpty()) return; // nothing to flush
     renderer.restoreToCount(1);
 
@@ -17,14 +17,20 @@
 #ifndef ANDROID_HWUI_DEFERRED_DISPLAY_LIST_H
 #define ANDROID_HWUI_DEFERRED_DISPLAY_LIST_H
 
+#include <utils/Condition.h>
 #include <utils/Errors.h>
 #include <utils/LinearAllocator.h>
+#include <utils/Mutex.h>
 #include <utils/Vector.h>
 #include <utils/TinyHashMap.h>
 
+#include <pthread.h>
+
 #include "Matrix.h"
 #include "OpenGLRenderer.h"
 #include "Rect.h"
+#include "thread/Task.h"
+#include "thread/TaskProcessor.h"
 
 class SkBitmap;
 
@@ -64,6 +70,9 @@ public:
     float mAlpha;
     const RoundRectClipState* mRoundRectClipState;
     const ProjectionPathMask* mProjectionPathMask;
+
+    // OpProfiler node that issued the op, only set while profiling
+    int mProfiledNode;
 };
 
 class OpStatePair {
@@ -78,14 +87,31 @@ public:
     const DeferredDisplayState* state;
 };
 
+/**
+ * Struct containing information that instructs the defer
+ */
+struct DeferInfo {
+public:
+    DeferInfo();
+
+    int batchId;
+    mergeid_t mergeId;
+    bool mergeable;
+    bool opaqueOverBounds; // opaque over bounds in DeferredDisplayState - can skip ops below
+};
+
 class DeferredDisplayList {
     friend struct DeferStateStruct; // used to give access to allocator
 public:
     DeferredDisplayList(const Rect& bounds, bool avoidOverdraw = true) :
-            mBounds(bounds), mAvoidOverdraw(avoidOverdraw) {
+            mBounds(bounds), mAvoidOverdraw(avoidOverdraw),
+            mAsyncBatching(false), mAsyncBatchingDone(false) {
+        clear();
+    }
+    ~DeferredDisplayList() {
+        waitForAsyncBatching();
         clear();
     }
-    ~DeferredDisplayList() { clear(); }
 
     enum OpBatchId {
         kOpBatch_None = 0, // Don't batch
@@ -119,9 +145,55 @@ public:
      */
     void addDrawOp(OpenGLRenderer& renderer, DrawOp* op);
 
+    /**
+     * Moves the batching and merging of all subsequently added ops to a TaskManager worker.
+     *
+     * Ops are still walked, quick rejected and precached on the calling thread, as they depend
+     * on the renderer's state, but the search for a target batch happens on the worker. This lets
+     * the batching of this list overlap with GL work issued by the calling thread, such as the
+     * flush of previously deferred layers. endAsyncBatching() must be called once all ops have been
+     * added, before the list is flushed.
+     */
+    void beginAsyncBatching(TaskManager& taskManager);
+
+    /**
+     * Signals that no more ops will be added to this list. The worker finishes batching the
+     * pending ops in the background, flush() waits for it.
+     */
+    void endAsyncBatching();
+
 private:
     DeferredDisplayList(const DeferredDisplayList& other); // disallow copy
 
+    /**
+     * An op (or barrier) that has been fully deferred on the calling thread and is waiting to be
+     * inserted in the batch list by the batching worker.
+     */
+    struct PendingOp {
+        DrawOp* op;
+        const DeferredDisplayState* state;
+        DeferInfo deferInfo;
+        Batch* barrier;
+        bool resetBatching;
+        int viewportWidth;
+        int viewportHeight;
+    };
+
+    class BatchingTask : public Task<bool> {
+    public:
+        BatchingTask(DeferredDisplayList* list) : list(list) {}
+
+        DeferredDisplayList* list;
+    };
+
+    class BatchingProcessor : public TaskProcessor<bool> {
+    public:
+        BatchingProcessor(TaskManager* taskManager) : TaskProcessor<bool>(taskManager) {}
+        ~BatchingProcessor() {}
+
+        virtual void onProcess(const sp<Task<bool> >& task) override;
+    };
+
     DeferredDisplayState* createState() {
         return new (mAllocator) DeferredDisplayState();
     }
@@ -148,6 +220,21 @@ private:
 
     void discardDrawingBatches(const unsigned int maxIndex);
 
+    /**
+     * Finds or creates the batch the op should be drawn in. Called either directly from
+     * addDrawOp(), or from the batching worker if async batching is enabled.
+     */
+    void batchDrawOp(DrawOp* op, const DeferredDisplayState* state, DeferInfo& deferInfo,
+            int viewportWidth, int viewportHeight);
+    void addBarrier(Batch* barrier);
+    void addBatchingReset();
+
+    void queuePendingOp(const PendingOp& pendingOp);
+    void flushPendingOps();
+    void processPendingOp(PendingOp& pendingOp);
+    void runBatchingLoop();
+    void waitForAsyncBatching();
+
     // layer space bounds of rendering
     Rect mBounds;
     const bool mAvoidOverdraw;
@@ -179,26 +266,26 @@ private:
     TinyHashMap<mergeid_t, DrawBatch*> mMergingBatches[kOpBatch_Count];
 
     LinearAllocator mAllocator;
-};
 
-/**
- * Struct containing information that instructs the defer
- */
-struct DeferInfo {
-public:
-    DeferInfo() :
-            batchId(DeferredDisplayList::kOpBatch_None),
-            mergeId((mergeid_t) -1),
-            mergeable(false),
-            opaqueOverBounds(false) {
-    };
-
-    int batchId;
-    mergeid_t mergeId;
-    bool mergeable;
-    bool opaqueOverBounds; // opaque over bounds in DeferredDisplayState - can skip ops below
+    // Async batching state, the pending ops are handed to the worker in chunks
+    bool mAsyncBatching;
+    bool mAsyncBatchingDone;
+    pthread_t mDeferThread;
+    Vector<PendingOp> mLocalPendingOps;
+    Vector<PendingOp> mPendingOps;
+    Mutex mPendingLock;
+    Condition mPendingCondition;
+    sp<BatchingTask> mBatchingTask;
+    sp<BatchingProcessor> mBatchingProcessor;
 };
 
+inline DeferInfo::DeferInfo() :
+        batchId(DeferredDisplayList::kOpBatch_None),
+        mergeId((mergeid_t) -1),
+        mergeable(false),
+        opaqueOverBounds(false) {
+}
+
 }; // namespace uirenderer
 }; // namespace android
 
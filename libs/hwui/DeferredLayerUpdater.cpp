@@ -21,6 +21,9 @@
 #include "renderthread/EglManager.h"
 #include "renderthread/RenderTask.h"
 
+#include <utils/Timers.h>
+#include <utils/Trace.h>
+
 namespace android {
 namespace uirenderer {
 
@@ -64,9 +67,12 @@ bool DeferredLayerUpdater::apply() {
             mNeedsGLContextAttach = false;
             mSurfaceTexture->attachToContext(mLayer->getTextureId());
         }
+        mLastLatchDuration = 0;
         if (mUpdateTexImage) {
             mUpdateTexImage = false;
+            nsecs_t start = systemTime(CLOCK_MONOTONIC);
             doUpdateTexImage();
+            mLastLatchDuration = systemTime(CLOCK_MONOTONIC) - start;
         }
         if (mTransform) {
             mLayer->getTransform().load(*mTransform);
@@ -77,6 +83,9 @@ bool DeferredLayerUpdater::apply() {
 }
 
 void DeferredLayerUpdater::doUpdateTexImage() {
+    ATRACE_NAME("Latch TextureView frame");
+    // If no new buffer is queued the GLConsumer keeps, and rebinds, the
+    // current one, so the layer simply shows the previous frame again
     if (mSurfaceTexture->updateTexImage() == NO_ERROR) {
         float transform[16];
 
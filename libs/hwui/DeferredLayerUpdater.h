@@ -21,6 +21,7 @@
 #include <SkColorFilter.h>
 #include <SkMatrix.h>
 #include <utils/StrongPointer.h>
+#include <utils/Timers.h>
 
 #include "Layer.h"
 #include "Rect.h"
@@ -85,6 +86,11 @@ public:
 
     ANDROID_API void detachSurfaceTexture();
 
+    // Time the last apply() spent latching a new frame, 0 if none was requested
+    nsecs_t lastLatchDuration() const {
+        return mLastLatchDuration;
+    }
+
 private:
     // Generic properties
     int mWidth;
@@ -98,6 +104,7 @@ private:
     SkMatrix* mTransform;
     bool mNeedsGLContextAttach;
     bool mUpdateTexImage;
+    nsecs_t mLastLatchDuration = 0;
 
     Layer* mLayer;
     Caches& mCaches;
@@ -222,6 +222,8 @@ bool DisplayListCanvas::clipRegion(const SkRegion* region, SkRegion::Op op) {
 
 void DisplayListCanvas::drawRenderNode(RenderNode* renderNode) {
     LOG_ALWAYS_FATAL_IF(!renderNode, "missing rendernode");
+    // The display list refs the node in addChild(), so it may be drawn even
+    // if nothing else keeps it alive, such as the node of a Picture.
     DrawRenderNodeOp* op = new (alloc()) DrawRenderNodeOp(
             renderNode,
             *mState.currentTransform(),
@@ -140,6 +140,8 @@ public:
         LOG_ALWAYS_FATAL("DisplayListCanvas is not backed by a bitmap.");
     }
 
+    virtual bool isHardwareAccelerated() const override { return true; }
+
     virtual bool isOpaque() override { return false; }
     virtual int width() override { return mState.getWidth(); }
     virtual int height() override { return mState.getHeight(); }
@@ -21,7 +21,9 @@
 #include "AssetAtlas.h"
 #include "DeferredDisplayList.h"
 #include "DisplayListCanvas.h"
+#include "DisplayListSerializer.h"
 #include "GammaFontRenderer.h"
+#include "OpProfiler.h"
 #include "Patch.h"
 #include "RenderNode.h"
 #include "renderstate/RenderState.h"
@@ -83,6 +85,12 @@ public:
     // NOTE: it would be nice to declare constants and overriding the implementation in each op to
     // point at the constants, but that seems to require a .cpp file
     virtual const char* name() = 0;
+
+    /**
+     * Writes the op as the DisplayListCanvas call that recorded it, returns false if the op
+     * can't be serialized, see DisplayListWriter
+     */
+    virtual bool serialize(DisplayListWriter& writer) const { return false; }
 };
 
 class StateOp : public DisplayListOp {
@@ -126,6 +134,9 @@ public:
             return;
         }
 
+        OpProfiler* profiler = replayStruct.mRenderer.opProfiler();
+        AutoOpProfile profile(profiler, name(),
+                CC_UNLIKELY(profiler) ? profiler->currentNode() : OpProfiler::kNoNode);
         applyDraw(replayStruct.mRenderer, replayStruct.mDirty);
     }
 
@@ -289,6 +300,11 @@ public:
 
     virtual const char* name() override { return "Save"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.save(mFlags);
+        return true;
+    }
+
     int getFlags() const { return mFlags; }
 private:
     int mFlags;
@@ -316,6 +332,11 @@ public:
 
     virtual const char* name() override { return "RestoreToCount"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.restoreToCount(mCount);
+        return true;
+    }
+
 private:
     int mCount;
 };
@@ -363,6 +384,11 @@ public:
         return isSaveLayerAlpha() ? "SaveLayerAlpha" : "SaveLayer";
     }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.saveLayer(mArea, mPaint, mFlags);
+        return true;
+    }
+
     int getFlags() { return mFlags; }
 
     // Called to make SaveLayerOp clip to the provided mask when drawing back/restored
@@ -402,6 +428,11 @@ public:
 
     virtual const char* name() override { return "Translate"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.translate(mDx, mDy);
+        return true;
+    }
+
 private:
     float mDx;
     float mDy;
@@ -422,6 +453,11 @@ public:
 
     virtual const char* name() override { return "Rotate"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.rotate(mDegrees);
+        return true;
+    }
+
 private:
     float mDegrees;
 };
@@ -441,6 +477,11 @@ public:
 
     virtual const char* name() override { return "Scale"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.scale(mSx, mSy);
+        return true;
+    }
+
 private:
     float mSx;
     float mSy;
@@ -461,6 +502,11 @@ public:
 
     virtual const char* name() override { return "Skew"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.skew(mSx, mSy);
+        return true;
+    }
+
 private:
     float mSx;
     float mSy;
@@ -485,6 +531,11 @@ public:
 
     virtual const char* name() override { return "SetMatrix"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.setMatrix(mMatrix);
+        return true;
+    }
+
 private:
     const SkMatrix mMatrix;
 };
@@ -504,6 +555,11 @@ public:
 
     virtual const char* name() override { return "SetLocalMatrix"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.setLocalMatrix(mMatrix);
+        return true;
+    }
+
 private:
     const SkMatrix mMatrix;
 };
@@ -523,6 +579,11 @@ public:
 
     virtual const char* name() override { return "ConcatMatrix"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.concat(mMatrix);
+        return true;
+    }
+
 private:
     const SkMatrix mMatrix;
 };
@@ -565,6 +626,11 @@ public:
 
     virtual const char* name() override { return "ClipRect"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.clipRect(mArea, mOp);
+        return true;
+    }
+
 protected:
     virtual bool isRect() override { return true; }
 
@@ -589,6 +655,11 @@ public:
 
     virtual const char* name() override { return "ClipPath"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.clipPath(mPath, mOp);
+        return true;
+    }
+
 private:
     const SkPath* mPath;
 };
@@ -635,7 +706,8 @@ public:
             mEntryValid = true;
             mEntry = renderer.renderState().assetAtlas().getEntry(mBitmap);
         }
-        return mEntry;
+        // Dynamic atlas entries can come and go between frames, never cache them
+        return mEntry ? mEntry : renderer.renderState().assetAtlas().getDynamicEntry(mBitmap);
     }
 
 #define SET_TEXTURE(ptr, posRect, offsetRect, texCoordsRect, xDim, yDim) \
@@ -684,7 +756,7 @@ public:
             }
         }
 
-        renderer.drawBitmaps(mBitmap, mEntry, ops.size(), &vertices[0],
+        renderer.drawBitmaps(mBitmap, getAtlasEntry(renderer), ops.size(), &vertices[0],
                 pureTranslate, bounds, mPaint);
     }
 
@@ -696,11 +768,16 @@ public:
 
     virtual const char* name() override { return "DrawBitmap"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawBitmap(mBitmap, mPaint);
+        return true;
+    }
+
     virtual void onDefer(OpenGLRenderer& renderer, DeferInfo& deferInfo,
             const DeferredDisplayState& state) override {
         deferInfo.batchId = DeferredDisplayList::kOpBatch_Bitmap;
-        deferInfo.mergeId = getAtlasEntry(renderer) ?
-                (mergeid_t) mEntry->getMergeId() : (mergeid_t) mBitmap;
+        AssetAtlas::Entry* entry = getAtlasEntry(renderer);
+        deferInfo.mergeId = entry ? (mergeid_t) entry->getMergeId() : (mergeid_t) mBitmap;
 
         // Don't merge non-simply transformed or neg scale ops, SET_TEXTURE doesn't handle rotation
         // Don't merge A8 bitmaps - the paint's color isn't compared by mergeId, or in
@@ -713,8 +790,9 @@ public:
     }
 
     void uvMap(OpenGLRenderer& renderer, Rect& texCoords) {
-        if (getAtlasEntry(renderer)) {
-            mEntry->uvMapper.map(texCoords);
+        AssetAtlas::Entry* entry = getAtlasEntry(renderer);
+        if (entry) {
+            entry->uvMapper.map(texCoords);
         }
     }
 
@@ -744,6 +822,11 @@ public:
 
     virtual const char* name() override { return "DrawBitmapRect"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawBitmapRect(mBitmap, mSrc, mLocalBounds, mPaint);
+        return true;
+    }
+
     virtual void onDefer(OpenGLRenderer& renderer, DeferInfo& deferInfo,
             const DeferredDisplayState& state) override {
         deferInfo.batchId = DeferredDisplayList::kOpBatch_Bitmap;
@@ -942,6 +1025,11 @@ public:
 
     virtual const char* name() override { return "DrawColor"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawColor(mColor, mMode);
+        return true;
+    }
+
 private:
     int mColor;
     SkXfermode::Mode mMode;
@@ -988,14 +1076,62 @@ public:
         OP_LOG("Draw Rect " RECT_STRING, RECT_ARGS(mLocalBounds));
     }
 
+    /**
+     * This multi-draw operation draws all the rects of the batch as instances
+     * of a single unit quad, with their own bounds and color. This method is
+     * also responsible for dirtying the current layer, if any.
+     */
+    virtual void multiDraw(OpenGLRenderer& renderer, Rect& dirty,
+            const Vector<OpStatePair>& ops, const Rect& bounds) override {
+        const DeferredDisplayState& firstState = *(ops[0].state);
+        renderer.restoreDisplayState(firstState, true); // restore all but the clip
+
+        RectInstance instances[ops.size()];
+        const bool hasLayer = renderer.hasLayer();
+        bool translucent = false;
+
+        for (unsigned int i = 0; i < ops.size(); i++) {
+            const DeferredDisplayState& state = *(ops[i].state);
+            // When we reach multiDraw(), the matrix is simple, so the mapped
+            // and clipped bounds are exactly what drawRect() would fill
+            const Rect& opBounds = state.mBounds;
+            const SkPaint* paint = ((DrawRectOp*) ops[i].op)->mPaint;
+            RectInstance::set(&instances[i], opBounds.left, opBounds.top,
+                    opBounds.right, opBounds.bottom, paint->getColor(), state.mAlpha);
+            translucent |= instances[i].a < 1.0f;
+
+            if (hasLayer) {
+                renderer.dirtyLayer(opBounds.left, opBounds.top, opBounds.right, opBounds.bottom);
+            }
+        }
+
+        renderer.drawRectInstances(&instances[0], ops.size(), translucent, bounds);
+    }
+
     virtual void onDefer(OpenGLRenderer& renderer, DeferInfo& deferInfo,
             const DeferredDisplayState& state) override {
         DrawStrokableOp::onDefer(renderer, deferInfo, state);
         deferInfo.opaqueOverBounds = isOpaqueOverBounds(state) &&
                 mPaint->getStyle() == SkPaint::kFill_Style;
+
+        // All the merged rects are drawn as instances, their color can differ
+        deferInfo.mergeId = (mergeid_t) kRectInstancesMergeId;
+        deferInfo.mergeable = Caches::getInstance().extensions().hasInstancedArrays() &&
+                state.mMatrix.isSimple() &&
+                mPaint->getStyle() == SkPaint::kFill_Style &&
+                !mPaint->getShader() && !mPaint->getColorFilter() &&
+                OpenGLRenderer::getXfermodeDirect(mPaint) == SkXfermode::kSrcOver_Mode;
     }
 
     virtual const char* name() override { return "DrawRect"; }
+
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawRect(mLocalBounds, mPaint);
+        return true;
+    }
+
+private:
+    static const uintptr_t kRectInstancesMergeId = 1;
 };
 
 class DrawRectsOp : public DrawBoundedOp {
@@ -1014,6 +1150,11 @@ public:
 
     virtual const char* name() override { return "DrawRects"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawRects(mRects, mCount, mPaint);
+        return true;
+    }
+
     virtual void onDefer(OpenGLRenderer& renderer, DeferInfo& deferInfo,
             const DeferredDisplayState& state) override {
         deferInfo.batchId = DeferredDisplayList::kOpBatch_Vertices;
@@ -1050,6 +1191,11 @@ public:
 
     virtual const char* name() override { return "DrawRoundRect"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawRoundRect(mLocalBounds, mRx, mRy, mPaint);
+        return true;
+    }
+
 private:
     float mRx;
     float mRy;
@@ -1099,6 +1245,11 @@ public:
 
     virtual const char* name() override { return "DrawCircle"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawCircle(mX, mY, mRadius, mPaint);
+        return true;
+    }
+
 private:
     float mX;
     float mY;
@@ -1141,6 +1292,11 @@ public:
     }
 
     virtual const char* name() override { return "DrawOval"; }
+
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawOval(mLocalBounds, mPaint);
+        return true;
+    }
 };
 
 class DrawArcOp : public DrawStrokableOp {
@@ -1163,6 +1319,11 @@ public:
 
     virtual const char* name() override { return "DrawArc"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawArc(mLocalBounds, mStartAngle, mSweepAngle, mUseCenter, mPaint);
+        return true;
+    }
+
 private:
     float mStartAngle;
     float mSweepAngle;
@@ -1187,6 +1348,11 @@ public:
 
     virtual void onDefer(OpenGLRenderer& renderer, DeferInfo& deferInfo,
             const DeferredDisplayState& state) override {
+        if (PathCache::canDrawWithStencil(mPath, mPaint)) {
+            // may still fall back to a texture at draw time, but rarely enough to skip precaching
+            deferInfo.batchId = DeferredDisplayList::kOpBatch_Vertices;
+            return;
+        }
         renderer.getCaches().pathCache.precache(mPath, mPaint);
 
         deferInfo.batchId = DeferredDisplayList::kOpBatch_AlphaMaskTexture;
@@ -1198,6 +1364,11 @@ public:
 
     virtual const char* name() override { return "DrawPath"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawPath(mPath, mPaint);
+        return true;
+    }
+
 private:
     const SkPath* mPath;
 };
@@ -1220,6 +1391,11 @@ public:
 
     virtual const char* name() override { return "DrawLines"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawLines(mPoints, mCount, mPaint);
+        return true;
+    }
+
     virtual void onDefer(OpenGLRenderer& renderer, DeferInfo& deferInfo,
             const DeferredDisplayState& state) override {
         deferInfo.batchId = mPaint->isAntiAlias() ?
@@ -1246,6 +1422,11 @@ public:
     }
 
     virtual const char* name() override { return "DrawPoints"; }
+
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawPoints(mPoints, mCount, mPaint);
+        return true;
+    }
 };
 
 class DrawSomeTextOp : public DrawOp {
@@ -1293,6 +1474,11 @@ public:
 
     virtual const char* name() override { return "DrawTextOnPath"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawTextOnPath(mText, mCount, mPath, mHOffset, mVOffset, mPaint);
+        return true;
+    }
+
 private:
     const SkPath* mPath;
     float mHOffset;
@@ -1313,6 +1499,11 @@ public:
 
     virtual const char* name() override { return "DrawPosText"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawPosText(mText, mCount, mPositions, mPaint);
+        return true;
+    }
+
 private:
     const float* mPositions;
 };
@@ -1329,11 +1520,17 @@ public:
     virtual void onDefer(OpenGLRenderer& renderer, DeferInfo& deferInfo,
             const DeferredDisplayState& state) override {
         FontRenderer& fontRenderer = renderer.getCaches().fontRenderer->getFontRenderer(mPaint);
-        SkMatrix transform;
-        renderer.findBestFontTransform(state.mMatrix, &transform);
-        if (mPrecacheTransform != transform) {
-            fontRenderer.precache(mPaint, mText, mCount, transform);
-            mPrecacheTransform = transform;
+        if (CC_UNLIKELY(FontRenderer::canUseDistanceField(mPaint, state.mMatrix))) {
+            // the same glyphs serve every scale, so the transform doesn't matter
+            fontRenderer.precacheDistanceField(mPaint, mText, mCount);
+            mPrecacheTransform = SkMatrix::InvalidMatrix();
+        } else {
+            SkMatrix transform;
+            renderer.findBestFontTransform(state.mMatrix, &transform);
+            if (mPrecacheTransform != transform) {
+                fontRenderer.precache(mPaint, mText, mCount, transform);
+                mPrecacheTransform = transform;
+            }
         }
         deferInfo.batchId = mPaint->getColor() == SK_ColorBLACK ?
                 DeferredDisplayList::kOpBatch_Text :
@@ -1379,6 +1576,12 @@ public:
 
     virtual const char* name() override { return "DrawText"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        writer.drawText(mText, mCount, mPositions, mX, mY, mLocalBounds, mTotalAdvance,
+                mPaint);
+        return true;
+    }
+
 private:
     const char* mText;
     int mBytesCount;
@@ -1453,6 +1656,10 @@ public:
 
     virtual const char* name() override { return "DrawRenderNode"; }
 
+    virtual bool serialize(DisplayListWriter& writer) const override {
+        return writer.drawRenderNode(mRenderNode);
+    }
+
     RenderNode* renderNode() { return mRenderNode; }
 
 private:
@@ -1548,6 +1755,15 @@ public:
         renderer.drawLayer(mLayer, mX, mY);
     }
 
+    virtual void onDefer(OpenGLRenderer& renderer, DeferInfo& deferInfo,
+            const DeferredDisplayState& state) override {
+        // Updating the layer from drawLayer() would switch to its FBO and
+        // back in the middle of the frame
+        if (mLayer->deferredUpdateScheduled) {
+            renderer.deferLayerUpdate(mLayer);
+        }
+    }
+
     virtual void output(int level, uint32_t logFlags) const override {
         OP_LOG("Draw Layer %p at %f %f", mLayer, mX, mY);
     }
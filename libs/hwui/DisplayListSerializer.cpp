@@ -0,0 +1,1090 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "DisplayListSerializer.h"
+
+#include "DisplayListCanvas.h"
+#include "DisplayListOp.h"
+#include "RenderNode.h"
+
+#include <SkBitmap.h>
+#include <SkMatrix.h>
+#include <SkPaint.h>
+#include <SkPath.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace android {
+namespace uirenderer {
+
+// "HWDL", bumped with any change to the records below
+static const int32_t kMagic = 0x4C445748;
+static const int32_t kVersion = 1;
+
+// Every record starts with one of these, followed by 4 byte aligned values
+enum RecordType {
+    kRecord_End = 0,
+    kRecord_Paint,
+    kRecord_Path,
+    kRecord_Bitmap,
+    kRecord_BeginNode,
+    kRecord_EndNode,
+
+    kRecord_ReorderBarrier,
+    kRecord_Save,
+    kRecord_RestoreToCount,
+    kRecord_SaveLayer,
+    kRecord_Translate,
+    kRecord_Rotate,
+    kRecord_Scale,
+    kRecord_Skew,
+    kRecord_SetMatrix,
+    kRecord_SetLocalMatrix,
+    kRecord_Concat,
+    kRecord_ClipRect,
+    kRecord_ClipPath,
+    kRecord_DrawColor,
+    kRecord_DrawRect,
+    kRecord_DrawRects,
+    kRecord_DrawRoundRect,
+    kRecord_DrawCircle,
+    kRecord_DrawOval,
+    kRecord_DrawArc,
+    kRecord_DrawPath,
+    kRecord_DrawLines,
+    kRecord_DrawPoints,
+    kRecord_DrawText,
+    kRecord_DrawPosText,
+    kRecord_DrawTextOnPath,
+    kRecord_DrawBitmap,
+    kRecord_DrawBitmapRect,
+    kRecord_DrawRenderNode,
+};
+
+enum OutlineType {
+    kOutline_None = 0,
+    kOutline_Empty,
+    kOutline_ConvexPath,
+    kOutline_RoundRect,
+};
+
+static size_t alignSize(size_t size) {
+    return (size + 3) & ~3;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DisplayListWriter
+///////////////////////////////////////////////////////////////////////////////
+
+void DisplayListWriter::writeTree(RenderNode* root) {
+    mData.clear();
+    mNodes.clear();
+    mPaints.clear();
+    mPaths.clear();
+    mBitmaps.clear();
+    mSkippedOpCount = 0;
+    mLossyPaintCount = 0;
+
+    writeInt(kMagic);
+    writeInt(kVersion);
+    int rootId = writeNode(root);
+    writeInt(kRecord_End);
+    writeInt(rootId);
+}
+
+bool DisplayListWriter::writeToFile(const char* path) const {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool success = fwrite(mData.data(), 1, mData.size(), file) == mData.size();
+    return (fclose(file) == 0) && success;
+}
+
+int DisplayListWriter::writeNode(RenderNode* node) {
+    auto found = mNodes.find(node);
+    if (found != mNodes.end()) return found->second;
+
+    // Children are written first, so that the ops drawing them can refer to them
+    DisplayListData* data = node->mDisplayListData;
+    if (data) {
+        const Vector<DrawRenderNodeOp*>& children = data->children();
+        for (size_t i = 0; i < children.size(); i++) {
+            writeNode(children[i]->renderNode());
+        }
+    }
+
+    int id = mNodes.size();
+    mNodes[node] = id;
+
+    writeBeginNode(node);
+    writeInt(data ? 1 : 0);
+    if (data) {
+        const Vector<DisplayListData::Chunk>& chunks = data->getChunks();
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const DisplayListData::Chunk& chunk = chunks[i];
+            insertReorderBarrier(chunk.reorderChildren);
+            for (size_t op = chunk.beginOpIndex; op < chunk.endOpIndex; op++) {
+                if (!data->displayListOps[op]->serialize(*this)) {
+                    mSkippedOpCount++;
+                }
+            }
+        }
+    }
+    writeInt(kRecord_EndNode);
+    return id;
+}
+
+void DisplayListWriter::writeBeginNode(const RenderNode* node) {
+    const RenderProperties& props = node->properties();
+    const Outline& outline = props.getOutline();
+
+    // Resources must be defined before the record using them
+    Rect outlineBounds;
+    float outlineRadius = 0;
+    int outlineType = kOutline_None;
+    int outlinePath = -1;
+    if (outline.getAsRoundRect(&outlineBounds, &outlineRadius)) {
+        outlineType = kOutline_RoundRect;
+    } else if (outline.getPath()) {
+        outlineType = kOutline_ConvexPath;
+        outlinePath = refPath(outline.getPath());
+    } else if (outline.isEmpty()) {
+        outlineType = kOutline_Empty;
+    }
+
+    writeInt(kRecord_BeginNode);
+    const char* name = node->getName();
+    writeArray(name, strlen(name) + 1);
+
+    writeInt(props.getLeft());
+    writeInt(props.getTop());
+    writeInt(props.getRight());
+    writeInt(props.getBottom());
+    writeFloat(props.getAlpha());
+    writeInt(props.getHasOverlappingRendering());
+    writeFloat(props.getElevation());
+    writeFloat(props.getTranslationX());
+    writeFloat(props.getTranslationY());
+    writeFloat(props.getTranslationZ());
+    writeFloat(props.getRotation());
+    writeFloat(props.getRotationX());
+    writeFloat(props.getRotationY());
+    writeFloat(props.getScaleX());
+    writeFloat(props.getScaleY());
+    writeInt(props.isPivotExplicitlySet());
+    writeFloat(props.getPivotX());
+    writeFloat(props.getPivotY());
+    writeFloat(props.getCameraDistance());
+
+    Rect clipBounds;
+    props.getClippingRectForFlags(CLIP_TO_CLIP_BOUNDS, &clipBounds);
+    writeInt(props.getClippingFlags());
+    writeRect(clipBounds);
+    writeInt(props.getProjectBackwards());
+    writeInt(props.isProjectionReceiver());
+
+    const SkMatrix* staticMatrix = props.getStaticMatrix();
+    writeInt(staticMatrix != nullptr);
+    if (staticMatrix) writeMatrix(*staticMatrix);
+    const SkMatrix* animationMatrix = props.getAnimationMatrix();
+    writeInt(animationMatrix != nullptr);
+    if (animationMatrix) writeMatrix(*animationMatrix);
+
+    // Layers promoted for overlapping alpha are promoted again when replayed
+    const LayerProperties& layerProps = props.layerProperties();
+    writeInt(static_cast<int>(props.promotedToLayer()
+            ? LayerType::None : props.effectiveLayerType()));
+    writeInt(layerProps.opaque());
+    writeInt(layerProps.alpha());
+    writeInt(layerProps.xferMode());
+
+    writeInt(outlineType);
+    writeRect(outlineBounds);
+    writeFloat(outlineRadius);
+    writeInt(outlinePath);
+    writeFloat(outline.getAlpha());
+    writeInt(outline.getShouldClip());
+}
+
+int DisplayListWriter::refPaint(const SkPaint* paint) {
+    if (!paint) return -1;
+
+    auto found = mPaints.find(paint);
+    if (found != mPaints.end()) return found->second;
+
+    if (paint->getShader() || paint->getColorFilter() || paint->getPathEffect()
+            || paint->getMaskFilter() || paint->getLooper() || paint->getImageFilter()
+            || paint->getRasterizer() || paint->getTypeface()) {
+        mLossyPaintCount++;
+    }
+
+    int index = mPaints.size();
+    mPaints[paint] = index;
+
+    writeInt(kRecord_Paint);
+    writeInt(paint->getFlags());
+    writeInt(paint->getColor());
+    writeInt(paint->getStyle());
+    writeFloat(paint->getStrokeWidth());
+    writeFloat(paint->getStrokeMiter());
+    writeInt(paint->getStrokeCap());
+    writeInt(paint->getStrokeJoin());
+    writeFloat(paint->getTextSize());
+    writeFloat(paint->getTextScaleX());
+    writeFloat(paint->getTextSkewX());
+    writeInt(paint->getTextAlign());
+    writeInt(paint->getTextEncoding());
+    writeInt(paint->getHinting());
+    writeInt(OpenGLRenderer::getXfermodeDirect(paint));
+    return index;
+}
+
+int DisplayListWriter::refPath(const SkPath* path) {
+    auto found = mPaths.find(path);
+    if (found != mPaths.end()) return found->second;
+
+    int index = mPaths.size();
+    mPaths[path] = index;
+
+    writeInt(kRecord_Path);
+    size_t size = path->writeToMemory(nullptr);
+    writeInt(size);
+    size_t offset = mData.size();
+    mData.resize(offset + alignSize(size), 0);
+    path->writeToMemory(&mData[offset]);
+    return index;
+}
+
+int DisplayListWriter::refBitmap(const SkBitmap* bitmap) {
+    // The display list holds copies of the application's bitmaps
+    uint32_t generationId = bitmap->getGenerationID();
+    auto found = mBitmaps.find(generationId);
+    if (found != mBitmaps.end()) return found->second;
+
+    int index = mBitmaps.size();
+    mBitmaps[generationId] = index;
+
+    writeInt(kRecord_Bitmap);
+    writeInt(bitmap->width());
+    writeInt(bitmap->height());
+    writeInt(bitmap->colorType());
+    writeInt(bitmap->alphaType());
+    return index;
+}
+
+void DisplayListWriter::insertReorderBarrier(bool enableReorder) {
+    writeInt(kRecord_ReorderBarrier);
+    writeInt(enableReorder);
+}
+
+void DisplayListWriter::save(int flags) {
+    writeInt(kRecord_Save);
+    writeInt(flags);
+}
+
+void DisplayListWriter::restoreToCount(int saveCount) {
+    writeInt(kRecord_RestoreToCount);
+    writeInt(saveCount);
+}
+
+void DisplayListWriter::saveLayer(const Rect& area, const SkPaint* paint, int flags) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_SaveLayer);
+    writeRect(area);
+    writeInt(paintIndex);
+    writeInt(flags);
+}
+
+void DisplayListWriter::translate(float dx, float dy) {
+    writeInt(kRecord_Translate);
+    writeFloat(dx);
+    writeFloat(dy);
+}
+
+void DisplayListWriter::rotate(float degrees) {
+    writeInt(kRecord_Rotate);
+    writeFloat(degrees);
+}
+
+void DisplayListWriter::scale(float sx, float sy) {
+    writeInt(kRecord_Scale);
+    writeFloat(sx);
+    writeFloat(sy);
+}
+
+void DisplayListWriter::skew(float sx, float sy) {
+    writeInt(kRecord_Skew);
+    writeFloat(sx);
+    writeFloat(sy);
+}
+
+void DisplayListWriter::setMatrix(const SkMatrix& matrix) {
+    writeInt(kRecord_SetMatrix);
+    writeMatrix(matrix);
+}
+
+void DisplayListWriter::setLocalMatrix(const SkMatrix& matrix) {
+    writeInt(kRecord_SetLocalMatrix);
+    writeMatrix(matrix);
+}
+
+void DisplayListWriter::concat(const SkMatrix& matrix) {
+    writeInt(kRecord_Concat);
+    writeMatrix(matrix);
+}
+
+void DisplayListWriter::clipRect(const Rect& area, SkRegion::Op op) {
+    writeInt(kRecord_ClipRect);
+    writeRect(area);
+    writeInt(op);
+}
+
+void DisplayListWriter::clipPath(const SkPath* path, SkRegion::Op op) {
+    int pathIndex = refPath(path);
+    writeInt(kRecord_ClipPath);
+    writeInt(pathIndex);
+    writeInt(op);
+}
+
+void DisplayListWriter::drawColor(int color, SkXfermode::Mode mode) {
+    writeInt(kRecord_DrawColor);
+    writeInt(color);
+    writeInt(mode);
+}
+
+void DisplayListWriter::drawRect(const Rect& rect, const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawRect);
+    writeRect(rect);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawRects(const float* rects, int count, const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawRects);
+    writeArray(rects, count * sizeof(float));
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawRoundRect(const Rect& rect, float rx, float ry,
+        const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawRoundRect);
+    writeRect(rect);
+    writeFloat(rx);
+    writeFloat(ry);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawCircle(float x, float y, float radius, const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawCircle);
+    writeFloat(x);
+    writeFloat(y);
+    writeFloat(radius);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawOval(const Rect& rect, const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawOval);
+    writeRect(rect);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawArc(const Rect& rect, float startAngle, float sweepAngle,
+        bool useCenter, const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawArc);
+    writeRect(rect);
+    writeFloat(startAngle);
+    writeFloat(sweepAngle);
+    writeInt(useCenter);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawPath(const SkPath* path, const SkPaint* paint) {
+    int pathIndex = refPath(path);
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawPath);
+    writeInt(pathIndex);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawLines(const float* points, int count, const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawLines);
+    writeArray(points, count * sizeof(float));
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawPoints(const float* points, int count, const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawPoints);
+    writeArray(points, count * sizeof(float));
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawText(const char* glyphs, int count, const float* positions,
+        float x, float y, const Rect& bounds, float totalAdvance, const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawText);
+    writeArray(glyphs, count * sizeof(uint16_t));
+    writeArray(positions, count * 2 * sizeof(float));
+    writeFloat(x);
+    writeFloat(y);
+    writeRect(bounds);
+    writeFloat(totalAdvance);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawPosText(const char* glyphs, int count, const float* positions,
+        const SkPaint* paint) {
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawPosText);
+    writeArray(glyphs, count * sizeof(uint16_t));
+    writeArray(positions, count * 2 * sizeof(float));
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawTextOnPath(const char* glyphs, int count, const SkPath* path,
+        float hOffset, float vOffset, const SkPaint* paint) {
+    int pathIndex = refPath(path);
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawTextOnPath);
+    writeArray(glyphs, count * sizeof(uint16_t));
+    writeInt(pathIndex);
+    writeFloat(hOffset);
+    writeFloat(vOffset);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawBitmap(const SkBitmap* bitmap, const SkPaint* paint) {
+    int bitmapIndex = refBitmap(bitmap);
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawBitmap);
+    writeInt(bitmapIndex);
+    writeInt(paintIndex);
+}
+
+void DisplayListWriter::drawBitmapRect(const SkBitmap* bitmap, const Rect& src,
+        const Rect& dst, const SkPaint* paint) {
+    int bitmapIndex = refBitmap(bitmap);
+    int paintIndex = refPaint(paint);
+    writeInt(kRecord_DrawBitmapRect);
+    writeInt(bitmapIndex);
+    writeRect(src);
+    writeRect(dst);
+    writeInt(paintIndex);
+}
+
+bool DisplayListWriter::drawRenderNode(RenderNode* renderNode) {
+    auto found = mNodes.find(renderNode);
+    if (found == mNodes.end()) return false;
+
+    writeInt(kRecord_DrawRenderNode);
+    writeInt(found->second);
+    return true;
+}
+
+void DisplayListWriter::writeInt(int32_t value) {
+    size_t offset = mData.size();
+    mData.resize(offset + sizeof(value));
+    memcpy(&mData[offset], &value, sizeof(value));
+}
+
+void DisplayListWriter::writeFloat(float value) {
+    size_t offset = mData.size();
+    mData.resize(offset + sizeof(value));
+    memcpy(&mData[offset], &value, sizeof(value));
+}
+
+void DisplayListWriter::writeRect(const Rect& rect) {
+    writeFloat(rect.left);
+    writeFloat(rect.top);
+    writeFloat(rect.right);
+    writeFloat(rect.bottom);
+}
+
+void DisplayListWriter::writeMatrix(const SkMatrix& matrix) {
+    for (int i = 0; i < 9; i++) {
+        writeFloat(matrix[i]);
+    }
+}
+
+void DisplayListWriter::writeArray(const void* data, size_t size) {
+    writeInt(size);
+    size_t offset = mData.size();
+    mData.resize(offset + alignSize(size), 0);
+    if (size) memcpy(&mData[offset], data, size);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DisplayListReader
+///////////////////////////////////////////////////////////////////////////////
+
+DisplayListReader::DisplayListReader(const void* data, size_t size)
+        : mData(reinterpret_cast<const uint8_t*>(data))
+        , mSize(size) {
+}
+
+sp<RenderNode> DisplayListReader::readTree() {
+    int32_t magic;
+    int32_t version;
+    if (!readInt(&magic) || magic != kMagic || !readInt(&version) || version != kVersion) {
+        ALOGW("Not a display list capture, or an unsupported version");
+        return nullptr;
+    }
+
+    int32_t tag;
+    while (readInt(&tag)) {
+        bool success;
+        switch (tag) {
+        case kRecord_Paint:
+            success = readPaint();
+            break;
+        case kRecord_Path:
+            success = readPath();
+            break;
+        case kRecord_Bitmap:
+            success = readBitmap();
+            break;
+        case kRecord_BeginNode:
+            success = readNode();
+            break;
+        case kRecord_End: {
+            int32_t rootId;
+            if (readInt(&rootId) && rootId >= 0 && rootId < static_cast<int>(mNodes.size())) {
+                return mNodes[rootId];
+            }
+            success = false;
+            break;
+        }
+        default:
+            success = false;
+            break;
+        }
+        if (!success) break;
+    }
+
+    ALOGW("Malformed display list capture at offset %zu", mOffset);
+    return nullptr;
+}
+
+bool DisplayListReader::readNode() {
+    sp<RenderNode> node = new RenderNode();
+    int width;
+    int height;
+    int32_t hasDisplayList;
+    if (!readProperties(node.get(), &width, &height) || !readInt(&hasDisplayList)) {
+        return false;
+    }
+
+    if (hasDisplayList) {
+        DisplayListCanvas canvas;
+        canvas.setViewport(width, height);
+        canvas.prepare();
+
+        bool success = true;
+        int32_t tag;
+        while (success && readInt(&tag) && tag != kRecord_EndNode) {
+            switch (tag) {
+            case kRecord_Paint:
+                success = readPaint();
+                break;
+            case kRecord_Path:
+                success = readPath();
+                break;
+            case kRecord_Bitmap:
+                success = readBitmap();
+                break;
+            default:
+                success = readOp(tag, canvas);
+                break;
+            }
+        }
+
+        canvas.finish();
+        DisplayListData* data = canvas.finishRecording();
+        if (!success || tag != kRecord_EndNode) {
+            delete data;
+            return false;
+        }
+        node->setStagingDisplayList(data);
+    } else {
+        int32_t tag;
+        if (!readInt(&tag) || tag != kRecord_EndNode) return false;
+    }
+
+    node->setPropertyFieldsDirty(RenderNode::GENERIC);
+    mNodes.push_back(node);
+    return true;
+}
+
+bool DisplayListReader::readProperties(RenderNode* node, int* outWidth, int* outHeight) {
+    size_t nameSize;
+    const char* name = reinterpret_cast<const char*>(readArray(&nameSize));
+    if (!name || !nameSize || name[nameSize - 1] != '\0') return false;
+    node->setName(name);
+
+    int32_t left, top, right, bottom;
+    int32_t hasOverlappingRendering, pivotExplicitlySet;
+    float alpha, elevation, translationX, translationY, translationZ;
+    float rotation, rotationX, rotationY, scaleX, scaleY;
+    float pivotX, pivotY, cameraDistance;
+    if (!readInt(&left) || !readInt(&top) || !readInt(&right) || !readInt(&bottom)
+            || !readFloat(&alpha) || !readInt(&hasOverlappingRendering)
+            || !readFloat(&elevation) || !readFloat(&translationX)
+            || !readFloat(&translationY) || !readFloat(&translationZ)
+            || !readFloat(&rotation) || !readFloat(&rotationX) || !readFloat(&rotationY)
+            || !readFloat(&scaleX) || !readFloat(&scaleY) || !readInt(&pivotExplicitlySet)
+            || !readFloat(&pivotX) || !readFloat(&pivotY) || !readFloat(&cameraDistance)) {
+        return false;
+    }
+
+    RenderProperties& props = node->mutateStagingProperties();
+    props.setLeftTopRightBottom(left, top, right, bottom);
+    props.setAlpha(alpha);
+    props.setHasOverlappingRendering(hasOverlappingRendering);
+    props.setElevation(elevation);
+    props.setTranslationX(translationX);
+    props.setTranslationY(translationY);
+    props.setTranslationZ(translationZ);
+    props.setRotation(rotation);
+    props.setRotationX(rotationX);
+    props.setRotationY(rotationY);
+    props.setScaleX(scaleX);
+    props.setScaleY(scaleY);
+    if (pivotExplicitlySet) {
+        props.setPivotX(pivotX);
+        props.setPivotY(pivotY);
+    }
+    props.setCameraDistance(cameraDistance);
+    *outWidth = right - left;
+    *outHeight = bottom - top;
+
+    int32_t clippingFlags, projectBackwards, projectionReceiver;
+    Rect clipBounds;
+    if (!readInt(&clippingFlags) || !readRect(&clipBounds)
+            || !readInt(&projectBackwards) || !readInt(&projectionReceiver)) {
+        return false;
+    }
+    props.setClipToBounds(clippingFlags & CLIP_TO_BOUNDS);
+    if (clippingFlags & CLIP_TO_CLIP_BOUNDS) {
+        props.setClipBounds(clipBounds);
+    }
+    props.setProjectBackwards(projectBackwards);
+    props.setProjectionReceiver(projectionReceiver);
+
+    int32_t hasMatrix;
+    SkMatrix matrix;
+    if (!readInt(&hasMatrix)) return false;
+    if (hasMatrix) {
+        if (!readMatrix(&matrix)) return false;
+        props.setStaticMatrix(&matrix);
+    }
+    if (!readInt(&hasMatrix)) return false;
+    if (hasMatrix) {
+        if (!readMatrix(&matrix)) return false;
+        props.setAnimationMatrix(&matrix);
+    }
+
+    int32_t layerType, layerOpaque, layerAlpha, layerMode;
+    if (!readInt(&layerType) || !readInt(&layerOpaque) || !readInt(&layerAlpha)
+            || !readInt(&layerMode)
+            || layerType < static_cast<int>(LayerType::None)
+            || layerType > static_cast<int>(LayerType::RenderLayer)
+            || layerMode < 0 || layerMode > SkXfermode::kLastMode) {
+        return false;
+    }
+    LayerProperties& layerProps = props.mutateLayerProperties();
+    layerProps.setType(static_cast<LayerType>(layerType));
+    layerProps.setOpaque(layerOpaque);
+    layerProps.setAlpha(layerAlpha);
+    layerProps.setXferMode(static_cast<SkXfermode::Mode>(layerMode));
+
+    int32_t outlineType, outlinePath, outlineShouldClip;
+    Rect outlineBounds;
+    float outlineRadius, outlineAlpha;
+    if (!readInt(&outlineType) || !readRect(&outlineBounds) || !readFloat(&outlineRadius)
+            || !readInt(&outlinePath) || !readFloat(&outlineAlpha)
+            || !readInt(&outlineShouldClip)) {
+        return false;
+    }
+    Outline& outline = props.mutableOutline();
+    switch (outlineType) {
+    case kOutline_None:
+        outline.setNone();
+        break;
+    case kOutline_Empty:
+        outline.setEmpty();
+        break;
+    case kOutline_ConvexPath: {
+        const SkPath* path = getPath(outlinePath);
+        if (!path) return false;
+        outline.setConvexPath(path, outlineAlpha);
+        break;
+    }
+    case kOutline_RoundRect:
+        outline.setRoundRect(outlineBounds.left, outlineBounds.top,
+                outlineBounds.right, outlineBounds.bottom, outlineRadius, outlineAlpha);
+        break;
+    default:
+        return false;
+    }
+    outline.setShouldClip(outlineShouldClip);
+    return true;
+}
+
+bool DisplayListReader::readOp(int32_t tag, DisplayListCanvas& canvas) {
+    static const SkPaint kDefaultPaint;
+
+    int32_t value;
+    int32_t index;
+    float x, y, z;
+    Rect rect;
+    Rect src;
+    SkMatrix matrix;
+    const SkPaint* paint;
+    const SkPath* path;
+    const SkBitmap* bitmap;
+    size_t size;
+    size_t positionsSize;
+    const void* array;
+    const void* positions;
+
+    switch (tag) {
+    case kRecord_ReorderBarrier:
+        if (!readInt(&value)) return false;
+        canvas.insertReorderBarrier(value);
+        return true;
+    case kRecord_Save:
+        if (!readInt(&value)) return false;
+        canvas.save(static_cast<SkCanvas::SaveFlags>(value));
+        return true;
+    case kRecord_RestoreToCount:
+        if (!readInt(&value) || value < 1 || value > canvas.getSaveCount()) return false;
+        canvas.restoreToCount(value);
+        return true;
+    case kRecord_SaveLayer:
+        if (!readRect(&rect) || !readInt(&index) || !getPaint(index, &paint)
+                || !readInt(&value)) {
+            return false;
+        }
+        canvas.saveLayer(rect.left, rect.top, rect.right, rect.bottom, paint,
+                static_cast<SkCanvas::SaveFlags>(value));
+        return true;
+    case kRecord_Translate:
+        if (!readFloat(&x) || !readFloat(&y)) return false;
+        canvas.translate(x, y);
+        return true;
+    case kRecord_Rotate:
+        if (!readFloat(&x)) return false;
+        canvas.rotate(x);
+        return true;
+    case kRecord_Scale:
+        if (!readFloat(&x) || !readFloat(&y)) return false;
+        canvas.scale(x, y);
+        return true;
+    case kRecord_Skew:
+        if (!readFloat(&x) || !readFloat(&y)) return false;
+        canvas.skew(x, y);
+        return true;
+    case kRecord_SetMatrix:
+        if (!readMatrix(&matrix)) return false;
+        canvas.setMatrix(matrix);
+        return true;
+    case kRecord_SetLocalMatrix:
+        if (!readMatrix(&matrix)) return false;
+        canvas.setLocalMatrix(matrix);
+        return true;
+    case kRecord_Concat:
+        if (!readMatrix(&matrix)) return false;
+        canvas.concat(matrix);
+        return true;
+    case kRecord_ClipRect:
+        if (!readRect(&rect) || !readInt(&value)
+                || value < 0 || value > SkRegion::kLastOp) {
+            return false;
+        }
+        canvas.clipRect(rect.left, rect.top, rect.right, rect.bottom,
+                static_cast<SkRegion::Op>(value));
+        return true;
+    case kRecord_ClipPath:
+        if (!readInt(&index) || !(path = getPath(index)) || !readInt(&value)
+                || value < 0 || value > SkRegion::kLastOp) {
+            return false;
+        }
+        canvas.clipPath(path, static_cast<SkRegion::Op>(value));
+        return true;
+    case kRecord_DrawColor:
+        if (!readInt(&value) || !readInt(&index)
+                || index < 0 || index > SkXfermode::kLastMode) {
+            return false;
+        }
+        canvas.drawColor(value, static_cast<SkXfermode::Mode>(index));
+        return true;
+    case kRecord_DrawRect:
+        if (!readRect(&rect) || !readInt(&index) || !getPaint(index, &paint)) return false;
+        canvas.drawRect(rect.left, rect.top, rect.right, rect.bottom,
+                paint ? *paint : kDefaultPaint);
+        return true;
+    case kRecord_DrawRects:
+        if (!(array = readArray(&size)) || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawRects(reinterpret_cast<const float*>(array), size / sizeof(float), paint);
+        return true;
+    case kRecord_DrawRoundRect:
+        if (!readRect(&rect) || !readFloat(&x) || !readFloat(&y)
+                || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawRoundRect(rect.left, rect.top, rect.right, rect.bottom, x, y,
+                paint ? *paint : kDefaultPaint);
+        return true;
+    case kRecord_DrawCircle:
+        if (!readFloat(&x) || !readFloat(&y) || !readFloat(&z)
+                || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawCircle(x, y, z, paint ? *paint : kDefaultPaint);
+        return true;
+    case kRecord_DrawOval:
+        if (!readRect(&rect) || !readInt(&index) || !getPaint(index, &paint)) return false;
+        canvas.drawOval(rect.left, rect.top, rect.right, rect.bottom,
+                paint ? *paint : kDefaultPaint);
+        return true;
+    case kRecord_DrawArc:
+        if (!readRect(&rect) || !readFloat(&x) || !readFloat(&y) || !readInt(&value)
+                || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawArc(rect.left, rect.top, rect.right, rect.bottom, x, y, value,
+                paint ? *paint : kDefaultPaint);
+        return true;
+    case kRecord_DrawPath:
+        if (!readInt(&value) || !(path = getPath(value))
+                || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawPath(*path, paint ? *paint : kDefaultPaint);
+        return true;
+    case kRecord_DrawLines:
+    case kRecord_DrawPoints:
+        if (!(array = readArray(&size)) || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        if (tag == kRecord_DrawLines) {
+            canvas.drawLines(reinterpret_cast<const float*>(array), size / sizeof(float),
+                    paint ? *paint : kDefaultPaint);
+        } else {
+            canvas.drawPoints(reinterpret_cast<const float*>(array), size / sizeof(float),
+                    paint ? *paint : kDefaultPaint);
+        }
+        return true;
+    case kRecord_DrawText: {
+        float totalAdvance;
+        if (!(array = readArray(&size)) || !(positions = readArray(&positionsSize))
+                || positionsSize != size / sizeof(uint16_t) * 2 * sizeof(float)
+                || !readFloat(&x) || !readFloat(&y) || !readRect(&rect)
+                || !readFloat(&totalAdvance) || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawText(reinterpret_cast<const uint16_t*>(array),
+                reinterpret_cast<const float*>(positions), size / sizeof(uint16_t),
+                paint ? *paint : kDefaultPaint, x, y,
+                rect.left, rect.top, rect.right, rect.bottom, totalAdvance);
+        return true;
+    }
+    case kRecord_DrawPosText:
+        if (!(array = readArray(&size)) || !(positions = readArray(&positionsSize))
+                || positionsSize != size / sizeof(uint16_t) * 2 * sizeof(float)
+                || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawPosText(reinterpret_cast<const uint16_t*>(array),
+                reinterpret_cast<const float*>(positions), size / sizeof(uint16_t),
+                size / sizeof(uint16_t), paint ? *paint : kDefaultPaint);
+        return true;
+    case kRecord_DrawTextOnPath:
+        if (!(array = readArray(&size)) || !readInt(&value) || !(path = getPath(value))
+                || !readFloat(&x) || !readFloat(&y)
+                || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawTextOnPath(reinterpret_cast<const uint16_t*>(array),
+                size / sizeof(uint16_t), *path, x, y, paint ? *paint : kDefaultPaint);
+        return true;
+    case kRecord_DrawBitmap:
+        if (!readInt(&value) || !(bitmap = getBitmap(value))
+                || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawBitmap(bitmap, paint);
+        return true;
+    case kRecord_DrawBitmapRect:
+        if (!readInt(&value) || !(bitmap = getBitmap(value)) || !readRect(&src)
+                || !readRect(&rect) || !readInt(&index) || !getPaint(index, &paint)) {
+            return false;
+        }
+        canvas.drawBitmap(*bitmap, src.left, src.top, src.right, src.bottom,
+                rect.left, rect.top, rect.right, rect.bottom, paint);
+        return true;
+    case kRecord_DrawRenderNode:
+        if (!readInt(&index) || index < 0 || index >= static_cast<int>(mNodes.size())) {
+            return false;
+        }
+        canvas.drawRenderNode(mNodes[index].get());
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool DisplayListReader::readPaint() {
+    int32_t flags, color, style, cap, join, align, encoding, hinting, mode;
+    float strokeWidth, strokeMiter, textSize, textScaleX, textSkewX;
+    if (!readInt(&flags) || !readInt(&color) || !readInt(&style)
+            || !readFloat(&strokeWidth) || !readFloat(&strokeMiter)
+            || !readInt(&cap) || !readInt(&join) || !readFloat(&textSize)
+            || !readFloat(&textScaleX) || !readFloat(&textSkewX) || !readInt(&align)
+            || !readInt(&encoding) || !readInt(&hinting) || !readInt(&mode)) {
+        return false;
+    }
+    if (style < 0 || style >= SkPaint::kStyleCount
+            || cap < 0 || cap >= SkPaint::kCapCount
+            || join < 0 || join >= SkPaint::kJoinCount
+            || align < 0 || align >= SkPaint::kAlignCount
+            || encoding < SkPaint::kUTF8_TextEncoding
+            || encoding > SkPaint::kGlyphID_TextEncoding
+            || hinting < SkPaint::kNo_Hinting || hinting > SkPaint::kFull_Hinting
+            || mode < 0 || mode > SkXfermode::kLastMode) {
+        return false;
+    }
+
+    SkPaint paint;
+    paint.setFlags(flags);
+    paint.setColor(color);
+    paint.setStyle(static_cast<SkPaint::Style>(style));
+    paint.setStrokeWidth(strokeWidth);
+    paint.setStrokeMiter(strokeMiter);
+    paint.setStrokeCap(static_cast<SkPaint::Cap>(cap));
+    paint.setStrokeJoin(static_cast<SkPaint::Join>(join));
+    paint.setTextSize(textSize);
+    paint.setTextScaleX(textScaleX);
+    paint.setTextSkewX(textSkewX);
+    paint.setTextAlign(static_cast<SkPaint::Align>(align));
+    paint.setTextEncoding(static_cast<SkPaint::TextEncoding>(encoding));
+    paint.setHinting(static_cast<SkPaint::Hinting>(hinting));
+    if (mode != SkXfermode::kSrcOver_Mode) {
+        paint.setXfermodeMode(static_cast<SkXfermode::Mode>(mode));
+    }
+    mPaints.push_back(paint);
+    return true;
+}
+
+bool DisplayListReader::readPath() {
+    size_t size;
+    const void* data = readArray(&size);
+    if (!data) return false;
+
+    SkPath path;
+    if (path.readFromMemory(data, size) != size) return false;
+    mPaths.push_back(path);
+    return true;
+}
+
+bool DisplayListReader::readBitmap() {
+    int32_t width, height, colorType, alphaType;
+    if (!readInt(&width) || !readInt(&height) || !readInt(&colorType) || !readInt(&alphaType)
+            || width <= 0 || height <= 0
+            || alphaType < 0 || alphaType > kLastEnum_SkAlphaType) {
+        return false;
+    }
+
+    // Pixels aren't captured, keep the size and whether the paint color applies
+    SkColorType placeholderType = colorType == kAlpha_8_SkColorType
+            ? kAlpha_8_SkColorType : kN32_SkColorType;
+    SkBitmap bitmap;
+    if (!bitmap.tryAllocPixels(SkImageInfo::Make(width, height, placeholderType,
+            static_cast<SkAlphaType>(alphaType)))) {
+        return false;
+    }
+    bitmap.eraseColor(0xFF808080);
+    mBitmaps.push_back(bitmap);
+    return true;
+}
+
+bool DisplayListReader::readInt(int32_t* outValue) {
+    if (mSize - mOffset < sizeof(*outValue)) return false;
+    memcpy(outValue, mData + mOffset, sizeof(*outValue));
+    mOffset += sizeof(*outValue);
+    return true;
+}
+
+bool DisplayListReader::readFloat(float* outValue) {
+    if (mSize - mOffset < sizeof(*outValue)) return false;
+    memcpy(outValue, mData + mOffset, sizeof(*outValue));
+    mOffset += sizeof(*outValue);
+    return true;
+}
+
+bool DisplayListReader::readRect(Rect* outRect) {
+    return readFloat(&outRect->left) && readFloat(&outRect->top)
+            && readFloat(&outRect->right) && readFloat(&outRect->bottom);
+}
+
+bool DisplayListReader::readMatrix(SkMatrix* outMatrix) {
+    float values[9];
+    for (int i = 0; i < 9; i++) {
+        if (!readFloat(&values[i])) return false;
+    }
+    outMatrix->set9(values);
+    return true;
+}
+
+const void* DisplayListReader::readArray(size_t* outSize) {
+    int32_t size;
+    if (!readInt(&size) || size < 0 || mSize - mOffset < alignSize(size)) return nullptr;
+
+    const void* data = mData + mOffset;
+    mOffset += alignSize(size);
+    *outSize = size;
+    return data;
+}
+
+bool DisplayListReader::getPaint(int32_t index, const SkPaint** outPaint) const {
+    if (index == -1) {
+        *outPaint = nullptr;
+        return true;
+    }
+    if (index < 0 || index >= static_cast<int>(mPaints.size())) return false;
+    *outPaint = &mPaints[index];
+    return true;
+}
+
+const SkPath* DisplayListReader::getPath(int32_t index) const {
+    if (index < 0 || index >= static_cast<int>(mPaths.size())) return nullptr;
+    return &mPaths[index];
+}
+
+const SkBitmap* DisplayListReader::getBitmap(int32_t index) const {
+    if (index < 0 || index >= static_cast<int>(mBitmaps.size())) return nullptr;
+    return &mBitmaps[index];
+}
+
+} /* namespace uirenderer */
+} /* namespace android */
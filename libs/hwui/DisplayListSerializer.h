@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DISPLAYLISTSERIALIZER_H_
+#define DISPLAYLISTSERIALIZER_H_
+
+#include "utils/Macros.h"
+
+#include <SkRegion.h>
+#include <SkXfermode.h>
+#include <utils/StrongPointer.h>
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+class SkBitmap;
+class SkMatrix;
+class SkPaint;
+class SkPath;
+
+namespace android {
+namespace uirenderer {
+
+class DisplayListCanvas;
+class Rect;
+class RenderNode;
+
+/**
+ * Serializes a RenderNode tree, to capture frames of real apps and replay them
+ * in hwuitest, see DisplayListReader.
+ *
+ * The ops describe themselves with DisplayListOp::serialize() as the
+ * DisplayListCanvas calls that recorded them, so the reader simply records
+ * them again. Ops that can't be described that way (functors, layers,
+ * patches, meshes, animated canvas properties, clip regions) are skipped.
+ *
+ * Paints keep their flags, color, stroke, text settings and transfer mode.
+ * Shaders, color filters, path effects, mask filters, loopers and typefaces
+ * are dropped. Bitmaps are only referenced: the reader replaces them with
+ * placeholders of the same size and color type.
+ *
+ * Must be used on the RenderThread, it reads the properties and display lists
+ * that are synced to it.
+ */
+class DisplayListWriter {
+    PREVENT_COPY_AND_ASSIGN(DisplayListWriter);
+public:
+    DisplayListWriter() {}
+
+    void writeTree(RenderNode* root);
+    bool writeToFile(const char* path) const;
+
+    const std::vector<uint8_t>& data() const { return mData; }
+    int getSkippedOpCount() const { return mSkippedOpCount; }
+    int getLossyPaintCount() const { return mLossyPaintCount; }
+
+    // Called by DisplayListOp::serialize()
+    void insertReorderBarrier(bool enableReorder);
+    void save(int flags);
+    void restoreToCount(int saveCount);
+    void saveLayer(const Rect& area, const SkPaint* paint, int flags);
+    void translate(float dx, float dy);
+    void rotate(float degrees);
+    void scale(float sx, float sy);
+    void skew(float sx, float sy);
+    void setMatrix(const SkMatrix& matrix);
+    void setLocalMatrix(const SkMatrix& matrix);
+    void concat(const SkMatrix& matrix);
+    void clipRect(const Rect& area, SkRegion::Op op);
+    void clipPath(const SkPath* path, SkRegion::Op op);
+    void drawColor(int color, SkXfermode::Mode mode);
+    void drawRect(const Rect& rect, const SkPaint* paint);
+    void drawRects(const float* rects, int count, const SkPaint* paint);
+    void drawRoundRect(const Rect& rect, float rx, float ry, const SkPaint* paint);
+    void drawCircle(float x, float y, float radius, const SkPaint* paint);
+    void drawOval(const Rect& rect, const SkPaint* paint);
+    void drawArc(const Rect& rect, float startAngle, float sweepAngle, bool useCenter,
+            const SkPaint* paint);
+    void drawPath(const SkPath* path, const SkPaint* paint);
+    void drawLines(const float* points, int count, const SkPaint* paint);
+    void drawPoints(const float* points, int count, const SkPaint* paint);
+    void drawText(const char* glyphs, int count, const float* positions, float x, float y,
+            const Rect& bounds, float totalAdvance, const SkPaint* paint);
+    void drawPosText(const char* glyphs, int count, const float* positions,
+            const SkPaint* paint);
+    void drawTextOnPath(const char* glyphs, int count, const SkPath* path,
+            float hOffset, float vOffset, const SkPaint* paint);
+    void drawBitmap(const SkBitmap* bitmap, const SkPaint* paint);
+    void drawBitmapRect(const SkBitmap* bitmap, const Rect& src, const Rect& dst,
+            const SkPaint* paint);
+    bool drawRenderNode(RenderNode* renderNode);
+
+private:
+    int writeNode(RenderNode* node);
+    void writeBeginNode(const RenderNode* node);
+
+    // Return the index of the resource, writing it first if it's new
+    int refPaint(const SkPaint* paint);
+    int refPath(const SkPath* path);
+    int refBitmap(const SkBitmap* bitmap);
+
+    void writeInt(int32_t value);
+    void writeFloat(float value);
+    void writeRect(const Rect& rect);
+    void writeMatrix(const SkMatrix& matrix);
+    // Writes the size in bytes then the data, padded to keep the next values aligned
+    void writeArray(const void* data, size_t size);
+
+    std::vector<uint8_t> mData;
+
+    std::unordered_map<const RenderNode*, int> mNodes;
+    std::unordered_map<const SkPaint*, int> mPaints;
+    std::unordered_map<const SkPath*, int> mPaths;
+    std::unordered_map<uint32_t, int> mBitmaps;
+
+    int mSkippedOpCount = 0;
+    int mLossyPaintCount = 0;
+};
+
+/**
+ * Records the RenderNodes serialized by DisplayListWriter again.
+ *
+ * The arrays of the ops (points, glyphs, positions) are handed from the data
+ * straight to the DisplayListCanvas, so a capture can be mmap()ed and read
+ * without any intermediate copy. The data only needs to stay valid during
+ * readTree(), the canvas copies what it keeps.
+ */
+class DisplayListReader {
+    PREVENT_COPY_AND_ASSIGN(DisplayListReader);
+public:
+    // data must be 4 bytes aligned
+    DisplayListReader(const void* data, size_t size);
+
+    // Returns nullptr if the data is malformed
+    sp<RenderNode> readTree();
+
+private:
+    bool readNode();
+    bool readProperties(RenderNode* node, int* outWidth, int* outHeight);
+    bool readOp(int32_t tag, DisplayListCanvas& canvas);
+    bool readPaint();
+    bool readPath();
+    bool readBitmap();
+
+    bool readInt(int32_t* outValue);
+    bool readFloat(float* outValue);
+    bool readRect(Rect* outRect);
+    bool readMatrix(SkMatrix* outMatrix);
+    const void* readArray(size_t* outSize);
+
+    // Return nullptr if index is out of range, -1 is a valid null paint
+    bool getPaint(int32_t index, const SkPaint** outPaint) const;
+    const SkPath* getPath(int32_t index) const;
+    const SkBitmap* getBitmap(int32_t index) const;
+
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mOffset = 0;
+
+    std::vector<sp<RenderNode> > mNodes;
+    std::vector<SkPaint> mPaints;
+    std::vector<SkPath> mPaths;
+    std::vector<SkBitmap> mBitmaps;
+};
+
+} /* namespace uirenderer */
+} /* namespace android */
+
+#endif /* DISPLAYLISTSERIALIZER_H_ */
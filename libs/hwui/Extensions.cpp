@@ -58,6 +58,14 @@ Extensions::Extensions() {
     mHasTiledRendering = hasGlExtension("GL_QCOM_tiled_rendering");
     mHas1BitStencil = hasGlExtension("GL_OES_stencil1");
     mHas4BitStencil = hasGlExtension("GL_OES_stencil4");
+    mHasDisjointTimerQuery = hasGlExtension("GL_EXT_disjoint_timer_query");
+
+    mHasProgramBinary = false;
+    if (hasGlExtension("GL_OES_get_program_binary")) {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formatCount);
+        mHasProgramBinary = formatCount > 0;
+    }
 
     // Query EGL extensions
     findExtensions(eglQueryString(eglGetCurrentDisplay(), EGL_EXTENSIONS), mEglExtensionList);
@@ -44,10 +44,13 @@ public:
     inline bool has1BitStencil() const { return mHas1BitStencil; }
     inline bool has4BitStencil() const { return mHas4BitStencil; }
     inline bool hasNvSystemTime() const { return mHasNvSystemTime; }
+    inline bool hasProgramBinary() const { return mHasProgramBinary; }
+    inline bool hasDisjointTimerQuery() const { return mHasDisjointTimerQuery; }
     inline bool hasUnpackRowLength() const { return mVersionMajor >= 3; }
     inline bool hasPixelBufferObjects() const { return mVersionMajor >= 3; }
     inline bool hasOcclusionQueries() const { return mVersionMajor >= 3; }
     inline bool hasFloatTextures() const { return mVersionMajor >= 3; }
+    inline bool hasInstancedArrays() const { return mVersionMajor >= 3; }
 
     inline int getMajorGlVersion() const { return mVersionMajor; }
     inline int getMinorGlVersion() const { return mVersionMinor; }
@@ -71,6 +74,8 @@ private:
     bool mHas1BitStencil;
     bool mHas4BitStencil;
     bool mHasNvSystemTime;
+    bool mHasProgramBinary;
+    bool mHasDisjointTimerQuery;
 
     int mVersionMajor;
     int mVersionMinor;
@@ -50,10 +50,14 @@ namespace uirenderer {
 // TextSetupFunctor
 ///////////////////////////////////////////////////////////////////////////////
 
-void TextDrawFunctor::draw(CacheTexture& texture, bool linearFiltering) {
+void TextDrawFunctor::draw(CacheTexture& texture, bool linearFiltering,
+        float distanceFieldSmoothing) {
     int textureFillFlags = TextureFillFlags::None;
     if (texture.getFormat() == GL_ALPHA) {
         textureFillFlags |= TextureFillFlags::IsAlphaMaskTexture;
+    } else {
+        // color glyphs have no distance field, they are only scaled
+        distanceFieldSmoothing = 0.0f;
     }
     if (linearFiltering) {
         textureFillFlags |= TextureFillFlags::ForceFilter;
@@ -64,6 +68,7 @@ void TextDrawFunctor::draw(CacheTexture& texture, bool linearFiltering) {
     GlopBuilder(renderer->mRenderState, renderer->mCaches, &glop)
             .setMeshTexturedIndexedQuads(texture.mesh(), texture.meshElementCount())
             .setFillTexturePaint(texture.getTexture(), textureFillFlags, paint, renderer->currentSnapshot()->alpha)
+            .setFillDistanceField(distanceFieldSmoothing)
             .setTransform(*(renderer->currentSnapshot()), transformFlags)
             .setModelViewOffsetRect(0, 0, Rect(0, 0, 0, 0))
             .setRoundRectClipState(renderer->currentSnapshot()->roundRectClipState)
@@ -88,7 +93,8 @@ FontRenderer::FontRenderer()
         , mBounds(nullptr)
         , mDrawn(false)
         , mInitialized(false)
-        , mLinearFiltering(false) {
+        , mLinearFiltering(false)
+        , mDistanceFieldSmoothing(0.0f) {
 
     if (sLogFontRendererCreate) {
         INIT_LOGD("Creating FontRenderer");
@@ -203,7 +209,7 @@ CacheTexture* FontRenderer::cacheBitmapInTexture(Vector<CacheTexture*>& cacheTex
 }
 
 void FontRenderer::cacheBitmap(const SkGlyph& glyph, CachedGlyphInfo* cachedGlyph,
-        uint32_t* retOriginX, uint32_t* retOriginY, bool precaching) {
+        uint32_t* retOriginX, uint32_t* retOriginY, bool precaching, bool distanceField) {
     checkInit();
 
     // If the glyph bitmap is empty let's assum the glyph is valid
@@ -284,6 +290,8 @@ void FontRenderer::cacheBitmap(const SkGlyph& glyph, CachedGlyphInfo* cachedGlyp
     uint8_t* cacheBuffer = cacheTexture->getPixelBuffer()->map();
     uint8_t* bitmapBuffer = (uint8_t*) glyph.fImage;
     int srcStride = glyph.rowBytes();
+    // Distance fields hold distances, not coverage
+    const uint8_t* gammaTable = distanceField ? nullptr : mGammaTable;
 
     // Copy the glyph image, taking the mask format into account
     switch (format) {
@@ -294,13 +302,13 @@ void FontRenderer::cacheBitmap(const SkGlyph& glyph, CachedGlyphInfo* cachedGlyp
             // write leading border line
             memset(&cacheBuffer[row], 0, glyph.fWidth + 2 * TEXTURE_BORDER_SIZE);
             // write glyph data
-            if (mGammaTable) {
+            if (gammaTable) {
                 for (cacheY = startY, bY = 0; cacheY < endY; cacheY++, bY += srcStride) {
                     row = cacheY * cacheWidth;
                     cacheBuffer[row + startX - TEXTURE_BORDER_SIZE] = 0;
                     for (cacheX = startX, bX = 0; cacheX < endX; cacheX++, bX++) {
                         uint8_t tempCol = bitmapBuffer[bY + bX];
-                        cacheBuffer[row + cacheX] = mGammaTable[tempCol];
+                        cacheBuffer[row + cacheX] = gammaTable[tempCol];
                     }
                     cacheBuffer[row + endX + TEXTURE_BORDER_SIZE - 1] = 0;
                 }
@@ -484,7 +492,7 @@ void FontRenderer::issueDrawCommand(Vector<CacheTexture*>& cacheTextures) {
                 mDrawn = true;
             }
 
-            mFunctor->draw(*texture, mLinearFiltering);
+            mFunctor->draw(*texture, mLinearFiltering, mDistanceFieldSmoothing);
 
             texture->resetMesh();
             forceRebind = false;
@@ -552,6 +560,35 @@ void FontRenderer::appendRotatedMeshQuad(float x1, float y1, float u1, float v1,
 
 void FontRenderer::setFont(const SkPaint* paint, const SkMatrix& matrix) {
     mCurrentFont = Font::create(this, paint, matrix);
+    mDistanceFieldSmoothing = 0.0f;
+}
+
+// Text size once drawn, as far as glyph rasterization is concerned
+static float getScreenTextSize(const SkPaint* paint, const mat4& transform) {
+    float sx, sy;
+    transform.decomposeScale(sx, sy);
+    return paint->getTextSize() * std::max(sx, sy);
+}
+
+bool FontRenderer::canUseDistanceField(const SkPaint* paint, const mat4& transform) {
+    // Unscaled text keeps its hinted glyphs, and perspective needs a varying smoothing
+    return Properties::distanceFieldText
+            && !transform.isPureTranslate()
+            && !transform.isPerspective()
+            && paint->getStyle() == SkPaint::kFill_Style
+            && paint->isAntiAlias()
+            && getScreenTextSize(paint, transform) >= DISTANCE_FIELD_MIN_TEXT_SIZE;
+}
+
+void FontRenderer::setDistanceFieldFont(const SkPaint* paint, const mat4& transform) {
+    mCurrentFont = Font::createDistanceField(this, paint);
+
+    // Smooth the edge over about one pixel on screen: a screen pixel covers
+    // DISTANCE_FIELD_TEXT_SIZE / screenTextSize texels, and the texel values
+    // change by 127 / 255 every DISTANCE_FIELD_SPREAD texels
+    float texelsPerPixel = DISTANCE_FIELD_TEXT_SIZE / getScreenTextSize(paint, transform);
+    mDistanceFieldSmoothing = MathUtils::min(0.5f,
+            0.5f * texelsPerPixel * (127.0f / 255.0f) / DISTANCE_FIELD_SPREAD);
 }
 
 FontRenderer::DropShadow FontRenderer::renderDropShadow(const SkPaint* paint, const char *text,
@@ -646,6 +683,25 @@ void FontRenderer::precache(const SkPaint* paint, const char* text, int numGlyph
     font->precache(paint, text, numGlyphs);
 }
 
+void FontRenderer::precacheDistanceField(const SkPaint* paint, const char* text,
+        int numGlyphs) {
+    Font* font = Font::createDistanceField(this, paint);
+    SkPaint distanceFieldPaint(*paint);
+    Font::setupDistanceFieldPaint(&distanceFieldPaint);
+    font->precache(&distanceFieldPaint, text, numGlyphs);
+}
+
+Font::GlyphProcessor* FontRenderer::getGlyphProcessor() {
+    if (!mGlyphProcessor.get()) {
+        TaskManager& taskManager = Caches::getInstance().tasks;
+        if (!taskManager.canRunTasks()) {
+            return nullptr;
+        }
+        mGlyphProcessor = new Font::GlyphProcessor(&taskManager);
+    }
+    return mGlyphProcessor.get();
+}
+
 void FontRenderer::endPrecaching() {
     checkTextureUpdate();
 }
@@ -733,10 +789,15 @@ void FontRenderer::blurImage(uint8_t** image, int32_t width, int32_t height, flo
     }
 #endif
 
+    std::unique_ptr<uint8_t[]> scratch(new uint8_t[width * height]);
+    if ((int32_t) intRadius >= Blur::kBoxApproximationMinRadius) {
+        Blur::boxApproximation(intRadius, *image, scratch.get(), width, height);
+        return;
+    }
+
     std::unique_ptr<float[]> gaussian(new float[2 * intRadius + 1]);
     Blur::generateGaussianWeights(gaussian.get(), intRadius);
 
-    std::unique_ptr<uint8_t[]> scratch(new uint8_t[width * height]);
     Blur::horizontal(gaussian.get(), intRadius, *image, scratch.get(), width, height);
     Blur::vertical(gaussian.get(), intRadius, scratch.get(), *image, width, height);
 }
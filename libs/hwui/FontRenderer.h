@@ -59,7 +59,7 @@ public:
         , paint(paint) {
     }
 
-    void draw(CacheTexture& texture, bool linearFiltering);
+    void draw(CacheTexture& texture, bool linearFiltering, float distanceFieldSmoothing);
 
     OpenGLRenderer* renderer;
     float x;
@@ -84,7 +84,17 @@ public:
 
     void setFont(const SkPaint* paint, const SkMatrix& matrix);
 
+    /**
+     * Returns true if text drawn with the specified paint under the specified
+     * transform should use a distance field font, see PROPERTY_DISTANCE_FIELD_TEXT.
+     */
+    static bool canUseDistanceField(const SkPaint* paint, const mat4& transform);
+
+    // Sets the distance field font, and its smoothing for the transform's scale
+    void setDistanceFieldFont(const SkPaint* paint, const mat4& transform);
+
     void precache(const SkPaint* paint, const char* text, int numGlyphs, const SkMatrix& matrix);
+    void precacheDistanceField(const SkPaint* paint, const char* text, int numGlyphs);
     void endPrecaching();
 
     // bounds is an out parameter
@@ -126,7 +136,7 @@ private:
     void initTextTexture();
     CacheTexture* createCacheTexture(int width, int height, GLenum format, bool allocate);
     void cacheBitmap(const SkGlyph& glyph, CachedGlyphInfo* cachedGlyph,
-            uint32_t *retOriginX, uint32_t *retOriginY, bool precaching);
+            uint32_t *retOriginX, uint32_t *retOriginY, bool precaching, bool distanceField);
     CacheTexture* cacheBitmapInTexture(Vector<CacheTexture*>& cacheTextures, const SkGlyph& glyph,
             uint32_t* startX, uint32_t* startY);
 
@@ -153,6 +163,9 @@ private:
 
     void removeFont(const Font* font);
 
+    // Returns null if glyphs can't be rasterized off the render thread
+    Font::GlyphProcessor* getGlyphProcessor();
+
     void checkTextureUpdate();
 
     void setTextureDirty() {
@@ -170,6 +183,8 @@ private:
     Font* mCurrentFont;
     LruCache<Font::FontDescription, Font*> mActiveFonts;
 
+    sp<Font::GlyphProcessor> mGlyphProcessor;
+
     CacheTexture* mCurrentCacheTexture;
 
     bool mUploadTexture;
@@ -183,6 +198,9 @@ private:
 
     bool mLinearFiltering;
 
+    // Non zero while the current font is a distance field font
+    float mDistanceFieldSmoothing;
+
 #ifdef ANDROID_ENABLE_RENDERSCRIPT
     // RS constructs
     RSC::sp<RSC::RS> mRs;
@@ -35,10 +35,19 @@ const std::string FrameInfoNames[] = {
     "IssueDrawCommandsStart",
     "SwapBuffers",
     "FrameCompleted",
+    "GpuDuration",
+    "GpuLayersDuration",
+    "LayerLatchDuration",
+    "FramebufferSwitches",
 };
 
 void FrameInfo::importUiThreadInfo(int64_t* info) {
     memcpy(mFrameInfo, info, UI_THREAD_FRAME_INFO_SIZE * sizeof(int64_t));
+    // Not all of the render thread's fields are set on every frame, don't
+    // inherit them from the frame that previously used this FrameInfo
+    memset(mFrameInfo + UI_THREAD_FRAME_INFO_SIZE, 0,
+            (static_cast<int>(FrameInfoIndex::NumIndexes) - UI_THREAD_FRAME_INFO_SIZE)
+            * sizeof(int64_t));
 }
 
 } /* namespace uirenderer */
@@ -48,6 +48,16 @@ enum class FrameInfoIndex {
     SwapBuffers,
     FrameCompleted,
 
+    // Durations measured by GpuTimer, only with PROPERTY_GPU_FRAME_TIMING
+    GpuDuration,
+    GpuLayersDuration,
+
+    // Time spent latching new TextureView / SurfaceTexture frames during sync
+    LayerLatchDuration,
+
+    // Number of framebuffer binds issued while drawing the frame
+    FramebufferSwitches,
+
     // Must be the last value!
     NumIndexes
 };
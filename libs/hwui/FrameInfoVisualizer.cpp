@@ -18,7 +18,11 @@
 #include "OpenGLRenderer.h"
 
 #include <cutils/compiler.h>
+#include <utils/Log.h>
 #include <array>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
 
 #define RETURN_IF_PROFILING_DISABLED() if (CC_LIKELY(mType == ProfileType::None)) return
 #define RETURN_IF_DISABLED() if (CC_LIKELY(mType == ProfileType::None && !mShowDirtyRegions)) return
@@ -46,7 +50,7 @@ struct BarSegment {
     SkColor color;
 };
 
-static const std::array<BarSegment,7> Bar {{
+static const std::array<BarSegment,PROFILE_BAR_SEGMENTS> Bar {{
     { FrameInfoIndex::IntendedVsync, FrameInfoIndex::HandleInputStart, 0x00796B },
     { FrameInfoIndex::HandleInputStart, FrameInfoIndex::PerformTraversalsStart, 0x388E3C },
     { FrameInfoIndex::PerformTraversalsStart, FrameInfoIndex::DrawStart, 0x689F38},
@@ -67,6 +71,7 @@ FrameInfoVisualizer::FrameInfoVisualizer(FrameInfoSource& source)
 
 FrameInfoVisualizer::~FrameInfoVisualizer() {
     destroyData();
+    setExportFd(-1);
 }
 
 void FrameInfoVisualizer::setDensity(float density) {
@@ -110,6 +115,7 @@ void FrameInfoVisualizer::draw(OpenGLRenderer* canvas) {
         info.markSwapBuffers();
         info.markFrameCompleted();
 
+        updateBars();
         initializeRects(canvas->getViewportHeight(), canvas->getViewportWidth());
         drawGraph(canvas);
         drawThreshold(canvas);
@@ -126,6 +132,44 @@ void FrameInfoVisualizer::createData() {
 void FrameInfoVisualizer::destroyData() {
     mFastRects.reset(nullptr);
     mJankyRects.reset(nullptr);
+    mBars.clear();
+}
+
+void FrameInfoVisualizer::computeBar(size_t index, FrameBar& bar) {
+    const FrameInfo& frame = mFrameSource[index];
+    bar.vsync = frame[FrameInfoIndex::IntendedVsync];
+    bar.skipped = frame[FrameInfoIndex::Flags] & FrameInfoFlags::SkippedFrame;
+    bar.janky = frame.totalDuration() > FRAME_THRESHOLD_NS;
+    for (size_t i = 0; i < Bar.size(); i++) {
+        bar.segmentMs[i] = durationMS(index, Bar[i].start, Bar[i].end);
+    }
+}
+
+void FrameInfoVisualizer::updateBars() {
+    // mBars mirrors mFrameSource. Its newest entry was still in progress when
+    // it was computed, so it gets refreshed along with the frames added since.
+    ssize_t resume = -1;
+    if (mBars.size() && mBars.size() <= mFrameSource.size()) {
+        const int64_t vsync = mBars.back().vsync;
+        for (ssize_t i = mFrameSource.size() - 1; i >= 0; i--) {
+            if (mFrameSource[i][FrameInfoIndex::IntendedVsync] == vsync) {
+                resume = i;
+                break;
+            }
+        }
+    }
+
+    size_t first;
+    if (resume < 0) {
+        mBars.clear();
+        first = 0;
+    } else {
+        computeBar(resume, mBars.back());
+        first = resume + 1;
+    }
+    for (size_t fi = first; fi < mFrameSource.size(); fi++) {
+        computeBar(fi, mBars.next());
+    }
 }
 
 void FrameInfoVisualizer::initializeRects(const int baseline, const int width) {
@@ -136,15 +180,15 @@ void FrameInfoVisualizer::initializeRects(const int baseline, const int width) {
     mNumJankyRects = 0;
     int fast_i = 0, janky_i = 0;
     // Set the bottom of all the shapes to the baseline
-    for (int fi = mFrameSource.size() - 1; fi >= 0; fi--) {
-        if (mFrameSource[fi][FrameInfoIndex::Flags] & FrameInfoFlags::SkippedFrame) {
+    for (int fi = mBars.size() - 1; fi >= 0; fi--) {
+        if (mBars[fi].skipped) {
             continue;
         }
         float lineWidth = baseLineWidth;
         float* rect;
         int ri;
         // Rects are LTRB
-        if (mFrameSource[fi].totalDuration() <= FRAME_THRESHOLD_NS) {
+        if (!mBars[fi].janky) {
             rect = mFastRects.get();
             ri = fast_i;
             fast_i += 4;
@@ -165,18 +209,19 @@ void FrameInfoVisualizer::initializeRects(const int baseline, const int width) {
     }
 }
 
-void FrameInfoVisualizer::nextBarSegment(FrameInfoIndex start, FrameInfoIndex end) {
+void FrameInfoVisualizer::nextBarSegment(size_t segment) {
     int fast_i = (mNumFastRects - 1) * 4;
-    int janky_i = (mNumJankyRects - 1) * 4;;
-    for (size_t fi = 0; fi < mFrameSource.size(); fi++) {
-        if (mFrameSource[fi][FrameInfoIndex::Flags] & FrameInfoFlags::SkippedFrame) {
+    int janky_i = (mNumJankyRects - 1) * 4;
+    for (size_t fi = 0; fi < mBars.size(); fi++) {
+        const FrameBar& bar = mBars[fi];
+        if (bar.skipped) {
             continue;
         }
 
         float* rect;
         int ri;
         // Rects are LTRB
-        if (mFrameSource[fi].totalDuration() <= FRAME_THRESHOLD_NS) {
+        if (!bar.janky) {
             rect = mFastRects.get();
             ri = fast_i;
             fast_i -= 4;
@@ -189,14 +234,14 @@ void FrameInfoVisualizer::nextBarSegment(FrameInfoIndex start, FrameInfoIndex en
         // Set the bottom to the old top (build upwards)
         rect[ri + 3] = rect[ri + 1];
         // Move the top up by the duration
-        rect[ri + 1] -= mVerticalUnit * durationMS(fi, start, end);
+        rect[ri + 1] -= mVerticalUnit * bar.segmentMs[segment];
     }
 }
 
 void FrameInfoVisualizer::drawGraph(OpenGLRenderer* canvas) {
     SkPaint paint;
     for (size_t i = 0; i < Bar.size(); i++) {
-        nextBarSegment(Bar[i].start, Bar[i].end);
+        nextBarSegment(i);
         paint.setColor(Bar[i].color | BAR_FAST_ALPHA);
         canvas->drawRects(mFastRects.get(), mNumFastRects * 4, &paint);
         paint.setColor(Bar[i].color | BAR_JANKY_ALPHA);
@@ -262,5 +307,54 @@ void FrameInfoVisualizer::dumpData(int fd) {
     fflush(file);
 }
 
+void FrameInfoVisualizer::setExportFd(int fd) {
+    if (mExportFd >= 0) {
+        if (mExportDropped) {
+            ALOGW("Frame export dropped %zu frames", mExportDropped);
+        }
+        close(mExportFd);
+        mExportFd = -1;
+    }
+    mExportDropped = 0;
+    if (fd < 0) return;
+
+    mExportFd = dup(fd);
+    if (mExportFd < 0) {
+        ALOGW("Failed to dup frame export fd: %s", strerror(errno));
+        return;
+    }
+    std::string header;
+    for (size_t i = 0; i < static_cast<size_t>(FrameInfoIndex::NumIndexes); i++) {
+        header += FrameInfoNames[i];
+        header += ",";
+    }
+    header += "\n";
+    if (write(mExportFd, header.c_str(), header.length()) < 0) {
+        mExportDropped++;
+    }
+}
+
+void FrameInfoVisualizer::exportFrame(const FrameInfo& frame) {
+    if (CC_LIKELY(mExportFd < 0)) return;
+
+    char row[static_cast<int>(FrameInfoIndex::NumIndexes) * 22 + 2];
+    int length = 0;
+    for (int i = 0; i < static_cast<int>(FrameInfoIndex::NumIndexes); i++) {
+        length += snprintf(row + length, sizeof(row) - length, "%" PRId64 ",", frame[i]);
+    }
+    row[length++] = '\n';
+
+    // One write per frame keeps rows whole on pipes and sockets
+    ssize_t written = TEMP_FAILURE_RETRY(write(mExportFd, row, length));
+    if (written < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            mExportDropped++;
+        } else {
+            ALOGW("Stopping frame export: %s", strerror(errno));
+            setExportFd(-1);
+        }
+    }
+}
+
 } /* namespace uirenderer */
 } /* namespace android */
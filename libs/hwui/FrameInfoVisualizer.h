@@ -37,6 +37,20 @@ class OpenGLRenderer;
 // At least this is a compile failure if this doesn't match, so there's that.
 typedef RingBuffer<FrameInfo, 120> FrameInfoSource;
 
+// Number of colored segments stacked in each profile bar
+#define PROFILE_BAR_SEGMENTS 7
+
+/**
+ * Per frame bar data, derived once from the FrameInfo when a frame first
+ * shows up in the source instead of on every frame it stays on screen.
+ */
+struct FrameBar {
+    int64_t vsync;
+    bool skipped;
+    bool janky;
+    float segmentMs[PROFILE_BAR_SEGMENTS];
+};
+
 class FrameInfoVisualizer {
 public:
     FrameInfoVisualizer(FrameInfoSource& source);
@@ -50,12 +64,24 @@ public:
 
     void dumpData(int fd);
 
+    /**
+     * Streams every completed frame to fd, one CSV row per frame in the same
+     * column order as the framestats dump, until called again with -1. The
+     * fd is duplicated and should be non-blocking; frames that can't be
+     * written immediately are dropped rather than stalling the render thread.
+     * Works without profile bars enabled, so nothing needs to be drawn.
+     */
+    void setExportFd(int fd);
+    void exportFrame(const FrameInfo& frame);
+
 private:
     void createData();
     void destroyData();
 
+    void updateBars();
+    void computeBar(size_t index, FrameBar& bar);
     void initializeRects(const int baseline, const int width);
-    void nextBarSegment(FrameInfoIndex start, FrameInfoIndex end);
+    void nextBarSegment(size_t segment);
     void drawGraph(OpenGLRenderer* canvas);
     void drawThreshold(OpenGLRenderer* canvas);
 
@@ -70,6 +96,7 @@ private:
     float mDensity = 0;
 
     FrameInfoSource& mFrameSource;
+    RingBuffer<FrameBar, 120> mBars;
 
     int mVerticalUnit = 0;
     int mThresholdStroke = 0;
@@ -83,6 +110,9 @@ private:
     SkRect mDirtyRegion;
     bool mFlashToggle = false;
     nsecs_t mLastFrameLogged = 0;
+
+    int mExportFd = -1;
+    size_t mExportDropped = 0;
 };
 
 } /* namespace uirenderer */
@@ -106,6 +106,15 @@ struct Glop {
 
         int elementCount;
         TextureVertex mappedVertices[4];
+
+        // Per instance attributes, client memory only. The mesh is drawn
+        // once per instance if count > 0.
+        struct Instances {
+            const void* bounds;
+            const void* color;
+            GLsizei stride;
+            int count;
+        } instances;
     } mesh;
 
     struct Fill {
@@ -119,6 +128,9 @@ struct Glop {
             Matrix4* textureTransform;
         } texture;
 
+        // Smoothing width of distance field alpha textures, 0 for regular textures
+        float distanceFieldSmoothing;
+
         bool colorEnabled;
         FloatColor color;
 
@@ -64,6 +64,8 @@ GlopBuilder::GlopBuilder(RenderState& renderState, Caches& caches, Glop* outGlop
         , mShader(nullptr)
         , mOutGlop(outGlop) {
     mStageFlags = kInitialStage;
+    mOutGlop->mesh.instances = { nullptr, nullptr, 0, 0 };
+    mOutGlop->fill.distanceFieldSmoothing = 0.0f;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -137,6 +139,20 @@ GlopBuilder& GlopBuilder::setMeshIndexedQuads(Vertex* vertexData, int quadCount)
     return *this;
 }
 
+GlopBuilder& GlopBuilder::setMeshTriangles(const Vertex* vertexData, int vertexCount) {
+    TRIGGER_STAGE(kMeshStage);
+
+    mOutGlop->mesh.primitiveMode = GL_TRIANGLES;
+    mOutGlop->mesh.indices = { 0, nullptr };
+    mOutGlop->mesh.vertices = {
+            0,
+            VertexAttribFlags::None,
+            vertexData, nullptr, nullptr,
+            kVertexStride };
+    mOutGlop->mesh.elementCount = vertexCount;
+    return *this;
+}
+
 GlopBuilder& GlopBuilder::setMeshTexturedIndexedQuads(TextureVertex* vertexData, int elementCount) {
     TRIGGER_STAGE(kMeshStage);
 
@@ -189,10 +205,12 @@ GlopBuilder& GlopBuilder::setMeshVertexBuffer(const VertexBuffer& vertexBuffer,
 
     mOutGlop->mesh.primitiveMode = GL_TRIANGLE_STRIP;
     mOutGlop->mesh.indices = { 0, vertexBuffer.getIndices() };
+    // Vertices uploaded to a buffer object are addressed from offset 0
+    GLuint bufferObject = vertexBuffer.getBufferObject();
     mOutGlop->mesh.vertices = {
-            0,
+            bufferObject,
             alphaVertex ? VertexAttribFlags::Alpha : VertexAttribFlags::None,
-            vertexBuffer.getBuffer(), nullptr, nullptr,
+            bufferObject ? nullptr : vertexBuffer.getBuffer(), nullptr, nullptr,
             alphaVertex ? kAlphaVertexStride : kVertexStride };
     mOutGlop->mesh.elementCount = indices
                 ? vertexBuffer.getIndexCount() : vertexBuffer.getVertexCount();
@@ -215,6 +233,24 @@ GlopBuilder& GlopBuilder::setMeshPatchQuads(const Patch& patch) {
     return *this;
 }
 
+GlopBuilder& GlopBuilder::setMeshInstancedRects(const RectInstance* instances,
+        int instanceCount) {
+    TRIGGER_STAGE(kMeshStage);
+
+    mOutGlop->mesh.primitiveMode = GL_TRIANGLE_STRIP;
+    mOutGlop->mesh.indices = { 0, nullptr };
+    mOutGlop->mesh.vertices = {
+            mRenderState.meshState().getUnitQuadVBO(),
+            VertexAttribFlags::None,
+            nullptr, nullptr, nullptr,
+            kTextureVertexStride };
+    mOutGlop->mesh.elementCount = 4;
+    mOutGlop->mesh.instances = {
+            &instances[0].left, &instances[0].r,
+            kRectInstanceStride, instanceCount };
+    return *this;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Fill
 ////////////////////////////////////////////////////////////////////////////////
@@ -354,6 +390,17 @@ GlopBuilder& GlopBuilder::setFillTexturePaint(Texture& texture,
     return *this;
 }
 
+GlopBuilder& GlopBuilder::setFillDistanceField(float smoothing) {
+    REQUIRE_STAGES(kFillStage);
+    if (smoothing <= 0.0f) return *this;
+    LOG_ALWAYS_FATAL_IF(!mDescription.hasAlpha8Texture,
+            "distance fields must be alpha mask textures");
+
+    mOutGlop->fill.distanceFieldSmoothing = smoothing;
+    mDescription.isDistanceField = true;
+    return *this;
+}
+
 GlopBuilder& GlopBuilder::setFillPaint(const SkPaint& paint, float alphaScale) {
     TRIGGER_STAGE(kFillStage);
     REQUIRE_STAGES(kMeshStage | kRoundRectClipStage);
@@ -408,6 +455,21 @@ GlopBuilder& GlopBuilder::setFillShadowTexturePaint(ShadowTexture& texture, int
     return *this;
 }
 
+GlopBuilder& GlopBuilder::setFillInstanceColors(bool translucent) {
+    TRIGGER_STAGE(kFillStage);
+    REQUIRE_STAGES(kMeshStage | kRoundRectClipStage);
+
+    // The premultiplied colors of the instances are applied as is
+    mOutGlop->fill.texture = { nullptr, GL_INVALID_ENUM, GL_INVALID_ENUM, GL_INVALID_ENUM, nullptr };
+    setFill(SK_ColorWHITE, 1.0f, SkXfermode::kSrcOver_Mode, Blend::ModeOrderSwap::NoSwap,
+            nullptr, nullptr);
+    if (translucent && mOutGlop->blend.src == GL_ZERO) {
+        Blend::getFactors(SkXfermode::kSrcOver_Mode, Blend::ModeOrderSwap::NoSwap,
+                &mOutGlop->blend.src, &mOutGlop->blend.dst);
+    }
+    return *this;
+}
+
 GlopBuilder& GlopBuilder::setFillBlack() {
     TRIGGER_STAGE(kFillStage);
     REQUIRE_STAGES(kMeshStage | kRoundRectClipStage);
@@ -581,6 +643,11 @@ void verify(const ProgramDescription& description, const Glop& glop) {
     if (description.hasTextureTransform != (glop.fill.texture.textureTransform != nullptr)) {
         LOG_ALWAYS_FATAL("Texture transform incorrectly specified");
     }
+
+    if (glop.mesh.instances.count && (glop.mesh.vertices.attribFlags != VertexAttribFlags::None
+            || glop.mesh.indices.bufferObject || glop.mesh.indices.indices)) {
+        LOG_ALWAYS_FATAL("Instances can only be drawn from a non indexed position only mesh");
+    }
 }
 
 void GlopBuilder::build() {
@@ -593,7 +660,9 @@ void GlopBuilder::build() {
         }
     }
 
-    mDescription.hasColors = mOutGlop->mesh.vertices.attribFlags & VertexAttribFlags::Color;
+    mDescription.hasColors = (mOutGlop->mesh.vertices.attribFlags & VertexAttribFlags::Color)
+            || mOutGlop->mesh.instances.count;
+    mDescription.hasInstancedRects = mOutGlop->mesh.instances.count;
     mDescription.hasVertexAlpha = mOutGlop->mesh.vertices.attribFlags & VertexAttribFlags::Alpha;
 
     // Enable debug highlight when what we're about to draw is tested against
@@ -52,10 +52,12 @@ public:
     GlopBuilder& setMeshTexturedUvQuad(const UvMapper* uvMapper, const Rect uvs);
     GlopBuilder& setMeshVertexBuffer(const VertexBuffer& vertexBuffer, bool shadowInterp);
     GlopBuilder& setMeshIndexedQuads(Vertex* vertexData, int quadCount);
+    GlopBuilder& setMeshTriangles(const Vertex* vertexData, int vertexCount);
     GlopBuilder& setMeshTexturedMesh(TextureVertex* vertexData, int elementCount); // TODO: use indexed quads
     GlopBuilder& setMeshColoredTexturedMesh(ColorTextureVertex* vertexData, int elementCount); // TODO: use indexed quads
     GlopBuilder& setMeshTexturedIndexedQuads(TextureVertex* vertexData, int elementCount); // TODO: take quadCount
     GlopBuilder& setMeshPatchQuads(const Patch& patch);
+    GlopBuilder& setMeshInstancedRects(const RectInstance* instances, int instanceCount);
 
     GlopBuilder& setFillPaint(const SkPaint& paint, float alphaScale);
     GlopBuilder& setFillTexturePaint(Texture& texture, const int textureFillFlags,
@@ -64,11 +66,14 @@ public:
             const SkPaint& paint, float alphaScale);
     GlopBuilder& setFillShadowTexturePaint(ShadowTexture& texture, int shadowColor,
             const SkPaint& paint, float alphaScale);
+    GlopBuilder& setFillInstanceColors(bool translucent);
     GlopBuilder& setFillBlack();
     GlopBuilder& setFillClear();
     GlopBuilder& setFillLayer(Texture& texture, const SkColorFilter* colorFilter,
             float alpha, SkXfermode::Mode mode, Blend::ModeOrderSwap modeUsage);
     GlopBuilder& setFillTextureLayer(Layer& layer, float alpha);
+    // Follows setFillTexturePaint() with an alpha mask texture, a smoothing of 0 is ignored
+    GlopBuilder& setFillDistanceField(float smoothing);
 
     GlopBuilder& setTransform(const Snapshot& snapshot, const int transformFlags) {
         setTransform(snapshot.getOrthoMatrix(), *snapshot.transform, transformFlags);
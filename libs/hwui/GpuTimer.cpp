@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "GpuTimer.h"
+
+#include <GLES2/gl2ext.h>
+
+namespace android {
+namespace uirenderer {
+
+// The GPU shouldn't be more than a few frames behind, frames that would
+// exceed this many frames in flight simply aren't timed
+static const size_t kMaxPendingFrames = 5;
+
+void GpuTimer::beginFrame(FrameInfo* frame) {
+    if (mInFrame || mPendingFrames.size() >= kMaxPendingFrames) return;
+
+    mPendingFrames.emplace_back();
+    PendingFrame& pending = mPendingFrames.back();
+    pending.frame = frame;
+    pending.syncStart = frame->get(FrameInfoIndex::SyncStart);
+
+    mInFrame = true;
+    beginSegment(false);
+}
+
+void GpuTimer::endFrame() {
+    if (!mInFrame) return;
+    endSegment();
+    mInFrame = false;
+}
+
+void GpuTimer::beginLayers() {
+    if (!mInFrame || mPendingFrames.back().segments.back().layers) return;
+    endSegment();
+    beginSegment(true);
+}
+
+void GpuTimer::endLayers() {
+    if (!mInFrame || !mPendingFrames.back().segments.back().layers) return;
+    endSegment();
+    beginSegment(false);
+}
+
+void GpuTimer::beginSegment(bool layers) {
+    GLuint query;
+    if (mFreeQueries.empty()) {
+        glGenQueriesEXT(1, &query);
+    } else {
+        query = mFreeQueries.back();
+        mFreeQueries.pop_back();
+    }
+
+    mPendingFrames.back().segments.push_back({query, layers});
+    glBeginQueryEXT(GL_TIME_ELAPSED_EXT, query);
+    mInSegment = true;
+}
+
+void GpuTimer::endSegment() {
+    if (!mInSegment) return;
+    glEndQueryEXT(GL_TIME_ELAPSED_EXT);
+    mInSegment = false;
+}
+
+void GpuTimer::recycle(PendingFrame& frame) {
+    for (const Segment& segment : frame.segments) {
+        mFreeQueries.push_back(segment.query);
+    }
+    frame.segments.clear();
+}
+
+void GpuTimer::collect(std::vector<FrameInfo*>& outFrames) {
+    // The frame being recorded is never collected
+    size_t count = mPendingFrames.size() - (mInFrame ? 1 : 0);
+    if (count == 0) return;
+
+    // A disjoint operation (frequency change, context switch...) invalidates
+    // the results of all the queries in flight
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    size_t collected = 0;
+    for (; collected < count; collected++) {
+        PendingFrame& pending = mPendingFrames[collected];
+
+        if (!disjoint) {
+            GLuint available = GL_FALSE;
+            glGetQueryObjectuivEXT(pending.segments.back().query,
+                    GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+            // Queries complete in order, the following frames aren't ready either
+            if (!available) break;
+
+            int64_t total = 0;
+            int64_t layers = 0;
+            for (const Segment& segment : pending.segments) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64vEXT(segment.query, GL_QUERY_RESULT_EXT, &elapsed);
+                total += elapsed;
+                if (segment.layers) layers += elapsed;
+            }
+
+            FrameInfo* frame = pending.frame;
+            if (frame->get(FrameInfoIndex::SyncStart) == pending.syncStart) {
+                frame->set(FrameInfoIndex::GpuDuration) = total;
+                frame->set(FrameInfoIndex::GpuLayersDuration) = layers;
+                outFrames.push_back(frame);
+            }
+        }
+
+        recycle(pending);
+    }
+
+    mPendingFrames.erase(mPendingFrames.begin(), mPendingFrames.begin() + collected);
+}
+
+void GpuTimer::destroy() {
+    endFrame();
+    for (PendingFrame& pending : mPendingFrames) {
+        recycle(pending);
+    }
+    mPendingFrames.clear();
+
+    if (!mFreeQueries.empty()) {
+        glDeleteQueriesEXT(mFreeQueries.size(), &mFreeQueries[0]);
+        mFreeQueries.clear();
+    }
+}
+
+void GpuTimer::onGLContextDestroyed() {
+    mPendingFrames.clear();
+    mFreeQueries.clear();
+    mInFrame = false;
+    mInSegment = false;
+}
+
+} /* namespace uirenderer */
+} /* namespace android */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef GPUTIMER_H_
+#define GPUTIMER_H_
+
+#include "FrameInfo.h"
+#include "utils/Macros.h"
+
+#include <GLES2/gl2.h>
+
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+
+/**
+ * Measures the GPU time spent on frames with GL_EXT_disjoint_timer_query.
+ *
+ * The GPU time of the layer updates rendered by a frame is measured
+ * separately. Since time elapsed queries can't be nested, the frame's query
+ * is interrupted while layers render, so a frame is made of several segments.
+ *
+ * Query results become available a few frames later, collect() writes them
+ * to the FrameInfo of the frames they belong to.
+ */
+class GpuTimer {
+    PREVENT_COPY_AND_ASSIGN(GpuTimer);
+public:
+    GpuTimer() {}
+
+    void beginFrame(FrameInfo* frame);
+    void endFrame();
+
+    // Called around layer updates, no-ops outside of beginFrame()/endFrame()
+    void beginLayers();
+    void endLayers();
+
+    // Writes the GPU durations of the frames whose queries completed, and
+    // appends these frames to outFrames. The GL context must be current.
+    void collect(std::vector<FrameInfo*>& outFrames);
+
+    // Deletes all the queries. The GL context must be current.
+    void destroy();
+    // Forgets all the queries, they are destroyed along with the GL context
+    void onGLContextDestroyed();
+
+private:
+    struct Segment {
+        GLuint query;
+        bool layers;
+    };
+
+    struct PendingFrame {
+        FrameInfo* frame;
+        // Used to detect if the FrameInfo was reused for a newer frame
+        int64_t syncStart;
+        std::vector<Segment> segments;
+    };
+
+    void beginSegment(bool layers);
+    void endSegment();
+    void recycle(PendingFrame& frame);
+
+    std::vector<GLuint> mFreeQueries;
+    std::vector<PendingFrame> mPendingFrames;
+
+    bool mInFrame = false;
+    bool mInSegment = false;
+};
+
+} /* namespace uirenderer */
+} /* namespace android */
+
+#endif /* GPUTIMER_H_ */
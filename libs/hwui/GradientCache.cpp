@@ -63,9 +63,11 @@ int GradientCacheEntry::compare(const GradientCacheEntry& lhs, const GradientCac
 ///////////////////////////////////////////////////////////////////////////////
 
 GradientCache::GradientCache(Extensions& extensions)
-        : mCache(LruCache<GradientCacheEntry, Texture*>::kUnlimitedCapacity)
+        : mCache(FlatLruCache<GradientCacheEntry, Texture*>::kUnlimitedCapacity)
         , mSize(0)
         , mMaxSize(MB(DEFAULT_GRADIENT_CACHE_SIZE))
+        , mHitCount(0)
+        , mMissCount(0)
         , mUseFloatTexture(extensions.hasFloatTextures())
         , mHasNpot(extensions.hasNPot()){
     char property[PROPERTY_VALUE_MAX];
@@ -127,7 +129,10 @@ Texture* GradientCache::get(uint32_t* colors, float* positions, int count) {
     Texture* texture = mCache.get(gradient);
 
     if (!texture) {
+        mMissCount++;
         texture = addLinearGradient(gradient, colors, positions, count);
+    } else {
+        mHitCount++;
     }
 
     return texture;
@@ -17,13 +17,14 @@
 #ifndef ANDROID_HWUI_GRADIENT_CACHE_H
 #define ANDROID_HWUI_GRADIENT_CACHE_H
 
+#include "utils/FlatLruCache.h"
+
 #include <memory>
 
 #include <GLES3/gl3.h>
 
 #include <SkShader.h>
 
-#include <utils/LruCache.h>
 #include <utils/Mutex.h>
 #include <utils/Vector.h>
 
@@ -55,6 +56,25 @@ struct GradientCacheEntry {
         return *this;
     }
 
+    // FlatLruCache moves its keys around, don't copy the stops every time
+    GradientCacheEntry(GradientCacheEntry&& entry)
+            : colors(std::move(entry.colors))
+            , positions(std::move(entry.positions))
+            , count(entry.count) {
+        entry.count = 0;
+    }
+
+    GradientCacheEntry& operator=(GradientCacheEntry&& entry) {
+        if (this != &entry) {
+            colors = std::move(entry.colors);
+            positions = std::move(entry.positions);
+            count = entry.count;
+            entry.count = 0;
+        }
+
+        return *this;
+    }
+
     hash_t hash() const;
 
     static int compare(const GradientCacheEntry& lhs, const GradientCacheEntry& rhs);
@@ -135,6 +155,12 @@ public:
      * Returns the current size of the cache in bytes.
      */
     uint32_t getSize();
+    /**
+     * Returns the number of lookups that found, or missed, an entry since
+     * the cache was created.
+     */
+    uint32_t getHitCount() const { return mHitCount; }
+    uint32_t getMissCount() const { return mMissCount; }
 
 private:
     /**
@@ -174,10 +200,12 @@ private:
     void mixBytes(GradientColor& start, GradientColor& end, float amount, uint8_t*& dst) const;
     void mixFloats(GradientColor& start, GradientColor& end, float amount, uint8_t*& dst) const;
 
-    LruCache<GradientCacheEntry, Texture*> mCache;
+    FlatLruCache<GradientCacheEntry, Texture*> mCache;
 
     uint32_t mSize;
     uint32_t mMaxSize;
+    uint32_t mHitCount;
+    uint32_t mMissCount;
 
     GLint mMaxTextureSize;
     bool mUseFloatTexture;
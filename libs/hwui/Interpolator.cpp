@@ -24,14 +24,54 @@
 namespace android {
 namespace uirenderer {
 
+/**
+ * A smooth curve without parameters, sampled once per process and evaluated
+ * with a table lookup and a lerp instead of the transcendental math it is
+ * defined with. Only AccelerateDecelerateInterpolator, the default one, uses
+ * it. 256 samples keep the error well under 1e-4, and both endpoints are
+ * exact. Inputs outside [0, 1] fall back to the direct evaluation.
+ */
+class BakedCurve {
+public:
+    static const size_t kSize = 256;
+
+    explicit BakedCurve(float (*curve)(float))
+            : mCurve(curve) {
+        for (size_t i = 0; i < kSize; i++) {
+            mValues[i] = curve(i / (float) (kSize - 1));
+        }
+    }
+
+    float sample(float input) const {
+        if (!(input >= 0.0f && input <= 1.0f)) {
+            return mCurve(input);
+        }
+        float lutpos = input * (kSize - 1);
+        int i1 = (int) lutpos;
+        if (i1 >= (int) kSize - 1) {
+            return mValues[kSize - 1];
+        }
+        return MathUtils::lerp(mValues[i1], mValues[i1 + 1], lutpos - i1);
+    }
+
+private:
+    float (*mCurve)(float);
+    float mValues[kSize];
+};
+
 Interpolator* Interpolator::createDefaultInterpolator() {
     return new AccelerateDecelerateInterpolator();
 }
 
-float AccelerateDecelerateInterpolator::interpolate(float input) {
+static float accelerateDecelerate(float input) {
     return (float)(cosf((input + 1) * M_PI) / 2.0f) + 0.5f;
 }
 
+float AccelerateDecelerateInterpolator::interpolate(float input) {
+    static const BakedCurve sCurve(accelerateDecelerate);
+    return sCurve.sample(input);
+}
+
 float AccelerateInterpolator::interpolate(float input) {
     if (mFactor == 1.0f) {
         return input * input;
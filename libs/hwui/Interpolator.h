@@ -36,6 +36,12 @@ protected:
     Interpolator() {}
 };
 
+/**
+ * Evaluated from a table baked once per process, see BakedCurve. It is the
+ * only stock interpolator baked: the others either take a parameter, so would
+ * need a table per instance, or are piecewise (Bounce) and not smooth enough
+ * for a lerp across their segments. They are evaluated directly.
+ */
 class ANDROID_API AccelerateDecelerateInterpolator : public Interpolator {
 public:
     virtual float interpolate(float input) override;
@@ -199,11 +199,21 @@ void JankTracker::setFrameInterval(nsecs_t frameInterval) {
     mThresholds[kSlowUI] = static_cast<int64_t>(.5 * frameInterval);
     mThresholds[kSlowSync] = static_cast<int64_t>(.2 * frameInterval);
     mThresholds[kSlowRT] = static_cast<int64_t>(.75 * frameInterval);
+    mSlowGpuThreshold = static_cast<int64_t>(.75 * frameInterval);
 
 }
 
 void JankTracker::addFrame(const FrameInfo& frame) {
     mData->totalFrameCount++;
+    int64_t oldestInputEvent = frame[FrameInfoIndex::OldestInputEvent];
+    if (oldestInputEvent > 0) {
+        int64_t latency = frame[FrameInfoIndex::FrameCompleted] - oldestInputEvent;
+        if (latency >= 0 && latency < IGNORE_EXCEEDING) {
+            mInputLatencyCounts[frameCountIndexForFrameTime(
+                    latency, mInputLatencyCounts.size() - 1)]++;
+            mInputFrameCount++;
+        }
+    }
     // Fast-path for jank-free frames
     int64_t totalDuration =
             frame[FrameInfoIndex::FrameCompleted] - frame[FrameInfoIndex::IntendedVsync];
@@ -230,6 +240,20 @@ void JankTracker::addFrame(const FrameInfo& frame) {
     }
 }
 
+void JankTracker::addGpuTiming(const FrameInfo& frame) {
+    // Same criteria as addFrame(), only janky frames are of interest
+    int64_t totalDuration =
+            frame[FrameInfoIndex::FrameCompleted] - frame[FrameInfoIndex::IntendedVsync];
+    if (totalDuration < mFrameInterval || (frame[FrameInfoIndex::Flags] & EXEMPT_FRAMES_FLAGS)) {
+        return;
+    }
+
+    int64_t gpuDuration = frame[FrameInfoIndex::GpuDuration];
+    if (gpuDuration >= mSlowGpuThreshold && gpuDuration < IGNORE_EXCEEDING) {
+        mSlowGpuFrameCount++;
+    }
+}
+
 void JankTracker::dumpBuffer(const void* buffer, size_t bufsize, int fd) {
     if (bufsize < sizeof(ProfileData)) {
         return;
@@ -252,7 +276,20 @@ void JankTracker::dumpData(const ProfileData* data, int fd) {
     dprintf(fd, "\n");
 }
 
+void JankTracker::dump(int fd) {
+    dumpData(mData, fd);
+    dprintf(fd, "Frames with input: %u", mInputFrameCount);
+    dprintf(fd, "\nInput latency 50th percentile: %ums", findInputLatencyPercentile(50));
+    dprintf(fd, "\nInput latency 90th percentile: %ums", findInputLatencyPercentile(90));
+    dprintf(fd, "\nInput latency 99th percentile: %ums", findInputLatencyPercentile(99));
+    dprintf(fd, "\nNumber Slow GPU: %u", mSlowGpuFrameCount);
+    dprintf(fd, "\n");
+}
+
 void JankTracker::reset() {
+    mInputLatencyCounts.fill(0);
+    mInputFrameCount = 0;
+    mSlowGpuFrameCount = 0;
     mData->jankTypeCounts.fill(0);
     mData->frameCounts.fill(0);
     mData->totalFrameCount = 0;
@@ -260,6 +297,18 @@ void JankTracker::reset() {
     mData->statStartTime = systemTime(CLOCK_MONOTONIC);
 }
 
+uint32_t JankTracker::findInputLatencyPercentile(int percentile) {
+    int pos = percentile * mInputFrameCount / 100;
+    int remaining = mInputFrameCount - pos;
+    for (int i = mInputLatencyCounts.size() - 1; i >= 0; i--) {
+        remaining -= mInputLatencyCounts[i];
+        if (remaining <= 0) {
+            return frameTimeForFrameCountIndex(i);
+        }
+    }
+    return 0;
+}
+
 uint32_t JankTracker::findPercentile(const ProfileData* data, int percentile) {
     int pos = percentile * data->totalFrameCount / 100;
     int remaining = data->totalFrameCount - pos;
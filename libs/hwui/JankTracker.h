@@ -39,12 +39,17 @@ enum JankType {
     NUM_BUCKETS,
 };
 
+// The number of frame time buckets: bucket 0 holds frames up to 7ms, then
+// the buckets grow from 1ms to 4ms wide (see the kBucket* constants), and
+// the last one holds everything longer. Part of the size of ProfileData.
+static const size_t kFrameCountBuckets = 55;
+
 // Try to keep as small as possible, should match ASHMEM_SIZE in
 // GraphicsStatsService.java
 struct ProfileData {
     std::array<uint32_t, NUM_BUCKETS> jankTypeCounts;
     // See comments on kBucket* constants for what this holds
-    std::array<uint32_t, 55> frameCounts;
+    std::array<uint32_t, kFrameCountBuckets> frameCounts;
 
     uint32_t totalFrameCount;
     uint32_t jankFrameCount;
@@ -58,13 +63,17 @@ public:
     ~JankTracker();
 
     void addFrame(const FrameInfo& frame);
+    // GPU durations are only known a few frames after the frame was added
+    void addGpuTiming(const FrameInfo& frame);
 
-    void dump(int fd) { dumpData(mData, fd); }
+    void dump(int fd);
     void reset();
 
     void switchStorageToAshmem(int ashmemfd);
 
     uint32_t findPercentile(int p) { return findPercentile(mData, p); }
+    // Latency from the oldest input event of a frame until the frame completed
+    uint32_t findInputLatencyPercentile(int p);
 
     ANDROID_API static void dumpBuffer(const void* buffer, size_t bufsize, int fd);
 
@@ -77,6 +86,15 @@ private:
 
     std::array<int64_t, NUM_BUCKETS> mThresholds;
     int64_t mFrameInterval;
+    // Bucketed like ProfileData::frameCounts, but not part of it as
+    // GraphicsStatsService doesn't know about it
+    decltype(ProfileData::frameCounts) mInputLatencyCounts;
+    uint32_t mInputFrameCount;
+    // Janky frames with a slow GPU, only counted with PROPERTY_GPU_FRAME_TIMING.
+    // Not part of ProfileData either, it would change the size of the ashmem
+    // region GraphicsStatsService allocates
+    int64_t mSlowGpuThreshold;
+    uint32_t mSlowGpuFrameCount;
     ProfileData* mData;
     bool mIsMapped = false;
 };
@@ -22,6 +22,7 @@
 #include "DeferredDisplayList.h"
 #include "LayerRenderer.h"
 #include "OpenGLRenderer.h"
+#include "Properties.h"
 #include "RenderNode.h"
 #include "renderstate/RenderState.h"
 #include "utils/TraceUtils.h"
@@ -225,6 +226,7 @@ void Layer::defer(const OpenGLRenderer& rootRenderer) {
     ATRACE_LAYER_WORK("Optimize");
 
     updateLightPosFromRenderer(rootRenderer);
+    renderer->setOpProfiler(rootRenderer.opProfiler());
     const float width = layer.getWidth();
     const float height = layer.getHeight();
 
@@ -234,6 +236,9 @@ void Layer::defer(const OpenGLRenderer& rootRenderer) {
     }
 
     deferredList.reset(new DeferredDisplayList(dirtyRect));
+    if (CC_UNLIKELY(Properties::asyncDrawBatching)) {
+        deferredList->beginAsyncBatching(caches.tasks);
+    }
 
     DeferStateStruct deferredState(*deferredList, *renderer,
             RenderNode::kReplayFlag_ClipChildren);
@@ -244,6 +249,7 @@ void Layer::defer(const OpenGLRenderer& rootRenderer) {
 
     renderNode->computeOrdering();
     renderNode->defer(deferredState, 0);
+    deferredList->endAsyncBatching();
 
     deferredUpdateScheduled = false;
 }
@@ -279,6 +285,7 @@ void Layer::render(const OpenGLRenderer& rootRenderer) {
     ATRACE_LAYER_WORK("Direct-Issue");
 
     updateLightPosFromRenderer(rootRenderer);
+    renderer->setOpProfiler(rootRenderer.opProfiler());
     renderer->setViewport(layer.getWidth(), layer.getHeight());
     renderer->prepareDirty(dirtyRect.left, dirtyRect.top, dirtyRect.right, dirtyRect.bottom,
             !isBlend());
@@ -96,11 +96,35 @@ void LayerCache::clear() {
     mCache.clear();
 }
 
+ssize_t LayerCache::findLayer(const LayerEntry& entry) const {
+    ssize_t index = mCache.indexOf(entry);
+    if (index >= 0) return index;
+
+    // Layers resized by an animation rarely ask for the same size twice, so
+    // fall back to the smallest cached layer that covers the request without
+    // wasting too much of it. Entries are sorted by width, then height
+    const uint32_t maxArea = entry.mWidth * entry.mHeight * LAYER_CACHE_MAX_AREA_RATIO;
+    uint32_t bestArea = maxArea + 1;
+    size_t count = mCache.size();
+    for (size_t i = 0; i < count; i++) {
+        const LayerEntry& candidate = mCache.itemAt(i);
+        if (candidate.mWidth * entry.mHeight > maxArea) break;
+        if (candidate.mWidth < entry.mWidth || candidate.mHeight < entry.mHeight) continue;
+
+        const uint32_t area = candidate.mWidth * candidate.mHeight;
+        if (area < bestArea) {
+            bestArea = area;
+            index = i;
+        }
+    }
+    return index;
+}
+
 Layer* LayerCache::get(RenderState& renderState, const uint32_t width, const uint32_t height) {
     Layer* layer = nullptr;
 
     LayerEntry entry(width, height);
-    ssize_t index = mCache.indexOf(entry);
+    ssize_t index = findLayer(entry);
 
     if (index >= 0) {
         entry = mCache.itemAt(index);
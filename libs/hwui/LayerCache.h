@@ -36,6 +36,10 @@ class RenderState;
     #define LAYER_LOGD(...)
 #endif
 
+// A cached layer larger than the requested size is reused as long as its
+// area is at most this many times the area of the request
+#define LAYER_CACHE_MAX_AREA_RATIO 2
+
 ///////////////////////////////////////////////////////////////////////////////
 // Cache
 ///////////////////////////////////////////////////////////////////////////////
@@ -132,6 +136,7 @@ private:
     }; // struct LayerEntry
 
     void deleteLayer(Layer* layer);
+    ssize_t findLayer(const LayerEntry& entry) const;
 
     SortedList<LayerEntry> mCache;
 
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "OpProfiler.h"
+
+#include "RenderNode.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+namespace android {
+namespace uirenderer {
+
+// Nodes whose subtree took less than this fraction of the frame are folded
+// into their parent when dumped
+static const float kMinDumpedNodeFraction = 0.01f;
+// Maximum number of op types dumped
+static const size_t kMaxDumpedOps = 20;
+
+bool OpProfiler::beginFrame() {
+    mSampling = (mFrameCount++ % kSampleInterval) == 0;
+    if (mSampling) {
+        mSampledFrameCount++;
+        mNodes.clear();
+        mNodeStack.clear();
+    }
+    return mSampling;
+}
+
+void OpProfiler::endFrame() {
+    mSampling = false;
+    mNodeStack.clear();
+}
+
+void OpProfiler::pushNode(const RenderNode* node) {
+    NodeStats stats;
+    stats.name = node->getName();
+    stats.parent = currentNode();
+    stats.depth = mNodeStack.size();
+    stats.opCount = 0;
+    stats.selfDuration = 0;
+
+    mNodeStack.push_back(mNodes.size());
+    mNodes.push_back(stats);
+}
+
+void OpProfiler::popNode() {
+    if (!mNodeStack.empty()) mNodeStack.pop_back();
+}
+
+void OpProfiler::addOp(const char* name, int node, nsecs_t duration) {
+    OpStats& stats = mOpStats[name];
+    stats.count++;
+    stats.duration += duration;
+
+    if (node >= 0 && node < static_cast<int>(mNodes.size())) {
+        mNodes[node].opCount++;
+        mNodes[node].selfDuration += duration;
+    }
+}
+
+void OpProfiler::dump(int fd) const {
+    if (!mSampledFrameCount) return;
+
+    dprintf(fd, "\nDraw op profile, %d sampled frames (1 in %d):\n",
+            mSampledFrameCount, kSampleInterval);
+
+    // The same name may be reported through different pointers
+    std::map<std::string, OpStats> opStats;
+    for (auto& entry : mOpStats) {
+        OpStats& stats = opStats[entry.first];
+        stats.count += entry.second.count;
+        stats.duration += entry.second.duration;
+    }
+    std::vector<std::pair<std::string, OpStats>> ops(opStats.begin(), opStats.end());
+    std::sort(ops.begin(), ops.end(),
+            [](const std::pair<std::string, OpStats>& lhs,
+                    const std::pair<std::string, OpStats>& rhs) {
+                return lhs.second.duration > rhs.second.duration;
+            });
+
+    dprintf(fd, "  %-24s %10s %12s %10s\n", "Op", "Count", "Total (ms)", "Avg (us)");
+    for (size_t i = 0; i < ops.size() && i < kMaxDumpedOps; i++) {
+        const OpStats& stats = ops[i].second;
+        dprintf(fd, "  %-24s %10d %12.3f %10.2f\n", ops[i].first.c_str(), stats.count,
+                stats.duration / 1000000.0, stats.duration / 1000.0 / stats.count);
+    }
+
+    if (mNodes.empty()) return;
+
+    // Children are always recorded after their parent
+    std::vector<nsecs_t> subtree(mNodes.size());
+    nsecs_t frameDuration = 0;
+    for (size_t i = 0; i < mNodes.size(); i++) {
+        subtree[i] = mNodes[i].selfDuration;
+    }
+    for (int i = mNodes.size() - 1; i >= 0; i--) {
+        if (mNodes[i].parent != kNoNode) {
+            subtree[mNodes[i].parent] += subtree[i];
+        } else {
+            frameDuration += subtree[i];
+        }
+    }
+
+    dprintf(fd, "\nLast sampled frame by RenderNode, %.3fms total:\n",
+            frameDuration / 1000000.0);
+    dprintf(fd, "  %10s %10s %6s  %s\n", "Tree (ms)", "Self (ms)", "Ops", "Node");
+    const nsecs_t minDuration = frameDuration * kMinDumpedNodeFraction;
+    for (size_t i = 0; i < mNodes.size(); i++) {
+        const NodeStats& node = mNodes[i];
+        // A subtree never takes longer than its parent's, so the ancestors
+        // of a dumped node are always dumped as well
+        if (subtree[i] < minDuration) continue;
+
+        dprintf(fd, "  %10.3f %10.3f %6d  %*s%s\n", subtree[i] / 1000000.0,
+                node.selfDuration / 1000000.0, node.opCount, node.depth * 2, "",
+                node.name.c_str());
+    }
+}
+
+void OpProfiler::reset() {
+    mFrameCount = 0;
+    mSampledFrameCount = 0;
+    mSampling = false;
+    mOpStats.clear();
+    mNodes.clear();
+    mNodeStack.clear();
+}
+
+} /* namespace uirenderer */
+} /* namespace android */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef OPPROFILER_H_
+#define OPPROFILER_H_
+
+#include "utils/Macros.h"
+
+#include <cutils/compiler.h>
+#include <utils/Timers.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+
+class RenderNode;
+
+/**
+ * Attributes the CPU time spent issuing draw ops to op types and RenderNodes.
+ *
+ * Only one frame out of every kSampleInterval is profiled, see
+ * PROPERTY_OP_PROFILING. Op type costs are accumulated over all the sampled
+ * frames, the per RenderNode breakdown only covers the last sampled frame.
+ */
+class OpProfiler {
+    PREVENT_COPY_AND_ASSIGN(OpProfiler);
+public:
+    static const int kSampleInterval = 16;
+    static const int kNoNode = -1;
+
+    OpProfiler() {}
+
+    // Returns true if the frame that is starting has been sampled
+    bool beginFrame();
+    void endFrame();
+
+    // Brackets the ops issued by a RenderNode, including its children
+    void pushNode(const RenderNode* node);
+    void popNode();
+    int currentNode() const {
+        return mNodeStack.empty() ? kNoNode : mNodeStack.back();
+    }
+
+    // Called as draw ops are applied, node is the value of currentNode()
+    // when the op was issued
+    void addOp(const char* name, int node, nsecs_t duration);
+
+    void dump(int fd) const;
+    void reset();
+
+private:
+    struct OpStats {
+        int count = 0;
+        nsecs_t duration = 0;
+    };
+
+    struct NodeStats {
+        std::string name;
+        int parent;
+        int depth;
+        int opCount;
+        nsecs_t selfDuration;
+    };
+
+    int mFrameCount = 0;
+    int mSampledFrameCount = 0;
+    bool mSampling = false;
+
+    // Keyed by DisplayListOp::name(), merged by string when dumped
+    std::unordered_map<const char*, OpStats> mOpStats;
+
+    std::vector<NodeStats> mNodes;
+    std::vector<int> mNodeStack;
+};
+
+/**
+ * Times the draw ops applied in its scope, if the profiler is set
+ */
+class AutoOpProfile {
+public:
+    AutoOpProfile(OpProfiler* profiler, const char* name, int node)
+            : mProfiler(profiler), mName(name), mNode(node) {
+        if (CC_UNLIKELY(mProfiler)) mStart = systemTime(CLOCK_MONOTONIC);
+    }
+
+    ~AutoOpProfile() {
+        if (CC_UNLIKELY(mProfiler)) {
+            mProfiler->addOp(mName, mNode, systemTime(CLOCK_MONOTONIC) - mStart);
+        }
+    }
+
+private:
+    OpProfiler* mProfiler;
+    const char* mName;
+    int mNode;
+    nsecs_t mStart = 0;
+};
+
+} /* namespace uirenderer */
+} /* namespace android */
+
+#endif /* OPPROFILER_H_ */
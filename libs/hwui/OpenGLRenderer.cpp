@@ -20,6 +20,7 @@
 #include "GammaFontRenderer.h"
 #include "Glop.h"
 #include "GlopBuilder.h"
+#include "GpuTimer.h"
 #include "Patch.h"
 #include "PathTessellator.h"
 #include "Properties.h"
@@ -413,6 +414,7 @@ void OpenGLRenderer::updateLayers() {
     if (count > 0) {
         if (CC_UNLIKELY(Properties::drawDeferDisabled)) {
             startMark("Layer Updates");
+            if (mGpuTimer) mGpuTimer->beginLayers();
         } else {
             startMark("Defer Layer Updates");
         }
@@ -426,6 +428,7 @@ void OpenGLRenderer::updateLayers() {
         if (CC_UNLIKELY(Properties::drawDeferDisabled)) {
             mLayerUpdates.clear();
             mRenderState.bindFramebuffer(getTargetFbo());
+            if (mGpuTimer) mGpuTimer->endLayers();
         }
         endMark();
     }
@@ -435,6 +438,7 @@ void OpenGLRenderer::flushLayers() {
     int count = mLayerUpdates.size();
     if (count > 0) {
         startMark("Apply Layer Updates");
+        if (mGpuTimer) mGpuTimer->beginLayers();
 
         // Note: it is very important to update the layers in order
         for (int i = 0; i < count; i++) {
@@ -443,6 +447,7 @@ void OpenGLRenderer::flushLayers() {
 
         mLayerUpdates.clear();
         mRenderState.bindFramebuffer(getTargetFbo());
+        if (mGpuTimer) mGpuTimer->endLayers();
 
         endMark();
     }
@@ -474,13 +479,21 @@ void OpenGLRenderer::cancelLayerUpdate(Layer* layer) {
     }
 }
 
+void OpenGLRenderer::deferLayerUpdate(Layer* layer) {
+    // Only the frame's renderer flushes its layer updates ahead of its own
+    // drawing, layers drawn into other layers are still updated when drawn
+    if (hasLayer() || CC_UNLIKELY(Properties::drawDeferDisabled)) return;
+
+    if (updateLayer(layer, false)) {
+        pushLayerUpdate(layer);
+    }
+}
+
 void OpenGLRenderer::flushLayerUpdates() {
     ATRACE_NAME("Update HW Layers");
     mRenderState.blend().syncEnabled();
     updateLayers();
     flushLayers();
-    // Wait for all the layer updates to be executed
-    glFinish();
 }
 
 void OpenGLRenderer::markLayersAsBuildLayers() {
@@ -1501,9 +1514,15 @@ void OpenGLRenderer::drawRenderNode(RenderNode* renderNode, Rect& dirty, int32_t
         // debug where it's coming from, and when the problem occurs.
         bool avoidOverdraw = !Properties::debugOverdraw;
         DeferredDisplayList deferredList(mState.currentClipRect(), avoidOverdraw);
+        if (CC_UNLIKELY(Properties::asyncDrawBatching)) {
+            deferredList.beginAsyncBatching(mCaches.tasks);
+        }
         DeferStateStruct deferStruct(deferredList, *this, replayFlags);
         renderNode->defer(deferStruct, 0);
+        deferredList.endAsyncBatching();
 
+        // with async batching, the layer updates are issued while the worker is still batching
+        // the ops deferred above
         flushLayers();
         startFrame();
 
@@ -1784,6 +1803,61 @@ void OpenGLRenderer::drawConvexPath(const SkPath& path, const SkPaint* paint) {
     drawVertexBuffer(vertexBuffer, paint);
 }
 
+bool OpenGLRenderer::drawPathWithStencil(const SkPath& path, const SkPaint* paint) {
+    // The stencil buffer already holds complex clips, and overdraw debugging
+    // counts into it
+    if (!PathCache::canDrawWithStencil(&path, paint)
+            || Properties::debugOverdraw
+            || !currentSnapshot()->clipIsSimple()) {
+        return false;
+    }
+
+    Vector<Vertex> vertices;
+    PathTessellator::tessellatePathFans(path, *currentTransform(), vertices);
+    if (vertices.isEmpty()) return true;
+
+    const Rect bounds(path.getBounds());
+    if (quickRejectSetupScissor(bounds, paint)) return true;
+
+    // Layer clears and clip updates draw with the stencil state of their own,
+    // resolve them before taking it over
+    clearLayerRegions();
+    if (mState.getDirtyClip()) {
+        if (mRenderState.scissor().isEnabled()) {
+            setScissorFromClip();
+        }
+        setStencilFromClip();
+        mState.setDirtyClip(false);
+    }
+    ensureStencilBuffer();
+
+    Stencil& stencil = mRenderState.stencil();
+    SkPaint black;
+    black.setColor(SK_ColorBLACK);
+    black.setXfermodeMode(SkXfermode::kSrc_Mode);
+
+    stencil.enablePathClear();
+    drawColorRect(bounds.left, bounds.top, bounds.right, bounds.bottom, &black);
+
+    const SkPath::FillType fillType = path.getFillType();
+    stencil.enablePathWrite(fillType == SkPath::kEvenOdd_FillType);
+    Glop glop;
+    GlopBuilder(mRenderState, mCaches, &glop)
+            .setRoundRectClipState(currentSnapshot()->roundRectClipState)
+            .setMeshTriangles(vertices.array(), vertices.size())
+            .setFillBlack()
+            .setTransform(*currentSnapshot(), TransformFlags::None)
+            .setModelViewOffsetRect(0, 0, bounds)
+            .build();
+    renderGlop(glop);
+
+    stencil.enablePathCover();
+    drawColorRect(bounds.left, bounds.top, bounds.right, bounds.bottom, paint);
+
+    stencil.disable();
+    return true;
+}
+
 /**
  * We create tristrips for the lines much like shape stroke tessellation, using a per-vertex alpha
  * and additional geometry for defining an alpha slope perimeter.
@@ -2252,12 +2326,19 @@ void OpenGLRenderer::drawText(const char* text, int bytesCount, int count, float
     // Applying the full matrix in the shader is the easiest way to handle
     // rotation and perspective and allows us to always generated quads in the
     // font renderer which greatly simplifies the code, clipping in particular.
-    SkMatrix fontTransform;
-    bool linearFilter = findBestFontTransform(transform, &fontTransform)
-            || fabs(y - (int) y) > 0.0f
-            || fabs(x - (int) x) > 0.0f;
-    fontRenderer.setFont(paint, fontTransform);
-    fontRenderer.setTextureFiltering(linearFilter);
+    // Distance field fonts skip the partial matrix: their glyphs are rasterized
+    // once, at a fixed size, and the mesh is scaled to the text size.
+    if (CC_UNLIKELY(FontRenderer::canUseDistanceField(paint, transform))) {
+        fontRenderer.setDistanceFieldFont(paint, transform);
+        fontRenderer.setTextureFiltering(true);
+    } else {
+        SkMatrix fontTransform;
+        bool linearFilter = findBestFontTransform(transform, &fontTransform)
+                || fabs(y - (int) y) > 0.0f
+                || fabs(x - (int) x) > 0.0f;
+        fontRenderer.setFont(paint, fontTransform);
+        fontRenderer.setTextureFiltering(linearFilter);
+    }
 
     // TODO: Implement better clipping for scaled/rotated text
     const Rect* clip = !pureTranslate ? nullptr : &mState.currentClipRect();
@@ -2321,6 +2402,11 @@ void OpenGLRenderer::drawTextOnPath(const char* text, int bytesCount, int count,
 void OpenGLRenderer::drawPath(const SkPath* path, const SkPaint* paint) {
     if (mState.currentlyIgnored()) return;
 
+    if (drawPathWithStencil(*path, paint)) {
+        mDirty = true;
+        return;
+    }
+
     mCaches.textureState().activateTexture(0);
 
     PathTexture* texture = mCaches.pathCache.get(path, paint);
@@ -2500,6 +2586,23 @@ void OpenGLRenderer::drawRects(const float* rects, int count, const SkPaint* pai
     drawColorRects(rects, count, paint, false, true, true);
 }
 
+void OpenGLRenderer::drawRectInstances(const RectInstance* instances, int count,
+        bool translucent, const Rect& bounds) {
+    // The instance bounds are already in layer space
+    const int transformFlags = TransformFlags::MeshIgnoresCanvasTransform;
+    Glop glop;
+    GlopBuilder(mRenderState, mCaches, &glop)
+            .setRoundRectClipState(currentSnapshot()->roundRectClipState)
+            .setMeshInstancedRects(instances, count)
+            .setFillInstanceColors(translucent)
+            .setTransform(*currentSnapshot(), transformFlags)
+            .setModelViewOffsetRect(0, 0, bounds)
+            .build();
+    renderGlop(glop, GlopRenderType::Multi);
+
+    mDirty = true;
+}
+
 void OpenGLRenderer::drawShadow(float casterAlpha,
         const VertexBuffer* ambientShadowVertexBuffer, const VertexBuffer* spotShadowVertexBuffer) {
     if (mState.currentlyIgnored()) return;
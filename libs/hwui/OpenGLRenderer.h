@@ -63,6 +63,8 @@ enum class DrawOpMode {
 
 class DeferredDisplayState;
 struct Glop;
+class GpuTimer;
+class OpProfiler;
 class RenderState;
 class RenderNode;
 class TextDrawFunctor;
@@ -169,9 +171,22 @@ public:
 
     void pushLayerUpdate(Layer* layer);
     void cancelLayerUpdate(Layer* layer);
+    /**
+     * Defers the pending update of a layer met while deferring the frame so
+     * that it is issued with the other layer updates, before the frame's
+     * framebuffer is bound, instead of in the middle of the frame.
+     */
+    void deferLayerUpdate(Layer* layer);
     void flushLayerUpdates();
     void markLayersAsBuildLayers();
 
+    // When set, the GPU time of layer updates is measured separately
+    void setGpuTimer(GpuTimer* gpuTimer) { mGpuTimer = gpuTimer; }
+
+    // Set while the frame being drawn is sampled by the draw op profiler
+    void setOpProfiler(OpProfiler* opProfiler) { mOpProfiler = opProfiler; }
+    OpProfiler* opProfiler() const { return mOpProfiler; }
+
     virtual int saveLayer(float left, float top, float right, float bottom,
             const SkPaint* paint, int flags) {
         return saveLayer(left, top, right, bottom, paint, flags, nullptr);
@@ -219,6 +234,8 @@ public:
             const float* positions, const SkPaint* paint, float totalAdvance, const Rect& bounds,
             DrawOpMode drawOpMode = DrawOpMode::kImmediate);
     void drawRects(const float* rects, int count, const SkPaint* paint);
+    void drawRectInstances(const RectInstance* instances, int count, bool translucent,
+            const Rect& bounds);
 
     void drawShadow(float casterAlpha,
             const VertexBuffer* ambientShadowVertexBuffer,
@@ -736,6 +753,17 @@ private:
      */
     void drawConvexPath(const SkPath& path, const SkPaint* paint);
 
+    /**
+     * Fills the specified path with the stencil buffer: the triangle fans of its
+     * contours are accumulated in the stencil, then the path bounds are covered
+     * with the paint where the stencil is set. Returns false if the path must be
+     * drawn with a texture from the PathCache instead.
+     *
+     * @param path The path to fill
+     * @param paint The paint to render with
+     */
+    bool drawPathWithStencil(const SkPath& path, const SkPaint* paint);
+
     /**
      * Draws text underline and strike-through if needed.
      *
@@ -857,6 +885,9 @@ private:
     // List of layers to update at the beginning of a frame
     Vector< sp<Layer> > mLayerUpdates;
 
+    GpuTimer* mGpuTimer = nullptr;
+    OpProfiler* mOpProfiler = nullptr;
+
     // See PROPERTY_DISABLE_SCISSOR_OPTIMIZATION in
     // Properties.h
     bool mScissorOptimizationDisabled;
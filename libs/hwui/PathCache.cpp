@@ -29,6 +29,7 @@
 
 #include "Caches.h"
 #include "PathCache.h"
+#include "Properties.h"
 
 #include "thread/Signal.h"
 #include "thread/TaskProcessor.h"
@@ -83,6 +84,19 @@ bool PathCache::canDrawAsConvexPath(SkPath* path, const SkPaint* paint) {
     return paint->getPathEffect() == nullptr && path->getConvexity() == SkPath::kConvex_Convexity;
 }
 
+bool PathCache::canDrawWithStencil(const SkPath* path, const SkPaint* paint) {
+    // The stencil fill has aliased edges and knows nothing of strokes, effects
+    // or inverse fills. Past a few hundred points the fans of the contours cost
+    // more overdraw than a cached texture would.
+    return Properties::stencilPaths
+            && paint->getStyle() == SkPaint::kFill_Style
+            && !paint->isAntiAlias()
+            && paint->getPathEffect() == nullptr
+            && paint->getMaskFilter() == nullptr
+            && !path->isInverseFillType()
+            && path->countPoints() <= STENCIL_PATH_MAX_POINTS;
+}
+
 void PathCache::computePathBounds(const SkPath* path, const SkPaint* paint,
         float& left, float& top, float& offset, uint32_t& width, uint32_t& height) {
     const SkRect& bounds = path->getBounds();
@@ -137,7 +151,7 @@ static void drawPath(const SkPath *path, const SkPaint* paint, SkBitmap& bitmap,
 ///////////////////////////////////////////////////////////////////////////////
 
 PathCache::PathCache():
-        mCache(LruCache<PathDescription, PathTexture*>::kUnlimitedCapacity),
+        mCache(FlatLruCache<PathDescription, PathTexture*>::kUnlimitedCapacity),
         mSize(0), mMaxSize(MB(DEFAULT_PATH_CACHE_SIZE)) {
     char property[PROPERTY_VALUE_MAX];
     if (property_get(PROPERTY_PATH_CACHE_SIZE, property, nullptr) > 0) {
@@ -353,7 +367,7 @@ void PathCache::clearGarbage() {
         for (size_t i = 0; i < count; i++) {
             const uint32_t generationID = mGarbage.itemAt(i);
 
-            LruCache<PathDescription, PathTexture*>::Iterator iter(mCache);
+            FlatLruCache<PathDescription, PathTexture*>::Iterator iter(mCache);
             while (iter.next()) {
                 const PathDescription& key = iter.key();
                 if (key.type == kShapePath && key.shape.path.mGenerationID == generationID) {
@@ -21,12 +21,12 @@
 #include "Texture.h"
 #include "thread/Task.h"
 #include "thread/TaskProcessor.h"
+#include "utils/FlatLruCache.h"
 #include "utils/Macros.h"
 #include "utils/Pair.h"
 
 #include <GLES2/gl2.h>
 #include <SkPath.h>
-#include <utils/LruCache.h>
 #include <utils/Mutex.h>
 #include <utils/Vector.h>
 
@@ -51,6 +51,9 @@ class Caches;
     #define PATH_LOGD(...)
 #endif
 
+// Paths with more points than this are never filled with the stencil buffer
+#define STENCIL_PATH_MAX_POINTS 256
+
 ///////////////////////////////////////////////////////////////////////////////
 // Classes
 ///////////////////////////////////////////////////////////////////////////////
@@ -229,6 +232,11 @@ public:
     void precache(const SkPath* path, const SkPaint* paint);
 
     static bool canDrawAsConvexPath(SkPath* path, const SkPaint* paint);
+    /**
+     * Returns true if the path should be filled with the stencil buffer
+     * rather than with a texture from this cache, see PROPERTY_STENCIL_PATHS.
+     */
+    static bool canDrawWithStencil(const SkPath* path, const SkPaint* paint);
     static void computePathBounds(const SkPath* path, const SkPaint* paint,
             float& left, float& top, float& offset, uint32_t& width, uint32_t& height);
     static void computeBounds(const SkRect& bounds, const SkPaint* paint,
@@ -298,7 +306,7 @@ private:
         uint32_t mMaxTextureSize;
     };
 
-    LruCache<PathDescription, PathTexture*> mCache;
+    FlatLruCache<PathDescription, PathTexture*> mCache;
     uint32_t mSize;
     uint32_t mMaxSize;
     GLuint mMaxTextureSize;
@@ -51,8 +51,11 @@
 #include "Matrix.h"
 #include "Vector.h"
 #include "Vertex.h"
+#include "utils/Float4.h"
 #include "utils/MathUtils.h"
 
+#include <vector>
+
 namespace android {
 namespace uirenderer {
 
@@ -93,6 +96,65 @@ inline static Vector2 totalOffsetFromNormals(const Vector2& normalA, const Vecto
     return (normalA + normalB) / (1 + fabs(normalA.dot(normalB)));
 }
 
+/**
+ * Computes totalOffsetFromNormals() for each vertex, from the normals of the edges on both sides
+ * of it. For unclosed vertices, the first and last vertices don't get an offset, their caps only
+ * depend on the normal of a single edge.
+ *
+ * Every vertex only depends on its neighbours, so the normalizations and divisions, which
+ * dominate the cost of tessellating the outline, are done 4 vertices at a time when possible.
+ *
+ * The offset of vertex i is written to offsets[i], offsets is resized to vertices.size() + 1.
+ */
+static void computeVertexOffsets(const Vector<Vertex>& vertices, bool closed,
+        std::vector<Vector2>& offsets) {
+    const int count = vertices.size();
+    const int edgeCount = closed ? count : count - 1;
+    offsets.resize(count + 1);
+
+    // First store the normal of the edge from vertex i to vertex i + 1 in offsets[i + 1]
+    int i = 0;
+#ifdef HAS_FLOAT4
+    for (; i + 4 < count; i += 4) {
+        Float4 x, y, nextX, nextY;
+        Float4::loadXY(&vertices[i].x, x, y);
+        Float4::loadXY(&vertices[i + 1].x, nextX, nextY);
+        Float4 normalX = nextY - y;
+        Float4 normalY = x - nextX;
+        Float4 scale = Float4::inverseSqrt(normalX * normalX + normalY * normalY);
+        Float4::storeXY(&offsets[i + 1].x, normalX * scale, normalY * scale);
+    }
+#endif
+    for (; i < edgeCount; i++) {
+        const Vertex& current = vertices[i];
+        const Vertex& next = vertices[i + 1 < count ? i + 1 : 0];
+        Vector2 normal = {next.y - current.y, current.x - next.x};
+        normal.normalize();
+        offsets[i + 1] = normal;
+    }
+    if (closed) {
+        offsets[0] = offsets[count];
+    }
+
+    // Then combine the normals in place, the offset of a vertex only overwrites the normal of the
+    // edge before it, once it has been read
+    i = closed ? 0 : 1;
+    const int end = closed ? count : count - 1;
+#ifdef HAS_FLOAT4
+    const Float4 one = Float4::splat(1.0f);
+    for (; i + 4 <= end; i += 4) {
+        Float4 lastX, lastY, nextX, nextY;
+        Float4::loadXY(&offsets[i].x, lastX, lastY);
+        Float4::loadXY(&offsets[i + 1].x, nextX, nextY);
+        Float4 divisor = one + Float4::abs(lastX * nextX + lastY * nextY);
+        Float4::storeXY(&offsets[i].x, (lastX + nextX) / divisor, (lastY + nextY) / divisor);
+    }
+#endif
+    for (; i < end; i++) {
+        offsets[i] = totalOffsetFromNormals(offsets[i], offsets[i + 1]);
+    }
+}
+
 /**
  * Structure used for storing useful information about the SkPaint and scale used for tessellating
  */
@@ -208,17 +270,13 @@ void getStrokeVerticesFromPerimeter(const PaintInfo& paintInfo, const Vector<Ver
         VertexBuffer& vertexBuffer) {
     Vertex* buffer = vertexBuffer.alloc<Vertex>(perimeter.size() * 2 + 2);
 
+    std::vector<Vector2> offsets;
+    computeVertexOffsets(perimeter, true, offsets);
+
     int currentIndex = 0;
-    const Vertex* last = &(perimeter[perimeter.size() - 1]);
-    const Vertex* current = &(perimeter[0]);
-    Vector2 lastNormal = {current->y - last->y, last->x - current->x};
-    lastNormal.normalize();
     for (unsigned int i = 0; i < perimeter.size(); i++) {
-        const Vertex* next = &(perimeter[i + 1 >= perimeter.size() ? 0 : i + 1]);
-        Vector2 nextNormal = {next->y - current->y, current->x - next->x};
-        nextNormal.normalize();
-
-        Vector2 totalOffset = totalOffsetFromNormals(lastNormal, nextNormal);
+        const Vertex* current = &(perimeter[i]);
+        Vector2 totalOffset = offsets[i];
         paintInfo.scaleOffsetForStrokeWidth(totalOffset);
 
         Vertex::set(&buffer[currentIndex++],
@@ -228,9 +286,6 @@ void getStrokeVerticesFromPerimeter(const PaintInfo& paintInfo, const Vector<Ver
         Vertex::set(&buffer[currentIndex++],
                 current->x - totalOffset.x,
                 current->y - totalOffset.y);
-
-        current = next;
-        lastNormal = nextNormal;
     }
 
     // wrap around to beginning
@@ -304,30 +359,29 @@ void getStrokeVerticesFromUnclosedVertices(const PaintInfo& paintInfo,
     }
 
     int currentIndex = extra;
-    const Vertex* last = &(vertices[0]);
-    const Vertex* current = &(vertices[1]);
-    Vector2 lastNormal = {current->y - last->y, last->x - current->x};
-    lastNormal.normalize();
+    Vector2 beginNormal = {vertices[1].y - vertices[0].y, vertices[0].x - vertices[1].x};
+    beginNormal.normalize();
 
-    storeBeginEnd(paintInfo, vertices[0], lastNormal, buffer, currentIndex, true);
+    storeBeginEnd(paintInfo, vertices[0], beginNormal, buffer, currentIndex, true);
 
-    for (unsigned int i = 1; i < vertices.size() - 1; i++) {
-        const Vertex* next = &(vertices[i + 1]);
-        Vector2 nextNormal = {next->y - current->y, current->x - next->x};
-        nextNormal.normalize();
+    std::vector<Vector2> offsets;
+    computeVertexOffsets(vertices, false, offsets);
 
-        Vector2 strokeOffset  = totalOffsetFromNormals(lastNormal, nextNormal);
+    for (unsigned int i = 1; i < vertices.size() - 1; i++) {
+        const Vertex* current = &(vertices[i]);
+        Vector2 strokeOffset = offsets[i];
         paintInfo.scaleOffsetForStrokeWidth(strokeOffset);
 
         Vector2 center = {current->x, current->y};
         Vertex::set(&buffer[currentIndex++], center + strokeOffset);
         Vertex::set(&buffer[currentIndex++], center - strokeOffset);
-
-        current = next;
-        lastNormal = nextNormal;
     }
 
-    storeBeginEnd(paintInfo, vertices[lastIndex], lastNormal, buffer, currentIndex, false);
+    Vector2 endNormal = {vertices[lastIndex].y - vertices[lastIndex - 1].y,
+            vertices[lastIndex - 1].x - vertices[lastIndex].x};
+    endNormal.normalize();
+
+    storeBeginEnd(paintInfo, vertices[lastIndex], endNormal, buffer, currentIndex, false);
 
     DEBUG_DUMP_BUFFER();
 }
@@ -348,19 +402,16 @@ void getFillVerticesFromPerimeterAA(const PaintInfo& paintInfo, const Vector<Ver
 
     // generate alpha points - fill Alpha vertex gaps in between each point with
     // alpha 0 vertex, offset by a scaled normal.
+    std::vector<Vector2> offsets;
+    computeVertexOffsets(perimeter, true, offsets);
+
     int currentIndex = 0;
-    const Vertex* last = &(perimeter[perimeter.size() - 1]);
-    const Vertex* current = &(perimeter[0]);
-    Vector2 lastNormal = {current->y - last->y, last->x - current->x};
-    lastNormal.normalize();
     for (unsigned int i = 0; i < perimeter.size(); i++) {
-        const Vertex* next = &(perimeter[i + 1 >= perimeter.size() ? 0 : i + 1]);
-        Vector2 nextNormal = {next->y - current->y, current->x - next->x};
-        nextNormal.normalize();
+        const Vertex* current = &(perimeter[i]);
 
         // AA point offset from original point is that point's normal, such that each side is offset
         // by .5 pixels
-        Vector2 totalOffset = paintInfo.deriveAAOffset(totalOffsetFromNormals(lastNormal, nextNormal));
+        Vector2 totalOffset = paintInfo.deriveAAOffset(offsets[i]);
 
         AlphaVertex::set(&buffer[currentIndex++],
                 current->x + totalOffset.x,
@@ -370,9 +421,6 @@ void getFillVerticesFromPerimeterAA(const PaintInfo& paintInfo, const Vector<Ver
                 current->x - totalOffset.x,
                 current->y - totalOffset.y,
                 maxAlpha);
-
-        current = next;
-        lastNormal = nextNormal;
     }
 
     // wrap around to beginning
@@ -586,20 +634,18 @@ void getStrokeVerticesFromUnclosedVerticesAA(const PaintInfo& paintInfo,
     int currentAAInnerIndex = currentAAOuterIndex + (2 * offset) + 3 + (2 * extra);
     int currentStrokeIndex = currentAAInnerIndex + 7 + (3 * extra - 2 * extraOffset);
 
-    const Vertex* last = &(vertices[0]);
-    const Vertex* current = &(vertices[1]);
-    Vector2 lastNormal = {current->y - last->y, last->x - current->x};
-    lastNormal.normalize();
+    Vector2 beginNormal = {vertices[1].y - vertices[0].y, vertices[0].x - vertices[1].x};
+    beginNormal.normalize();
 
     // TODO: use normal from bezier traversal for cap, instead of from vertices
-    storeCapAA(paintInfo, vertices, buffer, true, lastNormal, offset);
+    storeCapAA(paintInfo, vertices, buffer, true, beginNormal, offset);
 
-    for (unsigned int i = 1; i < vertices.size() - 1; i++) {
-        const Vertex* next = &(vertices[i + 1]);
-        Vector2 nextNormal = {next->y - current->y, current->x - next->x};
-        nextNormal.normalize();
+    std::vector<Vector2> offsets;
+    computeVertexOffsets(vertices, false, offsets);
 
-        Vector2 totalOffset = totalOffsetFromNormals(lastNormal, nextNormal);
+    for (unsigned int i = 1; i < vertices.size() - 1; i++) {
+        const Vertex* current = &(vertices[i]);
+        Vector2 totalOffset = offsets[i];
         Vector2 AAOffset = paintInfo.deriveAAOffset(totalOffset);
 
         Vector2 innerOffset = totalOffset;
@@ -633,13 +679,15 @@ void getStrokeVerticesFromUnclosedVerticesAA(const PaintInfo& paintInfo,
                 current->x - outerOffset.x,
                 current->y - outerOffset.y,
                 0.0f);
-
-        current = next;
-        lastNormal = nextNormal;
     }
 
+    const int lastIndex = vertices.size() - 1;
+    Vector2 endNormal = {vertices[lastIndex].y - vertices[lastIndex - 1].y,
+            vertices[lastIndex - 1].x - vertices[lastIndex].x};
+    endNormal.normalize();
+
     // TODO: use normal from bezier traversal for cap, instead of from vertices
-    storeCapAA(paintInfo, vertices, buffer, false, lastNormal, offset);
+    storeCapAA(paintInfo, vertices, buffer, false, endNormal, offset);
 
     DEBUG_DUMP_ALPHA_BUFFER();
 }
@@ -654,16 +702,12 @@ void getStrokeVerticesFromPerimeterAA(const PaintInfo& paintInfo, const Vector<V
     int currentStrokeIndex = offset;
     int currentAAInnerIndex = offset * 2;
 
-    const Vertex* last = &(perimeter[perimeter.size() - 1]);
-    const Vertex* current = &(perimeter[0]);
-    Vector2 lastNormal = {current->y - last->y, last->x - current->x};
-    lastNormal.normalize();
-    for (unsigned int i = 0; i < perimeter.size(); i++) {
-        const Vertex* next = &(perimeter[i + 1 >= perimeter.size() ? 0 : i + 1]);
-        Vector2 nextNormal = {next->y - current->y, current->x - next->x};
-        nextNormal.normalize();
+    std::vector<Vector2> offsets;
+    computeVertexOffsets(perimeter, true, offsets);
 
-        Vector2 totalOffset = totalOffsetFromNormals(lastNormal, nextNormal);
+    for (unsigned int i = 0; i < perimeter.size(); i++) {
+        const Vertex* current = &(perimeter[i]);
+        Vector2 totalOffset = offsets[i];
         Vector2 AAOffset = paintInfo.deriveAAOffset(totalOffset);
 
         Vector2 innerOffset = totalOffset;
@@ -697,9 +741,6 @@ void getStrokeVerticesFromPerimeterAA(const PaintInfo& paintInfo, const Vector<V
                 current->x - outerOffset.x,
                 current->y - outerOffset.y,
                 0.0f);
-
-        current = next;
-        lastNormal = nextNormal;
     }
 
     // wrap each strip around to beginning, creating degenerate tris to bridge strips
@@ -912,6 +953,77 @@ void pushToVector(Vector<Vertex>& vertices, float x, float y) {
     Vertex::set(newVertex, x, y);
 }
 
+static void appendContourFan(const Vector<Vertex>& contour, Vector<Vertex>& outputVertices) {
+    const int size = contour.size();
+    if (size < 3) return;
+
+    for (int i = 1; i < size - 1; i++) {
+        outputVertices.add(contour[0]);
+        outputVertices.add(contour[i]);
+        outputVertices.add(contour[i + 1]);
+    }
+}
+
+void PathTessellator::tessellatePathFans(const SkPath& path, const mat4& transform,
+        Vector<Vertex>& outputVertices) {
+    ATRACE_CALL();
+
+    float scaleX, scaleY;
+    extractTessellationScales(transform, &scaleX, &scaleY);
+    const PathApproximationInfo approximationInfo(1.0f / scaleX, 1.0f / scaleY,
+            OUTLINE_REFINE_THRESHOLD);
+
+    // contours are closed implicitly, the fan's last triangle covers the closing edge
+    SkPath::Iter iter(path, false);
+    SkPoint pts[4];
+    SkPath::Verb v;
+    Vector<Vertex> contour;
+    while (SkPath::kDone_Verb != (v = iter.next(pts))) {
+        switch (v) {
+        case SkPath::kMove_Verb:
+            appendContourFan(contour, outputVertices);
+            contour.clear();
+            pushToVector(contour, pts[0].x(), pts[0].y());
+            break;
+        case SkPath::kLine_Verb:
+            pushToVector(contour, pts[1].x(), pts[1].y());
+            break;
+        case SkPath::kQuad_Verb:
+            recursiveQuadraticBezierVertices(
+                    pts[0].x(), pts[0].y(),
+                    pts[2].x(), pts[2].y(),
+                    pts[1].x(), pts[1].y(),
+                    approximationInfo, contour);
+            break;
+        case SkPath::kCubic_Verb:
+            recursiveCubicBezierVertices(
+                    pts[0].x(), pts[0].y(),
+                    pts[1].x(), pts[1].y(),
+                    pts[3].x(), pts[3].y(),
+                    pts[2].x(), pts[2].y(),
+                    approximationInfo, contour);
+            break;
+        case SkPath::kConic_Verb: {
+            SkAutoConicToQuads converter;
+            const SkPoint* quads = converter.computeQuads(pts, iter.conicWeight(),
+                    approximationInfo.thresholdForConicQuads);
+            for (int i = 0; i < converter.countQuads(); ++i) {
+                const int offset = 2 * i;
+                recursiveQuadraticBezierVertices(
+                        quads[offset].x(), quads[offset].y(),
+                        quads[offset+2].x(), quads[offset+2].y(),
+                        quads[offset+1].x(), quads[offset+1].y(),
+                        approximationInfo, contour);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    appendContourFan(contour, outputVertices);
+}
+
 class ClockwiseEnforcer {
 public:
     void addPoint(const SkPoint& point) {
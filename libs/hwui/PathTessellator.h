@@ -111,6 +111,19 @@ public:
     static bool approximatePathOutlineVertices(const SkPath &path, float threshold,
             Vector<Vertex> &outputVertices);
 
+    /**
+     * Approximates every contour of a path, in any winding, and appends one triangle fan per
+     * contour to outputVertices as a GL_TRIANGLES list. The fans overlap where the path is
+     * concave or self intersecting, and are meant to be resolved in the stencil buffer.
+     *
+     * @param path The path to be approximated, in local coordinates
+     * @param transform The transform the path will be drawn with, used to drive stretch-aware
+     *        curve subdivision
+     * @param outputVertices The Vector the triangles are appended to
+     */
+    static void tessellatePathFans(const SkPath& path, const mat4& transform,
+            Vector<Vertex>& outputVertices);
+
 private:
     static bool approximatePathOutlineVertices(const SkPath &path, bool forceClose,
             const PathApproximationInfo& approximationInfo, Vector<Vertex> &outputVertices);
@@ -46,12 +46,7 @@ Program::Program(const ProgramDescription& description, const char* vertex, cons
             glAttachShader(mProgramId, mVertexShader);
             glAttachShader(mProgramId, mFragmentShader);
 
-            bindAttrib("position", kBindingPosition);
-            if (description.hasTexture || description.hasExternalTexture) {
-                texCoords = bindAttrib("texCoords", kBindingTexCoords);
-            } else {
-                texCoords = -1;
-            }
+            bindAttribs(description);
 
             ATRACE_BEGIN("linkProgram");
             glLinkProgram(mProgramId);
@@ -82,21 +77,85 @@ Program::Program(const ProgramDescription& description, const char* vertex, cons
     }
 }
 
+Program::Program(const ProgramDescription& description, GLenum binaryFormat,
+        const void* binary, GLsizei length) {
+    mInitialized = false;
+    mHasColorUniform = false;
+    mHasSampler = false;
+    mUse = false;
+
+    // Programs loaded from a binary have no shader objects attached
+    mVertexShader = 0;
+    mFragmentShader = 0;
+
+    mProgramId = glCreateProgram();
+
+    // The attribute locations were bound when the binary was linked, the
+    // bindings are only recorded here
+    bindAttribs(description);
+
+    ATRACE_BEGIN("loadProgramBinary");
+    glProgramBinaryOES(mProgramId, binaryFormat, binary, length);
+    ATRACE_END();
+
+    GLint status;
+    glGetProgramiv(mProgramId, GL_LINK_STATUS, &status);
+    if (status == GL_TRUE) {
+        mInitialized = true;
+        transform = addUniform("transform");
+        projection = addUniform("projection");
+    } else {
+        // Not fatal, the binary may be stale after a driver update. The caller
+        // is expected to compile the program from source instead
+        PROGRAM_LOGD("Rejected program binary, format 0x%x", binaryFormat);
+        glDeleteProgram(mProgramId);
+    }
+}
+
 Program::~Program() {
     if (mInitialized) {
-        // This would ideally happen after linking the program
-        // but Tegra drivers, especially when perfhud is enabled,
-        // sometimes crash if we do so
-        glDetachShader(mProgramId, mVertexShader);
-        glDetachShader(mProgramId, mFragmentShader);
+        if (mVertexShader) {
+            // This would ideally happen after linking the program
+            // but Tegra drivers, especially when perfhud is enabled,
+            // sometimes crash if we do so
+            glDetachShader(mProgramId, mVertexShader);
+            glDetachShader(mProgramId, mFragmentShader);
 
-        glDeleteShader(mVertexShader);
-        glDeleteShader(mFragmentShader);
+            glDeleteShader(mVertexShader);
+            glDeleteShader(mFragmentShader);
+        }
 
         glDeleteProgram(mProgramId);
     }
 }
 
+void Program::bindAttribs(const ProgramDescription& description) {
+    bindAttrib("position", kBindingPosition);
+    if (description.hasTexture || description.hasExternalTexture) {
+        texCoords = bindAttrib("texCoords", kBindingTexCoords);
+    } else {
+        texCoords = -1;
+    }
+}
+
+bool Program::getBinary(GLenum* binaryFormat, Vector<uint8_t>* binary) const {
+    if (!mInitialized) return false;
+
+    GLint length = 0;
+    glGetProgramiv(mProgramId, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0) return false;
+
+    binary->resize(length);
+    GLsizei written = 0;
+    glGetProgramBinaryOES(mProgramId, length, &written, binaryFormat, binary->editArray());
+    if (written <= 0) {
+        binary->clear();
+        return false;
+    }
+    binary->resize(written);
+    return true;
+}
+
 int Program::addAttrib(const char* name) {
     int slot = glGetAttribLocation(mProgramId, name);
     mAttributes.add(name, slot);
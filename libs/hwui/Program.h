@@ -18,6 +18,7 @@
 #define ANDROID_HWUI_PROGRAM_H
 
 #include <utils/KeyedVector.h>
+#include <utils/Vector.h>
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
@@ -86,6 +87,8 @@ namespace uirenderer {
 
 #define PROGRAM_HAS_DEBUG_HIGHLIGHT 43
 #define PROGRAM_HAS_ROUND_RECT_CLIP 44
+#define PROGRAM_HAS_INSTANCED_RECTS 45
+#define PROGRAM_IS_DISTANCE_FIELD 46
 
 ///////////////////////////////////////////////////////////////////////////////
 // Types
@@ -122,12 +125,17 @@ struct ProgramDescription {
     // Texturing
     bool hasTexture;
     bool hasAlpha8Texture;
+    // The alpha 8 texture holds a signed distance field, see FontRenderer
+    bool isDistanceField;
     bool hasExternalTexture;
     bool hasTextureTransform;
 
     // Color attribute
     bool hasColors;
 
+    // Position mapped to per instance rect bounds
+    bool hasInstancedRects;
+
     // Modulate, this should only be set when setColor() return true
     bool modulate;
 
@@ -170,10 +178,12 @@ struct ProgramDescription {
     void reset() {
         hasTexture = false;
         hasAlpha8Texture = false;
+        isDistanceField = false;
         hasExternalTexture = false;
         hasTextureTransform = false;
 
         hasColors = false;
+        hasInstancedRects = false;
 
         hasVertexAlpha = false;
         useShadowAlphaInterp = false;
@@ -271,6 +281,8 @@ struct ProgramDescription {
         if (hasColors) key |= programid(0x1) << PROGRAM_HAS_COLORS;
         if (hasDebugHighlight) key |= programid(0x1) << PROGRAM_HAS_DEBUG_HIGHLIGHT;
         if (hasRoundRectClip) key |= programid(0x1) << PROGRAM_HAS_ROUND_RECT_CLIP;
+        if (hasInstancedRects) key |= programid(0x1) << PROGRAM_HAS_INSTANCED_RECTS;
+        if (isDistanceField) key |= programid(0x1) << PROGRAM_IS_DISTANCE_FIELD;
         return key;
     }
 
@@ -316,8 +328,21 @@ public:
      * shaders sources.
      */
     Program(const ProgramDescription& description, const char* vertex, const char* fragment);
+
+    /**
+     * Creates a new program from a binary previously returned by getBinary().
+     * If the driver rejects the binary, isInitialized() returns false.
+     */
+    Program(const ProgramDescription& description, GLenum binaryFormat,
+            const void* binary, GLsizei length);
     virtual ~Program();
 
+    /**
+     * Retrieves the linked binary of this program, as understood by the
+     * current driver. Returns false if the binary could not be retrieved.
+     */
+    bool getBinary(GLenum* binaryFormat, Vector<uint8_t>* binary) const;
+
     /**
      * Binds this program to the GL context.
      */
@@ -409,6 +434,11 @@ private:
      */
     GLuint buildShader(const char* source, GLenum type);
 
+    /**
+     * Sets up the attribute state common to compiled and binary programs.
+     */
+    void bindAttribs(const ProgramDescription& description);
+
     // Name of the OpenGL program and shaders
     GLuint mProgramId;
     GLuint mVertexShader;
@@ -16,7 +16,13 @@
 
 #define LOG_TAG "OpenGLRenderer"
 
+#include <utils/JenkinsHash.h>
+#include <utils/Mutex.h>
 #include <utils/String8.h>
+#include <utils/Trace.h>
+
+#include <stdio.h>
+#include <unistd.h>
 
 #include "Caches.h"
 #include "Dither.h"
@@ -32,6 +38,7 @@ namespace uirenderer {
 #define MODULATE_OP_NO_MODULATE 0
 #define MODULATE_OP_MODULATE 1
 #define MODULATE_OP_MODULATE_A8 2
+#define MODULATE_OP_DISTANCE_FIELD 3
 
 #define STR(x) STR1(x)
 #define STR1(x) #x
@@ -46,6 +53,8 @@ const char* gVS_Header_Attributes_TexCoords =
         "attribute vec2 texCoords;\n";
 const char* gVS_Header_Attributes_Colors =
         "attribute vec4 colors;\n";
+const char* gVS_Header_Attributes_InstancedRects =
+        "attribute vec4 instanceBounds;\n";
 const char* gVS_Header_Attributes_VertexAlphaParameters =
         "attribute float vtxAlpha;\n";
 const char* gVS_Header_Uniforms_TextureTransform =
@@ -121,6 +130,11 @@ const char* gVS_Main_OutBitmapTexCoords =
 const char* gVS_Main_Position =
         "    vec4 transformedPosition = projection * transform * position;\n"
         "    gl_Position = transformedPosition;\n";
+// The unit quad position is mapped to the bounds of the instance
+const char* gVS_Main_Position_InstancedRects =
+        "    vec4 transformedPosition = projection * transform *\n"
+        "            vec4(mix(instanceBounds.xy, instanceBounds.zw, position.xy), 0.0, 1.0);\n"
+        "    gl_Position = transformedPosition;\n";
 
 const char* gVS_Main_VertexAlpha =
         "    alpha = vtxAlpha;\n";
@@ -152,8 +166,15 @@ const char* gFS_Uniforms_GradientSampler[2] = {
         "%s\n"
         "uniform sampler2D gradientSampler;\n",
         "%s\n"
-        "uniform vec4 startColor;\n"
-        "uniform vec4 endColor;\n"
+        "uniform vec4 stopColors[4];\n"
+        "uniform highp vec3 stopStarts;\n"
+        "uniform highp vec3 stopScales;\n"
+        "\nvec4 stopGradient(highp float index) {\n"
+        "    highp vec3 amounts = clamp((vec3(index) - stopStarts) * stopScales, 0.0, 1.0);\n"
+        "    vec4 color = mix(stopColors[0], stopColors[1], amounts.x);\n"
+        "    color = mix(color, stopColors[2], amounts.y);\n"
+        "    return mix(color, stopColors[3], amounts.z);\n"
+        "}\n"
 };
 const char* gFS_Uniforms_BitmapSampler =
         "uniform sampler2D bitmapSampler;\n";
@@ -168,11 +189,20 @@ const char* gFS_Uniforms_ColorOp[3] = {
 };
 const char* gFS_Uniforms_Gamma =
         "uniform float gamma;\n";
+const char* gFS_Uniforms_DistanceField =
+        "uniform float distanceFieldSmoothing;\n";
 
 const char* gFS_Uniforms_HasRoundRectClip =
         "uniform vec4 roundRectInnerRectLTRB;\n"
         "uniform float roundRectRadius;\n";
 
+// The edge of the shape is at 0.5, smoothed over about a pixel on screen
+const char* gFS_DistanceField =
+        "\nfloat distanceFieldAlpha() {\n"
+        "    return smoothstep(0.5 - distanceFieldSmoothing, 0.5 + distanceFieldSmoothing,\n"
+        "            texture2D(baseSampler, outTexCoords).a);\n"
+        "}\n";
+
 const char* gFS_Main =
         "\nvoid main(void) {\n"
         "    lowp vec4 fragColor;\n";
@@ -215,12 +245,20 @@ const char* gFS_Fast_SingleModulateA8Texture_ApplyGamma =
         "\nvoid main(void) {\n"
         "    gl_FragColor = color * pow(texture2D(baseSampler, outTexCoords).a, gamma);\n"
         "}\n\n";
+const char* gFS_Fast_SingleA8Texture_DistanceField =
+        "\nvoid main(void) {\n"
+        "    gl_FragColor = vec4(0.0, 0.0, 0.0, distanceFieldAlpha());\n"
+        "}\n\n";
+const char* gFS_Fast_SingleModulateA8Texture_DistanceField =
+        "\nvoid main(void) {\n"
+        "    gl_FragColor = color * distanceFieldAlpha();\n"
+        "}\n\n";
 const char* gFS_Fast_SingleGradient[2] = {
         "\nvoid main(void) {\n"
         "    gl_FragColor = %s + texture2D(gradientSampler, linear);\n"
         "}\n\n",
         "\nvoid main(void) {\n"
-        "    gl_FragColor = %s + mix(startColor, endColor, clamp(linear, 0.0, 1.0));\n"
+        "    gl_FragColor = %s + stopGradient(linear);\n"
         "}\n\n",
 };
 const char* gFS_Fast_SingleModulateGradient[2] = {
@@ -228,7 +266,7 @@ const char* gFS_Fast_SingleModulateGradient[2] = {
         "    gl_FragColor = %s + color.a * texture2D(gradientSampler, linear);\n"
         "}\n\n",
         "\nvoid main(void) {\n"
-        "    gl_FragColor = %s + color.a * mix(startColor, endColor, clamp(linear, 0.0, 1.0));\n"
+        "    gl_FragColor = %s + color.a * stopGradient(linear);\n"
         "}\n\n"
 };
 
@@ -257,23 +295,29 @@ const char* gFS_Main_FetchA8Texture[4] = {
         "    fragColor = color * texture2D(baseSampler, outTexCoords).a;\n",
         "    fragColor = color * pow(texture2D(baseSampler, outTexCoords).a, gamma);\n"
 };
+const char* gFS_Main_FetchA8DistanceField[2] = {
+        // Don't modulate
+        "    fragColor = vec4(0.0, 0.0, 0.0, distanceFieldAlpha());\n",
+        // Modulate
+        "    fragColor = color * distanceFieldAlpha();\n"
+};
 const char* gFS_Main_FetchGradient[6] = {
         // Linear
         "    vec4 gradientColor = texture2D(gradientSampler, linear);\n",
 
-        "    vec4 gradientColor = mix(startColor, endColor, clamp(linear, 0.0, 1.0));\n",
+        "    vec4 gradientColor = stopGradient(linear);\n",
 
         // Circular
         "    vec4 gradientColor = texture2D(gradientSampler, vec2(length(circular), 0.5));\n",
 
-        "    vec4 gradientColor = mix(startColor, endColor, clamp(length(circular), 0.0, 1.0));\n",
+        "    vec4 gradientColor = stopGradient(length(circular));\n",
 
         // Sweep
         "    highp float index = atan(sweep.y, sweep.x) * 0.15915494309; // inv(2 * PI)\n"
         "    vec4 gradientColor = texture2D(gradientSampler, vec2(index - floor(index), 0.5));\n",
 
         "    highp float index = atan(sweep.y, sweep.x) * 0.15915494309; // inv(2 * PI)\n"
-        "    vec4 gradientColor = mix(startColor, endColor, clamp(index - floor(index), 0.0, 1.0));\n"
+        "    vec4 gradientColor = stopGradient(index - floor(index));\n"
 };
 const char* gFS_Main_FetchBitmap =
         "    vec4 bitmapColor = texture2D(bitmapSampler, outBitmapTexCoords);\n";
@@ -283,7 +327,7 @@ const char* gFS_Main_BlendShadersBG =
         "    fragColor = blendShaders(gradientColor, bitmapColor)";
 const char* gFS_Main_BlendShadersGB =
         "    fragColor = blendShaders(bitmapColor, gradientColor)";
-const char* gFS_Main_BlendShaders_Modulate[6] = {
+const char* gFS_Main_BlendShaders_Modulate[8] = {
         // Don't modulate
         ";\n",
         ";\n",
@@ -292,9 +336,12 @@ const char* gFS_Main_BlendShaders_Modulate[6] = {
         " * color.a;\n",
         // Modulate with alpha 8 texture
         " * texture2D(baseSampler, outTexCoords).a;\n",
-        " * pow(texture2D(baseSampler, outTexCoords).a, gamma);\n"
+        " * pow(texture2D(baseSampler, outTexCoords).a, gamma);\n",
+        // Modulate with distance field alpha 8 texture
+        " * distanceFieldAlpha();\n",
+        " * distanceFieldAlpha();\n"
 };
-const char* gFS_Main_GradientShader_Modulate[6] = {
+const char* gFS_Main_GradientShader_Modulate[8] = {
         // Don't modulate
         "    fragColor = gradientColor;\n",
         "    fragColor = gradientColor;\n",
@@ -303,9 +350,12 @@ const char* gFS_Main_GradientShader_Modulate[6] = {
         "    fragColor = gradientColor * color.a;\n",
         // Modulate with alpha 8 texture
         "    fragColor = gradientColor * texture2D(baseSampler, outTexCoords).a;\n",
-        "    fragColor = gradientColor * pow(texture2D(baseSampler, outTexCoords).a, gamma);\n"
+        "    fragColor = gradientColor * pow(texture2D(baseSampler, outTexCoords).a, gamma);\n",
+        // Modulate with distance field alpha 8 texture
+        "    fragColor = gradientColor * distanceFieldAlpha();\n",
+        "    fragColor = gradientColor * distanceFieldAlpha();\n"
     };
-const char* gFS_Main_BitmapShader_Modulate[6] = {
+const char* gFS_Main_BitmapShader_Modulate[8] = {
         // Don't modulate
         "    fragColor = bitmapColor;\n",
         "    fragColor = bitmapColor;\n",
@@ -314,7 +364,10 @@ const char* gFS_Main_BitmapShader_Modulate[6] = {
         "    fragColor = bitmapColor * color.a;\n",
         // Modulate with alpha 8 texture
         "    fragColor = bitmapColor * texture2D(baseSampler, outTexCoords).a;\n",
-        "    fragColor = bitmapColor * pow(texture2D(baseSampler, outTexCoords).a, gamma);\n"
+        "    fragColor = bitmapColor * pow(texture2D(baseSampler, outTexCoords).a, gamma);\n",
+        // Modulate with distance field alpha 8 texture
+        "    fragColor = bitmapColor * distanceFieldAlpha();\n",
+        "    fragColor = bitmapColor * distanceFieldAlpha();\n"
     };
 const char* gFS_Main_FragColor =
         "    gl_FragColor = fragColor;\n";
@@ -406,13 +459,179 @@ const char* gBlendOps[18] = {
 ///////////////////////////////////////////////////////////////////////////////
 
 ProgramCache::ProgramCache(Extensions& extensions)
-        : mHasES3(extensions.getMajorGlVersion() >= 3) {
+        : mBinariesDirty(false)
+        , mBinariesLoaded(false)
+        , mHasES3(extensions.getMajorGlVersion() >= 3)
+        , mHasProgramBinary(extensions.hasProgramBinary()) {
 }
 
 ProgramCache::~ProgramCache() {
     clear();
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Binary cache file
+///////////////////////////////////////////////////////////////////////////////
+
+#define PROGRAM_BINARY_CACHE_MAGIC ('h' | 'p' << 8 | 'b' << 16 | 'c' << 24)
+#define PROGRAM_BINARY_CACHE_VERSION 1
+
+// Binaries are typically a few kB, anything bigger than this is a corrupt file
+#define PROGRAM_BINARY_MAX_SIZE (1024 * 1024)
+
+struct ProgramBinaryCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t driverHash;
+    uint32_t count;
+};
+
+struct ProgramBinaryEntryHeader {
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+static Mutex sBinaryCacheFileLock;
+static String8 sBinaryCacheFile;
+
+void ProgramCache::setBinaryCacheFile(const char* path) {
+    Mutex::Autolock _l(sBinaryCacheFileLock);
+    sBinaryCacheFile.setTo(path);
+}
+
+static String8 getBinaryCacheFile() {
+    Mutex::Autolock _l(sBinaryCacheFileLock);
+    return sBinaryCacheFile;
+}
+
+uint32_t ProgramCache::getDriverHash() const {
+    // A driver update invalidates all the binaries, as does any change to the
+    // generated shaders, which is covered by PROGRAM_BINARY_CACHE_VERSION
+    const GLenum names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+    uint32_t hash = 0;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        const char* value = (const char*) glGetString(names[i]);
+        if (value) {
+            hash = JenkinsHashMixBytes(hash, (const uint8_t*) value, strlen(value));
+        }
+    }
+    return JenkinsHashWhiten(hash);
+}
+
+void ProgramCache::loadBinaries() {
+    if (!mHasProgramBinary || mBinariesLoaded) return;
+    String8 path = getBinaryCacheFile();
+    if (path.isEmpty()) return;
+
+    ATRACE_NAME("loadProgramBinaries");
+    mBinariesLoaded = true;
+
+    FILE* file = fopen(path.string(), "rb");
+    if (!file) return;
+
+    ProgramBinaryCacheHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1
+            || header.magic != PROGRAM_BINARY_CACHE_MAGIC
+            || header.version != PROGRAM_BINARY_CACHE_VERSION
+            || header.driverHash != getDriverHash()) {
+        PROGRAM_LOGD("Discarding stale program binary cache %s", path.string());
+        fclose(file);
+        // Rewrite the file with the binaries of this driver
+        mBinariesDirty = true;
+        return;
+    }
+
+    for (uint32_t i = 0; i < header.count; i++) {
+        ProgramBinaryEntryHeader entry;
+        if (fread(&entry, sizeof(entry), 1, file) != 1
+                || entry.length == 0 || entry.length > PROGRAM_BINARY_MAX_SIZE) {
+            break;
+        }
+
+        ProgramBinary& binary = mBinaries[entry.key];
+        binary.format = entry.format;
+        binary.data.resize(entry.length);
+        if (fread(binary.data.editArray(), entry.length, 1, file) != 1) {
+            mBinaries.erase(entry.key);
+            break;
+        }
+    }
+    fclose(file);
+
+    PROGRAM_LOGD("Loaded %zu program binaries from %s", mBinaries.size(), path.string());
+}
+
+void ProgramCache::saveBinaries() {
+    if (!mBinariesDirty) return;
+    String8 path = getBinaryCacheFile();
+    if (path.isEmpty()) return;
+
+    ATRACE_NAME("saveProgramBinaries");
+
+    // Write to a temporary file first so that a concurrent reader never sees
+    // a partially written cache
+    String8 tmpPath(path);
+    tmpPath.appendFormat(".%d.tmp", getpid());
+
+    FILE* file = fopen(tmpPath.string(), "wb");
+    if (!file) {
+        ALOGW("Could not open program binary cache %s", tmpPath.string());
+        return;
+    }
+
+    ProgramBinaryCacheHeader header;
+    header.magic = PROGRAM_BINARY_CACHE_MAGIC;
+    header.version = PROGRAM_BINARY_CACHE_VERSION;
+    header.driverHash = getDriverHash();
+    header.count = mBinaries.size();
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    for (auto iter = mBinaries.begin(); success && iter != mBinaries.end(); iter++) {
+        const ProgramBinary& binary = iter->second;
+        ProgramBinaryEntryHeader entry;
+        entry.key = iter->first;
+        entry.format = binary.format;
+        entry.length = binary.data.size();
+        success = fwrite(&entry, sizeof(entry), 1, file) == 1
+                && fwrite(binary.data.array(), entry.length, 1, file) == 1;
+    }
+
+    success &= fclose(file) == 0;
+    if (success && rename(tmpPath.string(), path.string()) == 0) {
+        mBinariesDirty = false;
+    } else {
+        ALOGW("Could not write program binary cache %s", path.string());
+        unlink(tmpPath.string());
+    }
+}
+
+Program* ProgramCache::loadProgram(const ProgramDescription& description, programid key) {
+    auto iter = mBinaries.find(key);
+    if (iter == mBinaries.end()) return nullptr;
+
+    const ProgramBinary& binary = iter->second;
+    Program* program = new Program(description, binary.format,
+            binary.data.array(), binary.data.size());
+    if (!program->isInitialized()) {
+        delete program;
+        mBinaries.erase(iter);
+        mBinariesDirty = true;
+        return nullptr;
+    }
+    return program;
+}
+
+void ProgramCache::storeBinary(programid key, const Program& program) {
+    if (!mBinariesLoaded) return;
+
+    ProgramBinary binary;
+    if (program.getBinary(&binary.format, &binary.data)) {
+        mBinaries[key] = binary;
+        mBinariesDirty = true;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Cache management
 ///////////////////////////////////////////////////////////////////////////////
@@ -422,6 +641,26 @@ void ProgramCache::clear() {
     mCache.clear();
 }
 
+void ProgramCache::preload() {
+    ATRACE_NAME("preloadPrograms");
+    for (int modulate = 0; modulate < 2; modulate++) {
+        ProgramDescription description;
+        description.modulate = modulate;
+        // solid colors
+        get(description);
+        // anti-aliased rects and paths
+        description.hasVertexAlpha = true;
+        get(description);
+        description.hasVertexAlpha = false;
+        // bitmaps, layers and patches
+        description.hasTexture = true;
+        get(description);
+        // text
+        description.hasAlpha8Texture = true;
+        get(description);
+    }
+}
+
 Program* ProgramCache::get(const ProgramDescription& description) {
     programid key = description.key();
     if (key == (PROGRAM_KEY_TEXTURE | PROGRAM_KEY_A8_TEXTURE)) {
@@ -433,8 +672,12 @@ Program* ProgramCache::get(const ProgramDescription& description) {
     auto iter = mCache.find(key);
     Program* program = nullptr;
     if (iter == mCache.end()) {
-        description.log("Could not find program");
-        program = generateProgram(description, key);
+        program = loadProgram(description, key);
+        if (!program) {
+            description.log("Could not find program");
+            program = generateProgram(description, key);
+            storeBinary(key, *program);
+        }
         mCache[key] = std::unique_ptr<Program>(program);
     } else {
         program = iter->second.get();
@@ -469,6 +712,9 @@ String8 ProgramCache::generateVertexShader(const ProgramDescription& description
     if (description.hasColors) {
         shader.append(gVS_Header_Attributes_Colors);
     }
+    if (description.hasInstancedRects) {
+        shader.append(gVS_Header_Attributes_InstancedRects);
+    }
     // Uniforms
     shader.append(gVS_Header_Uniforms);
     if (description.hasTextureTransform) {
@@ -520,7 +766,11 @@ String8 ProgramCache::generateVertexShader(const ProgramDescription& description
             shader.append(gVS_Main_OutBitmapTexCoords);
         }
         // Output transformed position
-        shader.append(gVS_Main_Position);
+        if (description.hasInstancedRects) {
+            shader.append(gVS_Main_Position_InstancedRects);
+        } else {
+            shader.append(gVS_Main_Position);
+        }
         if (description.hasGradient) {
             shader.append(gVS_Main_OutGradient[gradientIndex(description)]);
         }
@@ -538,7 +788,10 @@ String8 ProgramCache::generateVertexShader(const ProgramDescription& description
 
 static bool shaderOp(const ProgramDescription& description, String8& shader,
         const int modulateOp, const char** snippets) {
-    int op = description.hasAlpha8Texture ? MODULATE_OP_MODULATE_A8 : modulateOp;
+    int op = modulateOp;
+    if (description.hasAlpha8Texture) {
+        op = description.isDistanceField ? MODULATE_OP_DISTANCE_FIELD : MODULATE_OP_MODULATE_A8;
+    }
     op = op * 2 + description.hasGammaCorrection;
     shader.append(snippets[op]);
     return description.hasAlpha8Texture;
@@ -601,6 +854,10 @@ String8 ProgramCache::generateFragmentShader(const ProgramDescription& descripti
     if (description.hasRoundRectClip) {
         shader.append(gFS_Uniforms_HasRoundRectClip);
     }
+    if (description.isDistanceField) {
+        shader.append(gFS_Uniforms_DistanceField);
+        shader.append(gFS_DistanceField);
+    }
 
     // Optimization for common cases
     if (!description.hasVertexAlpha
@@ -630,6 +887,13 @@ String8 ProgramCache::generateFragmentShader(const ProgramDescription& descripti
                 shader.append(gFS_Fast_SingleModulateTexture);
             }
             fast = true;
+        } else if (singleA8Texture && description.isDistanceField) {
+            if (!description.modulate) {
+                shader.append(gFS_Fast_SingleA8Texture_DistanceField);
+            } else {
+                shader.append(gFS_Fast_SingleModulateA8Texture_DistanceField);
+            }
+            fast = true;
         } else if (singleA8Texture) {
             if (!description.modulate) {
                 if (description.hasGammaCorrection) {
@@ -692,8 +956,12 @@ String8 ProgramCache::generateFragmentShader(const ProgramDescription& descripti
         if (description.hasTexture || description.hasExternalTexture) {
             if (description.hasAlpha8Texture) {
                 if (!description.hasGradient && !description.hasBitmap) {
-                    shader.append(gFS_Main_FetchA8Texture[modulateOp * 2 +
-                                                          description.hasGammaCorrection]);
+                    if (description.isDistanceField) {
+                        shader.append(gFS_Main_FetchA8DistanceField[modulateOp]);
+                    } else {
+                        shader.append(gFS_Main_FetchA8Texture[modulateOp * 2 +
+                                                              description.hasGammaCorrection]);
+                    }
                 }
             } else {
                 shader.append(gFS_Main_FetchTexture[modulateOp]);
@@ -17,9 +17,11 @@
 #ifndef ANDROID_HWUI_PROGRAM_CACHE_H
 #define ANDROID_HWUI_PROGRAM_CACHE_H
 
+#include <cutils/compiler.h>
 #include <utils/KeyedVector.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 #include <map>
 
 #include <GLES2/gl2.h>
@@ -47,8 +49,41 @@ public:
 
     void clear();
 
+    /**
+     * Creates the programs used by nearly every frame (solid colors,
+     * bitmaps, text and anti-aliased geometry) ahead of the first draw.
+     */
+    void preload();
+
+    /**
+     * Sets the file used to persist linked program binaries across processes.
+     * Must be called before the caches are initialized to take effect.
+     */
+    ANDROID_API static void setBinaryCacheFile(const char* path);
+
+    /**
+     * Reads the program binaries saved by a previous process, if they were
+     * produced by the current driver. Programs are then created from these
+     * binaries instead of being compiled on first use.
+     */
+    void loadBinaries();
+
+    /**
+     * Writes the binaries of the programs linked since the last save to the
+     * binary cache file.
+     */
+    void saveBinaries();
+
 private:
+    struct ProgramBinary {
+        GLenum format;
+        Vector<uint8_t> data;
+    };
+
     Program* generateProgram(const ProgramDescription& description, programid key);
+    Program* loadProgram(const ProgramDescription& description, programid key);
+    void storeBinary(programid key, const Program& program);
+    uint32_t getDriverHash() const;
     String8 generateVertexShader(const ProgramDescription& description);
     String8 generateFragmentShader(const ProgramDescription& description);
     void generateBlend(String8& shader, const char* name, SkXfermode::Mode mode);
@@ -58,7 +93,13 @@ private:
 
     std::map<programid, std::unique_ptr<Program>> mCache;
 
+    // Binaries of the programs known to the binary cache file, used or not
+    std::map<programid, ProgramBinary> mBinaries;
+    bool mBinariesDirty;
+    bool mBinariesLoaded;
+
     const bool mHasES3;
+    const bool mHasProgramBinary;
 }; // class ProgramCache
 
 }; // namespace uirenderer
@@ -25,11 +25,19 @@ namespace uirenderer {
 
 bool Properties::drawDeferDisabled = false;
 bool Properties::drawReorderDisabled = false;
+bool Properties::asyncDrawBatching = false;
+bool Properties::stencilPaths = false;
+bool Properties::distanceFieldText = false;
+bool Properties::gpuFrameTiming = false;
+bool Properties::opProfiling = false;
+std::string Properties::captureFramePath;
+int Properties::renderAhead = 0;
 bool Properties::debugLayersUpdates = false;
 bool Properties::debugOverdraw = false;
 bool Properties::showDirtyRegions = false;
 bool Properties::skipEmptyFrames = true;
 bool Properties::swapBuffersWithDamage = true;
+bool Properties::useBufferAge = true;
 
 DebugLevel Properties::debugLevel = kDebugDisabled;
 OverdrawColorSet Properties::overdrawColorSet = OverdrawColorSet::Default;
@@ -96,6 +104,20 @@ bool Properties::load() {
     drawReorderDisabled = property_get_bool(PROPERTY_DISABLE_DRAW_REORDER, false);
     INIT_LOGD("  Draw reorder %s", drawReorderDisabled ? "disabled" : "enabled");
 
+    asyncDrawBatching = property_get_bool(PROPERTY_ASYNC_DRAW_BATCHING, false);
+    INIT_LOGD("  Async draw batching %s", asyncDrawBatching ? "enabled" : "disabled");
+
+    stencilPaths = property_get_bool(PROPERTY_STENCIL_PATHS, false);
+    distanceFieldText = property_get_bool(PROPERTY_DISTANCE_FIELD_TEXT, false);
+
+    gpuFrameTiming = property_get_bool(PROPERTY_GPU_FRAME_TIMING, false);
+    opProfiling = property_get_bool(PROPERTY_OP_PROFILING, false);
+
+    property_get(PROPERTY_CAPTURE_FRAME, property, "");
+    captureFramePath = property;
+
+    renderAhead = std::min(std::max(property_get_int32(PROPERTY_RENDER_AHEAD, 0), 0), 2);
+
     showDirtyRegions = property_get_bool(PROPERTY_DEBUG_SHOW_DIRTY_REGIONS, false);
 
     debugLevel = kDebugDisabled;
@@ -105,6 +127,7 @@ bool Properties::load() {
 
     skipEmptyFrames = property_get_bool(PROPERTY_SKIP_EMPTY_DAMAGE, true);
     swapBuffersWithDamage = property_get_bool(PROPERTY_SWAP_WITH_DAMAGE, true);
+    useBufferAge = property_get_bool(PROPERTY_USE_BUFFER_AGE, true);
 
     return (prevDebugLayersUpdates != debugLayersUpdates)
             || (prevDebugOverdraw != debugOverdraw)
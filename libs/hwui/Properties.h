@@ -19,6 +19,7 @@
 
 #include <cutils/properties.h>
 #include <stdlib.h>
+#include <string>
 #include <utils/Singleton.h>
 
 /**
@@ -144,12 +145,67 @@ enum DebugLevel {
  */
 #define PROPERTY_DISABLE_DRAW_REORDER "debug.hwui.disable_draw_reorder"
 
+/**
+ * Used to enable batching and merging of deferred draw operations on a
+ * worker thread, overlapping it with the GL work issued by the render thread.
+ * Has no effect if PROPERTY_DISABLE_DRAW_DEFER is set to "true"
+ * Default is "false".
+ */
+#define PROPERTY_ASYNC_DRAW_BATCHING "debug.hwui.async_draw_batching"
+
+/**
+ * Used to enable filling simple, non antialiased paths with the stencil
+ * buffer on the GPU instead of rasterizing them into PathCache textures.
+ * Default is "false".
+ */
+#define PROPERTY_STENCIL_PATHS "debug.hwui.stencil_paths"
+
+/**
+ * Used to enable drawing text under scale transforms with a single set of
+ * signed distance field glyphs, instead of rasterizing glyphs for every
+ * scale. Default is "false".
+ */
+#define PROPERTY_DISTANCE_FIELD_TEXT "debug.hwui.distance_field_text"
+
 /**
  * Setting this property will enable or disable the dropping of frames with
  * empty damage. Default is "true".
  */
 #define PROPERTY_SKIP_EMPTY_DAMAGE "debug.hwui.skip_empty_damage"
 
+/**
+ * Used to enable measuring the GPU time of each frame, and of the layer
+ * updates it renders, with GL_EXT_disjoint_timer_query. The durations are
+ * reported in the frame stats and used to count GPU-bound janky frames.
+ * Default is "false".
+ */
+#define PROPERTY_GPU_FRAME_TIMING "debug.hwui.gpu_frame_timing"
+
+/**
+ * Used to enable the draw op profiler, which samples one frame out of every
+ * few and attributes the time spent applying draw ops to op types and
+ * RenderNodes. The results are dumped with "dumpsys gfxinfo".
+ * Default is "false".
+ */
+#define PROPERTY_OP_PROFILING "debug.hwui.op_profiling"
+
+/**
+ * Path of a file to which the RenderNode tree of the next frame is written
+ * once, to be replayed by hwuitest --replay, see DisplayListWriter. Changing
+ * the path captures another frame.
+ * Default is empty, which disables capture.
+ */
+#define PROPERTY_CAPTURE_FRAME "debug.hwui.capture_frame"
+
+/**
+ * Number of frames, 0 to 2, the RenderThread may queue ahead of the display.
+ * Each adds a buffer to the windows so that swapping a frame doesn't wait on
+ * the display to release a buffer, letting the next frame sync early, at the
+ * cost of a frame of latency. Only applies to the surfaces set afterwards.
+ * Default is 0.
+ */
+#define PROPERTY_RENDER_AHEAD "debug.hwui.render_ahead"
+
 /**
  * Setting this property will enable usage of EGL_KHR_swap_buffers_with_damage
  * See: https://www.khronos.org/registry/egl/extensions/KHR/EGL_KHR_swap_buffers_with_damage.txt
@@ -159,6 +215,13 @@ enum DebugLevel {
  */
 #define PROPERTY_SWAP_WITH_DAMAGE "debug.hwui.swap_with_damage"
 
+/**
+ * Setting this property will enable or disable partial redraws of surfaces
+ * that don't preserve their buffers, using EGL_EXT_buffer_age and, if
+ * available, EGL_KHR_partial_update. Default is "true".
+ */
+#define PROPERTY_USE_BUFFER_AGE "debug.hwui.use_buffer_age"
+
 ///////////////////////////////////////////////////////////////////////////////
 // Runtime configuration properties
 ///////////////////////////////////////////////////////////////////////////////
@@ -198,6 +261,15 @@ enum DebugLevel {
 // These properties are defined in percentage (range 0..1)
 #define PROPERTY_TEXTURE_CACHE_FLUSH_RATE "ro.hwui.texture_cache_flushrate"
 
+// Indicates whether the texture cache uploads bitmaps through a PBO, so that
+// the driver can transfer them asynchronously. Only used if
+// PROPERTY_ENABLE_GPU_PIXEL_BUFFERS allows it. Default is "false".
+#define PROPERTY_TEXTURE_CACHE_PBO_UPLOADS "ro.hwui.texture_cache_pbo_uploads"
+
+// Number of process-local atlas pages frequently drawn app bitmaps can be
+// packed into at runtime, 0 disables dynamic atlas pages
+#define PROPERTY_DYNAMIC_ATLAS_PAGES "ro.hwui.dynamic_atlas_pages"
+
 // These properties are defined in pixels
 #define PROPERTY_TEXT_SMALL_CACHE_WIDTH "ro.hwui.text_small_cache_width"
 #define PROPERTY_TEXT_SMALL_CACHE_HEIGHT "ro.hwui.text_small_cache_height"
@@ -245,6 +317,8 @@ enum DebugLevel {
 
 #define DEFAULT_TEXTURE_CACHE_FLUSH_RATE 0.6f
 
+#define DEFAULT_DYNAMIC_ATLAS_PAGES 1
+
 #define DEFAULT_TEXT_GAMMA 1.4f
 #define DEFAULT_TEXT_BLACK_GAMMA_THRESHOLD 64
 #define DEFAULT_TEXT_WHITE_GAMMA_THRESHOLD 192
@@ -286,6 +360,13 @@ public:
 
     static bool drawDeferDisabled;
     static bool drawReorderDisabled;
+    static bool asyncDrawBatching;
+    static bool stencilPaths;
+    static bool distanceFieldText;
+    static bool gpuFrameTiming;
+    static bool opProfiling;
+    static std::string captureFramePath;
+    static int renderAhead;
     static bool debugLayersUpdates;
     static bool debugOverdraw;
     static bool showDirtyRegions;
@@ -293,6 +374,7 @@ public:
     static bool skipEmptyFrames;
     // TODO: Remove after stabilization period
     static bool swapBuffersWithDamage;
+    static bool useBufferAge;
 
     static DebugLevel debugLevel;
     static OverdrawColorSet overdrawColorSet;
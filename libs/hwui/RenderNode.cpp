@@ -31,6 +31,7 @@
 #include "DisplayListOp.h"
 #include "LayerRenderer.h"
 #include "OpenGLRenderer.h"
+#include "OpProfiler.h"
 #include "TreeInfo.h"
 #include "utils/MathUtils.h"
 #include "utils/TraceUtils.h"
@@ -254,7 +255,12 @@ void RenderNode::prepareTreeImpl(TreeInfo& info, bool functorsNeedLayer) {
     if (info.mode == TreeInfo::MODE_FULL) {
         pushStagingDisplayListChanges(info);
     }
+    // The children of layers and save layers draw their shadows relative to the layer
+    bool precacheShadows = info.precacheShadows;
+    info.precacheShadows &= properties().effectiveLayerType() == LayerType::None
+            && !(properties().getAlpha() < 1 && properties().getHasOverlappingRendering());
     prepareSubTree(info, childFunctorsNeedLayer, mDisplayListData);
+    info.precacheShadows = precacheShadows;
     pushLayerUpdate(info);
 
     info.damageAccumulator->popTransform();
@@ -272,6 +278,7 @@ void RenderNode::pushStagingPropertiesChanges(TreeInfo& info) {
         damageSelf(info);
         info.damageAccumulator->popTransform();
         mProperties = mStagingProperties;
+        mAnimatorManager.notifyPropertiesPushed();
         applyLayerPropertiesToLayer(info);
         // We could try to be clever and only re-damage if the matrix changed.
         // However, we don't need to worry about that. The cost of over-damaging
@@ -352,7 +359,80 @@ void RenderNode::prepareSubTree(TreeInfo& info, bool functorsNeedLayer, DisplayL
             childNode->prepareTreeImpl(info, childFunctorsNeedLayer);
             info.damageAccumulator->popTransform();
         }
+        if (info.precacheShadows) {
+            precacheChildShadows(info, subtree);
+        }
+    }
+}
+
+/**
+ * Queues the shadows the 3d children will cast when this node is issued, see
+ * issueOperationsOf3dChildren(), now that their properties and outlines are final for the frame.
+ * The TessellationCache hands them over to the DrawShadowOps deferred with the same inputs.
+ */
+void RenderNode::precacheChildShadows(TreeInfo& info, DisplayListData* subtree) {
+    Matrix4 drawTransform;
+    bool hasDrawTransform = false;
+    for (size_t chunkIndex = 0; chunkIndex < subtree->getChunks().size(); chunkIndex++) {
+        const DisplayListData::Chunk& chunk = subtree->getChunks()[chunkIndex];
+        if (!chunk.reorderChildren) continue;
+
+        for (size_t i = chunk.beginChildIndex; i < chunk.endChildIndex; i++) {
+            DrawRenderNodeOp* childOp = subtree->children()[i];
+            RenderNode* child = childOp->mRenderNode;
+            // only children with a positive Z cast shadows
+            float childZ = child->properties().getZ();
+            if (MathUtils::isZero(childZ) || childZ < 0.0f) continue;
+
+            if (!hasDrawTransform) {
+                // 3d children draw their shadows with the base transform of this node
+                info.damageAccumulator->computeCurrentTransform(&drawTransform);
+                hasDrawTransform = true;
+            }
+            child->precacheShadow(info, drawTransform, childOp->mTransformFromParent);
+        }
+    }
+}
+
+void RenderNode::precacheShadow(TreeInfo& info, const Matrix4& drawTransform,
+        const Matrix4& transformFromParent) {
+    if (properties().getAlpha() <= 0.0f
+            || properties().getOutline().getAlpha() <= 0.0f
+            || !properties().getOutline().getPath()
+            || properties().getScaleX() == 0
+            || properties().getScaleY() == 0) {
+        // no shadow to draw
+        return;
+    }
+
+    // Outlines clipped by the reveal clip or the clip bounds are intersected into paths
+    // allocated for the frame by issueDrawShadowOperation(), which can't be matched here
+    if (properties().getRevealClip().getPath()
+            || (properties().getClippingFlags() & CLIP_TO_CLIP_BOUNDS)) {
+        return;
     }
+
+    OpenGLRenderer* renderer = info.renderer;
+    if (!renderer->getViewportWidth() || !renderer->getViewportHeight()) return;
+
+    mat4 shadowMatrixXY(transformFromParent);
+    applyViewPropertyTransforms(shadowMatrixXY);
+    mat4 shadowMatrixZ(transformFromParent);
+    applyViewPropertyTransforms(shadowMatrixZ, true);
+
+    // The clip of the frame is within the viewport, outset to absorb the rounding
+    // differences with the transform the shadow will be drawn with
+    Rect localClip(renderer->getViewportWidth(), renderer->getViewportHeight());
+    Matrix4 inverse;
+    inverse.loadInverse(drawTransform);
+    inverse.mapRect(localClip);
+    localClip.outset(1.0f);
+
+    float casterAlpha = properties().getAlpha() * properties().getOutline().getAlpha();
+    Caches::getInstance().tessellationCache.precacheTreeShadows(&drawTransform, localClip,
+            casterAlpha >= 1.0f, properties().getOutline().getPath(),
+            &shadowMatrixXY, &shadowMatrixZ,
+            renderer->getLightCenter(), renderer->getLightRadius());
 }
 
 void RenderNode::destroyHardwareResources() {
@@ -870,6 +950,9 @@ void RenderNode::issueOperations(OpenGLRenderer& renderer, T& handler) {
 
     handler.startMark(getName());
 
+    OpProfiler* profiler = renderer.opProfiler();
+    if (CC_UNLIKELY(profiler)) profiler->pushNode(this);
+
 #if DEBUG_DISPLAY_LIST
     const Rect& clipRect = renderer.getLocalClipBounds();
     DISPLAY_LIST_LOGD("%*sStart display list (%p, %s), localClipBounds: %.0f, %.0f, %.0f, %.0f",
@@ -935,6 +1018,7 @@ void RenderNode::issueOperations(OpenGLRenderer& renderer, T& handler) {
             PROPERTY_SAVECOUNT, properties().getClipToBounds());
 
     DISPLAY_LIST_LOGD("%*sDone (%p, %s)", handler.level() * 2, "", this, getName());
+    if (CC_UNLIKELY(profiler)) profiler->popNode();
     handler.endMark();
 }
 
@@ -239,6 +239,9 @@ private:
     void pushStagingPropertiesChanges(TreeInfo& info);
     void pushStagingDisplayListChanges(TreeInfo& info);
     void prepareSubTree(TreeInfo& info, bool functorsNeedLayer, DisplayListData* subtree);
+    void precacheChildShadows(TreeInfo& info, DisplayListData* subtree);
+    void precacheShadow(TreeInfo& info, const Matrix4& drawTransform,
+            const Matrix4& transformFromParent);
     void applyLayerPropertiesToLayer(TreeInfo& info);
     void prepareLayer(TreeInfo& info, uint32_t dirtyMask);
     void pushLayerUpdate(TreeInfo& info);
@@ -259,6 +262,9 @@ private:
     DisplayListData* mDisplayListData;
     DisplayListData* mStagingDisplayListData;
 
+    // Captures the synced display lists
+    friend class DisplayListWriter;
+
     friend class AnimatorManager;
     AnimatorManager mAnimatorManager;
 
@@ -51,6 +51,8 @@ public:
 
     virtual void setBitmap(const SkBitmap& bitmap) override;
 
+    virtual bool isHardwareAccelerated() const override { return false; }
+
     virtual bool isOpaque() override;
     virtual int width() override;
     virtual int height() override;
@@ -27,9 +27,14 @@
 #include <SkMatrix.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+
 namespace android {
 namespace uirenderer {
 
+// Scale used for coincident stops, large enough to switch color within a pixel
+#define GRADIENT_HARD_STOP_SCALE 10000.0f
+
 ///////////////////////////////////////////////////////////////////////////////
 // Support
 ///////////////////////////////////////////////////////////////////////////////
@@ -47,10 +52,6 @@ static inline bool isPowerOfTwo(unsigned int n) {
     return !(n & (n - 1));
 }
 
-static inline void bindUniformColor(int slot, FloatColor color) {
-    glUniform4fv(slot, 1, reinterpret_cast<const float*>(&color));
-}
-
 static inline void bindTexture(Caches* caches, Texture* texture, GLenum wrapS, GLenum wrapT) {
     caches->textureState().bindTexture(texture->id);
     texture->setWrapST(wrapS, wrapT);
@@ -105,7 +106,33 @@ static void toSweepUnitMatrix(const float x, const float y, SkMatrix* matrix) {
 ///////////////////////////////////////////////////////////////////////////////
 
 static bool isSimpleGradient(const SkShader::GradientInfo& gradInfo) {
-    return gradInfo.fColorCount == 2 && gradInfo.fTileMode == SkShader::kClamp_TileMode;
+    return gradInfo.fColorCount >= 2 && gradInfo.fColorCount <= GRADIENT_MAX_SHADER_STOPS
+            && gradInfo.fTileMode == SkShader::kClamp_TileMode;
+}
+
+/**
+ * Fills in the uniforms read by stopGradient() in the fragment shader. Each
+ * stop after the first is mixed in over [start, start + 1 / scale]; unused
+ * stops repeat the last color so they have no effect.
+ */
+static void storeGradientStops(const SkShader::GradientInfo& gradInfo,
+        SkiaShaderData::GradientShaderData* outData) {
+    const int count = gradInfo.fColorCount;
+    for (int i = 0; i < GRADIENT_MAX_SHADER_STOPS; i++) {
+        outData->stopColors[i].set(gradInfo.fColors[std::min(i, count - 1)]);
+    }
+    for (int i = 1; i < GRADIENT_MAX_SHADER_STOPS; i++) {
+        if (i < count) {
+            float start = gradInfo.fColorOffsets[i - 1];
+            float length = gradInfo.fColorOffsets[i] - start;
+            outData->stopStarts[i - 1] = start;
+            // hard stops switch color instantly
+            outData->stopScales[i - 1] = length > 0.0f ? 1.0f / length : GRADIENT_HARD_STOP_SCALE;
+        } else {
+            outData->stopStarts[i - 1] = 1.0f;
+            outData->stopScales[i - 1] = 0.0f;
+        }
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -168,8 +195,7 @@ bool tryStoreGradient(Caches& caches, const SkShader& shader, const Matrix4 mode
         outData->gradientSampler = 0;
         outData->gradientTexture = nullptr;
 
-        outData->startColor.set(gradInfo.fColors[0]);
-        outData->endColor.set(gradInfo.fColors[1]);
+        storeGradientStops(gradInfo, outData);
     }
 
     outData->ditherSampler = (*textureUnit)++;
@@ -182,8 +208,11 @@ void applyGradient(Caches& caches, const SkiaShaderData::GradientShaderData& dat
         bindTexture(&caches, data.gradientTexture, data.wrapST, data.wrapST);
         glUniform1i(caches.program().getUniform("gradientSampler"), data.gradientSampler);
     } else {
-        bindUniformColor(caches.program().getUniform("startColor"), data.startColor);
-        bindUniformColor(caches.program().getUniform("endColor"), data.endColor);
+        Program& program = caches.program();
+        glUniform4fv(program.getUniform("stopColors"), GRADIENT_MAX_SHADER_STOPS,
+                reinterpret_cast<const float*>(&data.stopColors[0]));
+        glUniform3fv(program.getUniform("stopStarts"), 1, &data.stopStarts[0]);
+        glUniform3fv(program.getUniform("stopScales"), 1, &data.stopScales[0]);
     }
 
     // TODO: remove sampler slot incrementing from dither.setupProgram,
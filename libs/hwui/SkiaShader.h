@@ -34,6 +34,9 @@ class Layer;
 class Texture;
 struct ProgramDescription;
 
+// Clamped gradients with up to this many stops don't need a gradient texture
+#define GRADIENT_MAX_SHADER_STOPS 4
+
 /**
  * Type of Skia shader in use.
  *
@@ -64,9 +67,10 @@ struct SkiaShaderData {
         Matrix4 screenSpace;
         GLuint ditherSampler;
 
-        // simple gradient
-        FloatColor startColor;
-        FloatColor endColor;
+        // simple gradient, evaluated in the fragment shader
+        FloatColor stopColors[GRADIENT_MAX_SHADER_STOPS];
+        float stopStarts[GRADIENT_MAX_SHADER_STOPS - 1];
+        float stopScales[GRADIENT_MAX_SHADER_STOPS - 1];
 
         // complex gradient
         Texture* gradientTexture;
@@ -57,6 +57,7 @@
 #include "SpotShadow.h"
 #include "Vertex.h"
 #include "VertexBuffer.h"
+#include "utils/Float4.h"
 #include "utils/MathUtils.h"
 
 // TODO: After we settle down the new algorithm, we can remove the old one and
@@ -67,18 +68,6 @@ namespace uirenderer {
 
 static const float EPSILON = 1e-7;
 
-/**
- * For each polygon's vertex, the light center will project it to the receiver
- * as one of the outline vertex.
- * For each outline vertex, we need to store the position and normal.
- * Normal here is defined against the edge by the current vertex and the next vertex.
- */
-struct OutlineData {
-    Vector2 position;
-    Vector2 normal;
-    float radius;
-};
-
 /**
  * For each vertex, we need to keep track of its angle, whether it is penumbra or
  * umbra, and its corresponding vertex index.
@@ -378,6 +367,36 @@ float SpotShadow::projectCasterToOutline(Vector2& outline,
     return ratioZ;
 }
 
+void SpotShadow::projectCasterToOutlines(const Vector3& lightCenter, float lightSize,
+        const Vector3* poly, int polyLength, Vector2* outlinePositions, float* outlineRadii) {
+    int i = 0;
+#ifdef HAS_FLOAT4
+    const Float4 zero = Float4::splat(0.0f);
+    const Float4 ratioCap = Float4::splat(CASTER_Z_CAP_RATIO);
+    const Float4 lightX = Float4::splat(lightCenter.x);
+    const Float4 lightY = Float4::splat(lightCenter.y);
+    const Float4 lightZ = Float4::splat(lightCenter.z);
+    const Float4 radiusScale = Float4::splat(lightSize);
+    for (; i + 4 <= polyLength; i += 4) {
+        Float4 x, y, z;
+        Float4::loadXYZ(&poly[i].x, x, y, z);
+        // Same as projectCasterToOutline(): vertices at or below the receiver get
+        // 0, and vertices at the height of the light get the cap, instead of what
+        // the division by 0 gives, which is NaN with the ARMv7 reciprocal.
+        Float4 lightToPolyZ = lightZ - z;
+        Float4 ratioZ = Float4::min(Float4::max(z / lightToPolyZ, zero), ratioCap);
+        ratioZ = Float4::selectIfZero(lightToPolyZ, ratioCap, ratioZ);
+        Float4::storeXY(&outlinePositions[i].x,
+                x - ratioZ * (lightX - x), y - ratioZ * (lightY - y));
+        (ratioZ * radiusScale).store(&outlineRadii[i]);
+    }
+#endif
+    for (; i < polyLength; i++) {
+        float ratioZ = projectCasterToOutline(outlinePositions[i], lightCenter, poly[i]);
+        outlineRadii[i] = ratioZ * lightSize;
+    }
+}
+
 /**
  * Generate the shadow spot light of shape lightPoly and a object poly
  *
@@ -402,7 +421,15 @@ void SpotShadow::createSpotShadow(bool isCasterOpaque, const Vector3& lightCente
 #endif
         return;
     }
-    OutlineData outlineData[polyLength];
+    // For each polygon's vertex, the light center will project it to the receiver
+    // as one of the outline vertex. Each outline vertex has a position, a radius
+    // and a normal. Normal here is defined against the edge by the current vertex
+    // and the next vertex.
+    // These are kept in separate arrays so that they can be computed 4 vertices
+    // at a time.
+    Vector2 outlinePositions[polyLength];
+    Vector2 outlineNormals[polyLength];
+    float outlineRadii[polyLength];
     Vector2 outlineCentroid;
     // Calculate the projected outline for each polygon's vertices from the light center.
     //
@@ -418,25 +445,27 @@ void SpotShadow::createSpotShadow(bool isCasterOpaque, const Vector3& lightCente
     // Outline.x = Poly.x - Ratio * (Light.x - Poly.x)
     // Outline's radius / Light's radius = Ratio
 
-    // Compute the last outline vertex to make sure we can get the normal and outline
-    // in one single loop.
-    projectCasterToOutline(outlineData[polyLength - 1].position, lightCenter,
-            poly[polyLength - 1]);
+    projectCasterToOutlines(lightCenter, lightSize, poly, polyLength,
+            outlinePositions, outlineRadii);
 
     // Take the outline's polygon, calculate the normal for each outline edge.
-    int currentNormalIndex = polyLength - 1;
-    int nextNormalIndex = 0;
-
-    for (int i = 0; i < polyLength; i++) {
-        float ratioZ = projectCasterToOutline(outlineData[i].position,
-                lightCenter, poly[i]);
-        outlineData[i].radius = ratioZ * lightSize;
-
-        outlineData[currentNormalIndex].normal = ShadowTessellator::calculateNormal(
-                outlineData[currentNormalIndex].position,
-                outlineData[nextNormalIndex].position);
-        currentNormalIndex = (currentNormalIndex + 1) % polyLength;
-        nextNormalIndex++;
+    int i = 0;
+#ifdef HAS_FLOAT4
+    const Float4 zero = Float4::splat(0.0f);
+    for (; i + 4 < polyLength; i += 4) {
+        Float4 x, y, nextX, nextY;
+        Float4::loadXY(&outlinePositions[i].x, x, y);
+        Float4::loadXY(&outlinePositions[i + 1].x, nextX, nextY);
+        Float4 deltaX = nextX - x;
+        Float4 deltaY = nextY - y;
+        Float4::normalize(deltaX, deltaY);
+        // Same as ShadowTessellator::calculateNormal(), CCW 90 rotate to the delta.
+        Float4::storeXY(&outlineNormals[i].x, zero - deltaY, deltaX);
+    }
+#endif
+    for (; i < polyLength; i++) {
+        outlineNormals[i] = ShadowTessellator::calculateNormal(outlinePositions[i],
+                outlinePositions[(i + 1) % polyLength]);
     }
 
     projectCasterToOutline(outlineCentroid, lightCenter, polyCentroid);
@@ -457,7 +486,7 @@ void SpotShadow::createSpotShadow(bool isCasterOpaque, const Vector3& lightCente
     // We need the minimal of RaitoVI to decrease the spot shadow strength accordingly.
     float minRaitoVI = FLT_MAX;
 
-    for (int i = 0; i < polyLength; i++) {
+    for (i = 0; i < polyLength; i++) {
         // Generate all the penumbra's vertices only using the (outline vertex + normal * radius)
         // There is no guarantee that the penumbra is still convex, but for
         // each outline vertex, it will connect to all its corresponding penumbra vertices as
@@ -482,8 +511,8 @@ void SpotShadow::createSpotShadow(bool isCasterOpaque, const Vector3& lightCente
         //       (V3)-----------------------------------(V2)
         int preNormalIndex = (i + polyLength - 1) % polyLength;
 
-        const Vector2& previousNormal = outlineData[preNormalIndex].normal;
-        const Vector2& currentNormal = outlineData[i].normal;
+        const Vector2& previousNormal = outlineNormals[preNormalIndex];
+        const Vector2& currentNormal = outlineNormals[i];
 
         // Depending on how roundness we want for each corner, we can subdivide
         // further here and/or introduce some heuristic to decide how much the
@@ -506,8 +535,7 @@ void SpotShadow::createSpotShadow(bool isCasterOpaque, const Vector3& lightCente
                     (previousNormal * (currentCornerSliceNumber - k) + currentNormal * k) /
                     currentCornerSliceNumber;
             avgNormal.normalize();
-            penumbra[penumbraIndex++] = outlineData[i].position +
-                    avgNormal * outlineData[i].radius;
+            penumbra[penumbraIndex++] = outlinePositions[i] + avgNormal * outlineRadii[i];
         }
 
 
@@ -537,14 +565,14 @@ void SpotShadow::createSpotShadow(bool isCasterOpaque, const Vector3& lightCente
         // become lighter in this case.
         // The ratio can be simulated by using the inverse of maximum of ratioVI for
         // all (V).
-        float distOutline = (outlineData[i].position - outlineCentroid).length();
+        float distOutline = (outlinePositions[i] - outlineCentroid).length();
         if (CC_UNLIKELY(distOutline == 0)) {
             // If the outline has 0 area, then there is no spot shadow anyway.
             ALOGW("Outline has 0 area, no spot shadow!");
             return;
         }
 
-        float ratioVI = outlineData[i].radius / distOutline;
+        float ratioVI = outlineRadii[i] / distOutline;
         minRaitoVI = MathUtils::min(minRaitoVI, ratioVI);
         if (ratioVI >= (1 - FAKE_UMBRA_SIZE_RATIO)) {
             ratioVI = (1 - FAKE_UMBRA_SIZE_RATIO);
@@ -553,7 +581,7 @@ void SpotShadow::createSpotShadow(bool isCasterOpaque, const Vector3& lightCente
         // values below. But we can't skip the loop yet since we want to know the
         // maximum ratio.
         float ratioIC = 1 - ratioVI;
-        umbra[i] = outlineData[i].position * ratioIC + outlineCentroid * ratioVI;
+        umbra[i] = outlinePositions[i] * ratioIC + outlineCentroid * ratioVI;
     }
 
     hasValidUmbra = (minRaitoVI <= 1.0);
@@ -563,7 +591,7 @@ void SpotShadow::createSpotShadow(bool isCasterOpaque, const Vector3& lightCente
         ALOGW("The object is too close to the light or too small, no real umbra!");
 #endif
         for (int i = 0; i < polyLength; i++) {
-            umbra[i] = outlineData[i].position * FAKE_UMBRA_SIZE_RATIO +
+            umbra[i] = outlinePositions[i] * FAKE_UMBRA_SIZE_RATIO +
                     outlineCentroid * (1 - FAKE_UMBRA_SIZE_RATIO);
         }
         shadowStrengthScale = 1.0 / minRaitoVI;
@@ -794,10 +822,23 @@ inline void genNewPenumbraAndPairWithUmbra(const Vector2* penumbra, int penumbra
 // Precompute all the polygon's vector, return true if the reference cross product is positive.
 inline bool genPolyToCentroid(const Vector2* poly2d, int polyLength,
         const Vector2& centroid, Vector2* polyToCentroid) {
-    for (int j = 0; j < polyLength; j++) {
+    // Normalize these vectors such that we can use epsilon comparison after
+    // computing their cross products with another normalized vector.
+    int j = 0;
+#ifdef HAS_FLOAT4
+    const Float4 centroidX = Float4::splat(centroid.x);
+    const Float4 centroidY = Float4::splat(centroid.y);
+    for (; j + 4 <= polyLength; j += 4) {
+        Float4 x, y;
+        Float4::loadXY(&poly2d[j].x, x, y);
+        x = x - centroidX;
+        y = y - centroidY;
+        Float4 scale = Float4::inverseSqrt(x * x + y * y);
+        Float4::storeXY(&polyToCentroid[j].x, x * scale, y * scale);
+    }
+#endif
+    for (; j < polyLength; j++) {
         polyToCentroid[j] = poly2d[j] - centroid;
-        // Normalize these vectors such that we can use epsilon comparison after
-        // computing their cross products with another normalized vector.
         polyToCentroid[j].normalize();
     }
     float refCrossProduct = 0;
@@ -31,12 +31,23 @@ public:
             float lightSize, const Vector3* poly, int polyLength,
             const Vector3& polyCentroid, VertexBuffer& retstrips);
 
-private:
-    struct VertexAngleData;
-
+    /**
+     * Projects a caster vertex onto the receiver from the light center, and
+     * returns the ratio of the outline radius to the light radius.
+     */
     static float projectCasterToOutline(Vector2& outline,
             const Vector3& lightCenter, const Vector3& polyVertex);
 
+    /**
+     * Projects all the caster vertices like projectCasterToOutline(), 4 at a
+     * time where Float4 is available, and scales the ratios by lightSize.
+     */
+    static void projectCasterToOutlines(const Vector3& lightCenter, float lightSize,
+            const Vector3* poly, int polyLength, Vector2* outlinePositions, float* outlineRadii);
+
+private:
+    struct VertexAngleData;
+
     static void computeLightPolygon(int points, const Vector3& lightCenter,
             float size, Vector3* ret);
 
@@ -22,10 +22,12 @@
 #include "PathTessellator.h"
 #include "ShadowTessellator.h"
 #include "TessellationCache.h"
+#include "renderstate/RenderState.h"
 
 #include "thread/Signal.h"
 #include "thread/Task.h"
 #include "thread/TaskProcessor.h"
+#include "utils/MathUtils.h"
 
 namespace android {
 namespace uirenderer {
@@ -126,11 +128,15 @@ class TessellationCache::Buffer {
 public:
     Buffer(const sp<Task<VertexBuffer*> >& task)
             : mTask(task)
-            , mBuffer(nullptr) {
+            , mBuffer(nullptr)
+            , mMeshState(nullptr) {
     }
 
     ~Buffer() {
         mTask.clear();
+        if (mMeshState) {
+            mMeshState->deleteMeshBuffer(mBuffer->getBufferObject());
+        }
         delete mBuffer;
     }
 
@@ -139,8 +145,15 @@ public:
         return mBuffer->getSize();
     }
 
-    const VertexBuffer* getVertexBuffer() {
+    // Cached buffers are drawn over many frames, so the vertices are uploaded
+    // to a VBO the first time the buffer is drawn instead of on every draw
+    const VertexBuffer* getVertexBuffer(MeshState& meshState) {
         blockOnPrecache();
+        if (!mMeshState && mBuffer->getVertexCount()) {
+            mMeshState = &meshState;
+            mBuffer->setBufferObject(meshState.createStaticMeshBuffer(
+                    mBuffer->getBuffer(), mBuffer->getSize()));
+        }
         return mBuffer;
     }
 
@@ -154,6 +167,7 @@ private:
     }
     sp<Task<VertexBuffer*> > mTask;
     VertexBuffer* mBuffer;
+    MeshState* mMeshState;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -305,8 +319,9 @@ public:
 // Cache constructor/destructor
 ///////////////////////////////////////////////////////////////////////////////
 
-TessellationCache::TessellationCache()
-        : mSize(0)
+TessellationCache::TessellationCache(RenderState& renderState)
+        : mRenderState(renderState)
+        , mSize(0)
         , mMaxSize(MB(DEFAULT_VERTEX_CACHE_SIZE))
         , mCache(LruCache<Description, Buffer*>::kUnlimitedCapacity)
         , mShadowCache(LruCache<ShadowDescription, Task<vertexBuffer_pair_t*>*>::kUnlimitedCapacity) {
@@ -363,11 +378,13 @@ void TessellationCache::trim() {
         mCache.removeOldest();
     }
     mShadowCache.clear();
+    clearTreeShadows();
 }
 
 void TessellationCache::clear() {
     mCache.clear();
     mShadowCache.clear();
+    clearTreeShadows();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -390,14 +407,20 @@ void TessellationCache::precacheShadows(const Matrix4* drawTransform, const Rect
     ShadowDescription key(casterPerimeter, drawTransform);
 
     if (mShadowCache.get(key)) return;
-    sp<ShadowTask> task = new ShadowTask(drawTransform, localClip, opaque,
+    // the tree shadow keeps the ref it held in mTreeShadows
+    Task<vertexBuffer_pair_t*>* task = adoptTreeShadows(drawTransform, localClip, opaque,
             casterPerimeter, transformXY, transformZ, lightCenter, lightRadius);
-    if (mShadowProcessor == nullptr) {
-        mShadowProcessor = new ShadowProcessor(Caches::getInstance());
+    if (!task) {
+        sp<ShadowTask> newTask = new ShadowTask(drawTransform, localClip, opaque,
+                casterPerimeter, transformXY, transformZ, lightCenter, lightRadius);
+        if (mShadowProcessor == nullptr) {
+            mShadowProcessor = new ShadowProcessor(Caches::getInstance());
+        }
+        mShadowProcessor->add(newTask);
+        newTask->incStrong(nullptr); // not using sp<>s, so manually ref while in the cache
+        task = newTask.get();
     }
-    mShadowProcessor->add(task);
-    task->incStrong(nullptr); // not using sp<>s, so manually ref while in the cache
-    mShadowCache.put(key, task.get());
+    mShadowCache.put(key, task);
 }
 
 void TessellationCache::getShadowBuffers(const Matrix4* drawTransform, const Rect& localClip,
@@ -415,6 +438,66 @@ void TessellationCache::getShadowBuffers(const Matrix4* drawTransform, const Rec
     outBuffers = *(task->getResult());
 }
 
+void TessellationCache::precacheTreeShadows(const Matrix4* drawTransform, const Rect& localClip,
+        bool opaque, const SkPath* casterPerimeter,
+        const Matrix4* transformXY, const Matrix4* transformZ,
+        const Vector3& lightCenter, float lightRadius) {
+    sp<ShadowTask> task = new ShadowTask(drawTransform, localClip, opaque,
+            casterPerimeter, transformXY, transformZ, lightCenter, lightRadius);
+    if (mShadowProcessor == nullptr) {
+        mShadowProcessor = new ShadowProcessor(Caches::getInstance());
+    }
+    // may be wasted if the shadow isn't adopted, so let the tasks of the frame go first
+    mShadowProcessor->add(task, TaskPriority::Prefetch);
+    task->incStrong(nullptr); // not using sp<>s, so manually ref until adopted or cleared
+    mTreeShadows.push({casterPerimeter, task.get()});
+}
+
+void TessellationCache::clearTreeShadows() {
+    for (size_t i = 0; i < mTreeShadows.size(); i++) {
+        mTreeShadows[i].task->decStrong(nullptr);
+    }
+    mTreeShadows.clear();
+}
+
+static bool areNearlyEqual(const Matrix4& a, const Matrix4& b) {
+    for (int i = 0; i < 16; i++) {
+        if (!MathUtils::areEqual(a.data[i], b.data[i])) return false;
+    }
+    return true;
+}
+
+static bool areNearlyEqual(const Vector3& a, const Vector3& b) {
+    return MathUtils::areEqual(a.x, b.x)
+            && MathUtils::areEqual(a.y, b.y)
+            && MathUtils::areEqual(a.z, b.z);
+}
+
+Task<TessellationCache::vertexBuffer_pair_t*>*
+TessellationCache::adoptTreeShadows(const Matrix4* drawTransform,
+        const Rect& localClip, bool opaque, const SkPath* casterPerimeter,
+        const Matrix4* transformXY, const Matrix4* transformZ,
+        const Vector3& lightCenter, float lightRadius) {
+    for (size_t i = 0; i < mTreeShadows.size(); i++) {
+        if (mTreeShadows[i].casterPerimeter != casterPerimeter) continue;
+
+        // The tree only predicts the transforms, which may differ by rounding errors. Its
+        // local clip must cover the actual one, since the clip rejects parts of the shadows.
+        ShadowTask* t = static_cast<ShadowTask*>(mTreeShadows[i].task);
+        if (t->opaque == opaque
+                && t->lightRadius == lightRadius
+                && t->localClip.contains(localClip)
+                && areNearlyEqual(t->lightCenter, lightCenter)
+                && areNearlyEqual(t->drawTransform, *drawTransform)
+                && areNearlyEqual(t->transformXY, *transformXY)
+                && areNearlyEqual(t->transformZ, *transformZ)) {
+            mTreeShadows.removeAt(i);
+            return t;
+        }
+    }
+    return nullptr;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Tessellation precaching
 ///////////////////////////////////////////////////////////////////////////////
@@ -478,7 +561,8 @@ TessellationCache::Buffer* TessellationCache::getRoundRectBuffer(
 }
 const VertexBuffer* TessellationCache::getRoundRect(const Matrix4& transform, const SkPaint& paint,
         float width, float height, float rx, float ry) {
-    return getRoundRectBuffer(transform, paint, width, height, rx, ry)->getVertexBuffer();
+    return getRoundRectBuffer(transform, paint, width, height, rx, ry)
+            ->getVertexBuffer(mRenderState.meshState());
 }
 
 }; // namespace uirenderer
@@ -35,6 +35,7 @@ namespace android {
 namespace uirenderer {
 
 class Caches;
+class RenderState;
 class VertexBuffer;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -84,7 +85,7 @@ public:
         hash_t hash() const;
     };
 
-    TessellationCache();
+    TessellationCache(RenderState& renderState);
     ~TessellationCache();
 
     /**
@@ -139,6 +140,22 @@ public:
             const Vector3& lightCenter, float lightRadius,
             vertexBuffer_pair_t& outBuffers);
 
+    /**
+     * Queues the shadows of a caster while the tree is prepared, so that the shadows of all
+     * the casters of a frame tessellate on the worker threads ahead of the draw.
+     *
+     * The drawTransform of the caster can only be predicted at that point, precacheShadows()
+     * adopts the tree shadow of the same caster if its inputs are nearly identical instead of
+     * queuing its own task. Tree shadows that aren't adopted are dropped by trim() and
+     * clearTreeShadows().
+     */
+    void precacheTreeShadows(const Matrix4* drawTransform, const Rect& localClip,
+            bool opaque, const SkPath* casterPerimeter,
+            const Matrix4* transformXY, const Matrix4* transformZ,
+            const Vector3& lightCenter, float lightRadius);
+
+    void clearTreeShadows();
+
 private:
     class Buffer;
     class TessellationTask;
@@ -153,6 +170,13 @@ private:
 
     Buffer* getOrCreateBuffer(const Description& entry, Tessellator tessellator);
 
+    Task<vertexBuffer_pair_t*>* adoptTreeShadows(const Matrix4* drawTransform,
+            const Rect& localClip, bool opaque, const SkPath* casterPerimeter,
+            const Matrix4* transformXY, const Matrix4* transformZ,
+            const Vector3& lightCenter, float lightRadius);
+
+    RenderState& mRenderState;
+
     uint32_t mSize;
     uint32_t mMaxSize;
 
@@ -184,6 +208,14 @@ private:
     };
     BufferPairRemovedListener mBufferPairRemovedListener;
 
+    // holds a pointer, and implicit strong ref to each shadow task queued from the tree
+    // that hasn't been adopted yet, there are few enough casters per frame to search linearly
+    struct TreeShadow {
+        const SkPath* casterPerimeter;
+        Task<vertexBuffer_pair_t*>* task;
+    };
+    Vector<TreeShadow> mTreeShadows;
+
 }; // class TessellationCache
 
 }; // namespace uirenderer
@@ -98,7 +98,8 @@ int ShadowText::compare(const ShadowText& lhs, const ShadowText& rhs) {
 
 TextDropShadowCache::TextDropShadowCache():
         mCache(LruCache<ShadowText, ShadowTexture*>::kUnlimitedCapacity),
-        mSize(0), mMaxSize(MB(DEFAULT_DROP_SHADOW_CACHE_SIZE)) {
+        mSize(0), mMaxSize(MB(DEFAULT_DROP_SHADOW_CACHE_SIZE)),
+        mHitCount(0), mMissCount(0) {
     char property[PROPERTY_VALUE_MAX];
     if (property_get(PROPERTY_DROP_SHADOW_CACHE_SIZE, property, nullptr) > 0) {
         INIT_LOGD("  Setting drop shadow cache size to %sMB", property);
@@ -113,7 +114,8 @@ TextDropShadowCache::TextDropShadowCache():
 
 TextDropShadowCache::TextDropShadowCache(uint32_t maxByteSize):
         mCache(LruCache<ShadowText, ShadowTexture*>::kUnlimitedCapacity),
-        mSize(0), mMaxSize(maxByteSize) {
+        mSize(0), mMaxSize(maxByteSize),
+        mHitCount(0), mMissCount(0) {
     init();
 }
 
@@ -174,6 +176,11 @@ ShadowTexture* TextDropShadowCache::get(const SkPaint* paint, const char* text,
         int numGlyphs, float radius, const float* positions) {
     ShadowText entry(paint, radius, len, text, positions);
     ShadowTexture* texture = mCache.get(entry);
+    if (texture) {
+        mHitCount++;
+    } else {
+        mMissCount++;
+    }
 
     if (!texture) {
         SkPaint paintCopy(*paint);
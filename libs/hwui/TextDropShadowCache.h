@@ -160,6 +160,12 @@ public:
      * Returns the current size of the cache in bytes.
      */
     uint32_t getSize();
+    /**
+     * Returns the number of lookups that found, or missed, an entry since
+     * the cache was created.
+     */
+    uint32_t getHitCount() const { return mHitCount; }
+    uint32_t getMissCount() const { return mMissCount; }
 
 private:
     void init();
@@ -168,6 +174,8 @@ private:
 
     uint32_t mSize;
     uint32_t mMaxSize;
+    uint32_t mHitCount;
+    uint32_t mMissCount;
     FontRenderer* mRenderer;
     bool mDebugEnabled;
 }; // class TextDropShadowCache
@@ -99,6 +99,13 @@ public:
      */
     void* isInUse = nullptr;
 
+    /**
+     * Key of the texture in the TextureCache, and number of times it was
+     * reused there. Reused textures get a second chance before eviction.
+     */
+    uint32_t cacheKey = 0;
+    uint32_t reuseCount = 0;
+
 private:
     /**
      * Last wrap modes set on this texture.
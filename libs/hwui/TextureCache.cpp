@@ -34,6 +34,11 @@
 namespace android {
 namespace uirenderer {
 
+// Reuses beyond this count don't buy a texture more second chances
+#define TEXTURE_MAX_REUSE_COUNT 8
+// Maximum number of textures spared while making room for a new one
+#define TEXTURE_MAX_SPARED_PER_EVICTION 4
+
 ///////////////////////////////////////////////////////////////////////////////
 // Constructors/destructor
 ///////////////////////////////////////////////////////////////////////////////
@@ -42,7 +47,11 @@ TextureCache::TextureCache()
         : mCache(LruCache<uint32_t, Texture*>::kUnlimitedCapacity)
         , mSize(0)
         , mMaxSize(MB(DEFAULT_TEXTURE_CACHE_SIZE))
+        , mHitCount(0)
+        , mMissCount(0)
         , mFlushRate(DEFAULT_TEXTURE_CACHE_FLUSH_RATE)
+        , mPixelBufferUploads(false)
+        , mUploadBuffer(0)
         , mAssetAtlas(nullptr) {
     char property[PROPERTY_VALUE_MAX];
     if (property_get(PROPERTY_TEXTURE_CACHE_SIZE, property, nullptr) > 0) {
@@ -61,6 +70,9 @@ TextureCache::TextureCache()
                 DEFAULT_TEXTURE_CACHE_FLUSH_RATE * 100.0f);
     }
 
+    mPixelBufferUploads = property_get_bool(PROPERTY_TEXTURE_CACHE_PBO_UPLOADS, false);
+    INIT_LOGD("  Texture uploads through PBOs %s", mPixelBufferUploads ? "enabled" : "disabled");
+
     mCache.setOnEntryRemovedListener(this);
 
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &mMaxTextureSize);
@@ -87,8 +99,8 @@ uint32_t TextureCache::getMaxSize() {
 
 void TextureCache::setMaxSize(uint32_t maxSize) {
     mMaxSize = maxSize;
-    while (mSize > mMaxSize) {
-        mCache.removeOldest();
+    // Reserved sizes can't be evicted
+    while (mSize > mMaxSize && mCache.removeOldest()) {
     }
 }
 
@@ -122,6 +134,20 @@ void TextureCache::setAssetAtlas(AssetAtlas* assetAtlas) {
     mAssetAtlas = assetAtlas;
 }
 
+bool TextureCache::reserve(uint32_t size) {
+    if (size >= mMaxSize || !makeRoom(size)) {
+        return false;
+    }
+    mSize += size;
+    TEXTURE_LOGD("TextureCache::reserve: size, mSize = %d, %d", size, mSize);
+    return true;
+}
+
+void TextureCache::unreserve(uint32_t size) {
+    mSize -= size;
+    TEXTURE_LOGD("TextureCache::unreserve: size, mSize = %d, %d", size, mSize);
+}
+
 void TextureCache::resetMarkInUse(void* ownerToken) {
     LruCache<uint32_t, Texture*>::Iterator iter(mCache);
     while (iter.next()) {
@@ -150,7 +176,13 @@ Texture* TextureCache::getCachedTexture(const SkBitmap* bitmap, AtlasUsageType a
         }
     }
 
-    Texture* texture = mCache.get(bitmap->pixelRef()->getStableID());
+    const uint32_t key = bitmap->pixelRef()->getStableID();
+    Texture* texture = mCache.get(key);
+    if (texture) {
+        mHitCount++;
+    } else {
+        mMissCount++;
+    }
 
     if (!texture) {
         if (!canMakeTextureFromBitmap(bitmap)) {
@@ -158,20 +190,13 @@ Texture* TextureCache::getCachedTexture(const SkBitmap* bitmap, AtlasUsageType a
         }
 
         const uint32_t size = bitmap->rowBytes() * bitmap->height();
-        bool canCache = size < mMaxSize;
         // Don't even try to cache a bitmap that's bigger than the cache
-        while (canCache && mSize + size > mMaxSize) {
-            Texture* oldest = mCache.peekOldestValue();
-            if (oldest && !oldest->isInUse) {
-                mCache.removeOldest();
-            } else {
-                canCache = false;
-            }
-        }
+        bool canCache = size < mMaxSize && makeRoom(size);
 
         if (canCache) {
             texture = new Texture(Caches::getInstance());
             texture->bitmapSize = size;
+            texture->cacheKey = key;
             generateTexture(bitmap, texture, false);
 
             mSize += size;
@@ -180,18 +205,49 @@ Texture* TextureCache::getCachedTexture(const SkBitmap* bitmap, AtlasUsageType a
             if (mDebugEnabled) {
                 ALOGD("Texture created, size = %d", size);
             }
-            mCache.put(bitmap->pixelRef()->getStableID(), texture);
+            mCache.put(key, texture);
         }
     } else if (!texture->isInUse && bitmap->getGenerationID() != texture->generation) {
         // Texture was in the cache but is dirty, re-upload
         // TODO: Re-adjust the cache size if the bitmap's dimensions have changed
         generateTexture(bitmap, texture, true);
+    } else if (texture->reuseCount < TEXTURE_MAX_REUSE_COUNT) {
+        texture->reuseCount++;
+    } else if (CC_LIKELY(mAssetAtlas != nullptr) && atlasUsageType == AtlasUsageType::Use) {
+        // Drawn often enough to be worth packing into a dynamic atlas page. Asked
+        // on each use, so bitmaps dropped by a recycled page get packed again
+        mAssetAtlas->requestDynamicEntry(bitmap);
     }
 
     return texture;
 }
 
+bool TextureCache::makeRoom(uint32_t size) {
+    int spared = 0;
+    while (mSize + size > mMaxSize) {
+        Texture* oldest = mCache.peekOldestValue();
+        if (!oldest || oldest->isInUse) {
+            return false;
+        }
+
+        if (oldest->reuseCount > 0 && spared < TEXTURE_MAX_SPARED_PER_EVICTION) {
+            // Give reused textures a second chance, each time with half of
+            // their credit. get() moves the texture to the young end
+            oldest->reuseCount >>= 1;
+            mCache.get(oldest->cacheKey);
+            spared++;
+        } else {
+            mCache.removeOldest();
+        }
+    }
+    return true;
+}
+
 bool TextureCache::prefetchAndMarkInUse(void* ownerToken, const SkBitmap* bitmap) {
+    if (CC_LIKELY(mAssetAtlas != nullptr) && mAssetAtlas->getDynamicEntry(bitmap)) {
+        // Atlas pages are never evicted within a frame
+        return true;
+    }
     Texture* texture = getCachedTexture(bitmap, AtlasUsageType::Use);
     if (texture) {
         texture->isInUse = ownerToken;
@@ -228,15 +284,26 @@ void TextureCache::clearGarbage() {
     for (size_t i = 0; i < count; i++) {
         uint32_t pixelRefId = mGarbage.itemAt(i);
         mCache.remove(pixelRefId);
+        if (mAssetAtlas) {
+            mAssetAtlas->releaseDynamicEntry(pixelRefId);
+        }
     }
     mGarbage.clear();
 }
 
 void TextureCache::clear() {
     mCache.clear();
+    deleteUploadBuffer();
     TEXTURE_LOGD("TextureCache:clear(), mSize = %d", mSize);
 }
 
+void TextureCache::deleteUploadBuffer() {
+    if (mUploadBuffer) {
+        glDeleteBuffers(1, &mUploadBuffer);
+        mUploadBuffer = 0;
+    }
+}
+
 void TextureCache::flush() {
     if (mFlushRate >= 1.0f || mCache.size() == 0) return;
     if (mFlushRate <= 0.0f) {
@@ -247,8 +314,7 @@ void TextureCache::flush() {
     uint32_t targetSize = uint32_t(mSize * mFlushRate);
     TEXTURE_LOGD("TextureCache::flush: target size: %d", targetSize);
 
-    while (mSize > targetSize) {
-        mCache.removeOldest();
+    while (mSize > targetSize && mCache.removeOldest()) {
     }
 }
 
@@ -336,9 +402,58 @@ void TextureCache::uploadLoFiTexture(bool resize, const SkBitmap* bitmap,
             width, height, GL_UNSIGNED_BYTE, rgbaBitmap.getPixels());
 }
 
+bool TextureCache::uploadThroughPixelBuffer(bool resize, GLenum format, GLsizei stride,
+        GLsizei bpp, GLsizei width, GLsizei height, GLenum type, const GLvoid * data) {
+    if (!mUploadBuffer) {
+        glGenBuffers(1, &mUploadBuffer);
+    }
+
+    PixelBufferState& pixelBufferState = Caches::getInstance().pixelBufferState();
+    pixelBufferState.bind(mUploadBuffer);
+
+    // Orphan the previous contents, the driver may still be transferring them
+    const GLsizeiptr size = width * height * bpp;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    uint8_t* dst = (uint8_t*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!dst) {
+        pixelBufferState.unbind();
+        return false;
+    }
+
+    // The staging buffer is tightly packed, which also takes care of the stride
+    const uint8_t* src = (const uint8_t*) data;
+    for (GLsizei i = 0; i < height; i++) {
+        memcpy(dst, src, width * bpp);
+        dst += width * bpp;
+        src += stride * bpp;
+    }
+
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE) {
+        ALOGE("Corrupted texture upload buffer");
+        pixelBufferState.unbind();
+        return false;
+    }
+
+    if (resize) {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type, nullptr);
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, nullptr);
+    }
+
+    pixelBufferState.unbind();
+    return true;
+}
+
 void TextureCache::uploadToTexture(bool resize, GLenum format, GLsizei stride, GLsizei bpp,
         GLsizei width, GLsizei height, GLenum type, const GLvoid * data) {
     glPixelStorei(GL_UNPACK_ALIGNMENT, bpp);
+
+    if (mPixelBufferUploads && Caches::getInstance().gpuPixelBuffersEnabled
+            && uploadThroughPixelBuffer(resize, format, stride, bpp, width, height, type, data)) {
+        return;
+    }
+
     const bool useStride = stride != width
             && Caches::getInstance().extensions().hasUnpackRowLength();
     if ((stride == width) || useStride) {
@@ -50,7 +50,9 @@ class AssetAtlas;
 /**
  * A simple LRU texture cache. The cache has a maximum size expressed in bytes.
  * Any texture added to the cache causing the cache to grow beyond the maximum
- * allowed size will also cause the oldest texture to be kicked out.
+ * allowed size will also cause the oldest texture to be kicked out, unless it
+ * was reused since it was added or last spared. This keeps bitmaps that are
+ * drawn repeatedly from being thrashed by a stream of one-off bitmaps.
  */
 class TextureCache : public OnEntryRemoved<uint32_t, Texture*> {
 public:
@@ -118,6 +120,12 @@ public:
      * Returns the current size of the cache in bytes.
      */
     uint32_t getSize();
+    /**
+     * Returns the number of lookups that found, or missed, an entry since
+     * the cache was created.
+     */
+    uint32_t getHitCount() const { return mHitCount; }
+    uint32_t getMissCount() const { return mMissCount; }
 
     /**
      * Partially flushes the cache. The amount of memory freed by a flush
@@ -132,6 +140,17 @@ public:
 
     void setAssetAtlas(AssetAtlas* assetAtlas);
 
+    /**
+     * Accounts size bytes of textures kept outside of the cache, like the
+     * dynamic atlas pages, against its budget, evicting textures to make
+     * room. Returns false if textures in use prevent it.
+     */
+    bool reserve(uint32_t size);
+    /**
+     * Gives back size bytes taken by reserve().
+     */
+    void unreserve(uint32_t size);
+
 private:
     enum class AtlasUsageType {
         Use,
@@ -154,17 +173,32 @@ private:
     void uploadLoFiTexture(bool resize, const SkBitmap* bitmap, uint32_t width, uint32_t height);
     void uploadToTexture(bool resize, GLenum format, GLsizei stride, GLsizei bpp,
             GLsizei width, GLsizei height, GLenum type, const GLvoid * data);
+    bool uploadThroughPixelBuffer(bool resize, GLenum format, GLsizei stride, GLsizei bpp,
+            GLsizei width, GLsizei height, GLenum type, const GLvoid * data);
+
+    /**
+     * Evicts textures until size more bytes fit in the cache. Returns false
+     * if textures in use prevent it.
+     */
+    bool makeRoom(uint32_t size);
+    void deleteUploadBuffer();
 
     LruCache<uint32_t, Texture*> mCache;
 
     uint32_t mSize;
     uint32_t mMaxSize;
+    uint32_t mHitCount;
+    uint32_t mMissCount;
     GLint mMaxTextureSize;
 
     float mFlushRate;
 
     bool mDebugEnabled;
 
+    // Staging buffer, see PROPERTY_TEXTURE_CACHE_PBO_UPLOADS
+    bool mPixelBufferUploads;
+    GLuint mUploadBuffer;
+
     Vector<uint32_t> mGarbage;
     mutable Mutex mLock;
 
@@ -59,6 +59,7 @@ public:
         : mode(mode)
         , prepareTextures(mode == MODE_FULL)
         , runAnimations(true)
+        , precacheShadows(false)
         , damageAccumulator(nullptr)
         , renderState(renderState)
         , renderer(nullptr)
@@ -70,6 +71,7 @@ public:
         : mode(mode)
         , prepareTextures(mode == MODE_FULL)
         , runAnimations(clone.runAnimations)
+        , precacheShadows(false)
         , damageAccumulator(clone.damageAccumulator)
         , renderState(clone.renderState)
         , renderer(clone.renderer)
@@ -87,6 +89,10 @@ public:
     // as this being otherwise wasted work as all the animators will be
     // re-evaluated when the frame is actually drawn
     bool runAnimations;
+    // Queue the tessellation of the shadows cast by the children of the nodes being
+    // prepared, see RenderNode::precacheChildShadows(). Cleared while preparing content
+    // that isn't drawn directly by the renderer, such as the content of layers.
+    bool precacheShadows;
 
     // Must not be null during actual usage
     DamageAccumulator* damageAccumulator;
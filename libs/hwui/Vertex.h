@@ -120,6 +120,26 @@ struct AlphaVertex {
 
 REQUIRE_COMPATIBLE_LAYOUT(AlphaVertex);
 
+/**
+ * Simple structure to describe an instance of a rect with bounds and a
+ * premultiplied color.
+ */
+struct RectInstance {
+    float left, top, right, bottom;
+    float r, g, b, a;
+
+    static inline void set(RectInstance* instance, float left, float top,
+            float right, float bottom, int color, float alpha) {
+        float a = alpha * ((color >> 24) & 0xff) / 255.0f;
+        float r = a * ((color >> 16) & 0xff) / 255.0f;
+        float g = a * ((color >>  8) & 0xff) / 255.0f;
+        float b = a * ((color) & 0xff) / 255.0f;
+        *instance = { left, top, right, bottom, r, g, b, a };
+    }
+}; // struct RectInstance
+
+REQUIRE_COMPATIBLE_LAYOUT(RectInstance);
+
 }; // namespace uirenderer
 }; // namespace android
 
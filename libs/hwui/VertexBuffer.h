@@ -19,6 +19,8 @@
 
 #include "utils/MathUtils.h"
 
+#include <GLES2/gl2.h>
+
 namespace android {
 namespace uirenderer {
 
@@ -39,6 +41,7 @@ public:
             , mAllocatedIndexCount(0)
             , mByteCount(0)
             , mMeshFeatureFlags(kNone)
+            , mBufferObject(0)
             , mReallocBuffer(nullptr)
             , mCleanupMethod(nullptr)
             , mCleanupIndexMethod(nullptr)
@@ -141,6 +144,14 @@ public:
 
     void setBounds(Rect bounds) { mBounds = bounds; }
 
+    /**
+     * Buffer object holding a copy of the vertices, or 0 if they only live in
+     * client memory. Set by owners of vertex buffers drawn over many frames,
+     * which are also responsible for deleting the buffer object.
+     */
+    GLuint getBufferObject() const { return mBufferObject; }
+    void setBufferObject(GLuint bufferObject) { mBufferObject = bufferObject; }
+
     template <class TYPE>
     void createDegenerateSeparators(int allocSize) {
         TYPE* end = (TYPE*)mBuffer + mVertexCount;
@@ -168,6 +179,7 @@ private:
     unsigned int mByteCount;
 
     MeshFeatureFlags mMeshFeatureFlags;
+    GLuint mBufferObject;
 
     void* mReallocBuffer; // used for multi-allocation
 
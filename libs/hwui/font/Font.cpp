@@ -33,16 +33,20 @@
 #include "../FontRenderer.h"
 #include "../PixelBuffer.h"
 #include "../Properties.h"
+#include "../utils/DistanceField.h"
 
 namespace android {
 namespace uirenderer {
 
+// Maximum number of glyphs rasterized by a single GlyphTask
+#define GLYPH_TASK_MAX_GLYPHS 32
+
 ///////////////////////////////////////////////////////////////////////////////
 // Font
 ///////////////////////////////////////////////////////////////////////////////
 
 Font::Font(FontRenderer* state, const Font::FontDescription& desc) :
-        mState(state), mDescription(desc) { }
+        mState(state), mDescription(desc), mDistanceFieldScale(1.0f) { }
 
 Font::FontDescription::FontDescription(const SkPaint* paint, const SkMatrix& rasterMatrix)
         : mLookupTransform(rasterMatrix) {
@@ -239,6 +243,25 @@ void Font::drawCachedGlyphBitmap(CachedGlyphInfo* glyph, int x, int y, uint8_t*
     }
 }
 
+void Font::drawCachedGlyphDistanceField(CachedGlyphInfo* glyph, int x, int y,
+        uint8_t* bitmap, uint32_t bitmapW, uint32_t bitmapH, Rect* bounds, const float* pos) {
+    float width = glyph->mBitmapWidth * mDistanceFieldScale;
+    float height = glyph->mBitmapHeight * mDistanceFieldScale;
+
+    float nPenX = x + glyph->mBitmapLeft * mDistanceFieldScale;
+    float nPenY = y + glyph->mBitmapTop * mDistanceFieldScale + height;
+
+    float u1 = glyph->mBitmapMinU;
+    float u2 = glyph->mBitmapMaxU;
+    float v1 = glyph->mBitmapMinV;
+    float v2 = glyph->mBitmapMaxV;
+
+    mState->appendMeshQuad(nPenX, nPenY, u1, v2,
+            nPenX + width, nPenY, u2, v2,
+            nPenX + width, nPenY - height, u2, v1,
+            nPenX, nPenY - height, u1, v1, glyph->mCacheTexture);
+}
+
 void Font::drawCachedGlyph(CachedGlyphInfo* glyph, float x, float hOffset, float vOffset,
         SkPathMeasure& measure, SkPoint* position, SkVector* tangent) {
     const float halfWidth = glyph->mBitmapWidth * 0.5f;
@@ -280,6 +303,14 @@ void Font::drawCachedGlyph(CachedGlyphInfo* glyph, float x, float hOffset, float
 }
 
 CachedGlyphInfo* Font::getCachedGlyph(const SkPaint* paint, glyph_t textUnit, bool precaching) {
+    if (CC_UNLIKELY(!mPendingGlyphs.isEmpty())) {
+        ssize_t index = mPendingGlyphs.indexOfKey(textUnit);
+        if (index >= 0) {
+            sp<GlyphTask> task = mPendingGlyphs.valueAt(index);
+            cachePendingGlyphs(paint, task, textUnit, precaching);
+        }
+    }
+
     CachedGlyphInfo* cachedGlyph = mCachedGlyphs.valueFor(textUnit);
     if (cachedGlyph) {
         // Is the glyph still in texture cache?
@@ -298,6 +329,15 @@ CachedGlyphInfo* Font::getCachedGlyph(const SkPaint* paint, glyph_t textUnit, bo
 
 void Font::render(const SkPaint* paint, const char *text, uint32_t start, uint32_t len,
             int numGlyphs, int x, int y, const float* positions) {
+    if (isDistanceField()) {
+        // The same glyphs serve every text size, scaled while building the mesh
+        mDistanceFieldScale = paint->getTextSize() / DISTANCE_FIELD_TEXT_SIZE;
+        SkPaint distanceFieldPaint(*paint);
+        setupDistanceFieldPaint(&distanceFieldPaint);
+        render(&distanceFieldPaint, text, start, len, numGlyphs, x, y, FRAMEBUFFER, nullptr,
+                0, 0, nullptr, positions);
+        return;
+    }
     render(paint, text, start, len, numGlyphs, x, y, FRAMEBUFFER, nullptr,
             0, 0, nullptr, positions);
 }
@@ -369,6 +409,12 @@ void Font::precache(const SkPaint* paint, const char* text, int numGlyphs) {
         return;
     }
 
+    // When worker threads are available, only the glyphs that aren't cached
+    // yet are collected here. They are rasterized in the background and packed
+    // in the cache textures when first drawn
+    GlyphProcessor* processor = mState->getGlyphProcessor();
+    sp<GlyphTask> task;
+
     int glyphsCount = 0;
     while (glyphsCount < numGlyphs) {
         glyph_t glyph = GET_GLYPH(text);
@@ -377,12 +423,120 @@ void Font::precache(const SkPaint* paint, const char* text, int numGlyphs) {
         if (IS_END_OF_STRING(glyph)) {
             break;
         }
-
-        getCachedGlyph(paint, glyph, true);
         glyphsCount++;
+
+        if (!processor) {
+            getCachedGlyph(paint, glyph, true);
+            continue;
+        }
+
+        CachedGlyphInfo* cachedGlyph = mCachedGlyphs.valueFor(glyph);
+        if ((cachedGlyph && cachedGlyph->mIsValid) || mPendingGlyphs.indexOfKey(glyph) >= 0) {
+            continue;
+        }
+
+        if (!task.get()) {
+            task = new GlyphTask(paint, mDescription.mLookupTransform, isDistanceField());
+        }
+        task->glyphs.push_back(glyph);
+        mPendingGlyphs.add(glyph, task);
+
+        // Split long runs so that all the workers get a share
+        if (task->glyphs.size() >= GLYPH_TASK_MAX_GLYPHS) {
+            processor->add(task);
+            task.clear();
+        }
+    }
+
+    if (task.get()) {
+        processor->add(task);
     }
 }
 
+void Font::cachePendingGlyphs(const SkPaint* paint, const sp<GlyphTask>& task,
+        glyph_t textUnit, bool precaching) {
+    task->getResult();
+
+    ssize_t requested = -1;
+    for (size_t i = 0; i < task->glyphs.size(); i++) {
+        glyph_t glyph = task->glyphs[i];
+        mPendingGlyphs.removeItem(glyph);
+
+        if (glyph == textUnit) {
+            requested = i;
+            continue;
+        }
+
+        // The other glyphs of the run are packed as if precaching, so that
+        // they can't flush the glyph that is about to be drawn
+        CachedGlyphInfo* cachedGlyph = mCachedGlyphs.valueFor(glyph);
+        if (!cachedGlyph) {
+            cachedGlyph = new CachedGlyphInfo();
+            cachedGlyph->mIsValid = false;
+            cachedGlyph->mGlyphIndex = task->skiaGlyphs[i].fID;
+            mCachedGlyphs.add(glyph, cachedGlyph);
+        }
+        if (!cachedGlyph->mIsValid) {
+            updateGlyphCache(paint, task->skiaGlyphs[i], nullptr, cachedGlyph, true);
+        }
+    }
+
+    if (requested >= 0) {
+        CachedGlyphInfo* cachedGlyph = mCachedGlyphs.valueFor(textUnit);
+        if (!cachedGlyph) {
+            cachedGlyph = new CachedGlyphInfo();
+            cachedGlyph->mIsValid = false;
+            cachedGlyph->mGlyphIndex = task->skiaGlyphs[requested].fID;
+            mCachedGlyphs.add(textUnit, cachedGlyph);
+        }
+        if (!cachedGlyph->mIsValid) {
+            updateGlyphCache(paint, task->skiaGlyphs[requested], nullptr, cachedGlyph, precaching);
+        }
+    }
+}
+
+void Font::GlyphProcessor::onProcess(const sp<Task<bool> >& task) {
+    ATRACE_NAME("Rasterize Glyphs");
+    GlyphTask* t = static_cast<GlyphTask*>(task.get());
+
+    SkDeviceProperties deviceProperties(kUnknown_SkPixelGeometry, 1.0f);
+    SkAutoGlyphCache autoCache(t->paint, &deviceProperties, &t->lookupTransform);
+    SkGlyphCache* skiaGlyphCache = autoCache.getCache();
+
+    const size_t count = t->glyphs.size();
+    std::vector<size_t> offsets(count, 0);
+    t->skiaGlyphs.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        const SkGlyph& skiaGlyph = GET_METRICS(skiaGlyphCache, t->glyphs[i]);
+        const void* image = skiaGlyphCache->findImage(skiaGlyph);
+
+        // The glyph stays owned by Skia's cache, only keep the metrics
+        SkGlyph& glyph = t->skiaGlyphs[i];
+        glyph = skiaGlyph;
+        glyph.fImage = nullptr;
+        glyph.fPath = nullptr;
+
+        offsets[i] = t->images.size();
+        if (!image) {
+            offsets[i] = SIZE_MAX;
+        } else if (!t->distanceField
+                || !appendDistanceField(skiaGlyph, image, &glyph, &t->images)) {
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(image);
+            t->images.insert(t->images.end(), src, src + skiaGlyph.computeImageSize());
+        }
+    }
+
+    // images doesn't grow anymore, the glyphs can point into it
+    for (size_t i = 0; i < count; i++) {
+        if (offsets[i] != SIZE_MAX) {
+            t->skiaGlyphs[i].fImage = &t->images[offsets[i]];
+        }
+    }
+
+    task->setResult(true);
+}
+
 void Font::render(const SkPaint* paint, const char* text, uint32_t start, uint32_t len,
         int numGlyphs, int x, int y, RenderMode mode, uint8_t *bitmap,
         uint32_t bitmapW, uint32_t bitmapH, Rect* bounds, const float* positions) {
@@ -398,7 +552,9 @@ void Font::render(const SkPaint* paint, const char* text, uint32_t start, uint32
             &android::uirenderer::Font::measureCachedGlyph,
             &android::uirenderer::Font::measureCachedGlyph
     };
-    RenderGlyph render = gRenderGlyph[(mode << 1) + !mIdentityTransform];
+    RenderGlyph render = isDistanceField() && mode == FRAMEBUFFER
+            ? &android::uirenderer::Font::drawCachedGlyphDistanceField
+            : gRenderGlyph[(mode << 1) + !mIdentityTransform];
 
     text += start;
     int glyphsCount = 0;
@@ -431,33 +587,46 @@ void Font::updateGlyphCache(const SkPaint* paint, const SkGlyph& skiaGlyph,
         SkGlyphCache* skiaGlyphCache, CachedGlyphInfo* glyph, bool precaching) {
     glyph->mAdvanceX = skiaGlyph.fAdvanceX;
     glyph->mAdvanceY = skiaGlyph.fAdvanceY;
-    glyph->mBitmapLeft = skiaGlyph.fLeft;
-    glyph->mBitmapTop = skiaGlyph.fTop;
     glyph->mLsbDelta = skiaGlyph.fLsbDelta;
     glyph->mRsbDelta = skiaGlyph.fRsbDelta;
 
     uint32_t startX = 0;
     uint32_t startY = 0;
 
-    // Get the bitmap for the glyph
-    if (!skiaGlyph.fImage) {
+    // Get the bitmap for the glyph, glyphs rasterized by a GlyphTask come with it,
+    // already converted to a distance field if needed
+    if (!skiaGlyph.fImage && skiaGlyphCache) {
         skiaGlyphCache->findImage(skiaGlyph);
     }
-    mState->cacheBitmap(skiaGlyph, glyph, &startX, &startY, precaching);
+    const SkGlyph* imageGlyph = &skiaGlyph;
+    SkGlyph distanceFieldGlyph;
+    std::vector<uint8_t> distanceFieldImage;
+    if (skiaGlyphCache && isDistanceField()) {
+        distanceFieldGlyph = skiaGlyph;
+        if (appendDistanceField(skiaGlyph, skiaGlyph.fImage,
+                &distanceFieldGlyph, &distanceFieldImage)) {
+            distanceFieldGlyph.fImage = distanceFieldImage.data();
+            imageGlyph = &distanceFieldGlyph;
+        }
+    }
+
+    glyph->mBitmapLeft = imageGlyph->fLeft;
+    glyph->mBitmapTop = imageGlyph->fTop;
+    mState->cacheBitmap(*imageGlyph, glyph, &startX, &startY, precaching, isDistanceField());
 
     if (!glyph->mIsValid) {
         return;
     }
 
-    uint32_t endX = startX + skiaGlyph.fWidth;
-    uint32_t endY = startY + skiaGlyph.fHeight;
+    uint32_t endX = startX + imageGlyph->fWidth;
+    uint32_t endY = startY + imageGlyph->fHeight;
 
     glyph->mStartX = startX;
     glyph->mStartY = startY;
-    glyph->mBitmapWidth = skiaGlyph.fWidth;
-    glyph->mBitmapHeight = skiaGlyph.fHeight;
+    glyph->mBitmapWidth = imageGlyph->fWidth;
+    glyph->mBitmapHeight = imageGlyph->fHeight;
 
-    bool empty = skiaGlyph.fWidth == 0 || skiaGlyph.fHeight == 0;
+    bool empty = imageGlyph->fWidth == 0 || imageGlyph->fHeight == 0;
     if (!empty) {
         uint32_t cacheWidth = glyph->mCacheTexture->getWidth();
         uint32_t cacheHeight = glyph->mCacheTexture->getHeight();
@@ -486,18 +655,62 @@ CachedGlyphInfo* Font::cacheGlyph(const SkPaint* paint, glyph_t glyph, bool prec
     return newGlyph;
 }
 
-Font* Font::create(FontRenderer* state, const SkPaint* paint, const SkMatrix& matrix) {
-    FontDescription description(paint, matrix);
+Font* Font::obtain(FontRenderer* state, const Font::FontDescription& description) {
     Font* font = state->mActiveFonts.get(description);
 
     if (!font) {
         font = new Font(state, description);
         state->mActiveFonts.put(description, font);
     }
+    return font;
+}
+
+Font* Font::create(FontRenderer* state, const SkPaint* paint, const SkMatrix& matrix) {
+    Font* font = obtain(state, FontDescription(paint, matrix));
     font->mIdentityTransform = matrix.isIdentity();
 
     return font;
 }
 
+Font* Font::createDistanceField(FontRenderer* state, const SkPaint* paint) {
+    SkPaint distanceFieldPaint(*paint);
+    setupDistanceFieldPaint(&distanceFieldPaint);
+
+    FontDescription description(&distanceFieldPaint, SkMatrix::I());
+    description.mFlags |= kDistanceField;
+
+    Font* font = obtain(state, description);
+    font->mIdentityTransform = true;
+
+    return font;
+}
+
+void Font::setupDistanceFieldPaint(SkPaint* paint) {
+    paint->setTextSize(DISTANCE_FIELD_TEXT_SIZE);
+    // Hinting would snap the outlines to the pixel grid of the base size only
+    paint->setHinting(SkPaint::kNo_Hinting);
+}
+
+bool Font::appendDistanceField(const SkGlyph& skiaGlyph, const void* src,
+        SkGlyph* glyph, std::vector<uint8_t>* image) {
+    // Color glyphs are only scaled, hard edged BW glyphs work as distance fields as they are
+    if (!src || skiaGlyph.fMaskFormat != SkMask::kA8_Format
+            || skiaGlyph.fWidth == 0 || skiaGlyph.fHeight == 0) {
+        return false;
+    }
+
+    glyph->fWidth = skiaGlyph.fWidth + 2 * DISTANCE_FIELD_SPREAD;
+    glyph->fHeight = skiaGlyph.fHeight + 2 * DISTANCE_FIELD_SPREAD;
+    glyph->fLeft = skiaGlyph.fLeft - DISTANCE_FIELD_SPREAD;
+    glyph->fTop = skiaGlyph.fTop - DISTANCE_FIELD_SPREAD;
+
+    const size_t offset = image->size();
+    image->resize(offset + glyph->computeImageSize(), 0);
+    DistanceField::generate(reinterpret_cast<const uint8_t*>(src), skiaGlyph.rowBytes(),
+            skiaGlyph.fWidth, skiaGlyph.fHeight, &(*image)[offset], glyph->rowBytes(),
+            DISTANCE_FIELD_SPREAD);
+    return true;
+}
+
 }; // namespace uirenderer
 }; // namespace android
@@ -30,6 +30,8 @@
 #include "FontUtil.h"
 #include "../Rect.h"
 #include "../Matrix.h"
+#include "../thread/Task.h"
+#include "../thread/TaskProcessor.h"
 
 namespace android {
 namespace uirenderer {
@@ -49,7 +51,8 @@ class FontRenderer;
 class Font {
 public:
     enum Style {
-        kFakeBold = 1
+        kFakeBold = 1,
+        kDistanceField = 2
     };
 
     struct FontDescription {
@@ -97,14 +100,70 @@ public:
      */
     static Font* create(FontRenderer* state, const SkPaint* paint, const SkMatrix& matrix);
 
+    /**
+     * Creates the distance field font drawing the text of the specified paint
+     * at any size and scale. Its glyphs are rasterized once, at
+     * DISTANCE_FIELD_TEXT_SIZE, and their distance fields are scaled when drawn.
+     */
+    static Font* createDistanceField(FontRenderer* state, const SkPaint* paint);
+
+    bool isDistanceField() const {
+        return mDescription.mFlags & kDistanceField;
+    }
+
 private:
     friend class FontRenderer;
 
     Font(FontRenderer* state, const Font::FontDescription& desc);
 
+    static Font* obtain(FontRenderer* state, const Font::FontDescription& desc);
+
+    // Turns a paint into the one distance field glyphs are rasterized and precached with
+    static void setupDistanceFieldPaint(SkPaint* paint);
+
+    /**
+     * Appends the distance field of the A8 image of skiaGlyph to image and
+     * updates the bounds and format of glyph to match, leaving glyph->fImage
+     * to the caller. Returns false, with both untouched, for other formats.
+     */
+    static bool appendDistanceField(const SkGlyph& skiaGlyph, const void* src,
+            SkGlyph* glyph, std::vector<uint8_t>* image);
+
     typedef void (Font::*RenderGlyph)(CachedGlyphInfo*, int, int, uint8_t*,
             uint32_t, uint32_t, Rect*, const float*);
 
+    /**
+     * Rasterizes a run of glyphs off the render thread. The glyph images are
+     * copied out of Skia's glyph cache so that they can be packed in the cache
+     * textures later on, on the render thread.
+     */
+    class GlyphTask: public Task<bool> {
+    public:
+        GlyphTask(const SkPaint* paint, const SkMatrix& lookupTransform, bool distanceField):
+            paint(*paint), lookupTransform(lookupTransform), distanceField(distanceField) {
+        }
+
+        // copied, since input paint may not be immutable
+        const SkPaint paint;
+        const SkMatrix lookupTransform;
+        // The images are converted to distance fields as well
+        const bool distanceField;
+
+        std::vector<glyph_t> glyphs;
+
+        // Output, the fImage of each SkGlyph points into images
+        std::vector<SkGlyph> skiaGlyphs;
+        std::vector<uint8_t> images;
+    };
+
+    class GlyphProcessor: public TaskProcessor<bool> {
+    public:
+        GlyphProcessor(TaskManager* taskManager): TaskProcessor<bool>(taskManager) { }
+        ~GlyphProcessor() { }
+
+        virtual void onProcess(const sp<Task<bool> >& task) override;
+    };
+
     enum RenderMode {
         FRAMEBUFFER,
         BITMAP,
@@ -138,19 +197,35 @@ private:
     void drawCachedGlyphBitmap(CachedGlyphInfo* glyph, int x, int y,
             uint8_t *bitmap, uint32_t bitmapW, uint32_t bitmapH,
             Rect* bounds, const float* pos);
+    void drawCachedGlyphDistanceField(CachedGlyphInfo* glyph, int x, int y,
+            uint8_t *bitmap, uint32_t bitmapW, uint32_t bitmapH,
+            Rect* bounds, const float* pos);
     void drawCachedGlyph(CachedGlyphInfo* glyph, float x, float hOffset, float vOffset,
             SkPathMeasure& measure, SkPoint* position, SkVector* tangent);
 
     CachedGlyphInfo* getCachedGlyph(const SkPaint* paint, glyph_t textUnit,
             bool precaching = false);
 
+    /**
+     * Waits for the specified task and packs all of its glyphs in the cache
+     * textures. Only textUnit is allowed to flush the caches if it doesn't fit.
+     */
+    void cachePendingGlyphs(const SkPaint* paint, const sp<GlyphTask>& task,
+            glyph_t textUnit, bool precaching);
+
     FontRenderer* mState;
     FontDescription mDescription;
 
     // Cache of glyphs
     DefaultKeyedVector<glyph_t, CachedGlyphInfo*> mCachedGlyphs;
 
+    // Glyphs being rasterized by a GlyphTask, not yet in mCachedGlyphs
+    KeyedVector<glyph_t, sp<GlyphTask> > mPendingGlyphs;
+
     bool mIdentityTransform;
+
+    // Ratio of the text size being drawn to DISTANCE_FIELD_TEXT_SIZE
+    float mDistanceFieldScale;
 };
 
 inline int strictly_order_type(const Font::FontDescription& lhs,
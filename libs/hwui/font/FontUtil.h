@@ -40,6 +40,13 @@
 
 #define CACHE_BLOCK_ROUNDING_SIZE 4
 
+// Distance field glyphs are rasterized at this text size, and padded by
+// DISTANCE_FIELD_SPREAD pixels on each side
+#define DISTANCE_FIELD_TEXT_SIZE 48.0f
+#define DISTANCE_FIELD_SPREAD 4
+// Smaller text, on screen, keeps using hinted glyphs rasterized at their size
+#define DISTANCE_FIELD_MIN_TEXT_SIZE 16.0f
+
 #if RENDER_TEXT_AS_GLYPHS
     typedef uint16_t glyph_t;
     #define TO_GLYPH(g) g
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/Benchmark.h>
+
+#include "PathCache.h"
+#include "microbench/MicroBench.h"
+#include "utils/FlatLruCache.h"
+
+#include <SkPaint.h>
+
+#include <utils/LruCache.h>
+
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+// Round rect keys as PathCache builds them, differing by their size
+static std::vector<PathDescription> createKeys(int count) {
+    SkPaint paint;
+    paint.setStyle(SkPaint::kStroke_Style);
+    paint.setStrokeWidth(2.0f);
+
+    std::vector<PathDescription> keys;
+    for (int i = 0; i < count; i++) {
+        PathDescription key(kShapeRoundRect, &paint);
+        key.shape.roundRect.mWidth = 100 + i;
+        key.shape.roundRect.mHeight = 40 + i / 4;
+        key.shape.roundRect.mRx = 8;
+        key.shape.roundRect.mRy = 8;
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// Lookups of cached shapes, as each path draw does while deferring
+template <typename Cache>
+static void getHits(int iters, int count) {
+    std::vector<PathDescription> keys = createKeys(count);
+    Cache cache(Cache::kUnlimitedCapacity);
+    for (int i = 0; i < count; i++) {
+        cache.put(keys[i], i + 1);
+    }
+
+    for (int i = 0; i < iters; i++) {
+        for (int j = 0; j < count; j++) {
+            MicroBench::DoNotOptimize(cache.get(keys[j]));
+        }
+    }
+}
+
+// A working set larger than the cache, every lookup misses and evicts
+template <typename Cache>
+static void churn(int iters, int count) {
+    std::vector<PathDescription> keys = createKeys(count * 2);
+    Cache cache(Cache::kUnlimitedCapacity);
+
+    for (int i = 0; i < iters; i++) {
+        for (int j = 0; j < count * 2; j++) {
+            if (!cache.get(keys[j])) {
+                if (cache.size() >= (size_t) count) {
+                    cache.removeOldest();
+                }
+                cache.put(keys[j], j + 1);
+            }
+        }
+    }
+}
+
+BENCHMARK_WITH_ARG(BM_LruCache_getHits, int)->Arg(16)->Arg(256);
+void BM_LruCache_getHits::Run(int iters, int count) {
+    StartBenchmarkTiming();
+    getHits<LruCache<PathDescription, int> >(iters, count);
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_FlatLruCache_getHits, int)->Arg(16)->Arg(256);
+void BM_FlatLruCache_getHits::Run(int iters, int count) {
+    StartBenchmarkTiming();
+    getHits<FlatLruCache<PathDescription, int> >(iters, count);
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_LruCache_churn, int)->Arg(16)->Arg(256);
+void BM_LruCache_churn::Run(int iters, int count) {
+    StartBenchmarkTiming();
+    churn<LruCache<PathDescription, int> >(iters, count);
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_FlatLruCache_churn, int)->Arg(16)->Arg(256);
+void BM_FlatLruCache_churn::Run(int iters, int count) {
+    StartBenchmarkTiming();
+    churn<FlatLruCache<PathDescription, int> >(iters, count);
+    StopBenchmarkTiming();
+}
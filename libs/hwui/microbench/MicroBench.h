@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MICROBENCH_MICROBENCH_H
+#define MICROBENCH_MICROBENCH_H
+
+namespace android {
+namespace uirenderer {
+
+class MicroBench {
+public:
+    // Keeps the compiler from optimizing away the computation of value
+    template <class Tp>
+    static inline void DoNotOptimize(Tp const& value) {
+        asm volatile("" : : "g"(value) : "memory");
+    }
+};
+
+} /* namespace uirenderer */
+} /* namespace android */
+
+#endif /* MICROBENCH_MICROBENCH_H */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/Benchmark.h>
+
+#include "Matrix.h"
+#include "PathTessellator.h"
+#include "VertexBuffer.h"
+#include "microbench/MicroBench.h"
+
+#include <SkPaint.h>
+#include <SkPath.h>
+
+using namespace android;
+using namespace android::uirenderer;
+
+static void tessellate(int iters, const SkPath& path, const SkPaint& paint,
+        const mat4& transform) {
+    for (int i = 0; i < iters; i++) {
+        VertexBuffer vertexBuffer;
+        PathTessellator::tessellatePath(path, &paint, transform, vertexBuffer);
+        MicroBench::DoNotOptimize(vertexBuffer.getVertexCount());
+    }
+}
+
+// The number of vertices generated for a circle grows with its radius
+static SkPath createCircle(int radius) {
+    SkPath path;
+    path.addCircle(radius, radius, radius);
+    return path;
+}
+
+BENCHMARK_WITH_ARG(BM_PathTessellator_circleFill, int)->Arg(8)->Arg(64)->Arg(512);
+void BM_PathTessellator_circleFill::Run(int iters, int radius) {
+    SkPath path = createCircle(radius);
+    SkPaint paint;
+    mat4 transform;
+
+    StartBenchmarkTiming();
+    tessellate(iters, path, paint, transform);
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_PathTessellator_circleFillAA, int)->Arg(8)->Arg(64)->Arg(512);
+void BM_PathTessellator_circleFillAA::Run(int iters, int radius) {
+    SkPath path = createCircle(radius);
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    mat4 transform;
+
+    StartBenchmarkTiming();
+    tessellate(iters, path, paint, transform);
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_PathTessellator_circleStrokeAA, int)->Arg(8)->Arg(64)->Arg(512);
+void BM_PathTessellator_circleStrokeAA::Run(int iters, int radius) {
+    SkPath path = createCircle(radius);
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    paint.setStyle(SkPaint::kStroke_Style);
+    paint.setStrokeWidth(4);
+    mat4 transform;
+
+    StartBenchmarkTiming();
+    tessellate(iters, path, paint, transform);
+    StopBenchmarkTiming();
+}
+
+// Scaled, so that the approximation has to account for the transform
+BENCHMARK_WITH_ARG(BM_PathTessellator_roundRectFillAAScaled, int)->Arg(4)->Arg(16)->Arg(64);
+void BM_PathTessellator_roundRectFillAAScaled::Run(int iters, int cornerRadius) {
+    SkPath path;
+    path.addRoundRect(SkRect::MakeWH(200, 100), cornerRadius, cornerRadius);
+    SkPaint paint;
+    paint.setAntiAlias(true);
+    mat4 transform;
+    transform.loadScale(3, 3, 1);
+
+    StartBenchmarkTiming();
+    tessellate(iters, path, paint, transform);
+    StopBenchmarkTiming();
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/Benchmark.h>
+
+#include "microbench/MicroBench.h"
+#include "utils/PixelConvert.h"
+
+#include <SkColor.h>
+
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+// Mostly opaque pixels with some translucent ones, like a typical photo. The
+// benchmarks convert one row of a 1080p bitmap and the whole bitmap.
+static std::vector<uint32_t> createPixels(int count) {
+    std::vector<uint32_t> pixels(count);
+    for (int i = 0; i < count; i++) {
+        uint32_t alpha = (i % 16) ? 0xFF : (i * 7) & 0xFF;
+        pixels[i] = (alpha << 24) | ((i * 2654435761u) & 0xFFFFFF);
+    }
+    return pixels;
+}
+
+// setPixels() into ARGB_8888, premultiplied and not
+BENCHMARK_WITH_ARG(BM_PixelConvert_premultiply, int)->Arg(1080)->Arg(1080 * 1920);
+void BM_PixelConvert_premultiply::Run(int iters, int count) {
+    std::vector<uint32_t> pixels = createPixels(count);
+    std::vector<SkPMColor> dst(count);
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        PixelConvert::premultiply(dst.data(), pixels.data(), count);
+        MicroBench::DoNotOptimize(dst[count - 1]);
+    }
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_PixelConvert_colorToPMColor, int)->Arg(1080)->Arg(1080 * 1920);
+void BM_PixelConvert_colorToPMColor::Run(int iters, int count) {
+    std::vector<uint32_t> pixels = createPixels(count);
+    std::vector<SkPMColor> dst(count);
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        PixelConvert::colorToPMColor(dst.data(), pixels.data(), count);
+        MicroBench::DoNotOptimize(dst[count - 1]);
+    }
+    StopBenchmarkTiming();
+}
+
+// setPixels() into ALPHA_8
+BENCHMARK_WITH_ARG(BM_PixelConvert_colorToAlpha8, int)->Arg(1080)->Arg(1080 * 1920);
+void BM_PixelConvert_colorToAlpha8::Run(int iters, int count) {
+    std::vector<uint32_t> pixels = createPixels(count);
+    std::vector<uint8_t> dst(count);
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        PixelConvert::colorToAlpha8(dst.data(), pixels.data(), count);
+        MicroBench::DoNotOptimize(dst[count - 1]);
+    }
+    StopBenchmarkTiming();
+}
+
+// getPixels() from ARGB_8888, premultiplied, not premultiplied and opaque.
+// ARGB_4444 and indexed bitmaps go through these as well.
+BENCHMARK_WITH_ARG(BM_PixelConvert_unpremultiply, int)->Arg(1080)->Arg(1080 * 1920);
+void BM_PixelConvert_unpremultiply::Run(int iters, int count) {
+    std::vector<uint32_t> pixels = createPixels(count);
+    std::vector<SkColor> dst(count);
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        PixelConvert::unpremultiply(dst.data(), pixels.data(), count);
+        MicroBench::DoNotOptimize(dst[count - 1]);
+    }
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_PixelConvert_pmColorToColor, int)->Arg(1080)->Arg(1080 * 1920);
+void BM_PixelConvert_pmColorToColor::Run(int iters, int count) {
+    std::vector<uint32_t> pixels = createPixels(count);
+    std::vector<SkColor> dst(count);
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        PixelConvert::pmColorToColor(dst.data(), pixels.data(), count);
+        MicroBench::DoNotOptimize(dst[count - 1]);
+    }
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_PixelConvert_pmColorToOpaqueColor, int)->Arg(1080)->Arg(1080 * 1920);
+void BM_PixelConvert_pmColorToOpaqueColor::Run(int iters, int count) {
+    std::vector<uint32_t> pixels = createPixels(count);
+    std::vector<SkColor> dst(count);
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        PixelConvert::pmColorToOpaqueColor(dst.data(), pixels.data(), count);
+        MicroBench::DoNotOptimize(dst[count - 1]);
+    }
+    StopBenchmarkTiming();
+}
+
+// getPixels() from RGB_565
+BENCHMARK_WITH_ARG(BM_PixelConvert_rgb565ToColor, int)->Arg(1080)->Arg(1080 * 1920);
+void BM_PixelConvert_rgb565ToColor::Run(int iters, int count) {
+    std::vector<uint32_t> pixels = createPixels(count);
+    std::vector<SkColor> dst(count);
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        PixelConvert::rgb565ToColor(dst.data(), reinterpret_cast<const uint16_t*>(pixels.data()), count);
+        MicroBench::DoNotOptimize(dst[count - 1]);
+    }
+    StopBenchmarkTiming();
+}
+
+// getPixels() from ALPHA_8
+BENCHMARK_WITH_ARG(BM_PixelConvert_alpha8ToColor, int)->Arg(1080)->Arg(1080 * 1920);
+void BM_PixelConvert_alpha8ToColor::Run(int iters, int count) {
+    std::vector<uint32_t> pixels = createPixels(count);
+    std::vector<SkColor> dst(count);
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        PixelConvert::alpha8ToColor(dst.data(), reinterpret_cast<const uint8_t*>(pixels.data()), count);
+        MicroBench::DoNotOptimize(dst[count - 1]);
+    }
+    StopBenchmarkTiming();
+}
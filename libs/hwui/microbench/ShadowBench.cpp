@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/Benchmark.h>
+
+#include "AmbientShadow.h"
+#include "Matrix.h"
+#include "PathTessellator.h"
+#include "Rect.h"
+#include "ShadowTessellator.h"
+#include "SpotShadow.h"
+#include "Vector.h"
+#include "VertexBuffer.h"
+#include "microbench/MicroBench.h"
+
+#include <SkPath.h>
+#include <utils/Vector.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+// Roughly the light setup of a 1080p xxhdpi device
+static const Vector3 kLightCenter = {540, -600, 1800};
+static const float kLightRadius = 2400;
+static const float kCasterZ = 48;
+
+// Same as ShadowTessellator::tessellateAmbientShadow()
+static const float kAmbientHeightFactor = 1.0f / 128;
+static const float kAmbientGeomFactor = 64;
+
+// A counter-clockwise circle of vertexCount vertices at an elevation of z,
+// the way TessellationCache hands casters to the shadow tessellators
+static std::vector<Vector3> createCasterPolygon(int vertexCount, float radius, float z) {
+    std::vector<Vector3> polygon(vertexCount);
+    for (int i = 0; i < vertexCount; i++) {
+        float angle = -2 * M_PI * i / vertexCount;
+        polygon[i] = (Vector3){200 + radius * cosf(angle), 400 + radius * sinf(angle), z};
+    }
+    return polygon;
+}
+
+BENCHMARK_WITH_ARG(BM_AmbientShadow_createAmbientShadow, int)->Arg(8)->Arg(32)->Arg(128);
+void BM_AmbientShadow_createAmbientShadow::Run(int iters, int vertexCount) {
+    std::vector<Vector3> polygon = createCasterPolygon(vertexCount, 100, kCasterZ);
+    Vector3 centroid = {200, 400, kCasterZ};
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        VertexBuffer shadow;
+        AmbientShadow::createAmbientShadow(true, polygon.data(), vertexCount, centroid,
+                kAmbientHeightFactor, kAmbientGeomFactor, shadow);
+        MicroBench::DoNotOptimize(shadow.getVertexCount());
+    }
+    StopBenchmarkTiming();
+}
+
+BENCHMARK_WITH_ARG(BM_SpotShadow_createSpotShadow, int)->Arg(8)->Arg(32)->Arg(128);
+void BM_SpotShadow_createSpotShadow::Run(int iters, int vertexCount) {
+    std::vector<Vector3> polygon = createCasterPolygon(vertexCount, 100, kCasterZ);
+    Vector3 centroid = {200, 400, kCasterZ};
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        VertexBuffer shadow;
+        SpotShadow::createSpotShadow(true, kLightCenter, kLightRadius, polygon.data(),
+                vertexCount, centroid, shadow);
+        MicroBench::DoNotOptimize(shadow.getVertexCount());
+    }
+    StopBenchmarkTiming();
+}
+
+// Translucent casters also tessellate the umbra
+BENCHMARK_WITH_ARG(BM_SpotShadow_createSpotShadowTranslucent, int)->Arg(8)->Arg(32)->Arg(128);
+void BM_SpotShadow_createSpotShadowTranslucent::Run(int iters, int vertexCount) {
+    std::vector<Vector3> polygon = createCasterPolygon(vertexCount, 100, kCasterZ);
+    Vector3 centroid = {200, 400, kCasterZ};
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        VertexBuffer shadow;
+        SpotShadow::createSpotShadow(false, kLightCenter, kLightRadius, polygon.data(),
+                vertexCount, centroid, shadow);
+        MicroBench::DoNotOptimize(shadow.getVertexCount());
+    }
+    StopBenchmarkTiming();
+}
+
+// The full path, from a rounded rect outline with the given corner radius
+// to both shadows, as TessellationCache does it for a card
+BENCHMARK_WITH_ARG(BM_ShadowTessellator_roundRectShadows, int)->Arg(0)->Arg(8)->Arg(48);
+void BM_ShadowTessellator_roundRectShadows::Run(int iters, int cornerRadius) {
+    SkPath outline;
+    outline.addRoundRect(SkRect::MakeXYWH(100, 300, 300, 200), cornerRadius, cornerRadius);
+    Vector<Vertex> outlineVertices;
+    PathTessellator::approximatePathOutlineVertices(outline, 2.0f, outlineVertices);
+
+    // Shadows require counter-clockwise polygons
+    const int vertexCount = outlineVertices.size();
+    std::vector<Vector3> polygon(vertexCount);
+    for (int i = 0; i < vertexCount; i++) {
+        const Vertex& vertex = outlineVertices[vertexCount - 1 - i];
+        polygon[i] = (Vector3){vertex.x, vertex.y, kCasterZ};
+    }
+    Vector2 centroid2d = ShadowTessellator::centroid2d(
+            reinterpret_cast<const Vector2*>(outlineVertices.array()), vertexCount);
+    Vector3 centroid = {centroid2d.x, centroid2d.y, kCasterZ};
+
+    Rect casterBounds(100, 300, 400, 500);
+    Rect localClip(0, 0, 1080, 1920);
+    mat4 receiverTransform;
+
+    StartBenchmarkTiming();
+    for (int i = 0; i < iters; i++) {
+        VertexBuffer ambient;
+        VertexBuffer spot;
+        ShadowTessellator::tessellateAmbientShadow(true, polygon.data(), vertexCount,
+                centroid, casterBounds, localClip, kCasterZ, ambient);
+        ShadowTessellator::tessellateSpotShadow(true, polygon.data(), vertexCount,
+                centroid, receiverTransform, kLightCenter, kLightRadius,
+                casterBounds, localClip, spot);
+        MicroBench::DoNotOptimize(ambient.getVertexCount() + spot.getVertexCount());
+    }
+    StopBenchmarkTiming();
+}
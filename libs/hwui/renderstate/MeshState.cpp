@@ -91,6 +91,22 @@ bool MeshState::unbindMeshBuffer() {
     return bindMeshBufferInternal(0);
 }
 
+GLuint MeshState::createStaticMeshBuffer(const void* vertices, GLsizeiptr size) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    bindMeshBufferInternal(buffer);
+    glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+    return buffer;
+}
+
+void MeshState::deleteMeshBuffer(GLuint buffer) {
+    // Deleting the bound buffer reverts the binding to 0
+    if (mCurrentBuffer == buffer) {
+        mCurrentBuffer = 0;
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
 bool MeshState::bindMeshBufferInternal(GLuint buffer) {
     if (mCurrentBuffer != buffer) {
         glBindBuffer(GL_ARRAY_BUFFER, buffer);
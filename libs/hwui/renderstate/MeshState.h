@@ -43,6 +43,7 @@ const GLsizei kVertexStride = sizeof(Vertex);
 const GLsizei kAlphaVertexStride = sizeof(AlphaVertex);
 const GLsizei kTextureVertexStride = sizeof(TextureVertex);
 const GLsizei kColorTextureVertexStride = sizeof(ColorTextureVertex);
+const GLsizei kRectInstanceStride = sizeof(RectInstance);
 
 const GLsizei kMeshTextureOffset = 2 * sizeof(float);
 const GLsizei kVertexAlphaOffset = 2 * sizeof(float);
@@ -75,6 +76,17 @@ public:
      */
     bool unbindMeshBuffer();
 
+    /**
+     * Creates a VBO holding a copy of the specified vertices, for meshes that
+     * are drawn over many frames. The new VBO is left bound.
+     */
+    GLuint createStaticMeshBuffer(const void* vertices, GLsizeiptr size);
+
+    /**
+     * Deletes a VBO created with createStaticMeshBuffer().
+     */
+    void deleteMeshBuffer(GLuint buffer);
+
     ///////////////////////////////////////////////////////////////////////////////
     // Vertices
     ///////////////////////////////////////////////////////////////////////////////
@@ -19,6 +19,8 @@
 #include "renderthread/EglManager.h"
 #include "utils/GLUtils.h"
 
+#include <GLES3/gl3.h>
+
 namespace android {
 namespace uirenderer {
 
@@ -90,6 +92,9 @@ void RenderState::onGLContextDestroyed() {
 
     // TODO: reset all cached state in state objects
     std::for_each(mActiveLayers.begin(), mActiveLayers.end(), layerLostGlContext);
+    for (renderthread::CanvasContext* context : mRegisteredContexts) {
+        context->mGpuTimer.onGLContextDestroyed();
+    }
     mAssetAtlas.terminate();
 
     mCaches->terminate();
@@ -119,6 +124,7 @@ void RenderState::getViewport(GLsizei* outWidth, GLsizei* outHeight) {
 void RenderState::bindFramebuffer(GLuint fbo) {
     if (mFramebuffer != fbo) {
         mFramebuffer = fbo;
+        mFramebufferSwitchCount++;
         glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
     }
 }
@@ -238,6 +244,11 @@ void RenderState::render(const Glop& glop) {
                 fill.filter.matrix.vector);
     }
 
+    if (fill.distanceFieldSmoothing > 0.0f) {
+        glUniform1f(fill.program->getUniform("distanceFieldSmoothing"),
+                fill.distanceFieldSmoothing);
+    }
+
     // Round rect clipping uniforms
     if (glop.roundRectClipState) {
         // TODO: avoid query, and cache values (or RRCS ptr) in program
@@ -295,6 +306,24 @@ void RenderState::render(const Glop& glop) {
         glEnableVertexAttribArray(colorLocation);
         glVertexAttribPointer(colorLocation, 4, GL_FLOAT, GL_FALSE, vertices.stride, vertices.color);
     }
+    const Glop::Mesh::Instances& instances = mesh.instances;
+    int boundsLocation = -1;
+    if (instances.count) {
+        // Instance attributes are in client memory
+        meshState().unbindMeshBuffer();
+
+        boundsLocation = fill.program->getAttrib("instanceBounds");
+        glEnableVertexAttribArray(boundsLocation);
+        glVertexAttribPointer(boundsLocation, 4, GL_FLOAT, GL_FALSE, instances.stride,
+                instances.bounds);
+        glVertexAttribDivisor(boundsLocation, 1);
+
+        colorLocation = fill.program->getAttrib("colors");
+        glEnableVertexAttribArray(colorLocation);
+        glVertexAttribPointer(colorLocation, 4, GL_FLOAT, GL_FALSE, instances.stride,
+                instances.color);
+        glVertexAttribDivisor(colorLocation, 1);
+    }
     int alphaLocation = -1;
     if (vertices.attribFlags & VertexAttribFlags::Alpha) {
         // NOTE: alpha vertex position is computed assuming no VBO
@@ -335,6 +364,8 @@ void RenderState::render(const Glop& glop) {
         }
     } else if (indices.bufferObject || indices.indices) {
         glDrawElements(mesh.primitiveMode, mesh.elementCount, GL_UNSIGNED_SHORT, indices.indices);
+    } else if (instances.count) {
+        glDrawArraysInstanced(mesh.primitiveMode, 0, mesh.elementCount, instances.count);
     } else {
         glDrawArrays(mesh.primitiveMode, 0, mesh.elementCount);
     }
@@ -348,6 +379,13 @@ void RenderState::render(const Glop& glop) {
     if (vertices.attribFlags & VertexAttribFlags::Color) {
         glDisableVertexAttribArray(colorLocation);
     }
+    if (instances.count) {
+        // Other draws expect the attributes to be per vertex
+        glVertexAttribDivisor(boundsLocation, 0);
+        glDisableVertexAttribArray(boundsLocation);
+        glVertexAttribDivisor(colorLocation, 0);
+        glDisableVertexAttribArray(colorLocation);
+    }
 }
 
 void RenderState::dump() {
@@ -58,6 +58,8 @@ public:
 
     void bindFramebuffer(GLuint fbo);
     GLint getFramebuffer() { return mFramebuffer; }
+    // Number of times bindFramebuffer() actually changed the bound FBO
+    uint32_t getFramebufferSwitchCount() const { return mFramebufferSwitchCount; }
 
     void invokeFunctor(Functor* functor, DrawGlInfo::Mode mode, DrawGlInfo* info);
 
@@ -120,6 +122,7 @@ private:
     GLsizei mViewportWidth;
     GLsizei mViewportHeight;
     GLuint mFramebuffer;
+    uint32_t mFramebufferSwitchCount = 0;
 
     pthread_t mThreadId;
 };
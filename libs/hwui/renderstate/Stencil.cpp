@@ -123,6 +123,42 @@ void Stencil::enableDebugWrite() {
     glStencilMask(0xff);
 }
 
+void Stencil::enablePathClear() {
+    enable();
+    glStencilFunc(GL_ALWAYS, 0, 0xff);
+    // The test always passes so the first two values are meaningless
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glStencilMask(0xff);
+    mState = kWrite;
+}
+
+void Stencil::enablePathWrite(bool evenOdd) {
+    enable();
+    glStencilFunc(GL_ALWAYS, 0, 0xff);
+    // The test always passes so the first two values are meaningless
+    if (evenOdd) {
+        glStencilOp(GL_KEEP, GL_KEEP, GL_INVERT);
+        glStencilMask(0x1);
+    } else {
+        glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+        glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+        glStencilMask(0xff);
+    }
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    mState = kWrite;
+}
+
+void Stencil::enablePathCover() {
+    enable();
+    glStencilFunc(GL_NOTEQUAL, 0, 0xff);
+    // Leave the stencil clean for the next path or clip
+    glStencilOp(GL_KEEP, GL_KEEP, GL_ZERO);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glStencilMask(0xff);
+    mState = kTest;
+}
+
 void Stencil::enable() {
     if (mState == kDisabled) {
         glEnable(GL_STENCIL_TEST);
@@ -76,6 +76,26 @@ public:
      */
     void enableDebugWrite();
 
+    /**
+     * Used to fill paths. The stencil test always passes and 0 is written in
+     * the stencil buffer for each fragment, without touching the color buffer.
+     */
+    void enablePathClear();
+
+    /**
+     * Used to fill paths. The stencil test always passes and the stencil buffer
+     * accumulates the path's coverage, without touching the color buffer. With
+     * evenOdd the low bit of each fragment is inverted, otherwise front facing
+     * triangles increment and back facing triangles decrement the winding count.
+     */
+    void enablePathWrite(bool evenOdd);
+
+    /**
+     * Used to fill paths. The test passes where the stencil buffer is not 0, and
+     * every fragment that passes resets the stencil buffer to 0.
+     */
+    void enablePathCover();
+
     /**
      * Disables stencil test and write.
      */
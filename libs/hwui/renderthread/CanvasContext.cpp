@@ -19,6 +19,7 @@
 #include "AnimationContext.h"
 #include "Caches.h"
 #include "DeferredLayerUpdater.h"
+#include "DisplayListSerializer.h"
 #include "EglManager.h"
 #include "LayerRenderer.h"
 #include "OpenGLRenderer.h"
@@ -63,6 +64,11 @@ void CanvasContext::destroy() {
     freePrefetechedLayers();
     destroyHardwareResources();
     mAnimationContext->destroy();
+    if (mEglManager.hasEglContext()) {
+        mGpuTimer.destroy();
+    }
+    mEglManager.destroyFence(&mFrameFence);
+    mEglManager.destroyFence(&mLayerFence);
     if (mCanvas) {
         delete mCanvas;
         mCanvas = nullptr;
@@ -83,23 +89,64 @@ void CanvasContext::setSurface(ANativeWindow* window) {
         mEglSurface = mEglManager.createSurface(window);
     }
 
+    mRenderAheadDepth = 0;
+    mFramesAhead = 0;
+    if (mEglSurface != EGL_NO_SURFACE && Properties::renderAhead > 0) {
+        setRenderAheadBufferCount(window, Properties::renderAhead);
+    }
+
     if (mEglSurface != EGL_NO_SURFACE) {
-        const bool preserveBuffer = (mSwapBehavior != kSwap_discardBuffer);
+        // Tracking the age of the buffers is cheaper than having them preserved
+        mUseBufferAge = (mSwapBehavior != kSwap_discardBuffer) && mEglManager.hasBufferAge();
+        const bool preserveBuffer = (mSwapBehavior != kSwap_discardBuffer) && !mUseBufferAge;
         mBufferPreserved = mEglManager.setPreserveBuffer(mEglSurface, preserveBuffer);
         mHaveNewSurface = true;
+        mDamageHistory.clear();
         makeCurrent();
     } else {
         mRenderThread.removeFrameCallback(this);
     }
 }
 
-void CanvasContext::swapBuffers(const SkRect& dirty, EGLint width, EGLint height) {
-    if (CC_UNLIKELY(!mEglManager.swapBuffers(mEglSurface, dirty, width, height))) {
+void CanvasContext::setRenderAheadBufferCount(ANativeWindow* window, int depth) {
+    // Double buffering plus one buffer per frame queued ahead, on top of those
+    // the consumer may hold
+    int minUndequeuedBuffers = 0;
+    if (window->query(window, NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &minUndequeuedBuffers)
+            || native_window_set_buffer_count(window, minUndequeuedBuffers + 2 + depth)) {
+        ALOGW("Failed to add %d buffers to %s for render ahead", depth, mName.c_str());
+        return;
+    }
+    mRenderAheadDepth = depth;
+}
+
+void CanvasContext::swapBuffers(const DamageRects& damage, EGLint width, EGLint height) {
+    if (CC_UNLIKELY(!mEglManager.swapBuffers(mEglSurface, damage, width, height))) {
         setSurface(nullptr);
     }
     mHaveNewSurface = false;
 }
 
+SkRect CanvasContext::computeBufferDirty(const SkRect& frameDirty, EGLint width, EGLint height) {
+    const SkRect bounds = SkRect::MakeWH(width, height);
+    const EGLint bufferAge = mEglManager.queryBufferAge(mEglSurface);
+
+    SkRect& history = mDamageHistory.next();
+    history = frameDirty.isEmpty() ? bounds : frameDirty;
+
+    // The buffer holds the content of the frame bufferAge frames ago, the
+    // damage of the following frames, including this one, must be redrawn
+    if (bufferAge <= 0 || bufferAge > static_cast<EGLint>(mDamageHistory.size())) {
+        return SkRect::MakeEmpty();
+    }
+    SkRect dirty = history;
+    for (EGLint i = 1; i < bufferAge; i++) {
+        dirty.join(mDamageHistory[mDamageHistory.size() - 1 - i]);
+    }
+    // An empty rect redraws the whole surface
+    return dirty.contains(bounds) ? SkRect::MakeEmpty() : dirty;
+}
+
 void CanvasContext::requireSurface() {
     LOG_ALWAYS_FATAL_IF(mEglSurface == EGL_NO_SURFACE,
             "requireSurface() called but no surface set!");
@@ -155,6 +202,8 @@ void CanvasContext::makeCurrent() {
 void CanvasContext::processLayerUpdate(DeferredLayerUpdater* layerUpdater) {
     bool success = layerUpdater->apply();
     LOG_ALWAYS_FATAL_IF(!success, "Failed to update layer!");
+    // Layers are updated before prepareTree() picks the frame's FrameInfo
+    mLayerLatchDuration += layerUpdater->lastLatchDuration();
     if (layerUpdater->backingLayer()->deferredUpdateScheduled) {
         mCanvas->pushLayerUpdate(layerUpdater->backingLayer());
     }
@@ -174,16 +223,30 @@ void CanvasContext::prepareTree(TreeInfo& info, int64_t* uiFrameInfo, int64_t sy
     }
     mCurrentFrameInfo->importUiThreadInfo(uiFrameInfo);
     mCurrentFrameInfo->set(FrameInfoIndex::SyncQueued) = syncQueued;
+    mCurrentFrameInfo->set(FrameInfoIndex::LayerLatchDuration) = mLayerLatchDuration;
+    mLayerLatchDuration = 0;
     mCurrentFrameInfo->markSyncStart();
 
     info.damageAccumulator = &mDamageAccumulator;
     info.renderer = mCanvas;
     info.canvasContext = this;
+    // Queuing the shadows early only pays off if they tessellate on worker threads,
+    // otherwise they would be tessellated while the UI thread waits on the sync
+    info.precacheShadows = mCanvas && Caches::hasInstance()
+            && Caches::getInstance().tasks.canRunTasks();
+    if (info.precacheShadows) {
+        // Drops the shadows queued for a frame that wasn't drawn
+        Caches::getInstance().tessellationCache.clearTreeShadows();
+    }
 
     mAnimationContext->startFrame(info.mode);
     mRootRenderNode->prepareTree(info);
     mAnimationContext->runRemainingAnimations(info);
 
+    if (CC_UNLIKELY(!Properties::captureFramePath.empty())) {
+        captureFrame();
+    }
+
     freePrefetechedLayers();
 
     if (CC_UNLIKELY(!mNativeWindow.get())) {
@@ -198,6 +261,14 @@ void CanvasContext::prepareTree(TreeInfo& info, int64_t* uiFrameInfo, int64_t sy
     // last vsync time. Or something.
     mNativeWindow->query(mNativeWindow.get(),
             NATIVE_WINDOW_CONSUMER_RUNNING_BEHIND, &runningBehind);
+    // Rendering ahead, the consumer is expected to run behind by as many
+    // frames as the extra buffers allow before frames have to be dropped
+    if (runningBehind && mFramesAhead < mRenderAheadDepth) {
+        mFramesAhead++;
+        runningBehind = 0;
+    } else if (!runningBehind) {
+        mFramesAhead = 0;
+    }
     info.out.canDrawThisFrame = !runningBehind;
 
     if (!info.out.canDrawThisFrame) {
@@ -213,6 +284,24 @@ void CanvasContext::prepareTree(TreeInfo& info, int64_t* uiFrameInfo, int64_t sy
     }
 }
 
+void CanvasContext::captureFrame() {
+    // Shared by all the windows of the process, only the first one to sync
+    // a frame after the path changed is captured
+    static std::string sCapturedFramePath;
+    if (sCapturedFramePath == Properties::captureFramePath) return;
+    sCapturedFramePath = Properties::captureFramePath;
+
+    DisplayListWriter writer;
+    writer.writeTree(mRootRenderNode.get());
+    if (writer.writeToFile(sCapturedFramePath.c_str())) {
+        ALOGD("Captured frame of %s to %s, %zu bytes, %d ops skipped, %d paints simplified",
+                mName.c_str(), sCapturedFramePath.c_str(), writer.data().size(),
+                writer.getSkippedOpCount(), writer.getLossyPaintCount());
+    } else {
+        ALOGW("Failed to write frame capture to %s", sCapturedFramePath.c_str());
+    }
+}
+
 void CanvasContext::stopDrawing() {
     mRenderThread.removeFrameCallback(this);
 }
@@ -226,8 +315,9 @@ void CanvasContext::draw() {
     LOG_ALWAYS_FATAL_IF(!mCanvas || mEglSurface == EGL_NO_SURFACE,
             "drawRenderNode called on a context with no canvas or surface!");
 
-    SkRect dirty;
-    mDamageAccumulator.finish(&dirty);
+    DamageRects damage;
+    mDamageAccumulator.finish(&damage);
+    SkRect dirty = damage.bounds();
 
     // TODO: Re-enable after figuring out cause of b/22592975
 //    if (dirty.isEmpty() && Properties::skipEmptyFrames) {
@@ -242,7 +332,8 @@ void CanvasContext::draw() {
     if (width != mCanvas->getViewportWidth() || height != mCanvas->getViewportHeight()) {
         mCanvas->setViewport(width, height);
         dirty.setEmpty();
-    } else if (!mBufferPreserved || mHaveNewSurface) {
+        mDamageHistory.clear();
+    } else if ((!mBufferPreserved && !mUseBufferAge) || mHaveNewSurface) {
         dirty.setEmpty();
     } else {
         if (!dirty.isEmpty() && !dirty.intersect(0, 0, width, height)) {
@@ -250,8 +341,32 @@ void CanvasContext::draw() {
                     SK_RECT_ARGS(dirty), width, height);
             dirty.setEmpty();
         }
+        damage.intersect(SkRect::MakeWH(width, height));
         profiler().unionDirty(&dirty);
     }
+    if (dirty.isEmpty() || damage.isEmpty()) {
+        // Redrawing everything, so everything is damaged
+        dirty.setEmpty();
+        damage.setEmpty();
+    }
+
+    // Only the frame's own damage is swapped, but the back buffer may also
+    // lack the damage of the frames presented since it was last used
+    const SkRect frameDirty = dirty;
+    if (mUseBufferAge) {
+        dirty = computeBufferDirty(frameDirty, width, height);
+        mEglManager.damageFrame(mEglSurface, dirty, height);
+    }
+
+    beginGpuTiming();
+
+    RenderState& renderState = mRenderThread.renderState();
+    const uint32_t framebufferSwitchCount = renderState.getFramebufferSwitchCount();
+
+    const bool profileOps = CC_UNLIKELY(Properties::opProfiling) && mOpProfiler.beginFrame();
+    if (CC_UNLIKELY(profileOps)) {
+        mCanvas->setOpProfiler(&mOpProfiler);
+    }
 
     if (!dirty.isEmpty()) {
         mCanvas->prepareDirty(dirty.fLeft, dirty.fTop,
@@ -267,18 +382,61 @@ void CanvasContext::draw() {
 
     bool drew = mCanvas->finish();
 
+    mCurrentFrameInfo->set(FrameInfoIndex::FramebufferSwitches) =
+            renderState.getFramebufferSwitchCount() - framebufferSwitchCount;
+
+    // Between frames, the only time dynamic atlas pages may change
+    renderState.assetAtlas().updateDynamicPages();
+
+    mGpuTimer.endFrame();
+
+    if (CC_UNLIKELY(profileOps)) {
+        mOpProfiler.endFrame();
+        mCanvas->setOpProfiler(nullptr);
+    }
+
     // Even if we decided to cancel the frame, from the perspective of jank
     // metrics the frame was swapped at this point
     mCurrentFrameInfo->markSwapBuffers();
 
     if (drew) {
-        swapBuffers(dirty, width, height);
+        swapBuffers(damage, width, height);
+        mEglManager.insertFence(&mFrameFence);
+    } else {
+        // The back buffer wasn't presented, the history doesn't match the
+        // buffer ages anymore
+        mDamageHistory.clear();
     }
 
     // TODO: Use a fence for real completion?
     mCurrentFrameInfo->markFrameCompleted();
     mJankTracker.addFrame(*mCurrentFrameInfo);
     mRenderThread.jankTracker().addFrame(*mCurrentFrameInfo);
+    mProfiler.exportFrame(*mCurrentFrameInfo);
+    if (CC_UNLIKELY(mFrameCollector)) {
+        mFrameCollector->push_back(*mCurrentFrameInfo);
+    }
+}
+
+void CanvasContext::beginGpuTiming() {
+    if (CC_LIKELY(!Properties::gpuFrameTiming)
+            || !Caches::getInstance().extensions().hasDisjointTimerQuery()) {
+        // The property may have been turned off since the last frame
+        mGpuTimer.destroy();
+        mCanvas->setGpuTimer(nullptr);
+        return;
+    }
+
+    // Results of previous frames, whose jank was already counted without them
+    std::vector<FrameInfo*> timedFrames;
+    mGpuTimer.collect(timedFrames);
+    for (FrameInfo* frame : timedFrames) {
+        mJankTracker.addGpuTiming(*frame);
+        mRenderThread.jankTracker().addGpuTiming(*frame);
+    }
+
+    mGpuTimer.beginFrame(mCurrentFrameInfo);
+    mCanvas->setGpuTimer(&mGpuTimer);
 }
 
 // Called by choreographer to do an RT-driven animation
@@ -352,6 +510,7 @@ void CanvasContext::buildLayer(RenderNode* node) {
 
     mCanvas->markLayersAsBuildLayers();
     mCanvas->flushLayerUpdates();
+    mEglManager.insertFence(&mLayerFence);
 
     node->incStrong(nullptr);
     mPrefetechedLayers.insert(node);
@@ -371,10 +530,18 @@ void CanvasContext::destroyHardwareResources() {
         // Make sure to release all the textures we were owning as there won't
         // be another draw
         caches.textureCache.resetMarkInUse(this);
-        caches.flush(Caches::kFlushMode_Layers);
+        // Only our own work can still be using what we release, no need to
+        // drain the whole GPU queue
+        waitForGpuCompletion();
+        caches.flush(Caches::kFlushMode_Layers, false);
     }
 }
 
+void CanvasContext::waitForGpuCompletion() {
+    mEglManager.waitFence(&mFrameFence);
+    mEglManager.waitFence(&mLayerFence);
+}
+
 void CanvasContext::trimMemory(RenderThread& thread, int level) {
     // No context means nothing to free
     if (!thread.eglManager().hasEglContext()) return;
@@ -427,6 +594,7 @@ void CanvasContext::dumpFrames(int fd) {
 
 void CanvasContext::resetFrameStats() {
     mFrames.clear();
+    mOpProfiler.reset();
     mRenderThread.jankTracker().reset();
 }
 
@@ -21,8 +21,11 @@
 #include "IContextFactory.h"
 #include "FrameInfo.h"
 #include "FrameInfoVisualizer.h"
+#include "GpuTimer.h"
+#include "OpProfiler.h"
 #include "RenderNode.h"
 #include "utils/RingBuffer.h"
+#include "renderthread/EglManager.h"
 #include "renderthread/RenderTask.h"
 #include "renderthread/RenderThread.h"
 
@@ -35,6 +38,7 @@
 
 #include <set>
 #include <string>
+#include <vector>
 
 namespace android {
 namespace uirenderer {
@@ -90,6 +94,9 @@ public:
     void markLayerInUse(RenderNode* node);
 
     void destroyHardwareResources();
+    // Blocks until the GPU is done with the last frame drawn and the layers
+    // built since, without waiting for other contexts' work
+    void waitForGpuCompletion();
     static void trimMemory(RenderThread& thread, int level);
 
     static void invokeFunctor(RenderThread& thread, Functor* functor);
@@ -105,9 +112,12 @@ public:
     void notifyFramePending();
 
     FrameInfoVisualizer& profiler() { return mProfiler; }
+    OpProfiler& opProfiler() { return mOpProfiler; }
 
     void dumpFrames(int fd);
     void resetFrameStats();
+    // Used by benchmarks, see RenderProxy::setFrameCollector()
+    void setFrameCollector(std::vector<FrameInfo>* frames) { mFrameCollector = frames; }
 
     void setName(const std::string&& name) { mName = name; }
     const std::string& name() { return mName; }
@@ -119,10 +129,19 @@ private:
     friend class android::uirenderer::RenderState;
 
     void setSurface(ANativeWindow* window);
-    void swapBuffers(const SkRect& dirty, EGLint width, EGLint height);
+    // Grows the buffer queue of the window to queue up to depth frames ahead
+    void setRenderAheadBufferCount(ANativeWindow* window, int depth);
+    void swapBuffers(const DamageRects& damage, EGLint width, EGLint height);
+    // Returns the region of the back buffer that needs to be redrawn, given
+    // the damage of the frame
+    SkRect computeBufferDirty(const SkRect& frameDirty, EGLint width, EGLint height);
     void requireSurface();
 
     void freePrefetechedLayers();
+    // Writes the synced tree to Properties::captureFramePath if it changed
+    void captureFrame();
+
+    void beginGpuTiming();
 
     RenderThread& mRenderThread;
     EglManager& mEglManager;
@@ -130,6 +149,14 @@ private:
     EGLSurface mEglSurface = EGL_NO_SURFACE;
     bool mBufferPreserved = false;
     SwapBehavior mSwapBehavior = kSwap_default;
+    bool mUseBufferAge = false;
+    // Frames the consumer may run behind, see Properties::renderAhead, and
+    // how many it currently is
+    int mRenderAheadDepth = 0;
+    int mFramesAhead = 0;
+    // Damage of the last presented frames, the newest last, enough for the
+    // buffer ages of triple buffering with the render ahead buffers
+    RingBuffer<SkRect, 5> mDamageHistory;
 
     bool mOpaque;
     OpenGLRenderer* mCanvas = nullptr;
@@ -140,13 +167,24 @@ private:
     const sp<RenderNode> mRootRenderNode;
 
     FrameInfo* mCurrentFrameInfo = nullptr;
+    // Time spent latching the layers of the frame being synced, stored in
+    // its FrameInfo by prepareTree()
+    nsecs_t mLayerLatchDuration = 0;
     // Ring buffer large enough for 2 seconds worth of frames
     RingBuffer<FrameInfo, 120> mFrames;
     std::string mName;
     JankTracker mJankTracker;
     FrameInfoVisualizer mProfiler;
+    GpuTimer mGpuTimer;
+    OpProfiler mOpProfiler;
+
+    // Completion points of the last swapped frame and the last buildLayer()
+    GpuFence mFrameFence;
+    GpuFence mLayerFence;
 
     std::set<RenderNode*> mPrefetechedLayers;
+
+    std::vector<FrameInfo>* mFrameCollector = nullptr;
 };
 
 } /* namespace renderthread */
@@ -63,6 +63,32 @@ static const char* egl_error_str() {
     return egl_error_str(eglGetError());
 }
 
+static bool has_extension(const char* extensions, const char* extension) {
+    const size_t length = strlen(extension);
+    const char* match = extensions;
+    while (extensions && (match = strstr(match, extension))) {
+        // Don't match extensions whose name starts with extension
+        if ((match == extensions || match[-1] == ' ')
+                && (match[length] == ' ' || match[length] == '\0')) {
+            return true;
+        }
+        match += length;
+    }
+    return false;
+}
+
+// Converts dirty to an EGL rectangle, which is relative to the bottom-left
+// of the surface
+static void map_rect(const SkRect& dirty, EGLint height, EGLint* rect) {
+    SkIRect idirty;
+    dirty.roundOut(&idirty);
+    // layout: {x, y, width, height}
+    rect[0] = idirty.x();
+    rect[1] = height - (idirty.y() + idirty.height());
+    rect[2] = idirty.width();
+    rect[3] = idirty.height();
+}
+
 static bool load_dirty_regions_property() {
     char buf[PROPERTY_VALUE_MAX];
     int len = property_get(PROPERTY_RENDER_DIRTY_REGIONS, buf, "true");
@@ -76,7 +102,10 @@ EglManager::EglManager(RenderThread& thread)
         , mEglContext(EGL_NO_CONTEXT)
         , mPBufferSurface(EGL_NO_SURFACE)
         , mAllowPreserveBuffer(load_dirty_regions_property())
+        , mHasBufferAge(false)
+        , mHasPartialUpdate(false)
         , mCurrentSurface(EGL_NO_SURFACE)
+        , mGeneration(0)
         , mAtlasMap(nullptr)
         , mAtlasMapSize(0) {
     mCanSetPreserveBuffer = mAllowPreserveBuffer;
@@ -98,6 +127,7 @@ void EglManager::initialize() {
 
     ALOGI("Initialized EGL, version %d.%d", (int)major, (int)minor);
 
+    initExtensions();
     loadConfig();
     createContext();
     createPBufferSurface();
@@ -110,6 +140,19 @@ bool EglManager::hasEglContext() {
     return mEglDisplay != EGL_NO_DISPLAY;
 }
 
+void EglManager::initExtensions() {
+    const char* extensions = eglQueryString(mEglDisplay, EGL_EXTENSIONS);
+    // Partial redraws are disabled along with dirty regions
+#ifdef EGL_EXT_buffer_age
+    mHasBufferAge = mAllowPreserveBuffer && has_extension(extensions, "EGL_EXT_buffer_age");
+#endif
+#ifdef EGL_KHR_partial_update
+    mHasPartialUpdate = mAllowPreserveBuffer && has_extension(extensions, "EGL_KHR_partial_update");
+#endif
+    ALOGD("Use EGL_EXT_buffer_age: %s, EGL_KHR_partial_update: %s",
+            mHasBufferAge ? "true" : "false", mHasPartialUpdate ? "true" : "false");
+}
+
 void EglManager::loadConfig() {
     EGLint swapBehavior = mCanSetPreserveBuffer ? EGL_SWAP_BEHAVIOR_PRESERVED_BIT : 0;
     EGLint attribs[] = {
@@ -141,6 +184,9 @@ void EglManager::loadConfig() {
 }
 
 void EglManager::createContext() {
+    // A single context serves every window, TextureView and layer updater of the process,
+    // so the Caches tied to it, including the font and path textures, are shared by all of
+    // them. Surfaces are swapped with makeCurrent(), no share group is needed.
     EGLint attribs[] = { EGL_CONTEXT_CLIENT_VERSION, GLES_VERSION, EGL_NONE };
     mEglContext = eglCreateContext(mEglDisplay, mEglConfig, EGL_NO_CONTEXT, attribs);
     LOG_ALWAYS_FATAL_IF(mEglContext == EGL_NO_CONTEXT,
@@ -213,8 +259,12 @@ void EglManager::destroy() {
 
     mEglDisplay = EGL_NO_DISPLAY;
     mEglContext = EGL_NO_CONTEXT;
+    mHasBufferAge = false;
+    mHasPartialUpdate = false;
     mPBufferSurface = EGL_NO_SURFACE;
     mCurrentSurface = EGL_NO_SURFACE;
+    // eglTerminate() took the sync objects with it
+    mGeneration++;
 }
 
 bool EglManager::makeCurrent(EGLSurface surface, EGLint* errOut) {
@@ -251,7 +301,36 @@ void EglManager::beginFrame(EGLSurface surface, EGLint* width, EGLint* height) {
     eglBeginFrame(mEglDisplay, surface);
 }
 
-bool EglManager::swapBuffers(EGLSurface surface, const SkRect& dirty,
+bool EglManager::hasBufferAge() const {
+    return mHasBufferAge && Properties::useBufferAge;
+}
+
+EGLint EglManager::queryBufferAge(EGLSurface surface) {
+    EGLint age = 0;
+#ifdef EGL_EXT_buffer_age
+    if (hasBufferAge() && !eglQuerySurface(mEglDisplay, surface, EGL_BUFFER_AGE_EXT, &age)) {
+        ALOGW("Failed to query buffer age of surface %p, error=%s",
+                (void*) surface, egl_error_str());
+        age = 0;
+    }
+#endif
+    return age;
+}
+
+void EglManager::damageFrame(EGLSurface surface, const SkRect& dirty, EGLint height) {
+#ifdef EGL_KHR_partial_update
+    if (mHasPartialUpdate && hasBufferAge() && !dirty.isEmpty()) {
+        EGLint rects[4];
+        map_rect(dirty, height, rects);
+        if (!eglSetDamageRegionKHR(mEglDisplay, surface, rects, 1)) {
+            ALOGW("Failed to set damage region on surface %p, error=%s",
+                    (void*) surface, egl_error_str());
+        }
+    }
+#endif
+}
+
+bool EglManager::swapBuffers(EGLSurface surface, const DamageRects& damage,
         EGLint width, EGLint height) {
 
 #if WAIT_FOR_GPU_COMPLETION
@@ -263,8 +342,6 @@ bool EglManager::swapBuffers(EGLSurface surface, const SkRect& dirty,
 
 #ifdef EGL_KHR_swap_buffers_with_damage
     if (CC_LIKELY(Properties::swapBuffersWithDamage)) {
-        SkIRect idirty;
-        dirty.roundOut(&idirty);
         /*
          * EGL_KHR_swap_buffers_with_damage spec states:
          *
@@ -275,11 +352,11 @@ bool EglManager::swapBuffers(EGLSurface surface, const SkRect& dirty,
          * HWUI does everything with 0,0 being top-left, so need to map
          * the rect
          */
-        EGLint y = height - (idirty.y() + idirty.height());
-        // layout: {x, y, width, height}
-        EGLint rects[4] = { idirty.x(), y, idirty.width(), idirty.height() };
-        EGLint numrects = dirty.isEmpty() ? 0 : 1;
-        eglSwapBuffersWithDamageKHR(mEglDisplay, surface, rects, numrects);
+        EGLint rects[4 * DAMAGE_MAX_RECTS];
+        for (int i = 0; i < damage.count(); i++) {
+            map_rect(damage[i], height, &rects[4 * i]);
+        }
+        eglSwapBuffersWithDamageKHR(mEglDisplay, surface, rects, damage.count());
     } else {
         eglSwapBuffers(mEglDisplay, surface);
     }
@@ -311,6 +388,45 @@ void EglManager::fence() {
     eglDestroySyncKHR(mEglDisplay, fence);
 }
 
+void EglManager::insertFence(GpuFence* fence) {
+    destroyFence(fence);
+    if (!hasEglContext()) return;
+
+    fence->sync = eglCreateSyncKHR(mEglDisplay, EGL_SYNC_FENCE_KHR, NULL);
+    fence->generation = mGeneration;
+    if (fence->sync == EGL_NO_SYNC_KHR) {
+        ALOGW("Failed to create fence, error=%s", egl_error_str());
+        return;
+    }
+    // Make sure the fence can signal without anyone waiting on it
+    glFlush();
+}
+
+bool EglManager::waitFence(GpuFence* fence, EGLTimeKHR timeout) {
+    if (fence->sync == EGL_NO_SYNC_KHR || fence->generation != mGeneration) {
+        fence->sync = EGL_NO_SYNC_KHR;
+        return true;
+    }
+    ATRACE_NAME("Waiting for GPU fence");
+    EGLint result = eglClientWaitSyncKHR(mEglDisplay, fence->sync,
+            EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, timeout);
+    if (result == EGL_TIMEOUT_EXPIRED_KHR) {
+        return false;
+    }
+    if (result == EGL_FALSE) {
+        ALOGW("Failed to wait for fence, error=%s", egl_error_str());
+    }
+    destroyFence(fence);
+    return true;
+}
+
+void EglManager::destroyFence(GpuFence* fence) {
+    if (fence->sync != EGL_NO_SYNC_KHR && fence->generation == mGeneration) {
+        eglDestroySyncKHR(mEglDisplay, fence->sync);
+    }
+    fence->sync = EGL_NO_SYNC_KHR;
+}
+
 bool EglManager::setPreserveBuffer(EGLSurface surface, bool preserve) {
     if (CC_UNLIKELY(!mAllowPreserveBuffer)) return false;
 
@@ -16,8 +16,11 @@
 #ifndef EGLMANAGER_H
 #define EGLMANAGER_H
 
+#include "DamageAccumulator.h"
+
 #include <cutils/compiler.h>
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <SkRect.h>
 #include <ui/GraphicBuffer.h>
 #include <utils/StrongPointer.h>
@@ -28,6 +31,14 @@ namespace renderthread {
 
 class RenderThread;
 
+// A point in the GPU command stream that can be waited on, see
+// EglManager::insertFence(). Fences from before the EGL context was last
+// destroyed are ignored.
+struct GpuFence {
+    EGLSyncKHR sync = EGL_NO_SYNC_KHR;
+    uint32_t generation = 0;
+};
+
 // This class contains the shared global EGL objects, such as EGLDisplay
 // and EGLConfig, which are re-used by CanvasContext
 class EglManager {
@@ -46,15 +57,37 @@ public:
     // Returns true if the current surface changed, false if it was already current
     bool makeCurrent(EGLSurface surface, EGLint* errOut = nullptr);
     void beginFrame(EGLSurface surface, EGLint* width, EGLint* height);
-    bool swapBuffers(EGLSurface surface, const SkRect& dirty, EGLint width, EGLint height);
+    // Each of the damage rects is passed to the compositor, empty damage means the whole surface
+    bool swapBuffers(EGLSurface surface, const DamageRects& damage, EGLint width, EGLint height);
+
+    // Returns true if the age of the back buffer of surfaces can be queried,
+    // letting surfaces that don't preserve their buffers redraw partially
+    bool hasBufferAge() const;
+    // Returns the number of frames since the current back buffer was last
+    // presented, or 0 if its content is undefined. Must be called after
+    // beginFrame() and before drawing.
+    EGLint queryBufferAge(EGLSurface surface);
+    // Restricts rendering into the current back buffer to dirty, if
+    // EGL_KHR_partial_update is available. Must be called after
+    // queryBufferAge() and before drawing. An empty rect means the whole buffer.
+    void damageFrame(EGLSurface surface, const SkRect& dirty, EGLint height);
 
     // Returns true iff the surface is now preserving buffers.
     bool setPreserveBuffer(EGLSurface surface, bool preserve);
 
     void setTextureAtlas(const sp<GraphicBuffer>& buffer, int64_t* map, size_t mapSize);
 
+    // Waits until all the GL commands issued so far have completed
     void fence();
 
+    // Places fence after the GL commands issued so far and flushes them,
+    // replacing the point previously held by fence
+    void insertFence(GpuFence* fence);
+    // Blocks until the commands before fence have completed or timeout
+    // expires, returns false on timeout. The fence is consumed on completion.
+    bool waitFence(GpuFence* fence, EGLTimeKHR timeout = EGL_FOREVER_KHR);
+    void destroyFence(GpuFence* fence);
+
 private:
     friend class RenderThread;
 
@@ -66,6 +99,7 @@ private:
     void loadConfig();
     void createContext();
     void initAtlas();
+    void initExtensions();
 
     RenderThread& mRenderThread;
 
@@ -77,7 +111,12 @@ private:
     const bool mAllowPreserveBuffer;
     bool mCanSetPreserveBuffer;
 
+    bool mHasBufferAge;
+    bool mHasPartialUpdate;
+
     EGLSurface mCurrentSurface;
+    // Incremented each time the EGL context is destroyed
+    uint32_t mGeneration;
 
     sp<GraphicBuffer> mAtlasBuffer;
     int64_t* mAtlasMap;
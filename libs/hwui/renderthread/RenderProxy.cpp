@@ -358,6 +358,20 @@ void RenderProxy::trimMemory(int level) {
     }
 }
 
+CREATE_BRIDGE1(preload, RenderThread* thread) {
+    args->thread->eglManager().initialize();
+    Caches::getInstance().programCache.preload();
+    return nullptr;
+}
+
+void RenderProxy::preload() {
+    // Queued without waiting, so EGL setup overlaps with the caller's own startup
+    RenderThread& thread = RenderThread::getInstance();
+    SETUP_TASK(preload);
+    args->thread = &thread;
+    thread.queue(task);
+}
+
 CREATE_BRIDGE2(overrideProperty, const char* name, const char* value) {
     Properties::overrideProperty(args->name, args->value);
     return nullptr;
@@ -384,6 +398,17 @@ void RenderProxy::fence() {
     postAndWait(task);
 }
 
+CREATE_BRIDGE1(waitForGpuCompletion, CanvasContext* context) {
+    args->context->waitForGpuCompletion();
+    return nullptr;
+}
+
+void RenderProxy::waitForGpuCompletion() {
+    SETUP_TASK(waitForGpuCompletion);
+    args->context = mContext;
+    postAndWait(task);
+}
+
 CREATE_BRIDGE1(stopDrawing, CanvasContext* context) {
     args->context->stopDrawing();
     return nullptr;
@@ -413,6 +438,7 @@ CREATE_BRIDGE4(dumpProfileInfo, CanvasContext* context, RenderThread* thread,
     if (args->dumpFlags & DumpFlags::FrameStats) {
         args->context->dumpFrames(args->fd);
     }
+    args->context->opProfiler().dump(args->fd);
     if (args->dumpFlags & DumpFlags::Reset) {
         args->context->resetFrameStats();
     }
@@ -439,6 +465,31 @@ void RenderProxy::resetProfileInfo() {
     postAndWait(task);
 }
 
+CREATE_BRIDGE2(setFrameExportFd, CanvasContext* context, int fd) {
+    args->context->profiler().setExportFd(args->fd);
+    return nullptr;
+}
+
+void RenderProxy::setFrameExportFd(int fd) {
+    SETUP_TASK(setFrameExportFd);
+    args->context = mContext;
+    args->fd = fd;
+    // wait, since the fd is only duplicated on the render thread
+    postAndWait(task);
+}
+
+CREATE_BRIDGE2(setFrameCollector, CanvasContext* context, std::vector<FrameInfo>* frames) {
+    args->context->setFrameCollector(args->frames);
+    return nullptr;
+}
+
+void RenderProxy::setFrameCollector(std::vector<FrameInfo>* frames) {
+    SETUP_TASK(setFrameCollector);
+    args->context = mContext;
+    args->frames = frames;
+    postAndWait(task);
+}
+
 CREATE_BRIDGE2(dumpGraphicsMemory, int fd, RenderThread* thread) {
     args->thread->jankTracker().dump(args->fd);
 
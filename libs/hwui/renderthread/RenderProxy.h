@@ -91,15 +91,22 @@ public:
 
     ANDROID_API void destroyHardwareResources();
     ANDROID_API static void trimMemory(int level);
+    ANDROID_API static void preload();
     ANDROID_API static void overrideProperty(const char* name, const char* value);
 
     ANDROID_API void fence();
+    // Unlike fence(), also waits for the GPU to complete this context's work
+    ANDROID_API void waitForGpuCompletion();
     ANDROID_API void stopDrawing();
     ANDROID_API void notifyFramePending();
 
     ANDROID_API void dumpProfileInfo(int fd, int dumpFlags);
+    ANDROID_API void setFrameExportFd(int fd);
     // Not exported, only used for testing
     void resetProfileInfo();
+    // Not exported, only used for testing. The FrameInfo of the frames drawn
+    // until this is called again with nullptr is appended to frames.
+    void setFrameCollector(std::vector<FrameInfo>* frames);
     ANDROID_API static void dumpGraphicsMemory(int fd);
 
     ANDROID_API void setTextureAtlas(const sp<GraphicBuffer>& buffer, int64_t* map, size_t size);
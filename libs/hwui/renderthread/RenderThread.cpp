@@ -27,6 +27,8 @@
 #include <sys/resource.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+
 namespace android {
 using namespace uirenderer::renderthread;
 ANDROID_SINGLETON_STATIC_INSTANCE(RenderThread);
@@ -125,6 +127,62 @@ void TaskQueue::remove(RenderTask* task) {
     }
 }
 
+bool DelayedTaskQueue::runsAfter(const Entry& lhs, const Entry& rhs) {
+    if (lhs.task->mRunAt != rhs.task->mRunAt) {
+        return lhs.task->mRunAt > rhs.task->mRunAt;
+    }
+    return lhs.sequence > rhs.sequence;
+}
+
+RenderTask* DelayedTaskQueue::next() {
+    if (mHeap.empty()) return nullptr;
+    RenderTask* ret = mHeap.front().task;
+    std::pop_heap(mHeap.begin(), mHeap.end(), runsAfter);
+    mHeap.pop_back();
+    return ret;
+}
+
+void DelayedTaskQueue::queue(RenderTask* task) {
+    mHeap.push_back({task, mSequence++});
+    std::push_heap(mHeap.begin(), mHeap.end(), runsAfter);
+}
+
+bool DelayedTaskQueue::remove(RenderTask* task) {
+    for (size_t i = 0; i < mHeap.size(); i++) {
+        if (mHeap[i].task == task) {
+            mHeap.erase(mHeap.begin() + i);
+            std::make_heap(mHeap.begin(), mHeap.end(), runsAfter);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IncomingTaskStack::push(RenderTask* task) {
+    RenderTask* head = mHead.load(std::memory_order_relaxed);
+    // Since the RenderTask itself forms the linked list it is not allowed
+    // to have the same task queued twice
+    LOG_ALWAYS_FATAL_IF(task->mNext || head == task, "Task is already in the queue!");
+    do {
+        task->mNext = head;
+    } while (!mHead.compare_exchange_weak(head, task));
+    return head == nullptr;
+}
+
+RenderTask* IncomingTaskStack::takeAll() {
+    RenderTask* head = mHead.exchange(nullptr);
+
+    // The stack hands out the most recently pushed task first, reverse it
+    RenderTask* reversed = nullptr;
+    while (head) {
+        RenderTask* next = head->mNext;
+        head->mNext = reversed;
+        reversed = head;
+        head = next;
+    }
+    return reversed;
+}
+
 class DispatchFrameCallbacks : public RenderTask {
 private:
     RenderThread* mRenderThread;
@@ -138,6 +196,7 @@ public:
 
 RenderThread::RenderThread() : Thread(true), Singleton<RenderThread>()
         , mNextWakeup(LLONG_MAX)
+        , mWakePending(false)
         , mDisplayEventReceiver(nullptr)
         , mVsyncRequested(false)
         , mFrameCallbackTaskPending(false)
@@ -267,13 +326,22 @@ bool RenderThread::threadLoop() {
         LOG_ALWAYS_FATAL_IF(result == Looper::POLL_ERROR,
                 "RenderThread Looper POLL_ERROR!");
 
+        // We're awake, anything queued from now on will be picked up before
+        // we go back to sleep so there is no need to wake us again
+        mNextWakeup = 0;
+        mWakePending = false;
+
         nsecs_t nextWakeup;
         // Process our queue, if we have anything
         while (RenderTask* task = nextTask(&nextWakeup)) {
             task->run();
             // task may have deleted itself, do not reference it again
         }
-        if (nextWakeup == LLONG_MAX) {
+        if (!mIncoming.isEmpty() || !mIncomingAtFront.isEmpty()) {
+            // A task was queued after nextTask() published mNextWakeup, its
+            // producer may have seen a stale value and skipped the wake()
+            timeoutMillis = 0;
+        } else if (nextWakeup == LLONG_MAX) {
             timeoutMillis = -1;
         } else {
             nsecs_t timeoutNanos = nextWakeup - systemTime(SYSTEM_TIME_MONOTONIC);
@@ -303,19 +371,25 @@ bool RenderThread::threadLoop() {
     return false;
 }
 
-void RenderThread::queue(RenderTask* task) {
-    AutoMutex _lock(mLock);
-    mQueue.queue(task);
-    if (mNextWakeup && task->mRunAt < mNextWakeup) {
-        mNextWakeup = 0;
+void RenderThread::wakeIfNeeded(nsecs_t runAt) {
+    // mNextWakeup is read after the task has been pushed, and the RenderThread
+    // checks the incoming stacks after publishing mNextWakeup, so either we
+    // see the time it is going to sleep until or it sees our task
+    if (runAt < mNextWakeup && !mWakePending.exchange(true)) {
         mLooper->wake();
     }
 }
 
+void RenderThread::queue(RenderTask* task) {
+    // Once pushed, the task may run and delete itself
+    const nsecs_t runAt = task->mRunAt;
+    mIncoming.push(task);
+    wakeIfNeeded(runAt);
+}
+
 void RenderThread::queueAtFront(RenderTask* task) {
-    AutoMutex _lock(mLock);
-    mQueue.queueAtFront(task);
-    mLooper->wake();
+    mIncomingAtFront.push(task);
+    wakeIfNeeded(0);
 }
 
 void RenderThread::queueAt(RenderTask* task, nsecs_t runAtNs) {
@@ -324,8 +398,10 @@ void RenderThread::queueAt(RenderTask* task, nsecs_t runAtNs) {
 }
 
 void RenderThread::remove(RenderTask* task) {
-    AutoMutex _lock(mLock);
-    mQueue.remove(task);
+    drainIncomingTasks();
+    if (!mDelayedQueue.remove(task)) {
+        mQueue.remove(task);
+    }
 }
 
 void RenderThread::postFrameCallback(IFrameCallback* callback) {
@@ -345,22 +421,48 @@ void RenderThread::pushBackFrameCallback(IFrameCallback* callback) {
     }
 }
 
-RenderTask* RenderThread::nextTask(nsecs_t* nextWakeup) {
-    AutoMutex _lock(mLock);
-    RenderTask* next = mQueue.peek();
-    if (!next) {
-        mNextWakeup = LLONG_MAX;
-    } else {
-        mNextWakeup = next->mRunAt;
-        // Most tasks won't be delayed, so avoid unnecessary systemTime() calls
-        if (next->mRunAt <= 0 || next->mRunAt <= systemTime(SYSTEM_TIME_MONOTONIC)) {
-            next = mQueue.next();
+void RenderThread::drainIncomingTasks() {
+    RenderTask* task = mIncoming.takeAll();
+    while (task) {
+        RenderTask* next = task->mNext;
+        task->mNext = nullptr;
+        if (task->mRunAt > 0) {
+            mDelayedQueue.queue(task);
         } else {
-            next = nullptr;
+            mQueue.queue(task);
+        }
+        task = next;
+    }
+
+    // The most recent queueAtFront() call runs first
+    task = mIncomingAtFront.takeAll();
+    while (task) {
+        RenderTask* next = task->mNext;
+        task->mNext = nullptr;
+        mQueue.queueAtFront(task);
+        task = next;
+    }
+}
+
+RenderTask* RenderThread::nextTask(nsecs_t* nextWakeup) {
+    drainIncomingTasks();
+
+    RenderTask* next = mQueue.next();
+    nsecs_t wakeup = next ? 0 : LLONG_MAX;
+    if (!next && !mDelayedQueue.isEmpty()) {
+        wakeup = mDelayedQueue.peek()->mRunAt;
+        if (wakeup <= systemTime(SYSTEM_TIME_MONOTONIC)) {
+            next = mDelayedQueue.next();
+            wakeup = 0;
         }
     }
+    // Only publish the time we will sleep until once we're about to, tasks
+    // queued while we are still running don't need to wake us up
+    if (!next) {
+        mNextWakeup = wakeup;
+    }
     if (nextWakeup) {
-        *nextWakeup = mNextWakeup;
+        *nextWakeup = wakeup;
     }
     return next;
 }
@@ -29,8 +29,10 @@
 #include <utils/Singleton.h>
 #include <utils/Thread.h>
 
+#include <atomic>
 #include <memory>
 #include <set>
+#include <vector>
 
 namespace android {
 
@@ -62,6 +64,53 @@ private:
     RenderTask* mTail;
 };
 
+/**
+ * Min-heap of the delayed tasks, ordered by mRunAt. Tasks with the same
+ * mRunAt are run in the order they were queued.
+ *
+ * Only accessed from the RenderThread.
+ */
+class DelayedTaskQueue {
+public:
+    DelayedTaskQueue() : mSequence(0) {}
+
+    bool isEmpty() const { return mHeap.empty(); }
+    RenderTask* peek() const { return mHeap.empty() ? nullptr : mHeap.front().task; }
+    RenderTask* next();
+    void queue(RenderTask* task);
+    bool remove(RenderTask* task);
+
+private:
+    struct Entry {
+        RenderTask* task;
+        uint64_t sequence;
+    };
+
+    static bool runsAfter(const Entry& lhs, const Entry& rhs);
+
+    std::vector<Entry> mHeap;
+    uint64_t mSequence;
+};
+
+/**
+ * Lock-free multi-producer single-consumer stack of RenderTasks, linked
+ * through RenderTask::mNext. Any thread may push, only the RenderThread
+ * takes the tasks, all at once, in the order they were pushed.
+ */
+class IncomingTaskStack {
+public:
+    IncomingTaskStack() : mHead(nullptr) {}
+
+    // Returns true if the stack was empty before the push
+    bool push(RenderTask* task);
+    // Returns the pushed tasks, oldest first, as a list linked through mNext
+    RenderTask* takeAll();
+    bool isEmpty() const { return !mHead.load(); }
+
+private:
+    std::atomic<RenderTask*> mHead;
+};
+
 // Mimics android.view.Choreographer.FrameCallback
 class IFrameCallback {
 public:
@@ -78,6 +127,7 @@ public:
     ANDROID_API void queue(RenderTask* task);
     ANDROID_API void queueAtFront(RenderTask* task);
     void queueAt(RenderTask* task, nsecs_t runAtNs);
+    // Must be called on the RenderThread
     void remove(RenderTask* task);
 
     // Mimics android.view.Choreographer
@@ -116,12 +166,26 @@ private:
     // to the time to requery for the nextTask to run. mNextWakeup is also
     // set to this time
     RenderTask* nextTask(nsecs_t* nextWakeup);
+    // Moves the tasks queued by other threads into mQueue and mDelayedQueue
+    void drainIncomingTasks();
+    void wakeIfNeeded(nsecs_t runAt);
 
     sp<Looper> mLooper;
-    Mutex mLock;
 
-    nsecs_t mNextWakeup;
+    // The time at which the RenderThread will next look at its queues, 0 if
+    // it is currently awake and will drain the incoming tasks before sleeping
+    std::atomic<nsecs_t> mNextWakeup;
+    // Set once a wake() has been issued that the RenderThread hasn't received
+    // yet, so that a burst of queued tasks only wakes the looper once
+    std::atomic<bool> mWakePending;
+
+    // Written to by any thread
+    IncomingTaskStack mIncoming;
+    IncomingTaskStack mIncomingAtFront;
+
+    // Only accessed on the RenderThread
     TaskQueue mQueue;
+    DelayedTaskQueue mDelayedQueue;
 
     DisplayInfo mDisplayInfo;
 
@@ -30,6 +30,9 @@ HWUI_NULL_GPU := false
 include $(LOCAL_PATH)/Android.common.mk
 
 LOCAL_SRC_FILES += \
+	tests/BenchmarkReporter.cpp \
+	tests/ReplayScene.cpp \
+	tests/Scenes.cpp \
 	tests/TestContext.cpp \
 	tests/main.cpp
 
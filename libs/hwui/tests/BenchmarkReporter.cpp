@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BenchmarkReporter.h"
+#include "TestContext.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace android {
+namespace uirenderer {
+namespace test {
+
+// Frames taking longer than this missed a 60Hz vsync
+static const double kJankThresholdMs = 16.0;
+
+struct Metric {
+    const char* name;
+    FrameInfoIndex start;
+    FrameInfoIndex end;
+};
+
+static const Metric gMetrics[] = {
+    {"total", FrameInfoIndex::IntendedVsync, FrameInfoIndex::FrameCompleted},
+    {"sync", FrameInfoIndex::SyncStart, FrameInfoIndex::IssueDrawCommandsStart},
+    {"draw", FrameInfoIndex::IssueDrawCommandsStart, FrameInfoIndex::SwapBuffers},
+    {"swap", FrameInfoIndex::SwapBuffers, FrameInfoIndex::FrameCompleted},
+};
+
+static double percentile(const std::vector<double>& sorted, int percent) {
+    // Nearest rank, so that the value is always one of the samples
+    size_t rank = static_cast<size_t>(ceil(percent / 100.0 * sorted.size()));
+    return sorted[std::max(rank, static_cast<size_t>(1)) - 1];
+}
+
+DurationStats BenchmarkReporter::computeStats(const std::vector<FrameInfo>& frames,
+        FrameInfoIndex start, FrameInfoIndex end) {
+    DurationStats stats;
+    if (frames.empty()) return stats;
+
+    std::vector<double> durations;
+    durations.reserve(frames.size());
+    double sum = 0;
+    for (const FrameInfo& frame : frames) {
+        double duration = frame.duration(start, end) / 1000000.0;
+        durations.push_back(duration);
+        sum += duration;
+    }
+    std::sort(durations.begin(), durations.end());
+
+    stats.min = durations.front();
+    stats.p50 = percentile(durations, 50);
+    stats.p90 = percentile(durations, 90);
+    stats.p95 = percentile(durations, 95);
+    stats.p99 = percentile(durations, 99);
+    stats.max = durations.back();
+    stats.mean = sum / durations.size();
+    return stats;
+}
+
+static int countJankyFrames(const std::vector<FrameInfo>& frames) {
+    int count = 0;
+    for (const FrameInfo& frame : frames) {
+        double duration = frame.duration(FrameInfoIndex::IntendedVsync,
+                FrameInfoIndex::FrameCompleted) / 1000000.0;
+        if (duration > kJankThresholdMs) count++;
+    }
+    return count;
+}
+
+void BenchmarkReporter::print(FILE* out) const {
+    if (mJson) {
+        printJson(out);
+    } else {
+        printSummary(out);
+    }
+}
+
+void BenchmarkReporter::printJson(FILE* out) const {
+    fprintf(out, "{\n  \"display\": {\"width\": %d, \"height\": %d, \"density\": %.2f, "
+            "\"fps\": %.2f},\n", gDisplay.w, gDisplay.h, gDisplay.density, gDisplay.fps);
+    fprintf(out, "  \"benchmarks\": [");
+    for (size_t i = 0; i < mResults.size(); i++) {
+        const BenchmarkResult& result = mResults[i];
+        fprintf(out, "%s\n    {\n", i ? "," : "");
+        fprintf(out, "      \"name\": \"%s\",\n", result.name.c_str());
+        fprintf(out, "      \"run\": %d,\n", result.run);
+        fprintf(out, "      \"frames\": %zu,\n", result.frames.size());
+        fprintf(out, "      \"warmupFrames\": %d,\n", result.warmupFrames);
+        fprintf(out, "      \"jankyFrames\": %d,\n", countJankyFrames(result.frames));
+        fprintf(out, "      \"metrics\": {");
+        for (size_t m = 0; m < sizeof(gMetrics) / sizeof(gMetrics[0]); m++) {
+            const Metric& metric = gMetrics[m];
+            DurationStats stats = computeStats(result.frames, metric.start, metric.end);
+            fprintf(out, "%s\n        \"%s\": {\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+                    "\"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f, \"mean\": %.3f}",
+                    m ? "," : "", metric.name, stats.min, stats.p50, stats.p90,
+                    stats.p95, stats.p99, stats.max, stats.mean);
+        }
+        fprintf(out, "\n      }\n    }");
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+void BenchmarkReporter::printSummary(FILE* out) const {
+    for (const BenchmarkResult& result : mResults) {
+        fprintf(out, "\n%s (run %d): %zu frames, %d janky (> %.0fms)\n",
+                result.name.c_str(), result.run, result.frames.size(),
+                countJankyFrames(result.frames), kJankThresholdMs);
+        fprintf(out, "  %-6s %8s %8s %8s %8s %8s %8s %8s\n", "(ms)",
+                "min", "50th", "90th", "95th", "99th", "max", "mean");
+        for (const Metric& metric : gMetrics) {
+            DurationStats stats = computeStats(result.frames, metric.start, metric.end);
+            fprintf(out, "  %-6s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n", metric.name,
+                    stats.min, stats.p50, stats.p90, stats.p95, stats.p99, stats.max,
+                    stats.mean);
+        }
+    }
+}
+
+} // namespace test
+} // namespace uirenderer
+} // namespace android
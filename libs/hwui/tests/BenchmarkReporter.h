@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BENCHMARKREPORTER_H
+#define BENCHMARKREPORTER_H
+
+#include <FrameInfo.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+namespace test {
+
+/**
+ * Distribution of one of the stages of the frames of a benchmark run
+ */
+struct DurationStats {
+    double min = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double max = 0;
+    double mean = 0;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    int run = 0;
+    int warmupFrames = 0;
+    std::vector<FrameInfo> frames;
+};
+
+/**
+ * Prints benchmark results either as a human readable summary, or as JSON.
+ *
+ * The JSON output is meant to be diffed and parsed by scripts: keys are
+ * always emitted in the same order and durations are in milliseconds.
+ */
+class BenchmarkReporter {
+public:
+    BenchmarkReporter(bool json) : mJson(json) {}
+
+    void addResult(BenchmarkResult&& result) { mResults.push_back(std::move(result)); }
+    void print(FILE* out) const;
+
+    // Nearest rank percentiles of the duration between start and end, in ms
+    static DurationStats computeStats(const std::vector<FrameInfo>& frames,
+            FrameInfoIndex start, FrameInfoIndex end);
+
+private:
+    void printJson(FILE* out) const;
+    void printSummary(FILE* out) const;
+
+    bool mJson;
+    std::vector<BenchmarkResult> mResults;
+};
+
+} // namespace test
+} // namespace uirenderer
+} // namespace android
+
+#endif
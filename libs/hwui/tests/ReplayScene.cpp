@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TestScene.h"
+
+#include <DisplayListSerializer.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+namespace uirenderer {
+namespace test {
+
+/**
+ * Draws a frame captured with debug.hwui.capture_frame, redrawn as a whole
+ * every frame
+ */
+class ReplayScene : public TestScene {
+public:
+    explicit ReplayScene(const sp<RenderNode>& root) : mRoot(root) {}
+
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->drawRenderNode(mRoot.get());
+    }
+
+    void doFrame(int frameNr) override {
+        // Dirty properties damage the whole node when synced
+        mRoot->setPropertyFieldsDirty(RenderNode::GENERIC);
+    }
+
+private:
+    sp<RenderNode> mRoot;
+};
+
+std::unique_ptr<TestScene> createReplayScene(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: couldn't open %s\n", path);
+        return nullptr;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (!fstat(fd, &info) && info.st_size > 0) {
+        data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "Error: couldn't map %s\n", path);
+        return nullptr;
+    }
+
+    // The recorded display lists copy what they keep, the file can be unmapped
+    sp<RenderNode> root = DisplayListReader(data, info.st_size).readTree();
+    munmap(data, info.st_size);
+    if (!root.get()) {
+        fprintf(stderr, "Error: %s isn't a valid frame capture\n", path);
+        return nullptr;
+    }
+    return std::unique_ptr<TestScene>(new ReplayScene(root));
+}
+
+} // namespace test
+} // namespace uirenderer
+} // namespace android
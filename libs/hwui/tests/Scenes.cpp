@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TestScene.h"
+#include "TestContext.h"
+
+#include <SkBitmap.h>
+#include <SkPaint.h>
+#include <SkPath.h>
+
+#include <cstring>
+
+namespace android {
+namespace uirenderer {
+namespace test {
+
+class ShadowGridAnimation : public TestScene {
+public:
+    std::vector< sp<RenderNode> > cards;
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->insertReorderBarrier(true);
+
+        for (int x = dp(16); x < (width - dp(116)); x += dp(116)) {
+            for (int y = dp(16); y < (height - dp(116)); y += dp(116)) {
+                sp<RenderNode> card = createCard(x, y, dp(100), dp(100));
+                renderer->drawRenderNode(card.get());
+                cards.push_back(card);
+            }
+        }
+
+        renderer->insertReorderBarrier(false);
+    }
+    void doFrame(int frameNr) override {
+        int curFrame = frameNr % 150;
+        for (size_t ci = 0; ci < cards.size(); ci++) {
+            cards[ci]->mutateStagingProperties().setTranslationX(curFrame);
+            cards[ci]->mutateStagingProperties().setTranslationY(curFrame);
+            cards[ci]->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+        }
+    }
+private:
+    sp<RenderNode> createCard(int x, int y, int width, int height) {
+        sp<RenderNode> node = new RenderNode();
+        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
+        node->mutateStagingProperties().setElevation(dp(16));
+        node->mutateStagingProperties().mutableOutline().setRoundRect(0, 0, width, height, dp(10), 1);
+        node->mutateStagingProperties().mutableOutline().setShouldClip(true);
+        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y | RenderNode::Z);
+
+        DisplayListCanvas* renderer = startRecording(node.get());
+        renderer->drawColor(0xFFEEEEEE, SkXfermode::kSrcOver_Mode);
+        endRecording(renderer, node.get());
+        return node;
+    }
+};
+
+class ShadowGrid2Animation : public TestScene {
+public:
+    std::vector< sp<RenderNode> > cards;
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->insertReorderBarrier(true);
+
+        for (int x = dp(8); x < (width - dp(58)); x += dp(58)) {
+            for (int y = dp(8); y < (height - dp(58)); y += dp(58)) {
+                sp<RenderNode> card = createCard(x, y, dp(50), dp(50));
+                renderer->drawRenderNode(card.get());
+                cards.push_back(card);
+            }
+        }
+
+        renderer->insertReorderBarrier(false);
+    }
+    void doFrame(int frameNr) override {
+        int curFrame = frameNr % 150;
+        for (size_t ci = 0; ci < cards.size(); ci++) {
+            cards[ci]->mutateStagingProperties().setTranslationX(curFrame);
+            cards[ci]->mutateStagingProperties().setTranslationY(curFrame);
+            cards[ci]->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+        }
+    }
+private:
+    sp<RenderNode> createCard(int x, int y, int width, int height) {
+        sp<RenderNode> node = new RenderNode();
+        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
+        node->mutateStagingProperties().setElevation(dp(16));
+        node->mutateStagingProperties().mutableOutline().setRoundRect(0, 0, width, height, dp(6), 1);
+        node->mutateStagingProperties().mutableOutline().setShouldClip(true);
+        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y | RenderNode::Z);
+
+        DisplayListCanvas* renderer = startRecording(node.get());
+        renderer->drawColor(0xFFEEEEEE, SkXfermode::kSrcOver_Mode);
+        endRecording(renderer, node.get());
+        return node;
+    }
+};
+
+class RectGridAnimation : public TestScene {
+public:
+    sp<RenderNode> card;
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->insertReorderBarrier(true);
+
+        card = createCard(40, 40, 200, 200);
+        renderer->drawRenderNode(card.get());
+
+        renderer->insertReorderBarrier(false);
+    }
+    void doFrame(int frameNr) override {
+        int curFrame = frameNr % 150;
+        card->mutateStagingProperties().setTranslationX(curFrame);
+        card->mutateStagingProperties().setTranslationY(curFrame);
+        card->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+    }
+private:
+    sp<RenderNode> createCard(int x, int y, int width, int height) {
+        sp<RenderNode> node = new RenderNode();
+        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
+        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+
+        DisplayListCanvas* renderer = startRecording(node.get());
+        renderer->drawColor(0xFFFF00FF, SkXfermode::kSrcOver_Mode);
+
+        float rects[width * height];
+        int index = 0;
+        for (int xOffset = 0; xOffset < width; xOffset+=2) {
+            for (int yOffset = 0; yOffset < height; yOffset+=2) {
+                rects[index++] = xOffset;
+                rects[index++] = yOffset;
+                rects[index++] = xOffset + 1;
+                rects[index++] = yOffset + 1;
+            }
+        }
+        int count = width * height;
+
+        SkPaint paint;
+        paint.setColor(0xff00ffff);
+        renderer->drawRects(rects, count, &paint);
+
+        endRecording(renderer, node.get());
+        return node;
+    }
+};
+
+class OvalAnimation : public TestScene {
+public:
+    sp<RenderNode> card;
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->insertReorderBarrier(true);
+
+        card = createCard(40, 40, 400, 400);
+        renderer->drawRenderNode(card.get());
+
+        renderer->insertReorderBarrier(false);
+    }
+
+    void doFrame(int frameNr) override {
+        int curFrame = frameNr % 150;
+        card->mutateStagingProperties().setTranslationX(curFrame);
+        card->mutateStagingProperties().setTranslationY(curFrame);
+        card->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+    }
+private:
+    sp<RenderNode> createCard(int x, int y, int width, int height) {
+        sp<RenderNode> node = new RenderNode();
+        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
+        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+
+        DisplayListCanvas* renderer = startRecording(node.get());
+
+        SkPaint paint;
+        paint.setAntiAlias(true);
+        paint.setColor(0xFF000000);
+        renderer->drawOval(0, 0, width, height, paint);
+
+        endRecording(renderer, node.get());
+        return node;
+    }
+};
+
+class TextListAnimation : public TestScene {
+public:
+    std::vector< sp<RenderNode> > rows;
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->insertReorderBarrier(true);
+
+        // Twice the screen height so that there is always something to scroll to
+        int rowHeight = dp(48);
+        for (int y = 0; y < height * 2; y += rowHeight) {
+            sp<RenderNode> row = createRow(0, y, width, rowHeight, rows.size());
+            renderer->drawRenderNode(row.get());
+            rows.push_back(row);
+        }
+
+        renderer->insertReorderBarrier(false);
+    }
+    void doFrame(int frameNr) override {
+        // Scrolls down by one row every 10 frames, then jumps back up
+        int curFrame = frameNr % 150;
+        float scroll = -curFrame * dp(48) / 10.0f;
+        for (size_t ri = 0; ri < rows.size(); ri++) {
+            rows[ri]->mutateStagingProperties().setTranslationY(scroll);
+            rows[ri]->setPropertyFieldsDirty(RenderNode::Y);
+        }
+    }
+private:
+    sp<RenderNode> createRow(int x, int y, int width, int height, int index) {
+        sp<RenderNode> node = new RenderNode();
+        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
+        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+
+        DisplayListCanvas* renderer = startRecording(node.get());
+        renderer->drawColor(index % 2 ? 0xFFF5F5F5 : 0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+
+        SkPaint paint;
+        paint.setAntiAlias(true);
+        paint.setColor(0xFF000000);
+        paint.setTextSize(dp(index % 3 ? 14 : 20));
+        drawText(renderer, "The quick brown fox jumps over the lazy dog 0123456789",
+                paint, dp(16), height * 0.65f);
+
+        endRecording(renderer, node.get());
+        return node;
+    }
+
+    // Converts the text to glyphs, the way the framework hands text to hwui
+    static void drawText(DisplayListCanvas* renderer, const char* text, SkPaint& paint,
+            float x, float y) {
+        size_t length = strlen(text);
+        paint.setTextEncoding(SkPaint::kUTF8_TextEncoding);
+        int count = paint.textToGlyphs(text, length, nullptr);
+        std::unique_ptr<uint16_t[]> glyphs(new uint16_t[count]);
+        paint.textToGlyphs(text, length, glyphs.get());
+
+        paint.setTextEncoding(SkPaint::kGlyphID_TextEncoding);
+        std::unique_ptr<SkScalar[]> advances(new SkScalar[count]);
+        paint.getTextWidths(glyphs.get(), count * sizeof(uint16_t), advances.get());
+        std::unique_ptr<float[]> positions(new float[count * 2]);
+        float advance = 0;
+        for (int i = 0; i < count; i++) {
+            positions[i * 2] = advance;
+            positions[i * 2 + 1] = 0;
+            advance += advances[i];
+        }
+
+        SkRect bounds;
+        paint.measureText(glyphs.get(), count * sizeof(uint16_t), &bounds);
+        renderer->drawText(glyphs.get(), positions.get(), count, paint, x, y,
+                x + bounds.fLeft, y + bounds.fTop, x + bounds.fRight, y + bounds.fBottom,
+                advance);
+    }
+};
+
+class BitmapGridAnimation : public TestScene {
+public:
+    std::vector< sp<RenderNode> > cards;
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->insertReorderBarrier(true);
+
+        // A few distinct bitmaps, shared by the cards
+        static const SkColor colors[] = { 0xFFF44336, 0xFF4CAF50, 0xFF2196F3, 0xFFFFC107 };
+        int size = dp(64);
+        for (SkColor color : colors) {
+            bitmaps.emplace_back();
+            SkBitmap& bitmap = bitmaps.back();
+            bitmap.allocN32Pixels(size, size);
+            bitmap.eraseColor(color);
+            // A checkerboard so that the bitmaps aren't a single color
+            for (int y = 0; y < size; y += 8) {
+                for (int x = (y / 8) % 2 * 8; x < size; x += 16) {
+                    bitmap.eraseArea(SkIRect::MakeXYWH(x, y, 8, 8), 0xFFFFFFFF);
+                }
+            }
+        }
+
+        for (int x = dp(8); x < (width - dp(72)); x += dp(72)) {
+            for (int y = dp(8); y < (height - dp(72)); y += dp(72)) {
+                sp<RenderNode> card = createCard(x, y, size, size,
+                        bitmaps[cards.size() % bitmaps.size()]);
+                renderer->drawRenderNode(card.get());
+                cards.push_back(card);
+            }
+        }
+
+        renderer->insertReorderBarrier(false);
+    }
+    void doFrame(int frameNr) override {
+        int curFrame = frameNr % 150;
+        for (size_t ci = 0; ci < cards.size(); ci++) {
+            cards[ci]->mutateStagingProperties().setTranslationX(curFrame);
+            cards[ci]->mutateStagingProperties().setTranslationY(curFrame);
+            cards[ci]->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+        }
+    }
+private:
+    std::vector<SkBitmap> bitmaps;
+
+    sp<RenderNode> createCard(int x, int y, int width, int height, const SkBitmap& bitmap) {
+        sp<RenderNode> node = new RenderNode();
+        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
+        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+
+        DisplayListCanvas* renderer = startRecording(node.get());
+        renderer->drawBitmap(bitmap, 0, 0, nullptr);
+        endRecording(renderer, node.get());
+        return node;
+    }
+};
+
+class LayerAnimation : public TestScene {
+public:
+    std::vector< sp<RenderNode> > cards;
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->insertReorderBarrier(true);
+
+        for (int x = dp(16); x < (width - dp(116)); x += dp(116)) {
+            for (int y = dp(16); y < (height - dp(116)); y += dp(116)) {
+                sp<RenderNode> card = createCard(x, y, dp(100), dp(100));
+                renderer->drawRenderNode(card.get());
+                cards.push_back(card);
+            }
+        }
+
+        renderer->insertReorderBarrier(false);
+    }
+    void doFrame(int frameNr) override {
+        // Fading and rotating only composites the layers
+        int curFrame = frameNr % 150;
+        for (size_t ci = 0; ci < cards.size(); ci++) {
+            cards[ci]->mutateStagingProperties().setAlpha(0.4f + 0.6f * curFrame / 150.0f);
+            cards[ci]->mutateStagingProperties().setRotation(curFrame * 2.4f);
+            cards[ci]->setPropertyFieldsDirty(RenderNode::ALPHA | RenderNode::ROTATION);
+        }
+        // While updating one of them forces a layer update every frame
+        if (!cards.empty()) {
+            drawCardContent(cards[frameNr % cards.size()].get(), curFrame);
+        }
+    }
+private:
+    sp<RenderNode> createCard(int x, int y, int width, int height) {
+        sp<RenderNode> node = new RenderNode();
+        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
+        node->mutateStagingProperties().setPivotX(width / 2);
+        node->mutateStagingProperties().setPivotY(height / 2);
+        node->mutateStagingProperties().mutateLayerProperties().setType(LayerType::RenderLayer);
+        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y | RenderNode::GENERIC);
+
+        drawCardContent(node.get(), 0);
+        return node;
+    }
+
+    void drawCardContent(RenderNode* node, int frameNr) {
+        int width = node->stagingProperties().getWidth();
+        int height = node->stagingProperties().getHeight();
+
+        DisplayListCanvas* renderer = startRecording(node);
+        renderer->drawColor(0xFF3F51B5, SkXfermode::kSrcOver_Mode);
+
+        SkPaint paint;
+        paint.setAntiAlias(true);
+        paint.setColor(0xFFFF4081);
+        float inset = width / 8.0f + frameNr % 10;
+        renderer->drawRoundRect(inset, inset, width - inset, height - inset,
+                dp(8), dp(8), paint);
+        renderer->drawCircle(width / 2.0f, height / 2.0f, width / 8.0f, paint);
+        endRecording(renderer, node);
+    }
+};
+
+class ClipPathAnimation : public TestScene {
+public:
+    std::vector< sp<RenderNode> > cards;
+    void createContent(int width, int height, DisplayListCanvas* renderer) override {
+        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
+        renderer->insertReorderBarrier(true);
+
+        for (int x = dp(16); x < (width - dp(116)); x += dp(116)) {
+            for (int y = dp(16); y < (height - dp(116)); y += dp(116)) {
+                sp<RenderNode> card = createCard(x, y, dp(100), dp(100), cards.size());
+                renderer->drawRenderNode(card.get());
+                cards.push_back(card);
+            }
+        }
+
+        renderer->insertReorderBarrier(false);
+    }
+    void doFrame(int frameNr) override {
+        int curFrame = frameNr % 150;
+        for (size_t ci = 0; ci < cards.size(); ci++) {
+            cards[ci]->mutateStagingProperties().setTranslationX(curFrame);
+            cards[ci]->mutateStagingProperties().setTranslationY(curFrame);
+            cards[ci]->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+        }
+    }
+private:
+    sp<RenderNode> createCard(int x, int y, int width, int height, int index) {
+        sp<RenderNode> node = new RenderNode();
+        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
+        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+
+        // Alternates between a circle and a star, neither can be clipped
+        // with a scissor
+        SkPath path;
+        if (index % 2) {
+            path.addCircle(width / 2.0f, height / 2.0f, width / 2.0f);
+        } else {
+            path.moveTo(width / 2.0f, 0);
+            path.lineTo(width * 0.8f, height);
+            path.lineTo(0, height * 0.35f);
+            path.lineTo(width, height * 0.35f);
+            path.lineTo(width * 0.2f, height);
+            path.close();
+        }
+
+        DisplayListCanvas* renderer = startRecording(node.get());
+        renderer->save(SkCanvas::kMatrixClip_SaveFlag);
+        renderer->clipPath(&path, SkRegion::kIntersect_Op);
+        renderer->drawColor(0xFF009688, SkXfermode::kSrcOver_Mode);
+
+        SkPaint paint;
+        paint.setColor(0xFFFFEB3B);
+        renderer->drawRect(0, height / 2.0f, width, height, paint);
+        renderer->restore();
+        endRecording(renderer, node.get());
+        return node;
+    }
+};
+
+template <class T>
+static std::unique_ptr<TestScene> createScene() {
+    return std::unique_ptr<TestScene>(new T());
+}
+
+static const std::vector<SceneInfo> gScenes {
+    {"bitmapgrid", "a grid of bitmap cards sharing a few textures",
+            createScene<BitmapGridAnimation>},
+    {"clippath", "a grid of cards clipped to circles and stars, stencil clipping",
+            createScene<ClipPathAnimation>},
+    {"layers", "a grid of hardware layers fading and rotating, one of them redrawn every frame",
+            createScene<LayerAnimation>},
+    {"oval", "draws 1 oval", createScene<OvalAnimation>},
+    {"rectgrid", "creates a grid of 1x1 rects", createScene<RectGridAnimation>},
+    {"shadowgrid", "creates a grid of rounded rects that cast shadows, high CPU & GPU load",
+            createScene<ShadowGridAnimation>},
+    {"shadowgrid2", "a denser grid of smaller shadow casting rounded rects",
+            createScene<ShadowGrid2Animation>},
+    {"textlist", "a scrolling list of text rows in a few sizes", createScene<TextListAnimation>},
+};
+
+const std::vector<SceneInfo>& getScenes() {
+    return gScenes;
+}
+
+const SceneInfo* findScene(const char* name) {
+    for (const SceneInfo& scene : gScenes) {
+        if (!strcmp(scene.name, name)) return &scene;
+    }
+    return nullptr;
+}
+
+} // namespace test
+} // namespace uirenderer
+} // namespace android
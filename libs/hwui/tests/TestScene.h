@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TESTSCENE_H
+#define TESTSCENE_H
+
+#include <DisplayListCanvas.h>
+#include <RenderNode.h>
+
+#include <memory>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+namespace test {
+
+/**
+ * A scripted scene: its content is recorded once, then doFrame() animates it
+ * for every frame of the benchmark.
+ */
+class TestScene {
+public:
+    virtual ~TestScene() {}
+    virtual void createContent(int width, int height, DisplayListCanvas* renderer) = 0;
+    virtual void doFrame(int frameNr) = 0;
+
+    static DisplayListCanvas* startRecording(RenderNode* node) {
+        DisplayListCanvas* renderer = new DisplayListCanvas();
+        renderer->setViewport(node->stagingProperties().getWidth(),
+                node->stagingProperties().getHeight());
+        renderer->prepare();
+        return renderer;
+    }
+
+    static void endRecording(DisplayListCanvas* renderer, RenderNode* node) {
+        renderer->finish();
+        node->setStagingDisplayList(renderer->finishRecording());
+        delete renderer;
+    }
+};
+
+struct SceneInfo {
+    const char* name;
+    const char* description;
+    std::unique_ptr<TestScene> (*createScene)();
+};
+
+// All the scenes, sorted by name
+const std::vector<SceneInfo>& getScenes();
+// Returns nullptr if there is no scene with that name
+const SceneInfo* findScene(const char* name);
+// Replays a frame captured with debug.hwui.capture_frame, returns nullptr
+// if the file can't be read
+std::unique_ptr<TestScene> createReplayScene(const char* path);
+
+} // namespace test
+} // namespace uirenderer
+} // namespace android
+
+#endif
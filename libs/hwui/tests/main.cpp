@@ -24,10 +24,16 @@
 #include <renderthread/RenderProxy.h>
 #include <renderthread/RenderTask.h>
 
+#include "BenchmarkReporter.h"
 #include "TestContext.h"
+#include "TestScene.h"
 
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <utility>
 
 using namespace android;
 using namespace android::uirenderer;
@@ -41,300 +47,171 @@ public:
     }
 };
 
-static DisplayListCanvas* startRecording(RenderNode* node) {
-    DisplayListCanvas* renderer = new DisplayListCanvas();
-    renderer->setViewport(node->stagingProperties().getWidth(),
-            node->stagingProperties().getHeight());
-    renderer->prepare();
-    return renderer;
-}
-
-static void endRecording(DisplayListCanvas* renderer, RenderNode* node) {
-    renderer->finish();
-    node->setStagingDisplayList(renderer->finishRecording());
-    delete renderer;
-}
-
-class TreeContentAnimation {
-public:
-    virtual ~TreeContentAnimation() {}
+struct Options {
     int frameCount = 150;
-    virtual int getFrameCount() { return frameCount; }
-    virtual void setFrameCount(int fc) {
-        if (fc > 0) {
-            frameCount = fc;
-        }
-    }
-    virtual void createContent(int width, int height, DisplayListCanvas* renderer) = 0;
-    virtual void doFrame(int frameNr) = 0;
-
-    template <class T>
-    static void run(int frameCount) {
-        T animation;
-        animation.setFrameCount(frameCount);
-
-        TestContext testContext;
-
-        // create the native surface
-        const int width = gDisplay.w;
-        const int height = gDisplay.h;
-        sp<Surface> surface = testContext.surface();
-
-        RenderNode* rootNode = new RenderNode();
-        rootNode->incStrong(nullptr);
-        rootNode->mutateStagingProperties().setLeftTopRightBottom(0, 0, width, height);
-        rootNode->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
-        rootNode->mutateStagingProperties().setClipToBounds(false);
-        rootNode->setPropertyFieldsDirty(RenderNode::GENERIC);
-
-        ContextFactory factory;
-        std::unique_ptr<RenderProxy> proxy(new RenderProxy(false, rootNode, &factory));
-        proxy->loadSystemProperties();
-        proxy->initialize(surface);
-        float lightX = width / 2.0;
-        proxy->setup(width, height, dp(800.0f), 255 * 0.075, 255 * 0.15);
-        proxy->setLightCenter((Vector3){lightX, dp(-200.0f), dp(800.0f)});
-
-        android::uirenderer::Rect DUMMY;
-
-        DisplayListCanvas* renderer = startRecording(rootNode);
-        animation.createContent(width, height, renderer);
-        endRecording(renderer, rootNode);
-
-        // Do a few cold runs then reset the stats so that the caches are all hot
-        for (int i = 0; i < 3; i++) {
-            testContext.waitForVsync();
-            proxy->syncAndDrawFrame();
-        }
-        proxy->resetProfileInfo();
-
-        for (int i = 0; i < animation.getFrameCount(); i++) {
-            testContext.waitForVsync();
-
-            ATRACE_NAME("UI-Draw Frame");
-            nsecs_t vsync = systemTime(CLOCK_MONOTONIC);
-            UiFrameInfoBuilder(proxy->frameInfo())
-                    .setVsync(vsync, vsync);
-            animation.doFrame(i);
-            proxy->syncAndDrawFrame();
-        }
-
-        proxy->dumpProfileInfo(STDOUT_FILENO, 0);
-        rootNode->decStrong(nullptr);
-    }
-};
-
-class ShadowGridAnimation : public TreeContentAnimation {
-public:
-    std::vector< sp<RenderNode> > cards;
-    void createContent(int width, int height, DisplayListCanvas* renderer) override {
-        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
-        renderer->insertReorderBarrier(true);
-
-        for (int x = dp(16); x < (width - dp(116)); x += dp(116)) {
-            for (int y = dp(16); y < (height - dp(116)); y += dp(116)) {
-                sp<RenderNode> card = createCard(x, y, dp(100), dp(100));
-                renderer->drawRenderNode(card.get());
-                cards.push_back(card);
-            }
-        }
-
-        renderer->insertReorderBarrier(false);
-    }
-    void doFrame(int frameNr) override {
-        int curFrame = frameNr % 150;
-        for (size_t ci = 0; ci < cards.size(); ci++) {
-            cards[ci]->mutateStagingProperties().setTranslationX(curFrame);
-            cards[ci]->mutateStagingProperties().setTranslationY(curFrame);
-            cards[ci]->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
-        }
-    }
-private:
-    sp<RenderNode> createCard(int x, int y, int width, int height) {
-        sp<RenderNode> node = new RenderNode();
-        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
-        node->mutateStagingProperties().setElevation(dp(16));
-        node->mutateStagingProperties().mutableOutline().setRoundRect(0, 0, width, height, dp(10), 1);
-        node->mutateStagingProperties().mutableOutline().setShouldClip(true);
-        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y | RenderNode::Z);
-
-        DisplayListCanvas* renderer = startRecording(node.get());
-        renderer->drawColor(0xFFEEEEEE, SkXfermode::kSrcOver_Mode);
-        endRecording(renderer, node.get());
-        return node;
-    }
+    int warmupFrames = 10;
+    int runs = 1;
+    bool json = false;
 };
 
-class ShadowGrid2Animation : public TreeContentAnimation {
-public:
-    std::vector< sp<RenderNode> > cards;
-    void createContent(int width, int height, DisplayListCanvas* renderer) override {
-        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
-        renderer->insertReorderBarrier(true);
-
-        for (int x = dp(8); x < (width - dp(58)); x += dp(58)) {
-            for (int y = dp(8); y < (height - dp(58)); y += dp(58)) {
-                sp<RenderNode> card = createCard(x, y, dp(50), dp(50));
-                renderer->drawRenderNode(card.get());
-                cards.push_back(card);
-            }
-        }
-
-        renderer->insertReorderBarrier(false);
-    }
-    void doFrame(int frameNr) override {
-        int curFrame = frameNr % 150;
-        for (size_t ci = 0; ci < cards.size(); ci++) {
-            cards[ci]->mutateStagingProperties().setTranslationX(curFrame);
-            cards[ci]->mutateStagingProperties().setTranslationY(curFrame);
-            cards[ci]->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
-        }
-    }
-private:
-    sp<RenderNode> createCard(int x, int y, int width, int height) {
-        sp<RenderNode> node = new RenderNode();
-        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
-        node->mutateStagingProperties().setElevation(dp(16));
-        node->mutateStagingProperties().mutableOutline().setRoundRect(0, 0, width, height, dp(6), 1);
-        node->mutateStagingProperties().mutableOutline().setShouldClip(true);
-        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y | RenderNode::Z);
-
-        DisplayListCanvas* renderer = startRecording(node.get());
-        renderer->drawColor(0xFFEEEEEE, SkXfermode::kSrcOver_Mode);
-        endRecording(renderer, node.get());
-        return node;
+static BenchmarkResult runScene(const char* name, std::unique_ptr<TestScene> scene,
+        const Options& options, int run) {
+    TestContext testContext;
+
+    // create the native surface
+    const int width = gDisplay.w;
+    const int height = gDisplay.h;
+    sp<Surface> surface = testContext.surface();
+
+    RenderNode* rootNode = new RenderNode();
+    rootNode->incStrong(nullptr);
+    rootNode->mutateStagingProperties().setLeftTopRightBottom(0, 0, width, height);
+    rootNode->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+    rootNode->mutateStagingProperties().setClipToBounds(false);
+    rootNode->setPropertyFieldsDirty(RenderNode::GENERIC);
+
+    ContextFactory factory;
+    std::unique_ptr<RenderProxy> proxy(new RenderProxy(false, rootNode, &factory));
+    proxy->loadSystemProperties();
+    proxy->initialize(surface);
+    float lightX = width / 2.0;
+    proxy->setup(width, height, dp(800.0f), 255 * 0.075, 255 * 0.15);
+    proxy->setLightCenter((Vector3){lightX, dp(-200.0f), dp(800.0f)});
+
+    DisplayListCanvas* renderer = TestScene::startRecording(rootNode);
+    scene->createContent(width, height, renderer);
+    TestScene::endRecording(renderer, rootNode);
+
+    // Do a few cold runs then reset the stats so that the caches are all hot.
+    // The warmup frames are animated too so that the scene's layers, textures
+    // and paths for the first frames are already cached.
+    for (int i = 0; i < options.warmupFrames; i++) {
+        testContext.waitForVsync();
+        nsecs_t vsync = systemTime(CLOCK_MONOTONIC);
+        UiFrameInfoBuilder(proxy->frameInfo())
+                .setVsync(vsync, vsync);
+        scene->doFrame(i);
+        proxy->syncAndDrawFrame();
+    }
+    proxy->resetProfileInfo();
+
+    BenchmarkResult result;
+    result.name = name;
+    result.run = run;
+    result.warmupFrames = options.warmupFrames;
+    result.frames.reserve(options.frameCount);
+    proxy->setFrameCollector(&result.frames);
+
+    for (int i = 0; i < options.frameCount; i++) {
+        testContext.waitForVsync();
+
+        ATRACE_NAME("UI-Draw Frame");
+        nsecs_t vsync = systemTime(CLOCK_MONOTONIC);
+        UiFrameInfoBuilder(proxy->frameInfo())
+                .setVsync(vsync, vsync);
+        scene->doFrame(i);
+        proxy->syncAndDrawFrame();
+    }
+
+    proxy->setFrameCollector(nullptr);
+    if (!options.json) {
+        proxy->dumpProfileInfo(STDOUT_FILENO, 0);
     }
-};
-
-class RectGridAnimation : public TreeContentAnimation {
-public:
-    sp<RenderNode> card;
-    void createContent(int width, int height, DisplayListCanvas* renderer) override {
-        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
-        renderer->insertReorderBarrier(true);
+    rootNode->decStrong(nullptr);
+    return result;
+}
 
-        card = createCard(40, 40, 200, 200);
-        renderer->drawRenderNode(card.get());
+static void printUsage() {
+    printf("Usage: hwuitest [options] [scene...]\n\n"
+            "Options:\n"
+            "  --list       lists the scenes\n"
+            "  --count=N    number of measured frames per run, default 150\n"
+            "  --warmup=N   number of frames drawn before measuring, default 10\n"
+            "  --runs=N     number of runs of each scene, default 1\n"
+            "  --json       prints the results as JSON on stdout\n"
+            "  --replay=F   replays the frame captured to file F, see debug.hwui.capture_frame\n\n"
+            "Default scene is 'shadowgrid'\n");
+}
 
-        renderer->insertReorderBarrier(false);
+static void listScenes() {
+    for (const SceneInfo& scene : getScenes()) {
+        printf("%-12s %s\n", scene.name, scene.description);
     }
-    void doFrame(int frameNr) override {
-        int curFrame = frameNr % 150;
-        card->mutateStagingProperties().setTranslationX(curFrame);
-        card->mutateStagingProperties().setTranslationY(curFrame);
-        card->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
-    }
-private:
-    sp<RenderNode> createCard(int x, int y, int width, int height) {
-        sp<RenderNode> node = new RenderNode();
-        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
-        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
+}
 
-        DisplayListCanvas* renderer = startRecording(node.get());
-        renderer->drawColor(0xFFFF00FF, SkXfermode::kSrcOver_Mode);
+// Parses the value of --name=N into value, returns false if arg isn't --name
+static bool parseIntOption(const char* arg, const char* name, int minValue, int* value,
+        bool* error) {
+    size_t length = strlen(name);
+    if (strncmp(arg, name, length) || arg[length] != '=') return false;
+
+    char* end;
+    long parsed = strtol(arg + length + 1, &end, 10);
+    if (*end || end == arg + length + 1 || parsed < minValue || parsed > INT_MAX) {
+        fprintf(stderr, "Invalid value for %s: %s\n", name, arg + length + 1);
+        *error = true;
+    } else {
+        *value = parsed;
+    }
+    return true;
+}
 
-        float rects[width * height];
-        int index = 0;
-        for (int xOffset = 0; xOffset < width; xOffset+=2) {
-            for (int yOffset = 0; yOffset < height; yOffset+=2) {
-                rects[index++] = xOffset;
-                rects[index++] = yOffset;
-                rects[index++] = xOffset + 1;
-                rects[index++] = yOffset + 1;
+int main(int argc, char* argv[]) {
+    Options options;
+    std::vector<const SceneInfo*> scenes;
+    std::vector<const char*> replays;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool error = false;
+        if (!strcmp(arg, "--list")) {
+            listScenes();
+            return 0;
+        } else if (!strcmp(arg, "--help")) {
+            printUsage();
+            return 0;
+        } else if (!strcmp(arg, "--json")) {
+            options.json = true;
+        } else if (!strncmp(arg, "--replay=", strlen("--replay="))) {
+            replays.push_back(arg + strlen("--replay="));
+        } else if (parseIntOption(arg, "--count", 1, &options.frameCount, &error)
+                || parseIntOption(arg, "--warmup", 0, &options.warmupFrames, &error)
+                || parseIntOption(arg, "--runs", 1, &options.runs, &error)) {
+            if (error) return 1;
+        } else if (arg[0] == '-') {
+            fprintf(stderr, "Unknown option %s\n", arg);
+            printUsage();
+            return 1;
+        } else {
+            const SceneInfo* scene = findScene(arg);
+            if (!scene) {
+                fprintf(stderr, "Error: couldn't find test %s\n", arg);
+                return 1;
             }
+            scenes.push_back(scene);
         }
-        int count = width * height;
-
-        SkPaint paint;
-        paint.setColor(0xff00ffff);
-        renderer->drawRects(rects, count, &paint);
-
-        endRecording(renderer, node.get());
-        return node;
-    }
-};
-
-class OvalAnimation : public TreeContentAnimation {
-public:
-    sp<RenderNode> card;
-    void createContent(int width, int height, DisplayListCanvas* renderer) override {
-        renderer->drawColor(0xFFFFFFFF, SkXfermode::kSrcOver_Mode);
-        renderer->insertReorderBarrier(true);
-
-        card = createCard(40, 40, 400, 400);
-        renderer->drawRenderNode(card.get());
-
-        renderer->insertReorderBarrier(false);
-    }
-
-    void doFrame(int frameNr) override {
-        int curFrame = frameNr % 150;
-        card->mutateStagingProperties().setTranslationX(curFrame);
-        card->mutateStagingProperties().setTranslationY(curFrame);
-        card->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
-    }
-private:
-    sp<RenderNode> createCard(int x, int y, int width, int height) {
-        sp<RenderNode> node = new RenderNode();
-        node->mutateStagingProperties().setLeftTopRightBottom(x, y, x + width, y + height);
-        node->setPropertyFieldsDirty(RenderNode::X | RenderNode::Y);
-
-        DisplayListCanvas* renderer = startRecording(node.get());
-
-        SkPaint paint;
-        paint.setAntiAlias(true);
-        paint.setColor(0xFF000000);
-        renderer->drawOval(0, 0, width, height, paint);
-
-        endRecording(renderer, node.get());
-        return node;
     }
-};
-
-struct cstr_cmp {
-    bool operator()(const char *a, const char *b) const {
-        return std::strcmp(a, b) < 0;
+    if (scenes.empty() && replays.empty()) {
+        scenes.push_back(findScene("shadowgrid"));
     }
-};
 
-typedef void (*testProc)(int);
-
-std::map<const char*, testProc, cstr_cmp> gTestMap {
-    {"shadowgrid", TreeContentAnimation::run<ShadowGridAnimation>},
-    {"shadowgrid2", TreeContentAnimation::run<ShadowGrid2Animation>},
-    {"rectgrid", TreeContentAnimation::run<RectGridAnimation> },
-    {"oval", TreeContentAnimation::run<OvalAnimation> },
-};
-
-int main(int argc, char* argv[]) {
-    const char* testName = argc > 1 ? argv[1] : "shadowgrid";
-    testProc proc = gTestMap[testName];
-    if(!proc) {
-        printf("Error: couldn't find test %s\n", testName);
-        return 1;
-    }
-    int loopCount = 1;
-    if (argc > 2) {
-        loopCount = atoi(argv[2]);
-        if (!loopCount) {
-            printf("Invalid loop count!\n");
-            return 1;
+    BenchmarkReporter reporter(options.json);
+    for (const SceneInfo* scene : scenes) {
+        for (int run = 0; run < options.runs; run++) {
+            reporter.addResult(runScene(scene->name, scene->createScene(), options, run));
         }
     }
-    int frameCount = 150;
-    if (argc > 3) {
-        frameCount = atoi(argv[3]);
-        if (frameCount < 1) {
-            printf("Invalid frame count!\n");
-            return 1;
+    for (const char* replay : replays) {
+        for (int run = 0; run < options.runs; run++) {
+            std::unique_ptr<TestScene> scene = createReplayScene(replay);
+            if (!scene) return 1;
+            reporter.addResult(runScene(replay, std::move(scene), options, run));
         }
     }
-    if (loopCount < 0) {
-        loopCount = INT_MAX;
-    }
-    for (int i = 0; i < loopCount; i++) {
-        proc(frameCount);
+    reporter.print(stdout);
+
+    if (!options.json) {
+        printf("Success!\n");
     }
-    printf("Success!\n");
     return 0;
 }
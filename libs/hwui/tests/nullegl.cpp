@@ -148,6 +148,11 @@ EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface) {
     return EGL_TRUE;
 }
 
+EGLBoolean eglSetDamageRegionKHR(EGLDisplay dpy, EGLSurface surface,
+                EGLint *rects, EGLint n_rects) {
+    return EGL_TRUE;
+}
+
 EGLImageKHR eglCreateImageKHR(EGLDisplay dpy, EGLContext ctx, EGLenum target, EGLClientBuffer buffer, const EGLint *attrib_list) {
     return (EGLImageKHR) malloc(sizeof(EGLImageKHR));
 }
@@ -264,6 +264,22 @@ void glDiscardFramebufferEXT(GLenum target, GLsizei numAttachments, const GLenum
 void glStartTilingQCOM(GLuint x, GLuint y, GLuint width, GLuint height, GLbitfield preserveMask) {}
 void glEndTilingQCOM(GLbitfield preserveMask) {}
 void glEGLImageTargetTexture2DOES(GLenum target, GLeglImageOES image) {}
+void glGenQueriesEXT(GLsizei n, GLuint *ids) {
+    glGenCommon(n, ids);
+}
+void glDeleteQueriesEXT(GLsizei n, const GLuint *ids) {}
+void glBeginQueryEXT(GLenum target, GLuint id) {}
+void glEndQueryEXT(GLenum target) {}
+void glGetQueryObjectuivEXT(GLuint id, GLenum pname, GLuint *params) {
+    *params = 0;
+}
+void glGetQueryObjectui64vEXT(GLuint id, GLenum pname, GLuint64 *params) {
+    *params = 0;
+}
+void glGetProgramBinaryOES(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary) {
+    *length = 0;
+}
+void glProgramBinaryOES(GLuint program, GLenum binaryFormat, const void *binary, GLint length) {}
 
 // GLES3
 void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
@@ -273,3 +289,6 @@ void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitf
 GLboolean glUnmapBuffer(GLenum target) {
     return GL_FALSE;
 }
+
+void glVertexAttribDivisor(GLuint index, GLuint divisor) {}
+void glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount) {}
@@ -39,7 +39,7 @@ TaskManager::TaskManager() {
     for (int i = 0; i < workerCount; i++) {
         String8 name;
         name.appendFormat("hwuiTask%d", i + 1);
-        mThreads.add(new WorkerThread(name));
+        mThreads.add(new WorkerThread(this, name));
     }
 }
 
@@ -59,21 +59,41 @@ void TaskManager::stop() {
     }
 }
 
-bool TaskManager::addTaskBase(const sp<TaskBase>& task, const sp<TaskProcessorBase>& processor) {
+bool TaskManager::addTaskBase(const sp<TaskBase>& task, const sp<TaskProcessorBase>& processor,
+        TaskPriority priority) {
     if (mThreads.size() > 0) {
         TaskWrapper wrapper(task, processor);
 
         size_t minQueueSize = INT_MAX;
         sp<WorkerThread> thread;
 
+        // Prefer waking up an idle worker, a busy one may be stuck in a long task
         for (size_t i = 0; i < mThreads.size(); i++) {
+            if (mThreads[i]->isIdle()) {
+                thread = mThreads[i];
+                break;
+            }
             if (mThreads[i]->getTaskCount() < minQueueSize) {
                 thread = mThreads[i];
                 minQueueSize = mThreads[i]->getTaskCount();
             }
         }
 
-        return thread->addTask(wrapper);
+        return thread->addTask(wrapper, priority);
+    }
+    return false;
+}
+
+bool TaskManager::takeTask(WorkerThread* worker, TaskWrapper& outTask) {
+    for (int i = 0; i < static_cast<int>(TaskPriority::NumPriorities); i++) {
+        TaskPriority priority = static_cast<TaskPriority>(i);
+        if (worker->takeTask(priority, outTask)) return true;
+
+        for (size_t j = 0; j < mThreads.size(); j++) {
+            if (mThreads[j].get() != worker && mThreads[j]->takeTask(priority, outTask)) {
+                return true;
+            }
+        }
     }
     return false;
 }
@@ -89,41 +109,67 @@ status_t TaskManager::WorkerThread::readyToRun() {
 
 bool TaskManager::WorkerThread::threadLoop() {
     mSignal.wait();
-    Vector<TaskWrapper> tasks;
-    {
-        Mutex::Autolock l(mLock);
-        tasks = mTasks;
-        mTasks.clear();
-    }
+    setProcessing(true);
 
-    for (size_t i = 0; i < tasks.size(); i++) {
-        const TaskWrapper& task = tasks.itemAt(i);
+    // The signal stays set if a task is added after the last takeTask(),
+    // so no task is left behind when going back to sleep
+    TaskWrapper task;
+    while (mManager->takeTask(this, task)) {
         task.mProcessor->process(task.mTask);
+        task = TaskWrapper();
     }
 
+    setProcessing(false);
     return true;
 }
 
-bool TaskManager::WorkerThread::addTask(TaskWrapper task) {
+bool TaskManager::WorkerThread::addTask(const TaskWrapper& task, TaskPriority priority) {
     if (!isRunning()) {
         run(mName.string(), PRIORITY_DEFAULT);
     } else if (exitPending()) {
         return false;
     }
 
-    ssize_t index;
     {
         Mutex::Autolock l(mLock);
-        index = mTasks.add(task);
+        mTasks[static_cast<int>(priority)].push_back(task);
     }
     mSignal.signal();
 
-    return index >= 0;
+    return true;
+}
+
+bool TaskManager::WorkerThread::takeTask(TaskPriority priority, TaskWrapper& outTask) {
+    Mutex::Autolock l(mLock);
+    std::deque<TaskWrapper>& tasks = mTasks[static_cast<int>(priority)];
+    if (tasks.empty()) return false;
+
+    outTask = tasks.front();
+    tasks.pop_front();
+    return true;
 }
 
 size_t TaskManager::WorkerThread::getTaskCount() const {
     Mutex::Autolock l(mLock);
-    return mTasks.size();
+    size_t count = 0;
+    for (int i = 0; i < static_cast<int>(TaskPriority::NumPriorities); i++) {
+        count += mTasks[i].size();
+    }
+    return count;
+}
+
+bool TaskManager::WorkerThread::isIdle() const {
+    Mutex::Autolock l(mLock);
+    if (mProcessing) return false;
+    for (int i = 0; i < static_cast<int>(TaskPriority::NumPriorities); i++) {
+        if (!mTasks[i].empty()) return false;
+    }
+    return true;
+}
+
+void TaskManager::WorkerThread::setProcessing(bool processing) {
+    Mutex::Autolock l(mLock);
+    mProcessing = processing;
 }
 
 void TaskManager::WorkerThread::exit() {
@@ -24,6 +24,8 @@
 
 #include "Signal.h"
 
+#include <deque>
+
 namespace android {
 namespace uirenderer {
 
@@ -35,6 +37,24 @@ template <typename T>
 class TaskProcessor;
 class TaskProcessorBase;
 
+enum class TaskPriority {
+    // Needed by the frame being drawn, which may soon wait on the result
+    Frame,
+    // Speculative work ahead of the frame that needs it, only runs once
+    // no frame task is left
+    Prefetch,
+
+    NumPriorities
+};
+
+/**
+ * Runs tasks on a few worker threads.
+ *
+ * Each worker has its own queue per priority. A worker that runs out of
+ * tasks of a priority steals the oldest ones of the other workers before
+ * moving on to the next priority, so short tasks don't wait behind a long
+ * task that keeps their worker busy.
+ */
 class TaskManager {
 public:
     TaskManager();
@@ -58,11 +78,13 @@ private:
     friend class TaskProcessor;
 
     template<typename T>
-    bool addTask(const sp<Task<T> >& task, const sp<TaskProcessor<T> >& processor) {
-        return addTaskBase(sp<TaskBase>(task), sp<TaskProcessorBase>(processor));
+    bool addTask(const sp<Task<T> >& task, const sp<TaskProcessor<T> >& processor,
+            TaskPriority priority) {
+        return addTaskBase(sp<TaskBase>(task), sp<TaskProcessorBase>(processor), priority);
     }
 
-    bool addTaskBase(const sp<TaskBase>& task, const sp<TaskProcessorBase>& processor);
+    bool addTaskBase(const sp<TaskBase>& task, const sp<TaskProcessorBase>& processor,
+            TaskPriority priority);
 
     struct TaskWrapper {
         TaskWrapper(): mTask(), mProcessor() { }
@@ -77,19 +99,29 @@ private:
 
     class WorkerThread: public Thread {
     public:
-        WorkerThread(const String8 name): mSignal(Condition::WAKE_UP_ONE), mName(name) { }
+        WorkerThread(TaskManager* manager, const String8 name)
+                : mManager(manager), mSignal(Condition::WAKE_UP_ONE), mName(name) { }
 
-        bool addTask(TaskWrapper task);
+        bool addTask(const TaskWrapper& task, TaskPriority priority);
+        // Takes the oldest task of the given priority, returns false if there is none
+        bool takeTask(TaskPriority priority, TaskWrapper& outTask);
         size_t getTaskCount() const;
+        // True if the worker is waiting for tasks
+        bool isIdle() const;
         void exit();
 
     private:
         virtual status_t readyToRun() override;
         virtual bool threadLoop() override;
 
-        // Lock for the list of tasks
+        void setProcessing(bool processing);
+
+        TaskManager* const mManager;
+
+        // Lock for the queues of tasks and mProcessing
         mutable Mutex mLock;
-        Vector<TaskWrapper> mTasks;
+        std::deque<TaskWrapper> mTasks[static_cast<int>(TaskPriority::NumPriorities)];
+        bool mProcessing = false;
 
         // Signal used to wake up the thread when a new
         // task is available in the list
@@ -98,6 +130,10 @@ private:
         const String8 mName;
     };
 
+    // Takes the next task for the worker, from its own queues or from the other workers'
+    bool takeTask(WorkerThread* worker, TaskWrapper& outTask);
+
+    // Set by the constructor, never modified afterwards
     Vector<sp<WorkerThread> > mThreads;
 };
 
@@ -39,8 +39,8 @@ public:
     TaskProcessor(TaskManager* manager): mManager(manager) { }
     virtual ~TaskProcessor() { }
 
-    void add(const sp<Task<T> >& task) {
-        if (!addImpl(task)) {
+    void add(const sp<Task<T> >& task, TaskPriority priority = TaskPriority::Frame) {
+        if (!addImpl(task, priority)) {
             // fall back to immediate execution
             process(task);
         }
@@ -49,7 +49,7 @@ public:
     virtual void onProcess(const sp<Task<T> >& task) = 0;
 
 private:
-    bool addImpl(const sp<Task<T> >& task);
+    bool addImpl(const sp<Task<T> >& task, TaskPriority priority);
 
     virtual void process(const sp<TaskBase>& task) override {
         sp<Task<T> > realTask = static_cast<Task<T>* >(task.get());
@@ -62,10 +62,10 @@ private:
 };
 
 template<typename T>
-bool TaskProcessor<T>::addImpl(const sp<Task<T> >& task) {
+bool TaskProcessor<T>::addImpl(const sp<Task<T> >& task, TaskPriority priority) {
     if (mManager) {
         sp<TaskProcessor<T> > self(this);
-        return mManager->addTask(task, self);
+        return mManager->addTask(task, self, priority);
     }
     return false;
 }
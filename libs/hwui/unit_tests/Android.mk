@@ -26,9 +26,16 @@ LOCAL_MODULE_TAGS := tests
 include $(LOCAL_PATH)/Android.common.mk
 
 LOCAL_SRC_FILES += \
+    unit_tests/AssetAtlasTests.cpp \
     unit_tests/ClipAreaTests.cpp \
     unit_tests/DamageAccumulatorTests.cpp \
+    unit_tests/DisplayListCanvasTests.cpp \
+    unit_tests/DistanceFieldTests.cpp \
+    unit_tests/FlatLruCacheTests.cpp \
+    unit_tests/InterpolatorTests.cpp \
     unit_tests/LinearAllocatorTests.cpp \
+    unit_tests/PixelConvertTests.cpp \
+    unit_tests/SpotShadowTests.cpp \
     unit_tests/main.cpp
 
 
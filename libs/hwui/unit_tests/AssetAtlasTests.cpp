@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <AssetAtlas.h>
+
+using namespace android;
+using namespace android::uirenderer;
+
+typedef AssetAtlas::ShelfPacker ShelfPacker;
+
+TEST(ShelfPacker, fillsShelvesLeftToRight) {
+    ShelfPacker packer(100);
+    uint32_t x, y;
+
+    EXPECT_TRUE(packer.allocate(40, 10, &x, &y));
+    EXPECT_EQ(0u, x);
+    EXPECT_EQ(0u, y);
+    EXPECT_TRUE(packer.allocate(40, 30, &x, &y));
+    EXPECT_EQ(40u, x);
+    EXPECT_EQ(0u, y);
+
+    // Doesn't fit the rest of the shelf, starts one above the tallest
+    EXPECT_TRUE(packer.allocate(30, 20, &x, &y));
+    EXPECT_EQ(0u, x);
+    EXPECT_EQ(30u, y);
+    EXPECT_TRUE(packer.allocate(70, 5, &x, &y));
+    EXPECT_EQ(30u, x);
+    EXPECT_EQ(30u, y);
+}
+
+TEST(ShelfPacker, fullArea) {
+    ShelfPacker packer(64);
+    uint32_t x, y;
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(packer.allocate(64, 16, &x, &y));
+        EXPECT_EQ(0u, x);
+        EXPECT_EQ(16u * i, y);
+    }
+    EXPECT_FALSE(packer.allocate(1, 1, &x, &y));
+}
+
+TEST(ShelfPacker, tooLarge) {
+    ShelfPacker packer(64);
+    uint32_t x, y;
+
+    EXPECT_FALSE(packer.allocate(65, 1, &x, &y));
+    EXPECT_FALSE(packer.allocate(1, 65, &x, &y));
+
+    // A failed allocation doesn't waste space
+    EXPECT_TRUE(packer.allocate(64, 64, &x, &y));
+    EXPECT_EQ(0u, x);
+    EXPECT_EQ(0u, y);
+}
+
+TEST(ShelfPacker, reset) {
+    ShelfPacker packer(32);
+    uint32_t x, y;
+
+    EXPECT_TRUE(packer.allocate(32, 32, &x, &y));
+    EXPECT_FALSE(packer.allocate(8, 8, &x, &y));
+
+    packer.reset();
+    EXPECT_TRUE(packer.allocate(8, 8, &x, &y));
+    EXPECT_EQ(0u, x);
+    EXPECT_EQ(0u, y);
+}
@@ -85,6 +85,31 @@ TEST(RectangleList, basics) {
     EXPECT_FALSE(rgn.isEmpty());
 }
 
+TEST(RectangleList, offsetTransforms) {
+    RectangleList list;
+    Matrix4 m45;
+    m45.loadRotate(45);
+    list.set(Rect(0, 0, 100, 100), m45);
+
+    // A child offset within the rotated parent shares its rectangle
+    Matrix4 child(m45);
+    child.translate(10, 20);
+    EXPECT_TRUE(list.intersectWith(Rect(0, 0, 100, 100), child));
+    EXPECT_EQ(1, list.getTransformedRectanglesCount());
+    const Rect& bounds = list.getTransformedRectangle(0).getBounds();
+    EXPECT_NEAR(10, bounds.left, 0.001f);
+    EXPECT_NEAR(20, bounds.top, 0.001f);
+    EXPECT_NEAR(100, bounds.right, 0.001f);
+    EXPECT_NEAR(100, bounds.bottom, 0.001f);
+
+    // Nesting deeper than the list capacity still fits
+    for (int i = 0; i < 10; i++) {
+        child.translate(1, 1);
+        EXPECT_TRUE(list.intersectWith(Rect(0, 0, 100, 100), child));
+    }
+    EXPECT_EQ(1, list.getTransformedRectanglesCount());
+}
+
 TEST(ClipArea, basics) {
     ClipArea area(createClipArea());
     EXPECT_FALSE(area.isEmpty());
@@ -123,5 +148,22 @@ TEST(ClipArea, replaceNegative) {
     area.clipRectWithTransform(expected, &transform, SkRegion::kReplace_Op);
     EXPECT_EQ(expected, area.getClipRect());
 }
+
+TEST(ClipArea, rectangleListBounds) {
+    ClipArea area(createClipArea());
+    area.setClip(0, 0, 1000, 1000);
+
+    Matrix4 m45;
+    m45.loadRotate(45);
+    area.clipRectWithTransform(Rect(0, 0, 100, 100), &m45, SkRegion::kIntersect_Op);
+    EXPECT_TRUE(area.isRectangleList());
+
+    // The clip rect tracks the bounds of the intersection
+    Matrix4 identity;
+    identity.loadIdentity();
+    area.clipRectWithTransform(Rect(0, 0, 50, 50), &identity, SkRegion::kIntersect_Op);
+    EXPECT_TRUE(area.isRectangleList());
+    EXPECT_EQ(Rect(0, 0, 50, 50), area.getClipRect());
+}
 }
 }
@@ -79,3 +79,50 @@ TEST(DamageAccumulator, union) {
     da.finish(&curDirty);
     ASSERT_EQ(SkRect::MakeLTRB(50, 50, 200, 125), curDirty);
 }
+
+// Test that far apart siblings keep separate damage rects, and that the
+// rects are still mapped by the transforms they pass through
+TEST(DamageAccumulator, separateRects) {
+    DamageAccumulator da;
+    Matrix4 identity;
+    Matrix4 translate;
+    DamageRects damage;
+    identity.loadIdentity();
+    translate.loadTranslate(10, 20, 0);
+    da.pushTransform(&translate);
+    da.pushTransform(&identity);
+    da.dirty(0, 0, 10, 10);
+    da.popTransform();
+    da.pushTransform(&identity);
+    da.dirty(500, 500, 510, 510);
+    da.popTransform();
+    da.popTransform();
+    da.finish(&damage);
+    ASSERT_EQ(2, damage.count());
+    SkRect first = damage[0].left() < damage[1].left() ? damage[0] : damage[1];
+    SkRect second = damage[0].left() < damage[1].left() ? damage[1] : damage[0];
+    EXPECT_EQ(SkRect::MakeLTRB(10, 20, 20, 30), first);
+    EXPECT_EQ(SkRect::MakeLTRB(510, 520, 520, 530), second);
+    EXPECT_EQ(SkRect::MakeLTRB(10, 20, 520, 530), damage.bounds());
+}
+
+// Test that overlapping rects are merged, and that damage beyond the rect
+// limit is merged into the closest rect rather than dropped
+TEST(DamageAccumulator, mergeRects) {
+    DamageRects damage;
+    damage.join(0, 0, 10, 10);
+    damage.join(5, 5, 15, 15);
+    ASSERT_EQ(1, damage.count());
+    EXPECT_EQ(SkRect::MakeLTRB(0, 0, 15, 15), damage[0]);
+
+    for (int i = 1; i <= DAMAGE_MAX_RECTS; i++) {
+        damage.join(i * 100, 0, i * 100 + 10, 10);
+    }
+    EXPECT_EQ(DAMAGE_MAX_RECTS, damage.count());
+    EXPECT_EQ(SkRect::MakeLTRB(0, 0, DAMAGE_MAX_RECTS * 100 + 10, 15), damage.bounds());
+    for (int i = 0; i < damage.count(); i++) {
+        for (int j = i + 1; j < damage.count(); j++) {
+            EXPECT_FALSE(SkRect::Intersects(damage[i], damage[j]));
+        }
+    }
+}
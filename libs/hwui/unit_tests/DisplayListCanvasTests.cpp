@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "DisplayList.h"
+#include "DisplayListCanvas.h"
+#include "DisplayListOp.h"
+#include "RenderNode.h"
+
+#include <SkPaint.h>
+
+using namespace android;
+using namespace android::uirenderer;
+
+namespace {
+
+class TrackedRenderNode : public RenderNode {
+public:
+    TrackedRenderNode(bool* destroyed) : mDestroyed(destroyed) {}
+    virtual ~TrackedRenderNode() { *mDestroyed = true; }
+
+private:
+    bool* mDestroyed;
+};
+
+// Records a node the way Picture::renderNode() does
+sp<RenderNode> createPictureNode(bool* destroyed) {
+    DisplayListCanvas recorder;
+    recorder.setViewport(100, 100);
+    recorder.prepare();
+    SkPaint paint;
+    recorder.drawRect(0, 0, 100, 100, paint);
+
+    sp<RenderNode> node = new TrackedRenderNode(destroyed);
+    node->setName("Picture");
+    node->setStagingDisplayList(recorder.finishRecording());
+    node->mutateStagingProperties().setLeftTopRightBottom(0, 0, 100, 100);
+    return node;
+}
+
+} // namespace
+
+TEST(DisplayListCanvas, drawRenderNodeOwnsNode) {
+    bool destroyed = false;
+    sp<RenderNode> child = createPictureNode(&destroyed);
+
+    DisplayListCanvas canvas;
+    canvas.setViewport(200, 200);
+    canvas.prepare();
+    canvas.drawRenderNode(child.get());
+    DisplayListData* data = canvas.finishRecording();
+
+    // Like the Picture being finalized or recorded again after it was drawn
+    child.clear();
+    EXPECT_FALSE(destroyed);
+
+    // Walk the parent's ops as a replay would
+    ASSERT_EQ(1u, data->children().size());
+    size_t renderNodeOps = 0;
+    for (size_t i = 0; i < data->displayListOps.size(); i++) {
+        if (data->displayListOps[i] == data->children()[0]) {
+            RenderNode* node = data->children()[0]->renderNode();
+            EXPECT_STREQ("Picture", node->getName());
+            EXPECT_EQ(100, node->stagingProperties().getWidth());
+            renderNodeOps++;
+        }
+    }
+    EXPECT_EQ(1u, renderNodeOps);
+
+    // The parent's display list was the last owner
+    delete data;
+    EXPECT_TRUE(destroyed);
+}
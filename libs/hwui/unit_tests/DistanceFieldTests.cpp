@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <utils/DistanceField.h>
+
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+static const int kSize = 16;
+static const int kSpread = 4;
+static const int kPaddedSize = kSize + 2 * kSpread;
+
+// A kSize mask holding a square from 4 to 11, inclusive
+static std::vector<uint8_t> createSquare() {
+    std::vector<uint8_t> mask(kSize * kSize, 0);
+    for (int y = 4; y < 12; y++) {
+        for (int x = 4; x < 12; x++) {
+            mask[y * kSize + x] = 255;
+        }
+    }
+    return mask;
+}
+
+TEST(DistanceField, edges) {
+    std::vector<uint8_t> src = createSquare();
+    std::vector<uint8_t> dst(kPaddedSize * kPaddedSize);
+    DistanceField::generate(src.data(), kSize, kSize, kSize, dst.data(), kPaddedSize, kSpread);
+
+    const int row = (8 + kSpread) * kPaddedSize;
+    // half a pixel away from the edge, on either side
+    EXPECT_EQ(143, dst[row + 4 + kSpread]);
+    EXPECT_EQ(112, dst[row + 3 + kSpread]);
+    // one pixel further in, 127 / kSpread higher
+    EXPECT_EQ(175, dst[row + 5 + kSpread]);
+    // further than kSpread outside
+    EXPECT_EQ(0, dst[0]);
+    EXPECT_EQ(0, dst[kPaddedSize * kPaddedSize - 1]);
+}
+
+TEST(DistanceField, symmetry) {
+    std::vector<uint8_t> src = createSquare();
+    std::vector<uint8_t> dst(kPaddedSize * kPaddedSize);
+    DistanceField::generate(src.data(), kSize, kSize, kSize, dst.data(), kPaddedSize, kSpread);
+
+    // the square is centered between pixels 7 and 8 of the mask
+    for (int y = 0; y < kPaddedSize; y++) {
+        for (int x = 0; x < kPaddedSize; x++) {
+            const int mirrorX = kPaddedSize - 1 - x;
+            const int mirrorY = kPaddedSize - 1 - y;
+            EXPECT_EQ(dst[y * kPaddedSize + x], dst[y * kPaddedSize + mirrorX]);
+            EXPECT_EQ(dst[y * kPaddedSize + x], dst[mirrorY * kPaddedSize + x]);
+            EXPECT_EQ(dst[y * kPaddedSize + x], dst[x * kPaddedSize + y]);
+        }
+    }
+}
+
+TEST(DistanceField, empty) {
+    std::vector<uint8_t> src(kSize * kSize, 127);
+    std::vector<uint8_t> dst(kPaddedSize * kPaddedSize, 1);
+    DistanceField::generate(src.data(), kSize, kSize, kSize, dst.data(), kPaddedSize, kSpread);
+    for (int i = 0; i < kPaddedSize * kPaddedSize; i++) {
+        EXPECT_EQ(0, dst[i]) << "pixel " << i;
+    }
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <utils/FlatLruCache.h>
+
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+namespace {
+
+// Few distinct hashes, so most keys share their probe sequence
+struct CollidingKey {
+    int id;
+
+    CollidingKey() : id(0) {}
+    CollidingKey(int id) : id(id) {}
+
+    bool operator==(const CollidingKey& other) const { return id == other.id; }
+};
+
+hash_t hash_type(const CollidingKey& key) {
+    return key.id % 3;
+}
+
+class RecordingListener : public OnEntryRemoved<CollidingKey, int> {
+public:
+    void operator()(CollidingKey& key, int& value) override {
+        removedKeys.push_back(key.id);
+        EXPECT_EQ(key.id * 10, value);
+    }
+
+    std::vector<int> removedKeys;
+};
+
+typedef FlatLruCache<CollidingKey, int> TestCache;
+
+} // namespace
+
+TEST(FlatLruCache, putAndGet) {
+    TestCache cache(TestCache::kUnlimitedCapacity);
+    for (int i = 1; i <= 100; i++) {
+        EXPECT_TRUE(cache.put(i, i * 10));
+    }
+    EXPECT_FALSE(cache.put(50, 0));
+    EXPECT_EQ(100u, cache.size());
+
+    for (int i = 1; i <= 100; i++) {
+        EXPECT_EQ(i * 10, cache.get(i));
+    }
+    EXPECT_EQ(0, cache.get(101));
+}
+
+TEST(FlatLruCache, removeOldestFollowsRecency) {
+    RecordingListener listener;
+    TestCache cache(TestCache::kUnlimitedCapacity);
+    cache.setOnEntryRemovedListener(&listener);
+    for (int i = 1; i <= 40; i++) {
+        cache.put(i, i * 10);
+    }
+    // Touched entries become the most recent ones, the table grew meanwhile
+    cache.get(1);
+    cache.get(2);
+
+    for (int i = 3; i <= 40; i++) {
+        EXPECT_TRUE(cache.removeOldest());
+    }
+    EXPECT_TRUE(cache.removeOldest());
+    EXPECT_TRUE(cache.removeOldest());
+    EXPECT_FALSE(cache.removeOldest());
+
+    ASSERT_EQ(40u, listener.removedKeys.size());
+    for (int i = 0; i < 38; i++) {
+        EXPECT_EQ(i + 3, listener.removedKeys[i]);
+    }
+    EXPECT_EQ(1, listener.removedKeys[38]);
+    EXPECT_EQ(2, listener.removedKeys[39]);
+}
+
+TEST(FlatLruCache, removeKeepsCollidingEntries) {
+    RecordingListener listener;
+    TestCache cache(TestCache::kUnlimitedCapacity);
+    cache.setOnEntryRemovedListener(&listener);
+    for (int i = 1; i <= 12; i++) {
+        cache.put(i, i * 10);
+    }
+
+    // Removing from the middle of the probe sequences shifts the others back
+    for (int i = 2; i <= 12; i += 2) {
+        EXPECT_TRUE(cache.remove(i));
+    }
+    EXPECT_FALSE(cache.remove(2));
+    EXPECT_EQ(6u, cache.size());
+    for (int i = 1; i <= 12; i++) {
+        EXPECT_EQ(i % 2 ? i * 10 : 0, cache.get(i));
+    }
+
+    int visited = 0;
+    TestCache::Iterator iter(cache);
+    while (iter.next()) {
+        EXPECT_EQ(1, iter.key().id % 2);
+        EXPECT_EQ(iter.key().id * 10, iter.value());
+        visited++;
+    }
+    EXPECT_EQ(6, visited);
+}
+
+TEST(FlatLruCache, capacity) {
+    RecordingListener listener;
+    TestCache cache(4);
+    cache.setOnEntryRemovedListener(&listener);
+    for (int i = 1; i <= 4; i++) {
+        cache.put(i, i * 10);
+    }
+    cache.get(1);
+    cache.put(5, 50);
+
+    EXPECT_EQ(4u, cache.size());
+    ASSERT_EQ(1u, listener.removedKeys.size());
+    EXPECT_EQ(2, listener.removedKeys[0]);
+    EXPECT_EQ(10, cache.get(1));
+}
+
+TEST(FlatLruCache, clear) {
+    RecordingListener listener;
+    TestCache cache(TestCache::kUnlimitedCapacity);
+    cache.setOnEntryRemovedListener(&listener);
+    for (int i = 1; i <= 3; i++) {
+        cache.put(i, i * 10);
+    }
+    cache.get(1);
+
+    cache.clear();
+    EXPECT_EQ(0u, cache.size());
+    EXPECT_EQ(0, cache.get(1));
+    ASSERT_EQ(3u, listener.removedKeys.size());
+    EXPECT_EQ(2, listener.removedKeys[0]);
+    EXPECT_EQ(3, listener.removedKeys[1]);
+    EXPECT_EQ(1, listener.removedKeys[2]);
+
+    // Usable again after releasing its table
+    EXPECT_TRUE(cache.put(7, 70));
+    EXPECT_EQ(70, cache.get(7));
+    cache.setOnEntryRemovedListener(nullptr);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <Interpolator.h>
+
+#include <cmath>
+
+using namespace android;
+using namespace android::uirenderer;
+
+static float accelerateDecelerate(float input) {
+    return (float)(cosf((input + 1) * M_PI) / 2.0f) + 0.5f;
+}
+
+TEST(Interpolator, accelerateDecelerateEndpoints) {
+    AccelerateDecelerateInterpolator interpolator;
+    EXPECT_EQ(accelerateDecelerate(0.0f), interpolator.interpolate(0.0f));
+    EXPECT_EQ(accelerateDecelerate(1.0f), interpolator.interpolate(1.0f));
+}
+
+TEST(Interpolator, accelerateDecelerateBaked) {
+    AccelerateDecelerateInterpolator interpolator;
+    for (int i = 0; i <= 1000; i++) {
+        float input = i / 1000.0f;
+        EXPECT_NEAR(accelerateDecelerate(input), interpolator.interpolate(input), 1e-4f)
+                << "input " << input;
+    }
+}
+
+TEST(Interpolator, accelerateDecelerateOutOfRange) {
+    AccelerateDecelerateInterpolator interpolator;
+    EXPECT_EQ(accelerateDecelerate(-0.25f), interpolator.interpolate(-0.25f));
+    EXPECT_EQ(accelerateDecelerate(1.25f), interpolator.interpolate(1.25f));
+}
@@ -106,3 +106,33 @@ TEST(LinearAllocator, rewind) {
     // Checking for a double-destroy case
     EXPECT_EQ(destroyed, false);
 }
+
+TEST(LinearAllocator, reusePages) {
+    LinearAllocator::trimPagePool();
+    {
+        LinearAllocator la;
+        la.alloc(64);
+    }
+    LinearAllocator::PagePoolStats stats = LinearAllocator::getPagePoolStats();
+    EXPECT_LT(0u, stats.pooledSize);
+    {
+        LinearAllocator la;
+        la.alloc(64);
+        EXPECT_EQ(0u, LinearAllocator::getPagePoolStats().pooledSize);
+    }
+    EXPECT_EQ(stats.reusedPages + 1, LinearAllocator::getPagePoolStats().reusedPages);
+    EXPECT_EQ(stats.allocatedPages, LinearAllocator::getPagePoolStats().allocatedPages);
+    EXPECT_EQ(stats.pooledSize, LinearAllocator::getPagePoolStats().pooledSize);
+
+    LinearAllocator::trimPagePool();
+    EXPECT_EQ(0u, LinearAllocator::getPagePoolStats().pooledSize);
+}
+
+TEST(LinearAllocator, dedicatedPagesNotPooled) {
+    LinearAllocator::trimPagePool();
+    {
+        LinearAllocator la;
+        la.alloc(64 * 1024);
+    }
+    EXPECT_EQ(0u, LinearAllocator::getPagePoolStats().pooledSize);
+}
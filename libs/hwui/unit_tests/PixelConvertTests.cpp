@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <utils/PixelConvert.h>
+
+#include <SkColorPriv.h>
+#include <SkUnPreMultiply.h>
+
+#include <vector>
+
+using namespace android;
+using namespace android::uirenderer;
+
+// Long enough to cover the vector loops and leave a scalar tail
+static const int kPixelCount = 16 * 4 + 3;
+
+// Opaque, transparent and translucent runs so every branch is taken
+static std::vector<SkColor> createColors() {
+    std::vector<SkColor> colors(kPixelCount);
+    uint32_t seed = 1;
+    for (int i = 0; i < kPixelCount; i++) {
+        seed = seed * 1103515245 + 12345;
+        SkColor rgb = seed & 0xFFFFFF;
+        switch ((i / 8) % 3) {
+            case 0: colors[i] = 0xFF000000 | rgb; break;
+            case 1: colors[i] = (i & 1) ? 0 : rgb; break;
+            default: colors[i] = (seed >> 24) << 24 | rgb; break;
+        }
+    }
+    return colors;
+}
+
+TEST(PixelConvert, premultiply) {
+    std::vector<SkColor> src = createColors();
+    std::vector<SkPMColor> dst(kPixelCount);
+    PixelConvert::premultiply(dst.data(), src.data(), kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        EXPECT_EQ(SkPreMultiplyColor(src[i]), dst[i]) << "pixel " << i;
+    }
+}
+
+TEST(PixelConvert, colorToPMColor) {
+    std::vector<SkColor> src = createColors();
+    std::vector<SkPMColor> dst(kPixelCount);
+    PixelConvert::colorToPMColor(dst.data(), src.data(), kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        SkColor c = src[i];
+        EXPECT_EQ(SkPackARGB32NoCheck(SkColorGetA(c), SkColorGetR(c), SkColorGetG(c),
+                SkColorGetB(c)), dst[i]) << "pixel " << i;
+    }
+}
+
+TEST(PixelConvert, colorToAlpha8) {
+    std::vector<SkColor> src = createColors();
+    std::vector<uint8_t> dst(kPixelCount);
+    PixelConvert::colorToAlpha8(dst.data(), src.data(), kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        EXPECT_EQ(SkColorGetA(src[i]), dst[i]) << "pixel " << i;
+    }
+}
+
+TEST(PixelConvert, unpremultiply) {
+    std::vector<SkColor> colors = createColors();
+    std::vector<SkPMColor> src(kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        src[i] = SkPreMultiplyColor(colors[i]);
+    }
+    std::vector<SkColor> dst(kPixelCount);
+    PixelConvert::unpremultiply(dst.data(), src.data(), kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        EXPECT_EQ(SkUnPreMultiply::PMColorToColor(src[i]), dst[i]) << "pixel " << i;
+    }
+}
+
+TEST(PixelConvert, pmColorToColor) {
+    std::vector<SkColor> src = createColors();
+    std::vector<SkColor> dst(kPixelCount);
+    PixelConvert::pmColorToColor(dst.data(), src.data(), kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        SkPMColor c = src[i];
+        EXPECT_EQ(SkColorSetARGB(SkGetPackedA32(c), SkGetPackedR32(c), SkGetPackedG32(c),
+                SkGetPackedB32(c)), dst[i]) << "pixel " << i;
+    }
+}
+
+TEST(PixelConvert, pmColorToOpaqueColor) {
+    std::vector<SkColor> src = createColors();
+    std::vector<SkColor> dst(kPixelCount);
+    PixelConvert::pmColorToOpaqueColor(dst.data(), src.data(), kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        SkPMColor c = src[i];
+        EXPECT_EQ(SkColorSetRGB(SkGetPackedR32(c), SkGetPackedG32(c), SkGetPackedB32(c)),
+                dst[i]) << "pixel " << i;
+    }
+}
+
+TEST(PixelConvert, rgb565ToColor) {
+    std::vector<uint16_t> src(kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        src[i] = i * 1021;
+    }
+    std::vector<SkColor> dst(kPixelCount);
+    PixelConvert::rgb565ToColor(dst.data(), src.data(), kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        uint16_t c = src[i];
+        EXPECT_EQ(SkColorSetRGB(SkPacked16ToR32(c), SkPacked16ToG32(c), SkPacked16ToB32(c)),
+                dst[i]) << "pixel " << i;
+    }
+}
+
+TEST(PixelConvert, alpha8ToColor) {
+    std::vector<uint8_t> src(kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        src[i] = i * 7;
+    }
+    std::vector<SkColor> dst(kPixelCount);
+    PixelConvert::alpha8ToColor(dst.data(), src.data(), kPixelCount);
+    for (int i = 0; i < kPixelCount; i++) {
+        EXPECT_EQ(SkColorSetARGB(src[i], src[i], src[i], src[i]), dst[i]) << "pixel " << i;
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <SpotShadow.h>
+#include <Vector.h>
+
+#include <cmath>
+
+using namespace android;
+using namespace android::uirenderer;
+
+// The batched projection must give what the projection of each vertex gives,
+// including for the vertices that are clamped
+TEST(SpotShadow, projectCasterToOutlinesMatchesScalar) {
+    const Vector3 lightCenter = {50.0f, -20.0f, 100.0f};
+    const float lightSize = 30.0f;
+    const Vector3 poly[] = {
+        {0.0f, 0.0f, 10.0f},
+        {10.0f, 0.0f, 0.0f},        // on the receiver
+        {10.0f, 10.0f, -5.0f},      // below the receiver
+        {0.0f, 10.0f, 100.0f},      // at the height of the light
+        {-5.0f, 5.0f, 150.0f},      // above the light
+        {-10.0f, 0.0f, 96.0f},      // past the cap
+        {-10.0f, -10.0f, 50.0f},
+        {0.0f, -10.0f, 100.0f},     // at the height of the light, in the scalar tail
+        {5.0f, -5.0f, -1.0f},       // below the receiver, in the scalar tail
+    };
+    const int polyLength = sizeof(poly) / sizeof(poly[0]);
+
+    Vector2 outlinePositions[polyLength];
+    float outlineRadii[polyLength];
+    SpotShadow::projectCasterToOutlines(lightCenter, lightSize, poly, polyLength,
+            outlinePositions, outlineRadii);
+
+    for (int i = 0; i < polyLength; i++) {
+        Vector2 expectedPosition;
+        float expectedRadius = lightSize *
+                SpotShadow::projectCasterToOutline(expectedPosition, lightCenter, poly[i]);
+        EXPECT_FALSE(std::isnan(outlineRadii[i])) << "vertex " << i;
+        EXPECT_NEAR(expectedPosition.x, outlinePositions[i].x, 1e-3f) << "vertex " << i;
+        EXPECT_NEAR(expectedPosition.y, outlinePositions[i].y, 1e-3f) << "vertex " << i;
+        EXPECT_NEAR(expectedRadius, outlineRadii[i], 1e-4f) << "vertex " << i;
+    }
+}
@@ -17,6 +17,15 @@
 #define LOG_TAG "OpenGLRenderer"
 
 #include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BLUR_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BLUR_USE_SSE2 1
+#endif
 
 #include "Blur.h"
 #include "MathUtils.h"
@@ -91,6 +100,59 @@ void Blur::generateGaussianWeights(float* weights, int32_t radius) {
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Vectorized kernel
+///////////////////////////////////////////////////////////////////////////////
+
+#if defined(BLUR_USE_NEON) || defined(BLUR_USE_SSE2)
+#define BLUR_VECTOR_WIDTH 4
+
+/**
+ * Computes BLUR_VECTOR_WIDTH adjacent blurred pixels. input points to the
+ * first tap of the first pixel and consecutive taps are stride bytes apart.
+ * The taps are accumulated in the same order as the scalar loops, and the
+ * result is truncated, so both paths produce the same output.
+ */
+static inline void blurVector(const float* weights, int32_t radius,
+        const uint8_t* input, int32_t stride, uint8_t* output) {
+    uint32_t pixels;
+#if defined(BLUR_USE_NEON)
+    float32x4_t blurred = vdupq_n_f32(0.0f);
+    for (int32_t r = -radius; r <= radius; r++) {
+        memcpy(&pixels, input, sizeof(pixels));
+        uint16x8_t wide = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(pixels)));
+        float32x4_t current = vcvtq_f32_u32(vmovl_u16(vget_low_u16(wide)));
+        blurred = vaddq_f32(blurred, vmulq_n_f32(current, *weights));
+        weights++;
+        input += stride;
+    }
+    uint16x4_t narrow = vmovn_u32(vcvtq_u32_f32(blurred));
+    uint8x8_t result = vmovn_u16(vcombine_u16(narrow, narrow));
+    pixels = vget_lane_u32(vreinterpret_u32_u8(result), 0);
+#else
+    const __m128i zero = _mm_setzero_si128();
+    __m128 blurred = _mm_setzero_ps();
+    for (int32_t r = -radius; r <= radius; r++) {
+        memcpy(&pixels, input, sizeof(pixels));
+        __m128i wide = _mm_unpacklo_epi8(_mm_cvtsi32_si128(pixels), zero);
+        __m128 current = _mm_cvtepi32_ps(_mm_unpacklo_epi16(wide, zero));
+        blurred = _mm_add_ps(blurred, _mm_mul_ps(current, _mm_set1_ps(*weights)));
+        weights++;
+        input += stride;
+    }
+    __m128i result = _mm_cvttps_epi32(blurred);
+    result = _mm_packs_epi32(result, result);
+    result = _mm_packus_epi16(result, result);
+    pixels = _mm_cvtsi128_si32(result);
+#endif
+    memcpy(output, &pixels, sizeof(pixels));
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Gaussian blur
+///////////////////////////////////////////////////////////////////////////////
+
 void Blur::horizontal(float* weights, int32_t radius,
         const uint8_t* source, uint8_t* dest, int32_t width, int32_t height) {
     float blurredPixel = 0.0f;
@@ -102,6 +164,15 @@ void Blur::horizontal(float* weights, int32_t radius,
         uint8_t* output = dest + y * width;
 
         for (int32_t x = 0; x < width; x ++) {
+#ifdef BLUR_VECTOR_WIDTH
+            // Non-border pixels are blurred a vector at a time
+            while (x > radius && x + BLUR_VECTOR_WIDTH <= width - radius) {
+                blurVector(weights, radius, input + (x - radius), 1, output);
+                output += BLUR_VECTOR_WIDTH;
+                x += BLUR_VECTOR_WIDTH;
+            }
+            if (x >= width) break;
+#endif
             blurredPixel = 0.0f;
             const float* gPtr = weights;
             // Optimization for non-border pixels
@@ -143,7 +214,19 @@ void Blur::vertical(float* weights, int32_t radius,
     for (int32_t y = 0; y < height; y ++) {
         uint8_t* output = dest + y * width;
 
-        for (int32_t x = 0; x < width; x ++) {
+        // Non-border rows are blurred a vector at a time
+        int32_t x = 0;
+#ifdef BLUR_VECTOR_WIDTH
+        if (y > radius && y < (height - radius)) {
+            const uint8_t* input = source + (y - radius) * width;
+            for (; x + BLUR_VECTOR_WIDTH <= width; x += BLUR_VECTOR_WIDTH) {
+                blurVector(weights, radius, input + x, width, output);
+                output += BLUR_VECTOR_WIDTH;
+            }
+        }
+#endif
+
+        for (; x < width; x ++) {
             blurredPixel = 0.0f;
             const float* gPtr = weights;
             const uint8_t* input = source + x;
@@ -179,5 +262,78 @@ void Blur::vertical(float* weights, int32_t radius,
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Box blur approximation
+///////////////////////////////////////////////////////////////////////////////
+
+#define BLUR_BOX_PASSES 3
+
+/**
+ * Computes the radii of BLUR_BOX_PASSES successive box blurs whose combined
+ * variance best approximates that of a gaussian of the specified sigma.
+ */
+static void computeBoxRadii(float sigma, int32_t* radii) {
+    const int32_t n = BLUR_BOX_PASSES;
+    const float variance = 12.0f * sigma * sigma;
+
+    int32_t lower = (int32_t) floorf(sqrtf(variance / n + 1.0f));
+    if (lower % 2 == 0) lower--;
+    if (lower < 1) lower = 1;
+    const int32_t upper = lower + 2;
+
+    const int32_t lowerCount = (int32_t) roundf(
+            (variance - n * lower * lower - 4 * n * lower - 3 * n) / (-4 * lower - 4));
+    for (int32_t i = 0; i < n; i++) {
+        radii[i] = ((i < lowerCount ? lower : upper) - 1) / 2;
+    }
+}
+
+/**
+ * Box blurs count runs of length pixels, the pixels of a run are step bytes
+ * apart and consecutive runs stride bytes apart. Edges are clamped like the
+ * gaussian passes.
+ */
+static void boxBlur(int32_t radius, const uint8_t* source, uint8_t* dest,
+        int32_t length, int32_t step, int32_t count, int32_t stride) {
+    const int32_t last = length - 1;
+    // 16.16 fixed point reciprocal of the box size
+    const uint32_t scale = (1 << 16) / (2 * radius + 1);
+
+    for (int32_t i = 0; i < count; i++) {
+        const uint8_t* input = source + i * stride;
+        uint8_t* output = dest + i * stride;
+
+        uint32_t sum = 0;
+        for (int32_t r = -radius; r <= radius; r++) {
+            sum += input[MathUtils::clamp(r, 0, last) * step];
+        }
+
+        for (int32_t p = 0; p < length; p++) {
+            output[p * step] = (uint8_t) ((sum * scale + (1 << 15)) >> 16);
+            sum += input[MathUtils::min(p + radius + 1, last) * step];
+            sum -= input[MathUtils::max(p - radius, 0) * step];
+        }
+    }
+}
+
+void Blur::boxApproximation(int32_t radius, uint8_t* image, uint8_t* scratch,
+        int32_t width, int32_t height) {
+    int32_t radii[BLUR_BOX_PASSES];
+    computeBoxRadii(legacyConvertRadiusToSigma((float) radius), radii);
+
+    // Ping-pong between both buffers, an odd number of passes per direction
+    // leaves the result in image once both directions are done
+    uint8_t* source = image;
+    uint8_t* dest = scratch;
+    for (int32_t i = 0; i < BLUR_BOX_PASSES; i++) {
+        boxBlur(radii[i], source, dest, width, 1, height, width);
+        uint8_t* tmp = source; source = dest; dest = tmp;
+    }
+    for (int32_t i = 0; i < BLUR_BOX_PASSES; i++) {
+        boxBlur(radii[i], source, dest, height, width, width, 1);
+        uint8_t* tmp = source; source = dest; dest = tmp;
+    }
+}
+
 }; // namespace uirenderer
 }; // namespace android
@@ -39,6 +39,16 @@ public:
         uint8_t* dest, int32_t width, int32_t height);
     static void vertical(float* weights, int32_t radius, const uint8_t* source,
         uint8_t* dest, int32_t width, int32_t height);
+
+    // Starting at this radius, boxApproximation() is cheaper than the
+    // gaussian passes and visually indistinguishable
+    static const int32_t kBoxApproximationMinRadius = 16;
+
+    // Approximates the gaussian blur of the specified radius with successive
+    // box blurs whose cost doesn't depend on the radius. image is blurred in
+    // place, scratch must be as large as image.
+    static void boxApproximation(int32_t radius, uint8_t* image, uint8_t* scratch,
+        int32_t width, int32_t height);
 };
 
 }; // namespace uirenderer
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <memory>
+
+#include "DistanceField.h"
+#include "MathUtils.h"
+
+namespace android {
+namespace uirenderer {
+
+static const float kFar = 1e20f;
+
+/**
+ * One dimensional squared euclidean distance transform of f, written to d,
+ * in linear time (Felzenszwalb and Huttenlocher, "Distance Transforms of
+ * Sampled Functions"). v and z are scratch arrays of n and n + 1 elements.
+ */
+static void transform(const float* f, float* d, int32_t n, int32_t* v, float* z) {
+    int32_t k = 0;
+    v[0] = 0;
+    z[0] = -kFar;
+    z[1] = kFar;
+    for (int32_t q = 1; q < n; q++) {
+        float s;
+        while (true) {
+            const int32_t p = v[k];
+            s = ((f[q] + q * q) - (f[p] + p * p)) / (2 * (q - p));
+            if (s > z[k]) break;
+            k--;
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = kFar;
+    }
+
+    k = 0;
+    for (int32_t q = 0; q < n; q++) {
+        while (z[k + 1] < q) k++;
+        const int32_t delta = q - v[k];
+        d[q] = delta * delta + f[v[k]];
+    }
+}
+
+// Replaces the grid of seeds (0) and far pixels (kFar) with its squared distance transform
+static void transform(float* grid, int32_t width, int32_t height) {
+    const int32_t n = MathUtils::max(width, height);
+    std::unique_ptr<float[]> f(new float[n]);
+    std::unique_ptr<float[]> d(new float[n]);
+    std::unique_ptr<int32_t[]> v(new int32_t[n]);
+    std::unique_ptr<float[]> z(new float[n + 1]);
+
+    for (int32_t x = 0; x < width; x++) {
+        for (int32_t y = 0; y < height; y++) f[y] = grid[y * width + x];
+        transform(f.get(), d.get(), height, v.get(), z.get());
+        for (int32_t y = 0; y < height; y++) grid[y * width + x] = d[y];
+    }
+
+    for (int32_t y = 0; y < height; y++) {
+        float* row = &grid[y * width];
+        transform(row, d.get(), width, v.get(), z.get());
+        memcpy(row, d.get(), width * sizeof(float));
+    }
+}
+
+void DistanceField::generate(const uint8_t* src, int32_t srcStride,
+        int32_t width, int32_t height, uint8_t* dst, int32_t dstStride, int32_t spread) {
+    const int32_t dstWidth = width + 2 * spread;
+    const int32_t dstHeight = height + 2 * spread;
+    const int32_t size = dstWidth * dstHeight;
+
+    // toInside seeds the pixels inside the shape, toOutside the others
+    std::unique_ptr<float[]> toInside(new float[size]);
+    std::unique_ptr<float[]> toOutside(new float[size]);
+    for (int32_t y = 0; y < dstHeight; y++) {
+        const int32_t srcY = y - spread;
+        for (int32_t x = 0; x < dstWidth; x++) {
+            const int32_t srcX = x - spread;
+            const bool inside = srcX >= 0 && srcX < width && srcY >= 0 && srcY < height
+                    && src[srcY * srcStride + srcX] >= 128;
+            toInside[y * dstWidth + x] = inside ? 0.0f : kFar;
+            toOutside[y * dstWidth + x] = inside ? kFar : 0.0f;
+        }
+    }
+
+    transform(toInside.get(), dstWidth, dstHeight);
+    transform(toOutside.get(), dstWidth, dstHeight);
+
+    const float scale = 127.0f / spread;
+    for (int32_t y = 0; y < dstHeight; y++) {
+        uint8_t* row = &dst[y * dstStride];
+        for (int32_t x = 0; x < dstWidth; x++) {
+            const int32_t index = y * dstWidth + x;
+            float distance = sqrtf(toOutside[index]) - sqrtf(toInside[index]);
+            // The edge runs between the centers of the last pixel inside and
+            // the first one outside
+            distance += distance > 0.0f ? -0.5f : 0.5f;
+            row[x] = (uint8_t) MathUtils::clamp(128.0f + distance * scale, 0.0f, 255.0f);
+        }
+    }
+}
+
+}; // namespace uirenderer
+}; // namespace android
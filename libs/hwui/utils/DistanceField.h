@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HWUI_DISTANCE_FIELD_H
+#define ANDROID_HWUI_DISTANCE_FIELD_H
+
+#include <stdint.h>
+#include <cutils/compiler.h>
+
+namespace android {
+namespace uirenderer {
+
+class DistanceField {
+public:
+    /**
+     * Converts an alpha mask into a signed distance field, padded by spread
+     * pixels on each side: dst must hold (height + 2 * spread) rows of
+     * (width + 2 * spread) pixels. Pixels whose alpha is at least 128 are
+     * inside the shape. Each output value is 128, the edge, plus the signed
+     * distance to the edge in pixels, positive inside, scaled so that spread
+     * pixels map to 127 and clamped.
+     */
+    ANDROID_API static void generate(const uint8_t* src, int32_t srcStride,
+            int32_t width, int32_t height, uint8_t* dst, int32_t dstStride, int32_t spread);
+};
+
+}; // namespace uirenderer
+}; // namespace android
+
+#endif // ANDROID_HWUI_DISTANCE_FIELD_H
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HWUI_FLAT_LRU_CACHE_H
+#define ANDROID_HWUI_FLAT_LRU_CACHE_H
+
+#include <utils/LruCache.h>
+#include <utils/TypeHelpers.h>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace uirenderer {
+
+/**
+ * An LRU cache with the interface of LruCache that keeps its entries, keys
+ * and values included, in one open addressing table instead of allocating a
+ * node for each of them.
+ *
+ * Lookups probe linearly from the key's hash. The hash is stored in the entry,
+ * so probing compares keys only when hashes match and growing the table never
+ * hashes a key again. The recency list is threaded through the table by index.
+ *
+ * Keys must be default constructible, and must provide hash_type() and
+ * operator==, like the keys of LruCache. Removing an entry can move others
+ * within the table, so references returned by get() are only valid until the
+ * cache is changed.
+ */
+template <typename TKey, typename TValue>
+class FlatLruCache {
+public:
+    enum Capacity {
+        kUnlimitedCapacity,
+    };
+
+    explicit FlatLruCache(uint32_t maxCapacity)
+            : mMaxCapacity(maxCapacity) {
+    }
+
+    ~FlatLruCache() {
+        clear();
+    }
+
+    void setOnEntryRemovedListener(OnEntryRemoved<TKey, TValue>* listener) {
+        mListener = listener;
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+    /**
+     * Returns the value of the key, or a default constructed value if the key
+     * isn't in the cache, and makes the entry the most recently used one.
+     */
+    const TValue& get(const TKey& key) {
+        ssize_t index = find(key, hashKey(key));
+        if (index < 0) {
+            return mNullValue;
+        }
+        unlink(index);
+        linkYoungest(index);
+        return mTable[index].value;
+    }
+
+    /**
+     * Adds the entry as the most recently used one. Returns false, leaving
+     * the cache unchanged, if the key is already in the cache.
+     */
+    bool put(const TKey& key, const TValue& value) {
+        const hash_t hash = hashKey(key);
+        if (find(key, hash) >= 0) {
+            return false;
+        }
+
+        if ((mSize + 1) * 4 > mTable.size() * 3) {
+            grow();
+        }
+        insert(TKey(key), TValue(value), hash);
+
+        if (mMaxCapacity != kUnlimitedCapacity && mSize > mMaxCapacity) {
+            removeOldest();
+        }
+        return true;
+    }
+
+    bool remove(const TKey& key) {
+        ssize_t index = find(key, hashKey(key));
+        if (index < 0) {
+            return false;
+        }
+        removeAt(index);
+        return true;
+    }
+
+    bool removeOldest() {
+        if (mOldest < 0) {
+            return false;
+        }
+        removeAt(mOldest);
+        return true;
+    }
+
+    const TValue& peekOldestValue() {
+        return mOldest < 0 ? mNullValue : mTable[mOldest].value;
+    }
+
+    /**
+     * Removes all the entries, notifying the listener from the least recently
+     * used one on, and releases the table.
+     */
+    void clear() {
+        if (mListener) {
+            for (ssize_t index = mOldest; index >= 0; index = mTable[index].newer) {
+                (*mListener)(mTable[index].key, mTable[index].value);
+            }
+        }
+        std::vector<Entry>().swap(mTable);
+        mSize = 0;
+        mOldest = -1;
+        mYoungest = -1;
+    }
+
+    /**
+     * Visits the entries in table order. The cache must not be changed
+     * while iterating.
+     */
+    class Iterator {
+    public:
+        Iterator(const FlatLruCache<TKey, TValue>& cache)
+                : mCache(cache), mIndex(-1) {
+        }
+
+        bool next() {
+            const ssize_t count = mCache.mTable.size();
+            do {
+                mIndex++;
+            } while (mIndex < count && !mCache.mTable[mIndex].used);
+            return mIndex < count;
+        }
+
+        const TKey& key() const { return mCache.mTable[mIndex].key; }
+        const TValue& value() const { return mCache.mTable[mIndex].value; }
+
+    private:
+        const FlatLruCache<TKey, TValue>& mCache;
+        ssize_t mIndex;
+    };
+
+private:
+    struct Entry {
+        TKey key;
+        TValue value;
+        hash_t hash = 0;
+        ssize_t older = -1;
+        ssize_t newer = -1;
+        bool used = false;
+    };
+
+    static hash_t hashKey(const TKey& key) {
+        // Finds both the hash_type() of the key's own namespace and the
+        // overloads of libutils for the basic types.
+        using android::hash_type;
+        return hash_type(key);
+    }
+
+    size_t mask() const {
+        return mTable.size() - 1;
+    }
+
+    ssize_t find(const TKey& key, hash_t hash) const {
+        if (mTable.empty()) {
+            return -1;
+        }
+        // The table is never full, so there's always an empty slot to stop at.
+        for (size_t index = hash & mask(); mTable[index].used; index = (index + 1) & mask()) {
+            const Entry& entry = mTable[index];
+            if (entry.hash == hash && entry.key == key) {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    void insert(TKey&& key, TValue&& value, hash_t hash) {
+        size_t index = hash & mask();
+        while (mTable[index].used) {
+            index = (index + 1) & mask();
+        }
+
+        Entry& entry = mTable[index];
+        entry.key = std::move(key);
+        entry.value = std::move(value);
+        entry.hash = hash;
+        entry.used = true;
+        linkYoungest(index);
+        mSize++;
+    }
+
+    // Doubles the table, keeping the order of the recency list.
+    void grow() {
+        std::vector<Entry> oldTable(mTable.empty() ? 16 : mTable.size() * 2);
+        oldTable.swap(mTable);
+
+        ssize_t index = mOldest;
+        mSize = 0;
+        mOldest = -1;
+        mYoungest = -1;
+        while (index >= 0) {
+            Entry& entry = oldTable[index];
+            insert(std::move(entry.key), std::move(entry.value), entry.hash);
+            index = entry.newer;
+        }
+    }
+
+    void linkYoungest(ssize_t index) {
+        Entry& entry = mTable[index];
+        entry.older = mYoungest;
+        entry.newer = -1;
+        if (mYoungest >= 0) {
+            mTable[mYoungest].newer = index;
+        } else {
+            mOldest = index;
+        }
+        mYoungest = index;
+    }
+
+    void unlink(ssize_t index) {
+        Entry& entry = mTable[index];
+        if (entry.older >= 0) {
+            mTable[entry.older].newer = entry.newer;
+        } else {
+            mOldest = entry.newer;
+        }
+        if (entry.newer >= 0) {
+            mTable[entry.newer].older = entry.older;
+        } else {
+            mYoungest = entry.older;
+        }
+    }
+
+    void release(Entry& entry) {
+        entry.key = TKey();
+        entry.value = TValue();
+        entry.used = false;
+    }
+
+    void removeAt(ssize_t index) {
+        if (mListener) {
+            (*mListener)(mTable[index].key, mTable[index].value);
+        }
+        unlink(index);
+        release(mTable[index]);
+        mSize--;
+
+        // Shift the following entries of the probe sequence back into the
+        // hole, unless that would move them before their home slot, so
+        // lookups never need tombstones.
+        size_t hole = index;
+        for (size_t next = (hole + 1) & mask(); mTable[next].used; next = (next + 1) & mask()) {
+            const size_t home = mTable[next].hash & mask();
+            const bool reachable = hole <= next
+                    ? (home <= hole || home > next)
+                    : (home <= hole && home > next);
+            if (reachable) {
+                move(next, hole);
+                hole = next;
+            }
+        }
+    }
+
+    void move(size_t from, size_t to) {
+        Entry& src = mTable[from];
+        Entry& dst = mTable[to];
+        dst.key = std::move(src.key);
+        dst.value = std::move(src.value);
+        dst.hash = src.hash;
+        dst.older = src.older;
+        dst.newer = src.newer;
+        dst.used = true;
+
+        if (dst.older >= 0) {
+            mTable[dst.older].newer = to;
+        } else {
+            mOldest = to;
+        }
+        if (dst.newer >= 0) {
+            mTable[dst.newer].older = to;
+        } else {
+            mYoungest = to;
+        }
+        release(src);
+    }
+
+    std::vector<Entry> mTable;
+    size_t mSize = 0;
+    ssize_t mOldest = -1;
+    ssize_t mYoungest = -1;
+    uint32_t mMaxCapacity;
+    OnEntryRemoved<TKey, TValue>* mListener = nullptr;
+    TValue mNullValue = TValue();
+};
+
+}; // namespace uirenderer
+}; // namespace android
+
+#endif // ANDROID_HWUI_FLAT_LRU_CACHE_H
@@ -0,0 +1,235 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FLOAT4_H
+#define FLOAT4_H
+
+#include <math.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FLOAT4_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FLOAT4_USE_SSE2 1
+#endif
+
+#if defined(FLOAT4_USE_NEON) || defined(FLOAT4_USE_SSE2)
+// Defined when Float4 is available, code using it must keep a scalar path
+#define HAS_FLOAT4 1
+
+namespace android {
+namespace uirenderer {
+
+/**
+ * Four floats processed in parallel, with just the operations needed by the
+ * tessellators.
+ *
+ * Divisions and square roots are exact, except on ARMv7 where NEON only has
+ * reciprocal estimates: these are refined with two Newton-Raphson steps,
+ * which is within a couple of ulps of the scalar result.
+ */
+class Float4 {
+public:
+#if defined(FLOAT4_USE_NEON)
+    typedef float32x4_t NativeType;
+#else
+    typedef __m128 NativeType;
+#endif
+
+    Float4() {}
+    explicit Float4(NativeType value) : mValue(value) {}
+
+    static Float4 splat(float value) {
+#if defined(FLOAT4_USE_NEON)
+        return Float4(vdupq_n_f32(value));
+#else
+        return Float4(_mm_set1_ps(value));
+#endif
+    }
+
+    /**
+     * Loads 4 consecutive (x, y) pairs, as laid out in arrays of Vertex or Vector2
+     */
+    static void loadXY(const float* xy, Float4& x, Float4& y) {
+#if defined(FLOAT4_USE_NEON)
+        float32x4x2_t values = vld2q_f32(xy);
+        x.mValue = values.val[0];
+        y.mValue = values.val[1];
+#else
+        __m128 low = _mm_loadu_ps(xy);
+        __m128 high = _mm_loadu_ps(xy + 4);
+        x.mValue = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+        y.mValue = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+#endif
+    }
+
+    static void storeXY(float* xy, const Float4& x, const Float4& y) {
+#if defined(FLOAT4_USE_NEON)
+        float32x4x2_t values = {{ x.mValue, y.mValue }};
+        vst2q_f32(xy, values);
+#else
+        _mm_storeu_ps(xy, _mm_unpacklo_ps(x.mValue, y.mValue));
+        _mm_storeu_ps(xy + 4, _mm_unpackhi_ps(x.mValue, y.mValue));
+#endif
+    }
+
+    /**
+     * Loads 4 consecutive (x, y, z) triplets, as laid out in arrays of Vector3
+     */
+    static void loadXYZ(const float* xyz, Float4& x, Float4& y, Float4& z) {
+#if defined(FLOAT4_USE_NEON)
+        float32x4x3_t values = vld3q_f32(xyz);
+        x.mValue = values.val[0];
+        y.mValue = values.val[1];
+        z.mValue = values.val[2];
+#else
+        x.mValue = _mm_setr_ps(xyz[0], xyz[3], xyz[6], xyz[9]);
+        y.mValue = _mm_setr_ps(xyz[1], xyz[4], xyz[7], xyz[10]);
+        z.mValue = _mm_setr_ps(xyz[2], xyz[5], xyz[8], xyz[11]);
+#endif
+    }
+
+    void store(float* values) const {
+#if defined(FLOAT4_USE_NEON)
+        vst1q_f32(values, mValue);
+#else
+        _mm_storeu_ps(values, mValue);
+#endif
+    }
+
+    Float4 operator+(const Float4& other) const {
+#if defined(FLOAT4_USE_NEON)
+        return Float4(vaddq_f32(mValue, other.mValue));
+#else
+        return Float4(_mm_add_ps(mValue, other.mValue));
+#endif
+    }
+
+    Float4 operator-(const Float4& other) const {
+#if defined(FLOAT4_USE_NEON)
+        return Float4(vsubq_f32(mValue, other.mValue));
+#else
+        return Float4(_mm_sub_ps(mValue, other.mValue));
+#endif
+    }
+
+    Float4 operator*(const Float4& other) const {
+#if defined(FLOAT4_USE_NEON)
+        return Float4(vmulq_f32(mValue, other.mValue));
+#else
+        return Float4(_mm_mul_ps(mValue, other.mValue));
+#endif
+    }
+
+    Float4 operator/(const Float4& other) const {
+#if defined(FLOAT4_USE_NEON) && defined(__aarch64__)
+        return Float4(vdivq_f32(mValue, other.mValue));
+#elif defined(FLOAT4_USE_NEON)
+        float32x4_t reciprocal = vrecpeq_f32(other.mValue);
+        reciprocal = vmulq_f32(vrecpsq_f32(other.mValue, reciprocal), reciprocal);
+        reciprocal = vmulq_f32(vrecpsq_f32(other.mValue, reciprocal), reciprocal);
+        return Float4(vmulq_f32(mValue, reciprocal));
+#else
+        return Float4(_mm_div_ps(mValue, other.mValue));
+#endif
+    }
+
+    static Float4 abs(const Float4& value) {
+#if defined(FLOAT4_USE_NEON)
+        return Float4(vabsq_f32(value.mValue));
+#else
+        return Float4(_mm_andnot_ps(_mm_set1_ps(-0.0f), value.mValue));
+#endif
+    }
+
+    static Float4 min(const Float4& a, const Float4& b) {
+#if defined(FLOAT4_USE_NEON)
+        return Float4(vminq_f32(a.mValue, b.mValue));
+#else
+        return Float4(_mm_min_ps(a.mValue, b.mValue));
+#endif
+    }
+
+    static Float4 max(const Float4& a, const Float4& b) {
+#if defined(FLOAT4_USE_NEON)
+        return Float4(vmaxq_f32(a.mValue, b.mValue));
+#else
+        return Float4(_mm_max_ps(a.mValue, b.mValue));
+#endif
+    }
+
+    /**
+     * Returns ifZero in the lanes where test is 0, and value in the others
+     */
+    static Float4 selectIfZero(const Float4& test, const Float4& ifZero, const Float4& value) {
+#if defined(FLOAT4_USE_NEON)
+        uint32x4_t isZero = vceqq_f32(test.mValue, vdupq_n_f32(0.0f));
+        return Float4(vbslq_f32(isZero, ifZero.mValue, value.mValue));
+#else
+        __m128 isZero = _mm_cmpeq_ps(test.mValue, _mm_setzero_ps());
+        return Float4(_mm_or_ps(_mm_and_ps(isZero, ifZero.mValue),
+                _mm_andnot_ps(isZero, value.mValue)));
+#endif
+    }
+
+    /**
+     * Returns 1 / sqrt(value), infinite for 0
+     */
+    static Float4 inverseSqrt(const Float4& value) {
+#if defined(FLOAT4_USE_NEON) && defined(__aarch64__)
+        return Float4(vdivq_f32(vdupq_n_f32(1.0f), vsqrtq_f32(value.mValue)));
+#elif defined(FLOAT4_USE_NEON)
+        float32x4_t estimate = vrsqrteq_f32(value.mValue);
+        estimate = vmulq_f32(vrsqrtsq_f32(vmulq_f32(value.mValue, estimate), estimate), estimate);
+        estimate = vmulq_f32(vrsqrtsq_f32(vmulq_f32(value.mValue, estimate), estimate), estimate);
+        // The refinement steps turn the infinite estimate for 0 into NaN
+        uint32x4_t isZero = vceqq_f32(value.mValue, vdupq_n_f32(0.0f));
+        return Float4(vbslq_f32(isZero, vdupq_n_f32(INFINITY), estimate));
+#else
+        return Float4(_mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(value.mValue)));
+#endif
+    }
+
+    /**
+     * Normalizes 4 vectors. Zero length vectors are left as is, like
+     * ShadowTessellator::calculateNormal() does, instead of becoming NaN.
+     */
+    static void normalize(Float4& x, Float4& y) {
+        Float4 lengthSquared = x * x + y * y;
+        Float4 scale = inverseSqrt(lengthSquared);
+#if defined(FLOAT4_USE_NEON)
+        uint32x4_t nonZero = vcgtq_f32(lengthSquared.mValue, vdupq_n_f32(0.0f));
+        x.mValue = vbslq_f32(nonZero, vmulq_f32(x.mValue, scale.mValue), x.mValue);
+        y.mValue = vbslq_f32(nonZero, vmulq_f32(y.mValue, scale.mValue), y.mValue);
+#else
+        __m128 nonZero = _mm_cmpgt_ps(lengthSquared.mValue, _mm_setzero_ps());
+        x.mValue = _mm_or_ps(_mm_and_ps(nonZero, _mm_mul_ps(x.mValue, scale.mValue)),
+                _mm_andnot_ps(nonZero, x.mValue));
+        y.mValue = _mm_or_ps(_mm_and_ps(nonZero, _mm_mul_ps(y.mValue, scale.mValue)),
+                _mm_andnot_ps(nonZero, y.mValue));
+#endif
+    }
+
+private:
+    NativeType mValue;
+};
+
+} /* namespace uirenderer */
+} /* namespace android */
+
+#endif // FLOAT4_USE_NEON || FLOAT4_USE_SSE2
+
+#endif // FLOAT4_H
@@ -29,6 +29,7 @@
 
 #include <stdlib.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
 
 
 // The ideal size of a page allocation (these need to be multiples of 8)
@@ -42,6 +43,10 @@
 // Must be smaller than INITIAL_PAGE_SIZE
 #define MAX_WASTE_SIZE ((size_t)1024)
 
+// The maximum amount of free pages kept by the pool, about the display lists
+// re-recorded for a busy frame
+#define MAX_POOLED_SIZE ((size_t)1048576) // 1MB
+
 #if ALIGN_DOUBLE
 #define ALIGN_SZ (sizeof(double))
 #else
@@ -88,6 +93,92 @@ void* operator new(std::size_t size, android::uirenderer::LinearAllocator& la) {
 namespace android {
 namespace uirenderer {
 
+// Standard pages double from INITIAL_PAGE_SIZE up to MAX_PAGE_SIZE
+static const int kPageSizeCount = 6;
+
+static int pageSizeIndex(size_t pageSize) {
+    int index = 0;
+    while (index < kPageSizeCount - 1 && (INITIAL_PAGE_SIZE << index) < pageSize) {
+        index++;
+    }
+    return index;
+}
+
+/**
+ * Free standard pages of the destroyed allocators. Display lists are recorded
+ * on the UI thread and destroyed on the RenderThread, so the pool is shared by
+ * all the threads instead of being thread local.
+ */
+class PagePool {
+public:
+    // Returns nullptr if there is no free page of that size
+    void* obtain(size_t pageSize) {
+        AutoMutex _l(mLock);
+        int index = pageSizeIndex(pageSize);
+        FreePage* page = mFreePages[index];
+        if (page) {
+            mFreePages[index] = page->next;
+            mPooledSize -= pageSize;
+            mReusedPages++;
+        } else {
+            mAllocatedPages++;
+        }
+        return page;
+    }
+
+    // Returns false if the pool is full, the page must then be freed
+    bool recycle(void* buffer, size_t pageSize) {
+        AutoMutex _l(mLock);
+        if (mPooledSize + pageSize > MAX_POOLED_SIZE) return false;
+
+        int index = pageSizeIndex(pageSize);
+        FreePage* page = reinterpret_cast<FreePage*>(buffer);
+        page->next = mFreePages[index];
+        mFreePages[index] = page;
+        mPooledSize += pageSize;
+        return true;
+    }
+
+    void trim() {
+        AutoMutex _l(mLock);
+        for (int i = 0; i < kPageSizeCount; i++) {
+            while (mFreePages[i]) {
+                FreePage* page = mFreePages[i];
+                mFreePages[i] = page->next;
+                free(page);
+            }
+        }
+        mPooledSize = 0;
+    }
+
+    LinearAllocator::PagePoolStats stats() {
+        AutoMutex _l(mLock);
+        LinearAllocator::PagePoolStats stats;
+        stats.pooledSize = mPooledSize;
+        stats.maxPooledSize = MAX_POOLED_SIZE;
+        stats.reusedPages = mReusedPages;
+        stats.allocatedPages = mAllocatedPages;
+        return stats;
+    }
+
+private:
+    struct FreePage {
+        FreePage* next;
+    };
+
+    Mutex mLock;
+    FreePage* mFreePages[kPageSizeCount] = {};
+    size_t mPooledSize = 0;
+    size_t mReusedPages = 0;
+    size_t mAllocatedPages = 0;
+};
+
+static PagePool& pagePool() {
+    // Never destroyed, allocators may outlive the static destructors
+    static PagePool* sPool = new PagePool();
+    return *sPool;
+}
+
 class LinearAllocator::Page {
 public:
     Page* next() { return mNextPage; }
@@ -118,10 +209,12 @@ LinearAllocator::LinearAllocator()
     , mNext(0)
     , mCurrentPage(0)
     , mPages(0)
+    , mDedicatedPages(0)
     , mTotalAllocated(0)
     , mWastedSpace(0)
     , mPageCount(0)
-    , mDedicatedPageCount(0) {}
+    , mDedicatedPageCount(0)
+    , mReusedPageCount(0) {}
 
 LinearAllocator::~LinearAllocator(void) {
     while (mDtorList) {
@@ -129,18 +222,29 @@ LinearAllocator::~LinearAllocator(void) {
         mDtorList = node->next;
         node->dtor(node->addr);
     }
+    size_t pageSize = INITIAL_PAGE_SIZE;
     Page* p = mPages;
+    while (p) {
+        Page* next = p->next();
+        p->~Page();
+        if (!pagePool().recycle(p, pageSize)) {
+            free(p);
+            RM_ALLOCATION(pageSize);
+        }
+        pageSize = min(MAX_PAGE_SIZE, pageSize * 2);
+        p = next;
+    }
+    p = mDedicatedPages;
     while (p) {
         Page* next = p->next();
         p->~Page();
         free(p);
-        RM_ALLOCATION(mPageSize);
         p = next;
     }
 }
 
 void* LinearAllocator::start(Page* p) {
-    return ALIGN_PTR(((size_t*)p) + sizeof(Page));
+    return ALIGN_PTR(((size_t)p) + sizeof(Page));
 }
 
 void* LinearAllocator::end(Page* p) {
@@ -159,7 +263,7 @@ void LinearAllocator::ensureNext(size_t size) {
         mPageSize = ALIGN(mPageSize);
     }
     mWastedSpace += mPageSize;
-    Page* p = newPage(mPageSize);
+    Page* p = newStandardPage();
     if (mCurrentPage) {
         mCurrentPage->setNext(p);
     }
@@ -177,10 +281,8 @@ void* LinearAllocator::alloc(size_t size) {
         // Allocation is too large, create a dedicated page for the allocation
         Page* page = newPage(size);
         mDedicatedPageCount++;
-        page->setNext(mPages);
-        mPages = page;
-        if (!mCurrentPage)
-            mCurrentPage = mPages;
+        page->setNext(mDedicatedPages);
+        mDedicatedPages = page;
         return start(page);
     }
     ensureNext(size);
@@ -228,7 +330,7 @@ void LinearAllocator::rewindIfLastAlloc(void* ptr, size_t allocSize) {
     runDestructorFor(ptr);
     // Don't bother rewinding across pages
     allocSize = ALIGN(allocSize);
-    if (ptr >= start(mCurrentPage) && ptr < end(mCurrentPage)
+    if (mCurrentPage && ptr >= start(mCurrentPage) && ptr < end(mCurrentPage)
             && ptr == ((char*)mNext - allocSize)) {
         mWastedSpace += allocSize;
         mNext = ptr;
@@ -244,6 +346,24 @@ LinearAllocator::Page* LinearAllocator::newPage(size_t pageSize) {
     return new (buf) Page();
 }
 
+LinearAllocator::Page* LinearAllocator::newStandardPage() {
+    void* buf = pagePool().obtain(mPageSize);
+    if (!buf) return newPage(mPageSize);
+
+    mTotalAllocated += ALIGN(mPageSize + sizeof(LinearAllocator::Page));
+    mPageCount++;
+    mReusedPageCount++;
+    return new (buf) Page();
+}
+
+LinearAllocator::PagePoolStats LinearAllocator::getPagePoolStats() {
+    return pagePool().stats();
+}
+
+void LinearAllocator::trimPagePool() {
+    pagePool().trim();
+}
+
 static const char* toSize(size_t value, float& result) {
     if (value < 2000) {
         result = value;
@@ -265,7 +385,8 @@ void LinearAllocator::dumpMemoryStats(const char* prefix) {
     prettySuffix = toSize(mWastedSpace, prettySize);
     ALOGD("%sWasted space: %.2f%s (%.1f%%)", prefix, prettySize, prettySuffix,
           (float) mWastedSpace / (float) mTotalAllocated * 100.0f);
-    ALOGD("%sPages %zu (dedicated %zu)", prefix, mPageCount, mDedicatedPageCount);
+    ALOGD("%sPages %zu (dedicated %zu, reused %zu)", prefix, mPageCount, mDedicatedPageCount,
+            mReusedPageCount);
 }
 
 }; // namespace uirenderer
@@ -37,6 +37,10 @@ namespace uirenderer {
  * the overhead of malloc when many objects are allocated. It is most useful when creating many
  * small objects with a similar lifetime, and doesn't add significant overhead for large
  * allocations.
+ *
+ * The pages of the standard sizes are returned to a process wide pool when the allocator is
+ * destroyed, and reused by the next allocators, so that display lists re-recorded every frame
+ * don't go through malloc once the pool is warm. Dedicated pages of large allocations are freed.
  */
 class LinearAllocator {
 public:
@@ -101,6 +105,22 @@ public:
      */
     size_t usedSize() const { return mTotalAllocated - mWastedSpace; }
 
+    struct PagePoolStats {
+        // Bytes of free pages held by the pool, and its limit
+        size_t pooledSize;
+        size_t maxPooledSize;
+        // Standard pages taken from the pool and malloc'd since the process started
+        size_t reusedPages;
+        size_t allocatedPages;
+    };
+
+    static PagePoolStats getPagePoolStats();
+
+    /**
+     * Frees the pages held by the pool
+     */
+    static void trimPagePool();
+
 private:
     LinearAllocator(const LinearAllocator& other);
 
@@ -115,6 +135,7 @@ private:
     void addToDestructionList(Destructor, void* addr);
     void runDestructorFor(void* addr);
     Page* newPage(size_t pageSize);
+    Page* newStandardPage();
     bool fitsInCurrentPage(size_t size);
     void ensureNext(size_t size);
     void* start(Page *p);
@@ -124,7 +145,9 @@ private:
     size_t mMaxAllocSize;
     void* mNext;
     Page* mCurrentPage;
+    // Standard pages, in allocation order, so the size of each can be recomputed
     Page* mPages;
+    Page* mDedicatedPages;
     DestructorNode* mDtorList = nullptr;
 
     // Memory usage tracking
@@ -132,6 +155,7 @@ private:
     size_t mWastedSpace;
     size_t mPageCount;
     size_t mDedicatedPageCount;
+    size_t mReusedPageCount;
 };
 
 }; // namespace uirenderer
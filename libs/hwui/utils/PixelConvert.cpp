@@ -0,0 +1,328 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <SkColorPriv.h>
+#include <SkUnPreMultiply.h>
+
+// The vector paths assume alpha is the top byte of both SkColor and SkPMColor,
+// so the two only ever differ by the position of red and blue.
+#if SK_A32_SHIFT == 24 && SK_G32_SHIFT == 8 && \
+        ((SK_R32_SHIFT == 16 && SK_B32_SHIFT == 0) || (SK_R32_SHIFT == 0 && SK_B32_SHIFT == 16))
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PIXEL_CONVERT_USE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_CONVERT_USE_SSE2 1
+#endif
+#endif
+
+#include "PixelConvert.h"
+
+namespace android {
+namespace uirenderer {
+
+static inline SkPMColor packColor(SkColor c) {
+    return SkPackARGB32NoCheck(SkColorGetA(c), SkColorGetR(c), SkColorGetG(c), SkColorGetB(c));
+}
+
+static inline SkColor unpackColor(SkPMColor c) {
+    return SkColorSetARGB(SkGetPackedA32(c), SkGetPackedR32(c), SkGetPackedG32(c),
+            SkGetPackedB32(c));
+}
+
+static inline SkColor expand565(uint16_t c) {
+    return SkColorSetRGB(SkPacked16ToR32(c), SkPacked16ToG32(c), SkPacked16ToB32(c));
+}
+
+#if PIXEL_CONVERT_USE_NEON
+
+// Swaps between the SkColor and SkPMColor byte orders, 4 pixels at a time
+static inline uint32x4_t swizzle(uint32x4_t c) {
+#if SK_R32_SHIFT == 16
+    return c;
+#else
+    uint32x4_t ag = vandq_u32(c, vdupq_n_u32(0xFF00FF00));
+    uint32x4_t r = vandq_u32(vshrq_n_u32(c, 16), vdupq_n_u32(0xFF));
+    uint32x4_t b = vshlq_n_u32(vandq_u32(c, vdupq_n_u32(0xFF)), 16);
+    return vorrq_u32(ag, vorrq_u32(r, b));
+#endif
+}
+
+// SkMulDiv255Round() on 16 channels
+static inline uint8x16_t mulDiv255Round(uint8x16_t x, uint8x16_t a) {
+    uint16x8_t lo = vmull_u8(vget_low_u8(x), vget_low_u8(a));
+    uint16x8_t hi = vmull_u8(vget_high_u8(x), vget_high_u8(a));
+    lo = vrsraq_n_u16(lo, lo, 8);
+    hi = vrsraq_n_u16(hi, hi, 8);
+    return vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8));
+}
+
+static inline uint32_t andLanes(uint32x4_t v) {
+    uint32x2_t m = vand_u32(vget_low_u32(v), vget_high_u32(v));
+    return vget_lane_u32(m, 0) & vget_lane_u32(m, 1);
+}
+
+static inline uint32_t orLanes(uint32x4_t v) {
+    uint32x2_t m = vorr_u32(vget_low_u32(v), vget_high_u32(v));
+    return vget_lane_u32(m, 0) | vget_lane_u32(m, 1);
+}
+
+#elif PIXEL_CONVERT_USE_SSE2
+
+static inline __m128i swizzle(__m128i c) {
+#if SK_R32_SHIFT == 16
+    return c;
+#else
+    const __m128i low = _mm_set1_epi32(0xFF);
+    __m128i ag = _mm_and_si128(c, _mm_set1_epi32(0xFF00FF00));
+    __m128i r = _mm_and_si128(_mm_srli_epi32(c, 16), low);
+    __m128i b = _mm_slli_epi32(_mm_and_si128(c, low), 16);
+    return _mm_or_si128(ag, _mm_or_si128(r, b));
+#endif
+}
+
+// SkMulDiv255Round() of 2 pixels unpacked to 16 bit channels, by their alpha
+static inline __m128i premultiplyUnpacked(__m128i c) {
+    // Alpha is multiplied by 255, which leaves it unchanged
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3)),
+            _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_or_si128(a, _mm_set_epi16(0xFF, 0, 0, 0, 0xFF, 0, 0, 0));
+    __m128i prod = _mm_add_epi16(_mm_mullo_epi16(c, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(prod, _mm_srli_epi16(prod, 8)), 8);
+}
+
+#endif
+
+void PixelConvert::premultiply(SkPMColor* dst, const SkColor* src, int count) {
+    int i = 0;
+#if PIXEL_CONVERT_USE_NEON
+    for (; i + 16 <= count; i += 16) {
+        // In memory, an SkColor is B, G, R, A
+        uint8x16x4_t c = vld4q_u8((const uint8_t*) (src + i));
+        uint8x16x4_t p;
+        p.val[SK_A32_SHIFT / 8] = c.val[3];
+        p.val[SK_R32_SHIFT / 8] = mulDiv255Round(c.val[2], c.val[3]);
+        p.val[SK_G32_SHIFT / 8] = mulDiv255Round(c.val[1], c.val[3]);
+        p.val[SK_B32_SHIFT / 8] = mulDiv255Round(c.val[0], c.val[3]);
+        vst4q_u8((uint8_t*) (dst + i), p);
+    }
+#elif PIXEL_CONVERT_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i lo = premultiplyUnpacked(_mm_unpacklo_epi8(c, zero));
+        __m128i hi = premultiplyUnpacked(_mm_unpackhi_epi8(c, zero));
+        _mm_storeu_si128((__m128i*) (dst + i), swizzle(_mm_packus_epi16(lo, hi)));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = SkPreMultiplyColor(src[i]);
+    }
+}
+
+void PixelConvert::colorToPMColor(SkPMColor* dst, const SkColor* src, int count) {
+    // Needed to thwart the unreachable code detection from clang.
+    static const bool sk_color_ne_zero = SK_COLOR_MATCHES_PMCOLOR_BYTE_ORDER;
+    if (sk_color_ne_zero) {
+        memcpy(dst, src, count * sizeof(SkColor));
+        return;
+    }
+
+    int i = 0;
+#if PIXEL_CONVERT_USE_NEON
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(dst + i, swizzle(vld1q_u32(src + i)));
+    }
+#elif PIXEL_CONVERT_USE_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*) (src + i));
+        _mm_storeu_si128((__m128i*) (dst + i), swizzle(c));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = packColor(src[i]);
+    }
+}
+
+void PixelConvert::colorToAlpha8(uint8_t* dst, const SkColor* src, int count) {
+    int i = 0;
+#if PIXEL_CONVERT_USE_NEON
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t c = vld4q_u8((const uint8_t*) (src + i));
+        vst1q_u8(dst + i, c.val[3]);
+    }
+#elif PIXEL_CONVERT_USE_SSE2
+    for (; i + 16 <= count; i += 16) {
+        const __m128i* s = (const __m128i*) (src + i);
+        __m128i a0 = _mm_srli_epi32(_mm_loadu_si128(s), 24);
+        __m128i a1 = _mm_srli_epi32(_mm_loadu_si128(s + 1), 24);
+        __m128i a2 = _mm_srli_epi32(_mm_loadu_si128(s + 2), 24);
+        __m128i a3 = _mm_srli_epi32(_mm_loadu_si128(s + 3), 24);
+        __m128i a = _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3));
+        _mm_storeu_si128((__m128i*) (dst + i), a);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = SkColorGetA(src[i]);
+    }
+}
+
+void PixelConvert::unpremultiply(SkColor* dst, const SkPMColor* src, int count) {
+    int i = 0;
+    // Only opaque and fully transparent pixels can skip the divide, which is
+    // most of most bitmaps. Anything else goes through Skia's reciprocal table.
+#if PIXEL_CONVERT_USE_NEON
+    const uint32x4_t rgb = vdupq_n_u32(0x00FFFFFF);
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t c = vld1q_u32(src + i);
+        if (andLanes(vorrq_u32(c, rgb)) == 0xFFFFFFFF) {
+            vst1q_u32(dst + i, swizzle(c));
+        } else if (orLanes(vbicq_u32(c, rgb)) == 0) {
+            vst1q_u32(dst + i, vdupq_n_u32(0));
+        } else {
+            for (int j = i; j < i + 4; j++) {
+                dst[j] = SkUnPreMultiply::PMColorToColor(src[j]);
+            }
+        }
+    }
+#elif PIXEL_CONVERT_USE_SSE2
+    const __m128i rgb = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i ones = _mm_set1_epi32(0xFFFFFFFF);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 4 <= count; i += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*) (src + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_or_si128(c, rgb), ones)) == 0xFFFF) {
+            _mm_storeu_si128((__m128i*) (dst + i), swizzle(c));
+        } else if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_andnot_si128(rgb, c), zero)) == 0xFFFF) {
+            _mm_storeu_si128((__m128i*) (dst + i), zero);
+        } else {
+            for (int j = i; j < i + 4; j++) {
+                dst[j] = SkUnPreMultiply::PMColorToColor(src[j]);
+            }
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = SkUnPreMultiply::PMColorToColor(src[i]);
+    }
+}
+
+void PixelConvert::pmColorToColor(SkColor* dst, const SkPMColor* src, int count) {
+    int i = 0;
+#if PIXEL_CONVERT_USE_NEON
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(dst + i, swizzle(vld1q_u32(src + i)));
+    }
+#elif PIXEL_CONVERT_USE_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*) (src + i));
+        _mm_storeu_si128((__m128i*) (dst + i), swizzle(c));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = unpackColor(src[i]);
+    }
+}
+
+void PixelConvert::pmColorToOpaqueColor(SkColor* dst, const SkPMColor* src, int count) {
+    int i = 0;
+#if PIXEL_CONVERT_USE_NEON
+    const uint32x4_t alpha = vdupq_n_u32(0xFF000000);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u32(dst + i, vorrq_u32(swizzle(vld1q_u32(src + i)), alpha));
+    }
+#elif PIXEL_CONVERT_USE_SSE2
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+    for (; i + 4 <= count; i += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*) (src + i));
+        _mm_storeu_si128((__m128i*) (dst + i), _mm_or_si128(swizzle(c), alpha));
+    }
+#endif
+    for (; i < count; i++) {
+        SkPMColor c = src[i];
+        dst[i] = SkColorSetRGB(SkGetPackedR32(c), SkGetPackedG32(c), SkGetPackedB32(c));
+    }
+}
+
+void PixelConvert::rgb565ToColor(SkColor* dst, const uint16_t* src, int count) {
+    int i = 0;
+#if SK_R16_SHIFT == 11 && SK_G16_SHIFT == 5 && SK_B16_SHIFT == 0
+#if PIXEL_CONVERT_USE_NEON
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t c = vld1q_u16(src + i);
+        uint16x8_t r = vshrq_n_u16(c, 11);
+        uint16x8_t g = vandq_u16(vshrq_n_u16(c, 5), vdupq_n_u16(0x3F));
+        uint16x8_t b = vandq_u16(c, vdupq_n_u16(0x1F));
+        uint8x8x4_t p;
+        p.val[0] = vmovn_u16(vorrq_u16(vshlq_n_u16(b, 3), vshrq_n_u16(b, 2)));
+        p.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(g, 2), vshrq_n_u16(g, 4)));
+        p.val[2] = vmovn_u16(vorrq_u16(vshlq_n_u16(r, 3), vshrq_n_u16(r, 2)));
+        p.val[3] = vdup_n_u8(0xFF);
+        vst4_u8((uint8_t*) (dst + i), p);
+    }
+#elif PIXEL_CONVERT_USE_SSE2
+    for (; i + 8 <= count; i += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i r = _mm_srli_epi16(c, 11);
+        __m128i g = _mm_and_si128(_mm_srli_epi16(c, 5), _mm_set1_epi16(0x3F));
+        __m128i b = _mm_and_si128(c, _mm_set1_epi16(0x1F));
+        r = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+        g = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+        b = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+        __m128i bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+        __m128i ra = _mm_or_si128(r, _mm_set1_epi16(0xFF00));
+        __m128i* d = (__m128i*) (dst + i);
+        _mm_storeu_si128(d, _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128(d + 1, _mm_unpackhi_epi16(bg, ra));
+    }
+#endif
+#endif
+    for (; i < count; i++) {
+        dst[i] = expand565(src[i]);
+    }
+}
+
+void PixelConvert::alpha8ToColor(SkColor* dst, const uint8_t* src, int count) {
+    int i = 0;
+#if PIXEL_CONVERT_USE_NEON
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t a = vld1q_u8(src + i);
+        uint8x16x4_t p = {{ a, a, a, a }};
+        vst4q_u8((uint8_t*) (dst + i), p);
+    }
+#elif PIXEL_CONVERT_USE_SSE2
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+        __m128i lo = _mm_unpacklo_epi8(a, a);
+        __m128i hi = _mm_unpackhi_epi8(a, a);
+        __m128i* d = (__m128i*) (dst + i);
+        _mm_storeu_si128(d, _mm_unpacklo_epi16(lo, lo));
+        _mm_storeu_si128(d + 1, _mm_unpackhi_epi16(lo, lo));
+        _mm_storeu_si128(d + 2, _mm_unpacklo_epi16(hi, hi));
+        _mm_storeu_si128(d + 3, _mm_unpackhi_epi16(hi, hi));
+    }
+#endif
+    for (; i < count; i++) {
+        uint8_t a = src[i];
+        dst[i] = SkColorSetARGB(a, a, a, a);
+    }
+}
+
+}; // namespace uirenderer
+}; // namespace android
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HWUI_PIXEL_CONVERT_H
+#define ANDROID_HWUI_PIXEL_CONVERT_H
+
+#include <stdint.h>
+#include <cutils/compiler.h>
+#include <SkColor.h>
+
+namespace android {
+namespace uirenderer {
+
+/**
+ * Row converters between SkColor and the pixel formats of SkBitmap, used by
+ * Bitmap.getPixels() and Bitmap.setPixels(). Each one produces exactly the
+ * same values as the equivalent per pixel Skia helper, noted below, but works
+ * on several pixels at once with NEON or SSE2 when available.
+ */
+class PixelConvert {
+public:
+    // SkPreMultiplyColor()
+    ANDROID_API static void premultiply(SkPMColor* dst, const SkColor* src, int count);
+    // SkPackARGB32NoCheck(), without premultiplying
+    ANDROID_API static void colorToPMColor(SkPMColor* dst, const SkColor* src, int count);
+    // SkColorGetA()
+    ANDROID_API static void colorToAlpha8(uint8_t* dst, const SkColor* src, int count);
+
+    // SkUnPreMultiply::PMColorToColor()
+    ANDROID_API static void unpremultiply(SkColor* dst, const SkPMColor* src, int count);
+    // SkColorSetARGB(), for pixels that aren't premultiplied
+    ANDROID_API static void pmColorToColor(SkColor* dst, const SkPMColor* src, int count);
+    // SkColorSetRGB(), ignoring the alpha of the pixels
+    ANDROID_API static void pmColorToOpaqueColor(SkColor* dst, const SkPMColor* src, int count);
+    // SkColorSetRGB(SkPacked16ToR32(), SkPacked16ToG32(), SkPacked16ToB32())
+    ANDROID_API static void rgb565ToColor(SkColor* dst, const uint16_t* src, int count);
+    // SkColorSetARGB(a, a, a, a)
+    ANDROID_API static void alpha8ToColor(SkColor* dst, const uint8_t* src, int count);
+};
+
+}; // namespace uirenderer
+}; // namespace android
+
+#endif // ANDROID_HWUI_PIXEL_CONVERT_H
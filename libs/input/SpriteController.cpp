@@ -391,6 +391,7 @@ sp<SurfaceControl> SpriteController::obtainSurface(int32_t width, int32_t height
 
 SpriteController::SpriteImpl::SpriteImpl(const sp<SpriteController> controller) :
         mController(controller) {
+    mLocked.iconGenerationId = 0;
 }
 
 SpriteController::SpriteImpl::~SpriteImpl() {
@@ -408,8 +409,21 @@ void SpriteController::SpriteImpl::setIcon(const SpriteIcon& icon) {
     AutoMutex _l(mController->mLock);
 
     uint32_t dirty;
-    if (icon.isValid()) {
+    if (icon.isValid() && icon.bitmap.getGenerationID() == mLocked.iconGenerationId
+            && icon.hotSpotX == mLocked.state.icon.hotSpotX
+            && icon.hotSpotY == mLocked.state.icon.hotSpotY) {
+        if (mLocked.state.icon.isValid()) {
+            return; // same icon and already set so nothing to do
+        }
+        // The surface still holds this icon from before it was cleared, as is
+        // common for recycled spot sprites, so it can be shown without a redraw.
+        mLocked.state.icon.bitmap = mLocked.clearedIconBitmap;
+        mLocked.clearedIconBitmap.reset();
+        dirty = DIRTY_VISIBILITY;
+    } else if (icon.isValid()) {
         icon.bitmap.copyTo(&mLocked.state.icon.bitmap, kN32_SkColorType);
+        mLocked.iconGenerationId = icon.bitmap.getGenerationID();
+        mLocked.clearedIconBitmap.reset();
 
         if (!mLocked.state.icon.isValid()
                 || mLocked.state.icon.hotSpotX != icon.hotSpotX
@@ -421,8 +435,11 @@ void SpriteController::SpriteImpl::setIcon(const SpriteIcon& icon) {
             dirty = DIRTY_BITMAP;
         }
     } else if (mLocked.state.icon.isValid()) {
+        // Only hide the surface, keeping what is drawn into it in case the
+        // same icon is set again.
+        mLocked.clearedIconBitmap = mLocked.state.icon.bitmap;
         mLocked.state.icon.bitmap.reset();
-        dirty = DIRTY_BITMAP | DIRTY_HOTSPOT;
+        dirty = DIRTY_VISIBILITY;
     } else {
         return; // setting to invalid icon and already invalid so nothing to do
     }
@@ -245,6 +245,11 @@ private:
 
         struct Locked {
             SpriteState state;
+            // The generation ID of the bitmap the icon was copied from, and the
+            // copy while the icon is cleared, so that setting the same icon
+            // again doesn't copy and redraw it.
+            uint32_t iconGenerationId;
+            SkBitmap clearedIconBitmap;
         } mLocked; // guarded by mController->mLock
 
         void invalidateLocked(uint32_t dirty);
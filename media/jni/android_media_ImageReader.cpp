@@ -72,6 +72,23 @@ static struct {
     jmethodID ctor;
 } gSurfacePlaneClassInfo;
 
+static struct {
+    jclass clazz;
+} gByteBufferClassInfo;
+
+// A LockedBuffer plus the plane layout derived from it, which is computed on
+// the first nativeGetPlanes() call and reused until the image is released.
+struct LockedImage : public CpuConsumer::LockedBuffer {
+    LockedImage() : planesValid(false), numPlanes(0) {}
+
+    bool planesValid;
+    int numPlanes;
+    uint8_t* planeBase[IMAGE_READER_MAX_NUM_PLANES];
+    uint32_t planeSize[IMAGE_READER_MAX_NUM_PLANES];
+    int rowStride[IMAGE_READER_MAX_NUM_PLANES];
+    int pixelStride[IMAGE_READER_MAX_NUM_PLANES];
+};
+
 // Get an ID that's unique within this process.
 static int32_t createProcessUniqueId() {
     static volatile int32_t globalCounter = 0;
@@ -140,7 +157,7 @@ JNIImageReaderContext::JNIImageReaderContext(JNIEnv* env,
     mWeakThiz(env->NewGlobalRef(weakThiz)),
     mClazz((jclass)env->NewGlobalRef(clazz)) {
     for (int i = 0; i < maxImages; i++) {
-        CpuConsumer::LockedBuffer *buffer = new CpuConsumer::LockedBuffer;
+        CpuConsumer::LockedBuffer *buffer = new LockedImage;
         BufferItem* opaqueBuffer = new BufferItem;
         mBuffers.push_back(buffer);
         mOpaqueBuffers.push_back(opaqueBuffer);
@@ -218,7 +235,7 @@ JNIImageReaderContext::~JNIImageReaderContext() {
     // Delete LockedBuffers
     for (List<CpuConsumer::LockedBuffer *>::iterator it = mBuffers.begin();
             it != mBuffers.end(); it++) {
-        delete *it;
+        delete static_cast<LockedImage*>(*it);
     }
 
     // Delete opaque buffers
@@ -783,6 +800,10 @@ static void ImageReader_classInit(JNIEnv* env, jclass clazz)
             "(Landroid/media/ImageReader$SurfaceImage;III)V");
     LOG_ALWAYS_FATAL_IF(gSurfacePlaneClassInfo.ctor == NULL,
             "Can not find SurfacePlane constructor");
+
+    jclass byteBufferClazz = env->FindClass("java/nio/ByteBuffer");
+    LOG_ALWAYS_FATAL_IF(byteBufferClazz == NULL, "Can not find ByteBuffer class");
+    gByteBufferClassInfo.clazz = (jclass) env->NewGlobalRef(byteBufferClazz);
 }
 
 static void ImageReader_init(JNIEnv* env, jobject thiz, jobject weakThiz,
@@ -1067,6 +1088,7 @@ static jint ImageReader_lockedImageSetup(JNIEnv* env, JNIImageReaderContext* ctx
         }
     }
     // Set SurfaceImage instance member variables
+    static_cast<LockedImage*>(buffer)->planesValid = false;
     Image_setBuffer(env, image, buffer);
     env->SetLongField(image, gSurfaceImageClassInfo.mTimestamp,
             static_cast<jlong>(buffer->timestamp));
@@ -1211,6 +1233,104 @@ static jobject Image_getByteBuffer(JNIEnv* env, jobject thiz, int idx, int reade
     return byteBuffer;
 }
 
+static int Image_getNumPlanes(int32_t halFormat)
+{
+    switch (halFormat) {
+        case HAL_PIXEL_FORMAT_YCbCr_420_888:
+        case HAL_PIXEL_FORMAT_YV12:
+            return 3;
+        default:
+            return 1;
+    }
+}
+
+// Returns the ByteBuffers of all planes at once and writes each plane's row
+// and pixel stride to strides[2 * i] and strides[2 * i + 1].
+static jobjectArray Image_getPlanes(JNIEnv* env, jobject thiz, jint readerFormat,
+        jintArray strides)
+{
+    int readerHalFormat = android_view_Surface_mapPublicFormatToHalFormat(
+            static_cast<PublicFormat>(readerFormat));
+    if (isFormatOpaque(readerHalFormat)) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                "Opaque images from Opaque ImageReader do not have any planes");
+        return NULL;
+    }
+
+    LockedImage* image = static_cast<LockedImage*>(Image_getLockedBuffer(env, thiz));
+    if (image == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException", "Image was released");
+        return NULL;
+    }
+
+    if (!image->planesValid) {
+        int32_t fmt = applyFormatOverrides(image->flexFormat, readerHalFormat);
+        int numPlanes = Image_getNumPlanes(fmt);
+        for (int i = 0; i < numPlanes; i++) {
+            Image_getLockedBufferInfo(env, image, i, &image->planeBase[i],
+                    &image->planeSize[i], readerHalFormat);
+            image->rowStride[i] = Image_imageGetRowStride(env, image, i, readerHalFormat);
+            image->pixelStride[i] = Image_imageGetPixelStride(env, image, i, readerHalFormat);
+            if (env->ExceptionCheck()) {
+                return NULL;
+            }
+            if (image->planeSize[i] > static_cast<uint32_t>(INT32_MAX)) {
+                jniThrowExceptionFmt(env, "java/lang/IllegalStateException",
+                        "Size too large for bytebuffer capacity %" PRIu32, image->planeSize[i]);
+                return NULL;
+            }
+        }
+        image->numPlanes = numPlanes;
+        image->planesValid = true;
+    }
+
+    if (strides != NULL) {
+        if (env->GetArrayLength(strides) < 2 * image->numPlanes) {
+            jniThrowException(env, "java/lang/IllegalArgumentException",
+                    "strides array is too small");
+            return NULL;
+        }
+        jint values[2 * IMAGE_READER_MAX_NUM_PLANES];
+        for (int i = 0; i < image->numPlanes; i++) {
+            values[2 * i] = image->rowStride[i];
+            values[2 * i + 1] = image->pixelStride[i];
+        }
+        env->SetIntArrayRegion(strides, 0, 2 * image->numPlanes, values);
+    }
+
+    jobjectArray buffers = env->NewObjectArray(image->numPlanes,
+            gByteBufferClassInfo.clazz, NULL);
+    if (buffers == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < image->numPlanes; i++) {
+        jobject byteBuffer = env->NewDirectByteBuffer(image->planeBase[i], image->planeSize[i]);
+        if (byteBuffer == NULL) {
+            if (!env->ExceptionCheck()) {
+                jniThrowException(env, "java/lang/IllegalStateException",
+                        "Failed to allocate ByteBuffer");
+            }
+            return NULL;
+        }
+        env->SetObjectArrayElement(buffers, i, byteBuffer);
+        env->DeleteLocalRef(byteBuffer);
+    }
+    return buffers;
+}
+
+// Returns the ANativeWindowBuffer of an opaque image, for importing it into
+// EGL with EGL_NATIVE_BUFFER_ANDROID instead of locking it for the CPU. The
+// pointer is only valid until the image is closed.
+static jlong Image_getNativeBuffer(JNIEnv* env, jobject thiz)
+{
+    BufferItem* opaqueBuffer = Image_getOpaqueBuffer(env, thiz);
+    if (opaqueBuffer == NULL || opaqueBuffer->mGraphicBuffer == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException", "Image was released");
+        return 0;
+    }
+    return reinterpret_cast<jlong>(opaqueBuffer->mGraphicBuffer->getNativeBuffer());
+}
+
 static jint Image_getWidth(JNIEnv* env, jobject thiz, jint format)
 {
     if (isFormatOpaque(format)) {
@@ -1272,6 +1392,12 @@ static JNINativeMethod gImageMethods[] = {
     {"nativeGetFormat",        "(I)I",                        (void*)Image_getFormat },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gImageOptionalMethods[] = {
+    {"nativeGetPlanes",        "(I[I)[Ljava/nio/ByteBuffer;", (void*)Image_getPlanes },
+    {"nativeGetNativeBuffer",  "()J",                         (void*)Image_getNativeBuffer },
+};
+
 int register_android_media_ImageReader(JNIEnv *env) {
 
     int ret1 = AndroidRuntime::registerNativeMethods(env,
@@ -1280,5 +1406,8 @@ int register_android_media_ImageReader(JNIEnv *env) {
     int ret2 = AndroidRuntime::registerNativeMethods(env,
                    "android/media/ImageReader$SurfaceImage", gImageMethods, NELEM(gImageMethods));
 
+    AndroidRuntime::registerOptionalNativeMethods(env, "android/media/ImageReader$SurfaceImage",
+                   gImageOptionalMethods, NELEM(gImageOptionalMethods));
+
     return (ret1 || ret2);
 }
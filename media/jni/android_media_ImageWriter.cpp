@@ -31,6 +31,7 @@
 
 #include <stdint.h>
 #include <inttypes.h>
+#include <unistd.h>
 
 #define ALIGN(x, mask) ( ((x) + (mask) - 1) & ~((mask) - 1) )
 
@@ -492,45 +493,36 @@ static void ImageWriter_queueImage(JNIEnv* env, jobject thiz, jlong nativeCtx, j
     Image_setNativeContext(env, image, NULL, -1);
 }
 
-static jint ImageWriter_attachAndQueueImage(JNIEnv* env, jobject thiz, jlong nativeCtx,
-        jlong nativeBuffer, jint imageFormat, jlong timestampNs, jint left, jint top,
+// Attaches a buffer owned by another pipeline to the writer's queue without
+// copying it. Returns the error, with the exception already thrown.
+static status_t attachAndQueueBuffer(JNIEnv* env, JNIImageWriterContext* ctx,
+        const sp<GraphicBuffer>& buffer, int fenceFd, jlong timestampNs, jint left, jint top,
         jint right, jint bottom) {
-    ALOGV("%s", __FUNCTION__);
-    JNIImageWriterContext* const ctx = reinterpret_cast<JNIImageWriterContext *>(nativeCtx);
-    if (ctx == NULL || thiz == NULL) {
+    // The consumer of the writer reads the buffer with the layout it was
+    // configured for, only buffers of the same format can skip the copy.
+    const int writerFormat = ctx->getBufferFormat();
+    const int bufferFormat = buffer->getPixelFormat();
+    if (bufferFormat != writerFormat
+            && !(isFormatOpaque(bufferFormat) && isFormatOpaque(writerFormat))) {
+        ALOGE("%s: buffer format 0x%x doesn't match writer format 0x%x", __FUNCTION__,
+                bufferFormat, writerFormat);
+        if (fenceFd >= 0) {
+            close(fenceFd);
+        }
         jniThrowException(env, "java/lang/IllegalStateException",
-                "ImageWriterContext is not initialized");
-        return -1;
+                "Trying to attach an image of a different format into the ImageWriter");
+        return BAD_VALUE;
     }
 
     sp<Surface> surface = ctx->getProducer();
-    status_t res = OK;
-    if (!isFormatOpaque(imageFormat)) {
-        // TODO: need implement, see b/19962027
-        jniThrowRuntimeException(env,
-                "nativeAttachImage for non-opaque image is not implement yet!!!");
-        return -1;
-    }
-
-    if (!isFormatOpaque(ctx->getBufferFormat())) {
-        jniThrowException(env, "java/lang/IllegalStateException",
-                "Trying to attach an opaque image into a non-opaque ImageWriter");
-        return -1;
-    }
-
-    // Image is guaranteed to be from ImageReader at this point, so it is safe to
-    // cast to BufferItem pointer.
-    BufferItem* opaqueBuffer = reinterpret_cast<BufferItem*>(nativeBuffer);
-    if (opaqueBuffer == NULL) {
-        jniThrowException(env, "java/lang/IllegalStateException",
-                "Image is not initialized or already closed");
-        return -1;
-    }
 
     // Step 1. Attach Image
-    res = surface->attachBuffer(opaqueBuffer->mGraphicBuffer.get());
+    status_t res = surface->attachBuffer(buffer.get());
     if (res != OK) {
         ALOGE("Attach image failed: %s (%d)", strerror(-res), res);
+        if (fenceFd >= 0) {
+            close(fenceFd);
+        }
         switch (res) {
             case NO_INIT:
                 jniThrowException(env, "java/lang/IllegalStateException",
@@ -548,25 +540,28 @@ static jint ImageWriter_attachAndQueueImage(JNIEnv* env, jobject thiz, jlong nat
     // it was not locked.
     ALOGV("timestamp to be queued: %" PRId64, timestampNs);
     res = native_window_set_buffers_timestamp(anw.get(), timestampNs);
-    if (res != OK) {
+    if (res == OK) {
+        android_native_rect_t cropRect;
+        cropRect.left = left;
+        cropRect.top = top;
+        cropRect.right = right;
+        cropRect.bottom = bottom;
+        res = native_window_set_crop(anw.get(), &cropRect);
+        if (res != OK) {
+            jniThrowRuntimeException(env, "Set crop rect failed");
+        }
+    } else {
         jniThrowRuntimeException(env, "Set timestamp failed");
-        return res;
     }
-
-    android_native_rect_t cropRect;
-    cropRect.left = left;
-    cropRect.top = top;
-    cropRect.right = right;
-    cropRect.bottom = bottom;
-    res = native_window_set_crop(anw.get(), &cropRect);
     if (res != OK) {
-        jniThrowRuntimeException(env, "Set crop rect failed");
+        // The buffer is attached, give it back to the queue
+        anw->cancelBuffer(anw.get(), buffer.get(), fenceFd);
         return res;
     }
 
-    // Step 3. Queue Image.
-    res = anw->queueBuffer(anw.get(), opaqueBuffer->mGraphicBuffer.get(), /*fenceFd*/
-            -1);
+    // Step 3. Queue Image. The fence hands the wait for the producer of the
+    // buffer over to the consumer of the writer instead of blocking here.
+    res = anw->queueBuffer(anw.get(), buffer.get(), fenceFd);
     if (res != OK) {
         ALOGE("%s: Queue buffer failed: %s (%d)", __FUNCTION__, strerror(-res), res);
         switch (res) {
@@ -580,11 +575,49 @@ static jint ImageWriter_attachAndQueueImage(JNIEnv* env, jobject thiz, jlong nat
         }
         return res;
     }
+    return OK;
+}
+
+static jint ImageWriter_attachAndQueueImage(JNIEnv* env, jobject thiz, jlong nativeCtx,
+        jlong nativeBuffer, jint imageFormat, jlong timestampNs, jint left, jint top,
+        jint right, jint bottom) {
+    ALOGV("%s", __FUNCTION__);
+    JNIImageWriterContext* const ctx = reinterpret_cast<JNIImageWriterContext *>(nativeCtx);
+    if (ctx == NULL || thiz == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                "ImageWriterContext is not initialized");
+        return -1;
+    }
+
+    if (!isFormatOpaque(imageFormat)) {
+        // Non-opaque ImageReader images are CpuConsumer buffers, which don't
+        // expose their GraphicBuffer, see b/19962027
+        jniThrowRuntimeException(env,
+                "Non-opaque images come from a CpuConsumer and have no attachable "
+                "GraphicBuffer");
+        return -1;
+    }
+
+    // Image is guaranteed to be from ImageReader at this point, so it is safe to
+    // cast to BufferItem pointer.
+    BufferItem* opaqueBuffer = reinterpret_cast<BufferItem*>(nativeBuffer);
+    if (opaqueBuffer == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                "Image is not initialized or already closed");
+        return -1;
+    }
+
+    // The producer of the reader may still be writing to the buffer
+    int fenceFd = -1;
+    if (opaqueBuffer->mFence != NULL && opaqueBuffer->mFence->isValid()) {
+        fenceFd = opaqueBuffer->mFence->dup();
+    }
 
     // Do not set the image native context. Since it would overwrite the existing native context
     // of the image that is from ImageReader, the subsequent image close will run into issues.
 
-    return res;
+    return attachAndQueueBuffer(env, ctx, opaqueBuffer->mGraphicBuffer, fenceFd, timestampNs,
+            left, top, right, bottom);
 }
 
 // --------------------------Image methods---------------------------------------
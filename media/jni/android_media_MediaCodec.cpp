@@ -41,6 +41,7 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/PersistentSurface.h>
 #include <nativehelper/ScopedLocalRef.h>
+#include <nativehelper/ScopedPrimitiveArray.h>
 
 #include <system/window.h>
 
@@ -85,6 +86,12 @@ static struct {
     jmethodID setNativeObjectLocked;
 } gPersistentSurfaceClassInfo;
 
+static struct {
+    jclass clazz;
+    jmethodID ctor;
+    jmethodID set;
+} gBufferInfo;
+
 struct fields_t {
     jfieldID context;
     jmethodID postEventFromNativeID;
@@ -349,11 +356,7 @@ status_t JMediaCodec::dequeueOutputBuffer(
         return err;
     }
 
-    ScopedLocalRef<jclass> clazz(
-            env, env->FindClass("android/media/MediaCodec$BufferInfo"));
-
-    jmethodID method = env->GetMethodID(clazz.get(), "set", "(IIJI)V");
-    env->CallVoidMethod(bufferInfo, method, (jint)offset, (jint)size, timeUs, flags);
+    env->CallVoidMethod(bufferInfo, gBufferInfo.set, (jint)offset, (jint)size, timeUs, flags);
 
     return OK;
 }
@@ -673,12 +676,7 @@ void JMediaCodec::handleCallback(const sp<AMessage> &msg) {
             CHECK(msg->findInt64("timeUs", &timeUs));
             CHECK(msg->findInt32("flags", (int32_t *)&flags));
 
-            ScopedLocalRef<jclass> clazz(
-                    env, env->FindClass("android/media/MediaCodec$BufferInfo"));
-            jmethodID ctor = env->GetMethodID(clazz.get(), "<init>", "()V");
-            jmethodID method = env->GetMethodID(clazz.get(), "set", "(IIJI)V");
-
-            obj = env->NewObject(clazz.get(), ctor);
+            obj = env->NewObject(gBufferInfo.clazz, gBufferInfo.ctor);
 
             if (obj == NULL) {
                 if (env->ExceptionCheck()) {
@@ -689,7 +687,7 @@ void JMediaCodec::handleCallback(const sp<AMessage> &msg) {
                 return;
             }
 
-            env->CallVoidMethod(obj, method, (jint)offset, (jint)size, timeUs, flags);
+            env->CallVoidMethod(obj, gBufferInfo.set, (jint)offset, (jint)size, timeUs, flags);
             break;
         }
 
@@ -1228,6 +1226,56 @@ static void android_media_MediaCodec_queueInputBuffer(
             env, err, ACTION_CODE_FATAL, errorDetailMsg.empty() ? NULL : errorDetailMsg.c_str());
 }
 
+static void android_media_MediaCodec_queueInputBuffers(
+        JNIEnv *env,
+        jobject thiz,
+        jintArray indexArray,
+        jintArray offsetArray,
+        jintArray sizeArray,
+        jlongArray timestampUsArray,
+        jintArray flagsArray) {
+    ALOGV("android_media_MediaCodec_queueInputBuffers");
+
+    sp<JMediaCodec> codec = getMediaCodec(env, thiz);
+
+    if (codec == NULL) {
+        throwExceptionAsNecessary(env, INVALID_OPERATION);
+        return;
+    }
+
+    ScopedIntArrayRO indices(env, indexArray);
+    ScopedIntArrayRO offsets(env, offsetArray);
+    ScopedIntArrayRO sizes(env, sizeArray);
+    ScopedLongArrayRO timestampsUs(env, timestampUsArray);
+    ScopedIntArrayRO flags(env, flagsArray);
+    if (indices.get() == NULL || offsets.get() == NULL || sizes.get() == NULL
+            || timestampsUs.get() == NULL || flags.get() == NULL) {
+        return;
+    }
+
+    const size_t count = indices.size();
+    if (offsets.size() != count || sizes.size() != count
+            || timestampsUs.size() != count || flags.size() != count) {
+        throwExceptionAsNecessary(env, BAD_VALUE, ACTION_CODE_FATAL,
+                "buffer arrays must have the same length");
+        return;
+    }
+
+    // Queue in order and stop at the first failure, like a loop of
+    // queueInputBuffer() calls would.
+    for (size_t i = 0; i < count; i++) {
+        AString errorDetailMsg;
+        status_t err = codec->queueInputBuffer(
+                indices[i], offsets[i], sizes[i], timestampsUs[i], flags[i], &errorDetailMsg);
+        if (err != OK) {
+            throwExceptionAsNecessary(
+                    env, err, ACTION_CODE_FATAL,
+                    errorDetailMsg.empty() ? NULL : errorDetailMsg.c_str());
+            return;
+        }
+    }
+}
+
 static void android_media_MediaCodec_queueSecureInputBuffer(
         JNIEnv *env,
         jobject thiz,
@@ -1430,6 +1478,31 @@ static void android_media_MediaCodec_releaseOutputBuffer(
     throwExceptionAsNecessary(env, err);
 }
 
+static void android_media_MediaCodec_releaseOutputBuffers(
+        JNIEnv *env, jobject thiz, jintArray indexArray, jboolean render) {
+    ALOGV("android_media_MediaCodec_releaseOutputBuffers");
+
+    sp<JMediaCodec> codec = getMediaCodec(env, thiz);
+
+    if (codec == NULL) {
+        throwExceptionAsNecessary(env, INVALID_OPERATION);
+        return;
+    }
+
+    ScopedIntArrayRO indices(env, indexArray);
+    if (indices.get() == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < indices.size(); i++) {
+        status_t err = codec->releaseOutputBuffer(indices[i], render, false, 0);
+        if (err != OK) {
+            throwExceptionAsNecessary(env, err);
+            return;
+        }
+    }
+}
+
 static void android_media_MediaCodec_signalEndOfInputStream(JNIEnv* env,
         jobject thiz) {
     ALOGV("android_media_MediaCodec_signalEndOfInputStream");
@@ -1669,6 +1742,16 @@ static void android_media_MediaCodec_native_init(JNIEnv *env) {
     gFields.cryptoInfoModeID = env->GetFieldID(clazz.get(), "mode", "I");
     CHECK(gFields.cryptoInfoModeID != NULL);
 
+    clazz.reset(env->FindClass("android/media/MediaCodec$BufferInfo"));
+    CHECK(clazz.get() != NULL);
+    gBufferInfo.clazz = (jclass)env->NewGlobalRef(clazz.get());
+
+    gBufferInfo.ctor = env->GetMethodID(clazz.get(), "<init>", "()V");
+    CHECK(gBufferInfo.ctor != NULL);
+
+    gBufferInfo.set = env->GetMethodID(clazz.get(), "set", "(IIJI)V");
+    CHECK(gBufferInfo.set != NULL);
+
     clazz.reset(env->FindClass("android/media/MediaCodec$CryptoException"));
     CHECK(clazz.get() != NULL);
 
@@ -1882,7 +1965,18 @@ static JNINativeMethod gMethods[] = {
       (void *)android_media_MediaCodec_native_finalize },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "native_queueInputBuffers", "([I[I[I[J[I)V",
+      (void *)android_media_MediaCodec_queueInputBuffers },
+
+    { "native_releaseOutputBuffers", "([IZ)V",
+      (void *)android_media_MediaCodec_releaseOutputBuffers },
+};
+
 int register_android_media_MediaCodec(JNIEnv *env) {
+    AndroidRuntime::registerOptionalNativeMethods(env,
+                "android/media/MediaCodec", gOptionalMethods, NELEM(gOptionalMethods));
     return AndroidRuntime::registerNativeMethods(env,
                 "android/media/MediaCodec", gMethods, NELEM(gMethods));
 }
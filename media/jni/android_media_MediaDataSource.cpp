@@ -20,6 +20,10 @@
 
 #include "android_media_MediaDataSource.h"
 
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "android_runtime/AndroidRuntime.h"
 #include "android_runtime/Log.h"
 #include "jni.h"
@@ -32,7 +36,8 @@
 namespace android {
 
 JMediaDataSource::JMediaDataSource(JNIEnv* env, jobject source)
-    : mJavaObjStatus(OK), mSizeIsCached(false), mCachedSize(0), mMemory(NULL) {
+    : mJavaObjStatus(OK), mSizeIsCached(false), mCachedSize(0), mMemory(NULL),
+      mCache(NULL), mCacheOffset(0), mCacheSize(0), mFd(-1), mFdOffset(0) {
     mMediaDataSourceObj = env->NewGlobalRef(source);
     CHECK(mMediaDataSourceObj != NULL);
 
@@ -46,6 +51,45 @@ JMediaDataSource::JMediaDataSource(JNIEnv* env, jobject source)
     mCloseMethod = env->GetMethodID(mediaDataSourceClass.get(), "close", "()V");
     CHECK(mCloseMethod != NULL);
 
+    // Optional: sources backed by a file opt in by implementing
+    // MediaDataSource.FileBacked, to hand us the descriptor and the offset of
+    // their data within it. Other sources are never asked, even if they
+    // happen to have methods of the same names.
+    ScopedLocalRef<jclass> fileBackedClass(env,
+            env->FindClass("android/media/MediaDataSource$FileBacked"));
+    if (fileBackedClass.get() == NULL) {
+        env->ExceptionClear();
+    } else if (env->IsInstanceOf(mMediaDataSourceObj, fileBackedClass.get())) {
+        jmethodID getFdMethod = env->GetMethodID(fileBackedClass.get(),
+                "getFileDescriptor", "()Ljava/io/FileDescriptor;");
+        CHECK(getFdMethod != NULL);
+        ScopedLocalRef<jobject> fileDesc(env,
+                env->CallObjectMethod(mMediaDataSourceObj, getFdMethod));
+        if (env->ExceptionCheck()) {
+            LOGW_EX(env);
+            env->ExceptionClear();
+        } else if (fileDesc.get() != NULL) {
+            int fd = jniGetFDFromFileDescriptor(env, fileDesc.get());
+            if (fd >= 0) {
+                mFd = dup(fd);
+            }
+        }
+    }
+    if (mFd >= 0) {
+        jmethodID getFdOffsetMethod = env->GetMethodID(fileBackedClass.get(),
+                "getFileDescriptorOffset", "()J");
+        CHECK(getFdOffsetMethod != NULL);
+        mFdOffset = env->CallLongMethod(mMediaDataSourceObj, getFdOffsetMethod);
+        if (env->ExceptionCheck() || mFdOffset < 0) {
+            LOGW_EX(env);
+            env->ExceptionClear();
+            ::close(mFd);
+            mFd = -1;
+            mFdOffset = 0;
+        }
+        ALOGV_IF(mFd >= 0, "reading from fd %d at offset %lld", mFd, (long long)mFdOffset);
+    }
+
     ScopedLocalRef<jbyteArray> tmp(env, env->NewByteArray(kBufferSize));
     mByteArrayObj = (jbyteArray)env->NewGlobalRef(tmp.get());
     CHECK(mByteArrayObj != NULL);
@@ -55,12 +99,20 @@ JMediaDataSource::JMediaDataSource(JNIEnv* env, jobject source)
     if (mMemory == NULL) {
         ALOGE("Failed to allocate memory!");
     }
+
+    if (mFd < 0) {
+        mCache = new uint8_t[kReadAheadSize];
+    }
 }
 
 JMediaDataSource::~JMediaDataSource() {
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     env->DeleteGlobalRef(mMediaDataSourceObj);
     env->DeleteGlobalRef(mByteArrayObj);
+    delete[] mCache;
+    if (mFd >= 0) {
+        ::close(mFd);
+    }
 }
 
 sp<IMemory> JMediaDataSource::getIMemory() {
@@ -77,8 +129,47 @@ ssize_t JMediaDataSource::readAt(off64_t offset, size_t size) {
     if (size > kBufferSize) {
         size = kBufferSize;
     }
+    if (mFd >= 0) {
+        return readFromFd_l(offset, size);
+    }
+
+    if (offset < mCacheOffset || offset + (off64_t)size > mCacheOffset + (off64_t)mCacheSize) {
+        ssize_t filled = fillCache_l(offset);
+        if (filled <= 0) {
+            return filled;
+        }
+    }
+    // what the java source returned may be short of the request
+    size_t available = mCacheSize - (size_t)(offset - mCacheOffset);
+    if (size > available) {
+        size = available;
+    }
+    ALOGV("readAt %lld => %zu from cache.", (long long)offset, size);
+    memcpy(mMemory->pointer(), mCache + (offset - mCacheOffset), size);
+    return size;
+}
+
+ssize_t JMediaDataSource::readFromFd_l(off64_t offset, size_t size) {
+    ssize_t numread;
+    do {
+        numread = pread64(mFd, mMemory->pointer(), size, mFdOffset + offset);
+    } while (numread < 0 && errno == EINTR);
+    if (numread < 0) {
+        ALOGW("pread from data source fd failed: %s", strerror(errno));
+        mJavaObjStatus = UNKNOWN_ERROR;
+        return -1;
+    }
+    return numread;
+}
+
+// Reads kReadAheadSize bytes at offset from the java source into mCache.
+// Returns the number of bytes cached, 0 at EOF or -1 on error.
+ssize_t JMediaDataSource::fillCache_l(off64_t offset) {
+    mCacheSize = 0;
+    mCacheOffset = offset;
 
     JNIEnv* env = AndroidRuntime::getJNIEnv();
+    const size_t size = kReadAheadSize;
     jint numread = env->CallIntMethod(mMediaDataSourceObj, mReadMethod,
             (jlong)offset, mByteArrayObj, (jint)0, (jint)size);
     if (env->ExceptionCheck()) {
@@ -104,8 +195,9 @@ ssize_t JMediaDataSource::readAt(off64_t offset, size_t size) {
         return -1;
     }
 
-    ALOGV("readAt %lld / %zu => %d.", (long long)offset, size, numread);
-    env->GetByteArrayRegion(mByteArrayObj, 0, numread, (jbyte*)mMemory->pointer());
+    ALOGV("fillCache %lld / %zu => %d.", (long long)offset, size, numread);
+    env->GetByteArrayRegion(mByteArrayObj, 0, numread, (jbyte*)mCache);
+    mCacheSize = numread;
     return numread;
 }
 
@@ -148,6 +240,11 @@ void JMediaDataSource::close() {
     env->CallVoidMethod(mMediaDataSourceObj, mCloseMethod);
     // The closed state is effectively the same as an error state.
     mJavaObjStatus = UNKNOWN_ERROR;
+    mCacheSize = 0;
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
 }
 
 }  // namespace android
@@ -32,10 +32,16 @@ namespace android {
 // If the java DataSource returns an error or throws an exception it
 // will be considered to be in a broken state, and the only further call this
 // will make is to close().
+//
+// Reads go through a native read-ahead cache, so the many small reads an
+// extractor makes while parsing a container cost one call into java per
+// kReadAheadSize bytes. A DataSource that implements MediaDataSource.FileBacked
+// to hand out a file descriptor is read with pread() and never called for data.
 class JMediaDataSource : public BnDataSource {
 public:
     enum {
         kBufferSize = 64 * 1024,
+        kReadAheadSize = kBufferSize,
     };
 
     JMediaDataSource(JNIEnv *env, jobject source);
@@ -47,6 +53,9 @@ public:
     virtual void close();
 
 private:
+    ssize_t readFromFd_l(off64_t offset, size_t size);
+    ssize_t fillCache_l(off64_t offset);
+
     // Protect all member variables with mLock because this object will be
     // accessed on different binder worker threads.
     Mutex mLock;
@@ -65,6 +74,15 @@ private:
     jmethodID mCloseMethod;
     jbyteArray mByteArrayObj;
 
+    // Read-ahead cache holding [mCacheOffset, mCacheOffset + mCacheSize).
+    uint8_t* mCache;
+    off64_t mCacheOffset;
+    size_t mCacheSize;
+
+    // Set when the java DataSource provided a file descriptor; owned by us.
+    int mFd;
+    off64_t mFdOffset;
+
     DISALLOW_EVIL_CONSTRUCTORS(JMediaDataSource);
 };
 
@@ -38,6 +38,7 @@
 #include <media/stagefright/NuMediaExtractor.h>
 
 #include <nativehelper/ScopedLocalRef.h>
+#include <nativehelper/ScopedPrimitiveArray.h>
 
 #include "android_util_Binder.h"
 
@@ -207,6 +208,119 @@ status_t JMediaExtractor::readSampleData(
     return OK;
 }
 
+status_t JMediaExtractor::readSampleDataBatch(
+        jobject byteBuf, size_t offset, size_t maxSamples, int64_t *info,
+        size_t *numSamples, size_t *totalSize) {
+    *numSamples = 0;
+    *totalSize = 0;
+
+    JNIEnv *env = AndroidRuntime::getJNIEnv();
+
+    void *dst = env->GetDirectBufferAddress(byteBuf);
+
+    size_t dstSize;
+    jbyteArray byteArray = NULL;
+
+    ScopedLocalRef<jclass> byteBufClass(env, env->FindClass("java/nio/ByteBuffer"));
+    CHECK(byteBufClass.get() != NULL);
+
+    if (dst == NULL) {
+        jmethodID arrayID =
+            env->GetMethodID(byteBufClass.get(), "array", "()[B");
+        CHECK(arrayID != NULL);
+
+        byteArray =
+            (jbyteArray)env->CallObjectMethod(byteBuf, arrayID);
+
+        if (byteArray == NULL) {
+            return INVALID_OPERATION;
+        }
+
+        jboolean isCopy;
+        dst = env->GetByteArrayElements(byteArray, &isCopy);
+
+        dstSize = (size_t) env->GetArrayLength(byteArray);
+    } else {
+        dstSize = (size_t) env->GetDirectBufferCapacity(byteBuf);
+    }
+
+    if (dstSize < offset) {
+        if (byteArray != NULL) {
+            env->ReleaseByteArrayElements(byteArray, (jbyte *)dst, 0);
+        }
+
+        return -ERANGE;
+    }
+
+    status_t err = OK;
+    size_t used = offset;
+    while (*numSamples < maxSamples) {
+        size_t trackIndex;
+        err = mImpl->getSampleTrackIndex(&trackIndex);
+        if (err != OK) {
+            break;
+        }
+
+        sp<ABuffer> buffer = new ABuffer((char *)dst + used, dstSize - used);
+        err = mImpl->readSampleData(buffer);
+        if (err != OK) {
+            // a sample that does not fit stays current for the next call
+            break;
+        }
+
+        int64_t sampleTimeUs;
+        uint32_t sampleFlags;
+        if ((err = mImpl->getSampleTime(&sampleTimeUs)) != OK
+                || (err = getSampleFlags(&sampleFlags)) != OK) {
+            break;
+        }
+
+        int64_t *sampleInfo = info + *numSamples * kBatchInfoFields;
+        sampleInfo[0] = buffer->size();
+        sampleInfo[1] = sampleTimeUs;
+        sampleInfo[2] = sampleFlags;
+        sampleInfo[3] = trackIndex;
+        used += buffer->size();
+        ++*numSamples;
+
+        err = mImpl->advance();
+        if (err != OK) {
+            break;
+        }
+    }
+
+    if (byteArray != NULL) {
+        env->ReleaseByteArrayElements(byteArray, (jbyte *)dst, 0);
+    }
+
+    // report what was read; the error surfaces on the next call
+    if (*numSamples == 0) {
+        return err;
+    }
+
+    *totalSize = used - offset;
+
+    jmethodID positionID = env->GetMethodID(
+            byteBufClass.get(), "position", "(I)Ljava/nio/Buffer;");
+
+    CHECK(positionID != NULL);
+
+    jmethodID limitID = env->GetMethodID(
+            byteBufClass.get(), "limit", "(I)Ljava/nio/Buffer;");
+
+    CHECK(limitID != NULL);
+
+    jobject me = env->CallObjectMethod(
+            byteBuf, limitID, used);
+    env->DeleteLocalRef(me);
+    me = env->CallObjectMethod(
+            byteBuf, positionID, offset);
+    env->DeleteLocalRef(me);
+    me = NULL;
+
+    return OK;
+}
+
 status_t JMediaExtractor::getSampleTrackIndex(size_t *trackIndex) {
     return mImpl->getSampleTrackIndex(trackIndex);
 }
@@ -425,6 +539,45 @@ static jint android_media_MediaExtractor_readSampleData(
     return (jint) sampleSize;
 }
 
+static jint android_media_MediaExtractor_readSampleDataBatch(
+        JNIEnv *env, jobject thiz, jobject byteBuf, jint offset, jlongArray infoArray) {
+    sp<JMediaExtractor> extractor = getMediaExtractor(env, thiz);
+
+    if (extractor == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException", NULL);
+        return -1;
+    }
+
+    if (infoArray == NULL) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", NULL);
+        return -1;
+    }
+
+    ScopedLongArrayRW info(env, infoArray);
+    if (info.get() == NULL) {
+        return -1;
+    }
+
+    size_t maxSamples = info.size() / JMediaExtractor::kBatchInfoFields;
+    if (maxSamples == 0) {
+        return 0;
+    }
+
+    size_t numSamples;
+    size_t totalSize;
+    status_t err = extractor->readSampleDataBatch(
+            byteBuf, offset, maxSamples, (int64_t *)info.get(), &numSamples, &totalSize);
+
+    if (err == ERROR_END_OF_STREAM) {
+        return -1;
+    } else if (err != OK) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", NULL);
+        return -1;
+    }
+
+    return (jint) numSamples;
+}
+
 static jint android_media_MediaExtractor_getSampleTrackIndex(
         JNIEnv *env, jobject thiz) {
     sp<JMediaExtractor> extractor = getMediaExtractor(env, thiz);
@@ -830,7 +983,15 @@ static JNINativeMethod gMethods[] = {
       (void *)android_media_MediaExtractor_hasCacheReachedEOS },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "readSampleDataBatch", "(Ljava/nio/ByteBuffer;I[J)I",
+        (void *)android_media_MediaExtractor_readSampleDataBatch },
+};
+
 int register_android_media_MediaExtractor(JNIEnv *env) {
+    AndroidRuntime::registerOptionalNativeMethods(env,
+                "android/media/MediaExtractor", gOptionalMethods, NELEM(gOptionalMethods));
     return AndroidRuntime::registerNativeMethods(env,
                 "android/media/MediaExtractor", gMethods, NELEM(gMethods));
 }
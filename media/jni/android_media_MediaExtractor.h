@@ -56,6 +56,16 @@ struct JMediaExtractor : public RefBase {
 
     status_t advance();
     status_t readSampleData(jobject byteBuf, size_t offset, size_t *sampleSize);
+
+    // Reads up to maxSamples consecutive samples back to back into byteBuf,
+    // advancing past each one, and stores size, time, flags and track index
+    // of sample i at info[i * kBatchInfoFields].
+    enum {
+        kBatchInfoFields = 4,
+    };
+    status_t readSampleDataBatch(
+            jobject byteBuf, size_t offset, size_t maxSamples, int64_t *info,
+            size_t *numSamples, size_t *totalSize);
     status_t getSampleTrackIndex(size_t *trackIndex);
     status_t getSampleTime(int64_t *sampleTimeUs);
     status_t getSampleFlags(uint32_t *sampleFlags);
@@ -332,6 +332,240 @@ static jobject android_media_MediaMetadataRetriever_getFrameAtTime(JNIEnv *env,
     return jBitmap;
 }
 
+// Bilinearly samples an RGB565 pixel at the 16.16 fixed point source position
+// (sx, sy). Positions are clamped to the frame so edge pixels are replicated.
+static inline uint16_t sample565(const uint16_t* src, size_t width, size_t height,
+        int32_t sx, int32_t sy)
+{
+    const int32_t maxX = (int32_t) (width - 1) << 16;
+    const int32_t maxY = (int32_t) (height - 1) << 16;
+    sx = sx < 0 ? 0 : (sx > maxX ? maxX : sx);
+    sy = sy < 0 ? 0 : (sy > maxY ? maxY : sy);
+
+    const size_t x0 = sx >> 16;
+    const size_t y0 = sy >> 16;
+    const size_t x1 = x0 + 1 < width ? x0 + 1 : x0;
+    const size_t y1 = y0 + 1 < height ? y0 + 1 : y0;
+    // 8 bit weights keep the per channel products inside 32 bits.
+    const uint32_t fx = (sx >> 8) & 0xff;
+    const uint32_t fy = (sy >> 8) & 0xff;
+
+    const uint32_t p00 = src[y0 * width + x0];
+    const uint32_t p01 = src[y0 * width + x1];
+    const uint32_t p10 = src[y1 * width + x0];
+    const uint32_t p11 = src[y1 * width + x1];
+
+    const uint32_t w00 = (256 - fx) * (256 - fy);
+    const uint32_t w01 = fx * (256 - fy);
+    const uint32_t w10 = (256 - fx) * fy;
+    const uint32_t w11 = fx * fy;
+
+    const uint32_t r = ((p00 >> 11) * w00 + (p01 >> 11) * w01
+            + (p10 >> 11) * w10 + (p11 >> 11) * w11 + 32768) >> 16;
+    const uint32_t g = (((p00 >> 5) & 0x3f) * w00 + ((p01 >> 5) & 0x3f) * w01
+            + ((p10 >> 5) & 0x3f) * w10 + ((p11 >> 5) & 0x3f) * w11 + 32768) >> 16;
+    const uint32_t b = ((p00 & 0x1f) * w00 + (p01 & 0x1f) * w01
+            + (p10 & 0x1f) * w10 + (p11 & 0x1f) * w11 + 32768) >> 16;
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+// Rotates and resamples a width x height RGB565 frame into a dstWidth x dstHeight
+// buffer in a single pass. dstWidth and dstHeight are in rotated (display)
+// orientation. This avoids materializing a full resolution rotated copy and then
+// rescaling it again through Bitmap.createScaledBitmap().
+static void scaleRotate565(uint16_t* dst, size_t dstWidth, size_t dstHeight,
+        const uint16_t* src, size_t width, size_t height, int angle)
+{
+    const bool swap = (angle == 90 || angle == 270);
+    const size_t rotatedWidth = swap ? height : width;
+    const size_t rotatedHeight = swap ? width : height;
+
+    // Step through the rotated image in 16.16 fixed point, sampling pixel centers.
+    const int32_t stepX = (int32_t) (((int64_t) rotatedWidth << 16) / dstWidth);
+    const int32_t stepY = (int32_t) (((int64_t) rotatedHeight << 16) / dstHeight);
+    const int32_t startX = stepX / 2 - 32768;
+    const int32_t startY = stepY / 2 - 32768;
+    const int32_t maxX = (int32_t) (width - 1) << 16;
+    const int32_t maxY = (int32_t) (height - 1) << 16;
+
+    int32_t ry = startY;
+    for (size_t i = 0; i < dstHeight; ++i, ry += stepY) {
+        int32_t rx = startX;
+        uint16_t* row = dst + i * dstWidth;
+        for (size_t j = 0; j < dstWidth; ++j, rx += stepX) {
+            // Map the rotated position back into the unrotated source frame;
+            // this is the inverse of the index mapping used by rotate90/180/270.
+            int32_t sx, sy;
+            switch (angle) {
+                case 90:
+                    sx = ry;
+                    sy = maxY - rx;
+                    break;
+                case 180:
+                    sx = maxX - rx;
+                    sy = maxY - ry;
+                    break;
+                case 270:
+                    sx = maxX - ry;
+                    sy = rx;
+                    break;
+                default:
+                    sx = rx;
+                    sy = ry;
+                    break;
+            }
+            row[j] = sample565(src, width, height, sx, sy);
+        }
+    }
+}
+
+// Converts a VideoFrame into a Bitmap of dstWidth x dstHeight (in display
+// orientation). A non-positive dimension is derived from the other one using the
+// frame's display aspect ratio; if both are non-positive the display size is used.
+static jobject createScaledBitmapFromFrame(JNIEnv *env, const VideoFrame *videoFrame,
+        jint dstWidth, jint dstHeight)
+{
+    const bool swapWidthAndHeight =
+            videoFrame->mRotationAngle == 90 || videoFrame->mRotationAngle == 270;
+    uint32_t displayWidth = videoFrame->mDisplayWidth;
+    uint32_t displayHeight = videoFrame->mDisplayHeight;
+    if (swapWidthAndHeight) {
+        displayWidth = videoFrame->mDisplayHeight;
+        displayHeight = videoFrame->mDisplayWidth;
+    }
+    if (videoFrame->mWidth == 0 || videoFrame->mHeight == 0
+            || displayWidth == 0 || displayHeight == 0) {
+        ALOGE("createScaledBitmapFromFrame: empty video frame");
+        return NULL;
+    }
+
+    if (dstWidth <= 0 && dstHeight <= 0) {
+        dstWidth = displayWidth;
+        dstHeight = displayHeight;
+    } else if (dstWidth <= 0) {
+        dstWidth = (jint) (((uint64_t) dstHeight * displayWidth + displayHeight / 2)
+                / displayHeight);
+    } else if (dstHeight <= 0) {
+        dstHeight = (jint) (((uint64_t) dstWidth * displayHeight + displayWidth / 2)
+                / displayWidth);
+    }
+    if (dstWidth <= 0) {
+        dstWidth = 1;
+    }
+    if (dstHeight <= 0) {
+        dstHeight = 1;
+    }
+
+    jobject config = env->CallStaticObjectMethod(
+                        fields.configClazz,
+                        fields.createConfigMethod,
+                        GraphicsJNI::colorTypeToLegacyBitmapConfig(kRGB_565_SkColorType));
+
+    jobject jBitmap = env->CallStaticObjectMethod(
+                            fields.bitmapClazz,
+                            fields.createBitmapMethod,
+                            dstWidth,
+                            dstHeight,
+                            config);
+    env->DeleteLocalRef(config);
+    if (jBitmap == NULL) {
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+        }
+        ALOGE("createScaledBitmapFromFrame: create Bitmap failed!");
+        return NULL;
+    }
+
+    SkBitmap bitmap;
+    GraphicsJNI::getSkBitmap(env, jBitmap, &bitmap);
+
+    bitmap.lockPixels();
+    const uint16_t* src = (const uint16_t*)((const char*)videoFrame + sizeof(VideoFrame));
+    uint16_t* dst = (uint16_t*) bitmap.getPixels();
+    const uint32_t rotatedWidth = swapWidthAndHeight ? videoFrame->mHeight : videoFrame->mWidth;
+    const uint32_t rotatedHeight = swapWidthAndHeight ? videoFrame->mWidth : videoFrame->mHeight;
+    if ((uint32_t) dstWidth == rotatedWidth && (uint32_t) dstHeight == rotatedHeight) {
+        // No resampling needed, a plain rotation is cheaper.
+        rotate(dst, src, videoFrame->mWidth, videoFrame->mHeight, videoFrame->mRotationAngle);
+    } else {
+        scaleRotate565(dst, dstWidth, dstHeight, src, videoFrame->mWidth,
+                videoFrame->mHeight, videoFrame->mRotationAngle);
+    }
+    bitmap.unlockPixels();
+
+    return jBitmap;
+}
+
+static jobject android_media_MediaMetadataRetriever_getScaledFrameAtTime(JNIEnv *env,
+        jobject thiz, jlong timeUs, jint option, jint dstWidth, jint dstHeight)
+{
+    ALOGV("getScaledFrameAtTime: %lld us option: %d size: %dx%d",
+            (long long)timeUs, option, dstWidth, dstHeight);
+    MediaMetadataRetriever* retriever = getRetriever(env, thiz);
+    if (retriever == 0) {
+        jniThrowException(env, "java/lang/IllegalStateException", "No retriever available");
+        return NULL;
+    }
+
+    VideoFrame *videoFrame = NULL;
+    sp<IMemory> frameMemory = retriever->getFrameAtTime(timeUs, option);
+    if (frameMemory != 0) {
+        videoFrame = static_cast<VideoFrame *>(frameMemory->pointer());
+    }
+    if (videoFrame == NULL) {
+        ALOGE("getScaledFrameAtTime: videoFrame is a NULL pointer");
+        return NULL;
+    }
+
+    return createScaledBitmapFromFrame(env, videoFrame, dstWidth, dstHeight);
+}
+
+// Extracts one thumbnail per entry of timesUs on the same retriever, so the data
+// source and extractor are set up once for the whole batch. Frames that cannot be
+// retrieved leave a null entry in the returned array.
+static jobjectArray android_media_MediaMetadataRetriever_getFramesAtTimes(JNIEnv *env,
+        jobject thiz, jlongArray timesUs, jint option, jint dstWidth, jint dstHeight)
+{
+    MediaMetadataRetriever* retriever = getRetriever(env, thiz);
+    if (retriever == 0) {
+        jniThrowException(env, "java/lang/IllegalStateException", "No retriever available");
+        return NULL;
+    }
+    if (timesUs == NULL) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "Null time array");
+        return NULL;
+    }
+
+    const jsize count = env->GetArrayLength(timesUs);
+    jobjectArray result = env->NewObjectArray(count, fields.bitmapClazz, NULL);
+    if (result == NULL) {
+        return NULL;
+    }
+
+    jlong* times = env->GetLongArrayElements(timesUs, NULL);
+    if (times == NULL) {
+        return NULL;
+    }
+    for (jsize i = 0; i < count; ++i) {
+        ALOGV("getFramesAtTimes: [%d] %lld us", i, (long long)times[i]);
+        sp<IMemory> frameMemory = retriever->getFrameAtTime(times[i], option);
+        if (frameMemory == 0 || frameMemory->pointer() == NULL) {
+            ALOGW("getFramesAtTimes: no frame at %lld us", (long long)times[i]);
+            continue;
+        }
+        const VideoFrame *videoFrame = static_cast<VideoFrame *>(frameMemory->pointer());
+        jobject jBitmap = createScaledBitmapFromFrame(env, videoFrame, dstWidth, dstHeight);
+        if (jBitmap != NULL) {
+            env->SetObjectArrayElement(result, i, jBitmap);
+            // Keep the local reference table bounded for large batches.
+            env->DeleteLocalRef(jBitmap);
+        }
+    }
+    env->ReleaseLongArrayElements(timesUs, times, JNI_ABORT);
+
+    return result;
+}
+
 static jbyteArray android_media_MediaMetadataRetriever_getEmbeddedPicture(
         JNIEnv *env, jobject thiz, jint pictureType)
 {
@@ -485,10 +719,18 @@ static JNINativeMethod nativeMethods[] = {
         {"native_init",     "()V", (void *)android_media_MediaMetadataRetriever_native_init},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod optionalNativeMethods[] = {
+        {"_getScaledFrameAtTime", "(JIII)Landroid/graphics/Bitmap;", (void *)android_media_MediaMetadataRetriever_getScaledFrameAtTime},
+        {"_getFramesAtTimes", "([JIII)[Landroid/graphics/Bitmap;", (void *)android_media_MediaMetadataRetriever_getFramesAtTimes},
+};
+
 // This function only registers the native methods, and is called from
 // JNI_OnLoad in android_media_MediaPlayer.cpp
 int register_android_media_MediaMetadataRetriever(JNIEnv *env)
 {
+    AndroidRuntime::registerOptionalNativeMethods
+        (env, kClassPathName, optionalNativeMethods, NELEM(optionalNativeMethods));
     return AndroidRuntime::registerNativeMethods
         (env, kClassPathName, nativeMethods, NELEM(nativeMethods));
 }
@@ -28,12 +28,18 @@
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaMuxer.h>
 
+#include <utils/Vector.h>
+
 namespace android {
 
 struct fields_t {
     jmethodID arrayID;
 };
 
+// Ints per sample in the info array of nativeWriteSampleDataBatch:
+// track index, offset, size and flags
+static const int kBatchSampleInfoSize = 4;
+
 static fields_t gFields;
 
 }
@@ -131,6 +137,94 @@ static void android_media_MediaMuxer_writeSampleData(
     return;
 }
 
+// Writes several samples held by one ByteBuffer with a single JNI call,
+// sampleInfo holds kBatchSampleInfoSize ints for each entry of timesUs
+static void android_media_MediaMuxer_writeSampleDataBatch(
+        JNIEnv *env, jclass /* clazz */, jlong nativeObject, jobject byteBuf,
+        jintArray sampleInfo, jlongArray timesUs) {
+    sp<MediaMuxer> muxer(reinterpret_cast<MediaMuxer *>(nativeObject));
+    if (muxer == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                          "Muxer was not set up correctly");
+        return;
+    }
+
+    if (sampleInfo == NULL || timesUs == NULL) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                          "sample descriptors are null");
+        return;
+    }
+    jsize count = env->GetArrayLength(timesUs);
+    if (env->GetArrayLength(sampleInfo) != count * kBatchSampleInfoSize) {
+        jniThrowException(env, "java/lang/IllegalArgumentException",
+                          "sample descriptors have mismatched lengths");
+        return;
+    }
+
+    Vector<jint> info;
+    Vector<jlong> times;
+    info.resize(count * kBatchSampleInfoSize);
+    times.resize(count);
+    env->GetIntArrayRegion(sampleInfo, 0, info.size(), info.editArray());
+    env->GetLongArrayRegion(timesUs, 0, count, times.editArray());
+
+    void *dst = env->GetDirectBufferAddress(byteBuf);
+
+    jlong dstSize;
+    jbyteArray byteArray = NULL;
+
+    if (dst == NULL) {
+        byteArray =
+            (jbyteArray)env->CallObjectMethod(byteBuf, gFields.arrayID);
+
+        if (byteArray == NULL) {
+            jniThrowException(env, "java/lang/IllegalArgumentException",
+                              "byteArray is null");
+            return;
+        }
+
+        jboolean isCopy;
+        dst = env->GetByteArrayElements(byteArray, &isCopy);
+
+        dstSize = env->GetArrayLength(byteArray);
+    } else {
+        dstSize = env->GetDirectBufferCapacity(byteBuf);
+    }
+
+    // Reject the whole batch before anything is written
+    for (jsize i = 0; i < count; i++) {
+        const jint *sample = info.array() + i * kBatchSampleInfoSize;
+        jint offset = sample[1];
+        jint size = sample[2];
+        if (offset < 0 || size < 0 || dstSize < ((jlong)offset + size)) {
+            ALOGE("writeSampleDataBatch saw wrong dstSize %lld, size  %d, offset %d "
+                  "for sample %d", (long long)dstSize, size, offset, (int)i);
+            if (byteArray != NULL) {
+                env->ReleaseByteArrayElements(byteArray, (jbyte *)dst, JNI_ABORT);
+            }
+            jniThrowException(env, "java/lang/IllegalArgumentException",
+                              "sample has a wrong size");
+            return;
+        }
+    }
+
+    status_t err = OK;
+    for (jsize i = 0; i < count && err == OK; i++) {
+        const jint *sample = info.array() + i * kBatchSampleInfoSize;
+        sp<ABuffer> buffer = new ABuffer((char *)dst + sample[1], sample[2]);
+        err = muxer->writeSampleData(buffer, sample[0], times[i], sample[3]);
+    }
+
+    if (byteArray != NULL) {
+        env->ReleaseByteArrayElements(byteArray, (jbyte *)dst, JNI_ABORT);
+    }
+
+    if (err != OK) {
+        jniThrowException(env, "java/lang/IllegalStateException",
+                          "writeSampleData returned an error");
+    }
+}
+
 // Constructor counterpart.
 static jlong android_media_MediaMuxer_native_setup(
         JNIEnv *env, jclass clazz, jobject fileDescriptor,
@@ -245,11 +339,19 @@ static JNINativeMethod gMethods[] = {
 
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    { "nativeWriteSampleDataBatch", "(JLjava/nio/ByteBuffer;[I[J)V",
+        (void *)android_media_MediaMuxer_writeSampleDataBatch },
+};
+
 // This function only registers the native methods, and is called from
 // JNI_OnLoad in android_media_MediaPlayer.cpp
 int register_android_media_MediaMuxer(JNIEnv *env) {
     int err = AndroidRuntime::registerNativeMethods(env,
                 "android/media/MediaMuxer", gMethods, NELEM(gMethods));
+    AndroidRuntime::registerOptionalNativeMethods(env,
+                "android/media/MediaMuxer", gOptionalMethods, NELEM(gOptionalMethods));
 
     jclass byteBufClass = env->FindClass("java/nio/ByteBuffer");
     CHECK(byteBufClass != NULL);
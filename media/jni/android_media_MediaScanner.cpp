@@ -19,6 +19,10 @@
 #define LOG_TAG "MediaScannerJNI"
 #include <utils/Log.h>
 #include <utils/threads.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+#include <cutils/atomic.h>
 #include <media/mediascanner.h>
 #include <media/stagefright/StagefrightMediaScanner.h>
 #include <private/media/VideoFrame.h>
@@ -28,6 +32,13 @@
 #include "android_runtime/AndroidRuntime.h"
 #include "android_runtime/Log.h"
 
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace android;
 
 
@@ -105,6 +116,27 @@ static bool isValidUtf8(const char* bytes) {
     return true;
 }
 
+// Like NewStringUTF(), but replaces the bytes of invalid modified UTF-8 with
+// '?' instead of aborting.
+static jstring newStringUTFCleaned(JNIEnv* env, const char* value) {
+    char *cleaned = NULL;
+    if (!isValidUtf8(value)) {
+        cleaned = strdup(value);
+        char *chp = cleaned;
+        char ch;
+        while ((ch = *chp)) {
+            if (ch & 0x80) {
+                *chp = '?';
+            }
+            chp++;
+        }
+        value = cleaned;
+    }
+    jstring str = env->NewStringUTF(value);
+    free(cleaned);
+    return str;
+}
+
 class MyMediaScannerClient : public MediaScannerClient
 {
 public:
@@ -113,7 +145,9 @@ public:
             mClient(env->NewGlobalRef(client)),
             mScanFileMethodID(0),
             mHandleStringTagMethodID(0),
-            mSetMimeTypeMethodID(0)
+            mHandleStringTagsMethodID(0),
+            mSetMimeTypeMethodID(0),
+            mStringClass(NULL)
     {
         ALOGV("MyMediaScannerClient constructor");
         jclass mediaScannerClientInterface =
@@ -136,6 +170,19 @@ public:
                                     mediaScannerClientInterface,
                                     "setMimeType",
                                     "(Ljava/lang/String;)V");
+
+            // Optional; when the client has it, all the tags of a file are
+            // delivered in one call as alternating names and values.
+            mHandleStringTagsMethodID = env->GetMethodID(
+                                    mediaScannerClientInterface,
+                                    "handleStringTags",
+                                    "([Ljava/lang/String;)V");
+            if (mHandleStringTagsMethodID == NULL) {
+                env->ExceptionClear();
+            } else {
+                mStringClass = env->FindClass("java/lang/String");
+            }
+            env->DeleteLocalRef(mediaScannerClientInterface);
         }
     }
 
@@ -143,6 +190,42 @@ public:
     {
         ALOGV("MyMediaScannerClient destructor");
         mEnv->DeleteGlobalRef(mClient);
+        if (mStringClass != NULL) {
+            mEnv->DeleteLocalRef(mStringClass);
+        }
+    }
+
+    // Sends the tags queued by handleStringTag() to the client.
+    status_t flushTags()
+    {
+        if (mPendingTags.isEmpty()) {
+            return OK;
+        }
+
+        const size_t count = mPendingTags.size();
+        jobjectArray tags = mEnv->NewObjectArray(count, mStringClass, NULL);
+        if (tags == NULL) {
+            mPendingTags.clear();
+            mEnv->ExceptionClear();
+            return NO_MEMORY;
+        }
+        for (size_t i = 0; i < count; i++) {
+            jstring str = newStringUTFCleaned(mEnv, mPendingTags[i].string());
+            if (str == NULL) {
+                mEnv->DeleteLocalRef(tags);
+                mPendingTags.clear();
+                mEnv->ExceptionClear();
+                return NO_MEMORY;
+            }
+            mEnv->SetObjectArrayElement(tags, i, str);
+            mEnv->DeleteLocalRef(str);
+        }
+        mPendingTags.clear();
+
+        mEnv->CallVoidMethod(mClient, mHandleStringTagsMethodID, tags);
+
+        mEnv->DeleteLocalRef(tags);
+        return checkAndClearExceptionFromCallback(mEnv, "handleStringTags");
     }
 
     virtual status_t scanFile(const char* path, long long lastModified,
@@ -167,26 +250,18 @@ public:
     virtual status_t handleStringTag(const char* name, const char* value)
     {
         ALOGV("handleStringTag: name(%s) and value(%s)", name, value);
+        if (mHandleStringTagsMethodID != NULL) {
+            mPendingTags.push(String8(name));
+            mPendingTags.push(String8(value));
+            return OK;
+        }
+
         jstring nameStr, valueStr;
         if ((nameStr = mEnv->NewStringUTF(name)) == NULL) {
             mEnv->ExceptionClear();
             return NO_MEMORY;
         }
-        char *cleaned = NULL;
-        if (!isValidUtf8(value)) {
-            cleaned = strdup(value);
-            char *chp = cleaned;
-            char ch;
-            while ((ch = *chp)) {
-                if (ch & 0x80) {
-                    *chp = '?';
-                }
-                chp++;
-            }
-            value = cleaned;
-        }
-        valueStr = mEnv->NewStringUTF(value);
-        free(cleaned);
+        valueStr = newStringUTFCleaned(mEnv, value);
         if (valueStr == NULL) {
             mEnv->DeleteLocalRef(nameStr);
             mEnv->ExceptionClear();
@@ -204,6 +279,9 @@ public:
     virtual status_t setMimeType(const char* mimeType)
     {
         ALOGV("setMimeType: %s", mimeType);
+        // Keep the client seeing events in the order the scanner made them.
+        flushTags();
+
         jstring mimeTypeStr;
         if ((mimeTypeStr = mEnv->NewStringUTF(mimeType)) == NULL) {
             mEnv->ExceptionClear();
@@ -221,9 +299,161 @@ private:
     jobject mClient;
     jmethodID mScanFileMethodID;
     jmethodID mHandleStringTagMethodID;
+    jmethodID mHandleStringTagsMethodID;
     jmethodID mSetMimeTypeMethodID;
+    jclass mStringClass;
+    Vector<String8> mPendingTags;
 };
 
+// Records what the scanner reports for one file, so that it can be extracted
+// on a worker thread and replayed to the Java client later.
+class RecordingMediaScannerClient : public MediaScannerClient
+{
+public:
+    enum EventType {
+        EVENT_STRING_TAG,
+        EVENT_MIME_TYPE,
+    };
+
+    struct Event {
+        EventType type;
+        String8 name;
+        String8 value;
+    };
+
+    virtual status_t scanFile(const char* /*path*/, long long /*lastModified*/,
+            long long /*fileSize*/, bool /*isDirectory*/, bool /*noMedia*/)
+    {
+        return OK;
+    }
+
+    virtual status_t handleStringTag(const char* name, const char* value)
+    {
+        Event event;
+        event.type = EVENT_STRING_TAG;
+        event.name = name;
+        event.value = value;
+        mEvents.push(event);
+        return OK;
+    }
+
+    virtual status_t setMimeType(const char* mimeType)
+    {
+        Event event;
+        event.type = EVENT_MIME_TYPE;
+        event.value = mimeType;
+        mEvents.push(event);
+        return OK;
+    }
+
+    status_t replay(MyMediaScannerClient& client) const
+    {
+        for (size_t i = 0; i < mEvents.size(); i++) {
+            const Event& event = mEvents[i];
+            status_t err = event.type == EVENT_MIME_TYPE
+                    ? client.setMimeType(event.value.string())
+                    : client.handleStringTag(event.name.string(), event.value.string());
+            if (err != OK) {
+                return err;
+            }
+        }
+        return OK;
+    }
+
+private:
+    Vector<Event> mEvents;
+};
+
+// The StagefrightMediaScanner owned by a Java MediaScanner, plus the state of
+// prefetchFiles(): the metadata extracted ahead of processFile() and the
+// journal of files that were already scanned.
+class JNIMediaScanner : public StagefrightMediaScanner
+{
+public:
+    struct JournalEntry {
+        long long lastModified;
+        long long fileSize;
+    };
+
+    struct PrefetchedFile {
+        String8 mimeType;
+        MediaScanResult result;
+        RecordingMediaScannerClient client;
+        // Recorded in the journal once processFile() replayed the results
+        bool hasJournalEntry;
+        JournalEntry journalEntry;
+    };
+
+    JNIMediaScanner() : mJournalDirty(false) {}
+
+    virtual ~JNIMediaScanner()
+    {
+        clearPrefetched();
+    }
+
+    void setScanLocale(const char* locale)
+    {
+        setLocale(locale);
+        mScanLocale = locale;
+    }
+
+    const String8& scanLocale() const { return mScanLocale; }
+
+    void clearPrefetched()
+    {
+        for (size_t i = 0; i < mPrefetched.size(); i++) {
+            delete mPrefetched.valueAt(i);
+        }
+        mPrefetched.clear();
+    }
+
+    KeyedVector<String8, PrefetchedFile*> mPrefetched;
+    KeyedVector<String8, JournalEntry> mJournal;
+    String8 mJournalPath;
+    bool mJournalDirty;
+
+private:
+    String8 mScanLocale;
+};
+
+// Never use more threads than this for prefetchFiles(); metadata extraction
+// is mostly I/O bound, and each thread talks to the media server.
+static const long kMaxPrefetchThreads = 4;
+
+struct PrefetchJob {
+    String8 path;
+    String8 mimeType;
+    bool hasMimeType;
+    JNIMediaScanner::JournalEntry journalEntry;
+    JNIMediaScanner::PrefetchedFile* file;
+};
+
+struct PrefetchState {
+    Vector<PrefetchJob>* jobs;
+    const char* locale;
+    volatile int32_t nextJob;
+};
+
+static void* prefetchThreadMain(void* arg)
+{
+    PrefetchState* state = static_cast<PrefetchState*>(arg);
+    StagefrightMediaScanner scanner;
+    if (state->locale[0] != '\0') {
+        scanner.setLocale(state->locale);
+    }
+
+    while (true) {
+        int32_t index = android_atomic_inc(&state->nextJob);
+        if (index >= (int32_t) state->jobs->size()) {
+            break;
+        }
+        PrefetchJob& job = state->jobs->editItemAt(index);
+        job.file->result = scanner.processFile(job.path.string(),
+                job.hasMimeType ? job.mimeType.string() : NULL, job.file->client);
+    }
+    return NULL;
+}
+
 
 static MediaScanner *getNativeScanner_l(JNIEnv* env, jobject thiz)
 {
@@ -297,7 +527,30 @@ android_media_MediaScanner_processFile(
     }
 
     MyMediaScannerClient myClient(env, client);
-    MediaScanResult result = mp->processFile(pathStr, mimeTypeStr, myClient);
+    MediaScanResult result;
+
+    JNIMediaScanner* scanner = static_cast<JNIMediaScanner*>(mp);
+    ssize_t prefetchedIndex = scanner->mPrefetched.indexOfKey(String8(pathStr));
+    JNIMediaScanner::PrefetchedFile* prefetched = prefetchedIndex >= 0
+            ? scanner->mPrefetched.valueAt(prefetchedIndex) : NULL;
+    if (prefetched != NULL
+            && prefetched->mimeType == String8(mimeTypeStr ? mimeTypeStr : "")) {
+        scanner->mPrefetched.removeItemsAt(prefetchedIndex);
+        result = prefetched->result;
+        if (prefetched->client.replay(myClient) != OK) {
+            result = MEDIA_SCAN_RESULT_ERROR;
+        }
+        // Only files the client really received are skipped by the next scan
+        if (prefetched->hasJournalEntry && result != MEDIA_SCAN_RESULT_ERROR
+                && !env->ExceptionCheck()) {
+            scanner->mJournal.replaceValueFor(String8(pathStr), prefetched->journalEntry);
+            scanner->mJournalDirty = true;
+        }
+        delete prefetched;
+    } else {
+        result = mp->processFile(pathStr, mimeTypeStr, myClient);
+    }
+    myClient.flushTags();
     if (result == MEDIA_SCAN_RESULT_ERROR) {
         ALOGE("An error occurred while scanning file '%s'.", pathStr);
     }
@@ -326,11 +579,264 @@ android_media_MediaScanner_setLocale(
     if (localeStr == NULL) {  // Out of memory
         return;
     }
-    mp->setLocale(localeStr);
+    static_cast<JNIMediaScanner*>(mp)->setScanLocale(localeStr);
 
     env->ReleaseStringUTFChars(locale, localeStr);
 }
 
+static bool
+loadJournal(JNIMediaScanner* scanner)
+{
+    scanner->mJournal.clear();
+    scanner->mJournalDirty = false;
+
+    FILE* file = fopen(scanner->mJournalPath.string(), "re");
+    if (file == NULL) {
+        return errno == ENOENT;
+    }
+
+    // One "<lastModified> <fileSize> <path>" line per file, sorted by path.
+    char line[PATH_MAX + 64];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        JNIMediaScanner::JournalEntry entry;
+        int pathOffset = 0;
+        if (sscanf(line, "%lld %lld %n", &entry.lastModified, &entry.fileSize,
+                &pathOffset) < 2 || pathOffset == 0) {
+            continue;
+        }
+        char* path = line + pathOffset;
+        size_t length = strlen(path);
+        if (length > 0 && path[length - 1] == '\n') {
+            path[--length] = '\0';
+        }
+        if (length > 0) {
+            scanner->mJournal.add(String8(path, length), entry);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+static bool
+saveJournal(JNIMediaScanner* scanner)
+{
+    String8 tmpPath(scanner->mJournalPath);
+    tmpPath.append(".tmp");
+
+    FILE* file = fopen(tmpPath.string(), "we");
+    if (file == NULL) {
+        ALOGE("Failed to open '%s': %s", tmpPath.string(), strerror(errno));
+        return false;
+    }
+    for (size_t i = 0; i < scanner->mJournal.size(); i++) {
+        const JNIMediaScanner::JournalEntry& entry = scanner->mJournal.valueAt(i);
+        fprintf(file, "%lld %lld %s\n", entry.lastModified, entry.fileSize,
+                scanner->mJournal.keyAt(i).string());
+    }
+    bool ok = fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmpPath.string(), scanner->mJournalPath.string()) != 0) {
+        ALOGE("Failed to write '%s': %s", scanner->mJournalPath.string(), strerror(errno));
+        unlink(tmpPath.string());
+        return false;
+    }
+    scanner->mJournalDirty = false;
+    return true;
+}
+
+static void
+android_media_MediaScanner_setJournalPath(
+        JNIEnv *env, jobject thiz, jstring path)
+{
+    ALOGV("setJournalPath");
+    MediaScanner *mp = getNativeScanner_l(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, kRunTimeException, "No scanner available");
+        return;
+    }
+    JNIMediaScanner* scanner = static_cast<JNIMediaScanner*>(mp);
+
+    if (path == NULL) {
+        scanner->mJournalPath.setTo("");
+        scanner->mJournal.clear();
+        scanner->mJournalDirty = false;
+        return;
+    }
+
+    const char *pathStr = env->GetStringUTFChars(path, NULL);
+    if (pathStr == NULL) {  // Out of memory
+        return;
+    }
+    scanner->mJournalPath.setTo(pathStr);
+    env->ReleaseStringUTFChars(path, pathStr);
+
+    if (!loadJournal(scanner)) {
+        ALOGW("Failed to read scan journal '%s': %s", scanner->mJournalPath.string(),
+                strerror(errno));
+    }
+}
+
+static jboolean
+android_media_MediaScanner_saveJournal(JNIEnv *env, jobject thiz)
+{
+    ALOGV("saveJournal");
+    MediaScanner *mp = getNativeScanner_l(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, kRunTimeException, "No scanner available");
+        return JNI_FALSE;
+    }
+    JNIMediaScanner* scanner = static_cast<JNIMediaScanner*>(mp);
+    if (scanner->mJournalPath.isEmpty()) {
+        return JNI_FALSE;
+    }
+    if (!scanner->mJournalDirty) {
+        return JNI_TRUE;
+    }
+    return saveJournal(scanner) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Extracts the metadata of the given files on several threads, ahead of the
+// processFile() calls for them, which then replay the results instead of
+// opening the files. Files whose size and modification time match the
+// journal are not extracted, and false is returned for them. The journal only
+// records a file once processFile() has handed its results to the client.
+static jbooleanArray
+android_media_MediaScanner_prefetchFiles(
+        JNIEnv *env, jobject thiz, jobjectArray paths, jobjectArray mimeTypes)
+{
+    ALOGV("prefetchFiles");
+    MediaScanner *mp = getNativeScanner_l(env, thiz);
+    if (mp == NULL) {
+        jniThrowException(env, kRunTimeException, "No scanner available");
+        return NULL;
+    }
+    JNIMediaScanner* scanner = static_cast<JNIMediaScanner*>(mp);
+
+    if (paths == NULL) {
+        jniThrowException(env, kIllegalArgumentException, NULL);
+        return NULL;
+    }
+    const jsize count = env->GetArrayLength(paths);
+    if (mimeTypes != NULL && env->GetArrayLength(mimeTypes) != count) {
+        jniThrowException(env, kIllegalArgumentException,
+                "paths and mimeTypes must have the same length");
+        return NULL;
+    }
+
+    jbooleanArray changed = env->NewBooleanArray(count);
+    if (changed == NULL) {
+        return NULL;
+    }
+
+    // Anything left over from the previous batch was never asked for.
+    scanner->clearPrefetched();
+
+    Vector<PrefetchJob> jobs;
+    Vector<jboolean> changedValues;
+    changedValues.insertAt(JNI_FALSE, 0, count);
+    const bool useJournal = !scanner->mJournalPath.isEmpty();
+
+    for (jsize i = 0; i < count; i++) {
+        jstring path = (jstring) env->GetObjectArrayElement(paths, i);
+        if (path == NULL) {
+            continue;
+        }
+        const char *pathStr = env->GetStringUTFChars(path, NULL);
+        if (pathStr == NULL) {  // Out of memory
+            return NULL;
+        }
+        PrefetchJob job;
+        job.path.setTo(pathStr);
+        env->ReleaseStringUTFChars(path, pathStr);
+        env->DeleteLocalRef(path);
+
+        job.hasMimeType = false;
+        jstring mimeType = mimeTypes != NULL
+                ? (jstring) env->GetObjectArrayElement(mimeTypes, i) : NULL;
+        if (mimeType != NULL) {
+            const char *mimeTypeStr = env->GetStringUTFChars(mimeType, NULL);
+            if (mimeTypeStr == NULL) {  // Out of memory
+                return NULL;
+            }
+            job.mimeType.setTo(mimeTypeStr);
+            job.hasMimeType = true;
+            env->ReleaseStringUTFChars(mimeType, mimeTypeStr);
+            env->DeleteLocalRef(mimeType);
+        }
+
+        struct stat st;
+        if (stat(job.path.string(), &st) != 0 || S_ISDIR(st.st_mode)) {
+            continue;
+        }
+        job.journalEntry.lastModified = st.st_mtime;
+        job.journalEntry.fileSize = st.st_size;
+        if (useJournal) {
+            ssize_t index = scanner->mJournal.indexOfKey(job.path);
+            if (index >= 0) {
+                const JNIMediaScanner::JournalEntry& old = scanner->mJournal.valueAt(index);
+                if (old.lastModified == job.journalEntry.lastModified
+                        && old.fileSize == job.journalEntry.fileSize) {
+                    continue;
+                }
+            }
+        }
+
+        changedValues.editItemAt(i) = JNI_TRUE;
+        job.file = NULL;
+        jobs.push(job);
+    }
+
+    // Allocated once all the arguments are read, so the early returns above
+    // have nothing to free
+    for (size_t i = 0; i < jobs.size(); i++) {
+        PrefetchJob& job = jobs.editItemAt(i);
+        job.file = new JNIMediaScanner::PrefetchedFile;
+        job.file->mimeType = job.mimeType;
+        job.file->result = MEDIA_SCAN_RESULT_ERROR;
+        job.file->hasJournalEntry = useJournal;
+        job.file->journalEntry = job.journalEntry;
+    }
+
+    if (!jobs.isEmpty()) {
+        PrefetchState state;
+        state.jobs = &jobs;
+        state.locale = scanner->scanLocale().string();
+        state.nextJob = 0;
+
+        long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+        if (threadCount > kMaxPrefetchThreads) threadCount = kMaxPrefetchThreads;
+        if (threadCount > (long) jobs.size()) threadCount = jobs.size();
+
+        // The calling thread does its share of the work too.
+        Vector<pthread_t> threads;
+        for (long i = 1; i < threadCount; i++) {
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, prefetchThreadMain, &state) == 0) {
+                threads.push(thread);
+            }
+        }
+        prefetchThreadMain(&state);
+        for (size_t i = 0; i < threads.size(); i++) {
+            pthread_join(threads[i], NULL);
+        }
+
+        for (size_t i = 0; i < jobs.size(); i++) {
+            const PrefetchJob& job = jobs[i];
+            ssize_t index = scanner->mPrefetched.indexOfKey(job.path);
+            if (index >= 0) {
+                // The same path was passed twice.
+                delete scanner->mPrefetched.valueAt(index);
+                scanner->mPrefetched.replaceValueAt(index, job.file);
+            } else {
+                scanner->mPrefetched.add(job.path, job.file);
+            }
+        }
+    }
+
+    env->SetBooleanArrayRegion(changed, 0, count, changedValues.array());
+    return changed;
+}
+
 static jbyteArray
 android_media_MediaScanner_extractAlbumArt(
         JNIEnv *env, jobject thiz, jobject fileDescriptor)
@@ -390,7 +896,7 @@ static void
 android_media_MediaScanner_native_setup(JNIEnv *env, jobject thiz)
 {
     ALOGV("native_setup");
-    MediaScanner *mp = new StagefrightMediaScanner;
+    MediaScanner *mp = new JNIMediaScanner;
 
     if (mp == NULL) {
         jniThrowException(env, kRunTimeException, "Out of memory");
@@ -456,10 +962,33 @@ static JNINativeMethod gMethods[] = {
     },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    {
+        "prefetchFiles",
+        "([Ljava/lang/String;[Ljava/lang/String;)[Z",
+        (void *)android_media_MediaScanner_prefetchFiles
+    },
+
+    {
+        "setJournalPath",
+        "(Ljava/lang/String;)V",
+        (void *)android_media_MediaScanner_setJournalPath
+    },
+
+    {
+        "saveJournal",
+        "()Z",
+        (void *)android_media_MediaScanner_saveJournal
+    },
+};
+
 // This function only registers the native methods, and is called from
 // JNI_OnLoad in android_media_MediaPlayer.cpp
 int register_android_media_MediaScanner(JNIEnv *env)
 {
+    AndroidRuntime::registerOptionalNativeMethods(env,
+                kClassMediaScanner, gOptionalMethods, NELEM(gOptionalMethods));
     return AndroidRuntime::registerNativeMethods(env,
                 kClassMediaScanner, gMethods, NELEM(gMethods));
 }
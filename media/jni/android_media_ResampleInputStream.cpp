@@ -22,9 +22,19 @@
 #include <stdio.h>
 #include <assert.h>
 #include <limits.h>
+#include <math.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <utils/threads.h>
+#include <utils/Vector.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_NEON_DOT
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_SSE2_DOT
+#endif
 
 #include "jni.h"
 #include "JNIHelp.h"
@@ -72,6 +82,46 @@ static const int nFir21 = sizeof(fir21) / sizeof(fir21[0]);
 
 static const int BUF_SIZE = 2048;
 
+// Sum of a[k] * b[k] for k in [0, n), exact in 64 bits.
+static inline int64_t dot_s16(const short* a, const short* b, int n) {
+    int k = 0;
+    int64_t sum = 0;
+#if defined(USE_NEON_DOT)
+    int64x2_t acc = vdupq_n_s64(0);
+    for (; k + 8 <= n; k += 8) {
+        int16x8_t va = vld1q_s16(a + k);
+        int16x8_t vb = vld1q_s16(b + k);
+        acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(va), vget_low_s16(vb)));
+        acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(va), vget_high_s16(vb)));
+    }
+    sum = vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1);
+#elif defined(USE_SSE2_DOT)
+    // pairs of products fit in 32 bits as the filters never hold -32768
+    __m128i acc = _mm_setzero_si128();
+    for (; k + 8 <= n; k += 8) {
+        __m128i p = _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(a + k)),
+                _mm_loadu_si128((const __m128i*)(b + k)));
+        __m128i sign = _mm_srai_epi32(p, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(p, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(p, sign));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    sum = lanes[0] + lanes[1];
+#endif
+    for (; k < n; k++) {
+        sum += (int32_t)a[k] * b[k];
+    }
+    return sum;
+}
+
+// Halves the rate of npoints * 2 + nFir21 - 1 samples at in into npoints
+// samples at out.  out may alias in, as out[i] only needs in[2i] onwards.
+static void fir21_decimate(const short* in, short* out, int npoints) {
+    for (int i = 0; i < npoints; i++) {
+        out[i] = (short)(dot_s16(fir21, &in[i * 2], nFir21) >> 16);
+    }
+}
 
 static void android_media_ResampleInputStream_fir21(JNIEnv *env, jclass /* clazz */,
          jbyteArray jIn,  jint jInOffset,
@@ -91,31 +141,234 @@ static void android_media_ResampleInputStream_fir21(JNIEnv *env, jclass /* clazz
 
     // compute filter
     short out[BUF_SIZE];
-    for (int i = 0; i < jNpoints; i++) {
-        long sum = 0;
-        const short* firp = &fir21[0];
-        const short* inp = &in[i * 2];
-        for (int n = nFir21; --n >= 0; ) {
-            sum += ((long)*firp++) * ((long)*inp++);
-        }
-        out[i] = (short)(sum >> 16);
-    }
+    fir21_decimate(in, out, jNpoints);
 
     // save new values
     env->SetByteArrayRegion(jOut, jOutOffset, jNpoints * 2, (jbyte*)out);
 }
 
+// Returns the address of size bytes at offset in a direct ByteBuffer, or
+// NULL with an IllegalArgumentException pending.
+static short* getDirectSamples(JNIEnv *env, jobject buffer, jint offset, jlong size) {
+    if (buffer == NULL) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "null buffer");
+        return NULL;
+    }
+    jbyte* base = (jbyte*)env->GetDirectBufferAddress(buffer);
+    jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (base == NULL || capacity < 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "not a direct buffer");
+        return NULL;
+    }
+    if (offset < 0 || (offset & 1) != 0 || size < 0 || offset + size > capacity) {
+        jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
+                "bad range %d + %lld for capacity %lld", offset, (long long)size,
+                (long long)capacity);
+        return NULL;
+    }
+    return (short*)(base + offset);
+}
+
+// Same as fir21, on direct ByteBuffers without copying or a length limit.
+// in and out may be the same buffer as long as jOutOffset <= jInOffset.
+static void android_media_ResampleInputStream_fir21Direct(JNIEnv *env, jclass /* clazz */,
+         jobject jIn,  jint jInOffset,
+         jobject jOut, jint jOutOffset,
+         jint jNpoints) {
+    if (jNpoints <= 0) {
+        return;
+    }
+    const short* in = getDirectSamples(env, jIn, jInOffset,
+            ((jlong)jNpoints * 2 + nFir21 - 1) * 2);
+    if (in == NULL) {
+        return;
+    }
+    short* out = getDirectSamples(env, jOut, jOutOffset, (jlong)jNpoints * 2);
+    if (out == NULL) {
+        return;
+    }
+    fir21_decimate(in, out, jNpoints);
+}
+
+// ----------------------------------------------------------------------------
+
+// Streaming polyphase resampler for any rateIn:rateOut, reduced to L:M, with
+// a windowed sinc filter split into L phases of mTaps taps each.
+class PolyphaseResampler {
+public:
+    static const int kMaxPhases = 1024;
+    static const int kTapsPerRatio = 16;
+    static const int kMaxTaps = 256;
+
+    PolyphaseResampler(int phases, int decimation);
+
+    // Returns an upper bound on the output of resample(inCount samples)
+    int maxOutput(int inCount) const {
+        return (int)(((int64_t)inCount * mPhases) / mDecimation) + 2;
+    }
+    int resample(const short* in, int inCount, short* out);
+
+private:
+    const int mPhases;      // L
+    const int mDecimation;  // M
+    int mTaps;
+    android::Vector<short> mCoefs;   // mPhases rows of mTaps, time reversed
+    android::Vector<short> mBuffer;  // history then the current input
+    int mIndex;             // input index in mBuffer of the next output
+    int mPhase;
+};
+
+PolyphaseResampler::PolyphaseResampler(int phases, int decimation)
+    : mPhases(phases), mDecimation(decimation) {
+    const int ratio = (decimation + phases - 1) / phases;
+    mTaps = kTapsPerRatio * (ratio > 1 ? ratio : 1);
+    if (mTaps > kMaxTaps) {
+        mTaps = kMaxTaps;
+    }
+
+    // prototype low-pass at the upsampled rate, cut just below the lower Nyquist
+    const int n = mPhases * mTaps;
+    const double cutoff = 0.45 / (phases > decimation ? phases : decimation);
+    android::Vector<double> h;
+    h.insertAt(0.0, 0, n);
+    for (int j = 0; j < n; j++) {
+        double x = j - (n - 1) / 2.0;
+        double sinc = x == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * x) / (M_PI * x);
+        double window = 0.5 - 0.5 * cos(2 * M_PI * (j + 0.5) / n);
+        h.editItemAt(j) = sinc * window;
+    }
+
+    // unity gain for every phase, in Q15
+    mCoefs.insertAt(0, 0, n);
+    for (int p = 0; p < mPhases; p++) {
+        double gain = 0;
+        for (int k = 0; k < mTaps; k++) {
+            gain += h[p + k * mPhases];
+        }
+        if (gain == 0) {
+            gain = 1;
+        }
+        for (int k = 0; k < mTaps; k++) {
+            double c = floor(h[p + k * mPhases] / gain * 32768.0 + 0.5);
+            if (c > 32767) c = 32767;
+            if (c < -32767) c = -32767;
+            mCoefs.editItemAt(p * mTaps + mTaps - 1 - k) = (short)c;
+        }
+    }
+
+    mBuffer.insertAt(0, 0, mTaps - 1);
+    mIndex = mTaps - 1;
+    mPhase = 0;
+}
+
+int PolyphaseResampler::resample(const short* in, int inCount, short* out) {
+    const int history = mTaps - 1;
+    mBuffer.appendArray(in, inCount);
+    const short* buffer = mBuffer.array();
+    const int length = mBuffer.size();
+
+    int outCount = 0;
+    while (mIndex < length) {
+        int64_t sum = dot_s16(&mCoefs[mPhase * mTaps], buffer + mIndex - history, mTaps);
+        int32_t sample = (int32_t)(sum >> 15);
+        if (sample > SHRT_MAX) sample = SHRT_MAX;
+        if (sample < SHRT_MIN) sample = SHRT_MIN;
+        out[outCount++] = (short)sample;
+
+        mPhase += mDecimation;
+        mIndex += mPhase / mPhases;
+        mPhase %= mPhases;
+    }
+
+    // keep the last mTaps - 1 samples for the next call
+    mBuffer.removeItemsAt(0, length - history);
+    mIndex -= length - history;
+    return outCount;
+}
+
+static int gcd(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static jlong android_media_ResampleInputStream_native_createResampler(JNIEnv *env,
+        jclass /* clazz */, jint rateIn, jint rateOut) {
+    if (rateIn <= 0 || rateOut <= 0) {
+        jniThrowException(env, "java/lang/IllegalArgumentException", "bad sample rate");
+        return 0;
+    }
+    int g = gcd(rateIn, rateOut);
+    int phases = rateOut / g;
+    int decimation = rateIn / g;
+    if (phases > PolyphaseResampler::kMaxPhases) {
+        jniThrowExceptionFmt(env, "java/lang/IllegalArgumentException",
+                "unsupported rate ratio %d:%d", rateIn, rateOut);
+        return 0;
+    }
+    return (jlong)(intptr_t)new PolyphaseResampler(phases, decimation);
+}
+
+// Resamples jInSize bytes at jInOffset of a direct ByteBuffer into another
+// one at jOutOffset, returning the number of bytes written.  The output must
+// have room for maxOutput samples.
+static jint android_media_ResampleInputStream_native_resample(JNIEnv *env, jclass /* clazz */,
+        jlong handle, jobject jIn, jint jInOffset, jint jInSize,
+        jobject jOut, jint jOutOffset) {
+    PolyphaseResampler* resampler = (PolyphaseResampler*)(intptr_t)handle;
+    if (resampler == NULL) {
+        jniThrowException(env, "java/lang/IllegalStateException", NULL);
+        return 0;
+    }
+    if (jInSize <= 0) {
+        return 0;
+    }
+    const int inCount = jInSize / 2;
+    const short* in = getDirectSamples(env, jIn, jInOffset, (jlong)inCount * 2);
+    if (in == NULL) {
+        return 0;
+    }
+    short* out = getDirectSamples(env, jOut, jOutOffset,
+            (jlong)resampler->maxOutput(inCount) * 2);
+    if (out == NULL) {
+        return 0;
+    }
+    return resampler->resample(in, inCount, out) * 2;
+}
+
+static void android_media_ResampleInputStream_native_releaseResampler(JNIEnv* /* env */,
+        jclass /* clazz */, jlong handle) {
+    delete (PolyphaseResampler*)(intptr_t)handle;
+}
+
 // ----------------------------------------------------------------------------
 
 static JNINativeMethod gMethods[] = {
     {"fir21", "([BI[BII)V", (void*)android_media_ResampleInputStream_fir21},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    {"fir21Direct", "(Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;II)V",
+            (void*)android_media_ResampleInputStream_fir21Direct},
+    {"native_createResampler", "(II)J",
+            (void*)android_media_ResampleInputStream_native_createResampler},
+    {"native_resample", "(JLjava/nio/ByteBuffer;IILjava/nio/ByteBuffer;I)I",
+            (void*)android_media_ResampleInputStream_native_resample},
+    {"native_releaseResampler", "(J)V",
+            (void*)android_media_ResampleInputStream_native_releaseResampler},
+};
+
 
 int register_android_media_ResampleInputStream(JNIEnv *env)
 {
     const char* const kClassPathName = "android/media/ResampleInputStream";
 
+    AndroidRuntime::registerOptionalNativeMethods(env,
+            kClassPathName, gOptionalMethods, NELEM(gOptionalMethods));
     return AndroidRuntime::registerNativeMethods(env,
             kClassPathName, gMethods, NELEM(gMethods));
 }
@@ -29,6 +29,11 @@
 #include "android_runtime/AndroidRuntime.h"
 #include "android_runtime/Log.h"
 
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
 #include "MtpDatabase.h"
 #include "MtpDataPacket.h"
 #include "MtpObjectInfo.h"
@@ -88,6 +93,19 @@ MtpDatabase* getMtpDatabase(JNIEnv *env, jobject database) {
 
 // ----------------------------------------------------------------------------
 
+// How long properties fetched for a folder listing are trusted. The media
+// provider can change behind our back, so don't keep them for long.
+static const nsecs_t kPropertyCacheTimeout = seconds_to_nanoseconds(5);
+
+// One row of an MtpPropertyList.
+struct CachedProperty {
+    uint64_t        key;    // handle << 16 | property
+    int             type;
+    jlong           longValue;
+    String8         stringValue;
+    bool            hasString;
+};
+
 class MyMtpDatabase : public MtpDatabase {
 private:
     jobject         mDatabase;
@@ -95,6 +113,23 @@ private:
     jlongArray      mLongBuffer;
     jcharArray      mStringBuffer;
 
+    // Properties of the children of the most recently listed folder. A
+    // property is fetched for all of them with one query the first time it
+    // is asked for, instead of with one query per object.
+    MtpObjectHandle                 mCacheParent;
+    nsecs_t                         mCacheTime;
+    Vector<MtpObjectHandle>         mCacheHandles;      // sorted
+    Vector<MtpObjectProperty>       mCacheFetched;
+    Vector<CachedProperty>          mCacheValues;       // sorted by key
+    KeyedVector<MtpObjectFormat, MtpObjectPropertyList*> mCacheFormatProperties;
+
+    void                            clearPropertyCache();
+    const CachedProperty*           findCachedProperty(MtpObjectHandle handle,
+                                            MtpObjectProperty property);
+    bool                            getCachedPropertyList(MtpObjectHandle handle,
+                                            uint32_t property,
+                                            Vector<const CachedProperty*>& outList);
+
 public:
                                     MyMtpDatabase(JNIEnv *env, jobject client);
     virtual                         ~MyMtpDatabase();
@@ -193,7 +228,9 @@ MyMtpDatabase::MyMtpDatabase(JNIEnv *env, jobject client)
     :   mDatabase(env->NewGlobalRef(client)),
         mIntBuffer(NULL),
         mLongBuffer(NULL),
-        mStringBuffer(NULL)
+        mStringBuffer(NULL),
+        mCacheParent(0),
+        mCacheTime(0)
 {
     // create buffers for out arguments
     // we don't need to be thread-safe so this is OK
@@ -216,6 +253,7 @@ MyMtpDatabase::MyMtpDatabase(JNIEnv *env, jobject client)
 }
 
 void MyMtpDatabase::cleanup(JNIEnv *env) {
+    clearPropertyCache();
     env->DeleteGlobalRef(mDatabase);
     env->DeleteGlobalRef(mIntBuffer);
     env->DeleteGlobalRef(mLongBuffer);
@@ -225,12 +263,228 @@ void MyMtpDatabase::cleanup(JNIEnv *env) {
 MyMtpDatabase::~MyMtpDatabase() {
 }
 
+static int compareCachedProperties(const CachedProperty* lhs, const CachedProperty* rhs) {
+    return lhs->key < rhs->key ? -1 : (lhs->key > rhs->key ? 1 : 0);
+}
+
+static int compareHandles(const MtpObjectHandle* lhs, const MtpObjectHandle* rhs) {
+    return *lhs < *rhs ? -1 : (*lhs > *rhs ? 1 : 0);
+}
+
+static inline uint64_t cachedPropertyKey(MtpObjectHandle handle, MtpObjectProperty property) {
+    return ((uint64_t)handle << 16) | (property & 0xFFFF);
+}
+
+// Appends the rows of a Java MtpPropertyList to outList.
+static void readPropertyList(JNIEnv* env, jobject list, Vector<CachedProperty>& outList) {
+    int count = env->GetIntField(list, field_mCount);
+    if (count <= 0)
+        return;
+
+    jintArray objectHandlesArray = (jintArray)env->GetObjectField(list, field_mObjectHandles);
+    jintArray propertyCodesArray = (jintArray)env->GetObjectField(list, field_mPropertyCodes);
+    jintArray dataTypesArray = (jintArray)env->GetObjectField(list, field_mDataTypes);
+    jlongArray longValuesArray = (jlongArray)env->GetObjectField(list, field_mLongValues);
+    jobjectArray stringValuesArray = (jobjectArray)env->GetObjectField(list, field_mStringValues);
+
+    jint* objectHandles = env->GetIntArrayElements(objectHandlesArray, 0);
+    jint* propertyCodes = env->GetIntArrayElements(propertyCodesArray, 0);
+    jint* dataTypes = env->GetIntArrayElements(dataTypesArray, 0);
+    jlong* longValues = (longValuesArray ? env->GetLongArrayElements(longValuesArray, 0) : NULL);
+
+    outList.setCapacity(outList.size() + count);
+    for (int i = 0; i < count; i++) {
+        CachedProperty entry;
+        entry.key = cachedPropertyKey(objectHandles[i], propertyCodes[i]);
+        entry.type = dataTypes[i];
+        entry.longValue = (longValues ? longValues[i] : 0);
+        entry.hasString = false;
+        if (entry.type == MTP_TYPE_STR && stringValuesArray) {
+            jstring value = (jstring)env->GetObjectArrayElement(stringValuesArray, i);
+            const char *valueStr = (value ? env->GetStringUTFChars(value, NULL) : NULL);
+            if (valueStr) {
+                entry.stringValue.setTo(valueStr);
+                entry.hasString = true;
+                env->ReleaseStringUTFChars(value, valueStr);
+            }
+            env->DeleteLocalRef(value);
+        }
+        outList.push(entry);
+    }
+
+    env->ReleaseIntArrayElements(objectHandlesArray, objectHandles, JNI_ABORT);
+    env->ReleaseIntArrayElements(propertyCodesArray, propertyCodes, JNI_ABORT);
+    env->ReleaseIntArrayElements(dataTypesArray, dataTypes, JNI_ABORT);
+    if (longValues)
+        env->ReleaseLongArrayElements(longValuesArray, longValues, JNI_ABORT);
+
+    env->DeleteLocalRef(objectHandlesArray);
+    env->DeleteLocalRef(propertyCodesArray);
+    env->DeleteLocalRef(dataTypesArray);
+    if (longValuesArray)
+        env->DeleteLocalRef(longValuesArray);
+    if (stringValuesArray)
+        env->DeleteLocalRef(stringValuesArray);
+}
+
+// Writes one value the way getObjectPropertyList() does.
+static bool putPropertyValue(MtpDataPacket& packet, const CachedProperty& entry) {
+    switch (entry.type) {
+        case MTP_TYPE_INT8:
+            packet.putInt8(entry.longValue);
+            break;
+        case MTP_TYPE_UINT8:
+            packet.putUInt8(entry.longValue);
+            break;
+        case MTP_TYPE_INT16:
+            packet.putInt16(entry.longValue);
+            break;
+        case MTP_TYPE_UINT16:
+            packet.putUInt16(entry.longValue);
+            break;
+        case MTP_TYPE_INT32:
+            packet.putInt32(entry.longValue);
+            break;
+        case MTP_TYPE_UINT32:
+            packet.putUInt32(entry.longValue);
+            break;
+        case MTP_TYPE_INT64:
+            packet.putInt64(entry.longValue);
+            break;
+        case MTP_TYPE_UINT64:
+            packet.putUInt64(entry.longValue);
+            break;
+        case MTP_TYPE_INT128:
+            packet.putInt128(entry.longValue);
+            break;
+        case MTP_TYPE_UINT128:
+            packet.putUInt128(entry.longValue);
+            break;
+        case MTP_TYPE_STR:
+            if (entry.hasString) {
+                packet.putString(entry.stringValue.string());
+            } else {
+                packet.putEmptyString();
+            }
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+void MyMtpDatabase::clearPropertyCache() {
+    mCacheParent = 0;
+    mCacheTime = 0;
+    mCacheHandles.clear();
+    mCacheFetched.clear();
+    mCacheValues.clear();
+    for (size_t i = 0; i < mCacheFormatProperties.size(); i++) {
+        delete mCacheFormatProperties.valueAt(i);
+    }
+    mCacheFormatProperties.clear();
+}
+
+const CachedProperty* MyMtpDatabase::findCachedProperty(MtpObjectHandle handle,
+                                            MtpObjectProperty property) {
+    if (mCacheParent == 0)
+        return NULL;
+    if (systemTime(SYSTEM_TIME_MONOTONIC) - mCacheTime > kPropertyCacheTimeout) {
+        clearPropertyCache();
+        return NULL;
+    }
+
+    // only objects in the listed folder are cached
+    ssize_t lo = 0, hi = (ssize_t)mCacheHandles.size() - 1;
+    bool listed = false;
+    while (lo <= hi) {
+        ssize_t mid = (lo + hi) / 2;
+        if (mCacheHandles[mid] == handle) {
+            listed = true;
+            break;
+        }
+        if (mCacheHandles[mid] < handle) lo = mid + 1; else hi = mid - 1;
+    }
+    if (!listed)
+        return NULL;
+
+    if (mCacheFetched.indexOf(property) < 0) {
+        // fetch this property for every object in the folder at once
+        JNIEnv* env = AndroidRuntime::getJNIEnv();
+        jobject list = env->CallObjectMethod(mDatabase, method_getObjectPropertyList,
+                    (jlong)mCacheParent, 0, (jlong)property, 0, 1);
+        checkAndClearExceptionFromCallback(env, __FUNCTION__);
+        mCacheFetched.push(property);
+        if (!list)
+            return NULL;
+        if (env->GetIntField(list, field_mResult) == MTP_RESPONSE_OK) {
+            readPropertyList(env, list, mCacheValues);
+            mCacheValues.sort(compareCachedProperties);
+        }
+        env->DeleteLocalRef(list);
+    }
+
+    const uint64_t key = cachedPropertyKey(handle, property);
+    lo = 0;
+    hi = (ssize_t)mCacheValues.size() - 1;
+    while (lo <= hi) {
+        ssize_t mid = (lo + hi) / 2;
+        const CachedProperty& entry = mCacheValues[mid];
+        if (entry.key == key)
+            return &entry;
+        if (entry.key < key) lo = mid + 1; else hi = mid - 1;
+    }
+    return NULL;
+}
+
+// Answers a single object getObjectPropertyList() from the cache, if every
+// value it needs is there.
+bool MyMtpDatabase::getCachedPropertyList(MtpObjectHandle handle,
+                                            uint32_t property,
+                                            Vector<const CachedProperty*>& outList) {
+    if (property != 0xFFFFFFFF) {
+        const CachedProperty* entry = findCachedProperty(handle, property);
+        if (!entry)
+            return false;
+        outList.push(entry);
+        return true;
+    }
+
+    // all properties supported by the object's format
+    const CachedProperty* formatEntry = findCachedProperty(handle, MTP_PROPERTY_OBJECT_FORMAT);
+    if (!formatEntry)
+        return false;
+    MtpObjectFormat format = formatEntry->longValue;
+    ssize_t index = mCacheFormatProperties.indexOfKey(format);
+    MtpObjectPropertyList* properties;
+    if (index >= 0) {
+        properties = mCacheFormatProperties.valueAt(index);
+    } else {
+        properties = getSupportedObjectProperties(format);
+        if (!properties)
+            return false;
+        mCacheFormatProperties.add(format, properties);
+    }
+
+    // findCachedProperty() may add to mCacheValues, so look up all the
+    // values before keeping pointers to any of them
+    for (size_t i = 0; i < properties->size(); i++) {
+        if (!findCachedProperty(handle, (*properties)[i]))
+            return false;
+    }
+    for (size_t i = 0; i < properties->size(); i++) {
+        outList.push(findCachedProperty(handle, (*properties)[i]));
+    }
+    return true;
+}
+
 MtpObjectHandle MyMtpDatabase::beginSendObject(const char* path,
                                             MtpObjectFormat format,
                                             MtpObjectHandle parent,
                                             MtpStorageID storage,
                                             uint64_t size,
                                             time_t modified) {
+    clearPropertyCache();
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     jstring pathStr = env->NewStringUTF(path);
     MtpObjectHandle result = env->CallIntMethod(mDatabase, method_beginSendObject,
@@ -245,6 +499,7 @@ MtpObjectHandle MyMtpDatabase::beginSendObject(const char* path,
 
 void MyMtpDatabase::endSendObject(const char* path, MtpObjectHandle handle,
                                 MtpObjectFormat format, bool succeeded) {
+    clearPropertyCache();
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     jstring pathStr = env->NewStringUTF(path);
     env->CallVoidMethod(mDatabase, method_endSendObject, pathStr,
@@ -271,6 +526,16 @@ MtpObjectHandleList* MyMtpDatabase::getObjectList(MtpStorageID storageID,
     env->ReleaseIntArrayElements(array, handles, 0);
     env->DeleteLocalRef(array);
 
+    // Start caching properties for this folder's children, which is what the
+    // initiator asks for next when browsing. The root isn't a real object.
+    clearPropertyCache();
+    if (parent != 0 && parent != 0xFFFFFFFF && format == 0) {
+        mCacheParent = parent;
+        mCacheTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        mCacheHandles.appendVector(*list);
+        mCacheHandles.sort(compareHandles);
+    }
+
     checkAndClearExceptionFromCallback(env, __FUNCTION__);
     return list;
 }
@@ -361,6 +626,27 @@ MtpDevicePropertyList* MyMtpDatabase::getSupportedDeviceProperties() {
 MtpResponseCode MyMtpDatabase::getObjectPropertyValue(MtpObjectHandle handle,
                                             MtpObjectProperty property,
                                             MtpDataPacket& packet) {
+    const CachedProperty* cached = findCachedProperty(handle, property);
+    if (cached) {
+        // special case date properties, like below
+        if (property == MTP_PROPERTY_DATE_MODIFIED || property == MTP_PROPERTY_DATE_ADDED) {
+            char    date[20];
+            formatDateTime(cached->longValue, date, sizeof(date));
+            packet.putString(date);
+            return MTP_RESPONSE_OK;
+        }
+        if (property == MTP_PROPERTY_ORIGINAL_RELEASE_DATE) {
+            char    date[20];
+            snprintf(date, sizeof(date), "%04" PRId64 "0101T000000", (int64_t)cached->longValue);
+            packet.putString(date);
+            return MTP_RESPONSE_OK;
+        }
+        if (putPropertyValue(packet, *cached))
+            return MTP_RESPONSE_OK;
+        ALOGE("unsupported type in getObjectPropertyValue\n");
+        return MTP_RESPONSE_INVALID_OBJECT_PROP_FORMAT;
+    }
+
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     jobject list = env->CallObjectMethod(mDatabase, method_getObjectPropertyList,
                 (jlong)handle, 0, (jlong)property, 0, 0);
@@ -534,6 +820,7 @@ MtpResponseCode MyMtpDatabase::setObjectPropertyValue(MtpObjectHandle handle,
     if (!getObjectPropertyInfo(property, type))
         return MTP_RESPONSE_OBJECT_PROP_NOT_SUPPORTED;
 
+    clearPropertyCache();
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     jlong longValue = 0;
     jstring stringValue = NULL;
@@ -668,6 +955,22 @@ MtpResponseCode MyMtpDatabase::getObjectPropertyList(MtpObjectHandle handle,
                                             uint32_t format, uint32_t property,
                                             int groupCode, int depth,
                                             MtpDataPacket& packet) {
+    if (format == 0 && groupCode == 0 && depth == 0 && property != 0) {
+        Vector<const CachedProperty*> cachedList;
+        if (getCachedPropertyList(handle, property, cachedList)) {
+            packet.putUInt32(cachedList.size());
+            for (size_t i = 0; i < cachedList.size(); i++) {
+                const CachedProperty* entry = cachedList[i];
+                packet.putUInt32(entry->key >> 16);
+                packet.putUInt16(entry->key & 0xFFFF);
+                packet.putUInt16(entry->type);
+                if (!putPropertyValue(packet, *entry))
+                    ALOGE("bad or unsupported data type in MyMtpDatabase::getObjectPropertyList");
+            }
+            return MTP_RESPONSE_OK;
+        }
+    }
+
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     jobject list = env->CallObjectMethod(mDatabase, method_getObjectPropertyList,
                 (jlong)handle, (jint)format, (jlong)property, (jint)groupCode, (jint)depth);
@@ -901,6 +1204,7 @@ MtpResponseCode MyMtpDatabase::getObjectFilePath(MtpObjectHandle handle,
 }
 
 MtpResponseCode MyMtpDatabase::deleteFile(MtpObjectHandle handle) {
+    clearPropertyCache();
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     MtpResponseCode result = env->CallIntMethod(mDatabase, method_deleteFile, (jint)handle);
 
@@ -1132,12 +1436,14 @@ MtpProperty* MyMtpDatabase::getDevicePropertyDesc(MtpDeviceProperty property) {
 }
 
 void MyMtpDatabase::sessionStarted() {
+    clearPropertyCache();
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     env->CallVoidMethod(mDatabase, method_sessionStarted);
     checkAndClearExceptionFromCallback(env, __FUNCTION__);
 }
 
 void MyMtpDatabase::sessionEnded() {
+    clearPropertyCache();
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     env->CallVoidMethod(mDatabase, method_sessionEnded);
     checkAndClearExceptionFromCallback(env, __FUNCTION__);
@@ -17,7 +17,9 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "SoundPool"
 
+#include <errno.h>
 #include <inttypes.h>
+#include <unistd.h>
 
 #include <utils/Log.h>
 
@@ -65,6 +67,9 @@ SoundPool::SoundPool(int maxChannels, const audio_attributes_t* pAttributes)
     mAllocated = 0;
     mNextSampleID = 0;
     mNextChannelID = 0;
+    mStreamingThreshold = 0;
+    mMixer = NULL;
+    mMixEnabled = false;
 
     mCallback = 0;
     mUserData = 0;
@@ -85,6 +90,10 @@ SoundPool::~SoundPool()
     mDecodeThread->quit();
     quit();
 
+    // the mixer callback reads mChannelPool
+    delete mMixer;
+    mMixer = NULL;
+
     Mutex::Autolock lock(&mLock);
 
     mChannels.clear();
@@ -218,7 +227,7 @@ SoundChannel* SoundPool::findNextChannel(int channelID)
     return NULL;
 }
 
-int SoundPool::load(int fd, int64_t offset, int64_t length, int priority __unused)
+int SoundPool::load(int fd, int64_t offset, int64_t length, int priority)
 {
     ALOGV("load: fd=%d, offset=%" PRId64 ", length=%" PRId64 ", priority=%d",
             fd, offset, length, priority);
@@ -234,8 +243,9 @@ int SoundPool::load(int fd, int64_t offset, int64_t length, int priority __unuse
     // mDecodeThread->loadSample() may block on mDecodeThread message queue space;
     // the message queue emptying may block on SoundPool::findSample().
     //
-    // It theoretically possible that sample loads might decode out-of-order.
-    mDecodeThread->loadSample(sampleID);
+    // Queued loads are decoded highest priority first, and with more than one
+    // loader thread they may finish, and be reported, out of order.
+    mDecodeThread->loadSample(sampleID, priority);
     return sampleID;
 }
 
@@ -354,6 +364,9 @@ void SoundPool::autoPause()
         SoundChannel* channel = &mChannelPool[i];
         channel->autoPause();
     }
+    if (mMixer != NULL) {
+        mMixer->pause();
+    }
 }
 
 void SoundPool::resume(int channelID)
@@ -446,6 +459,55 @@ void SoundPool::done_l(SoundChannel* channel)
     }
 }
 
+void SoundPool::setStreamingThreshold(size_t threshold)
+{
+    Mutex::Autolock lock(&mLock);
+    mStreamingThreshold = threshold;
+}
+
+size_t SoundPool::streamingThreshold()
+{
+    Mutex::Autolock lock(&mLock);
+    return mStreamingThreshold;
+}
+
+void SoundPool::setLoaderThreadCount(int count)
+{
+    if (mDecodeThread != NULL) {
+        mDecodeThread->setThreadCount(count);
+    }
+}
+
+void SoundPool::setLowLatencyMixing(bool enabled)
+{
+    Mutex::Autolock lock(&mLock);
+    if (enabled && mMixer == NULL) {
+        SoundMixer* mixer = new SoundMixer(this);
+        if (mixer->init() != NO_ERROR) {
+            ALOGW("Unable to open the mixer track, playing sounds on their own tracks");
+            delete mixer;
+            return;
+        }
+        mMixer = mixer;
+    }
+    // channels already mixed keep playing on the mixer until they end
+    mMixEnabled = enabled && mMixer != NULL;
+}
+
+// called from AudioTrack callback thread, must not block on the decode queue
+bool SoundPool::requestStreamFill(SoundChannel* channel)
+{
+    return mDecodeThread->tryWrite(
+            SoundPoolMsg(SoundPoolMsg::FILL_STREAM, channel - mChannelPool));
+}
+
+void SoundPool::fillStream(int channelIndex)
+{
+    if (channelIndex >= 0 && channelIndex < mMaxChannels) {
+        mChannelPool[channelIndex].fillStream();
+    }
+}
+
 void SoundPool::setCallback(SoundPoolCallback* callback, void* user)
 {
     Mutex::Autolock lock(&mCallbackLock);
@@ -483,6 +545,7 @@ Sample::Sample(int sampleID, int fd, int64_t offset, int64_t length)
 void Sample::init()
 {
     mSize = 0;
+    mCompressedSize = 0;
     mRefCount = 0;
     mSampleID = 0;
     mState = UNLOADED;
@@ -502,7 +565,8 @@ Sample::~Sample()
 
 static status_t decode(int fd, int64_t offset, int64_t length,
         uint32_t *rate, int *numChannels, audio_format_t *audioFormat,
-        sp<MemoryHeapBase> heap, size_t *memsize) {
+        sp<MemoryHeapBase> heap, size_t *memsize,
+        size_t streamingThreshold, bool *tooLong) {
 
     ALOGV("fd %d, offset %" PRId64 ", size %" PRId64, fd, offset, length);
     AMediaExtractor *ex = AMediaExtractor_new();
@@ -594,6 +658,12 @@ static status_t decode(int fd, int64_t offset, int64_t length,
                         // there might be more data, but there's no space for it
                         sawOutputEOS = true;
                     }
+                    if (streamingThreshold > 0 && written >= streamingThreshold
+                            && !sawOutputEOS) {
+                        // long enough to stream instead, stop decoding
+                        *tooLong = true;
+                        sawOutputEOS = true;
+                    }
                 } else if (status == AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED) {
                     ALOGV("output buffers changed");
                 } else if (status == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
@@ -625,17 +695,49 @@ static status_t decode(int fd, int64_t offset, int64_t length,
     return UNKNOWN_ERROR;
 }
 
-status_t Sample::doLoad()
+// Copies the compressed data of a sample that is too long to keep as PCM.
+status_t Sample::loadCompressed()
+{
+    if (mLength <= 0 || (uint64_t) mLength > SIZE_MAX) {
+        return BAD_VALUE;
+    }
+    sp<MemoryHeapBase> heap = new MemoryHeapBase(mLength, 0, "SoundPool compressed sample");
+    if (heap->getHeapID() < 0) {
+        return NO_MEMORY;
+    }
+
+    uint8_t* dst = static_cast<uint8_t*>(heap->getBase());
+    size_t done = 0;
+    while (done < (size_t) mLength) {
+        ssize_t count = pread(mFd, dst + done, mLength - done, mOffset + done);
+        if (count <= 0) {
+            ALOGE("Unable to read compressed sample: %s", count < 0 ? strerror(errno) : "EOF");
+            return UNKNOWN_ERROR;
+        }
+        done += count;
+    }
+
+    mCompressed = heap;
+    mCompressedSize = done;
+    return NO_ERROR;
+}
+
+status_t Sample::doLoad(size_t streamingThreshold)
 {
     uint32_t sampleRate;
     int numChannels;
     audio_format_t format;
     status_t status;
+    bool tooLong = false;
     mHeap = new MemoryHeapBase(kDefaultHeapSize);
 
     ALOGV("Start decode");
     status = decode(mFd, mOffset, mLength, &sampleRate, &numChannels, &format,
-                                 mHeap, &mSize);
+                                 mHeap, &mSize, streamingThreshold, &tooLong);
+    if (status == NO_ERROR && tooLong) {
+        ALOGV("Streaming sample %d", mSampleID);
+        status = loadCompressed();
+    }
     ALOGV("close(%d)", mFd);
     ::close(mFd);
     mFd = -1;
@@ -658,7 +760,13 @@ status_t Sample::doLoad()
         goto error;
     }
 
-    mData = new MemoryBase(mHeap, 0, mSize);
+    if (mCompressed != 0) {
+        // only the compressed data is kept, decoded again when played
+        mHeap.clear();
+        mSize = 0;
+    } else {
+        mData = new MemoryBase(mHeap, 0, mSize);
+    }
     mSampleRate = sampleRate;
     mNumChannels = numChannels;
     mFormat = format;
@@ -667,9 +775,218 @@ status_t Sample::doLoad()
 
 error:
     mHeap.clear();
+    mCompressed.clear();
     return status;
 }
 
+SampleStream::SampleStream(const sp<Sample>& sample, int loop) :
+    mSample(sample), mExtractor(NULL), mCodec(NULL), mStarted(false),
+    mInputEOS(false), mOutputIndex(-1), mOutputOffset(0), mOutputSize(0),
+    mOutputEOS(false), mFillRequested(0), mBuffer(new uint8_t[kBufferSize]),
+    mReadPos(0), mWritePos(0), mLoop(loop), mDone(false)
+{
+}
+
+SampleStream::~SampleStream()
+{
+    if (mCodec != NULL) {
+        if (mOutputIndex >= 0) {
+            AMediaCodec_releaseOutputBuffer(mCodec, mOutputIndex, false /* render */);
+        }
+        AMediaCodec_stop(mCodec);
+        AMediaCodec_delete(mCodec);
+    }
+    if (mExtractor != NULL) {
+        AMediaExtractor_delete(mExtractor);
+    }
+    delete[] mBuffer;
+}
+
+void SampleStream::setLoop(int loop)
+{
+    Mutex::Autolock lock(&mLock);
+    mLoop = loop;
+}
+
+status_t SampleStream::start()
+{
+    mExtractor = AMediaExtractor_new();
+    if (AMediaExtractor_setDataSourceFd(mExtractor, mSample->compressed()->getHeapID(),
+            0, mSample->compressedSize()) != AMEDIA_OK) {
+        return UNKNOWN_ERROR;
+    }
+
+    size_t numTracks = AMediaExtractor_getTrackCount(mExtractor);
+    for (size_t i = 0; i < numTracks; i++) {
+        AMediaFormat *format = AMediaExtractor_getTrackFormat(mExtractor, i);
+        const char *mime;
+        if (!AMediaFormat_getString(format, AMEDIAFORMAT_KEY_MIME, &mime)) {
+            AMediaFormat_delete(format);
+            return UNKNOWN_ERROR;
+        }
+        if (strncmp(mime, "audio/", 6) == 0) {
+            mCodec = AMediaCodec_createDecoderByType(mime);
+            status_t status = UNKNOWN_ERROR;
+            if (mCodec != NULL
+                    && AMediaCodec_configure(mCodec, format,
+                            NULL /* window */, NULL /* drm */, 0 /* flags */) == AMEDIA_OK
+                    && AMediaCodec_start(mCodec) == AMEDIA_OK
+                    && AMediaExtractor_selectTrack(mExtractor, i) == AMEDIA_OK) {
+                status = NO_ERROR;
+            }
+            AMediaFormat_delete(format);
+            return status;
+        }
+        AMediaFormat_delete(format);
+    }
+    return UNKNOWN_ERROR;
+}
+
+void SampleStream::queueInput()
+{
+    ssize_t bufidx = AMediaCodec_dequeueInputBuffer(mCodec, 0);
+    if (bufidx < 0) {
+        return;
+    }
+    size_t bufsize;
+    uint8_t *buf = AMediaCodec_getInputBuffer(mCodec, bufidx, &bufsize);
+    int sampleSize = AMediaExtractor_readSampleData(mExtractor, buf, bufsize);
+    if (sampleSize < 0) {
+        sampleSize = 0;
+        mInputEOS = true;
+    }
+    int64_t presentationTimeUs = AMediaExtractor_getSampleTime(mExtractor);
+    AMediaCodec_queueInputBuffer(mCodec, bufidx,
+            0 /* offset */, sampleSize, presentationTimeUs,
+            mInputEOS ? AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM : 0);
+    AMediaExtractor_advance(mExtractor);
+}
+
+// start over if there are loops left, returns false at the end of the sample
+bool SampleStream::rewind()
+{
+    {
+        Mutex::Autolock lock(&mLock);
+        if (mLoop == 0) {
+            return false;
+        }
+        if (mLoop > 0) {
+            mLoop--;
+        }
+    }
+    if (AMediaExtractor_seekTo(mExtractor, 0, AMEDIAEXTRACTOR_SEEK_CLOSEST_SYNC) != AMEDIA_OK
+            || AMediaCodec_flush(mCodec) != AMEDIA_OK) {
+        return false;
+    }
+    mInputEOS = false;
+    mOutputEOS = false;
+    return true;
+}
+
+void SampleStream::fill()
+{
+    Mutex::Autolock fillLock(&mFillLock);
+
+    // let the callback ask again while we decode
+    cancelFillRequest();
+
+    if (!mStarted) {
+        mStarted = true;
+        if (start() != NO_ERROR) {
+            ALOGE("Unable to start decoding sample %d", mSample->sampleID());
+            Mutex::Autolock lock(&mLock);
+            mDone = true;
+            return;
+        }
+    }
+
+    for (;;) {
+        if (mOutputIndex >= 0) {
+            uint8_t *buf = AMediaCodec_getOutputBuffer(mCodec, mOutputIndex, NULL /* out_size */);
+            {
+                Mutex::Autolock lock(&mLock);
+                size_t count = kBufferSize - (mWritePos - mReadPos);
+                if (count > mOutputSize) {
+                    count = mOutputSize;
+                }
+                size_t pos = mWritePos % kBufferSize;
+                size_t first = count < kBufferSize - pos ? count : kBufferSize - pos;
+                memcpy(mBuffer + pos, buf + mOutputOffset, first);
+                memcpy(mBuffer, buf + mOutputOffset + first, count - first);
+                mWritePos += count;
+                mOutputOffset += count;
+                mOutputSize -= count;
+            }
+            if (mOutputSize > 0) {
+                // the ring buffer is full
+                return;
+            }
+            AMediaCodec_releaseOutputBuffer(mCodec, mOutputIndex, false /* render */);
+            mOutputIndex = -1;
+            if (mOutputEOS && !rewind()) {
+                Mutex::Autolock lock(&mLock);
+                mDone = true;
+                return;
+            }
+            continue;
+        }
+
+        {
+            Mutex::Autolock lock(&mLock);
+            if (mWritePos - mReadPos == kBufferSize) {
+                return;
+            }
+        }
+
+        if (!mInputEOS) {
+            queueInput();
+        }
+
+        AMediaCodecBufferInfo info;
+        ssize_t status = AMediaCodec_dequeueOutputBuffer(mCodec, &info, 1000);
+        if (status >= 0) {
+            mOutputIndex = status;
+            mOutputOffset = info.offset;
+            mOutputSize = info.size;
+            mOutputEOS = (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) != 0;
+        } else if (status != AMEDIACODEC_INFO_TRY_AGAIN_LATER
+                && status != AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED
+                && status != AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+            ALOGE("Decoding sample %d failed: %zd", mSample->sampleID(), status);
+            Mutex::Autolock lock(&mLock);
+            mDone = true;
+            return;
+        }
+    }
+}
+
+size_t SampleStream::read(uint8_t* buffer, size_t size)
+{
+    Mutex::Autolock lock(&mLock);
+    size_t count = mWritePos - mReadPos;
+    if (count > size) {
+        count = size;
+    }
+    size_t pos = mReadPos % kBufferSize;
+    size_t first = count < kBufferSize - pos ? count : kBufferSize - pos;
+    memcpy(buffer, mBuffer + pos, first);
+    memcpy(buffer + first, mBuffer, count - first);
+    mReadPos += count;
+    return count;
+}
+
+bool SampleStream::needsFill()
+{
+    Mutex::Autolock lock(&mLock);
+    return !mDone && (kBufferSize - (mWritePos - mReadPos)) >= kBufferSize / 2;
+}
+
+bool SampleStream::finished()
+{
+    Mutex::Autolock lock(&mLock);
+    return mDone && mWritePos == mReadPos;
+}
+
 
 void SoundChannel::init(SoundPool* soundPool)
 {
@@ -701,6 +1018,17 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
             return;
         }
 
+        SoundMixer* mixer = mSoundPool->mixer_l();
+        if (mixer != NULL && mixer->canMix(sample)) {
+            // release any track of our own outside of the lock
+            oldTrack = mAudioTrack;
+            mAudioTrack.clear();
+            playMixed_l(mixer, sample, nextChannelID, leftVolume, rightVolume,
+                    priority, loop, rate);
+            goto exit;
+        }
+        mMixed = false;
+
         // initialize track
         size_t afFrameCount;
         uint32_t afSampleRate;
@@ -749,6 +1077,17 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
             audio_channel_mask_t channelMask = audio_channel_out_mask_from_count(numChannels);
 
             // do not create a new audio track if current track is compatible with sample parameters
+            if (sample->isStreaming()) {
+                // streamed samples are pulled through the callback from the
+                // SampleStream ring buffer
+                size_t streamFrames = (kDefaultBufferCount * afFrameCount * sampleRate)
+                        / afSampleRate;
+                newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
+                        channelMask, streamFrames, AUDIO_OUTPUT_FLAG_NONE, callback, userData,
+                        0 /*default notification frames*/, AUDIO_SESSION_ALLOCATE,
+                        AudioTrack::TRANSFER_DEFAULT,
+                        NULL /*offloadInfo*/, -1 /*uid*/, -1 /*pid*/, mSoundPool->attributes());
+            } else {
     #ifdef USE_SHARED_MEM_BUFFER
             newTrack = new AudioTrack(streamType, sampleRate, sample->format(),
                     channelMask, sample->getIMemory(), AUDIO_OUTPUT_FLAG_FAST, callback, userData,
@@ -762,6 +1101,7 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
                     bufferFrames, AUDIO_SESSION_ALLOCATE, AudioTrack::TRANSFER_DEFAULT,
                     NULL /*offloadInfo*/, -1 /*uid*/, -1 /*pid*/, mSoundPool->attributes());
     #endif
+            }
             oldTrack = mAudioTrack;
             status = newTrack->initCheck();
             if (status != NO_ERROR) {
@@ -775,7 +1115,13 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
             ALOGV("using new track %p for sample %d", newTrack.get(), sample->sampleID());
         }
         newTrack->setVolume(leftVolume, rightVolume);
-        newTrack->setLoop(0, frameCount, loop);
+        if (sample->isStreaming()) {
+            // SampleStream does the looping
+            mStream = new SampleStream(sample, loop);
+        } else {
+            mStream.clear();
+            newTrack->setLoop(0, frameCount, loop);
+        }
         mPos = 0;
         mSample = sample;
         mChannelID = nextChannelID;
@@ -787,6 +1133,9 @@ void SoundChannel::play(const sp<Sample>& sample, int nextChannelID, float leftV
         mRate = rate;
         clearNextEvent();
         mState = PLAYING;
+        if (mStream != 0) {
+            requestFill_l();
+        }
         mAudioTrack->start();
         mAudioBufferSize = newTrack->frameCount()*newTrack->frameSize();
     }
@@ -798,6 +1147,101 @@ exit:
     }
 }
 
+// call with lock held
+void SoundChannel::playMixed_l(SoundMixer* mixer, const sp<Sample>& sample, int nextChannelID,
+        float leftVolume, float rightVolume, int priority, int loop, float rate)
+{
+    const size_t frameSize = sample->numChannels() *
+            ((sample->format() == AUDIO_FORMAT_PCM_16_BIT) ? sizeof(int16_t) : sizeof(uint8_t));
+    uint32_t sampleRate = uint32_t(float(sample->sampleRate()) * rate + 0.5);
+
+    // From now on, callbacks from a track this channel used before are ignored.
+    mToggle ^= 1;
+    mStream.clear();
+    mMixed = true;
+    mMixEnded = false;
+    mMixPos = 0;
+    mMixOutputRate = mixer->sampleRate();
+    mMixStep = (uint64_t(sampleRate) << 32) / mMixOutputRate;
+    mMixFrames = sample->size() / frameSize;
+    mMixLoop = loop;
+    mPos = 0;
+    mSample = sample;
+    mChannelID = nextChannelID;
+    mPriority = priority;
+    mLoop = loop;
+    mLeftVolume = leftVolume;
+    mRightVolume = rightVolume;
+    mNumChannels = sample->numChannels();
+    mRate = rate;
+    clearNextEvent();
+    mState = PLAYING;
+    mixer->wake();
+    ALOGV("mixing sample %d on channel %d", sample->sampleID(), nextChannelID);
+}
+
+static inline int32_t readMixFrame(const uint8_t* data, bool is16Bit, int numChannels,
+        size_t frame, int channel)
+{
+    size_t index = frame * numChannels + (numChannels > 1 ? channel : 0);
+    if (is16Bit) {
+        return ((const int16_t*) data)[index];
+    }
+    return (int32_t(data[index]) - 128) << 8;
+}
+
+// Adds frameCount frames of this channel, resampled to the mixer rate with
+// linear interpolation and scaled by the channel volume, to the stereo
+// accumulator at out. Returns false if the channel isn't being mixed.
+bool SoundChannel::mix(int32_t* out, size_t frameCount)
+{
+    Mutex::Autolock lock(&mLock);
+    if (!mMixed || mMixEnded || mState != PLAYING || mSample == 0 || mMixFrames == 0) {
+        return false;
+    }
+
+    const uint8_t* data = mSample->data();
+    const bool is16Bit = mSample->format() == AUDIO_FORMAT_PCM_16_BIT;
+    const int numChannels = mNumChannels;
+    // volumes in Q12
+    const int32_t leftVolume = int32_t(mLeftVolume * 4096.0f + 0.5f);
+    const int32_t rightVolume = int32_t(mRightVolume * 4096.0f + 0.5f);
+
+    for (size_t i = 0; i < frameCount; i++) {
+        size_t frame = size_t(mMixPos >> 32);
+        if (frame >= mMixFrames) {
+            if (mMixLoop == 0) {
+                ALOGV("mix %p channel %d end of sample", this, mChannelID);
+                mMixEnded = true;
+                mSoundPool->addToStopList(this);
+                return true;
+            }
+            if (mMixLoop > 0) {
+                mMixLoop--;
+            }
+            mMixPos -= uint64_t(mMixFrames) << 32;
+            frame = size_t(mMixPos >> 32);
+        }
+        size_t next = frame + 1;
+        if (next >= mMixFrames) {
+            next = mMixLoop != 0 ? 0 : frame;
+        }
+        const int32_t fraction = int32_t((mMixPos >> 16) & 0xffff);
+
+        int32_t l0 = readMixFrame(data, is16Bit, numChannels, frame, 0);
+        int32_t l1 = readMixFrame(data, is16Bit, numChannels, next, 0);
+        int32_t r0 = readMixFrame(data, is16Bit, numChannels, frame, 1);
+        int32_t r1 = readMixFrame(data, is16Bit, numChannels, next, 1);
+        int32_t left = l0 + (((l1 - l0) * fraction) >> 16);
+        int32_t right = r0 + (((r1 - r0) * fraction) >> 16);
+
+        out[2 * i] += (left * leftVolume) >> 12;
+        out[2 * i + 1] += (right * rightVolume) >> 12;
+        mMixPos += mMixStep;
+    }
+    return true;
+}
+
 void SoundChannel::nextEvent()
 {
     sp<Sample> sample;
@@ -869,7 +1313,23 @@ void SoundChannel::process(int event, void *info, unsigned long toggle)
             return;
         }
 
-        if (sample != 0) {
+        if (sample != 0 && mStream != 0) {
+            uint8_t* q = (uint8_t*) b->i8;
+            size_t count = mStream->read(q, b->size);
+            if (count == 0 && mStream->finished() && mPos < mAudioBufferSize) {
+                // pad with silence so that the end of the stream is played out
+                count = mAudioBufferSize - mPos;
+                if (count > b->size) {
+                    count = b->size;
+                }
+                memset(q, 0, count);
+                mPos += count;
+            }
+            if (mStream->needsFill()) {
+                requestFill_l();
+            }
+            b->size = count;
+        } else if (sample != 0) {
             // fill buffer
             uint8_t* q = (uint8_t*) b->i8;
             size_t count = 0;
@@ -896,6 +1356,9 @@ void SoundChannel::process(int event, void *info, unsigned long toggle)
             b->size = count;
             //ALOGV("buffer=%p, [0]=%d", b->i16, b->i16[0]);
         }
+    } else if (event == AudioTrack::EVENT_UNDERRUN && mStream != 0 && !mStream->finished()) {
+        // the decoder fell behind, not the end of the sample
+        ALOGV("process %p channel %d stream underrun", this, mChannelID);
     } else if (event == AudioTrack::EVENT_UNDERRUN || event == AudioTrack::EVENT_BUFFER_END) {
         ALOGV("process %p channel %d event %s",
               this, mChannelID, (event == AudioTrack::EVENT_UNDERRUN) ? "UNDERRUN" :
@@ -911,15 +1374,41 @@ void SoundChannel::process(int event, void *info, unsigned long toggle)
 }
 
 
+// call with lock held
+void SoundChannel::requestFill_l()
+{
+    if (mStream->startFillRequest() && !mSoundPool->requestStreamFill(this)) {
+        // the decode queue is full; try again on the next callback
+        mStream->cancelFillRequest();
+    }
+}
+
+// called from SoundPoolThread
+void SoundChannel::fillStream()
+{
+    sp<SampleStream> stream;
+    {
+        Mutex::Autolock lock(&mLock);
+        stream = mStream;
+    }
+    // decode without the lock, so that the callback can keep draining
+    if (stream != 0) {
+        stream->fill();
+    }
+}
+
 // call with lock held
 bool SoundChannel::doStop_l()
 {
     if (mState != IDLE) {
         setVolume_l(0, 0);
         ALOGV("stop");
-        mAudioTrack->stop();
+        if (!mMixed) {
+            mAudioTrack->stop();
+        }
         mPrevSampleID = mSample->sampleID();
         mSample.clear();
+        mStream.clear();
         mState = IDLE;
         mPriority = IDLE_PRIORITY;
         return true;
@@ -956,7 +1445,9 @@ void SoundChannel::pause()
     if (mState == PLAYING) {
         ALOGV("pause track");
         mState = PAUSED;
-        mAudioTrack->pause();
+        if (!mMixed) {
+            mAudioTrack->pause();
+        }
     }
 }
 
@@ -967,7 +1458,9 @@ void SoundChannel::autoPause()
         ALOGV("pause track");
         mState = PAUSED;
         mAutoPaused = true;
-        mAudioTrack->pause();
+        if (!mMixed) {
+            mAudioTrack->pause();
+        }
     }
 }
 
@@ -978,7 +1471,11 @@ void SoundChannel::resume()
         ALOGV("resume track");
         mState = PLAYING;
         mAutoPaused = false;
-        mAudioTrack->start();
+        if (!mMixed) {
+            mAudioTrack->start();
+        } else {
+            mSoundPool->mMixer->wake();
+        }
     }
 }
 
@@ -989,14 +1486,22 @@ void SoundChannel::autoResume()
         ALOGV("resume track");
         mState = PLAYING;
         mAutoPaused = false;
-        mAudioTrack->start();
+        if (!mMixed) {
+            mAudioTrack->start();
+        } else {
+            mSoundPool->mMixer->wake();
+        }
     }
 }
 
 void SoundChannel::setRate(float rate)
 {
     Mutex::Autolock lock(&mLock);
-    if (mAudioTrack != NULL && mSample != 0) {
+    if (mMixed && mSample != 0) {
+        uint32_t sampleRate = uint32_t(float(mSample->sampleRate()) * rate + 0.5);
+        mMixStep = (uint64_t(sampleRate) << 32) / mMixOutputRate;
+        mRate = rate;
+    } else if (mAudioTrack != NULL && mSample != 0) {
         uint32_t sampleRate = uint32_t(float(mSample->sampleRate()) * rate + 0.5);
         mAudioTrack->setSampleRate(sampleRate);
         mRate = rate;
@@ -1021,7 +1526,13 @@ void SoundChannel::setVolume(float leftVolume, float rightVolume)
 void SoundChannel::setLoop(int loop)
 {
     Mutex::Autolock lock(&mLock);
-    if (mAudioTrack != NULL && mSample != 0) {
+    if (mStream != 0) {
+        mStream->setLoop(loop);
+        mLoop = loop;
+    } else if (mMixed) {
+        mMixLoop = loop;
+        mLoop = loop;
+    } else if (mAudioTrack != NULL && mSample != 0) {
         uint32_t loopEnd = mSample->size()/mNumChannels/
             ((mSample->format() == AUDIO_FORMAT_PCM_16_BIT) ? sizeof(int16_t) : sizeof(uint8_t));
         mAudioTrack->setLoop(0, loopEnd, loop);
@@ -1048,6 +1559,124 @@ void SoundChannel::dump()
             mState, mChannelID, mNumChannels, mPos, mPriority, mLoop);
 }
 
+SoundMixer::SoundMixer(SoundPool* soundPool) :
+    mSoundPool(soundPool), mSampleRate(kDefaultSampleRate), mRunning(false), mIdleFrames(0)
+{
+}
+
+SoundMixer::~SoundMixer()
+{
+    if (mAudioTrack != 0) {
+        mAudioTrack->stop();
+    }
+    // waits for the callback thread to exit
+    mAudioTrack.clear();
+}
+
+status_t SoundMixer::init()
+{
+    audio_stream_type_t streamType = audio_attributes_to_stream_type(mSoundPool->attributes());
+    if (AudioSystem::getOutputSamplingRate(&mSampleRate, streamType) != NO_ERROR) {
+        mSampleRate = kDefaultSampleRate;
+    }
+
+    // mix at the output rate so AudioFlinger can keep the track on the fast path
+    sp<AudioTrack> track = new AudioTrack(streamType, mSampleRate, AUDIO_FORMAT_PCM_16_BIT,
+            AUDIO_CHANNEL_OUT_STEREO, 0 /*default frame count*/, AUDIO_OUTPUT_FLAG_FAST,
+            callback, this, 0 /*default notification frames*/, AUDIO_SESSION_ALLOCATE,
+            AudioTrack::TRANSFER_CALLBACK,
+            NULL /*offloadInfo*/, -1 /*uid*/, -1 /*pid*/, mSoundPool->attributes());
+    status_t status = track->initCheck();
+    if (status != NO_ERROR) {
+        ALOGE("Error creating mixer AudioTrack");
+        return status;
+    }
+    mAudioTrack = track;
+    return NO_ERROR;
+}
+
+// called with the lock of the channel that starts mixing held
+void SoundMixer::wake()
+{
+    Mutex::Autolock lock(&mLock);
+    mIdleFrames = 0;
+    if (!mRunning && mAudioTrack != 0) {
+        ALOGV("starting the mixer track");
+        if (mAudioTrack->start() == NO_ERROR) {
+            mRunning = true;
+        }
+    }
+}
+
+void SoundMixer::pause()
+{
+    Mutex::Autolock lock(&mLock);
+    if (mRunning) {
+        mAudioTrack->pause();
+        mRunning = false;
+    }
+}
+
+bool SoundMixer::canMix(const sp<Sample>& sample)
+{
+    const audio_format_t format = sample->format();
+    return mAudioTrack != 0 && !sample->isStreaming()
+            && (format == AUDIO_FORMAT_PCM_16_BIT || format == AUDIO_FORMAT_PCM_8_BIT)
+            && sample->numChannels() >= 1 && sample->numChannels() <= 2;
+}
+
+void SoundMixer::callback(int event, void* user, void *info)
+{
+    static_cast<SoundMixer*>(user)->process(event, info);
+}
+
+void SoundMixer::process(int event, void *info)
+{
+    if (event != AudioTrack::EVENT_MORE_DATA) {
+        // the mixer track never ends, an underrun only means nothing was playing
+        return;
+    }
+
+    AudioTrack::Buffer* b = static_cast<AudioTrack::Buffer *>(info);
+    int16_t* out = b->i16;
+    size_t frames = b->size / (2 * sizeof(int16_t));
+    const size_t totalFrames = frames;
+    bool active = false;
+    while (frames > 0) {
+        size_t count = frames < kMixFrames ? frames : kMixFrames;
+        memset(mMixBuffer, 0, count * 2 * sizeof(int32_t));
+        for (int i = 0; i < mSoundPool->mMaxChannels; ++i) {
+            active |= mSoundPool->mChannelPool[i].mix(mMixBuffer, count);
+        }
+        for (size_t i = 0; i < count * 2; i++) {
+            int32_t value = mMixBuffer[i];
+            if (value > 32767) {
+                value = 32767;
+            } else if (value < -32768) {
+                value = -32768;
+            }
+            *out++ = int16_t(value);
+        }
+        frames -= count;
+    }
+    b->size = (uint8_t*) out - (uint8_t*) b->i16;
+
+    // Don't keep a fast track, and the mixer thread, running on silence.
+    // The lock is taken after mixing, so a channel that starts mixing
+    // meanwhile resets the idle time before the track can be paused.
+    Mutex::Autolock lock(&mLock);
+    if (active) {
+        mIdleFrames = 0;
+    } else {
+        mIdleFrames += totalFrames;
+        if (mRunning && mIdleFrames >= size_t(mSampleRate) * kIdleTimeoutMs / 1000) {
+            ALOGV("pausing the idle mixer track");
+            mAudioTrack->pause();
+            mRunning = false;
+        }
+    }
+}
+
 void SoundEvent::set(const sp<Sample>& sample, int channelID, float leftVolume,
             float rightVolume, int priority, int loop, float rate)
 {
@@ -17,6 +17,7 @@
 #ifndef SOUNDPOOL_H_
 #define SOUNDPOOL_H_
 
+#include <cutils/atomic.h>
 #include <utils/threads.h>
 #include <utils/List.h>
 #include <utils/Vector.h>
@@ -25,6 +26,9 @@
 #include <binder/MemoryHeapBase.h>
 #include <binder/MemoryBase.h>
 
+struct AMediaCodec;
+struct AMediaExtractor;
+
 namespace android {
 
 static const int IDLE_PRIORITY = -1;
@@ -33,6 +37,7 @@ static const int IDLE_PRIORITY = -1;
 class SoundEvent;
 class SoundPoolThread;
 class SoundPool;
+class SoundMixer;
 
 // for queued events
 class SoundPoolEvent {
@@ -61,12 +66,17 @@ public:
     size_t size() { return mSize; }
     int state() { return mState; }
     uint8_t* data() { return static_cast<uint8_t*>(mData->pointer()); }
-    status_t doLoad();
+    status_t doLoad(size_t streamingThreshold);
     void startLoad() { mState = LOADING; }
     sp<IMemory> getIMemory() { return mData; }
+    // streamed samples keep their compressed data and have no PCM
+    bool isStreaming() { return mCompressed != 0; }
+    sp<MemoryHeapBase> compressed() { return mCompressed; }
+    size_t compressedSize() { return mCompressedSize; }
 
 private:
     void init();
+    status_t loadCompressed();
 
     size_t              mSize;
     volatile int32_t    mRefCount;
@@ -80,6 +90,55 @@ private:
     int64_t             mLength;
     sp<IMemory>         mData;
     sp<MemoryHeapBase>  mHeap;
+    sp<MemoryHeapBase>  mCompressed;
+    size_t              mCompressedSize;
+};
+
+// Decodes a streamed Sample on SoundPoolThread into a ring buffer, which the
+// AudioTrack callback of the SoundChannel playing it drains.
+class SampleStream : public RefBase {
+public:
+    SampleStream(const sp<Sample>& sample, int loop);
+    ~SampleStream();
+    void setLoop(int loop);
+
+    // called from SoundPoolThread; serialized, as several workers may
+    // pick up fill requests for the same stream
+    void fill();
+
+    // called from the AudioTrack callback thread
+    size_t read(uint8_t* buffer, size_t size);
+    bool needsFill();
+    bool finished();
+    bool startFillRequest() { return android_atomic_cmpxchg(0, 1, &mFillRequested) == 0; }
+    void cancelFillRequest() { android_atomic_release_store(0, &mFillRequested); }
+
+private:
+    static const size_t kBufferSize = 128 * 1024;
+
+    status_t start();
+    void queueInput();
+    bool rewind();
+
+    sp<Sample>          mSample;
+    AMediaExtractor*    mExtractor;
+    AMediaCodec*        mCodec;
+    bool                mStarted;
+    bool                mInputEOS;
+    ssize_t             mOutputIndex;
+    size_t              mOutputOffset;
+    size_t              mOutputSize;
+    bool                mOutputEOS;
+    volatile int32_t    mFillRequested;
+    Mutex               mFillLock;
+
+    // the ring buffer, and the state shared with the callback thread
+    Mutex               mLock;
+    uint8_t*            mBuffer;
+    size_t              mReadPos;
+    size_t              mWritePos;
+    int                 mLoop;
+    bool                mDone;
 };
 
 // stores pending events for stolen channels
@@ -114,7 +173,7 @@ class SoundChannel : public SoundEvent {
 public:
     enum state { IDLE, RESUMING, STOPPING, PAUSED, PLAYING };
     SoundChannel() : mState(IDLE), mNumChannels(1),
-            mPos(0), mToggle(0), mAutoPaused(false) {}
+            mPos(0), mToggle(0), mAutoPaused(false), mMixed(false) {}
     ~SoundChannel();
     void init(SoundPool* soundPool);
     void play(const sp<Sample>& sample, int channelID, float leftVolume, float rightVolume,
@@ -137,15 +196,23 @@ public:
     int nextChannelID() { return mNextEvent.channelID(); }
     void dump();
     int getPrevSampleID(void) { return mPrevSampleID; }
+    void fillStream();
+
+    // called from the SoundMixer callback
+    bool mix(int32_t* out, size_t frameCount);
 
 private:
     static void callback(int event, void* user, void *info);
     void process(int event, void *info, unsigned long toggle);
     bool doStop_l();
+    void requestFill_l();
+    void playMixed_l(SoundMixer* mixer, const sp<Sample>& sample, int nextChannelID,
+            float leftVolume, float rightVolume, int priority, int loop, float rate);
 
     SoundPool*          mSoundPool;
     sp<AudioTrack>      mAudioTrack;
     SoundEvent          mNextEvent;
+    sp<SampleStream>    mStream;
     Mutex               mLock;
     int                 mState;
     int                 mNumChannels;
@@ -154,12 +221,53 @@ private:
     unsigned long       mToggle;
     bool                mAutoPaused;
     int                 mPrevSampleID;
+
+    // state of a channel mixed into the SoundMixer track instead of its own
+    bool                mMixed;
+    bool                mMixEnded;
+    uint64_t            mMixPos;    // 32.32 fixed point frame position
+    uint64_t            mMixStep;   // 32.32 frames advanced per output frame
+    uint32_t            mMixOutputRate;
+    size_t              mMixFrames;
+    int                 mMixLoop;
+};
+
+// Mixes the channels of a SoundPool into a single fast AudioTrack, so that
+// playing a sound does not create a track or a callback thread of its own.
+class SoundMixer {
+public:
+    SoundMixer(SoundPool* soundPool);
+    ~SoundMixer();
+    // opens the mixer track, which is only started while channels are mixed
+    status_t init();
+    // starts the track if it was paused, for a channel that starts mixing
+    void wake();
+    void pause();
+    bool canMix(const sp<Sample>& sample);
+    uint32_t sampleRate() { return mSampleRate; }
+
+private:
+    static const size_t kMixFrames = 256;
+    // the track is paused after mixing nothing for this long
+    static const uint32_t kIdleTimeoutMs = 500;
+
+    static void callback(int event, void* user, void *info);
+    void process(int event, void *info);
+
+    SoundPool*          mSoundPool;
+    sp<AudioTrack>      mAudioTrack;
+    uint32_t            mSampleRate;
+    Mutex               mLock;
+    bool                mRunning;
+    size_t              mIdleFrames;
+    int32_t             mMixBuffer[kMixFrames * 2];
 };
 
 // application object for managing a pool of sounds
 class SoundPool {
     friend class SoundPoolThread;
     friend class SoundChannel;
+    friend class SoundMixer;
 public:
     SoundPool(int maxChannels, const audio_attributes_t* pAttributes);
     ~SoundPool();
@@ -178,12 +286,23 @@ public:
     void setRate(int channelID, float rate);
     const audio_attributes_t* attributes() { return &mAttributes; }
 
+    // samples that decode to more than this many bytes of PCM are stored
+    // compressed and decoded while they play; 0 disables streaming
+    void setStreamingThreshold(size_t threshold);
+    size_t streamingThreshold();
+    // number of threads decoding samples concurrently, 1 by default
+    void setLoaderThreadCount(int count);
+    // mix subsequently played PCM samples into one shared fast track
+    void setLowLatencyMixing(bool enabled);
+
     // called from SoundPoolThread
     void sampleLoaded(int sampleID);
     sp<Sample> findSample(int sampleID);
+    void fillStream(int channelIndex);
 
     // called from AudioTrack thread
     void done_l(SoundChannel* channel);
+    bool requestStreamFill(SoundChannel* channel);
 
     // callback function
     void setCallback(SoundPoolCallback* callback, void* user);
@@ -197,6 +316,7 @@ private:
     SoundChannel* findNextChannel (int channelID);
     SoundChannel* allocateChannel_l(int priority, int sampleID);
     void moveToFront_l(SoundChannel* channel);
+    SoundMixer* mixer_l() { return mMixEnabled ? mMixer : NULL; }
     void notify(SoundPoolEvent event);
     void dump();
 
@@ -222,6 +342,9 @@ private:
     int                     mNextSampleID;
     int                     mNextChannelID;
     bool                    mQuit;
+    size_t                  mStreamingThreshold;
+    SoundMixer*             mMixer;
+    bool                    mMixEnabled;
 
     // callback
     Mutex                   mCallbackLock;
@@ -31,39 +31,116 @@ void SoundPoolThread::write(SoundPoolMsg msg) {
     // if thread is quitting, don't add to queue
     if (mRunning) {
         mMsgQueue.push(msg);
-        mCondition.signal();
+        mCondition.broadcast();
     }
 }
 
+bool SoundPoolThread::tryWrite(SoundPoolMsg msg) {
+    Mutex::Autolock lock(&mLock);
+    if (!mRunning || mMsgQueue.size() >= maxMessages) {
+        return false;
+    }
+    mMsgQueue.push(msg);
+    mCondition.broadcast();
+    return true;
+}
+
+// KILL first, then stream fills, which feed a playing track, then the
+// highest priority load; equal priorities keep their submission order.
+size_t SoundPoolThread::nextMessage_l() {
+    size_t next = 0;
+    for (size_t i = 0; i < mMsgQueue.size(); i++) {
+        const SoundPoolMsg& msg = mMsgQueue[i];
+        if (msg.mMessageType != SoundPoolMsg::LOAD_SAMPLE) {
+            if (msg.mMessageType == SoundPoolMsg::KILL) {
+                return i;
+            }
+            if (mMsgQueue[next].mMessageType == SoundPoolMsg::LOAD_SAMPLE) {
+                next = i;
+            }
+        } else if (mMsgQueue[next].mMessageType == SoundPoolMsg::LOAD_SAMPLE
+                && msg.mPriority > mMsgQueue[next].mPriority) {
+            next = i;
+        }
+    }
+    return next;
+}
+
 const SoundPoolMsg SoundPoolThread::read() {
     Mutex::Autolock lock(&mLock);
     while (mMsgQueue.size() == 0) {
         mCondition.wait(mLock);
     }
-    SoundPoolMsg msg = mMsgQueue[0];
-    mMsgQueue.removeAt(0);
-    mCondition.signal();
+    size_t index = nextMessage_l();
+    SoundPoolMsg msg = mMsgQueue[index];
+    mMsgQueue.removeAt(index);
+    mCondition.broadcast();
     return msg;
 }
 
+void SoundPoolThread::setThreadCount(int count) {
+    Mutex::Autolock lock(&mLock);
+    if (count < 1) {
+        count = 1;
+    } else if (count > maxThreads) {
+        count = maxThreads;
+    }
+    if (!mRunning) {
+        return;
+    }
+    while (mThreadCount - mPendingKills < count) {
+        // take back a KILL that no worker has picked up yet
+        bool revoked = false;
+        for (size_t i = 0; mPendingKills > 0 && i < mMsgQueue.size(); i++) {
+            if (mMsgQueue[i].mMessageType == SoundPoolMsg::KILL) {
+                mMsgQueue.removeAt(i);
+                mPendingKills--;
+                revoked = true;
+                break;
+            }
+        }
+        if (revoked) {
+            continue;
+        }
+        if (!createThreadEtc(beginThread, this, "SoundPoolThread")) {
+            ALOGE("Unable to start SoundPoolThread worker");
+            break;
+        }
+        mThreadCount++;
+    }
+    while (mThreadCount - mPendingKills > count) {
+        // KILL bypasses maxMessages so shrinking never blocks on loads
+        mMsgQueue.push(SoundPoolMsg(SoundPoolMsg::KILL, 0));
+        mPendingKills++;
+        mCondition.broadcast();
+    }
+    ALOGV("setThreadCount: %d workers", mThreadCount - mPendingKills);
+}
+
 void SoundPoolThread::quit() {
     Mutex::Autolock lock(&mLock);
     if (mRunning) {
         mRunning = false;
         mMsgQueue.clear();
-        mMsgQueue.push(SoundPoolMsg(SoundPoolMsg::KILL, 0));
-        mCondition.signal();
-        mCondition.wait(mLock);
+        mPendingKills = mThreadCount;
+        for (int i = 0; i < mThreadCount; i++) {
+            mMsgQueue.push(SoundPoolMsg(SoundPoolMsg::KILL, 0));
+        }
+        mCondition.broadcast();
+        while (mThreadCount > 0) {
+            mCondition.wait(mLock);
+        }
     }
     ALOGV("return from quit");
 }
 
 SoundPoolThread::SoundPoolThread(SoundPool* soundPool) :
-    mSoundPool(soundPool)
+    mSoundPool(soundPool), mRunning(true), mThreadCount(0), mPendingKills(0)
 {
     mMsgQueue.setCapacity(maxMessages);
-    if (createThreadEtc(beginThread, this, "SoundPoolThread")) {
-        mRunning = true;
+    setThreadCount(1);
+    if (mThreadCount == 0) {
+        mRunning = false;
     }
 }
 
@@ -84,12 +161,20 @@ int SoundPoolThread::run() {
         SoundPoolMsg msg = read();
         ALOGV("Got message m=%d, mData=%d", msg.mMessageType, msg.mData);
         switch (msg.mMessageType) {
-        case SoundPoolMsg::KILL:
+        case SoundPoolMsg::KILL: {
             ALOGV("goodbye");
+            Mutex::Autolock lock(&mLock);
+            mThreadCount--;
+            mPendingKills--;
+            mCondition.broadcast();
             return NO_ERROR;
+        }
         case SoundPoolMsg::LOAD_SAMPLE:
             doLoadSample(msg.mData);
             break;
+        case SoundPoolMsg::FILL_STREAM:
+            mSoundPool->fillStream(msg.mData);
+            break;
         default:
             ALOGW("run: Unrecognized message %d\n",
                     msg.mMessageType);
@@ -98,16 +183,18 @@ int SoundPoolThread::run() {
     }
 }
 
-void SoundPoolThread::loadSample(int sampleID) {
-    write(SoundPoolMsg(SoundPoolMsg::LOAD_SAMPLE, sampleID));
+void SoundPoolThread::loadSample(int sampleID, int priority) {
+    write(SoundPoolMsg(SoundPoolMsg::LOAD_SAMPLE, sampleID, priority));
 }
 
 void SoundPoolThread::doLoadSample(int sampleID) {
     sp <Sample> sample = mSoundPool->findSample(sampleID);
     status_t status = -1;
     if (sample != 0) {
-        status = sample->doLoad();
+        status = sample->doLoad(mSoundPool->streamingThreshold());
     }
+    // each worker reports its own sample as soon as it is decoded, so a
+    // short sample is never held back behind a longer one
     mSoundPool->notify(SoundPoolEvent(SoundPoolEvent::SAMPLE_LOADED, sampleID, status));
 }
 
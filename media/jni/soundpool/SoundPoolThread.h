@@ -27,38 +27,48 @@ namespace android {
 
 class SoundPoolMsg {
 public:
-    enum MessageType { INVALID, KILL, LOAD_SAMPLE };
-    SoundPoolMsg() : mMessageType(INVALID), mData(0) {}
-    SoundPoolMsg(MessageType MessageType, int data) :
-        mMessageType(MessageType), mData(data) {}
+    enum MessageType { INVALID, KILL, LOAD_SAMPLE, FILL_STREAM };
+    SoundPoolMsg() : mMessageType(INVALID), mData(0), mPriority(0) {}
+    SoundPoolMsg(MessageType MessageType, int data, int priority = 0) :
+        mMessageType(MessageType), mData(data), mPriority(priority) {}
     uint16_t         mMessageType;
     uint16_t         mData;
+    int              mPriority;
 };
 
 /*
- * This class handles background requests from the SoundPool
+ * This class handles background requests from the SoundPool on a small
+ * pool of worker threads, so several samples can decode at once.
  */
 class SoundPoolThread {
 public:
     SoundPoolThread(SoundPool* SoundPool);
     ~SoundPoolThread();
-    void loadSample(int sampleID);
+    void loadSample(int sampleID, int priority);
+    // grows or shrinks the worker pool, clamped to [1, maxThreads]
+    void setThreadCount(int count);
     void quit();
     void write(SoundPoolMsg msg);
+    // like write(), but fails instead of waiting for queue space
+    bool tryWrite(SoundPoolMsg msg);
 
 private:
     static const size_t maxMessages = 5;
+    static const int maxThreads = 4;
 
     static int beginThread(void* arg);
     int run();
     void doLoadSample(int sampleID);
     const SoundPoolMsg read();
+    size_t nextMessage_l();
 
     Mutex                   mLock;
     Condition               mCondition;
     Vector<SoundPoolMsg>    mMsgQueue;
     SoundPool*              mSoundPool;
     bool                    mRunning;
+    int                     mThreadCount;   // live worker threads
+    int                     mPendingKills;  // KILLs queued to shrink the pool
 };
 
 } // end namespace android
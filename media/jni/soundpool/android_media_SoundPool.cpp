@@ -161,6 +161,33 @@ android_media_SoundPool_setRate(JNIEnv *env, jobject thiz, jint channelID,
     ap->setRate(channelID, (float) rate);
 }
 
+static void
+android_media_SoundPool_setStreamingThreshold(JNIEnv *env, jobject thiz, jint threshold)
+{
+    ALOGV("android_media_SoundPool_setStreamingThreshold");
+    SoundPool *ap = MusterSoundPool(env, thiz);
+    if (ap == NULL) return;
+    ap->setStreamingThreshold(threshold > 0 ? size_t(threshold) : 0);
+}
+
+static void
+android_media_SoundPool_setLoaderThreadCount(JNIEnv *env, jobject thiz, jint count)
+{
+    ALOGV("android_media_SoundPool_setLoaderThreadCount");
+    SoundPool *ap = MusterSoundPool(env, thiz);
+    if (ap == NULL) return;
+    ap->setLoaderThreadCount(count);
+}
+
+static void
+android_media_SoundPool_setLowLatencyMixing(JNIEnv *env, jobject thiz, jboolean enabled)
+{
+    ALOGV("android_media_SoundPool_setLowLatencyMixing");
+    SoundPool *ap = MusterSoundPool(env, thiz);
+    if (ap == NULL) return;
+    ap->setLowLatencyMixing(enabled == JNI_TRUE);
+}
+
 static void android_media_callback(SoundPoolEvent event, SoundPool* soundPool, void* user)
 {
     ALOGV("callback: (%d, %d, %d, %p, %p)", event.mMsg, event.mArg1, event.mArg2, soundPool, user);
@@ -292,6 +319,22 @@ static JNINativeMethod gMethods[] = {
     }
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod gOptionalMethods[] = {
+    {   "setStreamingThreshold",
+        "(I)V",
+        (void *)android_media_SoundPool_setStreamingThreshold
+    },
+    {   "setLoaderThreadCount",
+        "(I)V",
+        (void *)android_media_SoundPool_setLoaderThreadCount
+    },
+    {   "setLowLatencyMixing",
+        "(Z)V",
+        (void *)android_media_SoundPool_setLowLatencyMixing
+    },
+};
+
 static const char* const kClassPathName = "android/media/SoundPool";
 
 jint JNI_OnLoad(JavaVM* vm, void* /* reserved */)
@@ -331,6 +374,8 @@ jint JNI_OnLoad(JavaVM* vm, void* /* reserved */)
 
     if (AndroidRuntime::registerNativeMethods(env, kClassPathName, gMethods, NELEM(gMethods)) < 0)
         return result;
+    AndroidRuntime::registerOptionalNativeMethods(env, kClassPathName, gOptionalMethods,
+            NELEM(gOptionalMethods));
 
     // Get the AudioAttributes class and fields
     jclass audioAttrClass = env->FindClass(kAudioAttributesClassPathName);
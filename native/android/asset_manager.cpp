@@ -28,6 +28,26 @@
 
 using namespace android;
 
+// Batch entry points.  These are not in the NDK <android/asset_manager.h> yet, declare them
+// here with C linkage so the symbols match once the header picks them up.
+extern "C" {
+
+typedef struct AAssetBatchEntry {
+    // Compressed entries: the opened asset, its contents already inflated.  NULL otherwise.
+    AAsset* asset;
+    // Uncompressed entries: a descriptor to mmap or read the data from, owned by the caller.
+    // -1 otherwise.
+    int fd;
+    off64_t start;
+    off64_t length;
+} AAssetBatchEntry;
+
+int AAssetManager_openBatch(AAssetManager* amgr, const char* const* filenames, size_t count,
+        int mode, AAssetBatchEntry* outEntries);
+size_t AAssetDir_getFileNames(AAssetDir* assetDir, const char** outNames, size_t maxNames);
+
+}
+
 // -------------------- Backing implementation of the public API --------------------
 
 // AAssetManager is actually a secret typedef for an empty base class of AssetManager,
@@ -84,23 +104,30 @@ AAssetManager* AAssetManager_fromJava(JNIEnv* env, jobject assetManager)
     return (AAssetManager*) env->GetLongField(assetManager, gAssetManagerOffsets.mObject);
 }
 
-AAsset* AAssetManager_open(AAssetManager* amgr, const char* filename, int mode)
+static bool toAccessMode(int mode, Asset::AccessMode* outMode)
 {
-    Asset::AccessMode amMode;
     switch (mode) {
     case AASSET_MODE_UNKNOWN:
-        amMode = Asset::ACCESS_UNKNOWN;
-        break;
+        *outMode = Asset::ACCESS_UNKNOWN;
+        return true;
     case AASSET_MODE_RANDOM:
-        amMode = Asset::ACCESS_RANDOM;
-        break;
+        *outMode = Asset::ACCESS_RANDOM;
+        return true;
     case AASSET_MODE_STREAMING:
-        amMode = Asset::ACCESS_STREAMING;
-        break;
+        *outMode = Asset::ACCESS_STREAMING;
+        return true;
     case AASSET_MODE_BUFFER:
-        amMode = Asset::ACCESS_BUFFER;
-        break;
+        *outMode = Asset::ACCESS_BUFFER;
+        return true;
     default:
+        return false;
+    }
+}
+
+AAsset* AAssetManager_open(AAssetManager* amgr, const char* filename, int mode)
+{
+    Asset::AccessMode amMode;
+    if (!toAccessMode(mode, &amMode)) {
         return NULL;
     }
 
@@ -113,6 +140,49 @@ AAsset* AAssetManager_open(AAssetManager* amgr, const char* filename, int mode)
     return new AAsset(asset);
 }
 
+int AAssetManager_openBatch(AAssetManager* amgr, const char* const* filenames, size_t count,
+        int mode, AAssetBatchEntry* outEntries)
+{
+    Asset::AccessMode amMode;
+    if (!toAccessMode(mode, &amMode)) {
+        return -1;
+    }
+
+    Vector<Asset*> assets;
+    assets.resize(count);
+    AssetManager* mgr = static_cast<AssetManager*>(amgr);
+    mgr->openBatch(filenames, count, amMode, assets.editArray());
+
+    int found = 0;
+    for (size_t i = 0; i < count; i++) {
+        AAssetBatchEntry& entry = outEntries[i];
+        entry.asset = NULL;
+        entry.fd = -1;
+        entry.start = 0;
+        entry.length = 0;
+
+        Asset* asset = assets[i];
+        if (asset == NULL) {
+            continue;
+        }
+        found++;
+
+        // Stored entries are handed out as file ranges, the caller maps them directly.
+        entry.fd = asset->openFileDescriptor(&entry.start, &entry.length);
+        if (entry.fd >= 0) {
+            delete asset;
+            continue;
+        }
+
+        // Compressed ones are inflated now so later reads don't stall.
+        entry.start = 0;
+        entry.length = asset->getLength();
+        asset->getBuffer(false);
+        entry.asset = new AAsset(asset);
+    }
+    return found;
+}
+
 AAssetDir* AAssetManager_openDir(AAssetManager* amgr, const char* dirName)
 {
     AssetManager* mgr = static_cast<AssetManager*>(amgr);
@@ -148,6 +218,24 @@ const char* AAssetDir_getNextFileName(AAssetDir* assetDir)
     return returnName;
 }
 
+size_t AAssetDir_getFileNames(AAssetDir* assetDir, const char** outNames, size_t maxNames)
+{
+    // Same iteration as AAssetDir_getNextFileName().  The names point into the AssetDir and
+    // stay valid until it is closed.
+    size_t count = 0;
+    size_t index = assetDir->mCurFileIndex;
+    const size_t max = assetDir->mAssetDir->getFileCount();
+    while (index < max && count < maxNames) {
+        if (assetDir->mAssetDir->getFileType(index) == kFileTypeRegular) {
+            outNames[count++] = assetDir->mAssetDir->getFileName(index).string();
+        }
+        index++;
+    }
+
+    assetDir->mCurFileIndex = index;
+    return count;
+}
+
 void AAssetDir_rewind(AAssetDir* assetDir)
 {
     assetDir->mCurFileIndex = 0;
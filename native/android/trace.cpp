@@ -15,16 +15,18 @@
  */
 
 #include <android/trace.h>
+#include <android_runtime/android_os_Trace.h>
 #include <cutils/trace.h>
 
 bool ATrace_isEnabled() {
-    return atrace_is_tag_enabled(ATRACE_TAG_APP);
+    return (android::getBufferedTraceTags() & ATRACE_TAG_APP) != 0
+            || atrace_is_tag_enabled(ATRACE_TAG_APP);
 }
 
 void ATrace_beginSection(const char* sectionName) {
-    atrace_begin(ATRACE_TAG_APP, sectionName);
+    android::traceBegin(ATRACE_TAG_APP, sectionName);
 }
 
 void ATrace_endSection() {
-    atrace_end(ATRACE_TAG_APP);
+    android::traceEnd(ATRACE_TAG_APP);
 }
@@ -1948,6 +1948,142 @@ nScriptForEach(JNIEnv *_env, jobject _this, jlong con, jlong script, jint slot,
     }
 }
 
+// Commands of nScriptBatchSubmit(). Each one is followed in the command array
+// by the number of ints given in kBatchCommandArgs, and takes its RS objects
+// in order from the object array.
+enum {
+    // slot, input count, params offset, params length, has limits, 6 limits.
+    // Objects: script, the inputs, output.
+    RS_BATCH_FOR_EACH = 1,
+    // dstXoff, dstYoff, dstMip, dstFace, width, height, srcXoff, srcYoff, srcMip, srcFace.
+    // Objects: destination allocation, source allocation.
+    RS_BATCH_COPY_2D = 2,
+    // buffer index, buffer offset, offset, lod, count, sizeBytes.
+    // Objects: the allocation written from, or read into, the direct buffer.
+    RS_BATCH_DATA_1D = 3,
+    RS_BATCH_READ_1D = 4,
+};
+
+static const jint kBatchCommandArgs[] = { 0, 11, 10, 6, 6 };
+
+// Runs a recorded sequence of copies and kernel launches with a single JNI
+// transition. Data moves in and out through direct ByteBuffers, read and
+// written in place.
+static void
+nScriptBatchSubmit(JNIEnv *_env, jobject _this, jlong con, jintArray commands,
+                   jlongArray objects, jbyteArray params, jobjectArray buffers)
+{
+    if (commands == nullptr) {
+        return;
+    }
+    jint cmd_len = _env->GetArrayLength(commands);
+    jint obj_len = objects != nullptr ? _env->GetArrayLength(objects) : 0;
+    jint param_len = params != nullptr ? _env->GetArrayLength(params) : 0;
+    jint buffer_len = buffers != nullptr ? _env->GetArrayLength(buffers) : 0;
+    if (kLogApi) {
+        ALOGD("nScriptBatchSubmit, con(%p), commands(%i), objects(%i)", (RsContext)con,
+              cmd_len, obj_len);
+    }
+
+    jint *cmd_ptr = _env->GetIntArrayElements(commands, nullptr);
+    jlong *obj_ptr = objects != nullptr ? _env->GetLongArrayElements(objects, nullptr) : nullptr;
+    jbyte *param_ptr = params != nullptr ? _env->GetByteArrayElements(params, nullptr) : nullptr;
+
+    jint pc = 0;
+    jint next_obj = 0;
+    while (pc < cmd_len) {
+        const jint op = cmd_ptr[pc];
+        if (op <= 0 || op >= (jint)NELEM(kBatchCommandArgs)
+                || pc + 1 + kBatchCommandArgs[op] > cmd_len) {
+            ALOGE("Malformed RenderScript batch at command %i", pc);
+            break;
+        }
+        const jint *args = cmd_ptr + pc + 1;
+        pc += 1 + kBatchCommandArgs[op];
+
+        if (op == RS_BATCH_FOR_EACH) {
+            jint in_len = args[1];
+            // Summed as jlong, so an offset and length near INT_MAX can't wrap
+            const jlong param_end = (jlong)args[2] + args[3];
+            if (in_len < 0 || in_len > (jint)RS_KERNEL_MAX_ARGUMENTS
+                    || next_obj + in_len + 2 > obj_len
+                    || args[2] < 0 || args[3] < 0 || param_end > param_len) {
+                ALOGE("Malformed kernel launch in RenderScript batch");
+                break;
+            }
+            RsScript script = (RsScript)obj_ptr[next_obj++];
+            RsAllocation in_allocs[RS_KERNEL_MAX_ARGUMENTS];
+            for (jint i = 0; i < in_len; i++) {
+                in_allocs[i] = (RsAllocation)obj_ptr[next_obj++];
+            }
+            RsAllocation aout = (RsAllocation)obj_ptr[next_obj++];
+
+            RsScriptCall sc, *sca = nullptr;
+            if (args[4]) {
+                memset(&sc, 0, sizeof(sc));
+                sc.xStart   = args[5];
+                sc.xEnd     = args[6];
+                sc.yStart   = args[7];
+                sc.yEnd     = args[8];
+                sc.zStart   = args[9];
+                sc.zEnd     = args[10];
+                sc.strategy = RS_FOR_EACH_STRATEGY_DONT_CARE;
+                sca = &sc;
+            }
+            rsScriptForEachMulti((RsContext)con, script, args[0],
+                                 in_len > 0 ? in_allocs : nullptr, in_len, aout,
+                                 args[3] > 0 ? param_ptr + args[2] : nullptr, args[3],
+                                 sca, 0);
+        } else if (op == RS_BATCH_COPY_2D) {
+            if (next_obj + 2 > obj_len) {
+                ALOGE("Malformed copy in RenderScript batch");
+                break;
+            }
+            RsAllocation dst = (RsAllocation)obj_ptr[next_obj++];
+            RsAllocation src = (RsAllocation)obj_ptr[next_obj++];
+            rsAllocationCopy2DRange((RsContext)con,
+                                    dst, args[0], args[1], args[2], args[3],
+                                    args[4], args[5],
+                                    src, args[6], args[7], args[8], args[9]);
+        } else {
+            jint buffer_index = args[0];
+            jint buffer_offset = args[1];
+            jint size_bytes = args[5];
+            if (next_obj + 1 > obj_len || buffer_index < 0 || buffer_index >= buffer_len
+                    || buffer_offset < 0 || size_bytes < 0) {
+                ALOGE("Malformed data transfer in RenderScript batch");
+                break;
+            }
+            jobject buffer = _env->GetObjectArrayElement(buffers, buffer_index);
+            uint8_t *data = buffer != nullptr ?
+                    (uint8_t *)_env->GetDirectBufferAddress(buffer) : nullptr;
+            jlong capacity = buffer != nullptr ? _env->GetDirectBufferCapacity(buffer) : 0;
+            _env->DeleteLocalRef(buffer);
+            if (data == nullptr || (jlong)buffer_offset + size_bytes > capacity) {
+                ALOGE("RenderScript batch needs a direct buffer of at least %" PRId64 " bytes",
+                      (int64_t)buffer_offset + size_bytes);
+                break;
+            }
+            RsAllocation alloc = (RsAllocation)obj_ptr[next_obj++];
+            if (op == RS_BATCH_DATA_1D) {
+                rsAllocation1DData((RsContext)con, alloc, args[2], args[3], args[4],
+                                   data + buffer_offset, size_bytes);
+            } else {
+                rsAllocation1DRead((RsContext)con, alloc, args[2], args[3], args[4],
+                                   data + buffer_offset, size_bytes);
+            }
+        }
+    }
+
+    if (param_ptr != nullptr) {
+        _env->ReleaseByteArrayElements(params, param_ptr, JNI_ABORT);
+    }
+    if (obj_ptr != nullptr) {
+        _env->ReleaseLongArrayElements(objects, obj_ptr, JNI_ABORT);
+    }
+    _env->ReleaseIntArrayElements(commands, cmd_ptr, JNI_ABORT);
+}
+
 // -----------------------------------
 
 static jlong
@@ -2592,8 +2728,15 @@ static JNINativeMethod methods[] = {
 {"rsnSystemGetPointerSize",          "()I",                                   (void*)nSystemGetPointerSize },
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod optionalMethods[] = {
+{"rsnScriptBatchSubmit",             "(J[I[J[B[Ljava/nio/ByteBuffer;)V",      (void*)nScriptBatchSubmit },
+};
+
 static int registerFuncs(JNIEnv *_env)
 {
+    android::AndroidRuntime::registerOptionalNativeMethods(
+            _env, classPathName, optionalMethods, NELEM(optionalMethods));
     return android::AndroidRuntime::registerNativeMethods(
             _env, classPathName, methods, NELEM(methods));
 }
@@ -19,8 +19,10 @@
 
 #include "JNIHelp.h"
 #include "jni.h"
+#include "android_runtime/AndroidRuntime.h"
 #include <utils/Log.h>
 #include <utils/misc.h>
+#include <utils/Mutex.h>
 #include <utils/String8.h>
 
 #include <dirent.h>
@@ -90,6 +92,15 @@ public:
     virtual int setTime(struct timeval *tv) = 0;
     virtual int waitForAlarm() = 0;
 
+    /* Sets an alarm that may fire anywhere in [ts, ts + window_ns]. Coalescing
+       implementations only program the kernel on flush(). */
+    virtual int setWindow(int type, struct timespec *ts, int64_t /* window_ns */) {
+        return set(type, ts);
+    }
+    virtual int flush() { return 0; }
+    /* Fills up to n wakeup attribution counters, returns the number filled. */
+    virtual size_t getStats(int64_t * /* stats */, size_t /* n */) { return 0; }
+
 protected:
     int *fds;
     size_t n_fds;
@@ -105,20 +116,55 @@ public:
     int waitForAlarm();
 };
 
+/* Layout of the counters returned by getAlarmStats(), keep in sync with
+   AlarmManagerService.java */
+enum {
+    ALARM_STATS_EXPIRED_BASE = 0,   /* expiries per type, ANDROID_ALARM_TYPE_COUNT entries */
+    ALARM_STATS_WAKEUPS = ANDROID_ALARM_TYPE_COUNT, /* wakes caused by wakeup types */
+    ALARM_STATS_SHARED_WAKEUPS,     /* wakes that delivered more than one type */
+    ALARM_STATS_COALESCED,          /* deadlines moved onto another type's deadline */
+    ALARM_STATS_PROGRAMMED,         /* timerfd_settime() calls */
+    ALARM_STATS_PROGRAM_SKIPPED,    /* timerfd_settime() calls avoided */
+    ALARM_STATS_COUNT
+};
+
 class AlarmImplTimerFd : public AlarmImpl
 {
 public:
     AlarmImplTimerFd(int fds[N_ANDROID_TIMERFDS], int epollfd, int rtc_id) :
-        AlarmImpl(fds, N_ANDROID_TIMERFDS), epollfd(epollfd), rtc_id(rtc_id) { }
+        AlarmImpl(fds, N_ANDROID_TIMERFDS), epollfd(epollfd), rtc_id(rtc_id)
+    {
+        memset(deadlines, 0, sizeof(deadlines));
+        memset(programmed, 0, sizeof(programmed));
+        memset(stats, 0, sizeof(stats));
+    }
     ~AlarmImplTimerFd();
 
     int set(int type, struct timespec *ts);
     int setTime(struct timeval *tv);
     int waitForAlarm();
 
+    int setWindow(int type, struct timespec *ts, int64_t window_ns);
+    int flush();
+    size_t getStats(int64_t *out, size_t n);
+
 private:
+    struct Deadline {
+        bool armed;
+        int64_t start_ns;   /* in the type's own clock */
+        int64_t end_ns;
+    };
+
+    int program_l(size_t type, int64_t when_ns);
+
     int epollfd;
     int rtc_id;
+
+    Mutex lock;
+    Deadline deadlines[ANDROID_ALARM_TYPE_COUNT];
+    /* absolute expiry currently programmed per fd, 0 = disarmed or expired */
+    int64_t programmed[ANDROID_ALARM_TYPE_COUNT];
+    int64_t stats[ALARM_STATS_COUNT];
 };
 
 AlarmImpl::AlarmImpl(int *fds_, size_t n_fds) : fds(new int[n_fds]),
@@ -168,22 +214,175 @@ AlarmImplTimerFd::~AlarmImplTimerFd()
 
 int AlarmImplTimerFd::set(int type, struct timespec *ts)
 {
-    if (type > ANDROID_ALARM_TYPE_COUNT) {
+    int res = setWindow(type, ts, 0);
+    if (res < 0) {
+        return res;
+    }
+    return flush();
+}
+
+static inline int64_t timespec_to_ns(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static inline bool is_wakeup_type(size_t type)
+{
+    return type == ANDROID_ALARM_RTC_WAKEUP || type == ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP;
+}
+
+int AlarmImplTimerFd::setWindow(int type, struct timespec *ts, int64_t window_ns)
+{
+    /* the extra RTC change fd can't be set, it only reports time changes */
+    if (type < 0 || type >= ANDROID_ALARM_TYPE_COUNT || window_ns < 0) {
         errno = EINVAL;
         return -1;
     }
 
-    if (!ts->tv_nsec && !ts->tv_sec) {
-        ts->tv_nsec = 1;
-    }
+    Mutex::Autolock _l(lock);
+    Deadline &deadline = deadlines[type];
+    deadline.armed = true;
+    deadline.start_ns = timespec_to_ns(ts);
+    deadline.end_ns = deadline.start_ns + window_ns;
+    return 0;
+}
+
+int AlarmImplTimerFd::program_l(size_t type, int64_t when_ns)
+{
     /* timerfd interprets 0 = disarm, so replace with a practically
        equivalent deadline of 1 ns */
+    if (when_ns <= 0) {
+        when_ns = 1;
+    }
+    if (programmed[type] == when_ns) {
+        stats[ALARM_STATS_PROGRAM_SKIPPED]++;
+        return 0;
+    }
 
     struct itimerspec spec;
     memset(&spec, 0, sizeof(spec));
-    memcpy(&spec.it_value, ts, sizeof(spec.it_value));
+    spec.it_value.tv_sec = when_ns / 1000000000LL;
+    spec.it_value.tv_nsec = when_ns % 1000000000LL;
 
-    return timerfd_settime(fds[type], TFD_TIMER_ABSTIME, &spec, NULL);
+    stats[ALARM_STATS_PROGRAMMED]++;
+    int res = timerfd_settime(fds[type], TFD_TIMER_ABSTIME, &spec, NULL);
+    programmed[type] = res < 0 ? 0 : when_ns;
+    return res;
+}
+
+/*
+ * Picks one expiry per armed type inside its window, preferring instants the
+ * device is woken up at anyway: overlapping wakeup windows share one wake, and
+ * non-wakeup deadlines are pulled onto a wake (or onto each other) when their
+ * window allows it. Windows are compared on CLOCK_BOOTTIME.
+ */
+int AlarmImplTimerFd::flush()
+{
+    Mutex::Autolock _l(lock);
+
+    int64_t offsets[ANDROID_ALARM_TYPE_COUNT];
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    const int64_t boottime = timespec_to_ns(&now);
+    for (size_t i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+        clock_gettime(android_alarm_to_clockid[i], &now);
+        offsets[i] = timespec_to_ns(&now) - boottime;
+    }
+
+    int64_t when[ANDROID_ALARM_TYPE_COUNT];
+    bool done[ANDROID_ALARM_TYPE_COUNT];
+    for (size_t i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+        done[i] = !deadlines[i].armed;
+        when[i] = deadlines[i].start_ns - offsets[i];
+    }
+
+    /* Wakeup types first, then the others. Within a pass, handle the earliest
+       deadline first and let it absorb every later deadline whose window
+       contains it. */
+    for (int pass = 0; pass < 2; pass++) {
+        for (;;) {
+            ssize_t first = -1;
+            for (size_t i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+                if (!done[i] && is_wakeup_type(i) == (pass == 0)
+                        && (first < 0 || when[i] < when[first])) {
+                    first = i;
+                }
+            }
+            if (first < 0) {
+                break;
+            }
+
+            /* the latest start among overlapping windows is inside all of them */
+            int64_t anchor = when[first];
+            int64_t limit = deadlines[first].end_ns - offsets[first];
+            for (size_t i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+                if (done[i] || (ssize_t) i == first || is_wakeup_type(i) != (pass == 0)) {
+                    continue;
+                }
+                const int64_t start = deadlines[i].start_ns - offsets[i];
+                if (start <= limit) {
+                    anchor = start > anchor ? start : anchor;
+                    const int64_t end = deadlines[i].end_ns - offsets[i];
+                    limit = end < limit ? end : limit;
+                }
+            }
+            for (size_t i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+                if (done[i] || is_wakeup_type(i) != (pass == 0)) {
+                    continue;
+                }
+                const int64_t start = deadlines[i].start_ns - offsets[i];
+                const int64_t end = deadlines[i].end_ns - offsets[i];
+                if (start <= anchor && anchor <= end) {
+                    if ((ssize_t) i != first && start != anchor) {
+                        stats[ALARM_STATS_COALESCED]++;
+                    }
+                    when[i] = anchor;
+                    done[i] = true;
+                }
+            }
+        }
+
+        if (pass == 0) {
+            /* pull non-wakeup deadlines onto a programmed wake when possible */
+            for (size_t w = 0; w < ANDROID_ALARM_TYPE_COUNT; w++) {
+                if (!is_wakeup_type(w) || !deadlines[w].armed) {
+                    continue;
+                }
+                for (size_t i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+                    if (done[i] || is_wakeup_type(i)) {
+                        continue;
+                    }
+                    const int64_t start = deadlines[i].start_ns - offsets[i];
+                    const int64_t end = deadlines[i].end_ns - offsets[i];
+                    if (start <= when[w] && when[w] <= end) {
+                        if (start != when[w]) {
+                            stats[ALARM_STATS_COALESCED]++;
+                        }
+                        when[i] = when[w];
+                        done[i] = true;
+                    }
+                }
+            }
+        }
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+        if (deadlines[i].armed && program_l(i, when[i] + offsets[i]) < 0) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+size_t AlarmImplTimerFd::getStats(int64_t *out, size_t n)
+{
+    Mutex::Autolock _l(lock);
+    if (n > ALARM_STATS_COUNT) {
+        n = ALARM_STATS_COUNT;
+    }
+    memcpy(out, stats, n * sizeof(out[0]));
+    return n;
 }
 
 int AlarmImplTimerFd::setTime(struct timeval *tv)
@@ -247,6 +446,9 @@ int AlarmImplTimerFd::waitForAlarm()
     }
 
     int result = 0;
+    int expired = 0;
+    bool wakeup = false;
+    Mutex::Autolock _l(lock);
     for (int i = 0; i < nevents; i++) {
         uint32_t alarm_idx = events[i].data.u32;
         uint64_t unused;
@@ -259,8 +461,22 @@ int AlarmImplTimerFd::waitForAlarm()
             }
         } else {
             result |= (1 << alarm_idx);
+            if (alarm_idx < ANDROID_ALARM_TYPE_COUNT) {
+                /* one-shot timer, it has to be programmed again even for the same value */
+                programmed[alarm_idx] = 0;
+                deadlines[alarm_idx].armed = false;
+                stats[ALARM_STATS_EXPIRED_BASE + alarm_idx]++;
+                wakeup |= is_wakeup_type(alarm_idx);
+                expired++;
+            }
         }
     }
+    if (wakeup) {
+        stats[ALARM_STATS_WAKEUPS]++;
+    }
+    if (expired > 1) {
+        stats[ALARM_STATS_SHARED_WAKEUPS]++;
+    }
 
     return result;
 }
@@ -475,6 +691,72 @@ static void android_server_AlarmManagerService_set(JNIEnv*, jobject, jlong nativ
     }
 }
 
+static void android_server_AlarmManagerService_setWithWindow(JNIEnv*, jobject, jlong nativeData,
+        jint type, jlong seconds, jlong nanoseconds, jlong windowNanos)
+{
+    AlarmImpl *impl = reinterpret_cast<AlarmImpl *>(nativeData);
+    struct timespec ts;
+    ts.tv_sec = seconds;
+    ts.tv_nsec = nanoseconds;
+
+    int result = impl->setWindow(type, &ts, windowNanos);
+    if (result >= 0) {
+        result = impl->flush();
+    }
+    if (result < 0)
+    {
+        ALOGE("Unable to set alarm to %lld.%09lld (window %lld ns): %s\n",
+              static_cast<long long>(seconds),
+              static_cast<long long>(nanoseconds),
+              static_cast<long long>(windowNanos), strerror(errno));
+    }
+}
+
+/* Sets several alarms, given as (type, seconds, nanoseconds, window) quadruples,
+   and programs the kernel once for all of them. */
+static void android_server_AlarmManagerService_setAlarms(JNIEnv* env, jobject, jlong nativeData,
+        jlongArray alarms)
+{
+    AlarmImpl *impl = reinterpret_cast<AlarmImpl *>(nativeData);
+    if (alarms == NULL) {
+        return;
+    }
+    jsize length = env->GetArrayLength(alarms);
+    jlong* values = env->GetLongArrayElements(alarms, NULL);
+    if (values == NULL) {
+        return;
+    }
+
+    for (jsize i = 0; i + 3 < length; i += 4) {
+        struct timespec ts;
+        ts.tv_sec = values[i + 1];
+        ts.tv_nsec = values[i + 2];
+        if (impl->setWindow(static_cast<int>(values[i]), &ts, values[i + 3]) < 0) {
+            ALOGE("Unable to set alarm type %lld: %s\n",
+                  static_cast<long long>(values[i]), strerror(errno));
+        }
+    }
+    env->ReleaseLongArrayElements(alarms, values, JNI_ABORT);
+
+    if (impl->flush() < 0) {
+        ALOGE("Unable to program alarms: %s\n", strerror(errno));
+    }
+}
+
+static jint android_server_AlarmManagerService_getAlarmStats(JNIEnv* env, jobject, jlong nativeData,
+        jlongArray out)
+{
+    AlarmImpl *impl = reinterpret_cast<AlarmImpl *>(nativeData);
+    int64_t stats[ALARM_STATS_COUNT];
+    size_t n = impl->getStats(stats, ALARM_STATS_COUNT);
+    jsize length = env->GetArrayLength(out);
+    if ((size_t) length < n) {
+        n = length;
+    }
+    env->SetLongArrayRegion(out, 0, n, reinterpret_cast<const jlong *>(stats));
+    return (jint) n;
+}
+
 static jint android_server_AlarmManagerService_waitForAlarm(JNIEnv*, jobject, jlong nativeData)
 {
     AlarmImpl *impl = reinterpret_cast<AlarmImpl *>(nativeData);
@@ -504,8 +786,17 @@ static JNINativeMethod sMethods[] = {
     {"setKernelTimezone", "(JI)I", (void*)android_server_AlarmManagerService_setKernelTimezone},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod sOptionalMethods[] = {
+    {"setWithWindow", "(JIJJJ)V", (void*)android_server_AlarmManagerService_setWithWindow},
+    {"setAlarms", "(J[J)V", (void*)android_server_AlarmManagerService_setAlarms},
+    {"getAlarmStats", "(J[J)I", (void*)android_server_AlarmManagerService_getAlarmStats},
+};
+
 int register_android_server_AlarmManagerService(JNIEnv* env)
 {
+    AndroidRuntime::registerOptionalNativeMethods(env, "com/android/server/AlarmManagerService",
+                                                  sOptionalMethods, NELEM(sOptionalMethods));
     return jniRegisterNativeMethods(env, "com/android/server/AlarmManagerService",
                                     sMethods, NELEM(sMethods));
 }
@@ -54,6 +54,8 @@ static struct {
     jfieldID ownerUid;
     jfieldID inputFeatures;
     jfieldID displayId;
+    // Optional, NULL if the Java class has no such field.
+    jfieldID generation;
 } gInputWindowHandleClassInfo;
 
 static Mutex gHandleMutex;
@@ -64,7 +66,7 @@ static Mutex gHandleMutex;
 NativeInputWindowHandle::NativeInputWindowHandle(
         const sp<InputApplicationHandle>& inputApplicationHandle, jweak objWeak) :
         InputWindowHandle(inputApplicationHandle),
-        mObjWeak(objWeak) {
+        mObjWeak(objWeak), mInfoGeneration(0) {
 }
 
 NativeInputWindowHandle::~NativeInputWindowHandle() {
@@ -84,6 +86,17 @@ bool NativeInputWindowHandle::updateInfo() {
         return false;
     }
 
+    // The window manager bumps the generation whenever it changes any field,
+    // so an unchanged handle doesn't have to be read again field by field.
+    jint generation = 0;
+    if (gInputWindowHandleClassInfo.generation) {
+        generation = env->GetIntField(obj, gInputWindowHandleClassInfo.generation);
+        if (mInfo && generation != 0 && generation == mInfoGeneration) {
+            env->DeleteLocalRef(obj);
+            return true;
+        }
+    }
+
     if (!mInfo) {
         mInfo = new InputWindowInfo();
     } else {
@@ -158,6 +171,7 @@ bool NativeInputWindowHandle::updateInfo() {
             gInputWindowHandleClassInfo.inputFeatures);
     mInfo->displayId = env->GetIntField(obj,
             gInputWindowHandleClassInfo.displayId);
+    mInfoGeneration = generation;
 
     env->DeleteLocalRef(obj);
     return true;
@@ -302,6 +316,13 @@ int register_android_server_InputWindowHandle(JNIEnv* env) {
 
     GET_FIELD_ID(gInputWindowHandleClassInfo.displayId, clazz,
             "displayId", "I");
+
+    // Generation 0 means "always read", which is also what happens when the
+    // field doesn't exist.
+    gInputWindowHandleClassInfo.generation = env->GetFieldID(clazz, "generation", "I");
+    if (!gInputWindowHandleClassInfo.generation) {
+        env->ExceptionClear();
+    }
     return 0;
 }
 
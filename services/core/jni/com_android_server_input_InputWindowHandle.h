@@ -36,6 +36,8 @@ public:
 
 private:
     jweak mObjWeak;
+    // The Java generation that mInfo was last read at, or 0.
+    jint mInfoGeneration;
 };
 
 
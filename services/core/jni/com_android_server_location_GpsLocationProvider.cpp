@@ -55,6 +55,10 @@ static jmethodID method_reportGeofencePauseStatus;
 static jmethodID method_reportGeofenceResumeStatus;
 static jmethodID method_reportMeasurementData;
 static jmethodID method_reportNavigationMessages;
+// Optional packed variants, used when the Java side implements them
+static jmethodID method_reportLocationBatch;
+static jmethodID method_reportSvStatusPacked;
+static jmethodID method_reportMeasurementDataPacked;
 
 static const GpsInterface* sGpsInterface = NULL;
 static const GpsXtraInterface* sGpsXtraInterface = NULL;
@@ -69,6 +73,18 @@ static const GnssConfigurationInterface* sGnssConfigurationInterface = NULL;
 
 // temporary storage for GPS callbacks
 static GpsSvStatus  sGpsSvStatus;
+
+// Location batching, see native_set_location_batch_size(). Each fix is packed as
+// LOCATION_BATCH_DOUBLES doubles and LOCATION_BATCH_LONGS longs, keep the layout in sync
+// with GpsLocationProvider.reportLocationBatch().
+#define LOCATION_BATCH_DOUBLES 6    // latitude, longitude, altitude, speed, bearing, accuracy
+#define LOCATION_BATCH_LONGS 2      // flags, timestamp
+#define MAX_LOCATION_BATCH_SIZE 32
+static pthread_mutex_t sLocationBatchLock = PTHREAD_MUTEX_INITIALIZER;
+static int sLocationBatchSize = 0;  // 0 delivers every fix through reportLocation()
+static int sLocationBatchCount = 0;
+static jdouble sLocationBatchDoubles[MAX_LOCATION_BATCH_SIZE * LOCATION_BATCH_DOUBLES];
+static jlong sLocationBatchLongs[MAX_LOCATION_BATCH_SIZE * LOCATION_BATCH_LONGS];
 static const char* sNmeaString;
 static int sNmeaStringLength;
 
@@ -84,9 +100,59 @@ static void checkAndClearExceptionFromCallback(JNIEnv* env, const char* methodNa
     }
 }
 
+// Delivers the batched fixes with a single upcall. Must be called with
+// sLocationBatchLock held; the lock is released before calling into Java.
+static void deliver_location_batch_locked(JNIEnv* env)
+{
+    int count = sLocationBatchCount;
+    sLocationBatchCount = 0;
+    if (count == 0) {
+        pthread_mutex_unlock(&sLocationBatchLock);
+        return;
+    }
+
+    jdoubleArray doubles = env->NewDoubleArray(count * LOCATION_BATCH_DOUBLES);
+    jlongArray longs = env->NewLongArray(count * LOCATION_BATCH_LONGS);
+    if (doubles != NULL && longs != NULL) {
+        env->SetDoubleArrayRegion(doubles, 0, count * LOCATION_BATCH_DOUBLES,
+                sLocationBatchDoubles);
+        env->SetLongArrayRegion(longs, 0, count * LOCATION_BATCH_LONGS, sLocationBatchLongs);
+    }
+    pthread_mutex_unlock(&sLocationBatchLock);
+
+    if (doubles != NULL && longs != NULL) {
+        env->CallVoidMethod(mCallbacksObj, method_reportLocationBatch, count, doubles, longs);
+    }
+    checkAndClearExceptionFromCallback(env, __FUNCTION__);
+    env->DeleteLocalRef(doubles);
+    env->DeleteLocalRef(longs);
+}
+
 static void location_callback(GpsLocation* location)
 {
     JNIEnv* env = AndroidRuntime::getJNIEnv();
+
+    pthread_mutex_lock(&sLocationBatchLock);
+    if (sLocationBatchSize > 0 && method_reportLocationBatch != NULL) {
+        jdouble* d = &sLocationBatchDoubles[sLocationBatchCount * LOCATION_BATCH_DOUBLES];
+        jlong* l = &sLocationBatchLongs[sLocationBatchCount * LOCATION_BATCH_LONGS];
+        d[0] = location->latitude;
+        d[1] = location->longitude;
+        d[2] = location->altitude;
+        d[3] = location->speed;
+        d[4] = location->bearing;
+        d[5] = location->accuracy;
+        l[0] = location->flags;
+        l[1] = location->timestamp;
+        if (++sLocationBatchCount >= sLocationBatchSize) {
+            deliver_location_batch_locked(env);
+        } else {
+            pthread_mutex_unlock(&sLocationBatchLock);
+        }
+        return;
+    }
+    pthread_mutex_unlock(&sLocationBatchLock);
+
     env->CallVoidMethod(mCallbacksObj, method_reportLocation, location->flags,
             (jdouble)location->latitude, (jdouble)location->longitude,
             (jdouble)location->altitude,
@@ -102,9 +168,52 @@ static void status_callback(GpsStatus* status)
     checkAndClearExceptionFromCallback(env, __FUNCTION__);
 }
 
+// Hands the SV status to Java with the upcall itself, instead of having Java read it back
+// through native_read_sv_status(). The int array holds the PRNs followed by the ephemeris,
+// almanac and used in fix masks; the float array holds snr, elevation and azimuth per SV.
+static bool report_sv_status_packed(JNIEnv* env, const GpsSvStatus* sv_status)
+{
+    int num_svs = sv_status->num_svs;
+    if (num_svs < 0 || num_svs > GPS_MAX_SVS) {
+        num_svs = 0;
+    }
+
+    jint ints[GPS_MAX_SVS + 3];
+    jfloat floats[GPS_MAX_SVS * 3];
+    for (int i = 0; i < num_svs; i++) {
+        ints[i] = sv_status->sv_list[i].prn;
+        floats[i * 3] = sv_status->sv_list[i].snr;
+        floats[i * 3 + 1] = sv_status->sv_list[i].elevation;
+        floats[i * 3 + 2] = sv_status->sv_list[i].azimuth;
+    }
+    ints[num_svs] = sv_status->ephemeris_mask;
+    ints[num_svs + 1] = sv_status->almanac_mask;
+    ints[num_svs + 2] = sv_status->used_in_fix_mask;
+
+    jintArray intArray = env->NewIntArray(num_svs + 3);
+    jfloatArray floatArray = env->NewFloatArray(num_svs * 3);
+    if (intArray == NULL || floatArray == NULL) {
+        env->ExceptionClear();
+        env->DeleteLocalRef(intArray);
+        env->DeleteLocalRef(floatArray);
+        return false;
+    }
+    env->SetIntArrayRegion(intArray, 0, num_svs + 3, ints);
+    env->SetFloatArrayRegion(floatArray, 0, num_svs * 3, floats);
+
+    env->CallVoidMethod(mCallbacksObj, method_reportSvStatusPacked, num_svs, intArray, floatArray);
+    checkAndClearExceptionFromCallback(env, __FUNCTION__);
+    env->DeleteLocalRef(intArray);
+    env->DeleteLocalRef(floatArray);
+    return true;
+}
+
 static void sv_status_callback(GpsSvStatus* sv_status)
 {
     JNIEnv* env = AndroidRuntime::getJNIEnv();
+    if (method_reportSvStatusPacked != NULL && report_sv_status_packed(env, sv_status)) {
+        return;
+    }
     memcpy(&sGpsSvStatus, sv_status, sizeof(sGpsSvStatus));
     env->CallVoidMethod(mCallbacksObj, method_reportSvStatus);
     checkAndClearExceptionFromCallback(env, __FUNCTION__);
@@ -476,6 +585,21 @@ static void android_location_GpsLocationProvider_class_init_native(JNIEnv* env,
             "reportNavigationMessage",
             "(Landroid/location/GpsNavigationMessageEvent;)V");
 
+    // The packed callbacks are optional, fall back to the object based ones without them
+    method_reportLocationBatch = env->GetMethodID(clazz, "reportLocationBatch", "(I[D[J)V");
+    if (method_reportLocationBatch == NULL) {
+        env->ExceptionClear();
+    }
+    method_reportSvStatusPacked = env->GetMethodID(clazz, "reportSvStatusPacked", "(I[I[F)V");
+    if (method_reportSvStatusPacked == NULL) {
+        env->ExceptionClear();
+    }
+    method_reportMeasurementDataPacked = env->GetMethodID(
+            clazz, "reportMeasurementDataPacked", "(I[J[D)V");
+    if (method_reportMeasurementDataPacked == NULL) {
+        env->ExceptionClear();
+    }
+
     err = hw_get_module(GPS_HARDWARE_MODULE_ID, (hw_module_t const**)&module);
     if (err == 0) {
         hw_device_t* device;
@@ -588,8 +712,12 @@ static jboolean android_location_GpsLocationProvider_start(JNIEnv* /* env */, jo
         return JNI_FALSE;
 }
 
-static jboolean android_location_GpsLocationProvider_stop(JNIEnv* /* env */, jobject /* obj */)
+static jboolean android_location_GpsLocationProvider_stop(JNIEnv* env, jobject /* obj */)
 {
+    // don't sit on batched fixes once the session ends
+    pthread_mutex_lock(&sLocationBatchLock);
+    deliver_location_batch_locked(env);
+
     if (sGpsInterface) {
         if (sGpsInterface->stop() == 0) {
             return JNI_TRUE;
@@ -609,6 +737,27 @@ static void android_location_GpsLocationProvider_delete_aiding_data(JNIEnv* /* e
         sGpsInterface->delete_aiding_data(flags);
 }
 
+static jboolean android_location_GpsLocationProvider_set_location_batch_size(JNIEnv* env,
+        jobject /* obj */, jint batchSize)
+{
+    if (method_reportLocationBatch == NULL || batchSize < 0
+            || batchSize > MAX_LOCATION_BATCH_SIZE) {
+        return JNI_FALSE;
+    }
+    pthread_mutex_lock(&sLocationBatchLock);
+    sLocationBatchSize = batchSize;
+    // deliver what was batched with the previous size
+    deliver_location_batch_locked(env);
+    return JNI_TRUE;
+}
+
+static void android_location_GpsLocationProvider_flush_location_batch(JNIEnv* env,
+        jobject /* obj */)
+{
+    pthread_mutex_lock(&sLocationBatchLock);
+    deliver_location_batch_locked(env);
+}
+
 static jint android_location_GpsLocationProvider_read_sv_status(JNIEnv* env, jobject /* obj */,
         jintArray prnArray, jfloatArray snrArray, jfloatArray elevArray, jfloatArray azumArray,
         jintArray maskArray)
@@ -1232,6 +1381,151 @@ static jobjectArray translate_gps_measurements(JNIEnv* env, GpsData* data) {
     return gpsMeasurementArray;
 }
 
+// Packed measurement layout used by reportMeasurementDataPacked(), keep in sync with
+// GpsLocationProvider.java. The clock comes first in both arrays, followed by one fixed
+// size record per measurement. Optional values are only meaningful if the matching
+// GPS_CLOCK_HAS_* / GPS_MEASUREMENT_HAS_* bit is set in the packed flags.
+enum {
+    CLOCK_LONG_FLAGS,
+    CLOCK_LONG_LEAP_SECOND,
+    CLOCK_LONG_TYPE,
+    CLOCK_LONG_TIME_NS,
+    CLOCK_LONG_FULL_BIAS_NS,
+    CLOCK_LONG_COUNT
+};
+enum {
+    CLOCK_DOUBLE_TIME_UNCERTAINTY_NS,
+    CLOCK_DOUBLE_BIAS_NS,
+    CLOCK_DOUBLE_BIAS_UNCERTAINTY_NS,
+    CLOCK_DOUBLE_DRIFT_NSPS,
+    CLOCK_DOUBLE_DRIFT_UNCERTAINTY_NSPS,
+    CLOCK_DOUBLE_COUNT
+};
+enum {
+    MEASUREMENT_LONG_FLAGS,
+    MEASUREMENT_LONG_PRN,
+    MEASUREMENT_LONG_STATE,
+    MEASUREMENT_LONG_RECEIVED_GPS_TOW_NS,
+    MEASUREMENT_LONG_RECEIVED_GPS_TOW_UNCERTAINTY_NS,
+    MEASUREMENT_LONG_ACCUMULATED_DELTA_RANGE_STATE,
+    MEASUREMENT_LONG_CARRIER_CYCLES,
+    MEASUREMENT_LONG_LOSS_OF_LOCK,
+    MEASUREMENT_LONG_BIT_NUMBER,
+    MEASUREMENT_LONG_TIME_FROM_LAST_BIT_MS,
+    MEASUREMENT_LONG_MULTIPATH_INDICATOR,
+    MEASUREMENT_LONG_USED_IN_FIX,
+    MEASUREMENT_LONG_COUNT
+};
+enum {
+    MEASUREMENT_DOUBLE_TIME_OFFSET_NS,
+    MEASUREMENT_DOUBLE_C_N0_DBHZ,
+    MEASUREMENT_DOUBLE_PSEUDORANGE_RATE_MPS,
+    MEASUREMENT_DOUBLE_PSEUDORANGE_RATE_UNCERTAINTY_MPS,
+    MEASUREMENT_DOUBLE_ACCUMULATED_DELTA_RANGE_M,
+    MEASUREMENT_DOUBLE_ACCUMULATED_DELTA_RANGE_UNCERTAINTY_M,
+    MEASUREMENT_DOUBLE_PSEUDORANGE_M,
+    MEASUREMENT_DOUBLE_PSEUDORANGE_UNCERTAINTY_M,
+    MEASUREMENT_DOUBLE_CODE_PHASE_CHIPS,
+    MEASUREMENT_DOUBLE_CODE_PHASE_UNCERTAINTY_CHIPS,
+    MEASUREMENT_DOUBLE_CARRIER_FREQUENCY_HZ,
+    MEASUREMENT_DOUBLE_CARRIER_PHASE,
+    MEASUREMENT_DOUBLE_CARRIER_PHASE_UNCERTAINTY,
+    MEASUREMENT_DOUBLE_DOPPLER_SHIFT_HZ,
+    MEASUREMENT_DOUBLE_DOPPLER_SHIFT_UNCERTAINTY_HZ,
+    MEASUREMENT_DOUBLE_SNR_DB,
+    MEASUREMENT_DOUBLE_ELEVATION_DEG,
+    MEASUREMENT_DOUBLE_ELEVATION_UNCERTAINTY_DEG,
+    MEASUREMENT_DOUBLE_AZIMUTH_DEG,
+    MEASUREMENT_DOUBLE_AZIMUTH_UNCERTAINTY_DEG,
+    MEASUREMENT_DOUBLE_COUNT
+};
+
+// Delivers a measurement epoch as two primitive arrays with a single upcall, instead of
+// building GpsClock and GpsMeasurement objects through one setter call per field.
+static bool report_measurements_packed(JNIEnv* env, const GpsData* data) {
+    size_t count = data->measurement_count;
+    if (count > GPS_MAX_MEASUREMENT) {
+        count = GPS_MAX_MEASUREMENT;
+    }
+
+    jlong longs[CLOCK_LONG_COUNT + GPS_MAX_MEASUREMENT * MEASUREMENT_LONG_COUNT];
+    jdouble doubles[CLOCK_DOUBLE_COUNT + GPS_MAX_MEASUREMENT * MEASUREMENT_DOUBLE_COUNT];
+
+    const GpsClock& clock = data->clock;
+    longs[CLOCK_LONG_FLAGS] = clock.flags;
+    longs[CLOCK_LONG_LEAP_SECOND] = clock.leap_second;
+    longs[CLOCK_LONG_TYPE] = clock.type;
+    longs[CLOCK_LONG_TIME_NS] = clock.time_ns;
+    longs[CLOCK_LONG_FULL_BIAS_NS] = clock.full_bias_ns;
+    doubles[CLOCK_DOUBLE_TIME_UNCERTAINTY_NS] = clock.time_uncertainty_ns;
+    doubles[CLOCK_DOUBLE_BIAS_NS] = clock.bias_ns;
+    doubles[CLOCK_DOUBLE_BIAS_UNCERTAINTY_NS] = clock.bias_uncertainty_ns;
+    doubles[CLOCK_DOUBLE_DRIFT_NSPS] = clock.drift_nsps;
+    doubles[CLOCK_DOUBLE_DRIFT_UNCERTAINTY_NSPS] = clock.drift_uncertainty_nsps;
+
+    for (size_t i = 0; i < count; i++) {
+        const GpsMeasurement& m = data->measurements[i];
+        jlong* l = &longs[CLOCK_LONG_COUNT + i * MEASUREMENT_LONG_COUNT];
+        jdouble* d = &doubles[CLOCK_DOUBLE_COUNT + i * MEASUREMENT_DOUBLE_COUNT];
+
+        l[MEASUREMENT_LONG_FLAGS] = m.flags;
+        l[MEASUREMENT_LONG_PRN] = m.prn;
+        l[MEASUREMENT_LONG_STATE] = m.state;
+        l[MEASUREMENT_LONG_RECEIVED_GPS_TOW_NS] = m.received_gps_tow_ns;
+        l[MEASUREMENT_LONG_RECEIVED_GPS_TOW_UNCERTAINTY_NS] = m.received_gps_tow_uncertainty_ns;
+        l[MEASUREMENT_LONG_ACCUMULATED_DELTA_RANGE_STATE] = m.accumulated_delta_range_state;
+        l[MEASUREMENT_LONG_CARRIER_CYCLES] = m.carrier_cycles;
+        l[MEASUREMENT_LONG_LOSS_OF_LOCK] = m.loss_of_lock;
+        l[MEASUREMENT_LONG_BIT_NUMBER] = m.bit_number;
+        l[MEASUREMENT_LONG_TIME_FROM_LAST_BIT_MS] = m.time_from_last_bit_ms;
+        l[MEASUREMENT_LONG_MULTIPATH_INDICATOR] = m.multipath_indicator;
+        l[MEASUREMENT_LONG_USED_IN_FIX] =
+                (m.flags & GPS_MEASUREMENT_HAS_USED_IN_FIX) && m.used_in_fix;
+
+        d[MEASUREMENT_DOUBLE_TIME_OFFSET_NS] = m.time_offset_ns;
+        d[MEASUREMENT_DOUBLE_C_N0_DBHZ] = m.c_n0_dbhz;
+        d[MEASUREMENT_DOUBLE_PSEUDORANGE_RATE_MPS] = m.pseudorange_rate_mps;
+        d[MEASUREMENT_DOUBLE_PSEUDORANGE_RATE_UNCERTAINTY_MPS] = m.pseudorange_rate_uncertainty_mps;
+        d[MEASUREMENT_DOUBLE_ACCUMULATED_DELTA_RANGE_M] = m.accumulated_delta_range_m;
+        d[MEASUREMENT_DOUBLE_ACCUMULATED_DELTA_RANGE_UNCERTAINTY_M] =
+                m.accumulated_delta_range_uncertainty_m;
+        d[MEASUREMENT_DOUBLE_PSEUDORANGE_M] = m.pseudorange_m;
+        d[MEASUREMENT_DOUBLE_PSEUDORANGE_UNCERTAINTY_M] = m.pseudorange_uncertainty_m;
+        d[MEASUREMENT_DOUBLE_CODE_PHASE_CHIPS] = m.code_phase_chips;
+        d[MEASUREMENT_DOUBLE_CODE_PHASE_UNCERTAINTY_CHIPS] = m.code_phase_uncertainty_chips;
+        d[MEASUREMENT_DOUBLE_CARRIER_FREQUENCY_HZ] = m.carrier_frequency_hz;
+        d[MEASUREMENT_DOUBLE_CARRIER_PHASE] = m.carrier_phase;
+        d[MEASUREMENT_DOUBLE_CARRIER_PHASE_UNCERTAINTY] = m.carrier_phase_uncertainty;
+        d[MEASUREMENT_DOUBLE_DOPPLER_SHIFT_HZ] = m.doppler_shift_hz;
+        d[MEASUREMENT_DOUBLE_DOPPLER_SHIFT_UNCERTAINTY_HZ] = m.doppler_shift_uncertainty_hz;
+        d[MEASUREMENT_DOUBLE_SNR_DB] = m.snr_db;
+        d[MEASUREMENT_DOUBLE_ELEVATION_DEG] = m.elevation_deg;
+        d[MEASUREMENT_DOUBLE_ELEVATION_UNCERTAINTY_DEG] = m.elevation_uncertainty_deg;
+        d[MEASUREMENT_DOUBLE_AZIMUTH_DEG] = m.azimuth_deg;
+        d[MEASUREMENT_DOUBLE_AZIMUTH_UNCERTAINTY_DEG] = m.azimuth_uncertainty_deg;
+    }
+
+    const jsize longCount = CLOCK_LONG_COUNT + count * MEASUREMENT_LONG_COUNT;
+    const jsize doubleCount = CLOCK_DOUBLE_COUNT + count * MEASUREMENT_DOUBLE_COUNT;
+    jlongArray longArray = env->NewLongArray(longCount);
+    jdoubleArray doubleArray = env->NewDoubleArray(doubleCount);
+    if (longArray == NULL || doubleArray == NULL) {
+        env->ExceptionClear();
+        env->DeleteLocalRef(longArray);
+        env->DeleteLocalRef(doubleArray);
+        return false;
+    }
+    env->SetLongArrayRegion(longArray, 0, longCount, longs);
+    env->SetDoubleArrayRegion(doubleArray, 0, doubleCount, doubles);
+
+    env->CallVoidMethod(mCallbacksObj, method_reportMeasurementDataPacked,
+            (jint) count, longArray, doubleArray);
+    checkAndClearExceptionFromCallback(env, __FUNCTION__);
+    env->DeleteLocalRef(longArray);
+    env->DeleteLocalRef(doubleArray);
+    return true;
+}
+
 static void measurement_callback(GpsData* data) {
     JNIEnv* env = AndroidRuntime::getJNIEnv();
     if (data == NULL) {
@@ -1239,6 +1533,11 @@ static void measurement_callback(GpsData* data) {
         return;
     }
 
+    if (data->size == sizeof(GpsData) && method_reportMeasurementDataPacked != NULL
+            && report_measurements_packed(env, data)) {
+        return;
+    }
+
     if (data->size == sizeof(GpsData)) {
         jobject gpsClock = translate_gps_clock(env, &data->clock);
         jobjectArray measurementArray = translate_gps_measurements(env, data);
@@ -1530,8 +1829,23 @@ static JNINativeMethod sMethods[] = {
             (void*)android_location_GpsLocationProvider_configuration_update},
 };
 
+// Natives whose Java declarations may not be present.
+static JNINativeMethod sOptionalMethods[] = {
+    {"native_set_location_batch_size",
+            "(I)Z",
+            (void*)android_location_GpsLocationProvider_set_location_batch_size},
+    {"native_flush_location_batch",
+            "()V",
+            (void*)android_location_GpsLocationProvider_flush_location_batch},
+};
+
 int register_android_server_location_GpsLocationProvider(JNIEnv* env)
 {
+    AndroidRuntime::registerOptionalNativeMethods(
+            env,
+            "com/android/server/location/GpsLocationProvider",
+            sOptionalMethods,
+            NELEM(sOptionalMethods));
     return jniRegisterNativeMethods(
             env,
             "com/android/server/location/GpsLocationProvider",
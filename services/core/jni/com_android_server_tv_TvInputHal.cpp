@@ -27,9 +27,11 @@
 #include <gui/Surface.h>
 #include <utils/Errors.h>
 #include <utils/KeyedVector.h>
+#include <utils/List.h>
 #include <utils/Log.h>
 #include <utils/Looper.h>
 #include <utils/NativeHandle.h>
+#include <utils/Vector.h>
 #include <hardware/tv_input.h>
 
 namespace android {
@@ -71,6 +73,9 @@ static struct {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Number of buffers the HAL may be capturing into at once
+static const size_t MAX_CAPTURES_IN_FLIGHT = 3;
+
 class BufferProducerThread : public Thread {
 public:
     BufferProducerThread(tv_input_device_t* device, int deviceId, const tv_stream_t* stream);
@@ -82,24 +87,31 @@ public:
     void shutdown();
 
 private:
+    struct Capture {
+        sp<ANativeWindowBuffer_t> buffer;
+        uint32_t seq;
+        enum {
+            CAPTURING,
+            CAPTURED,
+            FAILED,
+        } state;
+    };
+
     Mutex mLock;
     Condition mCondition;
     sp<Surface> mSurface;
     tv_input_device_t* mDevice;
     int mDeviceId;
     tv_stream_t mStream;
-    sp<ANativeWindowBuffer_t> mBuffer;
-    enum {
-        CAPTURING,
-        CAPTURED,
-        RELEASED,
-    } mBufferState;
+    // Outstanding captures in request order, queued to the surface in that order
+    List<Capture> mCaptures;
     uint32_t mSeq;
     bool mShutdown;
 
     virtual bool threadLoop();
 
     void setSurfaceLocked(const sp<Surface>& surface);
+    bool hasPendingCaptureLocked() const;
 };
 
 BufferProducerThread::BufferProducerThread(
@@ -107,8 +119,6 @@ BufferProducerThread::BufferProducerThread(
     : Thread(false),
       mDevice(device),
       mDeviceId(deviceId),
-      mBuffer(NULL),
-      mBufferState(RELEASED),
       mSeq(0u),
       mShutdown(false) {
     memcpy(&mStream, stream, sizeof(mStream));
@@ -137,23 +147,53 @@ void BufferProducerThread::setSurface(const sp<Surface>& surface) {
     setSurfaceLocked(surface);
 }
 
+bool BufferProducerThread::hasPendingCaptureLocked() const {
+    for (List<Capture>::const_iterator it = mCaptures.begin(); it != mCaptures.end(); ++it) {
+        if (it->state == Capture::CAPTURING) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void BufferProducerThread::setSurfaceLocked(const sp<Surface>& surface) {
     if (surface == mSurface) {
         return;
     }
 
-    if (mBufferState == CAPTURING) {
-        mDevice->cancel_capture(mDevice, mDeviceId, mStream.stream_id, mSeq);
+    Vector<uint32_t> pendingSeqs;
+    for (List<Capture>::iterator it = mCaptures.begin(); it != mCaptures.end(); ++it) {
+        if (it->state == Capture::CAPTURING) {
+            pendingSeqs.push(it->seq);
+        }
+    }
+    if (!pendingSeqs.isEmpty()) {
+        // The HAL may report the cancellation from within cancel_capture
+        mLock.unlock();
+        for (size_t i = 0; i < pendingSeqs.size(); i++) {
+            mDevice->cancel_capture(mDevice, mDeviceId, mStream.stream_id, pendingSeqs[i]);
+        }
+        mLock.lock();
     }
-    while (mBufferState == CAPTURING) {
+    while (hasPendingCaptureLocked()) {
         status_t err = mCondition.waitRelative(mLock, s2ns(1));
         if (err != NO_ERROR) {
             ALOGE("error %d while wating for buffer state to change.", err);
             break;
         }
     }
-    mBuffer.clear();
-    mBufferState = RELEASED;
+    mCaptures.clear();
+
+    if (surface != NULL) {
+        // Leave room for every in-flight capture on top of what the consumer holds
+        sp<ANativeWindow> anw(surface);
+        int minUndequeuedBuffers = 0;
+        if (anw->query(anw.get(), NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS,
+                &minUndequeuedBuffers) == NO_ERROR) {
+            native_window_set_buffer_count(anw.get(),
+                    minUndequeuedBuffers + MAX_CAPTURES_IN_FLIGHT);
+        }
+    }
 
     mSurface = surface;
     mCondition.broadcast();
@@ -161,19 +201,18 @@ void BufferProducerThread::setSurfaceLocked(const sp<Surface>& surface) {
 
 void BufferProducerThread::onCaptured(uint32_t seq, bool succeeded) {
     Mutex::Autolock autoLock(&mLock);
-    if (seq != mSeq) {
-        ALOGW("Incorrect sequence value: expected %u actual %u", mSeq, seq);
-    }
-    if (mBufferState != CAPTURING) {
-        ALOGW("mBufferState != CAPTURING : instead %d", mBufferState);
-    }
-    if (succeeded) {
-        mBufferState = CAPTURED;
-    } else {
-        mBuffer.clear();
-        mBufferState = RELEASED;
+    for (List<Capture>::iterator it = mCaptures.begin(); it != mCaptures.end(); ++it) {
+        if (it->seq != seq) {
+            continue;
+        }
+        if (it->state != Capture::CAPTURING) {
+            ALOGW("capture %u reported twice", seq);
+        }
+        it->state = succeeded ? Capture::CAPTURED : Capture::FAILED;
+        mCondition.broadcast();
+        return;
     }
-    mCondition.broadcast();
+    ALOGW("Unknown capture sequence value %u", seq);
 }
 
 void BufferProducerThread::shutdown() {
@@ -197,33 +236,50 @@ bool BufferProducerThread::threadLoop() {
         return true;
     }
     sp<ANativeWindow> anw(mSurface);
-    while (mBufferState == CAPTURING) {
-        err = mCondition.waitRelative(mLock, s2ns(1));
-        if (err != NO_ERROR) {
-            ALOGE("error %d while wating for buffer state to change.", err);
-            return false;
-        }
-    }
-    if (mBufferState == CAPTURED && anw != NULL) {
-        err = anw->queueBuffer(anw.get(), mBuffer.get(), -1);
-        if (err != NO_ERROR) {
-            ALOGE("error %d while queueing buffer to surface", err);
-            return false;
+
+    // Hand finished buffers to the surface in the order they were requested
+    while (!mCaptures.empty() && mCaptures.begin()->state != Capture::CAPTURING) {
+        Capture& capture = *mCaptures.begin();
+        if (capture.state == Capture::CAPTURED) {
+            err = anw->queueBuffer(anw.get(), capture.buffer.get(), -1);
+            if (err != NO_ERROR) {
+                ALOGE("error %d while queueing buffer to surface", err);
+                return false;
+            }
+        } else {
+            anw->cancelBuffer(anw.get(), capture.buffer.get(), -1);
         }
-        mBuffer.clear();
-        mBufferState = RELEASED;
+        mCaptures.erase(mCaptures.begin());
     }
-    if (mBuffer == NULL && !mShutdown && anw != NULL) {
+
+    if (mCaptures.size() < MAX_CAPTURES_IN_FLIGHT && !mShutdown) {
         ANativeWindowBuffer_t* buffer = NULL;
         err = native_window_dequeue_buffer_and_wait(anw.get(), &buffer);
         if (err != NO_ERROR) {
             ALOGE("error %d while dequeueing buffer to surface", err);
             return false;
         }
-        mBuffer = buffer;
-        mBufferState = CAPTURING;
+        Capture capture;
+        capture.buffer = buffer;
+        capture.seq = ++mSeq;
+        capture.state = Capture::CAPTURING;
+        mCaptures.push_back(capture);
+
+        // The HAL may complete the capture from within request_capture
+        mLock.unlock();
         mDevice->request_capture(mDevice, mDeviceId, mStream.stream_id,
-                                 buffer->handle, ++mSeq);
+                                 buffer->handle, capture.seq);
+        mLock.lock();
+        return true;
+    }
+
+    // Every buffer is in flight, wait for the oldest one
+    if (!mCaptures.empty() && mCaptures.begin()->state == Capture::CAPTURING) {
+        err = mCondition.waitRelative(mLock, s2ns(1));
+        if (err != NO_ERROR) {
+            ALOGE("error %d while wating for buffer state to change.", err);
+            return false;
+        }
     }
 
     return true;
@@ -245,6 +301,7 @@ public:
     void onDeviceUnavailable(int deviceId);
     void onStreamConfigurationsChanged(int deviceId);
     void onCaptured(int deviceId, int streamId, uint32_t seq, bool succeeded);
+    void onFirstFrameCaptured(int deviceId, int streamId);
 
 private:
     // Connection between a surface and a stream.
@@ -448,6 +505,18 @@ const tv_stream_config_t* JTvInputHal::getStreamConfigs(int deviceId, int* numCo
 void JTvInputHal::notify(
         tv_input_device_t* dev, tv_input_event_t* event, void* data) {
     JTvInputHal* thiz = (JTvInputHal*)data;
+    if (event->type == TV_INPUT_EVENT_CAPTURE_SUCCEEDED ||
+            event->type == TV_INPUT_EVENT_CAPTURE_FAILED) {
+        // Completed buffers go straight to the producer thread; only the Java
+        // callback for the first frame needs the looper.
+        thiz->onCaptured(event->capture_result.device_id,
+                         event->capture_result.stream_id,
+                         event->capture_result.seq,
+                         event->type == TV_INPUT_EVENT_CAPTURE_SUCCEEDED);
+        if (event->capture_result.seq != 0) {
+            return;
+        }
+    }
     thiz->mLooper->sendMessage(new NotifyHandler(thiz, event), event->type);
 }
 
@@ -549,14 +618,15 @@ void JTvInputHal::onCaptured(int deviceId, int streamId, uint32_t seq, bool succ
         thread = connection.mThread;
     }
     thread->onCaptured(seq, succeeded);
-    if (seq == 0) {
-        JNIEnv* env = AndroidRuntime::getJNIEnv();
-        env->CallVoidMethod(
-                mThiz,
-                gTvInputHalClassInfo.firstFrameCaptured,
-                deviceId,
-                streamId);
-    }
+}
+
+void JTvInputHal::onFirstFrameCaptured(int deviceId, int streamId) {
+    JNIEnv* env = AndroidRuntime::getJNIEnv();
+    env->CallVoidMethod(
+            mThiz,
+            gTvInputHalClassInfo.firstFrameCaptured,
+            deviceId,
+            streamId);
 }
 
 JTvInputHal::NotifyHandler::NotifyHandler(JTvInputHal* hal, const tv_input_event_t* event) {
@@ -584,17 +654,11 @@ void JTvInputHal::NotifyHandler::handleMessage(const Message& message) {
         case TV_INPUT_EVENT_STREAM_CONFIGURATIONS_CHANGED: {
             mHal->onStreamConfigurationsChanged(mEvent.device_info.device_id);
         } break;
-        case TV_INPUT_EVENT_CAPTURE_SUCCEEDED: {
-            mHal->onCaptured(mEvent.capture_result.device_id,
-                             mEvent.capture_result.stream_id,
-                             mEvent.capture_result.seq,
-                             true /* succeeded */);
-        } break;
+        case TV_INPUT_EVENT_CAPTURE_SUCCEEDED:
         case TV_INPUT_EVENT_CAPTURE_FAILED: {
-            mHal->onCaptured(mEvent.capture_result.device_id,
-                             mEvent.capture_result.stream_id,
-                             mEvent.capture_result.seq,
-                             false /* succeeded */);
+            // Already delivered to the producer thread by notify()
+            mHal->onFirstFrameCaptured(mEvent.capture_result.device_id,
+                                       mEvent.capture_result.stream_id);
         } break;
         default:
             ALOGE("Unrecognizable event");
@@ -7,13 +7,17 @@
 #include "AaptUtil.h"
 #include "Main.h"
 #include "ResourceFilter.h"
+#include "WorkQueue.h"
 
 #include <utils/misc.h>
 #include <utils/SortedVector.h>
+#include <utils/threads.h>
 
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 static const char* kAssetDir = "assets";
 static const char* kResourceDir = "res";
@@ -21,9 +25,14 @@ static const char* kValuesDir = "values";
 static const char* kMipmapDir = "mipmap";
 static const char* kInvalidChars = "/\\:";
 static const size_t kMaxAssetFileName = 100;
+static const size_t kMaxScanThreads = 4;
 
 static const String8 kResString(kResourceDir);
 
+// isHidden() is also called by the DirScan threads, and strtok() isn't
+// reentrant.
+static Mutex gIgnorePatternsLock;
+
 /*
  * Names of asset files must meet the following criteria:
  *
@@ -62,7 +71,7 @@ const char * const gDefaultIgnoreAssets =
 // The ignore pattern that can be passed via --ignore-assets in Main.cpp
 const char * gUserIgnoreAssets = NULL;
 
-static bool isHidden(const char *root, const char *path)
+static bool isHidden(const char *path, FileType type, bool report)
 {
     // Patterns syntax:
     // - Delimiter is :
@@ -91,14 +100,11 @@ static bool isHidden(const char *root, const char *path)
     }
     char *patterns = strdup(p);
 
+    AutoMutex _l(gIgnorePatternsLock);
     bool ignore = false;
     bool chatty = true;
     char *matchedPattern = NULL;
 
-    String8 fullPath(root);
-    fullPath.appendPath(path);
-    FileType type = getFileType(fullPath);
-
     int plen = strlen(path);
 
     // Note: we don't have strtok_r under mingw.
@@ -134,7 +140,7 @@ static bool isHidden(const char *root, const char *path)
         }
     }
 
-    if (ignore && chatty) {
+    if (ignore && chatty && report) {
         fprintf(stderr, "    (skipping %s '%s' due to ANDROID_AAPT_IGNORE pattern '%s')\n",
                 type == kFileTypeDirectory ? "dir" : "file",
                 path,
@@ -145,6 +151,192 @@ static bool isHidden(const char *root, const char *path)
     return ignore;
 }
 
+/*
+ * The entries of one directory, in the order readdir() returned them,
+ * without "." and "..".
+ */
+struct DirListing : public RefBase
+{
+    int err;                // errno of a failed opendir(), 0 otherwise
+    Vector<String8> names;
+    Vector<FileType> types;
+
+    DirListing() : err(0) { }
+};
+
+static FileType getEntryType(DIR* dir, const String8& dirPath, const char* name)
+{
+#if !defined(_WIN32)
+    // Relative to the open directory, saves resolving the whole path per entry.
+    struct stat st;
+    if (fstatat(dirfd(dir), name, &st, 0) < 0) {
+        return (errno == ENOENT || errno == ENOTDIR) ? kFileTypeNonexistent : kFileTypeUnknown;
+    }
+    if (S_ISREG(st.st_mode)) {
+        return kFileTypeRegular;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return kFileTypeDirectory;
+    }
+    return kFileTypeUnknown;
+#else
+    (void) dir;
+    return getFileType(dirPath.appendPathCopy(String8(name)).string());
+#endif
+}
+
+static sp<DirListing> readDirListing(const String8& dirPath)
+{
+    sp<DirListing> listing = new DirListing();
+    DIR* dir = opendir(dirPath.string());
+    if (dir == NULL) {
+        listing->err = errno;
+        return listing;
+    }
+
+    while (1) {
+        struct dirent* entry = readdir(dir);
+        if (entry == NULL) {
+            break;
+        }
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        listing->names.add(String8(entry->d_name));
+        listing->types.add(getEntryType(dir, dirPath, entry->d_name));
+    }
+    closedir(dir);
+    return listing;
+}
+
+/*
+ * Lists whole source trees on a WorkQueue ahead of the slurp functions, which
+ * would otherwise wait on every opendir() and stat() in turn. Directories
+ * matching the ignore patterns aren't descended into.
+ *
+ * The slurp functions still visit the listings in order on the calling thread
+ * and do all the building and printing; takeListing() only saves them the
+ * filesystem round trips. A tree scanned here is only read once, each listing
+ * is dropped when taken.
+ */
+class DirScan
+{
+public:
+    DirScan() : mWorkQueue(kMaxScanThreads, false), mCanceled(false) {
+        sCurrent = this;
+    }
+
+    ~DirScan() {
+        {
+            AutoMutex _l(mLock);
+            mCanceled = true;
+        }
+        mWorkQueue.cancel();
+        mWorkQueue.finish();
+        sCurrent = NULL;
+    }
+
+    void scan(const String8& root) {
+        schedule(root);
+    }
+
+    /*
+     * Returns the listing of dirPath if it's in one of the scanned trees,
+     * waiting for it if needed, or NULL if it isn't.
+     */
+    static sp<DirListing> takeListing(const String8& dirPath) {
+        if (sCurrent == NULL) {
+            return NULL;
+        }
+        return sCurrent->take(dirPath);
+    }
+
+private:
+    class ScanWorkUnit : public WorkQueue::WorkUnit {
+    public:
+        ScanWorkUnit(DirScan* scan, const String8& dirPath) : mScan(scan), mDirPath(dirPath) { }
+
+        virtual bool run() {
+            mScan->scanDir(mDirPath);
+            return true;
+        }
+
+    private:
+        DirScan* mScan;
+        String8 mDirPath;
+    };
+
+    void schedule(const String8& dirPath) {
+        {
+            AutoMutex _l(mLock);
+            if (mCanceled || mListings.indexOfKey(dirPath) >= 0) {
+                return;
+            }
+            // Taken as "still being listed" until the listing is stored.
+            mListings.add(dirPath, NULL);
+        }
+
+        ScanWorkUnit* w = new ScanWorkUnit(this, dirPath);
+        // No backlog, a work unit doesn't wait for the units it schedules.
+        if (mWorkQueue.schedule(w, 0) != NO_ERROR) {
+            w->run();
+            delete w;
+        }
+    }
+
+    void scanDir(const String8& dirPath) {
+        sp<DirListing> listing = readDirListing(dirPath);
+
+        // Subdirectories are known before the listing is published, so
+        // takeListing() never misses one that is still to be listed.
+        const size_t N = listing->names.size();
+        for (size_t i = 0; i < N; i++) {
+            if (listing->types[i] == kFileTypeDirectory
+                    && !isHidden(listing->names[i].string(), kFileTypeDirectory, false)) {
+                schedule(dirPath.appendPathCopy(listing->names[i]));
+            }
+        }
+
+        AutoMutex _l(mLock);
+        mListings.replaceValueFor(dirPath, listing);
+        mListingAdded.broadcast();
+    }
+
+    sp<DirListing> take(const String8& dirPath) {
+        AutoMutex _l(mLock);
+        ssize_t index = mListings.indexOfKey(dirPath);
+        if (index < 0) {
+            return NULL;
+        }
+        while (mListings.valueAt(index) == NULL) {
+            mListingAdded.wait(mLock);
+            index = mListings.indexOfKey(dirPath);
+        }
+        sp<DirListing> listing = mListings.valueAt(index);
+        mListings.removeItemsAt(index);
+        return listing;
+    }
+
+    static DirScan* sCurrent;
+
+    WorkQueue mWorkQueue;
+    Mutex mLock;
+    Condition mListingAdded;
+    bool mCanceled;
+    KeyedVector<String8, sp<DirListing> > mListings;
+};
+
+DirScan* DirScan::sCurrent = NULL;
+
+static sp<DirListing> listDir(const String8& dirPath)
+{
+    sp<DirListing> listing = DirScan::takeListing(dirPath);
+    if (listing == NULL) {
+        listing = readDirListing(dirPath);
+    }
+    return listing;
+}
+
 // =========================================================================
 // =========================================================================
 // =========================================================================
@@ -392,9 +584,38 @@ void AaptLocaleValue::writeTo(ResTable_config* out) const {
     }
 }
 
+namespace {
+
+struct ParsedDirName {
+    String8 resType;
+    bool hasParams;     // names without qualifiers leave mParams alone
+    ConfigDescription params;
+};
+
+} // namespace
+
+// Every res directory of every library or overlay has the same few
+// qualifier sets, they are only parsed once.
+static Mutex gParsedDirNamesLock;
+static KeyedVector<String8, ParsedDirName> gParsedDirNames;
+
 bool
 AaptGroupEntry::initFromDirName(const char* dir, String8* resType)
 {
+    const String8 dirName(dir);
+    {
+        AutoMutex _l(gParsedDirNamesLock);
+        ssize_t index = gParsedDirNames.indexOfKey(dirName);
+        if (index >= 0) {
+            const ParsedDirName& parsed = gParsedDirNames.valueAt(index);
+            if (parsed.hasParams) {
+                mParams = parsed.params;
+            }
+            *resType = parsed.resType;
+            return true;
+        }
+    }
+
     const char* q = strchr(dir, '-');
     size_t typeLen;
     if (q != NULL) {
@@ -414,6 +635,16 @@ AaptGroupEntry::initFromDirName(const char* dir, String8* resType)
         }
     }
 
+    // Invalid names aren't cached, so their errors are reported every time.
+    ParsedDirName parsed;
+    parsed.resType = type;
+    parsed.hasParams = q != NULL;
+    parsed.params = mParams;
+    {
+        AutoMutex _l(gParsedDirNamesLock);
+        gParsedDirNames.add(dirName, parsed);
+    }
+
     *resType = type;
     return true;
 }
@@ -655,37 +886,31 @@ ssize_t AaptDir::slurpFullTree(Bundle* bundle, const String8& srcDir,
                             sp<FilePathStore>& fullResPaths, const bool overwrite)
 {
     Vector<String8> fileNames;
+    Vector<FileType> fileTypes;
     {
-        DIR* dir = NULL;
-
-        dir = opendir(srcDir.string());
-        if (dir == NULL) {
-            fprintf(stderr, "ERROR: opendir(%s): %s\n", srcDir.string(), strerror(errno));
+        sp<DirListing> listing = listDir(srcDir);
+        if (listing->err != 0) {
+            fprintf(stderr, "ERROR: opendir(%s): %s\n", srcDir.string(), strerror(listing->err));
             return UNKNOWN_ERROR;
         }
 
         /*
          * Slurp the filenames out of the directory.
          */
-        while (1) {
-            struct dirent* entry;
-
-            entry = readdir(dir);
-            if (entry == NULL)
-                break;
-
-            if (isHidden(srcDir.string(), entry->d_name))
+        const size_t NL = listing->names.size();
+        for (size_t i = 0; i < NL; i++) {
+            const String8& name = listing->names[i];
+            if (isHidden(name.string(), listing->types[i], true))
                 continue;
 
-            String8 name(entry->d_name);
             fileNames.add(name);
+            fileTypes.add(listing->types[i]);
             // Add fully qualified path for dependency purposes
             // if we're collecting them
             if (fullResPaths != NULL) {
                 fullResPaths->add(srcDir.appendPathCopy(name));
             }
         }
-        closedir(dir);
     }
 
     ssize_t count = 0;
@@ -697,10 +922,9 @@ ssize_t AaptDir::slurpFullTree(Bundle* bundle, const String8& srcDir,
     size_t i;
     for (i = 0; i < N; i++) {
         String8 pathName(srcDir);
-        FileType type;
+        const FileType type = fileTypes[i];
 
         pathName.appendPath(fileNames[i].string());
-        type = getFileType(pathName.string());
         if (type == kFileTypeDirectory) {
             sp<AaptDir> subdir;
             bool notAdded = false;
@@ -973,6 +1197,22 @@ ssize_t AaptAssets::slurpFromArgs(Bundle* bundle)
 
     const int N = bundle->getFileSpecCount();
 
+    /*
+     * Start listing all the source trees, they're slurped in order below.
+     */
+    DirScan dirScan;
+    for (size_t i = 0; i < bundle->getAssetSourceDirs().size(); i++) {
+        dirScan.scan(String8(bundle->getAssetSourceDirs()[i]));
+    }
+    for (size_t i = 0; i < dirCount; i++) {
+        if (resDirs[i]) {
+            dirScan.scan(String8(resDirs[i]));
+        }
+    }
+    for (int arg = 0; arg < N; arg++) {
+        dirScan.scan(String8(bundle->getFileSpecEntry(arg)));
+    }
+
     /*
      * If a package manifest was specified, include that first.
      */
@@ -1129,9 +1369,9 @@ ssize_t AaptAssets::slurpResourceTree(Bundle* bundle, const String8& srcDir)
 {
     ssize_t err = 0;
 
-    DIR* dir = opendir(srcDir.string());
-    if (dir == NULL) {
-        fprintf(stderr, "ERROR: opendir(%s): %s\n", srcDir.string(), strerror(errno));
+    sp<DirListing> listing = listDir(srcDir);
+    if (listing->err != 0) {
+        fprintf(stderr, "ERROR: opendir(%s): %s\n", srcDir.string(), strerror(listing->err));
         return UNKNOWN_ERROR;
     }
 
@@ -1141,25 +1381,24 @@ ssize_t AaptAssets::slurpResourceTree(Bundle* bundle, const String8& srcDir)
      * Run through the directory, looking for dirs that match the
      * expected pattern.
      */
-    while (1) {
-        struct dirent* entry = readdir(dir);
-        if (entry == NULL) {
-            break;
-        }
+    const size_t N = listing->names.size();
+    for (size_t i = 0; i < N; i++) {
+        const char* entryName = listing->names[i].string();
+        const FileType type = listing->types[i];
 
-        if (isHidden(srcDir.string(), entry->d_name)) {
+        if (isHidden(entryName, type, true)) {
             continue;
         }
 
         String8 subdirName(srcDir);
-        subdirName.appendPath(entry->d_name);
+        subdirName.appendPath(entryName);
 
         AaptGroupEntry group;
         String8 resType;
-        bool b = group.initFromDirName(entry->d_name, &resType);
+        bool b = group.initFromDirName(entryName, &resType);
         if (!b) {
             fprintf(stderr, "invalid resource directory name: %s %s\n", srcDir.string(),
-                    entry->d_name);
+                    entryName);
             err = -1;
             continue;
         }
@@ -1169,13 +1408,11 @@ ssize_t AaptAssets::slurpResourceTree(Bundle* bundle, const String8& srcDir)
             const char *verString = group.getVersionString().string();
             int dirVersionInt = atoi(verString + 1); // skip 'v' in version name
             if (dirVersionInt > maxResInt) {
-              fprintf(stderr, "max res %d, skipping %s\n", maxResInt, entry->d_name);
+              fprintf(stderr, "max res %d, skipping %s\n", maxResInt, entryName);
               continue;
             }
         }
 
-        FileType type = getFileType(subdirName.string());
-
         if (type == kFileTypeDirectory) {
             sp<AaptDir> dir = makeDir(resType);
             ssize_t res = dir->slurpFullTree(bundle, subdirName, group,
@@ -1204,9 +1441,6 @@ ssize_t AaptAssets::slurpResourceTree(Bundle* bundle, const String8& srcDir)
     }
 
 bail:
-    closedir(dir);
-    dir = NULL;
-
     if (err != 0) {
         return err;
     }
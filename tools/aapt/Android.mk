@@ -50,6 +50,7 @@ aaptSources := \
 aaptTests := \
     tests/AaptConfig_test.cpp \
     tests/AaptGroupEntry_test.cpp \
+    tests/CrunchCacheManifest_test.cpp \
     tests/Pseudolocales_test.cpp \
     tests/ResourceFilter_test.cpp \
     tests/ResourceTable_test.cpp
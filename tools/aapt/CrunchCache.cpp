@@ -8,13 +8,54 @@
 #include <utils/Vector.h>
 #include <utils/String8.h>
 
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
 #include "DirectoryWalker.h"
 #include "FileFinder.h"
 #include "CacheUpdater.h"
 #include "CrunchCache.h"
+#include "WorkQueue.h"
 
 using namespace android;
 
+// Name of the manifest in the cache directory, and the first line of its
+// current format. Each following line describes the source of one cached
+// file: "<hash> <size> <mod-time> <relative path>".
+static const char* kManifestName = "crunch-cache.manifest";
+static const char* kManifestHeader = "aapt-crunch-cache 1";
+
+namespace {
+
+struct StaleFile {
+    String8 relativePath;
+    CrunchCache::SourceInfo info;
+};
+
+/*
+ * Crunches one stale file, then describes its source for the manifest.
+ */
+class CrunchWorkUnit : public WorkQueue::WorkUnit {
+public:
+    CrunchWorkUnit(CacheUpdater* cu, const String8& source, const String8& dest,
+                   CrunchCache::SourceInfo* outInfo) :
+            mCacheUpdater(cu), mSource(source), mDest(dest), mOutInfo(outInfo) {
+    }
+
+    virtual bool run();
+
+private:
+    CacheUpdater* mCacheUpdater;
+    String8 mSource;
+    String8 mDest;
+    CrunchCache::SourceInfo* mOutInfo;
+};
+
+} // namespace
+
 CrunchCache::CrunchCache(String8 sourcePath, String8 destPath, FileFinder* ff)
     : mSourcePath(sourcePath), mDestPath(destPath), mSourceFiles(0), mDestFiles(0), mFileFinder(ff)
 {
@@ -28,9 +69,13 @@ CrunchCache::CrunchCache(String8 sourcePath, String8 destPath, FileFinder* ff)
     loadFiles();
 }
 
-size_t CrunchCache::crunch(CacheUpdater* cu, bool forceOverwrite)
+size_t CrunchCache::crunch(CacheUpdater* cu, bool forceOverwrite, size_t maxThreads)
 {
-    size_t numFilesUpdated = 0;
+    loadManifest();
+
+    // What the manifest will describe once the stale files are crunched.
+    KeyedVector<String8,SourceInfo> manifest;
+    Vector<StaleFile> staleFiles;
 
     // Iterate through the source files and compare to cache.
     // After processing a file, remove it from the source files and
@@ -50,11 +95,13 @@ size_t CrunchCache::crunch(CacheUpdater* cu, bool forceOverwrite)
             offset = 1;
         relativePath = String8(rPathPtr + offset);
 
-        if (forceOverwrite || needsUpdating(relativePath)) {
-            cu->processImage(mSourcePath.appendPathCopy(relativePath),
-                             mDestPath.appendPathCopy(relativePath));
-            numFilesUpdated++;
-            // crunchFile(relativePath);
+        SourceInfo info;
+        if (forceOverwrite || needsUpdating(relativePath, &info)) {
+            StaleFile staleFile;
+            staleFile.relativePath = relativePath;
+            staleFiles.push(staleFile);
+        } else if (info.isKnown()) {
+            manifest.add(relativePath, info);
         }
         // Delete this file from the source files and (if it exists) from the
         // dest files.
@@ -62,12 +109,47 @@ size_t CrunchCache::crunch(CacheUpdater* cu, bool forceOverwrite)
         mDestFiles.removeItem(mDestPath.appendPathCopy(relativePath));
     }
 
+    // Crunch the stale files. The work units keep pointers to the entries of
+    // staleFiles, which isn't modified until they're done.
+    const size_t numFilesUpdated = staleFiles.size();
+    if (maxThreads > 1 && numFilesUpdated > 1) {
+        WorkQueue wq(maxThreads, false);
+        for (size_t i = 0; i < numFilesUpdated; i++) {
+            StaleFile& staleFile = staleFiles.editItemAt(i);
+            CrunchWorkUnit* w = new CrunchWorkUnit(cu,
+                    mSourcePath.appendPathCopy(staleFile.relativePath),
+                    mDestPath.appendPathCopy(staleFile.relativePath),
+                    &staleFile.info);
+            if (wq.schedule(w) != NO_ERROR) {
+                // Crunch it here instead.
+                w->run();
+                delete w;
+            }
+        }
+        wq.finish();
+    } else {
+        for (size_t i = 0; i < numFilesUpdated; i++) {
+            StaleFile& staleFile = staleFiles.editItemAt(i);
+            CrunchWorkUnit(cu, mSourcePath.appendPathCopy(staleFile.relativePath),
+                    mDestPath.appendPathCopy(staleFile.relativePath), &staleFile.info).run();
+        }
+    }
+
+    for (size_t i = 0; i < numFilesUpdated; i++) {
+        if (staleFiles[i].info.isKnown()) {
+            manifest.add(staleFiles[i].relativePath, staleFiles[i].info);
+        }
+    }
+
     // Iterate through what's left of destFiles and delete leftovers
     while (mDestFiles.size() > 0) {
         cu->deleteFile(mDestFiles.keyAt(0));
         mDestFiles.removeItemsAt(0);
     }
 
+    mManifest = manifest;
+    saveManifest();
+
     // Update our knowledge of the files cache
     // both source and dest should be empty by now.
     loadFiles();
@@ -93,12 +175,147 @@ void CrunchCache::loadFiles()
     delete dw;
 }
 
-bool CrunchCache::needsUpdating(String8 relativePath) const
+bool CrunchCache::needsUpdating(String8 relativePath, SourceInfo* outInfo) const
 {
     // Retrieve modification dates for this file entry under the source and
     // cache directory trees. The vectors will return a modification date of 0
     // if the file doesn't exist.
-    time_t sourceDate = mSourceFiles.valueFor(mSourcePath.appendPathCopy(relativePath));
+    const String8 sourcePath = mSourcePath.appendPathCopy(relativePath);
+    time_t sourceDate = mSourceFiles.valueFor(sourcePath);
     time_t destDate = mDestFiles.valueFor(mDestPath.appendPathCopy(relativePath));
-    return sourceDate > destDate;
+
+    // If we know what the cached file was crunched from, compare the contents,
+    // the mod-times are meaningless in a fresh checkout.
+    ssize_t index = mManifest.indexOfKey(relativePath);
+    if (destDate != 0 && index >= 0) {
+        const SourceInfo& cached = mManifest.valueAt(index);
+        if (!describeFile(sourcePath, &cached, outInfo) || outInfo->hash != cached.hash) {
+            return true;
+        }
+        return false;
+    }
+
+    if (sourceDate > destDate) {
+        return true;
+    }
+
+    // Up to date, record its contents so the cache stays valid when copied.
+    describeFile(sourcePath, NULL, outInfo);
+    return false;
+}
+
+String8 CrunchCache::getManifestPath() const
+{
+    return mDestPath.appendPathCopy(String8(kManifestName));
+}
+
+void CrunchCache::loadManifest()
+{
+    mManifest.clear();
+
+    FILE* fp = fopen(getManifestPath().string(), "r");
+    if (fp == NULL) {
+        return;
+    }
+
+    char line[PATH_MAX + 128];
+    if (fgets(line, sizeof(line), fp) == NULL
+            || strncmp(line, kManifestHeader, strlen(kManifestHeader)) != 0
+            || line[strlen(kManifestHeader)] != '\n') {
+        fclose(fp);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        SourceInfo info;
+        uint64_t hash;
+        int64_t size;
+        int64_t modWhen;
+        int pathOffset = 0;
+        if (sscanf(line, "%" SCNx64 " %" SCNd64 " %" SCNd64 " %n",
+                   &hash, &size, &modWhen, &pathOffset) != 3 || pathOffset == 0) {
+            // A corrupt manifest only costs crunching again.
+            mManifest.clear();
+            break;
+        }
+
+        String8 relativePath(line + pathOffset);
+        if (relativePath.length() > 0
+                && relativePath.string()[relativePath.length() - 1] == '\n') {
+            relativePath.setTo(relativePath.string(), relativePath.length() - 1);
+        }
+
+        info.hash = hash;
+        info.size = size;
+        info.modWhen = (time_t) modWhen;
+        mManifest.add(relativePath, info);
+    }
+    fclose(fp);
+}
+
+void CrunchCache::saveManifest() const
+{
+    // Failing to write it only costs crunching again next time.
+    FILE* fp = fopen(getManifestPath().string(), "w");
+    if (fp == NULL) {
+        return;
+    }
+
+    fprintf(fp, "%s\n", kManifestHeader);
+    for (size_t i = 0; i < mManifest.size(); i++) {
+        const SourceInfo& info = mManifest.valueAt(i);
+        fprintf(fp, "%016" PRIx64 " %" PRId64 " %" PRId64 " %s\n",
+                info.hash, info.size, (int64_t) info.modWhen, mManifest.keyAt(i).string());
+    }
+    fclose(fp);
+}
+
+bool CrunchCache::describeFile(const String8& path, const SourceInfo* known,
+                               SourceInfo* outInfo)
+{
+    struct stat st;
+    if (stat(path.string(), &st) != 0) {
+        return false;
+    }
+
+    if (known != NULL && known->size == (int64_t) st.st_size
+            && known->modWhen == st.st_mtime) {
+        *outInfo = *known;
+        return true;
+    }
+
+    FILE* fp = fopen(path.string(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+
+    // 64-bit FNV-1a of the contents.
+    uint64_t hash = 14695981039346656037ULL;
+    unsigned char buf[32768];
+    size_t count;
+    while ((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            hash = (hash ^ buf[i]) * 1099511628211ULL;
+        }
+    }
+    bool error = ferror(fp) != 0;
+    fclose(fp);
+    if (error) {
+        return false;
+    }
+
+    outInfo->hash = hash;
+    outInfo->size = st.st_size;
+    outInfo->modWhen = st.st_mtime;
+    return true;
+}
+
+bool CrunchWorkUnit::run()
+{
+    mCacheUpdater->processImage(mSource, mDest);
+    CrunchCache::SourceInfo info;
+    if (CrunchCache::describeFile(mSource, NULL, &info)) {
+        *mOutInfo = info;
+    }
+    return true;
 }
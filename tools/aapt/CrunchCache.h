@@ -11,6 +11,7 @@
 
 #include <utils/KeyedVector.h>
 #include <utils/String8.h>
+#include <stdint.h>
 #include "FileFinder.h"
 #include "CacheUpdater.h"
 
@@ -21,6 +22,10 @@ using namespace android;
  *  them in a mirror-cache. It's capable of doing incremental updates to its
  *  cache.
  *
+ *  The cache keeps a manifest of the contents of the source files it was
+ *  crunched from, so that a cache copied to another checkout, where every
+ *  source file looks newer than the cache, is still up to date.
+ *
  *  Usage:
  *      Create an instance initialized with the root of the source tree, the
  *      root location to store the cache files, and an instance of a file finder.
@@ -43,7 +48,8 @@ public:
      * re-crunched even if they have not been modified recently. Otherwise,
      * source files are only crunched when they needUpdating. Afterwards,
      * we delete any leftover files in the cache that are no longer present
-     * in source.
+     * in source. If maxThreads is more than 1, the files are crunched on
+     * that many threads, and the CacheUpdater must be safe to call from them.
      *
      * PRECONDITIONS:
      *      No setup besides construction is needed
@@ -52,7 +58,27 @@ public:
      *      The function then returns the number of files changed in cache
      *      (counting deletions).
      */
-    size_t crunch(CacheUpdater* cu, bool forceOverwrite=false);
+    size_t crunch(CacheUpdater* cu, bool forceOverwrite=false, size_t maxThreads=1);
+
+    // What the manifest knows about the source of a cached file.
+    struct SourceInfo {
+        SourceInfo() : hash(0), size(-1), modWhen(0) {}
+
+        // Whether the file could be read.
+        bool isKnown() const { return size >= 0; }
+
+        uint64_t hash;
+        int64_t size;
+        time_t modWhen;
+    };
+
+    /** describeFile stats and hashes the file at path. If known describes
+     * the file as it was, and the file's size and mod-time didn't change, its
+     * hash is reused instead of reading the file.
+     * Returns false if the file can't be read.
+     */
+    static bool describeFile(const String8& path, const SourceInfo* known,
+                             SourceInfo* outInfo);
 
 private:
     /** loadFiles is a wrapper to the FileFinder that places matching
@@ -71,9 +97,14 @@ private:
      *
      * PRECONDITIONS:
      *      mSourceFiles and mDestFiles must be initialized and filled.
+     *      mManifest must be loaded.
      * POSTCONDITIONS:
-     *      returns true if and only if source file's modification time
-     *      is greater than the cached file's mod-time. Otherwise returns false.
+     *      If the manifest has an entry for the cached file, returns true if
+     *      and only if the source file's contents changed. Otherwise returns
+     *      true if and only if source file's modification time is greater
+     *      than the cached file's mod-time.
+     *      When it returns false, outInfo describes the source file, if it
+     *      could be read.
      *
      * USAGE:
      *      Should be used something like the following:
@@ -81,7 +112,17 @@ private:
      *          // Recrunch sourceFile out to destFile.
      *
      */
-    bool needsUpdating(String8 relativePath) const;
+    bool needsUpdating(String8 relativePath, SourceInfo* outInfo) const;
+
+    /** Reads the manifest of the cache into mManifest, leaving it empty if
+     * there is none or it's invalid.
+     */
+    void loadManifest();
+
+    /** Writes mManifest in the cache. */
+    void saveManifest() const;
+
+    String8 getManifestPath() const;
 
     // DATA MEMBERS ====================================================
 
@@ -95,6 +136,9 @@ private:
     DefaultKeyedVector<String8,time_t> mSourceFiles;
     DefaultKeyedVector<String8,time_t> mDestFiles;
 
+    // The sources of the files in the cache, keyed by their relative path.
+    KeyedVector<String8,SourceInfo> mManifest;
+
     // Pointer to a FileFinder to use
     FileFinder* mFileFinder;
 };
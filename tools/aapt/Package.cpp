@@ -8,6 +8,7 @@
 #include "OutputSet.h"
 #include "ResourceTable.h"
 #include "ResourceFilter.h"
+#include "WorkQueue.h"
 
 #include <androidfw/misc.h>
 
@@ -22,8 +23,16 @@
 #include <ctype.h>
 #include <errno.h>
 
+#include <queue>
+
 using namespace android;
 
+// Number of threads to use for compressing files.
+static const size_t MAX_THREADS = 4;
+
+// Number of files compressed ahead of the one being added to the archive.
+static const size_t MAX_PENDING_FILES = 4 * MAX_THREADS;
+
 static const char* kExcludeExtension = ".EXCLUDE";
 
 /* these formats are already compressed, or don't compress well */
@@ -36,10 +45,81 @@ static const char* kNoCompressExt[] = {
     ".amr", ".awb", ".wma", ".wmv"
 };
 
+/*
+ * A file compressed on a WorkQueue thread, waiting for its turn to be added
+ * to the archive.
+ */
+class CompressedFile : public RefBase {
+public:
+    CompressedFile() : mDone(false), mResult(NO_ERROR) { }
+
+    void setResult(status_t result) {
+        AutoMutex _l(mLock);
+        mResult = result;
+        mDone = true;
+        mDoneCondition.broadcast();
+    }
+
+    /* Waits for the file to be compressed, and returns the result. */
+    status_t waitForResult() {
+        AutoMutex _l(mLock);
+        while (!mDone) {
+            mDoneCondition.wait(mLock);
+        }
+        return mResult;
+    }
+
+    ZipFile::CompressedData data;
+
+private:
+    Mutex mLock;
+    Condition mDoneCondition;
+    bool mDone;
+    status_t mResult;
+};
+
+class CompressFileWorkUnit : public WorkQueue::WorkUnit {
+public:
+    CompressFileWorkUnit(const sp<const AaptFile>& file, int compressionMethod,
+            const sp<CompressedFile>& out) :
+            mFile(file), mCompressionMethod(compressionMethod), mOut(out) {
+    }
+
+    virtual bool run() {
+        status_t result;
+        if (mFile->hasData()) {
+            result = ZipFile::compressData(NULL, mFile->getData(), mFile->getSize(),
+                    mCompressionMethod, &mOut->data);
+        } else {
+            result = ZipFile::compressData(mFile->getSourceFile().string(), NULL, 0,
+                    mCompressionMethod, &mOut->data);
+        }
+        mOut->setResult(result);
+        return true; // the file reports its own errors when it's added
+    }
+
+private:
+    sp<const AaptFile> mFile;
+    int mCompressionMethod;
+    sp<CompressedFile> mOut;
+};
+
+struct PendingFile {
+    String8 storageName;
+    sp<const AaptFile> file;
+
+    // NULL if the file is compressed as it's added.
+    sp<CompressedFile> compressed;
+};
+
 /* fwd decls, so I can write this downward */
 ssize_t processAssets(Bundle* bundle, ZipFile* zip, const sp<const OutputSet>& outputSet);
-bool processFile(Bundle* bundle, ZipFile* zip, String8 storageName, const sp<const AaptFile>& file);
+bool processFile(Bundle* bundle, ZipFile* zip, String8 storageName, const sp<const AaptFile>& file,
+                 const sp<CompressedFile>& compressed);
+bool canCompressAhead(Bundle* bundle, const String8& storageName,
+                      const sp<const AaptFile>& file, int* outCompressionMethod);
 bool okayToCompress(Bundle* bundle, const String8& pathName);
+bool endsWith(const char* haystack, const char* needle);
 ssize_t processJarFiles(Bundle* bundle, ZipFile* zip);
 
 /*
@@ -215,24 +295,62 @@ bail:
     return result;
 }
 
+/*
+ * The files that are deflated are compressed on a WorkQueue, up to
+ * MAX_PENDING_FILES ahead of the file being added, and added to the
+ * archive in order once compressed.  The archive is the same as if they
+ * were compressed as they are added.
+ */
 ssize_t processAssets(Bundle* bundle, ZipFile* zip, const sp<const OutputSet>& outputSet)
 {
     ssize_t count = 0;
+    WorkQueue wq(MAX_THREADS, false);
+    std::queue<PendingFile> pending;
+
     const std::set<OutputEntry>& entries = outputSet->getEntries();
     std::set<OutputEntry>::const_iterator iter = entries.begin();
-    for (; iter != entries.end(); iter++) {
-        const OutputEntry& entry = *iter;
-        if (entry.getFile() == NULL) {
-            fprintf(stderr, "warning: null file being processed.\n");
-        } else {
-            String8 storagePath(entry.getPath());
-            storagePath.convertToResPath();
-            if (!processFile(bundle, zip, storagePath, entry.getFile())) {
-                return UNKNOWN_ERROR;
+    while (iter != entries.end() || !pending.empty()) {
+        if (iter != entries.end() && pending.size() < MAX_PENDING_FILES) {
+            const OutputEntry& entry = *iter;
+            iter++;
+            if (entry.getFile() == NULL) {
+                fprintf(stderr, "warning: null file being processed.\n");
+                continue;
             }
-            count++;
+
+            PendingFile file;
+            file.storageName = entry.getPath();
+            file.storageName.convertToResPath();
+            file.file = entry.getFile();
+
+            int compressionMethod;
+            if (canCompressAhead(bundle, file.storageName, file.file, &compressionMethod)) {
+                file.compressed = new CompressedFile();
+                CompressFileWorkUnit* w = new CompressFileWorkUnit(
+                        file.file, compressionMethod, file.compressed);
+                if (wq.schedule(w) != NO_ERROR) {
+                    // Compress it as it's added instead.
+                    delete w;
+                    file.compressed = NULL;
+                }
+            }
+            pending.push(file);
+            continue;
         }
+
+        const PendingFile& file = pending.front();
+        if (!processFile(bundle, zip, file.storageName, file.file, file.compressed)) {
+            // Drop the files not started yet, and wait for the threads still
+            // compressing: the queue's destructor doesn't join canceled threads.
+            wq.cancel();
+            wq.finish();
+            return UNKNOWN_ERROR;
+        }
+        pending.pop();
+        count++;
     }
+
+    wq.finish();
     return count;
 }
 
@@ -243,7 +361,8 @@ ssize_t processAssets(Bundle* bundle, ZipFile* zip, const sp<const OutputSet>& o
  * delete the existing entry before adding the new one.
  */
 bool processFile(Bundle* bundle, ZipFile* zip,
-                 String8 storageName, const sp<const AaptFile>& file)
+                 String8 storageName, const sp<const AaptFile>& file,
+                 const sp<CompressedFile>& compressed)
 {
     const bool hasData = file->hasData();
 
@@ -322,6 +441,11 @@ bool processFile(Bundle* bundle, ZipFile* zip,
 
     if (fromGzip) {
         result = zip->addGzip(file->getSourceFile().string(), storageName.string(), &entry);
+    } else if (compressed != NULL) {
+        result = compressed->waitForResult();
+        if (result == NO_ERROR) {
+            result = zip->addCompressed(compressed->data, storageName.string(), &entry);
+        }
     } else if (!hasData) {
         /* don't compress certain files, e.g. PNGs */
         int compressionMethod = bundle->getCompressionMethod();
@@ -359,6 +483,37 @@ bool processFile(Bundle* bundle, ZipFile* zip,
     return true;
 }
 
+/*
+ * Determine whether processFile() would deflate this file as it adds it,
+ * in which case it can be compressed ahead of time on another thread.
+ * In "update" mode, files may be kept rather than added, they are not.
+ */
+bool canCompressAhead(Bundle* bundle, const String8& storageName,
+                      const sp<const AaptFile>& file, int* outCompressionMethod)
+{
+    if (bundle->getUpdate()) {
+        return false;
+    }
+
+    if (endsWith(storageName.string(), kExcludeExtension) ||
+            strcasecmp(storageName.getPathExtension().string(), ".gz") == 0) {
+        return false;
+    }
+
+    int compressionMethod;
+    if (file->hasData()) {
+        compressionMethod = file->getCompressionMethod();
+    } else {
+        compressionMethod = bundle->getCompressionMethod();
+        if (!okayToCompress(bundle, storageName)) {
+            compressionMethod = ZipEntry::kCompressStored;
+        }
+    }
+
+    *outCompressionMethod = compressionMethod;
+    return compressionMethod == ZipEntry::kCompressDeflated;
+}
+
 /*
  * Determine whether or not we want to try to compress this file based
  * on the file extension.
@@ -960,8 +960,8 @@ static int32_t getPlatformAssetCookie(const AssetManager& assets) {
         ssize_t cnt = table.lockBag(0x01010000, &entry);
         if (cnt >= 0) {
             idx = entry->stringBlock;
+            table.unlockBag(entry);
         }
-        table.unlockBag(entry);
     }
 
     if (idx < 0) {
@@ -1069,7 +1069,7 @@ status_t updatePreProcessedCache(Bundle* bundle)
     CrunchCache cc(source,dest,ff);
 
     CacheUpdater* cu = new SystemCacheUpdater(bundle);
-    size_t numFiles = cc.crunch(cu);
+    size_t numFiles = cc.crunch(cu, false, MAX_THREADS);
 
     if (bundle->getVerbose())
         fprintf(stdout, "Crunched %d PNG files to update cache\n", (int)numFiles);
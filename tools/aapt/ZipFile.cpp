@@ -529,6 +529,199 @@ bail:
     return result;
 }
 
+/*
+ * Compress a file or a buffer ahead of adding it to an archive.
+ *
+ * The whole file is read in memory, and deflated in one pass into a buffer
+ * large enough for the worst case.
+ */
+/*static*/ status_t ZipFile::compressData(const char* fileName,
+    const void* data, size_t size, int compressionMethod, CompressedData* pData)
+{
+    unsigned char* fileData = NULL;
+    unsigned char* outBuf = NULL;
+    status_t result = NO_ERROR;
+
+    assert(compressionMethod == ZipEntry::kCompressDeflated ||
+           compressionMethod == ZipEntry::kCompressStored);
+    assert(pData->mData == NULL);
+
+    if (!data) {
+        FILE* inputFp = fopen(fileName, FILE_OPEN_RO);
+        if (inputFp == NULL)
+            return errnoToStatus(errno);
+
+        pData->mFromFile = true;
+        pData->mModWhen = getModTime(fileno(inputFp));
+
+        long fileSize = -1;
+        if (fseek(inputFp, 0, SEEK_END) == 0) {
+            fileSize = ftell(inputFp);
+            rewind(inputFp);
+        }
+        if (fileSize < 0) {
+            fclose(inputFp);
+            return UNKNOWN_ERROR;
+        }
+
+        size = fileSize;
+        fileData = (unsigned char*) malloc(size > 0 ? size : 1);
+        if (fileData == NULL) {
+            fclose(inputFp);
+            return NO_MEMORY;
+        }
+        if (fread(fileData, 1, size, inputFp) != size) {
+            ALOGD("fread %d bytes failed\n", (int) size);
+            free(fileData);
+            fclose(inputFp);
+            return UNKNOWN_ERROR;
+        }
+        fclose(inputFp);
+        data = fileData;
+    }
+
+    pData->mUncompressedLen = size;
+    pData->mCRC32 = crc32(crc32(0L, Z_NULL, 0), (const unsigned char*) data, size);
+
+    if (compressionMethod == ZipEntry::kCompressDeflated) {
+        z_stream zstream;
+        int zerr;
+
+        memset(&zstream, 0, sizeof(zstream));
+        zstream.zalloc = Z_NULL;
+        zstream.zfree = Z_NULL;
+        zstream.opaque = Z_NULL;
+        zstream.data_type = Z_UNKNOWN;
+
+        zerr = deflateInit2(&zstream, Z_BEST_COMPRESSION,
+            Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        if (zerr != Z_OK) {
+            ALOGD("Call to deflateInit2 failed (zerr=%d)\n", zerr);
+            free(fileData);
+            return UNKNOWN_ERROR;
+        }
+
+        size_t outSize = deflateBound(&zstream, size);
+        outBuf = (unsigned char*) malloc(outSize);
+        if (outBuf == NULL) {
+            deflateEnd(&zstream);
+            free(fileData);
+            return NO_MEMORY;
+        }
+
+        zstream.next_in = (Bytef*) data;
+        zstream.avail_in = size;
+        zstream.next_out = outBuf;
+        zstream.avail_out = outSize;
+        zerr = deflate(&zstream, Z_FINISH);
+        outSize = zstream.total_out;
+        deflateEnd(&zstream);
+
+        /*
+         * Make sure it has compressed "enough", with the same criteria as
+         * addCommon().
+         */
+        if (zerr != Z_STREAM_END) {
+            ALOGD("zlib deflate call failed (zerr=%d), storing\n", zerr);
+        } else if (outSize + (outSize / 10) > size) {
+            ALOGD("insufficient compression (src=%ld dst=%ld), storing\n",
+                (long) size, (long) outSize);
+        } else {
+            pData->mData = outBuf;
+            pData->mSize = outSize;
+            pData->mCompressionMethod = ZipEntry::kCompressDeflated;
+            free(fileData);
+            return NO_ERROR;
+        }
+        free(outBuf);
+    }
+
+    /* store it, reusing the file's buffer if we read one */
+    if (fileData == NULL) {
+        fileData = (unsigned char*) malloc(size > 0 ? size : 1);
+        if (fileData == NULL)
+            return NO_MEMORY;
+        memcpy(fileData, data, size);
+    }
+    pData->mData = fileData;
+    pData->mSize = size;
+    pData->mCompressionMethod = ZipEntry::kCompressStored;
+    return result;
+}
+
+/*
+ * Add an entry compressed with compressData().  This is addCommon(),
+ * with the data already in its final form.
+ */
+status_t ZipFile::addCompressed(const CompressedData& data,
+    const char* storageName, ZipEntry** ppEntry)
+{
+    ZipEntry* pEntry = NULL;
+    status_t result = NO_ERROR;
+    long lfhPosn, startPosn, endPosn;
+    time_t modWhen;
+
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
+    /* make sure we're in a reasonable state */
+    assert(mZipFp != NULL);
+    assert(mEntries.size() == mEOCD.mTotalNumEntries);
+
+    /* make sure it doesn't already exist */
+    if (getEntryByName(storageName) != NULL)
+        return ALREADY_EXISTS;
+
+    if (fseek(mZipFp, mEOCD.mCentralDirOffset, SEEK_SET) != 0)
+        return UNKNOWN_ERROR;
+
+    pEntry = new ZipEntry;
+    pEntry->initNew(storageName, NULL);
+    mNeedCDRewrite = true;
+
+    lfhPosn = ftell(mZipFp);
+    pEntry->mLFH.write(mZipFp);
+    startPosn = ftell(mZipFp);
+
+    if (data.mSize > 0 &&
+        fwrite(data.mData, 1, data.mSize, mZipFp) != data.mSize)
+    {
+        // don't need to truncate; happens in CDE rewrite
+        ALOGD("fwrite %d bytes failed\n", (int) data.mSize);
+        result = UNKNOWN_ERROR;
+        goto bail;
+    }
+    endPosn = ftell(mZipFp);
+
+    pEntry->setDataInfo(data.mUncompressedLen, endPosn - startPosn,
+        data.mCRC32, data.mCompressionMethod);
+    modWhen = data.mFromFile ? data.mModWhen : getModTime(fileno(mZipFp));
+    pEntry->setModWhen(modWhen);
+    pEntry->setLFHOffset(lfhPosn);
+    mEOCD.mNumEntries++;
+    mEOCD.mTotalNumEntries++;
+    mEOCD.mCentralDirSize = 0;      // mark invalid; set by flush()
+    mEOCD.mCentralDirOffset = endPosn;
+
+    /*
+     * Go back and write the LFH.
+     */
+    if (fseek(mZipFp, lfhPosn, SEEK_SET) != 0) {
+        result = UNKNOWN_ERROR;
+        goto bail;
+    }
+    pEntry->mLFH.write(mZipFp);
+
+    mEntries.add(pEntry);
+    if (ppEntry != NULL)
+        *ppEntry = pEntry;
+    pEntry = NULL;
+
+bail:
+    delete pEntry;
+    return result;
+}
+
 /*
  * Add an entry by copying it from another zip file.  If "padding" is
  * nonzero, the specified number of bytes will be added to the "extra"
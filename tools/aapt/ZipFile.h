@@ -24,6 +24,8 @@
 #include <utils/Vector.h>
 #include <utils/Errors.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include "ZipEntry.h"
 
@@ -126,6 +128,53 @@ public:
     status_t add(const ZipFile* pSourceZip, const ZipEntry* pSourceEntry,
         int padding, ZipEntry** ppEntry);
 
+    /*
+     * The data of an entry, compressed by compressData() before it is
+     * added with addCompressed().
+     */
+    class CompressedData {
+    public:
+        CompressedData(void)
+          : mData(NULL), mSize(0), mUncompressedLen(0), mCRC32(0),
+            mCompressionMethod(ZipEntry::kCompressStored), mFromFile(false),
+            mModWhen((time_t) -1)
+          {}
+        ~CompressedData(void) { free(mData); }
+
+    private:
+        CompressedData(const CompressedData&);
+        CompressedData& operator=(const CompressedData&);
+
+        friend class ZipFile;
+
+        unsigned char*  mData;
+        size_t          mSize;
+        long            mUncompressedLen;
+        unsigned long   mCRC32;
+        int             mCompressionMethod;
+        bool            mFromFile;
+        time_t          mModWhen;
+    };
+
+    /*
+     * Compress the file "fileName", or "data" if it is non-NULL, the way
+     * add() would with "compressionMethod", falling back to storing it if
+     * it doesn't compress well.
+     *
+     * This doesn't touch any archive, so entries can be compressed on
+     * other threads and then added in order.
+     */
+    static status_t compressData(const char* fileName, const void* data,
+        size_t size, int compressionMethod, CompressedData* pData);
+
+    /*
+     * Add an entry compressed with compressData().
+     *
+     * If "ppEntry" is non-NULL, a pointer to the new entry will be returned.
+     */
+    status_t addCompressed(const CompressedData& data, const char* storageName,
+        ZipEntry** ppEntry);
+
     /*
      * Mark an entry as having been removed.  It is not actually deleted
      * from the archive or our internal data structures until flush() is
@@ -240,7 +289,7 @@ private:
         const void* data, size_t size, unsigned long* pCRC32);
 
     /* get modification date from a file descriptor */
-    time_t getModTime(int fd);
+    static time_t getModTime(int fd);
 
     /*
      * We use stdio FILE*, which gives us buffering but makes dealing
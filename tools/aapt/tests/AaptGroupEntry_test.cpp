@@ -52,3 +52,23 @@ TEST(AaptGroupEntryTest, ParseCorrectType) {
     EXPECT_TRUE(TestParse(entry, "animator", &type));
     EXPECT_EQ(String8("animator"), type);
 }
+
+TEST(AaptGroupEntryTest, ParseSameNameTwice) {
+    AaptGroupEntry first;
+    String8 firstType;
+    EXPECT_TRUE(TestParse(first, "drawable-land-xhdpi-v21", &firstType));
+
+    AaptGroupEntry second;
+    String8 secondType;
+    EXPECT_TRUE(TestParse(second, "drawable-land-xhdpi-v21", &secondType));
+    EXPECT_EQ(firstType, secondType);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(String8("land-xhdpi-v21"), second.toString());
+}
+
+TEST(AaptGroupEntryTest, ParseInvalidNameTwice) {
+    AaptGroupEntry entry;
+    String8 type;
+    EXPECT_FALSE(TestParse(entry, "layout-notaqualifier", &type));
+    EXPECT_FALSE(TestParse(entry, "layout-notaqualifier", &type));
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "CrunchCache.h"
+#include "MockCacheUpdater.h"
+#include "MockFileFinder.h"
+
+using android::String8;
+
+/*
+ * The mod-times the crunch cache sees come from the MockFileFinder, and always
+ * make the cached file look older than its source, as in a fresh checkout. The
+ * contents of the source file, which the manifest keys on, are on disk.
+ */
+class CrunchCacheManifestTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        char dir[] = "/tmp/crunch_cache_testXXXXXX";
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+        mRoot = String8(dir);
+        mSource = mRoot.appendPathCopy(String8("res"));
+        mDest = mRoot.appendPathCopy(String8("res2"));
+        mSourceFile = mSource.appendPathCopy(String8("drawable/hello.png"));
+        ASSERT_EQ(0, mkdir(mSource.string(), 0700));
+        ASSERT_EQ(0, mkdir(mSource.appendPathCopy(String8("drawable")).string(), 0700));
+        ASSERT_EQ(0, mkdir(mDest.string(), 0700));
+
+        KeyedVector<String8, time_t> sourceData;
+        sourceData.add(mSourceFile, 5);
+        KeyedVector<String8, time_t> destData;
+        destData.add(mDest.appendPathCopy(String8("drawable/hello.png")), 3);
+        mData.add(mSource, sourceData);
+        mData.add(mDest, destData);
+    }
+
+    virtual void TearDown() {
+        unlink(mSourceFile.string());
+        unlink(mDest.appendPathCopy(String8("crunch-cache.manifest")).string());
+        rmdir(mSource.appendPathCopy(String8("drawable")).string());
+        rmdir(mSource.string());
+        rmdir(mDest.string());
+        rmdir(mRoot.string());
+    }
+
+    void writeSource(const char* contents, time_t modWhen) {
+        FILE* fp = fopen(mSourceFile.string(), "w");
+        ASSERT_TRUE(fp != NULL);
+        fputs(contents, fp);
+        fclose(fp);
+        struct utimbuf times;
+        times.actime = modWhen;
+        times.modtime = modWhen;
+        ASSERT_EQ(0, utime(mSourceFile.string(), &times));
+    }
+
+    // Runs the cache like a new aapt invocation, returning the files crunched.
+    int crunch() {
+        MockFileFinder ff(mData);
+        CrunchCache cc(mSource, mDest, &ff);
+        MockCacheUpdater cu;
+        cc.crunch(&cu);
+        return cu.processCount;
+    }
+
+    String8 mRoot;
+    String8 mSource;
+    String8 mDest;
+    String8 mSourceFile;
+    KeyedVector<String8, KeyedVector<String8, time_t> > mData;
+};
+
+TEST_F(CrunchCacheManifestTest, UnchangedSourceIsNotRecrunched) {
+    writeSource("first", 1000);
+    // No manifest yet, the mod-times decide.
+    EXPECT_EQ(1, crunch());
+    EXPECT_EQ(0, crunch());
+
+    // Touched, but with the same contents
+    writeSource("first", 2000);
+    EXPECT_EQ(0, crunch());
+}
+
+TEST_F(CrunchCacheManifestTest, ChangedSourceIsRecrunched) {
+    writeSource("first", 1000);
+    EXPECT_EQ(1, crunch());
+
+    writeSource("second", 2000);
+    EXPECT_EQ(1, crunch());
+    EXPECT_EQ(0, crunch());
+
+    // Same size, so only the hash tells them apart
+    writeSource("secone", 3000);
+    EXPECT_EQ(1, crunch());
+    EXPECT_EQ(0, crunch());
+}
+
+TEST_F(CrunchCacheManifestTest, CorruptManifestRecrunches) {
+    writeSource("first", 1000);
+    EXPECT_EQ(1, crunch());
+
+    FILE* fp = fopen(mDest.appendPathCopy(String8("crunch-cache.manifest")).string(), "w");
+    ASSERT_TRUE(fp != NULL);
+    fputs("aapt-crunch-cache 1\nnot an entry\n", fp);
+    fclose(fp);
+    EXPECT_EQ(1, crunch());
+    EXPECT_EQ(0, crunch());
+}
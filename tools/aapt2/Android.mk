@@ -28,6 +28,7 @@ sources := \
 	BigBuffer.cpp \
 	BinaryResourceParser.cpp \
 	BindingXmlPullParser.cpp \
+	CompileCache.cpp \
 	ConfigDescription.cpp \
 	Debug.cpp \
 	Files.cpp \
@@ -40,6 +41,7 @@ sources := \
 	ManifestParser.cpp \
 	ManifestValidator.cpp \
 	Png.cpp \
+	Profiler.cpp \
 	ProguardRules.cpp \
 	ResChunkPullParser.cpp \
 	Resource.cpp \
@@ -63,6 +65,7 @@ testSources := \
 	BigBuffer_test.cpp \
 	BindingXmlPullParser_test.cpp \
 	Compat_test.cpp \
+	CompileCache_test.cpp \
 	ConfigDescription_test.cpp \
 	JavaClassGenerator_test.cpp \
 	Linker_test.cpp \
@@ -71,12 +74,14 @@ testSources := \
 	ManifestParser_test.cpp \
 	Maybe_test.cpp \
 	NameMangler_test.cpp \
+	Profiler_test.cpp \
 	ResourceParser_test.cpp \
 	Resource_test.cpp \
 	ResourceTable_test.cpp \
 	ScopedXmlPullParser_test.cpp \
 	StringPiece_test.cpp \
 	StringPool_test.cpp \
+	TableFlattener_test.cpp \
 	Util_test.cpp \
 	XliffXmlPullParser_test.cpp \
 	XmlDom_test.cpp \
@@ -101,7 +106,7 @@ hostStaticLibs := \
 ifneq ($(strip $(USE_MINGW)),)
 	hostStaticLibs += libz
 else
-	hostLdLibs += -lz
+	hostLdLibs += -lz -lpthread
 endif
 
 cFlags := -Wall -Werror -Wno-unused-parameter -UNDEBUG
@@ -22,6 +22,8 @@
 
 namespace aapt {
 
+constexpr size_t BigBuffer::kMaxGrownBlockSize;
+
 void* BigBuffer::nextBlockImpl(size_t size) {
     if (!mBlocks.empty()) {
         Block& block = mBlocks.back();
@@ -46,6 +48,12 @@ void* BigBuffer::nextBlockImpl(size_t size) {
 
     mBlocks.push_back(std::move(block));
     mSize += size;
+
+    // A buffer that keeps growing is a big one, allocate bigger blocks
+    // for it so that its size doesn't cost one allocation per few KB.
+    if (mBlockSize < kMaxGrownBlockSize) {
+        mBlockSize = std::min(mBlockSize * 2, kMaxGrownBlockSize);
+    }
     return mBlocks.back().buffer.get();
 }
 
@@ -60,7 +60,8 @@ public:
 
     /**
      * Create a BigBuffer with block allocation sizes
-     * of blockSize.
+     * of blockSize. Each new block doubles the size of the
+     * next one, up to kMaxGrownBlockSize.
      */
     BigBuffer(size_t blockSize);
 
@@ -106,6 +107,8 @@ private:
      */
     void* nextBlockImpl(size_t size);
 
+    static constexpr size_t kMaxGrownBlockSize = 1024 * 1024;
+
     size_t mBlockSize;
     size_t mSize;
     std::vector<Block> mBlocks;
@@ -39,6 +39,20 @@ TEST(BigBufferTest, ReturnSameBlockIfNextAllocationFits) {
     EXPECT_EQ(b1 + 8, b2);
 }
 
+TEST(BigBufferTest, GrowBlocksOfBufferThatKeepsGrowing) {
+    BigBuffer buffer(16);
+
+    ASSERT_NE(nullptr, buffer.nextBlock<char>(16));
+
+    // The second block holds 32 bytes.
+    char* b1 = buffer.nextBlock<char>(16);
+    ASSERT_NE(nullptr, b1);
+    char* b2 = buffer.nextBlock<char>(16);
+    ASSERT_NE(nullptr, b2);
+    EXPECT_EQ(b1 + 16, b2);
+    EXPECT_EQ(2, std::distance(buffer.begin(), buffer.end()));
+}
+
 TEST(BigBufferTest, AllocateExactSizeBlockIfLargerThanBlockSize) {
     BigBuffer buffer(16);
 
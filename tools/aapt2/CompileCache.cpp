@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompileCache.h"
+#include "Files.h"
+#include "Util.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+
+namespace aapt {
+
+constexpr uint32_t kCacheMagic = 0x48434341u; // 'ACCH'
+constexpr uint32_t kCacheVersion = 1u;
+
+// 64-bit FNV-1a.
+constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ull;
+constexpr uint64_t kFnvPrime = 0x100000001b3ull;
+
+static uint64_t hashBytes(uint64_t hash, const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+static bool readFile(const StringPiece& path, std::string* outContents) {
+    std::ifstream in(path.toString(), std::ifstream::binary);
+    if (!in) {
+        return false;
+    }
+    outContents->assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+static void writeUint32(std::ostream* out, uint32_t value) {
+    out->write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void writeString(std::ostream* out, const std::u16string& str) {
+    const std::string utf8 = util::utf16ToUtf8(str);
+    writeUint32(out, utf8.size());
+    out->write(utf8.data(), utf8.size());
+}
+
+/**
+ * Reads the values of a cache entry, checking that they fit in it.
+ */
+class EntryReader {
+public:
+    EntryReader(const std::string& data) : mData(data), mOffset(0) {
+    }
+
+    bool readUint32(uint32_t* outValue) {
+        if (mData.size() - mOffset < sizeof(*outValue)) {
+            return false;
+        }
+        memcpy(outValue, mData.data() + mOffset, sizeof(*outValue));
+        mOffset += sizeof(*outValue);
+        return true;
+    }
+
+    bool readString(std::u16string* outStr) {
+        uint32_t size;
+        if (!readUint32(&size) || mData.size() - mOffset < size) {
+            return false;
+        }
+        *outStr = util::utf8ToUtf16(StringPiece(mData.data() + mOffset, size));
+        mOffset += size;
+        return true;
+    }
+
+    const char* readBytes(size_t size) {
+        if (mData.size() - mOffset < size) {
+            return nullptr;
+        }
+        const char* bytes = mData.data() + mOffset;
+        mOffset += size;
+        return bytes;
+    }
+
+    bool atEnd() const {
+        return mOffset == mData.size();
+    }
+
+private:
+    const std::string& mData;
+    size_t mOffset;
+};
+
+CompileCache::CompileCache(const StringPiece& directory) : mDirectory(directory.toString()) {
+}
+
+bool CompileCache::computeKey(const StringPiece& path, const StringPiece& options,
+                              std::string* outKey) {
+    std::string contents;
+    if (!readFile(path, &contents)) {
+        return false;
+    }
+
+    uint64_t hash = hashBytes(kFnvOffsetBasis, options.data(), options.size());
+    hash = hashBytes(hash, "", 1);
+    hash = hashBytes(hash, contents.data(), contents.size());
+
+    // The size makes an accidental collision of the hashes even less likely.
+    char key[40];
+    snprintf(key, sizeof(key), "%016llx-%zx", static_cast<unsigned long long>(hash),
+             contents.size());
+    *outKey = key;
+    return true;
+}
+
+std::string CompileCache::getPath(const StringPiece& key) const {
+    std::string path = mDirectory;
+    appendPath(&path, key);
+    return path;
+}
+
+bool CompileCache::get(const StringPiece& key, BigBuffer* outBuffer,
+                       std::vector<DeclaredId>* outIds) const {
+    std::string data;
+    if (!readFile(getPath(key), &data)) {
+        return false;
+    }
+
+    EntryReader reader(data);
+    uint32_t magic, version, idCount;
+    if (!reader.readUint32(&magic) || magic != kCacheMagic ||
+            !reader.readUint32(&version) || version != kCacheVersion ||
+            !reader.readUint32(&idCount)) {
+        return false;
+    }
+
+    std::vector<DeclaredId> ids;
+    for (uint32_t i = 0; i < idCount; i++) {
+        uint32_t type, line;
+        DeclaredId id;
+        if (!reader.readUint32(&type) || type > static_cast<uint32_t>(ResourceType::kXml) ||
+                !reader.readUint32(&line) ||
+                !reader.readString(&id.first.package) || !reader.readString(&id.first.entry)) {
+            return false;
+        }
+        id.first.type = static_cast<ResourceType>(type);
+        id.second = line;
+        ids.push_back(std::move(id));
+    }
+
+    uint32_t size;
+    const char* bytes;
+    if (!reader.readUint32(&size) || (bytes = reader.readBytes(size)) == nullptr ||
+            !reader.atEnd()) {
+        return false;
+    }
+
+    memcpy(outBuffer->nextBlock<char>(size), bytes, size);
+    *outIds = std::move(ids);
+    return true;
+}
+
+bool CompileCache::put(const StringPiece& key, const BigBuffer& buffer,
+                       const std::vector<DeclaredId>& ids) const {
+    static std::atomic<uint32_t> sNextTempFile(0);
+
+    const std::string path = getPath(key);
+    std::stringstream tempPath;
+    tempPath << path << ".tmp" << getpid() << "-" << sNextTempFile++;
+
+    {
+        std::ofstream out(tempPath.str(), std::ofstream::binary);
+        if (!out) {
+            return false;
+        }
+
+        writeUint32(&out, kCacheMagic);
+        writeUint32(&out, kCacheVersion);
+        writeUint32(&out, ids.size());
+        for (const DeclaredId& id : ids) {
+            writeUint32(&out, static_cast<uint32_t>(id.first.type));
+            writeUint32(&out, id.second);
+            writeString(&out, id.first.package);
+            writeString(&out, id.first.entry);
+        }
+        writeUint32(&out, buffer.size());
+        for (const auto& block : buffer) {
+            out.write(reinterpret_cast<const char*>(block.buffer.get()), block.size);
+        }
+
+        if (!out) {
+            out.close();
+            remove(tempPath.str().data());
+            return false;
+        }
+    }
+
+    if (rename(tempPath.str().data(), path.data()) != 0) {
+        // Another compile may have stored the same entry first.
+        remove(tempPath.str().data());
+        return getFileType(path) == FileType::kRegular;
+    }
+    return true;
+}
+
+} // namespace aapt
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_COMPILE_CACHE_H
+#define AAPT_COMPILE_CACHE_H
+
+#include "BigBuffer.h"
+#include "Resource.h"
+#include "StringPiece.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace aapt {
+
+/**
+ * A resource ID declared with '@+id/' in a compiled file, and the
+ * line that declared it.
+ */
+typedef std::pair<ResourceName, size_t> DeclaredId;
+
+/**
+ * A directory of compiled resource files, so that the files that didn't change
+ * since the last build aren't compiled again.
+ *
+ * Entries are keyed by a hash of the source file's contents and of everything
+ * else the compiled file depends on. There is no invalidation: a changed
+ * input simply has another key. Entries are written to a temporary file and
+ * then renamed, so concurrent compiles can share the directory.
+ */
+class CompileCache {
+public:
+    CompileCache(const StringPiece& directory);
+
+    /**
+     * Computes the key of the file at 'path' compiled with 'options', a string
+     * describing the options the compiled file depends on.
+     * Returns false if the file can't be read.
+     */
+    static bool computeKey(const StringPiece& path, const StringPiece& options,
+                           std::string* outKey);
+
+    /**
+     * Reads the compiled file and the IDs it declares.
+     * Returns false if there is no valid entry for the key.
+     */
+    bool get(const StringPiece& key, BigBuffer* outBuffer,
+             std::vector<DeclaredId>* outIds) const;
+
+    /**
+     * Stores the compiled file and the IDs it declares.
+     */
+    bool put(const StringPiece& key, const BigBuffer& buffer,
+             const std::vector<DeclaredId>& ids) const;
+
+private:
+    std::string getPath(const StringPiece& key) const;
+
+    std::string mDirectory;
+};
+
+} // namespace aapt
+
+#endif // AAPT_COMPILE_CACHE_H
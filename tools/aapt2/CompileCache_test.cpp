@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompileCache.h"
+#include "Files.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace aapt {
+
+class CompileCacheTest : public ::testing::Test {
+public:
+    virtual void SetUp() override {
+        char dir[] = "/tmp/aapt2_cache_test_XXXXXX";
+        ASSERT_NE(nullptr, mkdtemp(dir));
+        mDirectory = dir;
+    }
+
+    virtual void TearDown() override {
+        std::string command = "rm -rf " + mDirectory;
+        system(command.data());
+    }
+
+    std::string writeFile(const std::string& name, const std::string& contents) {
+        std::string path = mDirectory;
+        appendPath(&path, name);
+        std::ofstream out(path, std::ofstream::binary);
+        out << contents;
+        return path;
+    }
+
+protected:
+    std::string mDirectory;
+};
+
+static std::string toString(const BigBuffer& buffer) {
+    std::string str;
+    for (const auto& block : buffer) {
+        str.append(reinterpret_cast<const char*>(block.buffer.get()), block.size);
+    }
+    return str;
+}
+
+TEST_F(CompileCacheTest, KeyDependsOnContentsAndOptions) {
+    const std::string a = writeFile("a.xml", "<View/>");
+    const std::string b = writeFile("b.xml", "<View/>");
+    const std::string c = writeFile("c.xml", "<Button/>");
+
+    std::string keyA, keyB, keyC, keyOptions;
+    ASSERT_TRUE(CompileCache::computeKey(a, "xml", &keyA));
+    ASSERT_TRUE(CompileCache::computeKey(b, "xml", &keyB));
+    ASSERT_TRUE(CompileCache::computeKey(c, "xml", &keyC));
+    ASSERT_TRUE(CompileCache::computeKey(a, "xml android", &keyOptions));
+
+    EXPECT_EQ(keyA, keyB);
+    EXPECT_NE(keyA, keyC);
+    EXPECT_NE(keyA, keyOptions);
+
+    std::string missing;
+    EXPECT_FALSE(CompileCache::computeKey(mDirectory + "/missing.xml", "xml", &missing));
+}
+
+TEST_F(CompileCacheTest, GetReturnsWhatWasPut) {
+    CompileCache cache(mDirectory);
+
+    BigBuffer buffer(4);
+    memcpy(buffer.nextBlock<char>(5), "hello", 5);
+    memcpy(buffer.nextBlock<char>(6), " world", 6);
+
+    std::vector<DeclaredId> ids;
+    ids.push_back(DeclaredId(ResourceName{ u"android", ResourceType::kId, u"text" }, 12u));
+    ids.push_back(DeclaredId(ResourceName{ u"", ResourceType::kId, u"icon" }, 20u));
+
+    ASSERT_TRUE(cache.put("key", buffer, ids));
+
+    BigBuffer cachedBuffer(1024);
+    std::vector<DeclaredId> cachedIds;
+    ASSERT_TRUE(cache.get("key", &cachedBuffer, &cachedIds));
+
+    EXPECT_EQ(std::string("hello world"), toString(cachedBuffer));
+    ASSERT_EQ(2u, cachedIds.size());
+    EXPECT_EQ(ids[0].first, cachedIds[0].first);
+    EXPECT_EQ(12u, cachedIds[0].second);
+    EXPECT_EQ(ids[1].first, cachedIds[1].first);
+    EXPECT_EQ(20u, cachedIds[1].second);
+}
+
+TEST_F(CompileCacheTest, MissingOrCorruptEntriesAreIgnored) {
+    CompileCache cache(mDirectory);
+
+    BigBuffer buffer(1024);
+    std::vector<DeclaredId> ids;
+    EXPECT_FALSE(cache.get("missing", &buffer, &ids));
+
+    writeFile("corrupt", "not a cache entry");
+    EXPECT_FALSE(cache.get("corrupt", &buffer, &ids));
+    EXPECT_EQ(0u, buffer.size());
+}
+
+} // namespace aapt
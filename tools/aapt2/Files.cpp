@@ -17,8 +17,11 @@
 #include "Files.h"
 #include "Util.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
 #include <dirent.h>
+#include <fstream>
 #include <string>
 #include <sys/stat.h>
 
@@ -116,6 +119,30 @@ std::string getStem(const StringPiece& path) {
     return {};
 }
 
+bool fileMatches(const StringPiece& path, const StringPiece& contents) {
+    std::ifstream in(path.toString(), std::ifstream::binary);
+    if (!in) {
+        return false;
+    }
+
+    in.seekg(0, std::ifstream::end);
+    if (!in || static_cast<size_t>(in.tellg()) != contents.size()) {
+        return false;
+    }
+    in.seekg(0, std::ifstream::beg);
+
+    char buffer[4096];
+    size_t offset = 0;
+    while (offset < contents.size()) {
+        const size_t len = std::min(sizeof(buffer), contents.size() - offset);
+        if (!in.read(buffer, len) || memcmp(buffer, contents.data() + offset, len) != 0) {
+            return false;
+        }
+        offset += len;
+    }
+    return true;
+}
+
 bool FileFilter::setPattern(const StringPiece& pattern) {
     mPatternTokens = util::splitAndLowercase(pattern, ':');
     return true;
@@ -76,6 +76,13 @@ bool mkdirs(const StringPiece& path);
  */
 std::string getStem(const StringPiece& path);
 
+/*
+ * Returns true if the file at `path` exists and its contents
+ * are exactly `contents`. Used to avoid touching generated files
+ * that have not changed.
+ */
+bool fileMatches(const StringPiece& path, const StringPiece& contents);
+
 /*
  * Filter that determines which resource files/directories are
  * processed by AAPT. Takes a pattern string supplied by the user.
@@ -38,6 +38,12 @@ void optionalFlag(const StringPiece& name, const StringPiece& description,
             false, nullptr, false, false });
 }
 
+void optionalFlag(const StringPiece& name, const StringPiece& description,
+                  std::function<bool(const StringPiece&, std::string*)> action) {
+    sFlags.push_back(Flag{ name.toString(), description.toString(), action,
+            false, nullptr, false, false });
+}
+
 void requiredFlag(const StringPiece& name, const StringPiece& description,
                   std::function<void(const StringPiece&)> action) {
     sFlags.push_back(Flag{ name.toString(), description.toString(), wrap(action),
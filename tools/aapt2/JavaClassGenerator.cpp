@@ -81,13 +81,14 @@ static std::u16string transform(const StringPiece16& symbol) {
 }
 
 struct GenArgs : ValueVisitorArgs {
-    GenArgs(std::ostream* o, const std::u16string* p, std::u16string* e) :
-            out(o), package(p), entryName(e) {
+    GenArgs(std::ostream* o, const std::u16string* p, std::u16string* e, bool t) :
+            out(o), package(p), entryName(e), textSymbols(t) {
     }
 
     std::ostream* out;
     const std::u16string* package;
     std::u16string* entryName;
+    bool textSymbols;
 };
 
 void JavaClassGenerator::visit(const Styleable& styleable, ValueVisitorArgs& a) {
@@ -95,6 +96,7 @@ void JavaClassGenerator::visit(const Styleable& styleable, ValueVisitorArgs& a)
     std::ostream* out = static_cast<GenArgs&>(a).out;
     const std::u16string* package = static_cast<GenArgs&>(a).package;
     std::u16string* entryName = static_cast<GenArgs&>(a).entryName;
+    const bool textSymbols = static_cast<GenArgs&>(a).textSymbols;
 
     // This must be sorted by resource ID.
     std::vector<std::pair<ResourceId, ResourceNameRef>> sortedAttributes;
@@ -109,27 +111,39 @@ void JavaClassGenerator::visit(const Styleable& styleable, ValueVisitorArgs& a)
     std::sort(sortedAttributes.begin(), sortedAttributes.end());
 
     // First we emit the array containing the IDs of each attribute.
-    *out << "        "
-         << "public static final int[] " << transform(*entryName) << " = {";
-
     const size_t attrCount = sortedAttributes.size();
-    for (size_t i = 0; i < attrCount; i++) {
-        if (i % kAttribsPerLine == 0) {
-            *out << std::endl << "            ";
+    if (textSymbols) {
+        *out << "int[] styleable " << transform(*entryName) << " {";
+        for (size_t i = 0; i < attrCount; i++) {
+            *out << (i == 0 ? " " : ", ") << sortedAttributes[i].first;
         }
+        *out << " }" << std::endl;
+    } else {
+        *out << "        "
+             << "public static final int[] " << transform(*entryName) << " = {";
+
+        for (size_t i = 0; i < attrCount; i++) {
+            if (i % kAttribsPerLine == 0) {
+                *out << std::endl << "            ";
+            }
 
-        *out << sortedAttributes[i].first;
-        if (i != attrCount - 1) {
-            *out << ", ";
+            *out << sortedAttributes[i].first;
+            if (i != attrCount - 1) {
+                *out << ", ";
+            }
         }
+        *out << std::endl << "        };" << std::endl;
     }
-    *out << std::endl << "        };" << std::endl;
 
     // Now we emit the indices into the array.
     for (size_t i = 0; i < attrCount; i++) {
-        *out << "        "
-             << "public static" << finalModifier
-             << " int " << transform(*entryName);
+        if (textSymbols) {
+            *out << "int styleable " << transform(*entryName);
+        } else {
+            *out << "        "
+                 << "public static" << finalModifier
+                 << " int " << transform(*entryName);
+        }
 
         // We may reference IDs from other packages, so prefix the entry name with
         // the package.
@@ -137,12 +151,18 @@ void JavaClassGenerator::visit(const Styleable& styleable, ValueVisitorArgs& a)
         if (itemName.package != *package) {
             *out << "_" << transform(itemName.package);
         }
-        *out << "_" << transform(itemName.entry) << " = " << i << ";" << std::endl;
+        *out << "_" << transform(itemName.entry);
+        if (textSymbols) {
+            *out << " " << i << std::endl;
+        } else {
+            *out << " = " << i << ";" << std::endl;
+        }
     }
 }
 
 bool JavaClassGenerator::generateType(const std::u16string& package, size_t packageId,
-                                      const ResourceTableType& type, std::ostream& out) {
+                                      const ResourceTableType& type, bool textSymbols,
+                                      std::ostream& out) {
     const StringPiece finalModifier = mOptions.useFinal ? " final" : "";
 
     std::u16string unmangledPackage;
@@ -177,7 +197,11 @@ bool JavaClassGenerator::generateType(const std::u16string& package, size_t pack
 
         if (type.type == ResourceType::kStyleable) {
             assert(!entry->values.empty());
-            entry->values.front().value->accept(*this, GenArgs{ &out, &package, &unmangledName });
+            entry->values.front().value->accept(*this, GenArgs{ &out, &package, &unmangledName,
+                                                                textSymbols });
+        } else if (textSymbols) {
+            out << "int " << type.type << " " << transform(unmangledName) << " " << id
+                << std::endl;
         } else {
             out << "        " << "public static" << finalModifier
                 << " int " << transform(unmangledName) << " = " << id << ";" << std::endl;
@@ -195,7 +219,7 @@ bool JavaClassGenerator::generate(const std::u16string& package, std::ostream& o
 
     for (const auto& type : *mTable) {
         out << "    public static final class " << type->type << " {" << std::endl;
-        if (!generateType(package, packageId, *type, out)) {
+        if (!generateType(package, packageId, *type, false, out)) {
             return false;
         }
         out << "    }" << std::endl;
@@ -205,4 +229,14 @@ bool JavaClassGenerator::generate(const std::u16string& package, std::ostream& o
     return true;
 }
 
+bool JavaClassGenerator::generateTextSymbols(const std::u16string& package, std::ostream& out) {
+    const size_t packageId = mTable->getPackageId();
+    for (const auto& type : *mTable) {
+        if (!generateType(package, packageId, *type, true, out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 } // namespace aapt
@@ -52,6 +52,18 @@ public:
      */
     bool generate(const std::u16string& package, std::ostream& out);
 
+    /*
+     * Writes the symbols belonging to `package` to `out` in the R.txt format,
+     * one per line, so that the dependents of a library can pick up its IDs
+     * without parsing Java:
+     *
+     *   int <type> <name> <id>
+     *   int[] styleable <name> { <id>, <id>, ... }
+     *
+     * Returns true on success.
+     */
+    bool generateTextSymbols(const std::u16string& package, std::ostream& out);
+
     /*
      * ConstValueVisitor implementation.
      */
@@ -61,7 +73,7 @@ public:
 
 private:
     bool generateType(const std::u16string& package, size_t packageId,
-                      const ResourceTableType& type, std::ostream& out);
+                      const ResourceTableType& type, bool textSymbols, std::ostream& out);
 
     std::shared_ptr<const ResourceTable> mTable;
     Options mOptions;
@@ -143,4 +143,33 @@ TEST_F(JavaClassGeneratorTest, EmitOtherPackagesAttributesInStyleable) {
     EXPECT_NE(std::string::npos, output.find("int Foo_com_lib_bar ="));
 }
 
+TEST_F(JavaClassGeneratorTest, EmitTextSymbols) {
+    ASSERT_TRUE(addResource(ResourceName{ {}, ResourceType::kId, u"hey-man" },
+                            ResourceId{ 0x01, 0x02, 0x0000 }));
+
+    ASSERT_TRUE(addResource(ResourceName{ {}, ResourceType::kAttr, u"cool.attr" },
+                            ResourceId{ 0x01, 0x01, 0x0000 }));
+
+    std::unique_ptr<Styleable> styleable = util::make_unique<Styleable>();
+    Reference ref(ResourceName{ u"android", ResourceType::kAttr, u"cool.attr"});
+    ref.id = ResourceId{ 0x01, 0x01, 0x0000 };
+    styleable->entries.emplace_back(ref);
+
+    ASSERT_TRUE(mTable->addResource(ResourceName{ {}, ResourceType::kStyleable, u"hey.dude" },
+                                    ResourceId{ 0x01, 0x03, 0x0000 }, {},
+                                    SourceLine{ "test.xml", 21 }, std::move(styleable)));
+
+    JavaClassGenerator generator(mTable, {});
+
+    std::stringstream out;
+    EXPECT_TRUE(generator.generateTextSymbols(mTable->getPackage(), out));
+    std::string output = out.str();
+
+    EXPECT_NE(std::string::npos, output.find("int id hey_man 0x01020000\n"));
+    EXPECT_NE(std::string::npos, output.find("int attr cool_attr 0x01010000\n"));
+    EXPECT_NE(std::string::npos, output.find("int[] styleable hey_dude { 0x01010000 }\n"));
+    EXPECT_NE(std::string::npos, output.find("int styleable hey_dude_cool_attr 0\n"));
+    EXPECT_EQ(std::string::npos, output.find("public"));
+}
+
 } // namespace aapt
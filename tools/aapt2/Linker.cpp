@@ -25,24 +25,28 @@
 #include "Util.h"
 
 #include <androidfw/AssetManager.h>
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <iostream>
 #include <map>
 #include <ostream>
 #include <set>
 #include <sstream>
+#include <thread>
 #include <tuple>
 #include <vector>
 
 namespace aapt {
 
-Linker::Args::Args(const ResourceNameRef& r, const SourceLine& s) : referrer(r), source(s) {
+Linker::Args::Args(const ResourceNameRef& r, const SourceLine& s, TypeResult& t) :
+        referrer(r), source(s), result(t) {
 }
 
 Linker::Linker(const std::shared_ptr<ResourceTable>& table,
                const std::shared_ptr<IResolver>& resolver, const Options& options) :
-        mResolver(resolver), mTable(table), mOptions(options), mError(false) {
+        mResolver(resolver), mTable(table), mOptions(options) {
 }
 
 bool Linker::linkAndValidate() {
@@ -95,40 +99,110 @@ bool Linker::linkAndValidate() {
         }
     }
 
-    // Now do reference linking.
+    // Now do reference linking. Styles and layouts read the attributes they
+    // use, whose enum and flag symbols are linked like any other reference,
+    // so the attributes are linked first. The other types only change their
+    // own values, and are linked in parallel.
+    std::vector<ResourceTableType*> attrTypes;
+    std::vector<ResourceTableType*> otherTypes;
     for (auto& type : *mTable) {
-        for (auto& entry : type->entries) {
-            if (entry->publicStatus.isPublic && entry->values.empty()) {
-                // A public resource has no values. It will not be encoded
-                // properly without a symbol table. This is a unresolved symbol.
-                addUnresolvedSymbol(ResourceNameRef{
-                        mTable->getPackage(), type->type, entry->name },
-                        entry->publicStatus.source);
-                continue;
-            }
+        if (type->type == ResourceType::kAttr || type->type == ResourceType::kAttrPrivate) {
+            attrTypes.push_back(type.get());
+        } else {
+            otherTypes.push_back(type.get());
+        }
+    }
 
-            for (auto& valueConfig : entry->values) {
-                // Dispatch to the right method of this linker
-                // based on the value's type.
-                valueConfig.value->accept(*this, Args{
-                        ResourceNameRef{ mTable->getPackage(), type->type, entry->name },
-                        valueConfig.source
-                });
-            }
+    std::vector<TypeResult> attrResults;
+    linkTypes(attrTypes, &attrResults);
+    std::vector<TypeResult> otherResults;
+    linkTypes(otherTypes, &otherResults);
+
+    // Merge the results in the order of the types in the table.
+    bool error = false;
+    size_t attrIndex = 0;
+    size_t otherIndex = 0;
+    for (auto& type : *mTable) {
+        const bool isAttr = type->type == ResourceType::kAttr ||
+                type->type == ResourceType::kAttrPrivate;
+        TypeResult& result = isAttr ? attrResults[attrIndex++] : otherResults[otherIndex++];
+        error |= result.error;
+        for (auto& symbol : result.unresolvedSymbols) {
+            std::vector<SourceLine>& sources = mUnresolvedSymbols[symbol.first];
+            sources.insert(sources.end(), symbol.second.begin(), symbol.second.end());
+        }
+    }
+    return !error;
+}
+
+/**
+ * Links the types on up to mOptions.jobs threads, each taking the next type
+ * not linked yet.
+ */
+void Linker::linkTypes(const std::vector<ResourceTableType*>& types,
+                       std::vector<TypeResult>* outResults) {
+    outResults->resize(types.size());
+
+    std::atomic<size_t> nextType(0);
+    auto work = [&]() {
+        size_t i;
+        while ((i = nextType++) < types.size()) {
+            linkType(types[i], &(*outResults)[i]);
+        }
+    };
+
+#ifdef _WIN32
+    // The Windows toolchain has no std::thread, link serially.
+    work();
+#else
+    size_t jobs = mOptions.jobs;
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    jobs = std::min(jobs, types.size());
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < jobs; i++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+#endif
+}
+
+void Linker::linkType(ResourceTableType* type, TypeResult* outResult) {
+    for (auto& entry : type->entries) {
+        if (entry->publicStatus.isPublic && entry->values.empty()) {
+            // A public resource has no values. It will not be encoded
+            // properly without a symbol table. This is a unresolved symbol.
+            addUnresolvedSymbol(ResourceNameRef{
+                    mTable->getPackage(), type->type, entry->name },
+                    entry->publicStatus.source, outResult);
+            continue;
+        }
+
+        for (auto& valueConfig : entry->values) {
+            // Dispatch to the right method of this linker
+            // based on the value's type.
+            valueConfig.value->accept(*this, Args{
+                    ResourceNameRef{ mTable->getPackage(), type->type, entry->name },
+                    valueConfig.source,
+                    *outResult
+            });
         }
     }
-    return !mError;
 }
 
 const Linker::ResourceNameToSourceMap& Linker::getUnresolvedReferences() const {
     return mUnresolvedSymbols;
 }
 
-void Linker::doResolveReference(Reference& reference, const SourceLine& source) {
+bool Linker::doResolveReference(Reference& reference) {
     Maybe<ResourceId> result = mResolver->findId(reference.name);
     if (!result) {
-        addUnresolvedSymbol(reference.name, source);
-        return;
+        return false;
     }
     assert(result.value().isValid());
 
@@ -137,12 +211,12 @@ void Linker::doResolveReference(Reference& reference, const SourceLine& source)
     } else {
         reference.id = 0;
     }
+    return true;
 }
 
-const Attribute* Linker::doResolveAttribute(Reference& attribute, const SourceLine& source) {
+const Attribute* Linker::doResolveAttribute(Reference& attribute) {
     Maybe<IResolver::Entry> result = mResolver->findAttribute(attribute.name);
     if (!result || !result.value().attr) {
-        addUnresolvedSymbol(attribute.name, source);
         return nullptr;
     }
 
@@ -177,14 +251,16 @@ void Linker::visit(Reference& reference, ValueVisitorArgs& a) {
         return;
     }
 
-    doResolveReference(reference, args.source);
+    if (!doResolveReference(reference)) {
+        addUnresolvedSymbol(reference.name, args.source, &args.result);
+    }
 
     // TODO(adamlesinski): Verify the referencedType is another reference
     // or a compatible primitive.
 }
 
-void Linker::processAttributeValue(const ResourceNameRef& name, const SourceLine& source,
-        const Attribute& attr, std::unique_ptr<Item>& value) {
+void Linker::processAttributeValue(const Args& args, const Attribute& attr,
+        std::unique_ptr<Item>& value) {
     std::unique_ptr<Item> convertedValue;
     visitFunc<RawString>(*value, [&](RawString& str) {
         // This is a raw string, so check if it can be converted to anything.
@@ -204,6 +280,7 @@ void Linker::processAttributeValue(const ResourceNameRef& name, const SourceLine
             util::StringBuilder builder;
             builder.append(*str.value);
             if (builder) {
+                android::AutoMutex lock(mStringPoolLock);
                 convertedValue = util::make_unique<String>(
                         mTable->getValueStringPool().makeRef(builder.str()));
             }
@@ -215,7 +292,7 @@ void Linker::processAttributeValue(const ResourceNameRef& name, const SourceLine
     }
 
     // Process this new or old value (it can be a reference!).
-    value->accept(*this, Args{ name, source });
+    value->accept(*this, Args{ args.referrer, args.source, args.result });
 
     // Flatten the value to see what resource type it is.
     android::Res_value resValue;
@@ -224,13 +301,13 @@ void Linker::processAttributeValue(const ResourceNameRef& name, const SourceLine
     // Always allow references.
     const uint32_t typeMask = attr.typeMask | android::ResTable_map::TYPE_REFERENCE;
     if (!(typeMask & ResourceParser::androidTypeToAttributeTypeMask(resValue.dataType))) {
-        Logger::error(source)
+        Logger::error(args.source)
                 << *value
                 << " is not compatible with attribute "
                 << attr
                 << "."
                 << std::endl;
-        mError = true;
+        args.result.error = true;
     }
 }
 
@@ -242,9 +319,11 @@ void Linker::visit(Style& style, ValueVisitorArgs& a) {
     }
 
     for (Style::Entry& styleEntry : style.entries) {
-        const Attribute* attr = doResolveAttribute(styleEntry.key, args.source);
+        const Attribute* attr = doResolveAttribute(styleEntry.key);
         if (attr) {
-            processAttributeValue(args.referrer, args.source, *attr, styleEntry.value);
+            processAttributeValue(args, *attr, styleEntry.value);
+        } else {
+            addUnresolvedSymbol(styleEntry.key.name, args.source, &args.result);
         }
     }
 }
@@ -269,7 +348,7 @@ void Linker::visit(Array& array, ValueVisitorArgs& a) {
     Args& args = static_cast<Args&>(a);
 
     for (auto& item : array.items) {
-        item->accept(*this, Args{ args.referrer, args.source });
+        item->accept(*this, Args{ args.referrer, args.source, args.result });
     }
 }
 
@@ -278,13 +357,14 @@ void Linker::visit(Plural& plural, ValueVisitorArgs& a) {
 
     for (auto& item : plural.values) {
         if (item) {
-            item->accept(*this, Args{ args.referrer, args.source });
+            item->accept(*this, Args{ args.referrer, args.source, args.result });
         }
     }
 }
 
-void Linker::addUnresolvedSymbol(const ResourceNameRef& name, const SourceLine& source) {
-    mUnresolvedSymbols[name.toResourceName()].push_back(source);
+void Linker::addUnresolvedSymbol(const ResourceNameRef& name, const SourceLine& source,
+                                 TypeResult* result) {
+    result->unresolvedSymbols[name.toResourceName()].push_back(source);
 }
 
 } // namespace aapt
@@ -24,6 +24,7 @@
 #include "StringPiece.h"
 
 #include <androidfw/AssetManager.h>
+#include <utils/Mutex.h>
 #include <map>
 #include <memory>
 #include <ostream>
@@ -56,6 +57,12 @@ public:
          * When building a static library, set this to false.
          */
         bool linkResourceIds = true;
+
+        /**
+         * The number of resource types to link at once.
+         * 0 uses one thread per core.
+         */
+        size_t jobs = 0;
     };
 
     /**
@@ -74,6 +81,9 @@ public:
      * and validates types. Returns true if all references to defined values
      * are type-compatible. Missing resource references are recorded but do
      * not cause this method to fail.
+     *
+     * The references of each resource type are linked on their own thread,
+     * once the attributes they refer to are linked.
      */
     bool linkAndValidate();
 
@@ -85,19 +95,38 @@ public:
     const ResourceNameToSourceMap& getUnresolvedReferences() const;
 
 protected:
-    virtual void doResolveReference(Reference& reference, const SourceLine& source);
-    virtual const Attribute* doResolveAttribute(Reference& attribute, const SourceLine& source);
+    /**
+     * Return false, or nullptr, if the reference can't be resolved. These are
+     * called from several threads at once.
+     */
+    virtual bool doResolveReference(Reference& reference);
+    virtual const Attribute* doResolveAttribute(Reference& attribute);
 
     std::shared_ptr<IResolver> mResolver;
 
 private:
+    /**
+     * What linking a resource type found. Each type is linked on its own
+     * thread, and the results are merged in the order of the types once they
+     * are all done, so they don't depend on the threads.
+     */
+    struct TypeResult {
+        ResourceNameToSourceMap unresolvedSymbols;
+        bool error = false;
+    };
+
     struct Args : public ValueVisitorArgs {
-        Args(const ResourceNameRef& r, const SourceLine& s);
+        Args(const ResourceNameRef& r, const SourceLine& s, TypeResult& t);
 
         const ResourceNameRef& referrer;
         const SourceLine& source;
+        TypeResult& result;
     };
 
+    void linkTypes(const std::vector<ResourceTableType*>& types,
+                   std::vector<TypeResult>* outResults);
+    void linkType(ResourceTableType* type, TypeResult* outResult);
+
     //
     // Overrides of ValueVisitor
     //
@@ -108,15 +137,18 @@ private:
     void visit(Array& array, ValueVisitorArgs& args) override;
     void visit(Plural& plural, ValueVisitorArgs& args) override;
 
-    void processAttributeValue(const ResourceNameRef& name, const SourceLine& source,
-                               const Attribute& attr, std::unique_ptr<Item>& value);
+    void processAttributeValue(const Args& args, const Attribute& attr,
+                               std::unique_ptr<Item>& value);
 
-    void addUnresolvedSymbol(const ResourceNameRef& name, const SourceLine& source);
+    static void addUnresolvedSymbol(const ResourceNameRef& name, const SourceLine& source,
+                                    TypeResult* result);
 
     std::shared_ptr<ResourceTable> mTable;
     std::map<ResourceName, std::vector<SourceLine>> mUnresolvedSymbols;
     Options mOptions;
-    bool mError;
+
+    // Protects the table's value string pool, which all the types add to.
+    android::Mutex mStringPoolLock;
 };
 
 } // namespace aapt
@@ -18,6 +18,7 @@
 #include "BigBuffer.h"
 #include "BinaryResourceParser.h"
 #include "BindingXmlPullParser.h"
+#include "CompileCache.h"
 #include "Debug.h"
 #include "Files.h"
 #include "Flag.h"
@@ -28,6 +29,7 @@
 #include "ManifestValidator.h"
 #include "NameMangler.h"
 #include "Png.h"
+#include "Profiler.h"
 #include "ProguardRules.h"
 #include "ResourceParser.h"
 #include "ResourceTable.h"
@@ -43,18 +45,29 @@
 
 #include <algorithm>
 #include <androidfw/AssetManager.h>
+#include <atomic>
 #include <cstdlib>
 #include <dirent.h>
 #include <errno.h>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <map>
 #include <sstream>
 #include <sys/stat.h>
+#include <thread>
 #include <unordered_set>
 #include <utils/Errors.h>
 
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 constexpr const char* kAaptVersionStr = "2.0-alpha";
 
+constexpr const char16_t* kSchemaAndroid = u"http://schemas.android.com/apk/res/android";
+
 using namespace aapt;
 
 /**
@@ -298,16 +311,46 @@ struct AaptOptions {
     // Directory in which to write binding xml files.
     Source bindingOutput;
 
+    // Directory in which to keep the compiled files
+    // between compiles.
+    Maybe<Source> compileCache;
+
     // Directory to in which to generate R.java.
     Maybe<Source> generateJavaClass;
 
+    // Directory in which to generate R.txt, listing the
+    // app's symbols for the modules that depend on it.
+    Maybe<Source> generateTextSymbols;
+
     // File in which to produce proguard rules.
     Maybe<Source> generateProguardRules;
 
+    // A split APK to generate along with the base APK. It holds the
+    // resources defined for any of its configurations, ignoring their
+    // SDK version, instead of the base APK.
+    struct Split {
+        Source output;
+        std::vector<ConfigDescription> configs;
+    };
+
+    // The split APKs to generate when linking.
+    std::vector<Split> splits;
+
+    // File in which to write a Chrome trace of the time
+    // spent in each phase and on each file.
+    Maybe<Source> profileOutput;
+
+    // Records the trace, null when not profiling.
+    Profiler* profiler = nullptr;
+
     // Whether to output verbose details about
     // compilation.
     bool verbose = false;
 
+    // The number of files to compile, or resource types to link, at once.
+    // 0 uses one job per core.
+    size_t jobs = 0;
+
     // Whether or not to auto-version styles or layouts
     // referencing attributes defined in a newer SDK
     // level than the style or layout is defined for.
@@ -319,8 +362,7 @@ struct AaptOptions {
 };
 
 struct IdCollector : public xml::Visitor {
-    IdCollector(const Source& source, const std::shared_ptr<ResourceTable>& table) :
-            mSource(source), mTable(table) {
+    IdCollector(std::vector<DeclaredId>* outIds) : mOutIds(outIds) {
     }
 
     virtual void visit(xml::Text* node) override {}
@@ -338,8 +380,7 @@ struct IdCollector : public xml::Visitor {
             ResourceNameRef nameRef;
             if (ResourceParser::tryParseReference(attr.value, &nameRef, &create, &priv)) {
                 if (create) {
-                    mTable->addResource(nameRef, {}, mSource.line(node->lineNumber),
-                                        util::make_unique<Id>());
+                    mOutIds->push_back(DeclaredId(nameRef.toResourceName(), node->lineNumber));
                 }
             }
         }
@@ -350,12 +391,26 @@ struct IdCollector : public xml::Visitor {
     }
 
 private:
-    Source mSource;
-    std::shared_ptr<ResourceTable> mTable;
+    std::vector<DeclaredId>* mOutIds;
 };
 
-bool compileXml(const AaptOptions& options, const std::shared_ptr<ResourceTable>& table,
-                const CompileItem& item, ZipFile* outApk) {
+/**
+ * The result of compiling a CompileItem. Files are compiled in parallel,
+ * without touching the resource table or the APK, and their results are
+ * added to both in the order of the items.
+ */
+struct CompiledFile {
+    // The compiled file, null if it failed to compile or is copied as is.
+    std::unique_ptr<BigBuffer> buffer;
+
+    // The IDs declared with '@+id/' in a compiled XML file.
+    std::vector<DeclaredId> ids;
+
+    // Whether the file is copied to the APK as is.
+    bool copy = false;
+};
+
+bool compileXml(const AaptOptions& options, const CompileItem& item, CompiledFile* outFile) {
     std::ifstream in(item.source.path, std::ifstream::binary);
     if (!in) {
         Logger::error(item.source) << strerror(errno) << std::endl;
@@ -369,22 +424,15 @@ bool compileXml(const AaptOptions& options, const std::shared_ptr<ResourceTable>
     }
 
     // Collect any resource ID's declared here.
-    IdCollector idCollector(item.source, table);
+    IdCollector idCollector(&outFile->ids);
     root->accept(&idCollector);
 
-    BigBuffer outBuffer(1024);
-    if (!xml::flatten(root.get(), options.appInfo.package, &outBuffer)) {
+    std::unique_ptr<BigBuffer> outBuffer = util::make_unique<BigBuffer>(1024);
+    if (!xml::flatten(root.get(), options.appInfo.package, outBuffer.get())) {
         logger.error() << "failed to encode XML." << std::endl;
         return false;
     }
-
-    // Write the resulting compiled XML file to the output APK.
-    if (outApk->add(outBuffer, buildFileReference(item).data(), ZipEntry::kCompressStored,
-                nullptr) != android::NO_ERROR) {
-        Logger::error(options.output) << "failed to write compiled '" << item.source
-                                      << "' to apk." << std::endl;
-        return false;
-    }
+    outFile->buffer = std::move(outBuffer);
     return true;
 }
 
@@ -419,14 +467,22 @@ bool shouldGenerateVersionedResource(const std::shared_ptr<const ResourceTable>&
     return newConfig < iter->config;
 }
 
-bool linkXml(const AaptOptions& options, const std::shared_ptr<ResourceTable>& table,
-             const std::shared_ptr<IResolver>& resolver, const LinkItem& item,
-             const void* data, size_t dataLen, ZipFile* outApk, std::queue<LinkItem>* outQueue,
-             proguard::KeepSet* keepSet) {
+/**
+ * Inflates the XML file of item and flattens it into outData, resolving its
+ * attributes, then compresses it. Returns the smallest SDK version of the attributes that were
+ * stripped, or nothing on failure. This only reads the table, so several items
+ * can be flattened on different threads at once. The proguard rules of the
+ * file are added to keepSet.
+ */
+Maybe<size_t> flattenLinkedXml(const AaptOptions& options,
+                               const std::shared_ptr<IResolver>& resolver,
+                               const LinkItem& item, const void* data, size_t dataLen,
+                               ZipFile::CompressedData* outData,
+                               proguard::KeepSet* keepSet) {
     SourceLogger logger(item.source);
     std::unique_ptr<xml::Node> root = xml::inflate(data, dataLen, &logger);
     if (!root) {
-        return false;
+        return {};
     }
 
     xml::FlattenOptions xmlOptions;
@@ -450,19 +506,35 @@ bool linkXml(const AaptOptions& options, const std::shared_ptr<ResourceTable>& t
                                                        xmlOptions, &outBuffer);
     if (!minStrippedSdk) {
         logger.error() << "failed to encode XML." << std::endl;
-        return false;
+        return {};
     }
 
-    if (minStrippedSdk.value() > 0) {
+    if (ZipFile::compress(outBuffer, ZipEntry::kCompressDeflated, outData) !=
+            android::NO_ERROR) {
+        logger.error() << "failed to compress XML." << std::endl;
+        return {};
+    }
+    return minStrippedSdk;
+}
+
+/**
+ * Adds the flattened XML file of item to outApk, and queues a versioned copy of
+ * it if attributes were stripped for being too new. Modifies the table, so it
+ * must not run while other items are flattened.
+ */
+bool addLinkedXml(const AaptOptions& options, const std::shared_ptr<ResourceTable>& table,
+                  const LinkItem& item, size_t minStrippedSdk,
+                  const ZipFile::CompressedData& data, ZipFile* outApk,
+                  std::queue<LinkItem>* outQueue) {
+    if (minStrippedSdk > 0) {
         // Something was stripped, so let's generate a new file
         // with the version of the smallest SDK version stripped.
         // We can only generate a versioned layout if there doesn't exist a layout
         // with sdk version greater than the current one but less than the one we
         // want to generate.
-        if (shouldGenerateVersionedResource(table, item.name, item.config,
-                    minStrippedSdk.value())) {
+        if (shouldGenerateVersionedResource(table, item.name, item.config, minStrippedSdk)) {
             LinkItem newWork = item;
-            newWork.config.sdkVersion = minStrippedSdk.value();
+            newWork.config.sdkVersion = minStrippedSdk;
             outQueue->push(newWork);
 
             if (!addFileReference(table, newWork)) {
@@ -473,8 +545,8 @@ bool linkXml(const AaptOptions& options, const std::shared_ptr<ResourceTable>& t
         }
     }
 
-    if (outApk->add(outBuffer, buildFileReference(item).data(), ZipEntry::kCompressDeflated,
-                nullptr) != android::NO_ERROR) {
+    if (outApk->addCompressed(data, buildFileReference(item).data(), nullptr) !=
+            android::NO_ERROR) {
         Logger::error(options.output) << "failed to write linked file '"
                                       << buildFileReference(item) << "' to apk." << std::endl;
         return false;
@@ -482,30 +554,130 @@ bool linkXml(const AaptOptions& options, const std::shared_ptr<ResourceTable>& t
     return true;
 }
 
-bool compilePng(const AaptOptions& options, const CompileItem& item, ZipFile* outApk) {
+bool compilePng(const AaptOptions& options, const CompileItem& item, CompiledFile* outFile) {
     std::ifstream in(item.source.path, std::ifstream::binary);
     if (!in) {
         Logger::error(item.source) << strerror(errno) << std::endl;
         return false;
     }
 
-    BigBuffer outBuffer(4096);
+    std::unique_ptr<BigBuffer> outBuffer = util::make_unique<BigBuffer>(4096);
     std::string err;
     Png png;
-    if (!png.process(item.source, in, &outBuffer, {}, &err)) {
+    if (!png.process(item.source, in, outBuffer.get(), {}, &err)) {
         Logger::error(item.source) << err << std::endl;
         return false;
     }
+    outFile->buffer = std::move(outBuffer);
+    return true;
+}
+
+/**
+ * Compiles the file of the item, or does nothing if it is copied as is.
+ * With a cache, files compiled before with the same contents and options
+ * are read from it rather than compiled again.
+ */
+bool compileFile(const AaptOptions& options, const CompileCache* cache, const CompileItem& item,
+                 CompiledFile* outFile) {
+    const bool isXml = item.extension == "xml";
+    if (!isXml && item.extension != "png" && item.extension != "9.png") {
+        outFile->copy = true;
+        return true;
+    }
 
-    if (outApk->add(outBuffer, buildFileReference(item).data(), ZipEntry::kCompressStored,
-                nullptr) != android::NO_ERROR) {
-        Logger::error(options.output) << "failed to write compiled '" << item.source
-                                      << "' to apk." << std::endl;
+    Profiler::Scope scope(options.profiler, isXml ? "compile xml" : "compile png",
+                          item.source.path);
+
+    std::string key;
+    if (cache) {
+        // Everything the compiled file depends on besides the contents of the source.
+        std::stringstream keyOptions;
+        keyOptions << kAaptVersionStr << " " << item.extension << " " << item.config;
+        if (isXml) {
+            keyOptions << " " << options.appInfo.package;
+        }
+
+        if (CompileCache::computeKey(item.source.path, keyOptions.str(), &key)) {
+            std::unique_ptr<BigBuffer> buffer = util::make_unique<BigBuffer>(1024);
+            if (cache->get(key, buffer.get(), &outFile->ids)) {
+                outFile->buffer = std::move(buffer);
+                return true;
+            }
+        }
+    }
+
+    if (!(isXml ? compileXml(options, item, outFile) : compilePng(options, item, outFile))) {
         return false;
     }
+
+    if (!key.empty() && !cache->put(key, *outFile->buffer, outFile->ids)) {
+        Logger::warn(item.source) << "failed to cache compiled file." << std::endl;
+    }
     return true;
 }
 
+/**
+ * Calls work on options.jobs threads, this one included, but no more than there
+ * are items, and waits for them to return. work is expected to take the next
+ * item not processed yet until there are none left.
+ */
+static void runJobs(const AaptOptions& options, size_t itemCount,
+                    const std::function<void()>& work) {
+#ifdef _WIN32
+    // The Windows toolchain has no std::thread, run serially.
+    work();
+#else
+    size_t jobs = options.jobs;
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    jobs = std::min(jobs, itemCount);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < jobs; i++) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+#endif
+}
+
+/**
+ * Compiles the files of the items on options.jobs threads. Each thread takes the
+ * next item not compiled yet, so a few large files don't hold back the others.
+ * Returns false if any of them failed to compile.
+ */
+bool compileFiles(const AaptOptions& options, const std::vector<CompileItem>& items,
+                  std::vector<CompiledFile>* outFiles) {
+    outFiles->resize(items.size());
+
+    std::unique_ptr<CompileCache> cache;
+    if (options.compileCache) {
+        const std::string& directory = options.compileCache.value().path;
+        if (mkdirs(directory)) {
+            cache = util::make_unique<CompileCache>(directory);
+        } else {
+            Logger::warn(options.compileCache.value()) << "failed to create cache directory: "
+                                                       << strerror(errno) << std::endl;
+        }
+    }
+
+    std::atomic<size_t> nextItem(0);
+    std::atomic<bool> error(false);
+    auto work = [&]() {
+        size_t i;
+        while ((i = nextItem++) < items.size()) {
+            if (!compileFile(options, cache.get(), items[i], &(*outFiles)[i])) {
+                error = true;
+            }
+        }
+    };
+    runJobs(options, items.size(), work);
+    return !error;
+}
+
 bool copyFile(const AaptOptions& options, const CompileItem& item, ZipFile* outApk) {
     if (outApk->add(item.source.path.data(), buildFileReference(item).data(),
                 ZipEntry::kCompressStored, nullptr) != android::NO_ERROR) {
@@ -516,9 +688,32 @@ bool copyFile(const AaptOptions& options, const CompileItem& item, ZipFile* outA
     return true;
 }
 
+/**
+ * Returns the <manifest> element at the root of an AndroidManifest.xml.
+ */
+static xml::Element* findManifestElement(xml::Node* root) {
+    while (root && root->type == xml::NodeType::kNamespace && !root->children.empty()) {
+        root = root->children[0].get();
+    }
+
+    if (root && root->type == xml::NodeType::kElement) {
+        xml::Element* el = static_cast<xml::Element*>(root);
+        if (el->namespaceUri.empty() && el->name == u"manifest") {
+            return el;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Merges the manifest of the app with the ones of the libraries and writes it
+ * in the APK. The splits of the APK must have the same version code, it is
+ * returned in outVersionCode, left empty if the manifest has none.
+ */
 bool compileManifest(const AaptOptions& options, const std::shared_ptr<IResolver>& resolver,
                      const std::map<std::shared_ptr<ResourceTable>, StaticLibraryData>& libApks,
-                     const android::ResTable& table, ZipFile* outApk, proguard::KeepSet* keepSet) {
+                     const android::ResTable& table, ZipFile* outApk, proguard::KeepSet* keepSet,
+                     std::u16string* outVersionCode) {
     if (options.verbose) {
         Logger::note(options.manifest) << "compiling AndroidManifest.xml." << std::endl;
     }
@@ -571,6 +766,12 @@ bool compileManifest(const AaptOptions& options, const std::shared_ptr<IResolver
                                                   keepSet);
     }
 
+    if (xml::Element* manifestEl = findManifestElement(merger.getMergedXml())) {
+        if (xml::Attribute* attr = manifestEl->findAttribute(kSchemaAndroid, u"versionCode")) {
+            *outVersionCode = attr->value;
+        }
+    }
+
     BigBuffer outBuffer(1024);
     if (!xml::flattenAndLink(options.manifest, merger.getMergedXml(), options.appInfo.package,
                 resolver, {}, &outBuffer)) {
@@ -665,22 +866,51 @@ static Maybe<ResourcePathData> extractResourcePathData(const Source& source) {
     };
 }
 
-bool writeResourceTable(const AaptOptions& options, const std::shared_ptr<ResourceTable>& table,
-                        const TableFlattener::Options& flattenerOptions, ZipFile* outApk) {
-    if (table->begin() != table->end()) {
-        BigBuffer buffer(1024);
-        TableFlattener flattener(flattenerOptions);
-        if (!flattener.flatten(&buffer, *table)) {
-            Logger::error() << "failed to flatten resource table." << std::endl;
-            return false;
+/**
+ * Flattens the table into each of the APKs, with the flattener options for that
+ * APK. The flatteners only read the table, so they run concurrently.
+ */
+bool writeResourceTables(const AaptOptions& options, const std::shared_ptr<ResourceTable>& table,
+                         const std::vector<TableFlattener::Options>& flattenerOptions,
+                         const std::vector<ZipFile*>& outApks) {
+    assert(flattenerOptions.size() == outApks.size());
+    if (table->begin() == table->end()) {
+        return true;
+    }
+
+    std::vector<BigBuffer> buffers;
+    buffers.reserve(outApks.size());
+    for (size_t i = 0; i < outApks.size(); i++) {
+        buffers.emplace_back(1024);
+    }
+
+    std::atomic<size_t> nextTable(0);
+    std::atomic<bool> error(false);
+    auto work = [&]() {
+        size_t i;
+        while ((i = nextTable++) < outApks.size()) {
+            Profiler::Scope scope(options.profiler, "flatten table");
+            TableFlattener flattener(flattenerOptions[i]);
+            if (!flattener.flatten(&buffers[i], *table)) {
+                error = true;
+            }
         }
+    };
+    runJobs(options, outApks.size(), work);
+
+    if (error) {
+        Logger::error() << "failed to flatten resource table." << std::endl;
+        return false;
+    }
 
+    Profiler::Scope scope(options.profiler, "write table");
+    for (size_t i = 0; i < outApks.size(); i++) {
         if (options.verbose) {
-            Logger::note() << "Final resource table size=" << util::formatSize(buffer.size())
+            Logger::note() << "Final resource table size=" << util::formatSize(buffers[i].size())
                            << std::endl;
         }
 
-        if (outApk->add(buffer, "resources.arsc", ZipEntry::kCompressStored, nullptr) !=
+        if (outApks[i]->add(buffers[i], "resources.arsc", ZipEntry::kCompressStored, nullptr) !=
                 android::NO_ERROR) {
             Logger::note(options.output) << "failed to store resource table." << std::endl;
             return false;
@@ -689,6 +919,71 @@ bool writeResourceTable(const AaptOptions& options, const std::shared_ptr<Resour
     return true;
 }
 
+bool writeResourceTable(const AaptOptions& options, const std::shared_ptr<ResourceTable>& table,
+                        const TableFlattener::Options& flattenerOptions, ZipFile* outApk) {
+    return writeResourceTables(options, table, { flattenerOptions }, { outApk });
+}
+
+/**
+ * Returns the index of the split that holds the values for config, or -1 if
+ * they belong in the base APK.
+ */
+static int findSplit(const AaptOptions& options, ConfigDescription config) {
+    config.sdkVersion = 0;
+    config.minorVersion = 0;
+    for (size_t i = 0; i < options.splits.size(); i++) {
+        const std::vector<ConfigDescription>& configs = options.splits[i].configs;
+        if (std::find(configs.begin(), configs.end(), config) != configs.end()) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Writes the AndroidManifest.xml of a split APK, which only names the split
+ * and matches the package and version code of the base APK.
+ */
+static bool writeSplitManifest(const AaptOptions& options,
+                               const std::shared_ptr<IResolver>& resolver,
+                               const AaptOptions::Split& split,
+                               const std::u16string& versionCode, ZipFile* outApk) {
+    std::stringstream splitName;
+    splitName << "config.";
+    for (size_t i = 0; i < split.configs.size(); i++) {
+        splitName << (i == 0 ? "" : "_") << split.configs[i];
+    }
+
+    std::stringstream manifest;
+    manifest << "<manifest xmlns:android=\"" << util::utf16ToUtf8(kSchemaAndroid) << "\""
+             << " package=\"" << util::utf16ToUtf8(options.appInfo.package) << "\""
+             << " split=\"" << splitName.str() << "\"";
+    if (!versionCode.empty()) {
+        manifest << " android:versionCode=\"" << util::utf16ToUtf8(versionCode) << "\"";
+    }
+    manifest << "><application android:hasCode=\"false\" /></manifest>";
+
+    SourceLogger logger(split.output);
+    std::unique_ptr<xml::Node> root = xml::inflate(&manifest, &logger);
+    if (!root) {
+        return false;
+    }
+
+    BigBuffer outBuffer(1024);
+    if (!xml::flattenAndLink(split.output, root.get(), options.appInfo.package, resolver, {},
+                &outBuffer)) {
+        return false;
+    }
+
+    if (outApk->add(outBuffer, "AndroidManifest.xml", ZipEntry::kCompressStored, nullptr) !=
+            android::NO_ERROR) {
+        Logger::error(split.output) << "failed to write 'AndroidManifest.xml' to apk."
+                                    << std::endl;
+        return false;
+    }
+    return true;
+}
+
 /**
  * For each FileReference in the table, adds a LinkItem to the link queue for processing.
  */
@@ -728,6 +1023,36 @@ static void addApkFilesToLinkQueue(const std::u16string& package, const Source&
 static constexpr int kOpenFlags = ZipFile::kOpenCreate | ZipFile::kOpenTruncate |
         ZipFile::kOpenReadWrite;
 
+// The alignment of the stored entries of linked APKs, as zipalign does it,
+// so they can be mmap'd in place.
+static constexpr int kApkAlignment = 4;
+
+/**
+ * Writes a generated file, leaving it untouched if it already has these
+ * contents so that its timestamp doesn't make build systems rebuild
+ * everything that depends on it.
+ */
+static bool writeFileIfChanged(const AaptOptions& options, const Source& outPath,
+                               const std::string& contents, const char* description) {
+    if (fileMatches(outPath.path, contents)) {
+        if (options.verbose) {
+            Logger::note(outPath) << description << " are unchanged." << std::endl;
+        }
+        return true;
+    }
+
+    if (options.verbose) {
+        Logger::note(outPath) << "writing " << description << "." << std::endl;
+    }
+
+    std::ofstream fout(outPath.path, std::ofstream::binary);
+    if (!fout || !(fout << contents) || !fout.flush()) {
+        Logger::error(outPath) << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
 bool link(const AaptOptions& options, const std::shared_ptr<ResourceTable>& outTable,
           const std::shared_ptr<IResolver>& resolver) {
     std::map<std::shared_ptr<ResourceTable>, StaticLibraryData> apkFiles;
@@ -738,6 +1063,7 @@ bool link(const AaptOptions& options, const std::shared_ptr<ResourceTable>& outT
 
     // Load all APK files.
     for (const Source& source : options.input) {
+        Profiler::Scope scope(options.profiler, "load apk", source.path);
         std::unique_ptr<ZipFile> zipFile = util::make_unique<ZipFile>();
         if (zipFile->open(source.path.data(), ZipFile::kOpenReadOnly) != android::NO_ERROR) {
             Logger::error(source) << "failed to open: " << strerror(errno) << std::endl;
@@ -772,6 +1098,7 @@ bool link(const AaptOptions& options, const std::shared_ptr<ResourceTable>& outT
     std::queue<LinkItem> linkQueue;
     for (auto& p : apkFiles) {
         const std::shared_ptr<ResourceTable>& inTable = p.first;
+        Profiler::Scope scope(options.profiler, "merge table", p.second.source.path);
 
         // Collect all FileReferences and add them to the queue for processing.
         addApkFilesToLinkQueue(options.appInfo.package, p.second.source, inTable, p.second.apk,
@@ -785,12 +1112,15 @@ bool link(const AaptOptions& options, const std::shared_ptr<ResourceTable>& outT
 
     // Version all styles referencing attributes outside of their specified SDK version.
     if (options.versionStylesAndLayouts) {
+        Profiler::Scope scope(options.profiler, "version styles");
         versionStylesForCompat(outTable);
     }
 
     {
         // Now that everything is merged, let's link it.
+        Profiler::Scope scope(options.profiler, "link table");
         Linker::Options linkerOptions;
+        linkerOptions.jobs = options.jobs;
         if (options.packageType == AaptOptions::PackageType::StaticLibrary) {
             linkerOptions.linkResourceIds = false;
         }
@@ -818,47 +1148,126 @@ bool link(const AaptOptions& options, const std::shared_ptr<ResourceTable>& outT
         Logger::error(options.output) << "failed to open: " << strerror(errno) << std::endl;
         return false;
     }
+    outApk.setAlignment(kApkAlignment);
 
-    proguard::KeepSet keepSet;
-
-    android::ResTable binTable;
-    if (!compileManifest(options, resolver, apkFiles, binTable, &outApk, &keepSet)) {
-        return false;
+    // The splits share the IDs of the linked table, which is only flattened
+    // with different values for each APK.
+    std::vector<std::unique_ptr<ZipFile>> splitApks;
+    for (const AaptOptions::Split& split : options.splits) {
+        std::unique_ptr<ZipFile> splitApk = util::make_unique<ZipFile>();
+        if (splitApk->open(split.output.path.data(), kOpenFlags) != android::NO_ERROR) {
+            Logger::error(split.output) << "failed to open: " << strerror(errno) << std::endl;
+            return false;
+        }
+        splitApk->setAlignment(kApkAlignment);
+        splitApks.push_back(std::move(splitApk));
     }
 
-    for (; !linkQueue.empty(); linkQueue.pop()) {
-        const LinkItem& item = linkQueue.front();
+    auto apkForConfig = [&](const ConfigDescription& config) -> ZipFile* {
+        const int split = findSplit(options, config);
+        return split < 0 ? &outApk : splitApks[split].get();
+    };
 
-        assert(!item.originalPackage.empty());
-        ZipEntry* entry = item.apk->getEntryByName(item.originalPath.data());
-        if (!entry) {
-            Logger::error(item.source) << "failed to find '" << item.originalPath << "'."
-                                       << std::endl;
+    proguard::KeepSet keepSet;
+
+    android::ResTable binTable;
+    {
+        Profiler::Scope scope(options.profiler, "link manifest", options.manifest.path);
+        std::u16string versionCode;
+        if (!compileManifest(options, resolver, apkFiles, binTable, &outApk, &keepSet,
+                             &versionCode)) {
             return false;
         }
 
-        if (util::stringEndsWith<char>(item.originalPath, ".xml")) {
-            void* uncompressedData = item.apk->uncompress(entry);
-            assert(uncompressedData);
-
-            if (!linkXml(options, outTable, resolver, item, uncompressedData,
-                        entry->getUncompressedLen(), &outApk, &linkQueue, &keepSet)) {
-                Logger::error(options.output) << "failed to link '" << item.originalPath << "'."
-                                              << std::endl;
+        for (size_t i = 0; i < options.splits.size(); i++) {
+            if (!writeSplitManifest(options, resolver, options.splits[i], versionCode,
+                                    splitApks[i].get())) {
                 return false;
             }
-        } else {
-            if (outApk.add(item.apk, entry, buildFileReference(item).data(), 0, nullptr) !=
-                    android::NO_ERROR) {
-                Logger::error(options.output) << "failed to copy '" << item.originalPath << "'."
-                                              << std::endl;
+        }
+    }
+
+    // The XML files are flattened and compressed on several threads. Versioned copies of the
+    // files are queued as the results are added, and linked in the next round.
+    while (!linkQueue.empty()) {
+        struct LinkedFile {
+            LinkItem item;
+            ZipEntry* entry;
+            std::unique_ptr<void, DeleteMalloc> data;
+            std::unique_ptr<ZipFile::CompressedData> compressed;
+            Maybe<size_t> minStrippedSdk;
+            proguard::KeepSet keepSet;
+        };
+
+        // The input APKs can't be read from several threads, so the XML files
+        // are uncompressed up front.
+        std::vector<LinkedFile> files;
+        std::vector<size_t> xmlFiles;
+        for (; !linkQueue.empty(); linkQueue.pop()) {
+            const LinkItem& item = linkQueue.front();
+            assert(!item.originalPackage.empty());
+            ZipEntry* entry = item.apk->getEntryByName(item.originalPath.data());
+            if (!entry) {
+                Logger::error(item.source) << "failed to find '" << item.originalPath << "'."
+                                           << std::endl;
                 return false;
             }
+
+            LinkedFile file = { item, entry };
+            if (util::stringEndsWith<char>(item.originalPath, ".xml")) {
+                file.data.reset(item.apk->uncompress(entry));
+                assert(file.data);
+                file.compressed = util::make_unique<ZipFile::CompressedData>();
+                xmlFiles.push_back(files.size());
+            }
+            files.push_back(std::move(file));
+        }
+
+        std::atomic<size_t> nextFile(0);
+        auto work = [&]() {
+            size_t i;
+            while ((i = nextFile++) < xmlFiles.size()) {
+                LinkedFile& file = files[xmlFiles[i]];
+                Profiler::Scope scope(options.profiler, "link file", file.item.originalPath);
+                file.minStrippedSdk = flattenLinkedXml(options, resolver, file.item,
+                                                       file.data.get(),
+                                                       file.entry->getUncompressedLen(),
+                                                       file.compressed.get(),
+                                                       &file.keepSet);
+                file.data.reset();
+            }
+        };
+        runJobs(options, xmlFiles.size(), work);
+
+        // Add the files in the order they were queued, so the APK is the same
+        // however many jobs were used.
+        for (const LinkedFile& file : files) {
+            const LinkItem& item = file.item;
+            keepSet.addAll(file.keepSet);
+            if (file.compressed) {
+                if (!file.minStrippedSdk ||
+                        !addLinkedXml(options, outTable, item, file.minStrippedSdk.value(),
+                                      *file.compressed, apkForConfig(item.config),
+                                      &linkQueue)) {
+                    Logger::error(options.output) << "failed to link '" << item.originalPath
+                                                  << "'." << std::endl;
+                    return false;
+                }
+            } else {
+                if (apkForConfig(item.config)->add(item.apk, file.entry,
+                                                   buildFileReference(item).data(), 0,
+                                                   nullptr) != android::NO_ERROR) {
+                    Logger::error(options.output) << "failed to copy '" << item.originalPath
+                                                  << "'." << std::endl;
+                    return false;
+                }
+            }
         }
     }
 
     // Generate the Java class file.
     if (options.generateJavaClass) {
+        Profiler::Scope scope(options.profiler, "generate java");
         JavaClassGenerator::Options javaOptions;
         if (options.packageType == AaptOptions::PackageType::StaticLibrary) {
             javaOptions.useFinal = false;
@@ -882,25 +1291,48 @@ bool link(const AaptOptions& options, const std::shared_ptr<ResourceTable>& outT
 
             appendPath(&outPath.path, "R.java");
 
-            if (options.verbose) {
-                Logger::note(outPath) << "writing Java symbols." << std::endl;
-            }
-
-            std::ofstream fout(outPath.path);
-            if (!fout) {
-                Logger::error(outPath) << strerror(errno) << std::endl;
+            std::stringstream out;
+            if (!generator.generate(package, out)) {
+                Logger::error(outPath) << generator.getError() << "." << std::endl;
                 return false;
             }
 
-            if (!generator.generate(package, fout)) {
-                Logger::error(outPath) << generator.getError() << "." << std::endl;
+            if (!writeFileIfChanged(options, outPath, out.str(), "Java symbols")) {
                 return false;
             }
         }
     }
 
+    // Generate the text symbols file.
+    if (options.generateTextSymbols) {
+        Profiler::Scope scope(options.profiler, "generate text symbols");
+        JavaClassGenerator::Options javaOptions;
+        if (options.packageType == AaptOptions::PackageType::StaticLibrary) {
+            javaOptions.useFinal = false;
+        }
+        JavaClassGenerator generator(outTable, javaOptions);
+
+        Source outPath = options.generateTextSymbols.value();
+        if (!mkdirs(outPath.path)) {
+            Logger::error(outPath) << strerror(errno) << std::endl;
+            return false;
+        }
+        appendPath(&outPath.path, "R.txt");
+
+        std::stringstream out;
+        if (!generator.generateTextSymbols(options.appInfo.package, out)) {
+            Logger::error(outPath) << generator.getError() << "." << std::endl;
+            return false;
+        }
+
+        if (!writeFileIfChanged(options, outPath, out.str(), "text symbols")) {
+            return false;
+        }
+    }
+
     // Generate the Proguard rules file.
     if (options.generateProguardRules) {
+        Profiler::Scope scope(options.profiler, "generate proguard");
         const Source& outPath = options.generateProguardRules.value();
 
         if (options.verbose) {
@@ -919,18 +1351,21 @@ bool link(const AaptOptions& options, const std::shared_ptr<ResourceTable>& outT
         }
     }
 
-    outTable->getValueStringPool().prune();
-    outTable->getValueStringPool().sort(
-            [](const StringPool::Entry& a, const StringPool::Entry& b) -> bool {
-                if (a.context.priority < b.context.priority) {
-                    return true;
-                }
+    {
+        Profiler::Scope scope(options.profiler, "sort strings");
+        outTable->getValueStringPool().prune();
+        outTable->getValueStringPool().sort(
+                [](const StringPool::Entry& a, const StringPool::Entry& b) -> bool {
+                    if (a.context.priority < b.context.priority) {
+                        return true;
+                    }
 
-                if (a.context.priority > b.context.priority) {
-                    return false;
-                }
-                return a.value < b.value;
-            });
+                    if (a.context.priority > b.context.priority) {
+                        return false;
+                    }
+                    return a.value < b.value;
+                });
+    }
 
 
     // Flatten the resource table.
@@ -939,17 +1374,38 @@ bool link(const AaptOptions& options, const std::shared_ptr<ResourceTable>& outT
         flattenerOptions.useExtendedChunks = false;
     }
 
-    if (!writeResourceTable(options, outTable, flattenerOptions, &outApk)) {
+    std::vector<TableFlattener::Options> tableOptions = { flattenerOptions };
+    std::vector<ZipFile*> tableApks = { &outApk };
+    if (!options.splits.empty()) {
+        const AaptOptions* opts = &options;
+        tableOptions.front().configFilter = [opts](const ConfigDescription& config) -> bool {
+            return findSplit(*opts, config) < 0;
+        };
+
+        for (size_t i = 0; i < splitApks.size(); i++) {
+            tableOptions.push_back(flattenerOptions);
+            tableOptions.back().configFilter = [opts, i](const ConfigDescription& config) -> bool {
+                return findSplit(*opts, config) == static_cast<int>(i);
+            };
+            tableApks.push_back(splitApks[i].get());
+        }
+    }
+
+    if (!writeResourceTables(options, outTable, tableOptions, tableApks)) {
         return false;
     }
 
+    Profiler::Scope scope(options.profiler, "flush apk");
     outApk.flush();
+    for (std::unique_ptr<ZipFile>& splitApk : splitApks) {
+        splitApk->flush();
+    }
     return true;
 }
 
 bool compile(const AaptOptions& options, const std::shared_ptr<ResourceTable>& table,
              const std::shared_ptr<IResolver>& resolver) {
-    std::queue<CompileItem> compileQueue;
+    std::vector<CompileItem> compileItems;
     bool error = false;
 
     // Compile all the resource files passed in on the command line.
@@ -968,6 +1424,7 @@ bool compile(const AaptOptions& options, const std::shared_ptr<ResourceTable>& t
                 Logger::note(source) << "compiling values." << std::endl;
             }
 
+            Profiler::Scope scope(options.profiler, "compile values", source.path);
             error |= !compileValues(table, source, pathData.config);
         } else {
             // The file is in a directory like 'layout' or 'drawable'. Find out
@@ -979,7 +1436,7 @@ bool compile(const AaptOptions& options, const std::shared_ptr<ResourceTable>& t
                 return false;
             }
 
-            compileQueue.push(CompileItem{
+            compileItems.push_back(CompileItem{
                     ResourceName{ table->getPackage(), *type, pathData.name },
                     pathData.config,
                     source,
@@ -998,19 +1455,37 @@ bool compile(const AaptOptions& options, const std::shared_ptr<ResourceTable>& t
         return false;
     }
 
-    // Compile each file.
-    for (; !compileQueue.empty(); compileQueue.pop()) {
-        const CompileItem& item = compileQueue.front();
+    // Compile the files in parallel.
+    std::vector<CompiledFile> compiledFiles;
+    error |= !compileFiles(options, compileItems, &compiledFiles);
+
+    // Then add them to the table and the APK in order, so that the output doesn't
+    // depend on which file finished first.
+    for (size_t i = 0; i < compileItems.size(); i++) {
+        const CompileItem& item = compileItems[i];
+        CompiledFile& compiledFile = compiledFiles[i];
+        Profiler::Scope scope(options.profiler, "write file", item.source.path);
 
         // Add the file name to the resource table.
         error |= !addFileReference(table, item);
 
-        if (item.extension == "xml") {
-            error |= !compileXml(options, table, item, &outApk);
-        } else if (item.extension == "png" || item.extension == "9.png") {
-            error |= !compilePng(options, item, &outApk);
-        } else {
+        for (const auto& id : compiledFile.ids) {
+            table->addResource(id.first, {}, item.source.line(id.second),
+                               util::make_unique<Id>());
+        }
+
+        if (compiledFile.copy) {
             error |= !copyFile(options, item, &outApk);
+        } else if (compiledFile.buffer) {
+            // Write the resulting compiled file to the output APK.
+            if (outApk.add(*compiledFile.buffer, buildFileReference(item).data(),
+                        ZipEntry::kCompressStored, nullptr) != android::NO_ERROR) {
+                Logger::error(options.output) << "failed to write compiled '" << item.source
+                                              << "' to apk." << std::endl;
+                error = true;
+            }
+            // Release the memory of the file as soon as it's written.
+            compiledFile.buffer.reset();
         }
     }
 
@@ -1018,10 +1493,13 @@ bool compile(const AaptOptions& options, const std::shared_ptr<ResourceTable>& t
         return false;
     }
 
-    // Link and assign resource IDs.
-    Linker linker(table, resolver, {});
-    if (!linker.linkAndValidate()) {
-        return false;
+    {
+        // Link and assign resource IDs.
+        Profiler::Scope scope(options.profiler, "link table");
+        Linker linker(table, resolver, {});
+        if (!linker.linkAndValidate()) {
+            return false;
+        }
     }
 
     // Flatten the resource table.
@@ -1029,6 +1507,7 @@ bool compile(const AaptOptions& options, const std::shared_ptr<ResourceTable>& t
         return false;
     }
 
+    Profiler::Scope scope(options.profiler, "flush apk");
     outApk.flush();
     return true;
 }
@@ -1050,12 +1529,50 @@ static void printCommandsAndDie() {
     std::cerr << "compile       compiles a subset of resources" << std::endl;
     std::cerr << "link          links together compiled resources and libraries" << std::endl;
     std::cerr << "dump          dumps resource contents to to standard out" << std::endl;
+    std::cerr << "daemon        runs the commands read from standard in, keeping the "
+                 "libraries loaded" << std::endl;
     std::cerr << std::endl;
     std::cerr << "run aapt2 with one of the commands and the -h flag for extra details."
               << std::endl;
     exit(1);
 }
 
+/**
+ * Parses a split given as <path>:<config>[,<config>...]. A configuration may
+ * only go in one split.
+ */
+static bool parseSplit(const StringPiece& arg, std::vector<AaptOptions::Split>* outSplits,
+                       std::string* outError) {
+    const std::string argStr = arg.toString();
+    const size_t colonPos = argStr.rfind(':');
+    if (colonPos == std::string::npos || colonPos == 0 || colonPos == argStr.size() - 1) {
+        *outError = "split must be <path>:<config>[,<config>...]";
+        return false;
+    }
+
+    AaptOptions::Split split;
+    split.output = Source{ argStr.substr(0, colonPos) };
+    for (StringPiece configStr : util::tokenize<char>(
+                StringPiece(argStr).substr(colonPos + 1), ',')) {
+        ConfigDescription config;
+        if (!ConfigDescription::parse(configStr, &config) || config.sdkVersion != 0) {
+            *outError = "invalid split configuration '" + configStr.toString() + "'";
+            return false;
+        }
+
+        for (const AaptOptions::Split& otherSplit : *outSplits) {
+            if (std::find(otherSplit.configs.begin(), otherSplit.configs.end(), config) !=
+                    otherSplit.configs.end()) {
+                *outError = "configuration '" + configStr.toString() + "' is in two splits";
+                return false;
+            }
+        }
+        split.configs.push_back(config);
+    }
+    outSplits->push_back(std::move(split));
+    return true;
+}
+
 static AaptOptions prepareArgs(int argc, char** argv) {
     if (argc < 2) {
         std::cerr << "no command specified." << std::endl << std::endl;
@@ -1101,6 +1618,11 @@ static AaptOptions prepareArgs(int argc, char** argv) {
                     options.generateJavaClass = Source{ arg.toString() };
                 });
 
+        flag::optionalFlag("--output-text-symbols", "directory in which to generate R.txt",
+                [&options](const StringPiece& arg) {
+                    options.generateTextSymbols = Source{ arg.toString() };
+                });
+
         flag::optionalFlag("--proguard", "file in which to output proguard rules",
                 [&options](const StringPiece& arg) {
                     options.generateProguardRules = Source{ arg.toString() };
@@ -1115,6 +1637,34 @@ static AaptOptions prepareArgs(int argc, char** argv) {
                 });
         flag::optionalSwitch("--no-version", "Disables automatic style and layout versioning",
                              false, &options.versionStylesAndLayouts);
+
+        flag::optionalFlag("--split", "split APK to generate along with the base APK, "
+                           "as <path>:<config>[,<config>...]",
+                [&options](const StringPiece& arg, std::string* outError) -> bool {
+                    return parseSplit(arg, &options.splits, outError);
+                });
+    }
+
+    if (options.phase == AaptOptions::Phase::Compile ||
+            options.phase == AaptOptions::Phase::Link) {
+        flag::optionalFlag("-j", "number of files or resource types to process at once, "
+                           "defaults to one per core",
+                [&options](const StringPiece& arg) {
+                    options.jobs = std::max(1l, strtol(arg.toString().data(), nullptr, 10));
+                });
+
+        flag::optionalFlag("--profile", "file in which to write a Chrome trace of where the "
+                           "time is spent",
+                [&options](const StringPiece& arg) {
+                    options.profileOutput = Source{ arg.toString() };
+                });
+    }
+
+    if (options.phase == AaptOptions::Phase::Compile) {
+        flag::optionalFlag("--cache", "directory in which to keep compiled files between builds",
+                [&options](const StringPiece& arg) {
+                    options.compileCache = Source{ arg.toString() };
+                });
     }
 
     if (options.phase == AaptOptions::Phase::Compile ||
@@ -1155,6 +1705,10 @@ static AaptOptions prepareArgs(int argc, char** argv) {
     }
 
     if (isStaticLib) {
+        if (!options.splits.empty()) {
+            std::cerr << "splits can not be generated for a static library." << std::endl;
+            flag::usageAndDie(fullCommand);
+        }
         options.packageType = AaptOptions::PackageType::StaticLibrary;
     }
 
@@ -1203,16 +1757,50 @@ static bool doDump(const AaptOptions& options) {
     return true;
 }
 
-int main(int argc, char** argv) {
-    Logger::setLog(std::make_shared<Log>(std::cerr, std::cerr));
-    AaptOptions options = prepareArgs(argc, argv);
+/**
+ * The libraries loaded so far, by path. Only the daemon loads a library more
+ * than once, it keeps them here as long as the file doesn't change.
+ */
+struct LoadedLibrary {
+    time_t modTime;
+    off_t size;
+    std::shared_ptr<android::AssetManager> assetManager;
+};
+
+static std::map<std::string, LoadedLibrary> sLoadedLibraries;
 
+static std::shared_ptr<android::AssetManager> loadLibrary(const Source& source) {
+    struct stat info;
+    const bool exists = stat(source.path.data(), &info) == 0;
+
+    auto iter = sLoadedLibraries.find(source.path);
+    if (iter != sLoadedLibraries.end()) {
+        if (exists && iter->second.modTime == info.st_mtime &&
+                iter->second.size == info.st_size) {
+            return iter->second.assetManager;
+        }
+        sLoadedLibraries.erase(iter);
+    }
+
+    std::shared_ptr<android::AssetManager> assetManager =
+            std::make_shared<android::AssetManager>();
+    int32_t cookie;
+    if (!assetManager->addAssetPath(android::String8(source.path.data()), &cookie) ||
+            cookie == 0) {
+        return {};
+    }
+
+    if (exists) {
+        sLoadedLibraries[source.path] = LoadedLibrary{ info.st_mtime, info.st_size,
+                                                       assetManager };
+    }
+    return assetManager;
+}
+
+static bool run(AaptOptions options) {
     if (options.phase == AaptOptions::Phase::Dump ||
             options.phase == AaptOptions::Phase::DumpStyleGraph) {
-        if (!doDump(options)) {
-            return 1;
-        }
-        return 0;
+        return doDump(options);
     }
 
     // If we specified a manifest, go ahead and load the package name from the manifest.
@@ -1241,15 +1829,8 @@ int main(int argc, char** argv) {
     // Load the included libraries.
     std::vector<std::shared_ptr<const android::AssetManager>> sources;
     for (const Source& source : options.libraries) {
-        std::shared_ptr<android::AssetManager> assetManager =
-                std::make_shared<android::AssetManager>();
-        int32_t cookie;
-        if (!assetManager->addAssetPath(android::String8(source.path.data()), &cookie)) {
-            Logger::error(source) << "failed to load library." << std::endl;
-            return false;
-        }
-
-        if (cookie == 0) {
+        std::shared_ptr<android::AssetManager> assetManager = loadLibrary(source);
+        if (!assetManager) {
             Logger::error(source) << "failed to load library." << std::endl;
             return false;
         }
@@ -1260,16 +1841,119 @@ int main(int argc, char** argv) {
     std::shared_ptr<ResourceTableResolver> resolver = std::make_shared<ResourceTableResolver>(
             table, sources);
 
+    std::unique_ptr<Profiler> profiler;
+    if (options.profileOutput) {
+        profiler = util::make_unique<Profiler>();
+        options.profiler = profiler.get();
+    }
+
+    bool result = true;
     if (options.phase == AaptOptions::Phase::Compile) {
-        if (!compile(options, table, resolver)) {
-            Logger::error() << "aapt exiting with failures." << std::endl;
-            return 1;
-        }
+        Profiler::Scope scope(options.profiler, "compile");
+        result = compile(options, table, resolver);
     } else if (options.phase == AaptOptions::Phase::Link) {
-        if (!link(options, table, resolver)) {
-            Logger::error() << "aapt exiting with failures." << std::endl;
-            return 1;
+        Profiler::Scope scope(options.profiler, "link");
+        result = link(options, table, resolver);
+    }
+
+    // Write the trace even if the phase failed, it may show why.
+    if (profiler) {
+        const Source& outPath = options.profileOutput.value();
+        std::ofstream fout(outPath.path);
+        if (fout) {
+            profiler->writeChromeTrace(fout);
+        }
+
+        if (!fout) {
+            Logger::error(outPath) << "failed to write profile: " << strerror(errno) << std::endl;
+            result = false;
+        }
+    }
+
+    if (!result) {
+        Logger::error() << "aapt exiting with failures." << std::endl;
+    }
+    return result;
+}
+
+#ifndef _WIN32
+/**
+ * Runs one command of the daemon. The libraries it links against are loaded
+ * and parsed here, so they stay loaded for the next commands, then the command
+ * runs in a child process: it gets the loaded libraries for free, and it can
+ * exit on bad arguments without taking the daemon down.
+ */
+static bool runDaemonCommand(const std::vector<std::string>& args) {
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        if (args[i] == "-I") {
+            std::shared_ptr<android::AssetManager> assetManager =
+                    loadLibrary(Source{ args[i + 1] });
+            if (assetManager) {
+                assetManager->getResources(false);
+            }
+        }
+    }
+
+    std::cout.flush();
+    const pid_t pid = fork();
+    if (pid < 0) {
+        Logger::error() << "failed to start command: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if (pid == 0) {
+        std::vector<char*> argv = { const_cast<char*>("aapt2") };
+        for (const std::string& arg : args) {
+            argv.push_back(const_cast<char*>(arg.data()));
+        }
+        argv.push_back(nullptr);
+
+        const bool result = run(prepareArgs(argv.size() - 1, argv.data()));
+        std::cout.flush();
+        _exit(result ? 0 : 1);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+#endif
+
+/**
+ * Reads commands from standard in, one argument per line, each command ended
+ * by an empty line. "Done" or "Error" is written to standard out once a
+ * command is finished.
+ */
+static int runDaemon() {
+#ifdef _WIN32
+    Logger::error() << "daemon mode is not supported on Windows." << std::endl;
+    return 1;
+#else
+    std::vector<std::string> args;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty()) {
+            args.push_back(line);
+            continue;
+        }
+
+        if (!args.empty()) {
+            std::cout << (runDaemonCommand(args) ? "Done" : "Error") << std::endl;
+            args.clear();
         }
     }
     return 0;
+#endif
+}
+
+int main(int argc, char** argv) {
+    Logger::setLog(std::make_shared<Log>(std::cerr, std::cerr));
+    if (argc == 2 && StringPiece(argv[1]) == "daemon") {
+        return runDaemon();
+    }
+    return run(prepareArgs(argc, argv)) ? 0 : 1;
 }
@@ -21,6 +21,7 @@
 #include "Util.h"
 
 #include <androidfw/ResourceTypes.h>
+#include <cstring>
 #include <iostream>
 #include <png.h>
 #include <sstream>
@@ -229,6 +230,63 @@ static void checkNinePatchSerialization(android::Res_png_9patch* inPatch,  void*
 #define MAX(a,b) ((a)>(b)?(a):(b))
 #define ABS(a)   ((a)<0?-(a):(a))
 
+/**
+ * Finds the index of each color in the palette of up to 256 colors built while
+ * analyzing an image, in the order the colors were first seen. Searching the
+ * palette cost up to 256 comparisons per pixel in images with many colors;
+ * this checks the color of the previous pixel, which most pixels share, then
+ * probes a hash table twice the size of the palette.
+ */
+class PaletteIndex {
+public:
+    PaletteIndex(uint32_t* colors) : mColors(colors), mCount(0), mLastColor(0), mLastIndex(-1) {
+        memset(mSlots, -1, sizeof(mSlots));
+    }
+
+    int count() const {
+        return mCount;
+    }
+
+    /**
+     * Returns the index of the color, adding it to the palette if needed.
+     * Returns 256 if the color is new and the palette is full.
+     */
+    int indexOf(uint32_t color) {
+        if (mLastIndex >= 0 && color == mLastColor) {
+            return mLastIndex;
+        }
+
+        size_t slot = (color * 0x9e3779b1u) >> (32 - kSlotBits);
+        while (mSlots[slot] >= 0) {
+            if (mColors[mSlots[slot]] == color) {
+                mLastColor = color;
+                mLastIndex = mSlots[slot];
+                return mLastIndex;
+            }
+            slot = (slot + 1) & (kSlotCount - 1);
+        }
+
+        if (mCount == 256) {
+            return 256;
+        }
+        mColors[mCount] = color;
+        mSlots[slot] = mCount;
+        mLastColor = color;
+        mLastIndex = mCount;
+        return mCount++;
+    }
+
+private:
+    static constexpr int kSlotBits = 9;
+    static constexpr size_t kSlotCount = 1 << kSlotBits;
+
+    uint32_t* mColors;
+    int mCount;
+    uint32_t mLastColor;
+    int mLastIndex;
+    int16_t mSlots[kSlotCount];
+};
+
 static void analyze_image(SourceLogger* logger, const PngInfo& imageInfo, int grayscaleTolerance,
                           png_colorp rgbPalette, png_bytep alphaPalette,
                           int *paletteEntries, bool *hasTransparency, int *colorType,
@@ -239,6 +297,7 @@ static void analyze_image(SourceLogger* logger, const PngInfo& imageInfo, int gr
     uint32_t colors[256], col;
     int num_colors = 0;
     int maxGrayDeviation = 0;
+    PaletteIndex paletteIndex(colors);
 
     bool isOpaque = true;
     bool isPalette = true;
@@ -299,31 +358,22 @@ static void analyze_image(SourceLogger* logger, const PngInfo& imageInfo, int gr
             // Check if image is really <= 256 colors
             if (isPalette) {
                 col = (uint32_t) ((rr << 24) | (gg << 16) | (bb << 8) | aa);
-                bool match = false;
-                for (idx = 0; idx < num_colors; idx++) {
-                    if (colors[idx] == col) {
-                        match = true;
-                        break;
-                    }
-                }
+                idx = paletteIndex.indexOf(col);
 
                 // Write the palette index for the pixel to outRows optimistically
                 // We might overwrite it later if we decide to encode as gray or
                 // gray + alpha
                 *out++ = idx;
-                if (!match) {
-                    if (num_colors == 256) {
-                        if (kDebug) {
-                            printf("Found 257th color at %d, %d\n", i, j);
-                        }
-                        isPalette = false;
-                    } else {
-                        colors[num_colors++] = col;
+                if (idx == 256) {
+                    if (kDebug) {
+                        printf("Found 257th color at %d, %d\n", i, j);
                     }
+                    isPalette = false;
                 }
             }
         }
     }
+    num_colors = paletteIndex.count();
 
     *paletteEntries = 0;
     *hasTransparency = !isOpaque;
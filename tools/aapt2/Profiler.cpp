@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Profiler.h"
+
+#include <ostream>
+#include <pthread.h>
+#include <string>
+#include <time.h>
+#include <utils/AndroidThreads.h>
+
+namespace aapt {
+
+// androidGetTid() falls back to getpid() where there's no gettid(), which
+// would put every event on the same thread.
+static uint64_t currentThreadId() {
+#ifdef __APPLE__
+    uint64_t tid = 0;
+    pthread_threadid_np(nullptr, &tid);
+    return tid;
+#else
+    return androidGetTid();
+#endif
+}
+
+Profiler::Scope::Scope(Profiler* profiler, const char* name, const StringPiece& file) :
+        mProfiler(profiler), mName(name), mStartUs(0), mStartCpuUs(0) {
+    if (mProfiler) {
+        mFile = file.toString();
+        mStartUs = mProfiler->nowUs();
+        mStartCpuUs = threadCpuTimeUs();
+    }
+}
+
+Profiler::Scope::~Scope() {
+    if (mProfiler) {
+        const int64_t cpuUs = threadCpuTimeUs();
+        mProfiler->addEvent(Event{
+                mName,
+                std::move(mFile),
+                currentThreadId(),
+                mStartUs,
+                mProfiler->nowUs() - mStartUs,
+                cpuUs >= 0 ? cpuUs - mStartCpuUs : -1
+        });
+    }
+}
+
+Profiler::Profiler() : mStart(std::chrono::steady_clock::now()) {
+}
+
+int64_t Profiler::nowUs() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - mStart).count();
+}
+
+int64_t Profiler::threadCpuTimeUs() {
+#ifdef __linux__
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+#endif
+    return -1;
+}
+
+void Profiler::addEvent(Event&& event) {
+    android::AutoMutex lock(mLock);
+    mEvents.push_back(std::move(event));
+}
+
+static void writeJsonString(std::ostream& out, const std::string& str) {
+    static const char kHex[] = "0123456789abcdef";
+    out << '"';
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << "\\u00" << kHex[(c >> 4) & 0x0f] << kHex[c & 0x0f];
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void Profiler::writeChromeTrace(std::ostream& out) const {
+    android::AutoMutex lock(mLock);
+
+    out << "{\"traceEvents\":[";
+    for (size_t i = 0; i < mEvents.size(); i++) {
+        const Event& event = mEvents[i];
+        if (i != 0) {
+            out << ",";
+        }
+
+        // Complete events, "ph":"X", have a start and a duration.
+        out << "\n{\"name\":";
+        writeJsonString(out, event.name);
+        out << ",\"cat\":\"aapt2\",\"ph\":\"X\",\"pid\":1"
+            << ",\"tid\":" << event.thread
+            << ",\"ts\":" << event.startUs
+            << ",\"dur\":" << event.durationUs
+            << ",\"args\":{";
+
+        bool first = true;
+        if (!event.file.empty()) {
+            out << "\"file\":";
+            writeJsonString(out, event.file);
+            first = false;
+        }
+
+        if (event.cpuUs >= 0) {
+            if (!first) {
+                out << ",";
+            }
+            out << "\"cpu_us\":" << event.cpuUs;
+        }
+        out << "}}";
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+} // namespace aapt
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_PROFILER_H
+#define AAPT_PROFILER_H
+
+#include "StringPiece.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utils/Mutex.h>
+#include <vector>
+
+namespace aapt {
+
+/**
+ * Records how long the phases of aapt2, and the files they process, take.
+ * The events are written in the Chrome trace event format, which
+ * chrome://tracing and most trace viewers read.
+ */
+class Profiler {
+public:
+    /**
+     * Records its lifetime as an event named 'name', about the file 'file'
+     * if it isn't empty. Does nothing if profiler is null, so that the
+     * scopes cost nothing when not profiling.
+     */
+    class Scope {
+    public:
+        Scope(Profiler* profiler, const char* name, const StringPiece& file = {});
+        Scope(const Scope&) = delete; // Not copyable.
+        ~Scope();
+
+    private:
+        Profiler* mProfiler;
+        const char* mName;
+        std::string mFile;
+        int64_t mStartUs;
+        int64_t mStartCpuUs;
+    };
+
+    Profiler();
+    Profiler(const Profiler&) = delete; // Not copyable.
+
+    /**
+     * Writes the events recorded so far as a JSON trace.
+     */
+    void writeChromeTrace(std::ostream& out) const;
+
+private:
+    struct Event {
+        const char* name;
+        std::string file;
+        uint64_t thread;
+        int64_t startUs;
+        int64_t durationUs;
+
+        // The CPU time of the thread during the event, -1 if unknown.
+        int64_t cpuUs;
+    };
+
+    int64_t nowUs() const;
+    static int64_t threadCpuTimeUs();
+
+    void addEvent(Event&& event);
+
+    const std::chrono::steady_clock::time_point mStart;
+
+    mutable android::Mutex mLock;
+    std::vector<Event> mEvents;
+};
+
+} // namespace aapt
+
+#endif // AAPT_PROFILER_H
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Profiler.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+namespace aapt {
+
+TEST(ProfilerTest, WriteNoEvents) {
+    Profiler profiler;
+
+    std::stringstream out;
+    profiler.writeChromeTrace(out);
+    EXPECT_EQ(std::string("{\"traceEvents\":[\n],\"displayTimeUnit\":\"ms\"}\n"), out.str());
+}
+
+TEST(ProfilerTest, WriteEventOfEachScope) {
+    Profiler profiler;
+    {
+        Profiler::Scope scope(&profiler, "compile", "res/layout/main.xml");
+    }
+    {
+        Profiler::Scope scope(&profiler, "link");
+    }
+
+    std::stringstream out;
+    profiler.writeChromeTrace(out);
+    const std::string trace = out.str();
+
+    const size_t compile = trace.find("\"name\":\"compile\"");
+    const size_t link = trace.find("\"name\":\"link\"");
+    ASSERT_NE(std::string::npos, compile);
+    ASSERT_NE(std::string::npos, link);
+    EXPECT_LT(compile, link);
+    EXPECT_NE(std::string::npos, trace.find("\"file\":\"res/layout/main.xml\""));
+}
+
+TEST(ProfilerTest, EscapeFileNames) {
+    Profiler profiler;
+    {
+        Profiler::Scope scope(&profiler, "compile", "res\\\"a\"\n.xml");
+    }
+
+    std::stringstream out;
+    profiler.writeChromeTrace(out);
+    EXPECT_NE(std::string::npos, out.str().find("\"file\":\"res\\\\\\\"a\\\"\\u000a.xml\""));
+}
+
+TEST(ProfilerTest, NullProfilerRecordsNothing) {
+    Profiler::Scope scope(nullptr, "compile", "res/layout/main.xml");
+}
+
+} // namespace aapt
@@ -219,6 +219,15 @@ bool collectProguardRules(ResourceType type, const Source& source, xml::Node* no
     return true;
 }
 
+void KeepSet::addAll(const KeepSet& other) {
+    for (const auto& entry : other.mKeepSet) {
+        mKeepSet[entry.first].insert(entry.second.begin(), entry.second.end());
+    }
+    for (const auto& entry : other.mKeepMethodSet) {
+        mKeepMethodSet[entry.first].insert(entry.second.begin(), entry.second.end());
+    }
+}
+
 bool writeKeepSet(std::ostream* out, const KeepSet& keepSet) {
     for (const auto& entry : keepSet.mKeepSet) {
         for (const SourceLine& source : entry.second) {
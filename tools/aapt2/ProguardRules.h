@@ -39,6 +39,12 @@ public:
         mKeepMethodSet[methodName].insert(source);
     }
 
+    /**
+     * Adds the classes and methods kept by `other`, so that sets collected
+     * separately, eg. on different threads, can be merged.
+     */
+    void addAll(const KeepSet& other);
+
 private:
     friend bool writeKeepSet(std::ostream* out, const KeepSet& keepSet);
 
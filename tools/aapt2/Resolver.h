@@ -27,6 +27,8 @@ namespace aapt {
 
 /**
  * Resolves symbolic references (package:type/entry) into resource IDs/objects.
+ * The Linker resolves from several threads at once, implementations must be
+ * thread-safe.
  */
 class IResolver {
 public:
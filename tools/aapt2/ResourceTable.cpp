@@ -402,8 +402,15 @@ bool ResourceTable::merge(ResourceTable&& other) {
                     });
                 }
             }
+
+            // Our copy is all that's needed now, don't hold both in memory.
+            otherEntry.reset();
         }
+        otherType->entries.clear();
     }
+
+    other.mTypes.clear();
+    other.mValuePool.prune();
     return true;
 }
 
@@ -162,6 +162,9 @@ public:
     /*
      * Merges the resources from `other` into this table, mangling the names of the resources
      * if `other` has a different package name.
+     *
+     * The resources of `other` are released as they are merged, so that the tables being
+     * merged aren't held in memory twice. Afterwards `other` only keeps its package.
      */
     bool merge(ResourceTable&& other);
 
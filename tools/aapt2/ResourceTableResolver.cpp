@@ -52,9 +52,15 @@ Maybe<ResourceId> ResourceTableResolver::findId(const ResourceName& name) {
 }
 
 Maybe<IResolver::Entry> ResourceTableResolver::findAttribute(const ResourceName& name) {
-    auto cacheIter = mCache.find(name);
-    if (cacheIter != std::end(mCache)) {
-        return Entry{ cacheIter->second.id, cacheIter->second.attr.get() };
+    {
+        android::AutoMutex lock(mCacheLock);
+        auto cacheIter = mCache.find(name);
+        if (cacheIter != std::end(mCache)) {
+            if (!cacheIter->second.id.isValid()) {
+                return {};
+            }
+            return Entry{ cacheIter->second.id, cacheIter->second.attr.get() };
+        }
     }
 
     ResourceName mangledName;
@@ -71,8 +77,19 @@ Maybe<IResolver::Entry> ResourceTableResolver::findAttribute(const ResourceName&
             mangledName.type = name.type;
             nameToSearch = &mangledName;
         } else {
+            // Another thread may have built the entry since we looked, and
+            // building it again would free the Attribute it returned.
+            android::AutoMutex lock(mCacheLock);
+            auto cacheIter = mCache.find(name);
+            if (cacheIter != std::end(mCache)) {
+                if (!cacheIter->second.id.isValid()) {
+                    return {};
+                }
+                return Entry{ cacheIter->second.id, cacheIter->second.attr.get() };
+            }
+
             const CacheEntry* cacheEntry = buildCacheEntry(name);
-            if (cacheEntry) {
+            if (cacheEntry->id.isValid()) {
                 return Entry{ cacheEntry->id, cacheEntry->attr.get() };
             }
             return {};
@@ -123,7 +140,8 @@ Maybe<ResourceName> ResourceTableResolver::findName(ResourceId resId) {
 /**
  * This is called when we need to lookup a resource name in the AssetManager.
  * Since the values in the AssetManager are not parsed like in a ResourceTable,
- * we must create Attribute objects here if we find them.
+ * we must create Attribute objects here if we find them. Returns an entry with
+ * an invalid ID if no library defines the resource.
  */
 const ResourceTableResolver::CacheEntry* ResourceTableResolver::buildCacheEntry(
         const ResourceName& name) {
@@ -152,7 +170,9 @@ const ResourceTableResolver::CacheEntry* ResourceTableResolver::buildCacheEntry(
         const android::ResTable::bag_entry* bagBegin;
         ssize_t bags = table.lockBag(resId.id, &bagBegin);
         if (bags < 1) {
-            table.unlockBag(bagBegin);
+            if (bags == 0) {
+                table.unlockBag(bagBegin);
+            }
             return &entry;
         }
 
@@ -196,7 +216,10 @@ const ResourceTableResolver::CacheEntry* ResourceTableResolver::buildCacheEntry(
         table.unlockBag(bagBegin);
         return &entry;
     }
-    return nullptr;
+
+    // Remember the miss too, so that every reference to a missing symbol
+    // doesn't search all the libraries again.
+    return &mCache[name];
 }
 
 } // namespace aapt
@@ -24,6 +24,7 @@
 #include "ResourceValues.h"
 
 #include <androidfw/AssetManager.h>
+#include <utils/Mutex.h>
 #include <memory>
 #include <vector>
 #include <unordered_set>
@@ -32,6 +33,10 @@ namespace aapt {
 
 /**
  * Encapsulates the search of library sources as well as the local ResourceTable.
+ *
+ * The libraries are never parsed into a ResourceTable: their resources.arsc
+ * is loaded by the AssetManager, and only the symbols that are looked up get
+ * decoded, then cached.
  */
 class ResourceTableResolver : public IResolver {
 public:
@@ -57,10 +62,15 @@ private:
         std::unique_ptr<Attribute> attr;
     };
 
+    /**
+     * Must be called with mCacheLock held. Never returns null, the ID of the
+     * entry is invalid if the resource wasn't found.
+     */
     const CacheEntry* buildCacheEntry(const ResourceName& name);
 
     std::shared_ptr<const ResourceTable> mTable;
     std::vector<std::shared_ptr<const android::AssetManager>> mSources;
+    android::Mutex mCacheLock;
     std::map<ResourceName, CacheEntry> mCache;
     std::unordered_set<std::u16string> mIncludedPackages;
 };
@@ -225,4 +225,41 @@ TEST(ResourceTableTest, OverrideWeakResourceValue) {
     EXPECT_FALSE(entry->values.front().value->isWeak());
 }
 
+TEST(ResourceTableTest, MergeReleasesOtherTable) {
+    const std::u16string kAndroid = u"android";
+    const size_t kStringCount = 10000;
+
+    ResourceTable table;
+    table.setPackage(kAndroid);
+
+    ResourceTable other;
+    other.setPackage(kAndroid);
+    for (size_t i = 0; i < kStringCount; i++) {
+        const std::u16string name = u"string" + util::utf8ToUtf16(std::to_string(i));
+        ASSERT_TRUE(other.addResource(ResourceName{ kAndroid, ResourceType::kString, name }, {},
+                                      SourceLine{ "test/path/strings.xml", i },
+                                      util::make_unique<String>(
+                                              other.getValueStringPool().makeRef(name))));
+    }
+    ASSERT_EQ(kStringCount, other.getValueStringPool().size());
+
+    ASSERT_TRUE(table.merge(std::move(other)));
+
+    // The values were copied into our string pool, nothing of other is held anymore.
+    EXPECT_EQ(std::end(other), std::begin(other));
+    EXPECT_EQ(0u, other.getValueStringPool().size());
+    EXPECT_EQ(kStringCount, table.getValueStringPool().size());
+    EXPECT_EQ(kAndroid, other.getPackage());
+
+    const ResourceTableType* type;
+    const ResourceEntry* entry;
+    std::tie(type, entry) = table.findResource(
+            ResourceNameRef{ kAndroid, ResourceType::kString, u"string1234" });
+    ASSERT_NE(nullptr, entry);
+    ASSERT_EQ(1u, entry->values.size());
+    const String* str = dynamic_cast<const String*>(entry->values.front().value.get());
+    ASSERT_NE(nullptr, str);
+    EXPECT_EQ(std::u16string(u"string1234"), *str->value);
+}
+
 } // namespace aapt
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -25,6 +26,9 @@ namespace aapt {
 
 constexpr char kXmlNamespaceSep = 1;
 
+// The number of bytes read from the input at a time.
+constexpr int kBufferSize = 16384;
+
 SourceXmlPullParser::SourceXmlPullParser(std::istream& in) : mIn(in), mEmpty(), mDepth(0) {
     mParser = XML_ParserCreateNS(nullptr, kXmlNamespaceSep);
     XML_SetUserData(mParser, this);
@@ -47,7 +51,15 @@ SourceXmlPullParser::Event SourceXmlPullParser::next() {
 
     mEventQueue.pop();
     while (mEventQueue.empty()) {
-        mIn.read(mBuffer, sizeof(mBuffer) / sizeof(*mBuffer));
+        // Read straight into expat's buffer rather than copying the input into it.
+        char* buffer = reinterpret_cast<char*>(XML_GetBuffer(mParser, kBufferSize));
+        if (!buffer) {
+            mLastError = XML_ErrorString(XML_GetErrorCode(mParser));
+            mEventQueue.push(EventData{ Event::kBadDocument });
+            continue;
+        }
+
+        mIn.read(buffer, kBufferSize);
 
         const bool done = mIn.eof();
         if (mIn.bad() && !done) {
@@ -56,7 +68,7 @@ SourceXmlPullParser::Event SourceXmlPullParser::next() {
             continue;
         }
 
-        if (XML_Parse(mParser, mBuffer, mIn.gcount(), done) == XML_STATUS_ERROR) {
+        if (XML_ParseBuffer(mParser, mIn.gcount(), done) == XML_STATUS_ERROR) {
             mLastError = XML_ErrorString(XML_GetErrorCode(mParser));
             mEventQueue.push(EventData{ Event::kBadDocument });
             continue;
@@ -178,22 +190,30 @@ size_t SourceXmlPullParser::getAttributeCount() const {
     return mEventQueue.front().attributes.size();
 }
 
-/**
- * Extracts the namespace and name of an expanded element or attribute name.
- */
-static void splitName(const char* name, std::u16string& outNs, std::u16string& outName) {
+void SourceXmlPullParser::splitName(const char* name, std::u16string* outNs,
+                                    std::u16string* outName) {
     const char* p = name;
     while (*p != 0 && *p != kXmlNamespaceSep) {
         p++;
     }
 
     if (*p == 0) {
-        outNs = std::u16string();
-        outName = util::utf8ToUtf16(name);
-    } else {
-        outNs = util::utf8ToUtf16(StringPiece(name, (p - name)));
-        outName = util::utf8ToUtf16(p + 1);
+        outNs->clear();
+        *outName = util::utf8ToUtf16(name);
+        return;
+    }
+
+    const StringPiece ns(name, p - name);
+    auto iter = std::find_if(mNamespaceNames.begin(), mNamespaceNames.end(),
+                             [&ns](const std::pair<std::string, std::u16string>& entry) -> bool {
+                                 return ns == entry.first;
+                             });
+    if (iter == mNamespaceNames.end()) {
+        mNamespaceNames.emplace_back(ns.toString(), util::utf8ToUtf16(ns));
+        iter = mNamespaceNames.end() - 1;
     }
+    *outNs = iter->second;
+    *outName = util::utf8ToUtf16(p + 1);
 }
 
 void XMLCALL SourceXmlPullParser::startNamespaceHandler(void* userData, const char* prefix,
@@ -217,11 +237,17 @@ void XMLCALL SourceXmlPullParser::startElementHandler(void* userData, const char
     EventData data = {
             Event::kStartElement, XML_GetCurrentLineNumber(parser->mParser), parser->mDepth++
     };
-    splitName(name, data.data1, data.data2);
+    parser->splitName(name, &data.data1, &data.data2);
+
+    size_t attrCount = 0;
+    while (attrs[attrCount * 2]) {
+        attrCount++;
+    }
+    data.attributes.reserve(attrCount);
 
     while (*attrs) {
         Attribute attribute;
-        splitName(*attrs++, attribute.namespaceUri, attribute.name);
+        parser->splitName(*attrs++, &attribute.namespaceUri, &attribute.name);
         attribute.value = util::utf8ToUtf16(*attrs++);
 
         // Insert in sorted order.
@@ -250,7 +276,7 @@ void XMLCALL SourceXmlPullParser::endElementHandler(void* userData, const char*
     EventData data = {
             Event::kEndElement, XML_GetCurrentLineNumber(parser->mParser), --(parser->mDepth)
     };
-    splitName(name, data.data1, data.data2);
+    parser->splitName(name, &data.data1, &data.data2);
 
     // Move the data into the queue (no copy).
     parser->mEventQueue.push(std::move(data));
@@ -65,6 +65,12 @@ private:
     static void XMLCALL endNamespaceHandler(void* userData, const char* prefix);
     static void XMLCALL commentDataHandler(void* userData, const char* comment);
 
+    /**
+     * Extracts the namespace and name of an expanded element or attribute name.
+     * Namespace URIs repeat on most names, so their conversion is cached.
+     */
+    void splitName(const char* name, std::u16string* outNs, std::u16string* outName);
+
     struct EventData {
         Event event;
         size_t lineNumber;
@@ -77,13 +83,15 @@ private:
 
     std::istream& mIn;
     XML_Parser mParser;
-    char mBuffer[16384];
     std::queue<EventData> mEventQueue;
     std::string mLastError;
     const std::u16string mEmpty;
     size_t mDepth;
     std::stack<std::u16string> mNamespaceUris;
     std::vector<std::pair<std::u16string, std::u16string>> mPackageAliases;
+
+    // The UTF-8 and converted forms of the namespace URIs seen in names.
+    std::vector<std::pair<std::string, std::u16string>> mNamespaceNames;
 };
 
 } // namespace aapt
@@ -124,6 +124,82 @@ const StringPool::Context& StringPool::StyleRef::getContext() const {
     return mEntry->str.getContext();
 }
 
+static size_t hashString(const StringPiece16& str) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (char16_t c : str) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+StringPool::Entry* StringPool::findIndexed(const StringPiece16& str, size_t hash) const {
+    if (mIndex.empty()) {
+        return nullptr;
+    }
+
+    const size_t mask = mIndex.size() - 1;
+    for (size_t i = hash & mask; mIndex[i].entry != nullptr; i = (i + 1) & mask) {
+        if (mIndex[i].hash == hash && str == StringPiece16(mIndex[i].entry->value)) {
+            return mIndex[i].entry;
+        }
+    }
+    return nullptr;
+}
+
+void StringPool::addToIndex(Entry* entry, size_t hash) {
+    if (findIndexed(entry->value, hash) != nullptr) {
+        return;
+    }
+
+    reserveIndex(mIndexedCount + 1);
+    const size_t mask = mIndex.size() - 1;
+    size_t i = hash & mask;
+    while (mIndex[i].entry != nullptr) {
+        i = (i + 1) & mask;
+    }
+    mIndex[i] = IndexSlot{ hash, entry };
+    mIndexedCount++;
+}
+
+/**
+ * Grows the index so that it can hold count strings, keeping it at most
+ * 3/4 full.
+ */
+void StringPool::reserveIndex(size_t count) {
+    size_t capacity = std::max<size_t>(mIndex.size(), 16);
+    while (count * 4 > capacity * 3) {
+        capacity *= 2;
+    }
+    if (capacity == mIndex.size()) {
+        return;
+    }
+
+    std::vector<IndexSlot> oldIndex;
+    oldIndex.swap(mIndex);
+    mIndex.assign(capacity, IndexSlot{ 0, nullptr });
+
+    const size_t mask = capacity - 1;
+    for (const IndexSlot& slot : oldIndex) {
+        if (slot.entry != nullptr) {
+            size_t i = slot.hash & mask;
+            while (mIndex[i].entry != nullptr) {
+                i = (i + 1) & mask;
+            }
+            mIndex[i] = slot;
+        }
+    }
+}
+
+void StringPool::rebuildIndex() {
+    mIndex.clear();
+    mIndexedCount = 0;
+    reserveIndex(mStrings.size());
+    for (const std::unique_ptr<Entry>& entry : mStrings) {
+        addToIndex(entry.get(), hashString(entry->value));
+    }
+}
+
 StringPool::Ref StringPool::makeRef(const StringPiece16& str) {
     return makeRefImpl(str, Context{}, true);
 }
@@ -134,10 +210,11 @@ StringPool::Ref StringPool::makeRef(const StringPiece16& str, const Context& con
 
 StringPool::Ref StringPool::makeRefImpl(const StringPiece16& str, const Context& context,
         bool unique) {
+    const size_t hash = hashString(str);
     if (unique) {
-        auto iter = mIndexedStrings.find(str);
-        if (iter != std::end(mIndexedStrings)) {
-            return Ref(iter->second);
+        Entry* entry = findIndexed(str, hash);
+        if (entry != nullptr) {
+            return Ref(entry);
         }
     }
 
@@ -147,7 +224,7 @@ StringPool::Ref StringPool::makeRefImpl(const StringPiece16& str, const Context&
     entry->index = mStrings.size();
     entry->ref = 0;
     mStrings.emplace_back(entry);
-    mIndexedStrings.insert(std::make_pair(StringPiece16(entry->value), entry));
+    addToIndex(entry, hash);
     return Ref(entry);
 }
 
@@ -162,7 +239,7 @@ StringPool::StyleRef StringPool::makeRef(const StyleString& str, const Context&
     entry->index = mStrings.size();
     entry->ref = 0;
     mStrings.emplace_back(entry);
-    mIndexedStrings.insert(std::make_pair(StringPiece16(entry->value), entry));
+    addToIndex(entry, hashString(entry->value));
 
     StyleEntry* styleEntry = new StyleEntry();
     styleEntry->str = Ref(entry);
@@ -182,7 +259,7 @@ StringPool::StyleRef StringPool::makeRef(const StyleRef& ref) {
     entry->index = mStrings.size();
     entry->ref = 0;
     mStrings.emplace_back(entry);
-    mIndexedStrings.insert(std::make_pair(StringPiece16(entry->value), entry));
+    addToIndex(entry, hashString(entry->value));
 
     StyleEntry* styleEntry = new StyleEntry();
     styleEntry->str = Ref(entry);
@@ -195,36 +272,40 @@ StringPool::StyleRef StringPool::makeRef(const StyleRef& ref) {
 }
 
 void StringPool::merge(StringPool&& pool) {
-    mIndexedStrings.insert(pool.mIndexedStrings.begin(), pool.mIndexedStrings.end());
-    pool.mIndexedStrings.clear();
+    // Prune pool before merging it, so a later prune() of this pool only
+    // drops our own dead strings and the strings merged in are live.
+    pool.prune();
+
+    // The entries of pool that aren't indexed have the value of one that is,
+    // they can't be the first with their value here either.
+    reserveIndex(mIndexedCount + pool.mIndexedCount);
+    for (const IndexSlot& slot : pool.mIndex) {
+        if (slot.entry != nullptr) {
+            addToIndex(slot.entry, slot.hash);
+        }
+    }
+    pool.mIndex.clear();
+    pool.mIndexedCount = 0;
+
+    // Assign the indices of the new strings, ours don't move.
+    size_t index = mStrings.size();
+    for (const std::unique_ptr<Entry>& entry : pool.mStrings) {
+        entry->index = index++;
+    }
+
     std::move(pool.mStrings.begin(), pool.mStrings.end(), std::back_inserter(mStrings));
     pool.mStrings.clear();
     std::move(pool.mStyles.begin(), pool.mStyles.end(), std::back_inserter(mStyles));
     pool.mStyles.clear();
-
-    // Assign the indices.
-    const size_t len = mStrings.size();
-    for (size_t index = 0; index < len; index++) {
-        mStrings[index]->index = index;
-    }
 }
 
 void StringPool::hintWillAdd(size_t stringCount, size_t styleCount) {
     mStrings.reserve(mStrings.size() + stringCount);
     mStyles.reserve(mStyles.size() + styleCount);
+    reserveIndex(mIndexedCount + stringCount);
 }
 
 void StringPool::prune() {
-    const auto iterEnd = std::end(mIndexedStrings);
-    auto indexIter = std::begin(mIndexedStrings);
-    while (indexIter != iterEnd) {
-        if (indexIter->second->ref <= 0) {
-            mIndexedStrings.erase(indexIter++);
-        } else {
-            ++indexIter;
-        }
-    }
-
     auto endIter2 = std::remove_if(std::begin(mStrings), std::end(mStrings),
             [](const std::unique_ptr<Entry>& entry) -> bool {
                 return entry->ref <= 0;
@@ -241,6 +322,10 @@ void StringPool::prune() {
     // a deleted string from the StyleEntry.
     mStrings.erase(endIter2, std::end(mStrings));
     mStyles.erase(endIter3, std::end(mStyles));
+
+    // An open addressing table can't simply drop its slots, and the strings
+    // left may now be the first with their value.
+    rebuildIndex();
 }
 
 void StringPool::sort(const std::function<bool(const Entry&, const Entry&)>& cmp) {
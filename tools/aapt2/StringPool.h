@@ -164,8 +164,8 @@ public:
     StyleRef makeRef(const StyleRef& ref);
 
     /**
-     * Moves pool into this one without coalescing strings. When this
-     * function returns, pool will be empty.
+     * Moves the referenced strings of pool into this one without coalescing
+     * them. When this function returns, pool will be empty.
      */
     void merge(StringPool&& pool);
 
@@ -197,9 +197,25 @@ private:
 
     Ref makeRefImpl(const StringPiece16& str, const Context& context, bool unique);
 
+    /**
+     * A slot of the index of the strings, an open addressing hash table
+     * probed linearly. Only the first of several entries with the same
+     * value is indexed, it's the one makeRef() dedupes to.
+     */
+    struct IndexSlot {
+        size_t hash;
+        Entry* entry;
+    };
+
+    Entry* findIndexed(const StringPiece16& str, size_t hash) const;
+    void addToIndex(Entry* entry, size_t hash);
+    void reserveIndex(size_t count);
+    void rebuildIndex();
+
     std::vector<std::unique_ptr<Entry>> mStrings;
     std::vector<std::unique_ptr<StyleEntry>> mStyles;
-    std::multimap<StringPiece16, Entry*> mIndexedStrings;
+    std::vector<IndexSlot> mIndex;
+    size_t mIndexedCount = 0;
 };
 
 //
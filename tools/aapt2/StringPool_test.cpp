@@ -19,6 +19,7 @@
 
 #include <gtest/gtest.h>
 #include <string>
+#include <vector>
 
 using namespace android;
 
@@ -129,6 +130,69 @@ TEST(StringPoolTest, SortAndStillDedupe) {
     EXPECT_EQ(ref6.getIndex(), ref3.getIndex());
 }
 
+TEST(StringPoolTest, MergeAndStillDedupe) {
+    StringPool pool;
+    StringPool::Ref ref = pool.makeRef(u"wut");
+
+    StringPool other;
+    StringPool::Ref ref2 = other.makeRef(u"hey");
+    StringPool::Ref ref3 = other.makeRef(u"wut");
+
+    pool.merge(std::move(other));
+    EXPECT_EQ(0u, other.size());
+    EXPECT_EQ(3u, pool.size());
+    EXPECT_EQ(1u, ref2.getIndex());
+    EXPECT_EQ(2u, ref3.getIndex());
+
+    EXPECT_EQ(ref.getIndex(), pool.makeRef(u"wut").getIndex());
+    EXPECT_EQ(ref2.getIndex(), pool.makeRef(u"hey").getIndex());
+    EXPECT_EQ(3u, pool.size());
+}
+
+TEST(StringPoolTest, MergePrunesOtherFirst) {
+    StringPool pool;
+    StringPool::Ref ref = pool.makeRef(u"wut");
+
+    StringPool other;
+    {
+        StringPool::Ref ref2 = other.makeRef(u"dead");
+    }
+    StringPool::Ref ref3 = other.makeRef(u"hey");
+
+    pool.merge(std::move(other));
+    ASSERT_EQ(2u, pool.size());
+    EXPECT_EQ(1u, ref3.getIndex());
+
+    pool.prune();
+    ASSERT_EQ(2u, pool.size());
+    EXPECT_EQ(ref3.getIndex(), pool.makeRef(u"hey").getIndex());
+    EXPECT_EQ(2u, pool.size());
+}
+
+TEST(StringPoolTest, PruneAndStillDedupe) {
+    StringPool pool;
+    {
+        StringPool::Ref ref = pool.makeRef(u"wut");
+    }
+
+    // Enough strings to grow the index a few times.
+    std::vector<StringPool::Ref> refs;
+    for (int i = 0; i < 100; i++) {
+        refs.push_back(pool.makeRef(util::utf8ToUtf16(std::to_string(i))));
+    }
+
+    pool.prune();
+    ASSERT_EQ(100u, pool.size());
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(refs[i].getIndex(),
+                  pool.makeRef(util::utf8ToUtf16(std::to_string(i))).getIndex());
+    }
+    EXPECT_EQ(100u, pool.size());
+
+    pool.makeRef(u"wut");
+    EXPECT_EQ(101u, pool.size());
+}
+
 TEST(StringPoolTest, AddStyles) {
     StringPool pool;
 
@@ -423,6 +423,10 @@ bool TableFlattener::flatten(BigBuffer* out, const ResourceTable& table) {
             }
 
             for (const auto& configValue : entry->values) {
+                if (mOptions.configFilter && !mOptions.configFilter(configValue.config)) {
+                    continue;
+                }
+
                 data[configValue.config].push_back(FlatEntry{
                         entry,
                         configValue.value.get(),
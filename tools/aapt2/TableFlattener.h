@@ -18,8 +18,11 @@
 #define AAPT_TABLE_FLATTENER_H
 
 #include "BigBuffer.h"
+#include "ConfigDescription.h"
 #include "ResourceTable.h"
 
+#include <functional>
+
 namespace aapt {
 
 using SymbolEntryVector = std::vector<std::pair<ResourceNameRef, uint32_t>>;
@@ -44,6 +47,14 @@ struct TableFlattener {
          * on device.
          */
         bool useExtendedChunks = true;
+
+        /**
+         * When set, only the values for the configurations it accepts
+         * are flattened. Every entry is still written with its ID, so
+         * tables flattened with different filters stay aligned, as needed
+         * by the base and split APKs of an app.
+         */
+        std::function<bool(const ConfigDescription&)> configFilter;
     };
 
     TableFlattener(Options options);
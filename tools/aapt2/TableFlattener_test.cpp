@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ConfigDescription.h"
+#include "ResourceTable.h"
+#include "ResourceValues.h"
+#include "TableFlattener.h"
+#include "Util.h"
+
+#include <androidfw/ResourceTypes.h>
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace android;
+
+namespace aapt {
+
+class TableFlattenerTest : public ::testing::Test {
+public:
+    virtual void SetUp() override {
+        ASSERT_TRUE(ConfigDescription::parse("fr", &mFrConfig));
+
+        mTable.setPackage(u"android");
+        mTable.setPackageId(0x01);
+        addString(u"hello", 0, {}, u"hello");
+        addString(u"hello", 0, mFrConfig, u"bonjour");
+        addString(u"only_fr", 1, mFrConfig, u"seulement");
+    }
+
+    void addString(const StringPiece16& name, size_t entryId, const ConfigDescription& config,
+                   const StringPiece16& value) {
+        ASSERT_TRUE(mTable.addResource(ResourceName{ u"android", ResourceType::kString, name },
+                                       ResourceId{ 0x01, 0x02, entryId }, config,
+                                       SourceLine{ "test.xml", 1 },
+                                       util::make_unique<String>(
+                                               mTable.getValueStringPool().makeRef(value))));
+    }
+
+    ::testing::AssertionResult flatten(const TableFlattener::Options& options,
+                                       std::unique_ptr<uint8_t[]>* outData,
+                                       ResTable* outTable) {
+        BigBuffer buffer(1024);
+        TableFlattener flattener(options);
+        if (!flattener.flatten(&buffer, mTable)) {
+            return ::testing::AssertionFailure() << "failed to flatten table";
+        }
+
+        *outData = util::copy(buffer);
+        if (outTable->add(outData->get(), buffer.size(), -1, false) != NO_ERROR) {
+            return ::testing::AssertionFailure() << "failed to load flattened table";
+        }
+        return ::testing::AssertionSuccess();
+    }
+
+    static bool hasConfig(const ResTable& table, const ConfigDescription& config) {
+        Vector<ResTable_config> configs;
+        table.getConfigurations(&configs);
+        for (size_t i = 0; i < configs.size(); i++) {
+            if (ConfigDescription(configs[i]) == config) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ConfigDescription mFrConfig;
+    ResourceTable mTable;
+};
+
+TEST_F(TableFlattenerTest, FilterConfigsKeepsEntryIds) {
+    TableFlattener::Options baseOptions;
+    baseOptions.useExtendedChunks = false;
+    baseOptions.configFilter = [this](const ConfigDescription& config) -> bool {
+        return config != mFrConfig;
+    };
+
+    TableFlattener::Options splitOptions;
+    splitOptions.useExtendedChunks = false;
+    splitOptions.configFilter = [this](const ConfigDescription& config) -> bool {
+        return config == mFrConfig;
+    };
+
+    std::unique_ptr<uint8_t[]> baseData;
+    ResTable baseTable;
+    ASSERT_TRUE(flatten(baseOptions, &baseData, &baseTable));
+
+    std::unique_ptr<uint8_t[]> splitData;
+    ResTable splitTable;
+    ASSERT_TRUE(flatten(splitOptions, &splitData, &splitTable));
+
+    EXPECT_TRUE(hasConfig(baseTable, ConfigDescription{}));
+    EXPECT_FALSE(hasConfig(baseTable, mFrConfig));
+    EXPECT_FALSE(hasConfig(splitTable, ConfigDescription{}));
+    EXPECT_TRUE(hasConfig(splitTable, mFrConfig));
+
+    // The IDs are the same in both tables, even when the base has no value.
+    EXPECT_EQ(0x01020000u, baseTable.identifierForName(u"hello", 5, u"string", 6,
+                                                       u"android", 7));
+    EXPECT_EQ(0x01020000u, splitTable.identifierForName(u"hello", 5, u"string", 6,
+                                                        u"android", 7));
+    EXPECT_EQ(0x01020001u, splitTable.identifierForName(u"only_fr", 7, u"string", 6,
+                                                        u"android", 7));
+
+    Res_value value;
+    EXPECT_LT(baseTable.getResource(0x01020001u, &value), 0);
+    EXPECT_GE(splitTable.getResource(0x01020001u, &value), 0);
+}
+
+} // namespace aapt
@@ -347,8 +347,8 @@ bail:
 
 status_t ZipFile::add(const BigBuffer& buffer, const char* storageName, int compressionMethod,
                       ZipEntry** ppEntry) {
-    std::unique_ptr<uint8_t[]> data = util::copy(buffer);
-    return add(data.get(), buffer.size(), storageName, compressionMethod, ppEntry);
+    return addCommon(NULL, NULL, buffer.size(), &buffer, storageName,
+                     ZipEntry::kCompressStored, compressionMethod, ppEntry);
 }
 
 
@@ -365,8 +365,8 @@ status_t ZipFile::add(const BigBuffer& buffer, const char* storageName, int comp
  * safely written.  Not really a concern for us.
  */
 status_t ZipFile::addCommon(const char* fileName, const void* data, size_t size,
-    const char* storageName, int sourceType, int compressionMethod,
-    ZipEntry** ppEntry)
+    const BigBuffer* buffer, const char* storageName, int sourceType,
+    int compressionMethod, ZipEntry** ppEntry)
 {
     ZipEntry* pEntry = NULL;
     status_t result = NO_ERROR;
@@ -389,7 +389,7 @@ status_t ZipFile::addCommon(const char* fileName, const void* data, size_t size,
     if (getEntryByName(storageName) != NULL)
         return ALREADY_EXISTS;
 
-    if (!data) {
+    if (!data && !buffer) {
         inputFp = fopen(fileName, FILE_OPEN_RO);
         if (inputFp == NULL)
             return errnoToStatus(errno);
@@ -414,6 +414,13 @@ status_t ZipFile::addCommon(const char* fileName, const void* data, size_t size,
      * practice some utilities demand it.
      */
     lfhPosn = ftell(mZipFp);
+    if (sourceType == ZipEntry::kCompressStored &&
+        compressionMethod == ZipEntry::kCompressStored)
+    {
+        result = alignEntry(pEntry, lfhPosn);
+        if (result != NO_ERROR)
+            goto bail;
+    }
     pEntry->mLFH.write(mZipFp);
     startPosn = ftell(mZipFp);
 
@@ -423,7 +430,11 @@ status_t ZipFile::addCommon(const char* fileName, const void* data, size_t size,
     if (sourceType == ZipEntry::kCompressStored) {
         if (compressionMethod == ZipEntry::kCompressDeflated) {
             bool failed = false;
-            result = compressFpToFp(mZipFp, inputFp, data, size, &crc);
+            if (buffer) {
+                result = compressBufferToFp(mZipFp, *buffer, &crc);
+            } else {
+                result = compressFpToFp(mZipFp, inputFp, data, size, &crc);
+            }
             if (result != NO_ERROR) {
                 ALOGD("compression failed, storing\n");
                 failed = true;
@@ -445,7 +456,14 @@ status_t ZipFile::addCommon(const char* fileName, const void* data, size_t size,
             if (failed) {
                 compressionMethod = ZipEntry::kCompressStored;
                 if (inputFp) rewind(inputFp);
-                fseek(mZipFp, startPosn, SEEK_SET);
+
+                /* the stored data may need to start further along */
+                fseek(mZipFp, lfhPosn, SEEK_SET);
+                result = alignEntry(pEntry, lfhPosn);
+                if (result != NO_ERROR)
+                    goto bail;
+                pEntry->mLFH.write(mZipFp);
+                startPosn = ftell(mZipFp);
                 /* fall through to kCompressStored case */
             }
         }
@@ -453,6 +471,8 @@ status_t ZipFile::addCommon(const char* fileName, const void* data, size_t size,
         if (compressionMethod == ZipEntry::kCompressStored) {
             if (inputFp) {
                 result = copyFpToFp(mZipFp, inputFp, &crc);
+            } else if (buffer) {
+                result = copyBufferToFp(mZipFp, *buffer, &crc);
             } else {
                 result = copyDataToFp(mZipFp, data, size, &crc);
             }
@@ -538,6 +558,185 @@ bail:
     return result;
 }
 
+/*
+ * Compress the blocks of a buffer ahead of adding it to an archive.
+ *
+ * The blocks are deflated in one pass into a buffer large enough for the
+ * worst case.
+ */
+/*static*/ status_t ZipFile::compress(const BigBuffer& buffer,
+    int compressionMethod, CompressedData* pData)
+{
+    assert(compressionMethod == ZipEntry::kCompressDeflated ||
+           compressionMethod == ZipEntry::kCompressStored);
+    assert(pData->mData == NULL);
+
+    const size_t size = buffer.size();
+    unsigned long crc = crc32(0L, Z_NULL, 0);
+    for (const auto& block : buffer) {
+        crc = crc32(crc, block.buffer.get(), block.size);
+    }
+    pData->mUncompressedLen = size;
+    pData->mCRC32 = crc;
+
+    if (compressionMethod == ZipEntry::kCompressDeflated) {
+        z_stream zstream;
+        int zerr;
+
+        memset(&zstream, 0, sizeof(zstream));
+        zstream.zalloc = Z_NULL;
+        zstream.zfree = Z_NULL;
+        zstream.opaque = Z_NULL;
+        zstream.data_type = Z_UNKNOWN;
+
+        zerr = deflateInit2(&zstream, Z_BEST_COMPRESSION,
+            Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        if (zerr != Z_OK) {
+            ALOGD("Call to deflateInit2 failed (zerr=%d)\n", zerr);
+            return UNKNOWN_ERROR;
+        }
+
+        const size_t outSize = deflateBound(&zstream, size);
+        std::unique_ptr<unsigned char[]> outBuf(new unsigned char[outSize]);
+        zstream.next_out = outBuf.get();
+        zstream.avail_out = outSize;
+
+        BigBuffer::const_iterator block = buffer.begin();
+        do {
+            if (zstream.avail_in == 0 && block != buffer.end()) {
+                zstream.next_in = block->buffer.get();
+                zstream.avail_in = block->size;
+                ++block;
+            }
+            zerr = deflate(&zstream,
+                block == buffer.end() && zstream.avail_in == 0 ? Z_FINISH : Z_NO_FLUSH);
+        } while (zerr == Z_OK);
+        deflateEnd(&zstream);
+
+        /*
+         * Make sure it has compressed "enough", with the same criteria as
+         * addCommon().
+         */
+        const size_t dst = zstream.total_out;
+        if (zerr != Z_STREAM_END) {
+            ALOGD("zlib deflate call failed (zerr=%d), storing\n", zerr);
+        } else if (dst + (dst / 10) > size) {
+            ALOGD("insufficient compression (src=%ld dst=%ld), storing\n",
+                (long) size, (long) dst);
+        } else {
+            pData->mData = std::move(outBuf);
+            pData->mSize = dst;
+            pData->mCompressionMethod = ZipEntry::kCompressDeflated;
+            return NO_ERROR;
+        }
+    }
+
+    std::unique_ptr<unsigned char[]> data(new unsigned char[size > 0 ? size : 1]);
+    unsigned char* p = data.get();
+    for (const auto& block : buffer) {
+        memcpy(p, block.buffer.get(), block.size);
+        p += block.size;
+    }
+    pData->mData = std::move(data);
+    pData->mSize = size;
+    pData->mCompressionMethod = ZipEntry::kCompressStored;
+    return NO_ERROR;
+}
+
+/*
+ * Add an entry compressed with compress().  This is addCommon(), with the
+ * data already in its final form.
+ */
+status_t ZipFile::addCompressed(const CompressedData& data,
+    const char* storageName, ZipEntry** ppEntry)
+{
+    ZipEntry* pEntry = NULL;
+    status_t result = NO_ERROR;
+    long lfhPosn, startPosn, endPosn;
+
+    if (mReadOnly)
+        return INVALID_OPERATION;
+
+    /* make sure we're in a reasonable state */
+    assert(mZipFp != NULL);
+    assert(mEntries.size() == mEOCD.mTotalNumEntries);
+
+    /* make sure it doesn't already exist */
+    if (getEntryByName(storageName) != NULL)
+        return ALREADY_EXISTS;
+
+    if (fseek(mZipFp, mEOCD.mCentralDirOffset, SEEK_SET) != 0)
+        return UNKNOWN_ERROR;
+
+    pEntry = new ZipEntry;
+    pEntry->initNew(storageName, NULL);
+
+    lfhPosn = ftell(mZipFp);
+    if (data.mCompressionMethod == ZipEntry::kCompressStored) {
+        result = alignEntry(pEntry, lfhPosn);
+        if (result != NO_ERROR)
+            goto bail;
+    }
+
+    mNeedCDRewrite = true;
+    pEntry->mLFH.write(mZipFp);
+    startPosn = ftell(mZipFp);
+
+    if (data.mSize > 0 &&
+        fwrite(data.mData.get(), 1, data.mSize, mZipFp) != data.mSize)
+    {
+        // don't need to truncate; happens in CDE rewrite
+        ALOGD("fwrite %d bytes failed\n", (int) data.mSize);
+        result = UNKNOWN_ERROR;
+        goto bail;
+    }
+    endPosn = ftell(mZipFp);
+
+    pEntry->setDataInfo(data.mUncompressedLen, endPosn - startPosn,
+        data.mCRC32, data.mCompressionMethod);
+    pEntry->setModWhen(getModTime(fileno(mZipFp)));
+    pEntry->setLFHOffset(lfhPosn);
+    mEOCD.mNumEntries++;
+    mEOCD.mTotalNumEntries++;
+    mEOCD.mCentralDirSize = 0;      // mark invalid; set by flush()
+    mEOCD.mCentralDirOffset = endPosn;
+
+    /*
+     * Go back and write the LFH.
+     */
+    if (fseek(mZipFp, lfhPosn, SEEK_SET) != 0) {
+        result = UNKNOWN_ERROR;
+        goto bail;
+    }
+    pEntry->mLFH.write(mZipFp);
+
+    mEntries.push_back(pEntry);
+    if (ppEntry != NULL)
+        *ppEntry = pEntry;
+    pEntry = NULL;
+
+bail:
+    delete pEntry;
+    return result;
+}
+
+/*
+ * Pad the "extra" field of an entry so that its data, following its local
+ * header at "lfhPosn", starts at a multiple of mAlignment.
+ */
+status_t ZipFile::alignEntry(ZipEntry* pEntry, long lfhPosn)
+{
+    if (mAlignment <= 0)
+        return NO_ERROR;
+
+    const long dataPosn = lfhPosn + ZipEntry::LocalFileHeader::kLFHLen +
+        pEntry->mLFH.mFileNameLength + pEntry->mLFH.mExtraFieldLength;
+    const int padding = (mAlignment - (dataPosn % mAlignment)) % mAlignment;
+    if (padding == 0)
+        return NO_ERROR;
+    return pEntry->addPadding(padding);
+}
+
 /*
  * Add an entry by copying it from another zip file.  If "padding" is
  * nonzero, the specified number of bytes will be added to the "extra"
@@ -580,6 +779,13 @@ status_t ZipFile::add(const ZipFile* pSourceZip, const ZipEntry* pSourceEntry,
             goto bail;
     }
 
+    lfhPosn = ftell(mZipFp);
+    if (pEntry->getCompressionMethod() == ZipEntry::kCompressStored) {
+        result = alignEntry(pEntry, lfhPosn);
+        if (result != NO_ERROR)
+            goto bail;
+    }
+
     /*
      * From here on out, failures are more interesting.
      */
@@ -589,7 +795,6 @@ status_t ZipFile::add(const ZipFile* pSourceZip, const ZipEntry* pSourceEntry,
      * Write the LFH.  Since we're not recompressing the data, we already
      * have all of the fields filled out.
      */
-    lfhPosn = ftell(mZipFp);
     pEntry->mLFH.write(mZipFp);
 
     /*
@@ -698,6 +903,29 @@ status_t ZipFile::copyDataToFp(FILE* dstFp,
     return NO_ERROR;
 }
 
+/*
+ * Copy all of the blocks of "buffer" to "dst".
+ *
+ * On exit, "dstFp" will be seeked immediately past the data.
+ */
+status_t ZipFile::copyBufferToFp(FILE* dstFp, const BigBuffer& buffer,
+    unsigned long* pCRC32)
+{
+    *pCRC32 = crc32(0L, Z_NULL, 0);
+    for (const BigBuffer::Block& block : buffer) {
+        if (block.size == 0)
+            continue;
+
+        *pCRC32 = crc32(*pCRC32, block.buffer.get(), block.size);
+        if (fwrite(block.buffer.get(), 1, block.size, dstFp) != block.size) {
+            ALOGD("fwrite %d bytes failed\n", (int) block.size);
+            return UNKNOWN_ERROR;
+        }
+    }
+
+    return NO_ERROR;
+}
+
 /*
  * Copy some of the bytes in "src" to "dst".
  *
@@ -876,6 +1104,82 @@ bail:
     return result;
 }
 
+/*
+ * Compress all of the blocks of "buffer" and write them to "dstFp". zlib
+ * reads the blocks where they are, there is no input buffer to copy them to.
+ *
+ * On exit, "dstFp" will be seeked immediately past the compressed data.
+ */
+status_t ZipFile::compressBufferToFp(FILE* dstFp, const BigBuffer& buffer,
+    unsigned long* pCRC32)
+{
+    const size_t kBufSize = 32768;
+    std::unique_ptr<unsigned char[]> outBuf(new unsigned char[kBufSize]);
+    z_stream zstream;
+    int zerr;
+
+    memset(&zstream, 0, sizeof(zstream));
+    zstream.zalloc = Z_NULL;
+    zstream.zfree = Z_NULL;
+    zstream.opaque = Z_NULL;
+    zstream.next_out = outBuf.get();
+    zstream.avail_out = kBufSize;
+    zstream.data_type = Z_UNKNOWN;
+
+    zerr = deflateInit2(&zstream, Z_BEST_COMPRESSION,
+        Z_DEFLATED, -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if (zerr != Z_OK) {
+        if (zerr == Z_VERSION_ERROR) {
+            ALOGE("Installed zlib is not compatible with linked version (%s)\n",
+                ZLIB_VERSION);
+        } else {
+            ALOGD("Call to deflateInit2 failed (zerr=%d)\n", zerr);
+        }
+        return UNKNOWN_ERROR;
+    }
+
+    status_t result = NO_ERROR;
+    unsigned long crc = crc32(0L, Z_NULL, 0);
+    BigBuffer::const_iterator block = buffer.begin();
+    do {
+        /* move on to the next block once zlib consumed this one */
+        while (zstream.avail_in == 0 && block != buffer.end()) {
+            crc = crc32(crc, block->buffer.get(), block->size);
+            zstream.next_in = block->buffer.get();
+            zstream.avail_in = block->size;
+            ++block;
+        }
+
+        const int flush = (zstream.avail_in == 0 && block == buffer.end()) ?
+                Z_FINISH : Z_NO_FLUSH;
+        zerr = deflate(&zstream, flush);
+        if (zerr != Z_OK && zerr != Z_STREAM_END) {
+            ALOGD("zlib deflate call failed (zerr=%d)\n", zerr);
+            result = UNKNOWN_ERROR;
+            break;
+        }
+
+        /* write when we're full or when we're done */
+        const size_t outSize = zstream.next_out - outBuf.get();
+        if (zstream.avail_out == 0 || (zerr == Z_STREAM_END && outSize != 0)) {
+            if (fwrite(outBuf.get(), 1, outSize, dstFp) != outSize) {
+                ALOGD("write %d failed in deflate\n", (int) outSize);
+                result = UNKNOWN_ERROR;
+                break;
+            }
+
+            zstream.next_out = outBuf.get();
+            zstream.avail_out = kBufSize;
+        }
+    } while (zerr == Z_OK);
+
+    deflateEnd(&zstream);
+    if (result == NO_ERROR) {
+        *pCRC32 = crc;
+    }
+    return result;
+}
+
 /*
  * Mark an entry as deleted.
  *
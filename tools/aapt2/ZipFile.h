@@ -24,6 +24,7 @@
 #include "BigBuffer.h"
 #include "ZipEntry.h"
 
+#include <memory>
 #include <stdio.h>
 #include <utils/Errors.h>
 #include <vector>
@@ -47,7 +48,7 @@ using android::status_t;
 class ZipFile {
 public:
     ZipFile(void)
-      : mZipFp(NULL), mReadOnly(false), mNeedCDRewrite(false)
+      : mZipFp(NULL), mReadOnly(false), mNeedCDRewrite(false), mAlignment(0)
       {}
     ~ZipFile(void) {
         if (!mReadOnly)
@@ -88,7 +89,7 @@ public:
     status_t add(const char* fileName, const char* storageName,
         int compressionMethod, ZipEntry** ppEntry)
     {
-        return addCommon(fileName, NULL, 0, storageName,
+        return addCommon(fileName, NULL, 0, NULL, storageName,
                          ZipEntry::kCompressStored,
                          compressionMethod, ppEntry);
     }
@@ -101,7 +102,7 @@ public:
     status_t addGzip(const char* fileName, const char* storageName,
         ZipEntry** ppEntry)
     {
-        return addCommon(fileName, NULL, 0, storageName,
+        return addCommon(fileName, NULL, 0, NULL, storageName,
                          ZipEntry::kCompressDeflated,
                          ZipEntry::kCompressDeflated, ppEntry);
     }
@@ -114,11 +115,17 @@ public:
     status_t add(const void* data, size_t size, const char* storageName,
         int compressionMethod, ZipEntry** ppEntry)
     {
-        return addCommon(NULL, data, size, storageName,
+        return addCommon(NULL, data, size, NULL, storageName,
                          ZipEntry::kCompressStored,
                          compressionMethod, ppEntry);
     }
 
+    /*
+     * Add a file from the blocks of a BigBuffer, written out as they are
+     * without copying them into one contiguous buffer first.
+     *
+     * If "ppEntry" is non-NULL, a pointer to the new entry will be returned.
+     */
     status_t add(const BigBuffer& data, const char* storageName,
         int compressionMethod, ZipEntry** ppEntry);
 
@@ -134,6 +141,54 @@ public:
     status_t add(const ZipFile* pSourceZip, const ZipEntry* pSourceEntry,
                  const char* storageName, int padding, ZipEntry** ppEntry);
 
+    /*
+     * The data of an entry, compressed by compress() before it is
+     * added with addCompressed().
+     */
+    class CompressedData {
+    public:
+        CompressedData(void)
+          : mSize(0), mUncompressedLen(0), mCRC32(0),
+            mCompressionMethod(ZipEntry::kCompressStored)
+          {}
+        CompressedData(const CompressedData&) = delete; // No copying.
+
+    private:
+        friend class ZipFile;
+
+        std::unique_ptr<unsigned char[]> mData;
+        size_t          mSize;
+        long            mUncompressedLen;
+        unsigned long   mCRC32;
+        int             mCompressionMethod;
+    };
+
+    /*
+     * Compress the blocks of "buffer" the way add() would with
+     * "compressionMethod", falling back to storing them if they don't
+     * compress well.
+     *
+     * This doesn't touch any archive, so entries can be compressed on
+     * other threads and then added in order.
+     */
+    static status_t compress(const BigBuffer& buffer, int compressionMethod,
+        CompressedData* pData);
+
+    /*
+     * Add an entry compressed with compress().
+     *
+     * If "ppEntry" is non-NULL, a pointer to the new entry will be returned.
+     */
+    status_t addCompressed(const CompressedData& data, const char* storageName,
+        ZipEntry** ppEntry);
+
+    /*
+     * Start the data of the stored (uncompressed) entries added from now
+     * on at a multiple of "alignment" bytes, padding the "extra" field of
+     * their local header the way zipalign does.  Zero disables it.
+     */
+    void setAlignment(int alignment) { mAlignment = alignment; }
+
     /*
      * Mark an entry as having been removed.  It is not actually deleted
      * from the archive or our internal data structures until flush() is
@@ -230,14 +285,17 @@ private:
 
     /* common handler for all "add" functions */
     status_t addCommon(const char* fileName, const void* data, size_t size,
-        const char* storageName, int sourceType, int compressionMethod,
-        ZipEntry** ppEntry);
+        const BigBuffer* buffer, const char* storageName, int sourceType,
+        int compressionMethod, ZipEntry** ppEntry);
 
     /* copy all of "srcFp" into "dstFp" */
     status_t copyFpToFp(FILE* dstFp, FILE* srcFp, unsigned long* pCRC32);
     /* copy all of "data" into "dstFp" */
     status_t copyDataToFp(FILE* dstFp,
         const void* data, size_t size, unsigned long* pCRC32);
+    /* copy all the blocks of "buffer" into "dstFp" */
+    status_t copyBufferToFp(FILE* dstFp, const BigBuffer& buffer,
+        unsigned long* pCRC32);
     /* copy some of "srcFp" into "dstFp" */
     status_t copyPartialFpToFp(FILE* dstFp, FILE* srcFp, long length,
         unsigned long* pCRC32);
@@ -246,6 +304,15 @@ private:
     /* compress all of "srcFp" into "dstFp", using Deflate */
     status_t compressFpToFp(FILE* dstFp, FILE* srcFp,
         const void* data, size_t size, unsigned long* pCRC32);
+    /* compress all the blocks of "buffer" into "dstFp", using Deflate */
+    status_t compressBufferToFp(FILE* dstFp, const BigBuffer& buffer,
+        unsigned long* pCRC32);
+
+    /*
+     * Pad the "extra" field of "pEntry", whose local header is written
+     * at "lfhPosn", so that its data is aligned to mAlignment.
+     */
+    status_t alignEntry(ZipEntry* pEntry, long lfhPosn);
 
     /* get modification date from a file descriptor */
     time_t getModTime(int fd);
@@ -265,6 +332,9 @@ private:
     /* set this when we trash the central dir */
     bool            mNeedCDRewrite;
 
+    /* alignment of the data of stored entries, 0 for none */
+    int             mAlignment;
+
     /*
      * One ZipEntry per entry in the zip file.  I'm using pointers instead
      * of objects because it's easier than making operator= work for the
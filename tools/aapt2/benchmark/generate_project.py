@@ -0,0 +1,163 @@
+#!/usr/bin/env python
+#
+# Copyright (C) 2015 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Generates a synthetic resource project for benchmarking aapt2.
+
+The project has an AndroidManifest.xml and a res/ directory with:
+  - layouts that reference strings, drawables and each other's IDs,
+  - values files of strings, colors, dimens and styles,
+  - PNGs in every density,
+  - the strings translated into every locale.
+
+The output only depends on the arguments, so runs on different trees
+are comparable.
+"""
+
+from __future__ import print_function
+
+import argparse
+import os
+import random
+import struct
+import zlib
+
+PACKAGE = 'com.android.aapt2.benchmark'
+
+
+def writeFile(path, contents):
+    directory = os.path.dirname(path)
+    if not os.path.isdir(directory):
+        os.makedirs(directory)
+    mode = 'wb' if isinstance(contents, bytes) else 'w'
+    with open(path, mode) as f:
+        f.write(contents)
+
+
+def makePng(width, height, rnd):
+    """Returns an RGBA PNG of random-ish pixels, compressible like real art."""
+    def chunk(tag, data):
+        crc = zlib.crc32(tag + data) & 0xffffffff
+        return struct.pack('>I', len(data)) + tag + data + struct.pack('>I', crc)
+
+    color = [rnd.randint(0, 255) for _ in range(4)]
+    rows = []
+    for y in range(height):
+        row = bytearray([0])
+        for x in range(width):
+            if rnd.random() < 0.1:
+                color = [rnd.randint(0, 255) for _ in range(4)]
+            row.extend(color)
+        rows.append(bytes(row))
+    header = struct.pack('>IIBBBBB', width, height, 8, 6, 0, 0, 0)
+    return (b'\x89PNG\r\n\x1a\n' + chunk(b'IHDR', header) +
+            chunk(b'IDAT', zlib.compress(b''.join(rows))) + chunk(b'IEND', b''))
+
+
+def makeLayout(index, args, rnd):
+    lines = ['<?xml version="1.0" encoding="utf-8"?>',
+             '<LinearLayout xmlns:android="http://schemas.android.com/apk/res/android"',
+             '    android:layout_width="match_parent"',
+             '    android:layout_height="match_parent"',
+             '    android:orientation="vertical">']
+    for view in range(args.views):
+        lines += ['    <TextView',
+                  '        android:id="@+id/layout%d_view%d"' % (index, view),
+                  '        android:layout_width="wrap_content"',
+                  '        android:layout_height="wrap_content"',
+                  '        android:padding="@dimen/dimen%d"' % rnd.randrange(args.values),
+                  '        android:textColor="@color/color%d"' % rnd.randrange(args.values),
+                  '        android:text="@string/string%d" />' % rnd.randrange(args.values)]
+        if args.pngs:
+            lines += ['    <ImageView',
+                      '        android:layout_width="wrap_content"',
+                      '        android:layout_height="wrap_content"',
+                      '        android:src="@drawable/image%d" />' % rnd.randrange(args.pngs)]
+    lines += ['</LinearLayout>', '']
+    return '\n'.join(lines)
+
+
+def makeStrings(locale, args):
+    lines = ['<?xml version="1.0" encoding="utf-8"?>', '<resources>']
+    for i in range(args.values):
+        lines.append('    <string name="string%d">%s string number %d</string>' %
+                     (i, locale or 'default', i))
+    lines += ['</resources>', '']
+    return '\n'.join(lines)
+
+
+def makeValues(args):
+    lines = ['<?xml version="1.0" encoding="utf-8"?>', '<resources>']
+    for i in range(args.values):
+        lines.append('    <color name="color%d">#ff%06x</color>' % (i, (i * 2654435761) & 0xffffff))
+        lines.append('    <dimen name="dimen%d">%ddp</dimen>' % (i, i % 32))
+    for i in range(args.values // 10):
+        lines += ['    <style name="Style%d">' % i,
+                  '        <item name="android:textColor">@color/color%d</item>' % i,
+                  '        <item name="android:padding">@dimen/dimen%d</item>' % i,
+                  '    </style>']
+    lines += ['</resources>', '']
+    return '\n'.join(lines)
+
+
+def generate(args):
+    rnd = random.Random(args.seed)
+    res = os.path.join(args.out, 'res')
+
+    writeFile(os.path.join(args.out, 'AndroidManifest.xml'),
+              '<?xml version="1.0" encoding="utf-8"?>\n'
+              '<manifest xmlns:android="http://schemas.android.com/apk/res/android"\n'
+              '    package="%s">\n'
+              '    <application />\n'
+              '</manifest>\n' % PACKAGE)
+
+    for i in range(args.layouts):
+        writeFile(os.path.join(res, 'layout', 'layout%d.xml' % i), makeLayout(i, args, rnd))
+
+    writeFile(os.path.join(res, 'values', 'values.xml'), makeValues(args))
+    writeFile(os.path.join(res, 'values', 'strings.xml'), makeStrings(None, args))
+    for locale in args.locales:
+        writeFile(os.path.join(res, 'values-%s' % locale, 'strings.xml'),
+                  makeStrings(locale, args))
+
+    for density in args.densities:
+        for i in range(args.pngs):
+            writeFile(os.path.join(res, 'drawable-%s' % density, 'image%d.png' % i),
+                      makePng(args.png_size, args.png_size, rnd))
+
+
+def addArguments(parser):
+    parser.add_argument('--layouts', type=int, default=500, help='number of layouts')
+    parser.add_argument('--views', type=int, default=10, help='number of views per layout')
+    parser.add_argument('--values', type=int, default=2000,
+                        help='number of strings, colors and dimens')
+    parser.add_argument('--pngs', type=int, default=100, help='number of PNGs per density')
+    parser.add_argument('--png-size', type=int, default=48, help='width and height of the PNGs')
+    parser.add_argument('--locales', type=lambda s: [l for l in s.split(',') if l],
+                        default=['fr', 'de', 'es', 'ja', 'zh-rCN'],
+                        help='comma separated locales to translate the strings into')
+    parser.add_argument('--densities', type=lambda s: [d for d in s.split(',') if d],
+                        default=['mdpi', 'hdpi', 'xhdpi', 'xxhdpi'],
+                        help='comma separated densities to generate the PNGs for')
+    parser.add_argument('--seed', type=int, default=1, help='seed of the generated content')
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('out', help='directory in which to generate the project')
+    addArguments(parser)
+    generate(parser.parse_args())
@@ -0,0 +1,184 @@
+#!/usr/bin/env python
+#
+# Copyright (C) 2015 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+"""Times aapt2 compiling and linking a synthetic resource project.
+
+The project is made by generate_project.py. Each resource directory is
+compiled the way tools/aapt2/data/Makefile does it, then everything is
+linked against the framework. Each phase reports its best wall time over
+the runs, its throughput and the peak RSS of its processes.
+
+The results can be saved as a baseline with --save. A later run with
+--compare fails if a phase got slower or bigger than the baseline by
+more than --tolerance.
+
+Eg:
+  run_benchmark.py --aapt2 out/host/linux-x86/bin/aapt2 \\
+      --framework out/target/common/obj/APPS/framework-res_intermediates/package-export.apk \\
+      --save baseline.json
+"""
+
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+import generate_project
+
+
+def runProcess(command):
+    """Runs command, returning its peak RSS in KiB."""
+    process = subprocess.Popen(command)
+    _, status, usage = os.wait4(process.pid, 0)
+    process.returncode = status
+    if status != 0:
+        sys.exit('failed (%d): %s' % (status, ' '.join(command)))
+
+    # ru_maxrss is in bytes on Mac OS, KiB elsewhere.
+    if sys.platform == 'darwin':
+        return usage.ru_maxrss // 1024
+    return usage.ru_maxrss
+
+
+def listResourceDirs(res):
+    dirs = {}
+    for name in sorted(os.listdir(res)):
+        path = os.path.join(res, name)
+        dirs[name] = [os.path.join(path, f) for f in sorted(os.listdir(path))]
+    return dirs
+
+
+def runOnce(args, project, out):
+    if os.path.isdir(out):
+        shutil.rmtree(out)
+    os.makedirs(out)
+
+    jobs = ['-j', str(args.jobs)] if args.jobs else []
+    cache = ['--cache', os.path.join(args.work, 'cache')] if args.cache else []
+    results = {}
+
+    dirs = listResourceDirs(os.path.join(project, 'res'))
+    start = time.time()
+    peakRss = 0
+    for name, files in sorted(dirs.items()):
+        peakRss = max(peakRss, runProcess(
+                [args.aapt2, 'compile', '-o', os.path.join(out, name + '.apk')] +
+                jobs + cache + files))
+    results['compile'] = {
+        'seconds': time.time() - start,
+        'files': sum(len(files) for files in dirs.values()),
+        'peakRssKb': peakRss,
+    }
+
+    compiled = [os.path.join(out, name + '.apk') for name in sorted(dirs)]
+    start = time.time()
+    peakRss = runProcess(
+            [args.aapt2, 'link', '--manifest', os.path.join(project, 'AndroidManifest.xml'),
+             '-I', args.framework, '--java', os.path.join(out, 'gen'),
+             '-o', os.path.join(out, 'package.apk')] + jobs + compiled)
+    results['link'] = {
+        'seconds': time.time() - start,
+        'files': results['compile']['files'],
+        'peakRssKb': peakRss,
+    }
+    return results
+
+
+def best(runs):
+    """Keeps the fastest run of each phase, and the largest RSS of any."""
+    results = {}
+    for phase in runs[0]:
+        results[phase] = dict(min((run[phase] for run in runs), key=lambda r: r['seconds']))
+        results[phase]['peakRssKb'] = max(run[phase]['peakRssKb'] for run in runs)
+    return results
+
+
+def compare(results, baseline, tolerance):
+    regressions = []
+    for phase, result in sorted(results.items()):
+        if phase not in baseline:
+            continue
+        for key in ('seconds', 'peakRssKb'):
+            limit = baseline[phase][key] * (1.0 + tolerance)
+            if result[key] > limit:
+                regressions.append('%s %s: %.2f, baseline %.2f' %
+                                   (phase, key, result[key], baseline[phase][key]))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--aapt2', default='aapt2', help='aapt2 binary to run')
+    parser.add_argument('--framework', required=True, help='framework APK to link against')
+    parser.add_argument('--work', help='directory for the project and the outputs, '
+                        'a temporary one if unset')
+    parser.add_argument('-j', dest='jobs', type=int, help='jobs to pass to aapt2')
+    parser.add_argument('--cache', action='store_true',
+                        help='compile with a --cache directory, kept between runs')
+    parser.add_argument('--runs', type=int, default=3, help='number of runs to take the best of')
+    parser.add_argument('--save', help='file in which to save the results as a baseline')
+    parser.add_argument('--compare', help='baseline to compare the results with')
+    parser.add_argument('--tolerance', type=float, default=0.1,
+                        help='fraction by which a phase may exceed the baseline')
+    generate_project.addArguments(parser)
+    args = parser.parse_args()
+
+    temporary = args.work is None
+    if temporary:
+        args.work = tempfile.mkdtemp(prefix='aapt2-benchmark-')
+
+    try:
+        project = os.path.join(args.work, 'project')
+        if os.path.isdir(project):
+            shutil.rmtree(project)
+        args.out = project
+        generate_project.generate(args)
+
+        runs = [runOnce(args, project, os.path.join(args.work, 'out')) for _ in range(args.runs)]
+    finally:
+        if temporary:
+            shutil.rmtree(args.work)
+
+    results = best(runs)
+    for phase in ('compile', 'link'):
+        result = results[phase]
+        print('%-8s %8.2fs %10.1f files/s %8.1f MiB peak RSS' %
+              (phase, result['seconds'], result['files'] / result['seconds'],
+               result['peakRssKb'] / 1024.0))
+
+    if args.save:
+        with open(args.save, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True)
+
+    if args.compare:
+        with open(args.compare) as f:
+            regressions = compare(results, json.load(f), args.tolerance)
+        if regressions:
+            print('regressions:\n  ' + '\n  '.join(regressions))
+            return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
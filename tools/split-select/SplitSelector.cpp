@@ -36,8 +36,7 @@ SplitSelector::SplitSelector(const Vector<SplitDescription>& splits)
 
 static void selectBestFromGroup(const SortedVector<SplitDescription>& splits,
         const SplitDescription& target, Vector<SplitDescription>& splitsOut) {
-    SplitDescription bestSplit;
-    bool isSet = false;
+    const SplitDescription* bestSplit = NULL;
     const size_t splitCount = splits.size();
     for (size_t j = 0; j < splitCount; j++) {
         const SplitDescription& thisSplit = splits[j];
@@ -45,14 +44,13 @@ static void selectBestFromGroup(const SortedVector<SplitDescription>& splits,
             continue;
         }
 
-        if (!isSet || thisSplit.isBetterThan(bestSplit, target)) {
-            isSet = true;
-            bestSplit = thisSplit;
+        if (bestSplit == NULL || thisSplit.isBetterThan(*bestSplit, target)) {
+            bestSplit = &thisSplit;
         }
     }
 
-    if (isSet) {
-        splitsOut.add(bestSplit);
+    if (bestSplit != NULL) {
+        splitsOut.add(*bestSplit);
     }
 }
 
@@ -65,6 +63,29 @@ Vector<SplitDescription> SplitSelector::getBestSplits(const SplitDescription& ta
     return bestSplits;
 }
 
+Vector<Vector<SplitDescription> > SplitSelector::getBestSplits(
+        const Vector<SplitDescription>& targets) const {
+    // Many devices share the same configuration, remember where the splits
+    // of each distinct target were first selected.
+    KeyedVector<SplitDescription, size_t> selected;
+
+    Vector<Vector<SplitDescription> > bestSplits;
+    bestSplits.setCapacity(targets.size());
+    const size_t targetCount = targets.size();
+    for (size_t i = 0; i < targetCount; i++) {
+        const ssize_t idx = selected.indexOfKey(targets[i]);
+        if (idx >= 0) {
+            // Vectors share their storage when copied.
+            const Vector<SplitDescription> sameSplits = bestSplits[selected.valueAt(idx)];
+            bestSplits.add(sameSplits);
+        } else {
+            selected.add(targets[i], i);
+            bestSplits.add(getBestSplits(targets[i]));
+        }
+    }
+    return bestSplits;
+}
+
 KeyedVector<SplitDescription, sp<Rule> > SplitSelector::getRules() const {
     KeyedVector<SplitDescription, sp<Rule> > rules;
 
@@ -15,6 +15,7 @@
  */
 
 #include <gtest/gtest.h>
+#include <utils/SortedVector.h>
 #include <utils/String8.h>
 #include <utils/Vector.h>
 
@@ -69,4 +70,39 @@ TEST(SplitSelectorTest, rulesShouldMatchSelection) {
     EXPECT_RULES_EQ(rule, expectedRule);
 }
 
+TEST(SplitSelectorTest, selectsForManyTargets) {
+    Vector<SplitDescription> splits;
+    ASSERT_TRUE(addSplit(splits, "hdpi"));
+    ASSERT_TRUE(addSplit(splits, "xhdpi"));
+    ASSERT_TRUE(addSplit(splits, "en"));
+    ASSERT_TRUE(addSplit(splits, "fr"));
+    ASSERT_TRUE(addSplit(splits, "armeabi"));
+    ASSERT_TRUE(addSplit(splits, "x86"));
+
+    Vector<SplitDescription> targets;
+    ASSERT_TRUE(addSplit(targets, "fr-hdpi:armeabi"));
+    ASSERT_TRUE(addSplit(targets, "en-xhdpi:x86"));
+    ASSERT_TRUE(addSplit(targets, "fr-hdpi:armeabi"));
+    ASSERT_TRUE(addSplit(targets, "de-xxhdpi"));
+
+    SplitSelector selector(splits);
+    Vector<Vector<SplitDescription> > bestSplits = selector.getBestSplits(targets);
+    ASSERT_EQ(targets.size(), bestSplits.size());
+
+    for (size_t i = 0; i < targets.size(); i++) {
+        SortedVector<SplitDescription> expected;
+        expected.merge(selector.getBestSplits(targets[i]));
+        SortedVector<SplitDescription> actual;
+        actual.merge(bestSplits[i]);
+
+        ASSERT_EQ(expected.size(), actual.size()) << targets[i].toString().string();
+        for (size_t j = 0; j < expected.size(); j++) {
+            EXPECT_EQ(expected[j], actual[j]) << targets[i].toString().string();
+        }
+    }
+
+    // fr, hdpi and armeabi.
+    EXPECT_EQ(3u, bestSplits[0].size());
+}
+
 } // namespace split